@@ -0,0 +1,385 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* file.c
+ * File I/O methods for MEM module
+ *
+ * A file's data is held in chunks, allocated as writes reach them.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "mem_methods.h"
+
+static inline int mem_c_cmpf(const struct avltree_node *lhs,
+			     const struct avltree_node *rhs)
+{
+	struct mem_chunk *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct mem_chunk, node);
+	rk = avltree_container_of(rhs, struct mem_chunk, node);
+
+	if (lk->index < rk->index)
+		return -1;
+
+	if (lk->index == rk->index)
+		return 0;
+
+	return 1;
+}
+
+void mem_file_init(struct mem_fsal_obj_handle *hdl)
+{
+	avltree_init(&hdl->mh.file.chunks, mem_c_cmpf, 0 /* flags */);
+	hdl->mh.file.nchunks = 0;
+}
+
+static struct mem_chunk *mem_chunk_lookup(struct mem_fsal_obj_handle *hdl,
+					  uint64_t index)
+{
+	struct mem_chunk key;
+	struct avltree_node *node;
+
+	key.index = index;
+	node = avltree_lookup(&key.node, &hdl->mh.file.chunks);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct mem_chunk, node);
+}
+
+/**
+ * @brief Get a chunk of a file, allocating it if it is a hole
+ *
+ * Called with the object's lock held for write.  A new chunk is zero.
+ *
+ * @return The chunk, NULL if Max_Bytes or memory ran out.
+ */
+
+static struct mem_chunk *mem_chunk_get(struct mem_fsal_obj_handle *hdl,
+				       uint64_t index)
+{
+	struct mem_chunk *chunk = mem_chunk_lookup(hdl, index);
+	uint64_t used;
+
+	if (chunk != NULL)
+		return chunk;
+
+	used = atomic_add_uint64_t(&MEM.bytes_used, MEM_CHUNK);
+	if (MEM.params.max_bytes != 0 && used > MEM.params.max_bytes) {
+		atomic_sub_uint64_t(&MEM.bytes_used, MEM_CHUNK);
+		return NULL;
+	}
+
+	chunk = gsh_calloc(1, sizeof(struct mem_chunk));
+	if (chunk == NULL) {
+		atomic_sub_uint64_t(&MEM.bytes_used, MEM_CHUNK);
+		return NULL;
+	}
+
+	chunk->index = index;
+	avltree_insert(&chunk->node, &hdl->mh.file.chunks);
+	hdl->mh.file.nchunks++;
+
+	return chunk;
+}
+
+static void mem_chunk_free(struct mem_fsal_obj_handle *hdl,
+			   struct mem_chunk *chunk)
+{
+	avltree_remove(&chunk->node, &hdl->mh.file.chunks);
+	hdl->mh.file.nchunks--;
+	atomic_sub_uint64_t(&MEM.bytes_used, MEM_CHUNK);
+	gsh_free(chunk);
+}
+
+/**
+ * @brief Set a file's size
+ *
+ * Called with the object's lock held for write.  Chunks past the new
+ * end are freed and the rest of the last one zeroed, so growing again
+ * reads zeros.
+ */
+
+int mem_truncate(struct mem_fsal_obj_handle *hdl, uint64_t size)
+{
+	struct avltree_node *node;
+	struct mem_chunk *chunk;
+
+	/* Growing leaves a hole, which reads as zeros */
+	while ((node = avltree_last(&hdl->mh.file.chunks)) != NULL) {
+		chunk = avltree_container_of(node, struct mem_chunk, node);
+		if (chunk->index * MEM_CHUNK < size) {
+			if (size < (chunk->index + 1) * MEM_CHUNK)
+				memset(chunk->data + size % MEM_CHUNK, 0,
+				       MEM_CHUNK - size % MEM_CHUNK);
+			break;
+		}
+		mem_chunk_free(hdl, chunk);
+	}
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+
+	hdl->attrs.spaceused = hdl->mh.file.nchunks * MEM_CHUNK;
+	if (size != hdl->attrs.filesize) {
+		hdl->attrs.filesize = size;
+		mem_touch(hdl, true);
+	}
+
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	return 0;
+}
+
+/**
+ * @brief Free a file's data
+ */
+
+void mem_free_data(struct mem_fsal_obj_handle *hdl)
+{
+	struct avltree_node *node;
+
+	while ((node = avltree_first(&hdl->mh.file.chunks)) != NULL)
+		mem_chunk_free(hdl, avltree_container_of(node,
+							 struct mem_chunk,
+							 node));
+}
+
+/** mem_open
+ * There is nothing to open; remember the flags for status.
+ */
+
+fsal_status_t mem_open(struct fsal_obj_handle *obj_hdl,
+		       fsal_openflags_t openflags)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	assert(myself->mh.file.openflags == FSAL_O_CLOSED);
+	myself->mh.file.openflags = openflags;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_status
+ * Let the caller peek into the file's open/close state.
+ */
+
+fsal_openflags_t mem_status(struct fsal_obj_handle *obj_hdl)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+	return myself->mh.file.openflags;
+}
+
+/* mem_read
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t mem_read(struct fsal_obj_handle *obj_hdl,
+		       uint64_t offset,
+		       size_t buffer_size, void *buffer, size_t *read_amount,
+		       bool *end_of_file)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_chunk *chunk;
+	uint64_t size, done, pos, len;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	assert(myself->mh.file.openflags != FSAL_O_CLOSED);
+
+	mem_delay(MEM_OP_READ, buffer_size);
+
+	PTHREAD_RWLOCK_rdlock(&obj_hdl->lock);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	size = myself->attrs.filesize;
+	now(&myself->attrs.atime);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	if (offset >= size) {
+		*read_amount = 0;
+		*end_of_file = true;
+		goto out;
+	}
+
+	*read_amount = MIN(buffer_size, size - offset);
+	*end_of_file = offset + *read_amount == size;
+
+	for (done = 0; done < *read_amount; done += len) {
+		pos = (offset + done) % MEM_CHUNK;
+		len = MIN(*read_amount - done, MEM_CHUNK - pos);
+		chunk = mem_chunk_lookup(myself, (offset + done) / MEM_CHUNK);
+		/* A chunk never written is a hole */
+		if (chunk != NULL)
+			memcpy((char *)buffer + done, chunk->data + pos, len);
+		else
+			memset((char *)buffer + done, 0, len);
+	}
+
+ out:
+	PTHREAD_RWLOCK_unlock(&obj_hdl->lock);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_write
+ * concurrency (locks) is managed in cache_inode_*
+ *
+ * Data in memory is as stable as it gets, so every write is stable.
+ */
+
+fsal_status_t mem_write(struct fsal_obj_handle *obj_hdl,
+			uint64_t offset,
+			size_t buffer_size, void *buffer,
+			size_t *write_amount, bool *fsal_stable)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_chunk *chunk;
+	uint64_t done, pos, len;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	assert(myself->mh.file.openflags != FSAL_O_CLOSED);
+
+	if (offset + buffer_size < offset)
+		return fsalstat(ERR_FSAL_FBIG, EFBIG);
+
+	mem_delay(MEM_OP_WRITE, buffer_size);
+
+	PTHREAD_RWLOCK_wrlock(&obj_hdl->lock);
+
+	for (done = 0; done < buffer_size; done += len) {
+		pos = (offset + done) % MEM_CHUNK;
+		len = MIN(buffer_size - done, MEM_CHUNK - pos);
+		chunk = mem_chunk_get(myself, (offset + done) / MEM_CHUNK);
+		if (chunk == NULL)
+			break;
+		memcpy(chunk->data + pos, (char *)buffer + done, len);
+	}
+
+	if (done != 0) {
+		PTHREAD_MUTEX_lock(&myself->mutex);
+		if (offset + done > myself->attrs.filesize)
+			myself->attrs.filesize = offset + done;
+		myself->attrs.spaceused = myself->mh.file.nchunks * MEM_CHUNK;
+		mem_touch(myself, true);
+		PTHREAD_MUTEX_unlock(&myself->mutex);
+	}
+
+	PTHREAD_RWLOCK_unlock(&obj_hdl->lock);
+
+	/* Short if Max_Bytes ran out part way */
+	if (done == 0 && buffer_size != 0)
+		return fsalstat(ERR_FSAL_NOSPC, ENOSPC);
+
+	*write_amount = done;
+	*fsal_stable = true;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_commit
+ * Writes are already stable; only the backend's time is spent.
+ */
+
+fsal_status_t mem_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			 off_t offset, size_t len)
+{
+	mem_delay(MEM_OP_COMMIT, 0);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_lock_op
+ * With lock_support_owner off, SAL keeps the lock state and checks
+ * conflicts itself; with no other client of the data there is
+ * nothing for the backend to do.
+ */
+
+fsal_status_t mem_lock_op(struct fsal_obj_handle *obj_hdl,
+			  void *p_owner,
+			  fsal_lock_op_t lock_op,
+			  fsal_lock_param_t *request_lock,
+			  fsal_lock_param_t *conflicting_lock)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	if (myself->mh.file.openflags == FSAL_O_CLOSED) {
+		LogDebug(COMPONENT_FSAL,
+			 "Attempting to lock with no file descriptor open");
+		return fsalstat(ERR_FSAL_FAULT, 0);
+	}
+
+	if (conflicting_lock != NULL && lock_op == FSAL_OP_LOCKT)
+		conflicting_lock->lock_length = 0;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_share_op
+ * Share reservations are kept in SAL too.
+ */
+
+fsal_status_t mem_share_op(struct fsal_obj_handle *obj_hdl, void *p_owner,
+			   fsal_share_param_t request_share)
+{
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_close
+ * Close the file if it is still open.
+ */
+
+fsal_status_t mem_close(struct fsal_obj_handle *obj_hdl)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	assert(obj_hdl->type == REGULAR_FILE);
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	if (myself->mh.file.openflags == FSAL_O_CLOSED)
+		return fsalstat(ERR_FSAL_NOT_OPENED, 0);
+
+	myself->mh.file.openflags = FSAL_O_CLOSED;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* mem_lru_cleanup
+ * There are no descriptors to give back.
+ */
+
+fsal_status_t mem_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+			      lru_actions_t requests)
+{
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
@@ -0,0 +1,1325 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* handle.c
+ * MEM object (file|dir|symlink|special) handle methods
+ */
+
+#include "config.h"
+
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "nfs4_acls.h"
+#include "mem_methods.h"
+
+/* helpers
+ */
+
+static inline int mem_n_cmpf(const struct avltree_node *lhs,
+			     const struct avltree_node *rhs)
+{
+	struct mem_dirent *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct mem_dirent, avl_n);
+	rk = avltree_container_of(rhs, struct mem_dirent, avl_n);
+
+	return strcmp(lk->name, rk->name);
+}
+
+static inline int mem_i_cmpf(const struct avltree_node *lhs,
+			     const struct avltree_node *rhs)
+{
+	struct mem_dirent *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct mem_dirent, avl_i);
+	rk = avltree_container_of(rhs, struct mem_dirent, avl_i);
+
+	if (lk->index < rk->index)
+		return -1;
+
+	if (lk->index == rk->index)
+		return 0;
+
+	return 1;
+}
+
+static struct mem_dirent *mem_dirent_lookup(struct mem_fsal_obj_handle *dir,
+					    const char *name)
+{
+	struct mem_dirent key;
+	struct avltree_node *node;
+
+	key.name = (char *)name;
+	node = avltree_lookup(&key.avl_n, &dir->mh.dir.avl_name);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct mem_dirent, avl_n);
+}
+
+/**
+ * @brief Name an object in a directory
+ *
+ * Called with the directory's lock held for write.
+ *
+ * @return 0, EEXIST if the name is taken or ENOMEM.
+ */
+
+static int mem_dirent_insert(struct mem_fsal_obj_handle *dir,
+			     struct mem_fsal_obj_handle *hdl,
+			     const char *name)
+{
+	struct mem_dirent *dirent;
+
+	dirent = gsh_calloc(1, sizeof(struct mem_dirent));
+	if (dirent == NULL)
+		return ENOMEM;
+
+	dirent->name = gsh_strdup(name);
+	if (dirent->name == NULL) {
+		gsh_free(dirent);
+		return ENOMEM;
+	}
+
+	dirent->hdl = hdl;
+	if (avltree_insert(&dirent->avl_n, &dir->mh.dir.avl_name) != NULL) {
+		gsh_free(dirent->name);
+		gsh_free(dirent);
+		return EEXIST;
+	}
+	dirent->index = dir->mh.dir.next_i++;
+	avltree_insert(&dirent->avl_i, &dir->mh.dir.avl_index);
+
+	if (hdl->obj_handle.type == DIRECTORY)
+		hdl->mh.dir.parent = dir;
+
+	return 0;
+}
+
+static void mem_dirent_remove(struct mem_fsal_obj_handle *dir,
+			      struct mem_dirent *dirent)
+{
+	avltree_remove(&dirent->avl_n, &dir->mh.dir.avl_name);
+	avltree_remove(&dirent->avl_i, &dir->mh.dir.avl_index);
+	gsh_free(dirent->name);
+	gsh_free(dirent);
+}
+
+/**
+ * @brief Mark an object changed
+ *
+ * Called with the object's mutex held.
+ *
+ * @param[in] hdl    The object
+ * @param[in] modify Its data or entries changed, not only its inode
+ */
+
+void mem_touch(struct mem_fsal_obj_handle *hdl, bool modify)
+{
+	now(&hdl->attrs.ctime);
+	if (modify)
+		hdl->attrs.mtime = hdl->attrs.ctime;
+	hdl->attrs.chgtime = hdl->attrs.ctime;
+	hdl->attrs.change = timespec_to_nsecs(&hdl->attrs.chgtime);
+}
+
+static void mem_touch_locked(struct mem_fsal_obj_handle *hdl, bool modify)
+{
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	mem_touch(hdl, modify);
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+}
+
+/**
+ * @brief Replace an object's ACL with a hashed copy of acl
+ *
+ * Called with the object's mutex held.  acl is not consumed.
+ */
+
+static fsal_errors_t mem_set_acl(struct mem_fsal_obj_handle *hdl,
+				 fsal_acl_t *acl)
+{
+	fsal_acl_data_t acldata;
+	fsal_acl_status_t status;
+	fsal_acl_t *new_acl = NULL;
+
+	if (acl != NULL && acl->naces != 0) {
+		acldata.naces = acl->naces;
+		acldata.aces = nfs4_ace_alloc(acldata.naces);
+		if (acldata.aces == NULL)
+			return ERR_FSAL_NOMEM;
+		memcpy(acldata.aces, acl->aces,
+		       acldata.naces * sizeof(fsal_ace_t));
+
+		new_acl = nfs4_acl_new_entry(&acldata, &status);
+		if (new_acl == NULL)
+			return ERR_FSAL_FAULT;
+	}
+
+	if (hdl->attrs.acl != NULL)
+		nfs4_acl_release_entry(hdl->attrs.acl, &status);
+
+	hdl->attrs.acl = new_acl;
+	if (new_acl != NULL)
+		FSAL_SET_MASK(hdl->attrs.mask, ATTR_ACL);
+	else
+		FSAL_UNSET_MASK(hdl->attrs.mask, ATTR_ACL);
+
+	return ERR_FSAL_NO_ERROR;
+}
+
+/**
+ * @brief Copy attrs to where cache_inode reads them
+ *
+ * Called with the object's mutex held, and either the cache entry's
+ * attr_lock or no cache entry.  The copy takes its own ACL reference,
+ * which cache_inode drops before asking again.
+ */
+
+static void mem_publish(struct mem_fsal_obj_handle *hdl)
+{
+	int32_t expire = hdl->attributes.expire_time_attr;
+
+	hdl->attributes = hdl->attrs;
+	hdl->attributes.expire_time_attr = expire;
+	if (hdl->attributes.acl != NULL)
+		nfs4_acl_entry_inc_ref(hdl->attributes.acl);
+}
+
+/**
+ * @brief Give out a handle to an object
+ *
+ * @return false if the object is being freed.
+ */
+
+static bool mem_ref(struct mem_fsal_obj_handle *hdl)
+{
+	bool live;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	live = hdl->refcount != 0 || hdl->attrs.numlinks != 0 ||
+	       hdl == hdl->export->root_handle;
+	if (live && hdl->refcount++ == 0) {
+		/* No cache entry has seen it since the last one went */
+		mem_publish(hdl);
+	}
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	return live;
+}
+
+/* alloc_handle
+ * allocate and fill in a handle
+ */
+
+static struct mem_fsal_obj_handle *
+mem_alloc_handle(struct mem_fsal_export *export, object_file_type_t type,
+		 mode_t unix_mode, uid_t owner, gid_t group)
+{
+	struct mem_fsal_obj_handle *hdl;
+
+	hdl = gsh_calloc(1, sizeof(struct mem_fsal_obj_handle));
+
+	if (hdl == NULL) {
+		LogDebug(COMPONENT_FSAL,
+			 "Could not allocate handle");
+		return NULL;
+	}
+
+	hdl->export = export;
+	hdl->obj_handle.attrs = &hdl->attributes;
+	PTHREAD_MUTEX_init(&hdl->mutex, NULL);
+	glist_init(&hdl->xattrs);
+
+	hdl->attrs.mask = MEM.fs_info.supported_attrs & ~ATTR_ACL;
+	hdl->attrs.type = type;
+	hdl->attrs.fsid = export->fsid;
+	hdl->attrs.fileid = atomic_postinc_uint64_t(&MEM.next_fileid);
+	hdl->attrs.mode = unix2fsal_mode(unix_mode);
+	hdl->attrs.numlinks = type == DIRECTORY ? 2 : 1;
+	hdl->attrs.owner = owner;
+	hdl->attrs.group = group;
+
+	/* Use full timer resolution */
+	now(&hdl->attrs.atime);
+	hdl->attrs.creation = hdl->attrs.atime;
+	hdl->attrs.ctime = hdl->attrs.atime;
+	hdl->attrs.mtime = hdl->attrs.atime;
+	hdl->attrs.chgtime = hdl->attrs.atime;
+	hdl->attrs.change = timespec_to_nsecs(&hdl->attrs.chgtime);
+
+	if (type == DIRECTORY) {
+		avltree_init(&hdl->mh.dir.avl_name, mem_n_cmpf, 0 /* flags */);
+		avltree_init(&hdl->mh.dir.avl_index, mem_i_cmpf, 0 /* flags */);
+		/* cookies 0, 1 and 2 mean ".", ".." and the start */
+		hdl->mh.dir.next_i = 3;
+	} else if (type == REGULAR_FILE) {
+		mem_file_init(hdl);
+	}
+
+	fsal_obj_handle_init(&hdl->obj_handle, &export->export, type);
+	mem_handle_ops_init(&hdl->obj_handle.obj_ops);
+	mem_publish(hdl);
+
+	PTHREAD_RWLOCK_wrlock(&export->lock);
+	avltree_insert(&hdl->avl_f, &export->index);
+	PTHREAD_RWLOCK_unlock(&export->lock);
+
+	return hdl;
+}
+
+static void mem_free_handle(struct mem_fsal_obj_handle *hdl)
+{
+	struct avltree_node *node;
+	struct mem_dirent *dirent;
+	fsal_acl_status_t status;
+
+	fsal_obj_handle_fini(&hdl->obj_handle);
+
+	switch (hdl->obj_handle.type) {
+	case REGULAR_FILE:
+		mem_free_data(hdl);
+		break;
+	case SYMBOLIC_LINK:
+		gsh_free(hdl->mh.link);
+		break;
+	case DIRECTORY:
+		while ((node = avltree_first(&hdl->mh.dir.avl_name)) != NULL) {
+			dirent = avltree_container_of(node, struct mem_dirent,
+						      avl_n);
+			mem_dirent_remove(hdl, dirent);
+		}
+		break;
+	default:
+		break;
+	}
+
+	mem_free_xattrs(hdl);
+
+	if (hdl->attrs.acl != NULL)
+		nfs4_acl_release_entry(hdl->attrs.acl, &status);
+	if (hdl->attributes.acl != NULL)
+		nfs4_acl_release_entry(hdl->attributes.acl, &status);
+
+	PTHREAD_MUTEX_destroy(&hdl->mutex);
+	gsh_free(hdl);
+}
+
+/**
+ * @brief Free an object no directory names and no handle refers to
+ */
+
+static void mem_put(struct mem_fsal_obj_handle *hdl)
+{
+	bool dead;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	dead = hdl->refcount == 0 && hdl->attrs.numlinks == 0 &&
+	       hdl != hdl->export->root_handle;
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	if (!dead)
+		return;
+
+	/* Nobody can take a reference any more; wait out create_handle */
+	PTHREAD_RWLOCK_wrlock(&hdl->export->lock);
+	avltree_remove(&hdl->avl_f, &hdl->export->index);
+	PTHREAD_RWLOCK_unlock(&hdl->export->lock);
+
+	LogFullDebug(COMPONENT_FSAL, "Freeing fileid %" PRIu64,
+		     hdl->attrs.fileid);
+
+	mem_free_handle(hdl);
+}
+
+/**
+ * @brief Make the root of an export
+ */
+
+int mem_create_root(struct mem_fsal_export *export)
+{
+	export->root_handle = mem_alloc_handle(export, DIRECTORY, 0755, 0, 0);
+	if (export->root_handle == NULL)
+		return ENOMEM;
+
+	return 0;
+}
+
+/**
+ * @brief Free every object of an export
+ */
+
+void mem_free_tree(struct mem_fsal_export *export)
+{
+	struct avltree_node *node;
+	struct mem_fsal_obj_handle *hdl;
+
+	while ((node = avltree_first(&export->index)) != NULL) {
+		hdl = avltree_container_of(node, struct mem_fsal_obj_handle,
+					   avl_f);
+		avltree_remove(node, &export->index);
+		mem_free_handle(hdl);
+	}
+
+	export->root_handle = NULL;
+}
+
+/* handle methods
+ */
+
+/* lookup
+ * deprecated NULL parent && NULL path implies root handle
+ */
+
+static fsal_status_t lookup(struct fsal_obj_handle *parent,
+			    const char *path,
+			    struct fsal_obj_handle **handle)
+{
+	struct mem_fsal_obj_handle *myself, *hdl = NULL;
+	struct mem_dirent *dirent;
+	bool locked = op_ctx->fsal_private != parent;
+
+	myself = container_of(parent, struct mem_fsal_obj_handle, obj_handle);
+
+	if (parent->type != DIRECTORY)
+		return fsalstat(ERR_FSAL_NOTDIR, 0);
+
+	/* Check if this context already holds the lock on
+	 * this directory, in read_dirents, whose delay covers us.
+	 */
+	if (locked) {
+		mem_delay(MEM_OP_META, 0);
+		PTHREAD_RWLOCK_rdlock(&parent->lock);
+	}
+
+	if (strcmp(path, "..") == 0) {
+		hdl = myself->mh.dir.parent;
+	} else if (strcmp(path, ".") == 0) {
+		hdl = myself;
+	} else {
+		dirent = mem_dirent_lookup(myself, path);
+		if (dirent != NULL)
+			hdl = dirent->hdl;
+	}
+
+	/* The directory lock keeps the entry, and so the object */
+	if (hdl != NULL && !mem_ref(hdl))
+		hdl = NULL;
+
+	if (locked)
+		PTHREAD_RWLOCK_unlock(&parent->lock);
+
+	if (hdl == NULL)
+		return fsalstat(ERR_FSAL_NOENT, 0);
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Make a named object in a directory
+ *
+ * The caller's uid and gid own it.  Inheritable ACEs of the directory
+ * become its ACL unless one is given.
+ */
+
+static fsal_status_t mem_create_obj(struct fsal_obj_handle *dir_hdl,
+				    const char *name,
+				    object_file_type_t type,
+				    struct attrlist *attrib,
+				    fsal_dev_t *dev,
+				    const char *link_path,
+				    struct fsal_obj_handle **handle)
+{
+	struct mem_fsal_obj_handle *myself, *hdl;
+	mode_t unix_mode;
+	fsal_errors_t error;
+	char *link = NULL;
+	bool inherited = false;
+	int retval;
+
+	*handle = NULL;		/* poison it */
+
+	if (dir_hdl->type != DIRECTORY) {
+		LogCrit(COMPONENT_FSAL,
+			"Parent handle is not a directory. hdl = 0x%p",
+			dir_hdl);
+		return fsalstat(ERR_FSAL_NOTDIR, 0);
+	}
+
+	myself = container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_DIR, 0);
+
+	if (type == SYMBOLIC_LINK) {
+		/* Symlinks are 0777 whatever the mode */
+		unix_mode = 0777;
+		link = gsh_strdup(link_path);
+		if (link == NULL)
+			return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+	} else {
+		unix_mode = fsal2unix_mode(attrib->mode)
+		    & ~op_ctx->fsal_export->exp_ops.fs_umask(
+							op_ctx->fsal_export);
+	}
+
+	PTHREAD_RWLOCK_wrlock(&dir_hdl->lock);
+
+	if (mem_dirent_lookup(myself, name) != NULL) {
+		error = ERR_FSAL_EXIST;
+		goto unlock;
+	}
+
+	if (type == REGULAR_FILE || type == DIRECTORY) {
+		PTHREAD_MUTEX_lock(&myself->mutex);
+		if (!FSAL_TEST_MASK(attrib->mask, ATTR_ACL) ||
+		    attrib->acl == NULL) {
+			error = fsal_inherit_acls(attrib, myself->attrs.acl,
+						  type == DIRECTORY
+						  ? FSAL_ACE_FLAG_DIR_INHERIT
+						  : FSAL_ACE_FLAG_FILE_INHERIT);
+			inherited = attrib->acl != NULL;
+		} else {
+			error = ERR_FSAL_NO_ERROR;
+		}
+		PTHREAD_MUTEX_unlock(&myself->mutex);
+		if (error != ERR_FSAL_NO_ERROR)
+			goto unlock;
+	}
+
+	hdl = mem_alloc_handle(myself->export, type, unix_mode,
+			       op_ctx->creds->caller_uid,
+			       op_ctx->creds->caller_gid);
+	if (hdl == NULL) {
+		error = ERR_FSAL_NOMEM;
+		goto unlock;
+	}
+
+	if (type == SYMBOLIC_LINK) {
+		hdl->mh.link = link;
+		hdl->attrs.filesize = strlen(link);
+		link = NULL;
+	} else if ((type == CHARACTER_FILE || type == BLOCK_FILE) &&
+		   dev != NULL) {
+		hdl->attrs.rawdev = *dev;
+	}
+
+	if (FSAL_TEST_MASK(attrib->mask, ATTR_ACL) && attrib->acl != NULL) {
+		error = mem_set_acl(hdl, attrib->acl);
+		if (error != ERR_FSAL_NO_ERROR)
+			goto free;
+	}
+
+	retval = mem_dirent_insert(myself, hdl, name);
+	if (retval != 0) {
+		error = posix2fsal_error(retval);
+		goto free;
+	}
+
+	hdl->refcount = 1;
+	mem_publish(hdl);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	if (type == DIRECTORY)
+		myself->attrs.numlinks++;
+	mem_touch(myself, true);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	PTHREAD_RWLOCK_unlock(&dir_hdl->lock);
+
+	if (inherited) {
+		nfs4_ace_free(attrib->acl->aces);
+		nfs4_acl_free(attrib->acl);
+		attrib->acl = NULL;
+		FSAL_UNSET_MASK(attrib->mask, ATTR_ACL);
+	}
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+ free:
+	/* Unnamed and unreferenced, it goes at once */
+	hdl->attrs.numlinks = 0;
+	mem_put(hdl);
+
+ unlock:
+	PTHREAD_RWLOCK_unlock(&dir_hdl->lock);
+
+	if (inherited) {
+		nfs4_ace_free(attrib->acl->aces);
+		nfs4_acl_free(attrib->acl);
+		attrib->acl = NULL;
+		FSAL_UNSET_MASK(attrib->mask, ATTR_ACL);
+	}
+
+	if (link != NULL)
+		gsh_free(link);
+
+	return fsalstat(error, 0);
+}
+
+static fsal_status_t create(struct fsal_obj_handle *dir_hdl,
+			    const char *name,
+			    struct attrlist *attrib,
+			    struct fsal_obj_handle **handle)
+{
+	LogFullDebug(COMPONENT_FSAL, "create %s", name);
+
+	return mem_create_obj(dir_hdl, name, REGULAR_FILE, attrib, NULL, NULL,
+			      handle);
+}
+
+static fsal_status_t makedir(struct fsal_obj_handle *dir_hdl,
+			     const char *name,
+			     struct attrlist *attrib,
+			     struct fsal_obj_handle **handle)
+{
+	LogFullDebug(COMPONENT_FSAL, "mkdir %s", name);
+
+	return mem_create_obj(dir_hdl, name, DIRECTORY, attrib, NULL, NULL,
+			      handle);
+}
+
+static fsal_status_t makenode(struct fsal_obj_handle *dir_hdl,
+			      const char *name,
+			      object_file_type_t nodetype,
+			      fsal_dev_t *dev,
+			      struct attrlist *attrib,
+			      struct fsal_obj_handle **handle)
+{
+	switch (nodetype) {
+	case BLOCK_FILE:
+	case CHARACTER_FILE:
+	case SOCKET_FILE:
+	case FIFO_FILE:
+		break;
+	default:
+		LogMajor(COMPONENT_FSAL,
+			 "Invalid node type in FSAL_mknode: %d",
+			 nodetype);
+		return fsalstat(ERR_FSAL_INVAL, EINVAL);
+	}
+
+	LogFullDebug(COMPONENT_FSAL, "mknode %s", name);
+
+	return mem_create_obj(dir_hdl, name, nodetype, attrib, dev, NULL,
+			      handle);
+}
+
+/** makesymlink
+ *  Note that we do not set mode bits on symlinks for Linux/POSIX
+ *  They are not really settable in the kernel and are not checked
+ *  anyway (default is 0777) because open uses that target's mode
+ */
+
+static fsal_status_t makesymlink(struct fsal_obj_handle *dir_hdl,
+				 const char *name,
+				 const char *link_path,
+				 struct attrlist *attrib,
+				 struct fsal_obj_handle **handle)
+{
+	LogFullDebug(COMPONENT_FSAL, "symlink %s -> %s", name, link_path);
+
+	return mem_create_obj(dir_hdl, name, SYMBOLIC_LINK, attrib, NULL,
+			      link_path, handle);
+}
+
+static fsal_status_t readsymlink(struct fsal_obj_handle *obj_hdl,
+				 struct gsh_buffdesc *link_content,
+				 bool refresh)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	if (obj_hdl->type != SYMBOLIC_LINK)
+		return fsalstat(ERR_FSAL_FAULT, 0);
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	/* The target never changes, so there is no lock to take */
+	link_content->len = strlen(myself->mh.link) + 1;
+	link_content->addr = gsh_malloc(link_content->len);
+	if (link_content->addr == NULL) {
+		link_content->len = 0;
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+	}
+	memcpy(link_content->addr, myself->mh.link, link_content->len);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t linkfile(struct fsal_obj_handle *obj_hdl,
+			      struct fsal_obj_handle *destdir_hdl,
+			      const char *name)
+{
+	struct mem_fsal_obj_handle *myself, *destdir;
+	fsal_errors_t error = ERR_FSAL_NO_ERROR;
+	int retval;
+
+	if (obj_hdl->type == DIRECTORY)
+		return fsalstat(ERR_FSAL_ISDIR, 0);
+
+	if (destdir_hdl->type != DIRECTORY)
+		return fsalstat(ERR_FSAL_NOTDIR, 0);
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+	destdir = container_of(destdir_hdl, struct mem_fsal_obj_handle,
+			       obj_handle);
+
+	mem_delay(MEM_OP_DIR, 0);
+
+	PTHREAD_RWLOCK_wrlock(&destdir_hdl->lock);
+
+	if (mem_dirent_lookup(destdir, name) != NULL) {
+		error = ERR_FSAL_EXIST;
+		goto unlock;
+	}
+
+	/* An unlinked file stays unlinked */
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	if (myself->attrs.numlinks == 0) {
+		PTHREAD_MUTEX_unlock(&myself->mutex);
+		error = ERR_FSAL_STALE;
+		goto unlock;
+	}
+	myself->attrs.numlinks++;
+	mem_touch(myself, false);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	retval = mem_dirent_insert(destdir, myself, name);
+	if (retval != 0) {
+		PTHREAD_MUTEX_lock(&myself->mutex);
+		myself->attrs.numlinks--;
+		PTHREAD_MUTEX_unlock(&myself->mutex);
+		error = posix2fsal_error(retval);
+		goto unlock;
+	}
+
+	mem_touch_locked(destdir, true);
+
+ unlock:
+	PTHREAD_RWLOCK_unlock(&destdir_hdl->lock);
+
+	return fsalstat(error, 0);
+}
+
+/**
+ * read_dirents
+ * read the directory and call through the callback function for
+ * each entry.
+ * @param dir_hdl [IN] the directory to read
+ * @param whence [IN] where to start (next)
+ * @param dir_state [IN] pass thru of state to callback
+ * @param cb [IN] callback function
+ * @param eof [OUT] eof marker true == end of dir
+ */
+
+static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
+				  fsal_cookie_t *whence,
+				  void *dir_state,
+				  fsal_readdir_cb cb,
+				  bool *eof)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_dirent *dirent;
+	struct avltree_node *node;
+	fsal_cookie_t seekloc = whence != NULL ? *whence : 0;
+
+	*eof = true;
+
+	myself = container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_RWLOCK_rdlock(&dir_hdl->lock);
+
+	/* Use fsal_private to signal to lookup that we hold
+	 * the lock.
+	 */
+	op_ctx->fsal_private = dir_hdl;
+
+	for (node = avltree_first(&myself->mh.dir.avl_index);
+	     node != NULL;
+	     node = avltree_next(node)) {
+		dirent = avltree_container_of(node, struct mem_dirent, avl_i);
+
+		/* skip entries up to the one the cookie was given for */
+		if (dirent->index <= seekloc)
+			continue;
+
+		if (!cb(dirent->name, dir_state, dirent->index)) {
+			*eof = false;
+			break;
+		}
+	}
+
+	op_ctx->fsal_private = NULL;
+
+	PTHREAD_RWLOCK_unlock(&dir_hdl->lock);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Is dir ancestor, or under it?
+ *
+ * Called with the export's rename_lock held, which keeps directories
+ * where they are.
+ */
+
+static bool mem_is_under(struct mem_fsal_obj_handle *dir,
+			 struct mem_fsal_obj_handle *ancestor)
+{
+	for (; dir != NULL; dir = dir->mh.dir.parent)
+		if (dir == ancestor)
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief Drop the link a removed name held
+ *
+ * Called with the directory's lock held for write.
+ */
+
+static void mem_unlinked(struct mem_fsal_obj_handle *dir,
+			 struct mem_fsal_obj_handle *hdl)
+{
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	if (hdl->obj_handle.type == DIRECTORY) {
+		hdl->attrs.numlinks = 0;
+		hdl->mh.dir.parent = NULL;
+	} else {
+		hdl->attrs.numlinks--;
+	}
+	mem_touch(hdl, false);
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	PTHREAD_MUTEX_lock(&dir->mutex);
+	if (hdl->obj_handle.type == DIRECTORY)
+		dir->attrs.numlinks--;
+	mem_touch(dir, true);
+	PTHREAD_MUTEX_unlock(&dir->mutex);
+
+	mem_put(hdl);
+}
+
+static fsal_status_t renamefile(struct fsal_obj_handle *obj_hdl,
+				struct fsal_obj_handle *olddir_hdl,
+				const char *old_name,
+				struct fsal_obj_handle *newdir_hdl,
+				const char *new_name)
+{
+	struct mem_fsal_obj_handle *olddir, *newdir, *hdl, *victim = NULL;
+	struct mem_dirent *dirent, *target;
+	fsal_errors_t error = ERR_FSAL_NO_ERROR;
+	bool moving_dir;
+	int retval;
+
+	olddir = container_of(olddir_hdl, struct mem_fsal_obj_handle,
+			      obj_handle);
+	newdir = container_of(newdir_hdl, struct mem_fsal_obj_handle,
+			      obj_handle);
+	moving_dir = obj_hdl->type == DIRECTORY && olddir != newdir;
+
+	mem_delay(MEM_OP_DIR, 0);
+
+	if (moving_dir)
+		PTHREAD_MUTEX_lock(&olddir->export->rename_lock);
+
+	/* Take the directories in address order */
+	if (olddir == newdir) {
+		PTHREAD_RWLOCK_wrlock(&olddir_hdl->lock);
+	} else if (olddir < newdir) {
+		PTHREAD_RWLOCK_wrlock(&olddir_hdl->lock);
+		PTHREAD_RWLOCK_wrlock(&newdir_hdl->lock);
+	} else {
+		PTHREAD_RWLOCK_wrlock(&newdir_hdl->lock);
+		PTHREAD_RWLOCK_wrlock(&olddir_hdl->lock);
+	}
+
+	dirent = mem_dirent_lookup(olddir, old_name);
+	if (dirent == NULL) {
+		error = ERR_FSAL_NOENT;
+		goto unlock;
+	}
+	hdl = dirent->hdl;
+
+	if (moving_dir && mem_is_under(newdir, hdl)) {
+		error = ERR_FSAL_INVAL;
+		goto unlock;
+	}
+
+	target = mem_dirent_lookup(newdir, new_name);
+	if (target != NULL) {
+		victim = target->hdl;
+		if (victim == hdl) {
+			/* Two names of one object: nothing to do */
+			goto unlock;
+		}
+		if (victim->obj_handle.type == DIRECTORY &&
+		    hdl->obj_handle.type != DIRECTORY) {
+			error = ERR_FSAL_ISDIR;
+			goto unlock;
+		}
+		if (victim->obj_handle.type != DIRECTORY &&
+		    hdl->obj_handle.type == DIRECTORY) {
+			error = ERR_FSAL_NOTDIR;
+			goto unlock;
+		}
+		if (victim->obj_handle.type == DIRECTORY) {
+			/* Nobody else holds both our locks and its */
+			PTHREAD_RWLOCK_rdlock(&victim->obj_handle.lock);
+			retval = avltree_size(&victim->mh.dir.avl_name);
+			PTHREAD_RWLOCK_unlock(&victim->obj_handle.lock);
+			if (retval != 0) {
+				error = ERR_FSAL_NOTEMPTY;
+				goto unlock;
+			}
+		}
+	}
+
+	if (target != NULL) {
+		/* Take over the target's name, which cannot fail */
+		target->hdl = hdl;
+		if (hdl->obj_handle.type == DIRECTORY)
+			hdl->mh.dir.parent = newdir;
+		mem_unlinked(newdir, victim);
+	} else {
+		/* Name it in the new place first, so failing leaves it be */
+		retval = mem_dirent_insert(newdir, hdl, new_name);
+		if (retval != 0) {
+			error = posix2fsal_error(retval);
+			goto unlock;
+		}
+	}
+
+	mem_dirent_remove(olddir, dirent);
+
+	if (hdl->obj_handle.type == DIRECTORY && olddir != newdir) {
+		PTHREAD_MUTEX_lock(&olddir->mutex);
+		olddir->attrs.numlinks--;
+		PTHREAD_MUTEX_unlock(&olddir->mutex);
+		PTHREAD_MUTEX_lock(&newdir->mutex);
+		newdir->attrs.numlinks++;
+		PTHREAD_MUTEX_unlock(&newdir->mutex);
+	}
+
+	mem_touch_locked(olddir, true);
+	if (newdir != olddir)
+		mem_touch_locked(newdir, true);
+	mem_touch_locked(hdl, false);
+
+ unlock:
+	PTHREAD_RWLOCK_unlock(&olddir_hdl->lock);
+	if (olddir != newdir)
+		PTHREAD_RWLOCK_unlock(&newdir_hdl->lock);
+
+	if (moving_dir)
+		PTHREAD_MUTEX_unlock(&olddir->export->rename_lock);
+
+	return fsalstat(error, 0);
+}
+
+static fsal_status_t getattrs(struct fsal_obj_handle *obj_hdl)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	mem_publish(myself);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/*
+ * NOTE: this is done under protection of the attributes rwlock
+ *       in the cache entry.
+ */
+
+static fsal_status_t setattrs(struct fsal_obj_handle *obj_hdl,
+			      struct attrlist *attrs)
+{
+	struct mem_fsal_obj_handle *myself;
+	fsal_errors_t error = ERR_FSAL_NO_ERROR;
+	int retval;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	/* apply umask, if mode attribute is to be changed */
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_MODE))
+		attrs->mode &= ~op_ctx->fsal_export->exp_ops.
+			fs_umask(op_ctx->fsal_export);
+
+#ifdef ENABLE_RFC_ACL
+	{
+		fsal_status_t status;
+
+		if (FSAL_TEST_MASK(attrs->mask, ATTR_MODE) &&
+		    !FSAL_TEST_MASK(attrs->mask, ATTR_ACL)) {
+			/* Set ACL from MODE */
+			status = fsal_mode_to_acl(attrs,
+						  myself->attributes.acl);
+		} else {
+			/* If ATTR_ACL is set, mode needs to be adjusted no
+			 * matter what.  See 7530 s 6.4.1.3 */
+			if (!FSAL_TEST_MASK(attrs->mask, ATTR_MODE))
+				attrs->mode = myself->attributes.mode;
+			status = fsal_acl_to_mode(attrs);
+		}
+		if (FSAL_IS_ERROR(status))
+			return status;
+	}
+#endif /* ENABLE_RFC_ACL */
+
+	mem_delay(MEM_OP_META, 0);
+
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_SIZE)) {
+		if (obj_hdl->type != REGULAR_FILE) {
+			LogFullDebug(COMPONENT_FSAL,
+				     "Setting size on non-regular file");
+			return fsalstat(ERR_FSAL_INVAL, EINVAL);
+		}
+
+		PTHREAD_RWLOCK_wrlock(&obj_hdl->lock);
+		retval = mem_truncate(myself, attrs->filesize);
+		PTHREAD_RWLOCK_unlock(&obj_hdl->lock);
+		if (retval != 0)
+			return fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_MODE))
+		myself->attrs.mode = attrs->mode & 07777;
+
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_OWNER))
+		myself->attrs.owner = attrs->owner;
+
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_GROUP))
+		myself->attrs.group = attrs->group;
+
+	if (FSAL_TEST_MASK(attrs->mask, ATTR_ACL)) {
+		error = mem_set_acl(myself, attrs->acl);
+		if (error != ERR_FSAL_NO_ERROR)
+			goto unlock;
+	}
+
+	mem_touch(myself, false);
+
+	/* Setting time on symlinks is illegal, as it is for VFS */
+	if (obj_hdl->type != SYMBOLIC_LINK) {
+		if (FSAL_TEST_MASK(attrs->mask, ATTR_ATIME_SERVER))
+			myself->attrs.atime = myself->attrs.ctime;
+		else if (FSAL_TEST_MASK(attrs->mask, ATTR_ATIME))
+			myself->attrs.atime = attrs->atime;
+
+		if (FSAL_TEST_MASK(attrs->mask, ATTR_MTIME_SERVER))
+			myself->attrs.mtime = myself->attrs.ctime;
+		else if (FSAL_TEST_MASK(attrs->mask, ATTR_MTIME))
+			myself->attrs.mtime = attrs->mtime;
+	}
+
+ unlock:
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return fsalstat(error, 0);
+}
+
+/* file_unlink
+ * unlink the named file in the directory
+ */
+
+static fsal_status_t file_unlink(struct fsal_obj_handle *dir_hdl,
+				 const char *name)
+{
+	struct mem_fsal_obj_handle *myself, *hdl;
+	struct mem_dirent *dirent;
+	fsal_errors_t error = ERR_FSAL_NO_ERROR;
+	int size;
+
+	myself = container_of(dir_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_DIR, 0);
+
+	PTHREAD_RWLOCK_wrlock(&dir_hdl->lock);
+
+	dirent = mem_dirent_lookup(myself, name);
+	if (dirent == NULL) {
+		error = ERR_FSAL_NOENT;
+		goto unlock;
+	}
+	hdl = dirent->hdl;
+
+	if (hdl->obj_handle.type == DIRECTORY) {
+		/* Check if directory is empty */
+		PTHREAD_RWLOCK_rdlock(&hdl->obj_handle.lock);
+		size = avltree_size(&hdl->mh.dir.avl_name);
+		PTHREAD_RWLOCK_unlock(&hdl->obj_handle.lock);
+		if (size != 0) {
+			error = ERR_FSAL_NOTEMPTY;
+			goto unlock;
+		}
+	}
+
+	mem_dirent_remove(myself, dirent);
+	mem_unlinked(myself, hdl);
+
+ unlock:
+	PTHREAD_RWLOCK_unlock(&dir_hdl->lock);
+
+	return fsalstat(error, 0);
+}
+
+/* handle_digest
+ * fill in the opaque f/s file handle part.
+ * A MEM handle is the object's fileid.
+ */
+
+static fsal_status_t handle_digest(const struct fsal_obj_handle *obj_hdl,
+				   fsal_digesttype_t output_type,
+				   struct gsh_buffdesc *fh_desc)
+{
+	const struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl,
+			      const struct mem_fsal_obj_handle,
+			      obj_handle);
+
+	switch (output_type) {
+	case FSAL_DIGEST_NFSV3:
+	case FSAL_DIGEST_NFSV4:
+		if (fh_desc->len < sizeof(myself->attrs.fileid)) {
+			LogMajor(COMPONENT_FSAL,
+				 "Space too small for handle.  need %zu, have %zu",
+				 sizeof(myself->attrs.fileid), fh_desc->len);
+			return fsalstat(ERR_FSAL_TOOSMALL, 0);
+		}
+
+		memcpy(fh_desc->addr, &myself->attrs.fileid,
+		       sizeof(myself->attrs.fileid));
+		fh_desc->len = sizeof(myself->attrs.fileid);
+		break;
+
+	default:
+		return fsalstat(ERR_FSAL_SERVERFAULT, 0);
+	}
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * handle_to_key
+ * return a handle descriptor into the handle in this object handle
+ */
+
+static void handle_to_key(struct fsal_obj_handle *obj_hdl,
+			  struct gsh_buffdesc *fh_desc)
+{
+	struct mem_fsal_obj_handle *myself;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	/* The fileid never changes */
+	fh_desc->addr = &myself->attrs.fileid;
+	fh_desc->len = sizeof(myself->attrs.fileid);
+}
+
+/*
+ * release
+ * cache_inode is done with a handle; the object goes with its last
+ * handle once no directory names it.
+ */
+
+static void release(struct fsal_obj_handle *obj_hdl)
+{
+	struct mem_fsal_obj_handle *myself;
+	fsal_acl_status_t status;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	assert(myself->refcount > 0);
+	if (--myself->refcount == 0 && myself->attributes.acl != NULL) {
+		/* The FSAL releases the ACL cache_inode last saw */
+		nfs4_acl_release_entry(myself->attributes.acl, &status);
+		myself->attributes.acl = NULL;
+	}
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	mem_put(myself);
+}
+
+void mem_handle_ops_init(struct fsal_obj_ops *ops)
+{
+	ops->release = release;
+	ops->lookup = lookup;
+	ops->readdir = read_dirents;
+	ops->create = create;
+	ops->mkdir = makedir;
+	ops->mknode = makenode;
+	ops->symlink = makesymlink;
+	ops->readlink = readsymlink;
+	ops->test_access = fsal_test_access;
+	ops->getattrs = getattrs;
+	ops->setattrs = setattrs;
+	ops->link = linkfile;
+	ops->rename = renamefile;
+	ops->unlink = file_unlink;
+	ops->open = mem_open;
+	ops->status = mem_status;
+	ops->read = mem_read;
+	ops->write = mem_write;
+	ops->commit = mem_commit;
+	ops->lock_op = mem_lock_op;
+	ops->share_op = mem_share_op;
+	ops->close = mem_close;
+	ops->lru_cleanup = mem_lru_cleanup;
+	ops->handle_digest = handle_digest;
+	ops->handle_to_key = handle_to_key;
+
+	/* xattr related functions */
+	ops->list_ext_attrs = mem_list_ext_attrs;
+	ops->getextattr_id_by_name = mem_getextattr_id_by_name;
+	ops->getextattr_value_by_name = mem_getextattr_value_by_name;
+	ops->getextattr_value_by_id = mem_getextattr_value_by_id;
+	ops->setextattr_value = mem_setextattr_value;
+	ops->setextattr_value_by_id = mem_setextattr_value_by_id;
+	ops->getextattr_attrs = mem_getextattr_attrs;
+	ops->remove_extattr_by_id = mem_remove_extattr_by_id;
+	ops->remove_extattr_by_name = mem_remove_extattr_by_name;
+}
+
+/* export methods that create object handles
+ */
+
+/* lookup_path
+ * The export's path names its root; paths under it are walked.
+ */
+
+fsal_status_t mem_lookup_path(struct fsal_export *exp_hdl,
+			      const char *path,
+			      struct fsal_obj_handle **handle)
+{
+	struct mem_fsal_export *myself;
+	struct fsal_obj_handle *dir, *next;
+	fsal_status_t status;
+	size_t len;
+	char *copy, *name, *saveptr = NULL;
+
+	myself = container_of(exp_hdl, struct mem_fsal_export, export);
+	len = strlen(myself->export_path);
+
+	if (strncmp(path, myself->export_path, len) != 0 ||
+	    (path[len] != '\0' && path[len] != '/' &&
+	     myself->export_path[len - 1] != '/')) {
+		LogCrit(COMPONENT_FSAL,
+			"Attempt to lookup %s outside export %s",
+			path, myself->export_path);
+		return fsalstat(ERR_FSAL_NOENT, ENOENT);
+	}
+
+	if (!mem_ref(myself->root_handle))
+		return fsalstat(ERR_FSAL_STALE, ESTALE);
+
+	dir = &myself->root_handle->obj_handle;
+
+	copy = gsh_strdup(path + len);
+	if (copy == NULL) {
+		release(dir);
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+	}
+
+	for (name = strtok_r(copy, "/", &saveptr); name != NULL;
+	     name = strtok_r(NULL, "/", &saveptr)) {
+		status = lookup(dir, name, &next);
+		release(dir);
+		if (FSAL_IS_ERROR(status)) {
+			gsh_free(copy);
+			return status;
+		}
+		dir = next;
+	}
+
+	gsh_free(copy);
+	*handle = dir;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* create_handle
+ * Does what original FSAL_ExpandHandle did (sort of)
+ * returns a ref counted handle to be later used in cache_inode etc.
+ * NOTE! you must release this thing when done with it!
+ */
+
+fsal_status_t mem_create_handle(struct fsal_export *exp_hdl,
+				struct gsh_buffdesc *hdl_desc,
+				struct fsal_obj_handle **handle)
+{
+	struct mem_fsal_export *myself;
+	struct mem_fsal_obj_handle key, *hdl = NULL;
+	struct avltree_node *node;
+
+	*handle = NULL;
+
+	if (hdl_desc->len != sizeof(key.attrs.fileid)) {
+		LogCrit(COMPONENT_FSAL,
+			"Invalid handle size %zu expected %zu",
+			hdl_desc->len, sizeof(key.attrs.fileid));
+
+		return fsalstat(ERR_FSAL_BADHANDLE, 0);
+	}
+
+	myself = container_of(exp_hdl, struct mem_fsal_export, export);
+	memcpy(&key.attrs.fileid, hdl_desc->addr, sizeof(key.attrs.fileid));
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_RWLOCK_rdlock(&myself->lock);
+
+	node = avltree_lookup(&key.avl_f, &myself->index);
+	if (node != NULL) {
+		hdl = avltree_container_of(node, struct mem_fsal_obj_handle,
+					   avl_f);
+		if (!mem_ref(hdl))
+			hdl = NULL;
+	}
+
+	PTHREAD_RWLOCK_unlock(&myself->lock);
+
+	if (hdl == NULL) {
+		LogDebug(COMPONENT_FSAL,
+			 "Could not find fileid %" PRIu64,
+			 key.attrs.fileid);
+		return fsalstat(ERR_FSAL_STALE, ESTALE);
+	}
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
@@ -0,0 +1,236 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* main.c
+ * Module core functions
+ *
+ * FSAL_MEM keeps a read-write file system in memory, so the
+ * protocol, cache_inode and SAL layers can be measured without a
+ * backend.  The MEM block can delay each class of operation and
+ * limit read and write bandwidth to stand in for a slow or remote
+ * backend.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include "fsal.h"
+#include "FSAL/fsal_init.h"
+#include "mem_methods.h"
+
+/* defined the set of attributes supported with POSIX */
+#define MEM_SUPPORTED_ATTRIBUTES (					\
+		ATTR_TYPE     | ATTR_SIZE     |				\
+		ATTR_FSID     | ATTR_FILEID   |				\
+		ATTR_MODE     | ATTR_NUMLINKS | ATTR_OWNER     |	\
+		ATTR_GROUP    | ATTR_ATIME    | ATTR_RAWDEV    |	\
+		ATTR_CTIME    | ATTR_MTIME    | ATTR_SPACEUSED |	\
+		ATTR_CHGTIME  | ATTR_ACL)
+
+static const char myname[] = "MEM";
+
+/* filesystem info for MEM */
+static struct fsal_staticfsinfo_t default_mem_info = {
+	.maxfilesize = UINT64_MAX,
+	.maxlink = UINT32_MAX,
+	.maxnamelen = MAXNAMLEN,
+	.maxpathlen = MAXPATHLEN,
+	.no_trunc = true,
+	.chown_restricted = true,
+	.case_insensitive = false,
+	.case_preserving = true,
+	.link_support = true,
+	.symlink_support = true,
+	.lock_support = true,
+	.lock_support_owner = false,
+	.lock_support_async_block = false,
+	.named_attr = true,
+	.unique_handles = true,
+	.lease_time = {10, 0},
+	.acl_support = FSAL_ACLSUPPORT_ALLOW | FSAL_ACLSUPPORT_DENY,
+	.cansettime = true,
+	.homogenous = true,
+	.supported_attrs = MEM_SUPPORTED_ATTRIBUTES,
+	.maxread = FSAL_MAXIOSIZE,
+	.maxwrite = FSAL_MAXIOSIZE,
+	.umask = 0,
+	.auth_exportpath_xdev = false,
+	.xattr_access_rights = 0600,
+	.link_supports_permission_checks = false,
+};
+
+static struct config_item mem_items[] = {
+	CONF_ITEM_UI64("maxread", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
+		       mem_fsal_module, fs_info.maxread),
+	CONF_ITEM_UI64("maxwrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
+		       mem_fsal_module, fs_info.maxwrite),
+	CONF_ITEM_MODE("umask", 0,
+		       mem_fsal_module, fs_info.umask),
+	CONF_ITEM_UI64("Max_Bytes", 0, UINT64_MAX, 0,
+		       mem_fsal_module, params.max_bytes),
+	CONF_ITEM_UI32("Meta_Latency", 0, 10000000, 0,
+		       mem_fsal_module, params.latency[MEM_OP_META]),
+	CONF_ITEM_UI32("Dir_Latency", 0, 10000000, 0,
+		       mem_fsal_module, params.latency[MEM_OP_DIR]),
+	CONF_ITEM_UI32("Read_Latency", 0, 10000000, 0,
+		       mem_fsal_module, params.latency[MEM_OP_READ]),
+	CONF_ITEM_UI32("Write_Latency", 0, 10000000, 0,
+		       mem_fsal_module, params.latency[MEM_OP_WRITE]),
+	CONF_ITEM_UI32("Commit_Latency", 0, 10000000, 0,
+		       mem_fsal_module, params.latency[MEM_OP_COMMIT]),
+	CONF_ITEM_UI64("Read_Bandwidth", 0, UINT64_MAX, 0,
+		       mem_fsal_module, params.read_bandwidth),
+	CONF_ITEM_UI64("Write_Bandwidth", 0, UINT64_MAX, 0,
+		       mem_fsal_module, params.write_bandwidth),
+	CONFIG_EOL
+};
+
+static struct config_block mem_block = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.fsal.mem",
+	.blk_desc.name = "MEM",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = noop_conf_init,
+	.blk_desc.u.blk.params = mem_items,
+	.blk_desc.u.blk.commit = noop_conf_commit
+};
+
+/* private helper for export object
+ */
+
+struct fsal_staticfsinfo_t *mem_staticinfo(struct fsal_module *hdl)
+{
+	struct mem_fsal_module *myself;
+
+	myself = container_of(hdl, struct mem_fsal_module, fsal);
+	return &myself->fs_info;
+}
+
+/**
+ * @brief Stand in for the backend's time on an operation
+ *
+ * Sleeps the operation's latency and, for READ and WRITE, the time
+ * the bytes take at the configured bandwidth.  Called before any
+ * lock is taken, so operations wait in parallel as they would on a
+ * remote backend.
+ *
+ * @param[in] op    The class of operation
+ * @param[in] bytes Bytes read or written
+ */
+
+void mem_delay(enum mem_op op, size_t bytes)
+{
+	struct mem_params *params = &MEM.params;
+	uint64_t bandwidth = 0;
+	uint64_t usec = params->latency[op];
+	struct timespec ts;
+
+	if (op == MEM_OP_READ)
+		bandwidth = params->read_bandwidth;
+	else if (op == MEM_OP_WRITE)
+		bandwidth = params->write_bandwidth;
+
+	if (bandwidth != 0)
+		usec += (uint64_t)bytes * 1000000 / bandwidth;
+
+	if (usec == 0)
+		return;
+
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/* Module methods
+ */
+
+/* init_config
+ * must be called with a reference taken (via lookup_fsal)
+ */
+
+static fsal_status_t init_config(struct fsal_module *fsal_hdl,
+				 config_file_t config_struct,
+				 struct config_error_type *err_type)
+{
+	struct mem_fsal_module *mem_me =
+	    container_of(fsal_hdl, struct mem_fsal_module, fsal);
+
+	mem_me->fs_info = default_mem_info;	/* copy the consts */
+	(void) load_config_from_parse(config_struct,
+				      &mem_block,
+				      mem_me,
+				      true,
+				      err_type);
+	if (!config_error_is_harmless(err_type))
+		return fsalstat(ERR_FSAL_INVAL, 0);
+	display_fsinfo(&mem_me->fs_info);
+	LogDebug(COMPONENT_FSAL,
+		 "FSAL INIT: Supported attributes mask = 0x%" PRIx64,
+		 mem_me->fs_info.supported_attrs);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* Module initialization.
+ * Called by dlopen() to register the module
+ * keep a private pointer to me in myself
+ */
+
+/* my module private storage
+ */
+
+struct mem_fsal_module MEM;
+
+/* linkage to the exports and handle ops initializers
+ */
+
+MODULE_INIT void mem_init(void)
+{
+	int retval;
+	struct fsal_module *myself = &MEM.fsal;
+
+	retval = register_fsal(myself, myname, FSAL_MAJOR_VERSION,
+			       FSAL_MINOR_VERSION, FSAL_ID_NO_PNFS);
+	if (retval != 0) {
+		fprintf(stderr, "MEM module failed to register");
+		return;
+	}
+	myself->m_ops.create_export = mem_create_export;
+	myself->m_ops.init_config = init_config;
+
+	/* fileid 1 is left unused, like inode 1 on most file systems */
+	MEM.next_fileid = 2;
+}
+
+MODULE_FINI void mem_unload(void)
+{
+	int retval;
+
+	retval = unregister_fsal(&MEM.fsal);
+	if (retval != 0) {
+		fprintf(stderr, "MEM module failed to unregister");
+		return;
+	}
+}
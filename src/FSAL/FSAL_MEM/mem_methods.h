@@ -0,0 +1,248 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* MEM methods for handles
+ */
+
+#ifndef MEM_METHODS_H
+#define MEM_METHODS_H
+
+#include "avltree.h"
+#include "gsh_list.h"
+
+/**
+ * @brief Classes of operation the backend delays
+ */
+
+enum mem_op {
+	MEM_OP_META,		/*< lookup, getattrs, setattrs, readdir */
+	MEM_OP_DIR,		/*< create, link, rename, unlink */
+	MEM_OP_READ,
+	MEM_OP_WRITE,
+	MEM_OP_COMMIT,
+	MEM_OP_COUNT
+};
+
+/**
+ * @brief The MEM block
+ */
+
+struct mem_params {
+	uint32_t latency[MEM_OP_COUNT];	/*< Microseconds per operation */
+	uint64_t read_bandwidth;	/*< Bytes per second, 0 unlimited */
+	uint64_t write_bandwidth;	/*< Bytes per second, 0 unlimited */
+	uint64_t max_bytes;		/*< File data held, 0 unlimited */
+};
+
+struct mem_fsal_module {
+	struct fsal_module fsal;
+	struct fsal_staticfsinfo_t fs_info;
+	struct mem_params params;
+	uint64_t bytes_used;		/*< File data held */
+	uint64_t next_fileid;		/*< Unique over all exports */
+};
+
+extern struct mem_fsal_module MEM;
+
+struct mem_fsal_obj_handle;
+
+/*
+ * MEM internal export
+ */
+struct mem_fsal_export {
+	struct fsal_export export;
+	char *export_path;
+	fsal_fsid_t fsid;			/*< Of every object in it */
+	struct mem_fsal_obj_handle *root_handle;
+	pthread_rwlock_t lock;		/*< Protects index */
+	struct avltree index;		/*< Objects by fileid */
+	pthread_mutex_t rename_lock;	/*< Serializes moving directories */
+};
+
+fsal_status_t mem_lookup_path(struct fsal_export *exp_hdl,
+			      const char *path,
+			      struct fsal_obj_handle **handle);
+
+fsal_status_t mem_create_handle(struct fsal_export *exp_hdl,
+				struct gsh_buffdesc *hdl_desc,
+				struct fsal_obj_handle **handle);
+
+/**
+ * @brief A name in a directory
+ */
+
+struct mem_dirent {
+	struct avltree_node avl_n;	/*< In the directory by name */
+	struct avltree_node avl_i;	/*< In the directory by cookie */
+	uint64_t index;			/*< Readdir cookie */
+	struct mem_fsal_obj_handle *hdl;
+	char *name;
+};
+
+/**
+ * @brief An extended attribute
+ */
+
+struct mem_xattr {
+	struct glist_head list;
+	unsigned int id;
+	char *name;
+	size_t len;
+	char *value;
+};
+
+/*
+ * MEM internal object handle
+ *
+ * obj_handle.lock covers a directory's entries and a file's data.
+ * mutex covers attrs, refcount and xattrs and nests inside every
+ * other lock.
+ * attrs is the object as it is; attributes is what cache_inode sees
+ * through obj_handle.attrs, a copy of attrs taken by getattrs under
+ * the cache entry's attr_lock or when the first handle is given out.
+ *
+ * An object lives while a directory names it (attrs.numlinks) or
+ * cache_inode holds a handle to it (refcount).
+ */
+
+struct mem_fsal_obj_handle {
+	struct fsal_obj_handle obj_handle;
+	struct attrlist attributes;
+	struct attrlist attrs;
+	struct mem_fsal_export *export;
+	struct avltree_node avl_f;	/*< In the export index */
+	pthread_mutex_t mutex;
+	uint32_t refcount;		/*< Handles given out */
+	union {
+		struct {
+			struct mem_fsal_obj_handle *parent;
+			struct avltree avl_name;
+			struct avltree avl_index;
+			uint64_t next_i;
+		} dir;
+		struct {
+			struct avltree chunks;	/*< Data written, by index */
+			uint64_t nchunks;
+			fsal_openflags_t openflags;
+		} file;
+		char *link;
+	} mh;
+	struct glist_head xattrs;
+	unsigned int next_xattr_id;
+};
+
+/** Bytes of a chunk of file data */
+#define MEM_CHUNK (64 * 1024)
+
+/**
+ * @brief A chunk of a file's data
+ *
+ * Files are sparse: only the chunks written to are held, and the rest
+ * of the file reads as zeros.
+ */
+
+struct mem_chunk {
+	struct avltree_node node;	/*< In the file's chunks */
+	uint64_t index;			/*< Offset over MEM_CHUNK */
+	char data[MEM_CHUNK];
+};
+
+void mem_delay(enum mem_op op, size_t bytes);
+void mem_touch(struct mem_fsal_obj_handle *hdl, bool modify);
+
+	/* I/O management */
+fsal_status_t mem_open(struct fsal_obj_handle *obj_hdl,
+		       fsal_openflags_t openflags);
+fsal_openflags_t mem_status(struct fsal_obj_handle *obj_hdl);
+fsal_status_t mem_read(struct fsal_obj_handle *obj_hdl,
+		       uint64_t offset,
+		       size_t buffer_size, void *buffer,
+		       size_t *read_amount, bool *end_of_file);
+fsal_status_t mem_write(struct fsal_obj_handle *obj_hdl,
+			uint64_t offset,
+			size_t buffer_size, void *buffer,
+			size_t *write_amount, bool *fsal_stable);
+fsal_status_t mem_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			 off_t offset, size_t len);
+fsal_status_t mem_lock_op(struct fsal_obj_handle *obj_hdl,
+			  void *p_owner,
+			  fsal_lock_op_t lock_op,
+			  fsal_lock_param_t *request_lock,
+			  fsal_lock_param_t *conflicting_lock);
+fsal_status_t mem_share_op(struct fsal_obj_handle *obj_hdl, void *p_owner,
+			   fsal_share_param_t request_share);
+fsal_status_t mem_close(struct fsal_obj_handle *obj_hdl);
+fsal_status_t mem_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+			      lru_actions_t requests);
+void mem_file_init(struct mem_fsal_obj_handle *hdl);
+int mem_truncate(struct mem_fsal_obj_handle *hdl, uint64_t size);
+void mem_free_data(struct mem_fsal_obj_handle *hdl);
+
+/* extended attributes management */
+fsal_status_t mem_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
+				 unsigned int cookie,
+				 fsal_xattrent_t *xattrs_tab,
+				 unsigned int xattrs_tabsize,
+				 unsigned int *p_nb_returned,
+				 int *end_of_list);
+fsal_status_t mem_getextattr_id_by_name(struct fsal_obj_handle *obj_hdl,
+					const char *xattr_name,
+					unsigned int *pxattr_id);
+fsal_status_t mem_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
+					   const char *xattr_name,
+					   caddr_t buffer_addr,
+					   size_t buffer_size,
+					   size_t *p_output_size);
+fsal_status_t mem_getextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					 unsigned int xattr_id,
+					 caddr_t buffer_addr,
+					 size_t buffer_size,
+					 size_t *p_output_size);
+fsal_status_t mem_setextattr_value(struct fsal_obj_handle *obj_hdl,
+				   const char *xattr_name,
+				   caddr_t buffer_addr, size_t buffer_size,
+				   int create);
+fsal_status_t mem_setextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					 unsigned int xattr_id,
+					 caddr_t buffer_addr,
+					 size_t buffer_size);
+fsal_status_t mem_getextattr_attrs(struct fsal_obj_handle *obj_hdl,
+				   unsigned int xattr_id,
+				   struct attrlist *p_attrs);
+fsal_status_t mem_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
+				       unsigned int xattr_id);
+fsal_status_t mem_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
+					 const char *xattr_name);
+void mem_free_xattrs(struct mem_fsal_obj_handle *hdl);
+
+void mem_handle_ops_init(struct fsal_obj_ops *ops);
+int mem_create_root(struct mem_fsal_export *export);
+void mem_free_tree(struct mem_fsal_export *export);
+
+/* Internal MEM method linkage to export object
+ */
+
+fsal_status_t mem_create_export(struct fsal_module *fsal_hdl,
+				void *parse_node,
+				struct config_error_type *err_type,
+				const struct fsal_up_vector *up_ops);
+
+#endif /* MEM_METHODS_H */
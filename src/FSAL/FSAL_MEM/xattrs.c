@@ -0,0 +1,441 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* xattrs.c
+ * MEM object (file|dir) extended attributes
+ *
+ * An object's xattrs are a list in the order they were set, under
+ * the object's mutex.  Ids are never reused while the object lives,
+ * so a listing cookie is the id of the last entry returned plus one.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "gsh_list.h"
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "mem_methods.h"
+
+static struct mem_xattr *mem_xattr_by_name(struct mem_fsal_obj_handle *hdl,
+					   const char *name)
+{
+	struct glist_head *glist;
+	struct mem_xattr *xattr;
+
+	glist_for_each(glist, &hdl->xattrs) {
+		xattr = glist_entry(glist, struct mem_xattr, list);
+		if (strcmp(xattr->name, name) == 0)
+			return xattr;
+	}
+
+	return NULL;
+}
+
+static struct mem_xattr *mem_xattr_by_id(struct mem_fsal_obj_handle *hdl,
+					 unsigned int id)
+{
+	struct glist_head *glist;
+	struct mem_xattr *xattr;
+
+	glist_for_each(glist, &hdl->xattrs) {
+		xattr = glist_entry(glist, struct mem_xattr, list);
+		if (xattr->id == id)
+			return xattr;
+	}
+
+	return NULL;
+}
+
+static void mem_xattr_free(struct mem_xattr *xattr)
+{
+	glist_del(&xattr->list);
+	gsh_free(xattr->name);
+	gsh_free(xattr->value);
+	gsh_free(xattr);
+}
+
+/**
+ * @brief Replace an xattr's value
+ *
+ * Called with the object's mutex held.
+ */
+
+static fsal_errors_t mem_xattr_set(struct mem_xattr *xattr,
+				   caddr_t buffer_addr, size_t buffer_size)
+{
+	char *value = NULL;
+
+	if (buffer_size != 0) {
+		value = gsh_malloc(buffer_size);
+		if (value == NULL)
+			return ERR_FSAL_NOMEM;
+		memcpy(value, buffer_addr, buffer_size);
+	}
+
+	gsh_free(xattr->value);
+	xattr->value = value;
+	xattr->len = buffer_size;
+
+	return ERR_FSAL_NO_ERROR;
+}
+
+/**
+ * @brief Fill in an xattr's attributes from its object's
+ *
+ * Called with the object's mutex held.
+ */
+
+static void mem_xattr_attrs(struct mem_fsal_obj_handle *hdl,
+			    struct mem_xattr *xattr,
+			    struct attrlist *xattr_attrs)
+{
+	unsigned int i;
+	unsigned long hash = xattr->id + 1;
+	char *str = (char *)&hdl->attrs.fileid;
+
+	*xattr_attrs = hdl->attrs;
+	xattr_attrs->mask &= ~(ATTR_ACL | ATTR_RAWDEV);
+	xattr_attrs->acl = NULL;
+	xattr_attrs->type = EXTENDED_ATTR;
+	xattr_attrs->mode = unix2fsal_mode(
+		op_ctx->fsal_export->exp_ops.fs_xattr_access_rights(
+			op_ctx->fsal_export));
+	xattr_attrs->numlinks = 1;
+	xattr_attrs->filesize = xattr->len;
+	xattr_attrs->spaceused = xattr->len;
+	memset(&xattr_attrs->rawdev, 0, sizeof(xattr_attrs->rawdev));
+
+	for (i = 0; i < sizeof(xattr_attrs->fileid); i++, str++)
+		hash = (hash << 5) - hash + (unsigned long)(*str);
+	xattr_attrs->fileid = hash;
+}
+
+fsal_status_t mem_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
+				 unsigned int argcookie,
+				 fsal_xattrent_t *xattrs_tab,
+				 unsigned int xattrs_tabsize,
+				 unsigned int *p_nb_returned, int *end_of_list)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct glist_head *glist;
+	struct mem_xattr *xattr;
+	unsigned int cookie = argcookie;
+	unsigned int out_index = 0;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	/* Deal with special cookie */
+	if (cookie == XATTR_RW_COOKIE)
+		cookie = 0;
+
+	mem_delay(MEM_OP_META, 0);
+
+	*end_of_list = true;
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+
+	glist_for_each(glist, &myself->xattrs) {
+		xattr = glist_entry(glist, struct mem_xattr, list);
+		if (xattr->id < cookie)
+			continue;
+
+		if (out_index == xattrs_tabsize) {
+			*end_of_list = false;
+			break;
+		}
+
+		xattrs_tab[out_index].xattr_id = xattr->id;
+		strncpy(xattrs_tab[out_index].xattr_name, xattr->name,
+			MAXNAMLEN);
+		xattrs_tab[out_index].xattr_name[MAXNAMLEN] = '\0';
+		xattrs_tab[out_index].xattr_cookie = xattr->id + 1;
+		mem_xattr_attrs(myself, xattr,
+				&xattrs_tab[out_index].attributes);
+
+		/* next output slot */
+		out_index++;
+	}
+
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	*p_nb_returned = out_index;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t mem_getextattr_id_by_name(struct fsal_obj_handle *obj_hdl,
+					const char *xattr_name,
+					unsigned int *pxattr_id)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	xattr = mem_xattr_by_name(myself, xattr_name);
+	if (xattr != NULL)
+		*pxattr_id = xattr->id;
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	if (xattr == NULL)
+		return fsalstat(ERR_FSAL_NOENT, ENOENT);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Copy out a value
+ *
+ * Called with the object's mutex held.
+ */
+
+static fsal_status_t mem_xattr_get(struct mem_xattr *xattr,
+				   caddr_t buffer_addr,
+				   size_t buffer_size,
+				   size_t *p_output_size)
+{
+	if (xattr == NULL)
+		return fsalstat(ERR_FSAL_NOENT, ENOENT);
+
+	if (xattr->len > buffer_size)
+		return fsalstat(ERR_FSAL_TOOSMALL, ERANGE);
+
+	if (xattr->len != 0)
+		memcpy(buffer_addr, xattr->value, xattr->len);
+	*p_output_size = xattr->len;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t mem_getextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					 unsigned int xattr_id,
+					 caddr_t buffer_addr,
+					 size_t buffer_size,
+					 size_t *p_output_size)
+{
+	struct mem_fsal_obj_handle *myself;
+	fsal_status_t status;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	status = mem_xattr_get(mem_xattr_by_id(myself, xattr_id),
+			       buffer_addr, buffer_size, p_output_size);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return status;
+}
+
+fsal_status_t mem_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
+					   const char *xattr_name,
+					   caddr_t buffer_addr,
+					   size_t buffer_size,
+					   size_t *p_output_size)
+{
+	struct mem_fsal_obj_handle *myself;
+	fsal_status_t status;
+
+	/* sanity checks */
+	if (!obj_hdl || !p_output_size || !buffer_addr || !xattr_name)
+		return fsalstat(ERR_FSAL_FAULT, 0);
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	status = mem_xattr_get(mem_xattr_by_name(myself, xattr_name),
+			       buffer_addr, buffer_size, p_output_size);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return status;
+}
+
+fsal_status_t mem_setextattr_value(struct fsal_obj_handle *obj_hdl,
+				   const char *xattr_name, caddr_t buffer_addr,
+				   size_t buffer_size, int create)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+	fsal_errors_t error;
+
+	if (strlen(xattr_name) > MAXNAMLEN)
+		return fsalstat(ERR_FSAL_NAMETOOLONG, 0);
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+
+	xattr = mem_xattr_by_name(myself, xattr_name);
+	if (xattr != NULL) {
+		if (create) {
+			error = ERR_FSAL_EXIST;
+			goto unlock;
+		}
+		error = mem_xattr_set(xattr, buffer_addr, buffer_size);
+		goto touch;
+	}
+
+	xattr = gsh_calloc(1, sizeof(struct mem_xattr));
+	if (xattr == NULL) {
+		error = ERR_FSAL_NOMEM;
+		goto unlock;
+	}
+
+	xattr->name = gsh_strdup(xattr_name);
+	if (xattr->name == NULL) {
+		gsh_free(xattr);
+		error = ERR_FSAL_NOMEM;
+		goto unlock;
+	}
+
+	error = mem_xattr_set(xattr, buffer_addr, buffer_size);
+	if (error != ERR_FSAL_NO_ERROR) {
+		gsh_free(xattr->name);
+		gsh_free(xattr);
+		goto unlock;
+	}
+
+	xattr->id = myself->next_xattr_id++;
+	glist_add_tail(&myself->xattrs, &xattr->list);
+
+ touch:
+	if (error == ERR_FSAL_NO_ERROR)
+		mem_touch(myself, false);
+
+ unlock:
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return fsalstat(error, 0);
+}
+
+fsal_status_t mem_setextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					 unsigned int xattr_id,
+					 caddr_t buffer_addr,
+					 size_t buffer_size)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+	fsal_errors_t error = ERR_FSAL_NOENT;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	xattr = mem_xattr_by_id(myself, xattr_id);
+	if (xattr != NULL) {
+		error = mem_xattr_set(xattr, buffer_addr, buffer_size);
+		if (error == ERR_FSAL_NO_ERROR)
+			mem_touch(myself, false);
+	}
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	return fsalstat(error, 0);
+}
+
+fsal_status_t mem_getextattr_attrs(struct fsal_obj_handle *obj_hdl,
+				   unsigned int xattr_id,
+				   struct attrlist *p_attrs)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	xattr = mem_xattr_by_id(myself, xattr_id);
+	if (xattr != NULL)
+		mem_xattr_attrs(myself, xattr, p_attrs);
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	if (xattr == NULL)
+		return fsalstat(ERR_FSAL_INVAL, 0);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t mem_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
+				       unsigned int xattr_id)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	xattr = mem_xattr_by_id(myself, xattr_id);
+	if (xattr != NULL) {
+		mem_xattr_free(xattr);
+		mem_touch(myself, false);
+	}
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	if (xattr == NULL)
+		return fsalstat(ERR_FSAL_NOENT, ENOENT);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t mem_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
+					 const char *xattr_name)
+{
+	struct mem_fsal_obj_handle *myself;
+	struct mem_xattr *xattr;
+
+	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
+
+	mem_delay(MEM_OP_META, 0);
+
+	PTHREAD_MUTEX_lock(&myself->mutex);
+	xattr = mem_xattr_by_name(myself, xattr_name);
+	if (xattr != NULL) {
+		mem_xattr_free(xattr);
+		mem_touch(myself, false);
+	}
+	PTHREAD_MUTEX_unlock(&myself->mutex);
+
+	if (xattr == NULL)
+		return fsalstat(ERR_FSAL_NOENT, ENOENT);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Free all of an object's xattrs
+ */
+
+void mem_free_xattrs(struct mem_fsal_obj_handle *hdl)
+{
+	struct glist_head *glist, *glistn;
+
+	glist_for_each_safe(glist, glistn, &hdl->xattrs)
+		mem_xattr_free(glist_entry(glist, struct mem_xattr, list));
+}
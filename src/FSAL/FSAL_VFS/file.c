@@ -195,13 +195,13 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 
 	*write_amount = nb_written;
 
-	/* attempt stability */
+	/* attempt stability, along with any other writer of the file */
 	if (fsal_stable != NULL && *fsal_stable) {
-		retval = fsync(myself->u.file.fd);
-		if (retval == -1) {
-			retval = errno;
+		retval = fsal_sync_group_sync(&myself->u.file.sync,
+					      myself->u.file.fd, offset,
+					      nb_written);
+		if (retval != 0)
 			fsal_error = posix2fsal_error(retval);
-		}
 		*fsal_stable = true;
 	}
 
@@ -215,7 +215,7 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 
 /* vfs_commit
  * Commit a file range to storage.
- * for right now, fsync will have to do.
+ * Concurrent commits and stable writes share one fdatasync.
  */
 
 fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
@@ -242,11 +242,10 @@ fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 	assert(myself->u.file.fd >= 0
 	       && myself->u.file.openflags != FSAL_O_CLOSED);
 
-	retval = fsync(myself->u.file.fd);
-	if (retval == -1) {
-		retval = errno;
+	retval = fsal_sync_group_sync(&myself->u.file.sync, myself->u.file.fd,
+				      offset, len);
+	if (retval != 0)
 		fsal_error = posix2fsal_error(retval);
-	}
 
 	PTHREAD_RWLOCK_unlock(&obj_hdl->lock);
 
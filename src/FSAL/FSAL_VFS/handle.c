@@ -94,6 +94,7 @@ static struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	if (hdl->obj_handle.type == REGULAR_FILE) {
 		hdl->u.file.fd = -1;	/* no open on this yet */
 		hdl->u.file.openflags = FSAL_O_CLOSED;
+		fsal_sync_group_init(&hdl->u.file.sync);
 	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		ssize_t retlink;
 		size_t len = stat->st_size + 1;
@@ -144,7 +145,9 @@ static struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	return hdl;
 
  spcerr:
-	if (hdl->obj_handle.type == SYMBOLIC_LINK) {
+	if (hdl->obj_handle.type == REGULAR_FILE) {
+		fsal_sync_group_destroy(&hdl->u.file.sync);
+	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		if (hdl->u.symlink.link_content != NULL)
 			gsh_free(hdl->u.symlink.link_content);
 	} else if (vfs_unopenable_type(hdl->obj_handle.type)) {
@@ -1770,7 +1773,9 @@ static void release(struct fsal_obj_handle *obj_hdl)
 
 	fsal_obj_handle_fini(obj_hdl);
 
-	if (type == SYMBOLIC_LINK) {
+	if (type == REGULAR_FILE) {
+		fsal_sync_group_destroy(&myself->u.file.sync);
+	} else if (type == SYMBOLIC_LINK) {
 		if (myself->u.symlink.link_content != NULL)
 			gsh_free(myself->u.symlink.link_content);
 	} else if (vfs_unopenable_type(type)) {
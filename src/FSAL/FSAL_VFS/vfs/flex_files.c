@@ -0,0 +1,595 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   flex_files.c
+ * @brief pNFS flex files metadata server for the VFS FSAL
+ *
+ * An export with flex_files set hands out LAYOUT4_FLEX_FILES layouts
+ * of the whole file, one data server of the VFS block's Flex_Files
+ * list per mirror, so clients read and write the data servers
+ * directly and write every mirror.
+ *
+ * The data servers are NFSv3 or NFSv4.1 servers, typically other
+ * ganesha processes, that export the same file system under the same
+ * Export_Id: they are handed this server's handle of the file.  They
+ * are loosely coupled, reached with the anonymous stateid and the
+ * credentials of the client's user the layout carries, so it grants
+ * no access the user does not have.  Files are spread over the data
+ * servers by fileid.
+ *
+ * A READ layout lists every data server that is up, for clients to
+ * read from whichever serves them best.  A RW layout has ff_mirrors
+ * data servers, which clients write every one of.
+ *
+ * A data server a client reports an I/O or transport error from, in
+ * LAYOUTERROR or a layoutreturn body, is left out of new layouts for
+ * Error_Delay seconds, so clients fall back to I/O through us.  READ latencies
+ * from LAYOUTSTATS and layoutreturn bodies set the efficiency a data
+ * server is given, which clients pick mirrors to read by.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "abstract_atomic.h"
+#include "abstract_mem.h"
+#include "fsal.h"
+#include "fsal_pnfs.h"
+#include "pnfs_utils.h"
+#include "nfs23.h"
+#include "../vfs_methods.h"
+#include "flex_files.h"
+
+/** Room for an ff_device_addr4 of one IPv4 address and version */
+#define VFS_FF_DA_ADDR_SIZE 128
+
+/** Room for an ff_layout4 of VFS_FF_MAX_MIRRORS mirrors */
+#define VFS_FF_LOC_BODY_SIZE (20 + 208 * VFS_FF_MAX_MIRRORS)
+
+/** Efficiency of a data server without READ latencies, 1 us */
+#define VFS_FF_EFFICIENCY 1000000
+
+/*================================= config ================================*/
+
+static void *ff_ds_init(void *link_mem, void *self_struct)
+{
+	struct vfs_ff_ds *ds = self_struct;
+
+	assert(link_mem != NULL || self_struct != NULL);
+
+	if (link_mem == NULL) {
+		glist_init((struct glist_head *)self_struct);
+		return self_struct;
+	} else if (self_struct == NULL) {
+		ds = gsh_calloc(1, sizeof(struct vfs_ff_ds));
+		if (ds == NULL)
+			return NULL;
+
+		glist_init(&ds->ds_list);
+		return ds;
+	} else {
+		assert(glist_empty(&ds->ds_list));
+
+		gsh_free(ds);
+		return NULL;
+	}
+}
+
+static int ff_ds_commit(void *node, void *link_mem, void *self_struct,
+			struct config_error_type *err_type)
+{
+	struct glist_head *ds_head = link_mem;
+	struct vfs_ff_ds *ds = self_struct;
+
+	if (ds->ipaddr.ss_family != AF_INET) {
+		config_proc_error(node, err_type,
+				  "Data server %u: DS_Addr must be IPv4",
+				  ds->id);
+		err_type->invalid = true;
+		return 1;
+	}
+
+	glist_add_tail(ds_head, &ds->ds_list);
+	return 0;
+}
+
+static struct config_item ff_ds_params[] = {
+	CONF_MAND_UI32("DS_Id", 1, UINT32_MAX, 1,
+		       vfs_ff_ds, id),
+	CONF_MAND_IP_ADDR("DS_Addr", "127.0.0.1",
+			  vfs_ff_ds, ipaddr),
+	CONF_ITEM_INET_PORT("DS_Port", 1, UINT16_MAX, NFS_PORT,
+			    vfs_ff_ds, ipport),
+	CONF_ITEM_UI32("DS_Version", NFS_V3, NFS_V4, NFS_V3,
+		       vfs_ff_ds, version),
+	CONF_ITEM_UI32("DS_Rsize", 4096, FSAL_MAXIOSIZE, 1048576,
+		       vfs_ff_ds, rsize),
+	CONF_ITEM_UI32("DS_Wsize", 4096, FSAL_MAXIOSIZE, 1048576,
+		       vfs_ff_ds, wsize),
+	CONFIG_EOL
+};
+
+/**
+ * @brief Init the Flex_Files block, empty when it is not given
+ */
+
+void *vfs_ff_conf_init(void *link_mem, void *self_struct)
+{
+	struct vfs_ff_param *ff = self_struct;
+
+	assert(link_mem != NULL || self_struct != NULL);
+
+	if (link_mem == NULL) {
+		glist_init(&ff->ds_list);
+		return self_struct;
+	} else if (self_struct == NULL) {
+		return link_mem;
+	} else {
+		return NULL;
+	}
+}
+
+struct config_item vfs_ff_params[] = {
+	CONF_ITEM_BLOCK("Data_Server", ff_ds_params,
+			ff_ds_init, ff_ds_commit,
+			vfs_ff_param, ds_list),
+	CONF_ITEM_UI32("Error_Delay", 0, 3600, 60,
+		       vfs_ff_param, error_delay),
+	CONF_ITEM_UI32("Stats_Interval", 0, 3600, 60,
+		       vfs_ff_param, stats_interval),
+	CONFIG_EOL
+};
+
+/*============================= data servers ==============================*/
+
+static struct vfs_ff_ds *ff_ds_lookup(struct vfs_ff_param *ff,
+				      const struct pnfs_deviceid *deviceid)
+{
+	uint32_t i;
+
+	if (deviceid->fsal_id != FSAL_ID_VFS)
+		return NULL;
+
+	for (i = 0; i < ff->ds_count; i++)
+		if (ff->ds[i]->id == deviceid->devid)
+			return ff->ds[i];
+
+	return NULL;
+}
+
+static inline bool ff_ds_up(struct vfs_ff_ds *ds, time_t now)
+{
+	return atomic_fetch_uint64_t(&ds->down_until) <= now;
+}
+
+/**
+ * @brief Reads per second at the data server's READ latency
+ */
+
+static uint32_t ff_ds_efficiency(struct vfs_ff_ds *ds)
+{
+	uint64_t usec = atomic_fetch_uint64_t(&ds->read_usec);
+
+	if (usec == 0)
+		return VFS_FF_EFFICIENCY;
+
+	return MAX(VFS_FF_EFFICIENCY / usec, 1);
+}
+
+/**
+ * @brief Take a data server a client got an error from out of layouts
+ *
+ * Only errors that say the data server cannot be reached or cannot
+ * do I/O count.  Others, such as ACCESS or PERM for credentials it
+ * does not take, or DELAY from a busy one, say nothing of its health.
+ */
+
+static void ff_ds_error(struct vfs_ff_param *ff, struct vfs_ff_ds *ds,
+			nfsstat4 status, nfs_opnum4 opnum)
+{
+	time_t now = time(NULL);
+
+	(void)atomic_inc_uint64_t(&ds->errors);
+
+	switch (status) {
+	case NFS4ERR_NXIO:
+	case NFS4ERR_IO:
+		break;
+	default:
+		LogDebug(COMPONENT_PNFS,
+			 "Data server %u failed op %d with %d, keeping it",
+			 ds->id, opnum, status);
+		return;
+	}
+
+	if (ff->error_delay == 0)
+		return;
+
+	if (ff_ds_up(ds, now))
+		LogWarn(COMPONENT_PNFS,
+			"Data server %u failed op %d with %d, leaving it out of layouts for %u seconds",
+			ds->id, opnum, status, ff->error_delay);
+
+	atomic_store_uint64_t(&ds->down_until, now + ff->error_delay);
+}
+
+/**
+ * @brief Take note of the I/O a client did to a data server
+ */
+
+static void ff_ds_stats(struct vfs_ff_ds *ds, const io_info4 *read,
+			const io_info4 *write, const ff_layoutupdate4 *update)
+{
+	const ff_io_latency4 *lat;
+	uint64_t ns, usec, avg;
+
+	(void)atomic_add_uint64_t(&ds->reads, read->ii_count);
+	(void)atomic_add_uint64_t(&ds->read_bytes, read->ii_bytes);
+	(void)atomic_add_uint64_t(&ds->writes, write->ii_count);
+	(void)atomic_add_uint64_t(&ds->write_bytes, write->ii_bytes);
+
+	if (update == NULL || update->ffl_read.ffil_ops_completed == 0)
+		return;
+
+	lat = &update->ffl_read;
+	ns = lat->ffil_aggregate_completion_time.seconds * NS_PER_SEC +
+	     lat->ffil_aggregate_completion_time.nseconds;
+	usec = ns / NS_PER_USEC / lat->ffil_ops_completed;
+	if (usec == 0)
+		usec = 1;
+
+	/* Decay by a quarter towards the new mean */
+	avg = atomic_fetch_uint64_t(&ds->read_usec);
+	avg = avg == 0 ? usec : avg - avg / 4 + usec / 4;
+	atomic_store_uint64_t(&ds->read_usec, avg);
+}
+
+/*================================= fsal ops ==============================*/
+
+static size_t ff_da_addr_size(struct fsal_module *fsal_hdl)
+{
+	return VFS_FF_DA_ADDR_SIZE;
+}
+
+static nfsstat4 ff_getdeviceinfo(struct fsal_module *fsal_hdl,
+				 XDR *da_addr_body,
+				 const layouttype4 type,
+				 const struct pnfs_deviceid *deviceid)
+{
+	struct vfs_ff_ds *ds;
+	fsal_multipath_member_t host;
+
+	if (type != LAYOUT4_FLEX_FILES) {
+		LogCrit(COMPONENT_PNFS, "Unsupported layout type: %x", type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	ds = ff_ds_lookup(vfs_ff_param(fsal_hdl), deviceid);
+	if (ds == NULL)
+		return NFS4ERR_NOENT;
+
+	host.proto = IPPROTO_TCP;
+	host.addr = ntohl(((struct sockaddr_in *)&ds->ipaddr)->sin_addr.s_addr);
+	host.port = ntohs(ds->ipport);
+
+	return FSAL_encode_ff_device_addr(da_addr_body, &host, ds->version,
+					  ds->rsize, ds->wsize);
+}
+
+static nfsstat4 ff_layouterror(struct fsal_module *fsal_hdl,
+			       const layouttype4 type,
+			       const struct pnfs_deviceid *deviceid,
+			       nfsstat4 status, nfs_opnum4 opnum)
+{
+	struct vfs_ff_param *ff = vfs_ff_param(fsal_hdl);
+	struct vfs_ff_ds *ds;
+
+	if (type != LAYOUT4_FLEX_FILES)
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+
+	ds = ff_ds_lookup(ff, deviceid);
+	if (ds == NULL)
+		return NFS4ERR_INVAL;
+
+	ff_ds_error(ff, ds, status, opnum);
+	return NFS4_OK;
+}
+
+static nfsstat4 ff_layoutstats(struct fsal_module *fsal_hdl,
+			       const layouttype4 type,
+			       const struct pnfs_deviceid *deviceid,
+			       const io_info4 *read, const io_info4 *write,
+			       XDR *lou_body)
+{
+	struct vfs_ff_ds *ds;
+	ff_layoutupdate4 update;
+	bool decoded = false;
+
+	if (type != LAYOUT4_FLEX_FILES)
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+
+	ds = ff_ds_lookup(vfs_ff_param(fsal_hdl), deviceid);
+	if (ds == NULL)
+		return NFS4ERR_INVAL;
+
+	memset(&update, 0, sizeof(update));
+	if (lou_body != NULL)
+		decoded = xdr_ff_layoutupdate4(lou_body, &update);
+
+	ff_ds_stats(ds, read, write, decoded ? &update : NULL);
+
+	if (lou_body != NULL)
+		xdr_free((xdrproc_t) xdr_ff_layoutupdate4, &update);
+
+	return NFS4_OK;
+}
+
+/*=============================== export ops ==============================*/
+
+static void ff_layouttypes(struct fsal_export *exp_hdl, int32_t *count,
+			   const layouttype4 **types)
+{
+	static const layouttype4 supported_layout_type = LAYOUT4_FLEX_FILES;
+
+	*types = &supported_layout_type;
+	*count = 1;
+}
+
+/**
+ * @brief The smallest WRITE every data server takes
+ */
+
+static uint32_t ff_layout_blocksize(struct fsal_export *exp_hdl)
+{
+	struct vfs_ff_param *ff = vfs_ff_param(exp_hdl->fsal);
+	uint32_t i, size = UINT32_MAX;
+
+	for (i = 0; i < ff->ds_count; i++)
+		size = MIN(size, ff->ds[i]->wsize);
+
+	return size;
+}
+
+static uint32_t ff_maximum_segments(struct fsal_export *exp_hdl)
+{
+	return 1;
+}
+
+static size_t ff_loc_body_size(struct fsal_export *exp_hdl)
+{
+	return VFS_FF_LOC_BODY_SIZE;
+}
+
+/*=============================== handle ops ==============================*/
+
+/**
+ * @brief Grant a layout of the whole file
+ *
+ * The data servers that are up are taken in turn from one picked by
+ * fileid: ff_mirrors of them for a RW layout, as many as a layout
+ * holds for a READ layout, which clients read a single mirror of.
+ * The Linux client ignores layouts of less than the file, so the
+ * whole file is always granted.
+ */
+
+static nfsstat4 ff_layoutget(struct fsal_obj_handle *obj_hdl,
+			     struct req_op_context *req_ctx, XDR *loc_body,
+			     const struct fsal_layoutget_arg *arg,
+			     struct fsal_layoutget_res *res)
+{
+	struct vfs_fsal_export *export =
+		EXPORT_VFS_FROM_FSAL(req_ctx->fsal_export);
+	struct vfs_ff_param *ff = vfs_ff_param(obj_hdl->fsal);
+	fsal_ff_mirror_t mirrors[VFS_FF_MAX_MIRRORS];
+	struct vfs_ff_ds *ds;
+	time_t now = time(NULL);
+	uint32_t i, first, want, n = 0;
+	bool rw = res->segment.io_mode != LAYOUTIOMODE4_READ;
+	nfsstat4 nfs_status;
+
+	if (arg->type != LAYOUT4_FLEX_FILES) {
+		LogDebug(COMPONENT_PNFS, "Unsupported layout type: %x",
+			 arg->type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	want = rw ? export->ff_mirrors : VFS_FF_MAX_MIRRORS;
+
+	first = obj_hdl->attrs->fileid % ff->ds_count;
+
+	for (i = 0; i < ff->ds_count && n < want; i++) {
+		ds = ff->ds[(first + i) % ff->ds_count];
+		if (!ff_ds_up(ds, now))
+			continue;
+
+		memset(&mirrors[n].deviceid, 0, sizeof(mirrors[n].deviceid));
+		mirrors[n].deviceid.fsal_id = FSAL_ID_VFS;
+		mirrors[n].deviceid.devid = ds->id;
+		mirrors[n].efficiency = ff_ds_efficiency(ds);
+		mirrors[n].version = ds->version;
+		n++;
+	}
+
+	if (n == 0) {
+		LogDebug(COMPONENT_PNFS, "No data server is up");
+		return NFS4ERR_LAYOUTUNAVAILABLE;
+	}
+
+	nfs_status = FSAL_encode_flex_file_layout(loc_body, obj_hdl, 0,
+						  n, mirrors,
+						  req_ctx->creds->caller_uid,
+						  req_ctx->creds->caller_gid,
+						  0, ff->stats_interval);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	res->segment.offset = 0;
+	res->segment.length = NFS4_UINT64_MAX;
+	res->return_on_close = false;
+	res->last_segment = true;
+
+	LogFullDebug(COMPONENT_PNFS,
+		     "Granted %u mirrors from data server %u, iomode %d",
+		     n, ff->ds[first]->id, res->segment.io_mode);
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Take in the errors and statistics of a layoutreturn body
+ */
+
+static nfsstat4 ff_layoutreturn(struct fsal_obj_handle *obj_hdl,
+				struct req_op_context *req_ctx,
+				XDR *lrf_body,
+				const struct fsal_layoutreturn_arg *arg)
+{
+	struct vfs_ff_param *ff = vfs_ff_param(obj_hdl->fsal);
+	ff_layoutreturn4 lr;
+	ff_ioerr4 *ioerr;
+	ff_iostats4 *iostats;
+	device_error4 *error;
+	struct vfs_ff_ds *ds;
+	u_int i, j;
+
+	if (lrf_body == NULL || arg->lo_type != LAYOUT4_FLEX_FILES)
+		return NFS4_OK;
+
+	memset(&lr, 0, sizeof(lr));
+	if (!xdr_ff_layoutreturn4(lrf_body, &lr)) {
+		LogDebug(COMPONENT_PNFS, "Could not decode ff_layoutreturn4");
+		goto out;
+	}
+
+	for (i = 0; i < lr.fflr_ioerr_report.fflr_ioerr_report_len; i++) {
+		ioerr = &lr.fflr_ioerr_report.fflr_ioerr_report_val[i];
+		for (j = 0; j < ioerr->ffie_errors.ffie_errors_len; j++) {
+			error = &ioerr->ffie_errors.ffie_errors_val[j];
+			ds = ff_ds_lookup(ff,
+				(struct pnfs_deviceid *)error->de_deviceid);
+			if (ds != NULL)
+				ff_ds_error(ff, ds, error->de_status,
+					    error->de_opnum);
+		}
+	}
+
+	for (i = 0; i < lr.fflr_iostats_report.fflr_iostats_report_len;
+	     i++) {
+		iostats = &lr.fflr_iostats_report.fflr_iostats_report_val[i];
+		ds = ff_ds_lookup(ff,
+			(struct pnfs_deviceid *)iostats->ffis_deviceid);
+		if (ds != NULL)
+			ff_ds_stats(ds, &iostats->ffis_read,
+				    &iostats->ffis_write,
+				    &iostats->ffis_layoutupdate);
+	}
+
+ out:
+	xdr_free((xdrproc_t) xdr_ff_layoutreturn4, &lr);
+	return NFS4_OK;
+}
+
+/**
+ * @brief Nothing to commit
+ *
+ * The data servers wrote the file system we export; the protocol
+ * layer refreshes the attributes when the client says the file grew
+ * or changed.
+ */
+
+static nfsstat4 ff_layoutcommit(struct fsal_obj_handle *obj_hdl,
+				struct req_op_context *req_ctx,
+				XDR *lou_body,
+				const struct fsal_layoutcommit_arg *arg,
+				struct fsal_layoutcommit_res *res)
+{
+	res->size_supplied = false;
+	res->commit_done = true;
+	return NFS4_OK;
+}
+
+/*============================ initialization =============================*/
+
+/**
+ * @brief Index the data servers and take up the module's pNFS ops
+ *
+ * @param[in] fsal_hdl The VFS module, its config loaded
+ *
+ * @return 0, or an errno.
+ */
+
+int vfs_ff_init(struct fsal_module *fsal_hdl)
+{
+	struct vfs_ff_param *ff = vfs_ff_param(fsal_hdl);
+	struct glist_head *glist;
+	uint32_t i, j;
+
+	ff->ds_count = glist_length(&ff->ds_list);
+	if (ff->ds_count == 0)
+		return 0;
+
+	ff->ds = gsh_calloc(ff->ds_count, sizeof(*ff->ds));
+	if (ff->ds == NULL)
+		return ENOMEM;
+
+	i = 0;
+	glist_for_each(glist, &ff->ds_list)
+		ff->ds[i++] = glist_entry(glist, struct vfs_ff_ds, ds_list);
+
+	for (i = 0; i < ff->ds_count; i++)
+		for (j = i + 1; j < ff->ds_count; j++)
+			if (ff->ds[i]->id == ff->ds[j]->id) {
+				LogCrit(COMPONENT_PNFS,
+					"Duplicate flex files DS_Id %u",
+					ff->ds[i]->id);
+				gsh_free(ff->ds);
+				ff->ds = NULL;
+				ff->ds_count = 0;
+				return EINVAL;
+			}
+
+	fsal_hdl->m_ops.getdeviceinfo = ff_getdeviceinfo;
+	fsal_hdl->m_ops.fs_da_addr_size = ff_da_addr_size;
+	fsal_hdl->m_ops.layouterror = ff_layouterror;
+	fsal_hdl->m_ops.layoutstats = ff_layoutstats;
+
+	LogInfo(COMPONENT_PNFS, "Flex files layouts over %u data servers",
+		ff->ds_count);
+	return 0;
+}
+
+void vfs_ff_export_ops(struct export_ops *ops)
+{
+	ops->fs_layouttypes = ff_layouttypes;
+	ops->fs_layout_blocksize = ff_layout_blocksize;
+	ops->fs_maximum_segments = ff_maximum_segments;
+	ops->fs_loc_body_size = ff_loc_body_size;
+}
+
+void vfs_ff_handle_ops(struct fsal_obj_ops *ops)
+{
+	ops->layoutget = ff_layoutget;
+	ops->layoutreturn = ff_layoutreturn;
+	ops->layoutcommit = ff_layoutcommit;
+}
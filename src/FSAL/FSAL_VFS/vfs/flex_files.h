@@ -0,0 +1,80 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   flex_files.h
+ * @brief Declare flex_files.c externals
+ */
+
+#ifndef VFS_FLEX_FILES_H
+#define VFS_FLEX_FILES_H
+
+#include "gsh_list.h"
+#include "gsh_rpc.h"
+#include "fsal_api.h"
+#include "config_parsing.h"
+
+/** Most mirrors a layout is given */
+#define VFS_FF_MAX_MIRRORS 8
+
+/**
+ * @brief A data server flex files layouts send clients to
+ */
+
+struct vfs_ff_ds {
+	struct glist_head ds_list;	/*< Link in the Data_Server list */
+	sockaddr_t ipaddr;		/*< DS_Addr */
+	uint16_t ipport;		/*< DS_Port, network byte order */
+	uint32_t id;			/*< DS_Id */
+	uint32_t version;		/*< DS_Version */
+	uint32_t rsize;			/*< DS_Rsize */
+	uint32_t wsize;			/*< DS_Wsize */
+	/* What clients report of it */
+	uint64_t errors;
+	uint64_t reads, read_bytes;
+	uint64_t writes, write_bytes;
+	uint64_t read_usec;		/*< Decayed mean READ latency */
+	uint64_t down_until;		/*< Not handed out before this */
+};
+
+/**
+ * @brief The Flex_Files block of the VFS block
+ */
+
+struct vfs_ff_param {
+	struct glist_head ds_list;	/*< Data_Server blocks */
+	uint32_t error_delay;		/*< Error_Delay */
+	uint32_t stats_interval;	/*< Stats_Interval */
+	uint32_t ds_count;		/*< Length of ds_list */
+	struct vfs_ff_ds **ds;		/*< ds_list, as an array */
+};
+
+extern struct config_item vfs_ff_params[];
+void *vfs_ff_conf_init(void *link_mem, void *self_struct);
+
+/* in vfs/main.c */
+struct vfs_ff_param *vfs_ff_param(struct fsal_module *fsal_hdl);
+
+int vfs_ff_init(struct fsal_module *fsal_hdl);
+void vfs_ff_export_ops(struct export_ops *ops);
+void vfs_ff_handle_ops(struct fsal_obj_ops *ops);
+
+#endif /* VFS_FLEX_FILES_H */
@@ -38,7 +38,9 @@
 #include <sys/types.h>
 #include "gsh_list.h"
 #include "fsal.h"
+#include "fsal_convert.h"
 #include "FSAL/fsal_init.h"
+#include "flex_files.h"
 
 /* VFS FSAL module private storage
  */
@@ -55,6 +57,7 @@
 struct vfs_fsal_module {
 	struct fsal_module fsal;
 	struct fsal_staticfsinfo_t fs_info;
+	struct vfs_ff_param ff;
 	/* vfsfs_specific_initinfo_t specific_info;  placeholder */
 };
 
@@ -86,21 +89,24 @@ static struct fsal_staticfsinfo_t default_posix_info = {
 
 static struct config_item vfs_params[] = {
 	CONF_ITEM_BOOL("link_support", true,
-		       fsal_staticfsinfo_t, link_support),
+		       vfs_fsal_module, fs_info.link_support),
 	CONF_ITEM_BOOL("symlink_support", true,
-		       fsal_staticfsinfo_t, symlink_support),
+		       vfs_fsal_module, fs_info.symlink_support),
 	CONF_ITEM_BOOL("cansettime", true,
-		       fsal_staticfsinfo_t, cansettime),
+		       vfs_fsal_module, fs_info.cansettime),
 	CONF_ITEM_UI64("maxread", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxread),
+		       vfs_fsal_module, fs_info.maxread),
 	CONF_ITEM_UI64("maxwrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxwrite),
+		       vfs_fsal_module, fs_info.maxwrite),
 	CONF_ITEM_MODE("umask", 0,
-		       fsal_staticfsinfo_t, umask),
+		       vfs_fsal_module, fs_info.umask),
 	CONF_ITEM_BOOL("auth_xdev_export", false,
-		       fsal_staticfsinfo_t, auth_exportpath_xdev),
+		       vfs_fsal_module, fs_info.auth_exportpath_xdev),
 	CONF_ITEM_MODE("xattr_access_rights", 0400,
-		       fsal_staticfsinfo_t, xattr_access_rights),
+		       vfs_fsal_module, fs_info.xattr_access_rights),
+	CONF_ITEM_BLOCK("Flex_Files", vfs_ff_params,
+			vfs_ff_conf_init, noop_conf_commit,
+			vfs_fsal_module, ff),
 	CONFIG_EOL
 };
 
@@ -124,6 +130,14 @@ struct fsal_staticfsinfo_t *vfs_staticinfo(struct fsal_module *hdl)
 	return &myself->fs_info;
 }
 
+struct vfs_ff_param *vfs_ff_param(struct fsal_module *hdl)
+{
+	struct vfs_fsal_module *myself;
+
+	myself = container_of(hdl, struct vfs_fsal_module, fsal);
+	return &myself->ff;
+}
+
 /* Module methods
  */
 
@@ -137,15 +151,21 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 {
 	struct vfs_fsal_module *vfs_me =
 	    container_of(fsal_hdl, struct vfs_fsal_module, fsal);
+	int retval;
 
 	vfs_me->fs_info = default_posix_info;	/* copy the consts */
 	(void) load_config_from_parse(config_struct,
 				      &vfs_param,
-				      &vfs_me->fs_info,
+				      vfs_me,
 				      true,
 				      err_type);
 	if (!config_error_is_harmless(err_type))
 		return fsalstat(ERR_FSAL_INVAL, 0);
+	retval = vfs_ff_init(fsal_hdl);
+	if (retval != 0)
+		return fsalstat(posix2fsal_error(retval), retval);
+	if (vfs_me->ff.ds_count > 0)
+		vfs_me->fs_info.pnfs_mds = true;
 	display_fsinfo(&vfs_me->fs_info);
 	LogFullDebug(COMPONENT_FSAL,
 		     "Supported attributes constant = 0x%" PRIx64,
@@ -32,6 +32,7 @@
 #include "fsal_api.h"
 #include "../vfs_methods.h"
 #include "../subfsal.h"
+#include "flex_files.h"
 #ifdef ENABLE_VFS_DEBUG_ACL
 #include "attrs.h"
 #endif /* ENABLE_VFS_DEBUG_ACL */
@@ -55,6 +56,10 @@ static struct config_item export_params[] = {
 	CONF_ITEM_ENUM("fsid_type", -1,
 		       fsid_types,
 		       vfs_fsal_export, fsid_type),
+	CONF_ITEM_BOOL("flex_files", false,
+		       vfs_fsal_export, ff_enabled),
+	CONF_ITEM_UI32("ff_mirrors", 1, VFS_FF_MAX_MIRRORS, 1,
+		       vfs_fsal_export, ff_mirrors),
 	CONFIG_EOL
 };
 
@@ -78,10 +83,22 @@ void vfs_sub_fini(struct vfs_fsal_export *myself)
 void vfs_sub_init_export_ops(struct vfs_fsal_export *myself,
 			      const char *export_path)
 {
+	if (myself->ff_enabled) {
+		LogInfo(COMPONENT_FSAL,
+			"flex files layouts enabled for [%s]",
+			export_path);
+		vfs_ff_export_ops(&myself->export.exp_ops);
+	}
 }
 
 int vfs_sub_init_export(struct vfs_fsal_export *myself)
 {
+	if (myself->ff_enabled &&
+	    vfs_ff_param(myself->export.fsal)->ds_count == 0) {
+		LogCrit(COMPONENT_FSAL,
+			"flex_files set but VFS has no Flex_Files Data_Server");
+		return EINVAL;
+	}
 #ifdef ENABLE_VFS_DEBUG_ACL
 	vfs_acl_init();
 #endif /* ENABLE_VFS_DEBUG_ACL */
@@ -115,5 +132,7 @@ int vfs_sub_init_handle(struct vfs_fsal_export *myself,
 		const char *path)
 {
 	hdl->sub_ops = &vfs_obj_subops;
+	if (myself->ff_enabled)
+		vfs_ff_handle_ops(&hdl->obj_handle.obj_ops);
 	return 0;
 }
@@ -30,6 +30,7 @@
 
 #include "fsal_handle_syscalls.h"
 #include "fsal_api.h"
+#include "FSAL/fsal_commonlib.h"
 
 struct vfs_fsal_obj_handle;
 struct vfs_fsal_export;
@@ -43,6 +44,8 @@ struct vfs_fsal_export {
 	struct fsal_filesystem *root_fs;
 	struct glist_head filesystems;
 	int fsid_type;
+	bool ff_enabled;	/*< Hand out flex files layouts */
+	uint32_t ff_mirrors;	/*< Mirrors per flex files layout */
 };
 
 #define EXPORT_VFS_FROM_FSAL(fsal) \
@@ -138,6 +141,7 @@ struct vfs_fsal_obj_handle {
 		struct {
 			int fd;
 			fsal_openflags_t openflags;
+			struct fsal_sync_group sync;
 		} file;
 		struct {
 			unsigned char *link_content;
@@ -0,0 +1,258 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* BCACHE methods for handles
+ */
+
+#ifndef BCACHE_METHODS_H
+#define BCACHE_METHODS_H
+
+#include "avltree.h"
+#include "gsh_list.h"
+
+/** Partitions of the handle table the upcalls look keys up in */
+#define BCACHE_HANDLE_PARTITIONS 127
+
+/**
+ * @brief Parameters of the BCACHE config block
+ */
+
+struct bcache_params {
+	uint32_t block_size;		/*< Bytes in a block */
+	uint64_t max_ram;		/*< Bytes of blocks kept in memory */
+	uint64_t max_dirty;		/*< Bytes of dirty blocks */
+	char *disk_dir;			/*< Directory of the disk tier */
+	uint64_t max_disk;		/*< Bytes of blocks kept on disk */
+	bool write_back;		/*< Keep writes until COMMIT */
+	uint32_t negative_ttl;		/*< Seconds, 0 off */
+	uint32_t negative_max;		/*< Names per directory */
+};
+
+struct bcache_partition {
+	pthread_mutex_t mutex;
+	struct glist_head handles;
+	struct glist_head lost;		/*< Files whose writes were dropped */
+};
+
+struct bcache_fsal_module {
+	struct fsal_module fsal;
+	struct fsal_staticfsinfo_t fs_info;
+	struct bcache_params params;
+	struct fsal_up_vector up_ops;	/*< Passed to the sub FSALs */
+	struct bcache_partition handles[BCACHE_HANDLE_PARTITIONS];
+	pthread_mutex_t lru_mutex;	/*< Protects what follows */
+	struct glist_head ram_lru;	/*< Clean blocks in memory, MRU first */
+	struct glist_head disk_lru;	/*< Blocks on disk, MRU first */
+	uint64_t ram_bytes;		/*< Of all blocks in memory */
+	uint64_t dirty_bytes;		/*< Of the dirty ones */
+	int disk_fd;			/*< -1 without a disk tier */
+	uint32_t *free_slots;		/*< Unused blocks of the disk file */
+	uint32_t nfree;
+};
+
+extern struct bcache_fsal_module BCACHE;
+
+struct next_ops {
+	struct export_ops exp_ops;	/*< Vector of operations */
+	struct fsal_obj_ops obj_ops;	/*< Shared handle methods vector */
+	struct fsal_dsh_ops dsh_ops;	/*< Shared handle methods vector */
+	const struct fsal_up_vector *up_ops;	/*< Upcall operations */
+};
+
+/**
+ * Structure used to store data for read_dirents callback.
+ *
+ * Before executing the upper level callback (it might be another
+ * stackable fsal or the inode cache), the context has to be restored.
+ */
+struct bcache_readdir_state {
+	fsal_readdir_cb cb; /*< Callback to the upper layer. */
+	struct bcache_fsal_export *exp; /*< Export of the current BCACHE. */
+	void *dir_state; /*< State to be sent to the next callback. */
+};
+
+extern struct next_ops next_ops;
+void bcache_handle_ops_init(struct fsal_obj_ops *ops);
+
+/*
+ * BCACHE internal export
+ */
+struct bcache_fsal_export {
+	struct fsal_export export;
+	struct fsal_export *sub_export;
+};
+
+fsal_status_t bcache_lookup_path(struct fsal_export *exp_hdl,
+				 const char *path,
+				 struct fsal_obj_handle **handle);
+
+fsal_status_t bcache_create_handle(struct fsal_export *exp_hdl,
+				   struct gsh_buffdesc *hdl_desc,
+				   struct fsal_obj_handle **handle);
+
+/*
+ * BCACHE internal object handle
+ *
+ * It contains a pointer to the fsal_obj_handle used by the subfsal,
+ * and the blocks of a file or the names a directory does not have.
+ */
+
+struct bcache_fsal_obj_handle {
+	struct fsal_obj_handle obj_handle; /*< Handle containing BCACHE data.*/
+	struct fsal_obj_handle *sub_handle; /*< Handle of the sub fsal.*/
+	struct glist_head partition;	/*< In BCACHE.handles, by key */
+	struct gsh_buffdesc key;	/*< The sub FSAL's key */
+	fsal_openflags_t openflags;	/*< As the caller opened it */
+	pthread_mutex_t mutex;		/*< Protects what follows */
+	struct avltree blocks;		/*< Cached blocks, by index */
+	uint32_t ndirty;		/*< Blocks not written back */
+	uint64_t dirty_size;		/*< File size with the dirty blocks */
+	uint64_t change;		/*< Change attribute blocks match */
+	bool own_change;		/*< Change since moved by our writes */
+	uint64_t gen;			/*< Bumped when the blocks go stale */
+	fsal_errors_t flush_error;	/*< Of the last write back failed */
+	fsal_errors_t lost;		/*< Writes dropped, for COMMIT */
+	struct glist_head negatives;	/*< Names known not to exist */
+	uint32_t nnegatives;
+};
+
+/**
+ * @brief A block of a file's data
+ *
+ * A block in memory has data, one on disk only its slot in the disk
+ * file.  Dirty blocks are always in memory and on no LRU.  A block
+ * shorter than Block_Size ends the file.
+ */
+
+struct bcache_block {
+	struct avltree_node node;	/*< In the blocks of the file */
+	struct glist_head lru;		/*< In ram_lru or disk_lru */
+	struct bcache_fsal_obj_handle *hdl;
+	uint64_t index;			/*< Offset over Block_Size */
+	uint32_t len;			/*< Bytes of the file in it */
+	uint32_t dirty_start;		/*< Bytes not written back, */
+	uint32_t dirty_end;		/*< empty if start == end */
+	bool eof;			/*< The file ends in this block */
+	char *data;			/*< NULL once on disk */
+	uint32_t slot;			/*< Block of the disk file */
+};
+
+static inline bool bcache_dirty(struct bcache_block *blk)
+{
+	return blk->dirty_start != blk->dirty_end;
+}
+
+/* The block cache */
+int bcache_cache_init(void);
+void bcache_cache_fini(void);
+void bcache_handle_init(struct bcache_fsal_obj_handle *hdl);
+void bcache_handle_fini(struct bcache_fsal_obj_handle *hdl);
+fsal_status_t bcache_lost_writes(struct bcache_fsal_obj_handle *hdl);
+fsal_status_t bcache_cache_read(struct bcache_fsal_export *export,
+				struct bcache_fsal_obj_handle *hdl,
+				uint64_t offset, size_t size, void *buffer,
+				size_t *read_amount, bool *end_of_file);
+fsal_status_t bcache_cache_write(struct bcache_fsal_export *export,
+				 struct bcache_fsal_obj_handle *hdl,
+				 uint64_t offset, size_t size, void *buffer);
+void bcache_cache_update(struct bcache_fsal_obj_handle *hdl,
+			 uint64_t offset, size_t size, void *buffer);
+fsal_status_t bcache_flush(struct bcache_fsal_export *export,
+			   struct bcache_fsal_obj_handle *hdl);
+void bcache_drop_blocks(struct bcache_fsal_obj_handle *hdl);
+void bcache_attrs_fixup(struct bcache_fsal_obj_handle *hdl);
+bool bcache_negative_lookup(struct bcache_fsal_obj_handle *dir,
+			    const char *name);
+void bcache_negative_add(struct bcache_fsal_obj_handle *dir,
+			 const char *name, uint64_t gen);
+void bcache_negative_remove(struct bcache_fsal_obj_handle *dir,
+			    const char *name);
+uint64_t bcache_gen(struct bcache_fsal_obj_handle *hdl);
+void bcache_up_ops_init(void);
+
+	/* I/O management */
+fsal_status_t bcache_open(struct fsal_obj_handle *obj_hdl,
+			  fsal_openflags_t openflags);
+fsal_openflags_t bcache_status(struct fsal_obj_handle *obj_hdl);
+fsal_status_t bcache_read(struct fsal_obj_handle *obj_hdl,
+			  uint64_t offset,
+			  size_t buffer_size, void *buffer,
+			  size_t *read_amount, bool *end_of_file);
+fsal_status_t bcache_write(struct fsal_obj_handle *obj_hdl,
+			   uint64_t offset,
+			   size_t buffer_size, void *buffer,
+			   size_t *write_amount, bool *fsal_stable);
+fsal_status_t bcache_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			    off_t offset, size_t len);
+fsal_status_t bcache_lock_op(struct fsal_obj_handle *obj_hdl,
+			     void *p_owner,
+			     fsal_lock_op_t lock_op,
+			     fsal_lock_param_t *request_lock,
+			     fsal_lock_param_t *conflicting_lock);
+fsal_status_t bcache_close(struct fsal_obj_handle *obj_hdl);
+fsal_status_t bcache_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+				 lru_actions_t requests);
+
+/* extended attributes management */
+fsal_status_t bcache_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
+				    unsigned int cookie,
+				    fsal_xattrent_t *xattrs_tab,
+				    unsigned int xattrs_tabsize,
+				    unsigned int *p_nb_returned,
+				    int *end_of_list);
+fsal_status_t bcache_getextattr_id_by_name(struct fsal_obj_handle *obj_hdl,
+					   const char *xattr_name,
+					   unsigned int *pxattr_id);
+fsal_status_t bcache_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
+					      const char *xattr_name,
+					      caddr_t buffer_addr,
+					      size_t buffer_size,
+					      size_t *p_output_size);
+fsal_status_t bcache_getextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					    unsigned int xattr_id,
+					    caddr_t buffer_addr,
+					    size_t buffer_size,
+					    size_t *p_output_size);
+fsal_status_t bcache_setextattr_value(struct fsal_obj_handle *obj_hdl,
+				      const char *xattr_name,
+				      caddr_t buffer_addr, size_t buffer_size,
+				      int create);
+fsal_status_t bcache_setextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					    unsigned int xattr_id,
+					    caddr_t buffer_addr,
+					    size_t buffer_size);
+fsal_status_t bcache_getextattr_attrs(struct fsal_obj_handle *obj_hdl,
+				      unsigned int xattr_id,
+				      struct attrlist *p_attrs);
+fsal_status_t bcache_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
+					  unsigned int xattr_id);
+fsal_status_t bcache_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
+					    const char *xattr_name);
+
+/* Internal BCACHE method linkage to export object
+ */
+
+fsal_status_t bcache_create_export(struct fsal_module *fsal_hdl,
+				   void *parse_node,
+				   struct config_error_type *err_type,
+				   const struct fsal_up_vector *up_ops);
+
+#endif /* BCACHE_METHODS_H */
@@ -0,0 +1,1312 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* cache.c
+ * The block cache of BCACHE
+ *
+ * File data is cached in blocks of Block_Size bytes, each file's in an
+ * AVL tree by index.  Clean blocks in memory share one LRU; past
+ * Max_RAM bytes the least recently used are moved to the file in
+ * Disk_Dir, if there is one, or dropped.  Blocks on disk have an LRU
+ * of their own, bounded by Max_Disk, and are read back into memory
+ * when used.
+ *
+ * Writes go through to the sub FSAL and update the blocks cached.
+ * With Write_Back they are only copied into the blocks, which are
+ * written to the sub FSAL on COMMIT, close, a size change, and when
+ * the dirty blocks of all files pass Max_Dirty.  Those writes are
+ * replied to as unstable, so clients keep their data until a COMMIT
+ * succeeds, as they would with any server.  Blocks that cannot be
+ * written back stay dirty, and the sub FSAL's file stays open, until
+ * the handle is released.  If they are dropped then, the file is
+ * remembered and the next COMMIT on it fails.
+ *
+ * A file's clean blocks are dropped when its change attribute moves
+ * other than by our own writes, and on an upcall from the sub FSAL
+ * about it.  The same drops the names a directory is known not to
+ * have.  Each of these bumps a generation number of the handle, so a
+ * block read from the sub FSAL while it happened is not kept.
+ *
+ * Locking: the mutex of a handle protects its blocks and names, and
+ * is dropped while reading a block, not while writing blocks back.
+ * BCACHE.lru_mutex nests inside it.  Evicting the block of another
+ * file only ever trylocks its mutex.  The mutex of a partition of the
+ * handle table is taken before the mutex of a handle.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "abstract_atomic.h"
+#include "city.h"
+#include "bcache_methods.h"
+
+/**
+ * @brief A name a directory does not have
+ */
+
+struct bcache_negative {
+	struct glist_head list;		/*< In negatives, newest first */
+	time_t expires;
+	char name[];
+};
+
+/**
+ * @brief A file whose dirty blocks were dropped
+ *
+ * Kept in the partition of its key until a handle is made for the
+ * file again, which takes the error over for its next COMMIT.
+ */
+
+struct bcache_lost {
+	struct glist_head list;		/*< In the partition's lost */
+	fsal_errors_t error;
+	struct gsh_buffdesc key;
+	char addr[];
+};
+
+static int bcache_block_cmpf(const struct avltree_node *lhs,
+			     const struct avltree_node *rhs)
+{
+	struct bcache_block *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct bcache_block, node);
+	rk = avltree_container_of(rhs, struct bcache_block, node);
+
+	if (lk->index < rk->index)
+		return -1;
+
+	return lk->index > rk->index;
+}
+
+static struct bcache_partition *bcache_partition(struct gsh_buffdesc *key)
+{
+	uint64_t hash = CityHash64WithSeed(key->addr, key->len, 557);
+
+	return &BCACHE.handles[hash % BCACHE_HANDLE_PARTITIONS];
+}
+
+/**
+ * @brief Set up the disk tier
+ *
+ * The disk file is unlinked as soon as it is made, so nothing is
+ * left behind however the server stops.
+ *
+ * @return 0 or an errno.
+ */
+
+int bcache_cache_init(void)
+{
+	struct bcache_params *params = &BCACHE.params;
+	uint64_t nslots = params->max_disk / params->block_size;
+	char *path;
+	uint32_t i;
+	int fd, rc;
+
+	if (params->disk_dir == NULL || BCACHE.disk_fd >= 0)
+		return 0;
+
+	if (nslots == 0) {
+		LogWarn(COMPONENT_FSAL,
+			"BCACHE Max_Disk is less than a block, not using %s",
+			params->disk_dir);
+		return 0;
+	}
+	nslots = MIN(nslots, UINT32_MAX);
+
+	path = gsh_malloc(strlen(params->disk_dir) + sizeof("/bcache.XXXXXX"));
+	if (path == NULL)
+		return ENOMEM;
+	sprintf(path, "%s/bcache.XXXXXX", params->disk_dir);
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		rc = errno;
+		LogCrit(COMPONENT_FSAL,
+			"Could not create the BCACHE disk file %s: %s",
+			path, strerror(rc));
+		gsh_free(path);
+		return rc;
+	}
+	(void) unlink(path);
+	gsh_free(path);
+
+	BCACHE.free_slots = gsh_malloc(nslots * sizeof(uint32_t));
+	if (BCACHE.free_slots == NULL) {
+		close(fd);
+		return ENOMEM;
+	}
+
+	/* Hand out the start of the file first */
+	for (i = 0; i < nslots; i++)
+		BCACHE.free_slots[i] = nslots - 1 - i;
+	BCACHE.nfree = nslots;
+	BCACHE.disk_fd = fd;
+
+	LogInfo(COMPONENT_FSAL,
+		"BCACHE keeps up to %" PRIu64 " blocks in %s",
+		nslots, params->disk_dir);
+
+	return 0;
+}
+
+void bcache_cache_fini(void)
+{
+	struct bcache_lost *lost;
+	int i;
+
+	for (i = 0; i < BCACHE_HANDLE_PARTITIONS; i++) {
+		while ((lost = glist_first_entry(&BCACHE.handles[i].lost,
+						 struct bcache_lost,
+						 list)) != NULL) {
+			glist_del(&lost->list);
+			gsh_free(lost);
+		}
+	}
+
+	if (BCACHE.disk_fd >= 0) {
+		close(BCACHE.disk_fd);
+		BCACHE.disk_fd = -1;
+	}
+	gsh_free(BCACHE.free_slots);
+	BCACHE.free_slots = NULL;
+	BCACHE.nfree = 0;
+}
+
+static struct bcache_block *bcache_block_lookup(
+		struct bcache_fsal_obj_handle *hdl, uint64_t index)
+{
+	struct bcache_block key;
+	struct avltree_node *node;
+
+	key.index = index;
+	node = avltree_lookup(&key.node, &hdl->blocks);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct bcache_block, node);
+}
+
+/**
+ * @brief Add a clean block in memory to a file
+ *
+ * Called with the handle's mutex held.
+ *
+ * @return The block, or NULL if out of memory, with data not taken.
+ */
+
+static struct bcache_block *bcache_block_insert(
+		struct bcache_fsal_obj_handle *hdl, uint64_t index,
+		char *data, uint32_t len, bool eof)
+{
+	struct bcache_block *blk;
+
+	blk = gsh_calloc(1, sizeof(struct bcache_block));
+	if (blk == NULL)
+		return NULL;
+
+	blk->hdl = hdl;
+	blk->index = index;
+	blk->len = len;
+	blk->eof = eof;
+	blk->data = data;
+	avltree_insert(&blk->node, &hdl->blocks);
+
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	BCACHE.ram_bytes += BCACHE.params.block_size;
+	glist_add(&BCACHE.ram_lru, &blk->lru);
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+	return blk;
+}
+
+/**
+ * @brief Drop a block, dirty or not
+ *
+ * Called with the handle's mutex held.
+ */
+
+static void bcache_block_free(struct bcache_fsal_obj_handle *hdl,
+			      struct bcache_block *blk)
+{
+	uint32_t bs = BCACHE.params.block_size;
+
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	if (!glist_null(&blk->lru))
+		glist_del(&blk->lru);
+	if (blk->data != NULL)
+		BCACHE.ram_bytes -= bs;
+	else
+		BCACHE.free_slots[BCACHE.nfree++] = blk->slot;
+	if (bcache_dirty(blk)) {
+		BCACHE.dirty_bytes -= bs;
+		hdl->ndirty--;
+	}
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+	avltree_remove(&blk->node, &hdl->blocks);
+	gsh_free(blk->data);
+	gsh_free(blk);
+}
+
+/**
+ * @brief Make a clean block in memory the most recently used
+ */
+
+static void bcache_block_touch(struct bcache_block *blk)
+{
+	if (bcache_dirty(blk))
+		return;
+
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	if (BCACHE.ram_lru.next != &blk->lru) {
+		glist_del(&blk->lru);
+		glist_add(&BCACHE.ram_lru, &blk->lru);
+	}
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+}
+
+/**
+ * @brief Read a block on disk back into memory
+ *
+ * Called with the handle's mutex held, which keeps the slot from
+ * being given to another block.
+ *
+ * @return false if it could not be read, the block is then dropped.
+ */
+
+static bool bcache_block_load(struct bcache_fsal_obj_handle *hdl,
+			      struct bcache_block *blk)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	char *data;
+	ssize_t n;
+
+	data = gsh_malloc(bs);
+	if (data != NULL) {
+		n = pread(BCACHE.disk_fd, data, blk->len,
+			  (off_t)blk->slot * bs);
+		if (n == blk->len)
+			goto loaded;
+		LogInfo(COMPONENT_FSAL,
+			"Could not read a block back from the BCACHE disk file: %s",
+			n < 0 ? strerror(errno) : "short read");
+		gsh_free(data);
+	}
+
+	bcache_block_free(hdl, blk);
+	return false;
+
+ loaded:
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	glist_del(&blk->lru);
+	BCACHE.free_slots[BCACHE.nfree++] = blk->slot;
+	BCACHE.ram_bytes += bs;
+	glist_add(&BCACHE.ram_lru, &blk->lru);
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+	blk->data = data;
+	return true;
+}
+
+/**
+ * @brief Get a slot of the disk file
+ *
+ * Called with BCACHE.lru_mutex held.  With no slot free the least
+ * recently used block on disk is dropped for its slot.
+ *
+ * @return false if there is no disk tier or every block on disk is
+ *         busy.
+ */
+
+static bool bcache_slot_get(uint32_t *slot)
+{
+	struct glist_head *node;
+	struct bcache_block *blk;
+
+	if (BCACHE.disk_fd < 0)
+		return false;
+
+	if (BCACHE.nfree != 0) {
+		*slot = BCACHE.free_slots[--BCACHE.nfree];
+		return true;
+	}
+
+	for (node = BCACHE.disk_lru.prev; node != &BCACHE.disk_lru;
+	     node = node->prev) {
+		blk = glist_entry(node, struct bcache_block, lru);
+		if (pthread_mutex_trylock(&blk->hdl->mutex) != 0)
+			continue;
+		glist_del(&blk->lru);
+		avltree_remove(&blk->node, &blk->hdl->blocks);
+		PTHREAD_MUTEX_unlock(&blk->hdl->mutex);
+		*slot = blk->slot;
+		gsh_free(blk);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Bring the blocks in memory back under Max_RAM
+ *
+ * Called with no handle's mutex held.  The least recently used clean
+ * blocks are moved to disk or dropped; a block whose file is busy is
+ * passed over.
+ */
+
+static void bcache_trim(void)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	struct bcache_fsal_obj_handle *hdl;
+	struct glist_head *node;
+	struct bcache_block *blk;
+	uint32_t slot;
+	bool spill;
+	char *data;
+
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	node = BCACHE.ram_lru.prev;
+	while (BCACHE.ram_bytes > BCACHE.params.max_ram &&
+	       node != &BCACHE.ram_lru) {
+		blk = glist_entry(node, struct bcache_block, lru);
+		hdl = blk->hdl;
+		if (pthread_mutex_trylock(&hdl->mutex) != 0) {
+			node = node->prev;
+			continue;
+		}
+
+		glist_del(&blk->lru);
+		BCACHE.ram_bytes -= bs;
+		data = blk->data;
+		blk->data = NULL;
+		spill = bcache_slot_get(&slot);
+		PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+		/* The file's mutex keeps everyone off the block */
+		if (spill &&
+		    pwrite(BCACHE.disk_fd, data, blk->len,
+			   (off_t)slot * bs) != blk->len) {
+			LogInfo(COMPONENT_FSAL,
+				"Could not write a block to the BCACHE disk file: %s",
+				strerror(errno));
+			PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+			BCACHE.free_slots[BCACHE.nfree++] = slot;
+			spill = false;
+		} else {
+			PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+		}
+
+		if (spill) {
+			blk->slot = slot;
+			glist_add(&BCACHE.disk_lru, &blk->lru);
+		} else {
+			avltree_remove(&blk->node, &hdl->blocks);
+			gsh_free(blk);
+		}
+		PTHREAD_MUTEX_unlock(&hdl->mutex);
+		gsh_free(data);
+
+		node = BCACHE.ram_lru.prev;
+	}
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+}
+
+/**
+ * @brief Tell if a clean block ending the file is out of date
+ *
+ * The file grew past where it ended when the block was read.
+ */
+
+static bool bcache_block_stale(struct bcache_fsal_obj_handle *hdl,
+			       struct bcache_block *blk)
+{
+	uint64_t end = blk->index * BCACHE.params.block_size + blk->len;
+
+	return blk->eof && hdl->ndirty == 0 &&
+	       end < hdl->obj_handle.attrs->filesize;
+}
+
+/**
+ * @brief Read a block from the sub FSAL
+ *
+ * Called with the handle's mutex held, which is dropped while
+ * reading.  The block is added to the file unless another thread
+ * added it first or the file's blocks went stale meanwhile; in the
+ * latter case it is handed back on its own in @c detached.
+ *
+ * @param[out] blkp     The block added, or NULL
+ * @param[out] detached A block not added, or NULL
+ */
+
+static fsal_status_t bcache_fetch(struct bcache_fsal_export *export,
+				  struct bcache_fsal_obj_handle *hdl,
+				  uint64_t index, struct bcache_block **blkp,
+				  struct bcache_block **detached)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	struct fsal_obj_handle *sub_handle = hdl->sub_handle;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	uint64_t gen = hdl->gen;
+	struct bcache_block *blk;
+	size_t len = 0, n;
+	bool eof = false;
+	char *data;
+
+	*blkp = NULL;
+	*detached = NULL;
+
+	data = gsh_malloc(bs);
+	if (data == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	/* calling subfsal method, until the block is full or the file ends */
+	op_ctx->fsal_export = export->sub_export;
+	while (len < bs && !eof) {
+		status = sub_handle->obj_ops.read(sub_handle, index * bs + len,
+						  bs - len, data + len, &n,
+						  &eof);
+		if (FSAL_IS_ERROR(status))
+			break;
+		if (n == 0)
+			eof = true;
+		len += n;
+	}
+	op_ctx->fsal_export = &export->export;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+
+	if (FSAL_IS_ERROR(status)) {
+		gsh_free(data);
+		return status;
+	}
+
+	/* Another read or write got there first */
+	if (bcache_block_lookup(hdl, index) != NULL) {
+		gsh_free(data);
+		return status;
+	}
+
+	if (hdl->gen == gen)
+		blk = bcache_block_insert(hdl, index, data, len, eof);
+	else
+		blk = gsh_calloc(1, sizeof(struct bcache_block));
+
+	if (blk == NULL) {
+		gsh_free(data);
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+	}
+
+	if (hdl->gen == gen) {
+		*blkp = blk;
+	} else {
+		blk->index = index;
+		blk->len = len;
+		blk->eof = eof;
+		blk->data = data;
+		*detached = blk;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Get a block of a file in memory
+ *
+ * Called with the handle's mutex held, which is dropped while a block
+ * is read from the sub FSAL.
+ *
+ * @param[in]  fill     Read the block if it is not cached, else add an
+ *                      empty one for a write that covers it all
+ * @param[out] blkp     The block
+ * @param[out] detached Where a block that could not be kept is handed
+ *                      back, see bcache_fetch; NULL to read again.
+ */
+
+static fsal_status_t bcache_block_get(struct bcache_fsal_export *export,
+				      struct bcache_fsal_obj_handle *hdl,
+				      uint64_t index, bool fill,
+				      struct bcache_block **blkp,
+				      struct bcache_block **detached)
+{
+	fsal_status_t status;
+	struct bcache_block *blk, *mine;
+	char *data;
+
+	if (detached != NULL)
+		*detached = NULL;
+
+	for (;;) {
+		blk = bcache_block_lookup(hdl, index);
+		if (blk != NULL && bcache_block_stale(hdl, blk)) {
+			bcache_block_free(hdl, blk);
+			blk = NULL;
+		}
+		if (blk != NULL && blk->data == NULL &&
+		    !bcache_block_load(hdl, blk))
+			blk = NULL;
+		if (blk != NULL) {
+			*blkp = blk;
+			return fsalstat(ERR_FSAL_NO_ERROR, 0);
+		}
+
+		if (!fill) {
+			data = gsh_malloc(BCACHE.params.block_size);
+			if (data == NULL)
+				return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+			blk = bcache_block_insert(hdl, index, data, 0, false);
+			if (blk == NULL) {
+				gsh_free(data);
+				return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+			}
+			*blkp = blk;
+			return fsalstat(ERR_FSAL_NO_ERROR, 0);
+		}
+
+		status = bcache_fetch(export, hdl, index, &blk, &mine);
+		if (FSAL_IS_ERROR(status))
+			return status;
+		if (blk != NULL) {
+			*blkp = blk;
+			return status;
+		}
+		if (mine != NULL && detached != NULL) {
+			*blkp = mine;
+			*detached = mine;
+			return status;
+		}
+		if (mine != NULL) {
+			gsh_free(mine->data);
+			gsh_free(mine);
+		}
+	}
+}
+
+/**
+ * @brief Copy data into a block in memory
+ *
+ * A gap between the end of the block's data and where the copy
+ * starts is a hole and reads as zeros.
+ */
+
+static void bcache_block_copy(struct bcache_block *blk, uint32_t boff,
+			      const char *src, uint32_t n)
+{
+	if (boff > blk->len)
+		memset(blk->data + blk->len, 0, boff - blk->len);
+	memcpy(blk->data + boff, src, n);
+	if (boff + n > blk->len)
+		blk->len = boff + n;
+}
+
+/**
+ * @brief Fix the block that ended a file a write goes past
+ *
+ * Called with the handle's mutex held.  The rest of a dirty block is
+ * a hole now; a clean one is dropped.
+ *
+ * @param[in] index Index of the first block written
+ */
+
+static void bcache_extend(struct bcache_fsal_obj_handle *hdl, uint64_t index)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	struct bcache_block key, *blk;
+	struct avltree_node *node;
+
+	if (index == 0)
+		return;
+
+	key.index = index - 1;
+	node = avltree_inf(&key.node, &hdl->blocks);
+	if (node == NULL)
+		return;
+
+	blk = avltree_container_of(node, struct bcache_block, node);
+	if (!blk->eof)
+		return;
+
+	/* Only dirty data is sure to be the end of the file still */
+	if (!bcache_dirty(blk)) {
+		bcache_block_free(hdl, blk);
+		return;
+	}
+
+	memset(blk->data + blk->len, 0, bs - blk->len);
+	blk->len = bs;
+	blk->eof = false;
+}
+
+/**
+ * @brief Mark part of a block in memory as not written back
+ *
+ * Called with the handle's mutex held.
+ */
+
+static void bcache_block_dirty(struct bcache_fsal_obj_handle *hdl,
+			       struct bcache_block *blk,
+			       uint32_t start, uint32_t end)
+{
+	if (bcache_dirty(blk)) {
+		blk->dirty_start = MIN(blk->dirty_start, start);
+		blk->dirty_end = MAX(blk->dirty_end, end);
+		return;
+	}
+
+	PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+	glist_del(&blk->lru);
+	BCACHE.dirty_bytes += BCACHE.params.block_size;
+	PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+	hdl->ndirty++;
+	blk->dirty_start = start;
+	blk->dirty_end = end;
+}
+
+static fsal_status_t bcache_flush_locked(struct bcache_fsal_export *export,
+					 struct bcache_fsal_obj_handle *hdl);
+
+/**
+ * @brief Read from a file through its blocks
+ *
+ * Any of the range not cached is read from the sub FSAL a block at a
+ * time.  A read that fails part way returns what was read before.
+ */
+
+fsal_status_t bcache_cache_read(struct bcache_fsal_export *export,
+				struct bcache_fsal_obj_handle *hdl,
+				uint64_t offset, size_t size, void *buffer,
+				size_t *read_amount, bool *end_of_file)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	struct bcache_block *blk, *detached;
+	uint64_t pos = offset;
+	uint64_t end = offset + size;
+	uint32_t boff, n;
+	bool done = false;
+
+	*end_of_file = false;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	while (pos < end && !done) {
+		status = bcache_block_get(export, hdl, pos / bs, true, &blk,
+					  &detached);
+		if (FSAL_IS_ERROR(status))
+			break;
+
+		boff = pos % bs;
+		if (boff >= blk->len) {
+			*end_of_file = blk->eof;
+			done = true;
+		} else {
+			n = MIN(end - pos, blk->len - boff);
+			memcpy((char *)buffer + (pos - offset),
+			       blk->data + boff, n);
+			pos += n;
+			*end_of_file = blk->eof && boff + n == blk->len;
+			done = *end_of_file;
+		}
+
+		if (detached != NULL) {
+			gsh_free(detached->data);
+			gsh_free(detached);
+		} else {
+			bcache_block_touch(blk);
+		}
+	}
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	bcache_trim();
+
+	*read_amount = pos - offset;
+	if (FSAL_IS_ERROR(status) && pos > offset)
+		status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	return status;
+}
+
+/**
+ * @brief Write to a file's blocks only, for Write_Back
+ *
+ * Blocks only partly written are read from the sub FSAL first.  If
+ * the dirty blocks of all files are then over Max_Dirty, this file's
+ * are written back.
+ */
+
+fsal_status_t bcache_cache_write(struct bcache_fsal_export *export,
+				 struct bcache_fsal_obj_handle *hdl,
+				 uint64_t offset, size_t size, void *buffer)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	struct bcache_block *blk;
+	uint64_t pos = offset;
+	uint64_t end = offset + size;
+	uint32_t boff, n;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	while (pos < end) {
+		boff = pos % bs;
+		n = MIN(end - pos, bs - boff);
+		status = bcache_block_get(export, hdl, pos / bs,
+					  boff != 0 || n != bs, &blk, NULL);
+		if (FSAL_IS_ERROR(status))
+			break;
+
+		bcache_block_copy(blk, boff, (char *)buffer + (pos - offset),
+				  n);
+		if (pos + n < end)
+			blk->eof = false;
+		bcache_block_dirty(hdl, blk, boff, boff + n);
+		pos += n;
+	}
+
+	if (pos > offset) {
+		bcache_extend(hdl, offset / bs);
+		hdl->dirty_size = MAX(hdl->dirty_size, pos);
+	}
+
+	if (!FSAL_IS_ERROR(status) &&
+	    atomic_fetch_uint64_t(&BCACHE.dirty_bytes) >
+	    BCACHE.params.max_dirty)
+		status = bcache_flush_locked(export, hdl);
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	bcache_trim();
+
+	return status;
+}
+
+/**
+ * @brief Update the blocks cached after a write through
+ *
+ * Blocks not in memory are dropped rather than read back.
+ */
+
+void bcache_cache_update(struct bcache_fsal_obj_handle *hdl,
+			 uint64_t offset, size_t size, void *buffer)
+{
+	uint32_t bs = BCACHE.params.block_size;
+	struct bcache_block *blk;
+	uint64_t pos = offset;
+	uint64_t end = offset + size;
+	uint32_t boff, n;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	hdl->gen++;
+	hdl->own_change = true;
+
+	bcache_extend(hdl, offset / bs);
+
+	while (pos < end) {
+		boff = pos % bs;
+		n = MIN(end - pos, bs - boff);
+		blk = bcache_block_lookup(hdl, pos / bs);
+		if (blk != NULL && blk->data == NULL) {
+			bcache_block_free(hdl, blk);
+		} else if (blk != NULL) {
+			bcache_block_copy(blk, boff,
+					  (char *)buffer + (pos - offset), n);
+			if (pos + n < end)
+				blk->eof = false;
+		}
+		pos += n;
+	}
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+}
+
+/**
+ * @brief Write the dirty part of a block to the sub FSAL
+ */
+
+static fsal_status_t bcache_write_back(struct bcache_fsal_export *export,
+				       struct bcache_fsal_obj_handle *hdl,
+				       struct bcache_block *blk)
+{
+	struct fsal_obj_handle *sub_handle = hdl->sub_handle;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	uint64_t offset = blk->index * BCACHE.params.block_size +
+			  blk->dirty_start;
+	size_t len = blk->dirty_end - blk->dirty_start;
+	char *src = blk->data + blk->dirty_start;
+	bool stable = false;
+	size_t n;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	while (len != 0) {
+		status = sub_handle->obj_ops.write(sub_handle, offset, len,
+						   src, &n, &stable);
+		if (FSAL_IS_ERROR(status))
+			break;
+		if (n == 0) {
+			status = fsalstat(ERR_FSAL_IO, 0);
+			break;
+		}
+		offset += n;
+		src += n;
+		len -= n;
+	}
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+/**
+ * @brief Write a file's dirty blocks back
+ *
+ * Called with the handle's mutex held.  Blocks that fail stay dirty.
+ */
+
+static fsal_status_t bcache_flush_locked(struct bcache_fsal_export *export,
+					 struct bcache_fsal_obj_handle *hdl)
+{
+	struct avltree_node *node;
+	struct bcache_block *blk;
+	fsal_status_t status;
+
+	for (node = avltree_first(&hdl->blocks);
+	     node != NULL && hdl->ndirty != 0;
+	     node = avltree_next(node)) {
+		blk = avltree_container_of(node, struct bcache_block, node);
+		if (!bcache_dirty(blk))
+			continue;
+
+		status = bcache_write_back(export, hdl, blk);
+		if (FSAL_IS_ERROR(status)) {
+			LogInfo(COMPONENT_FSAL,
+				"Could not write back a block: %s",
+				msg_fsal_err(status.major));
+			hdl->flush_error = status.major;
+			return status;
+		}
+
+		blk->dirty_start = 0;
+		blk->dirty_end = 0;
+		hdl->ndirty--;
+
+		PTHREAD_MUTEX_lock(&BCACHE.lru_mutex);
+		BCACHE.dirty_bytes -= BCACHE.params.block_size;
+		glist_add(&BCACHE.ram_lru, &blk->lru);
+		PTHREAD_MUTEX_unlock(&BCACHE.lru_mutex);
+
+		hdl->own_change = true;
+	}
+	hdl->dirty_size = 0;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t bcache_flush(struct bcache_fsal_export *export,
+			   struct bcache_fsal_obj_handle *hdl)
+{
+	fsal_status_t status;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	status = bcache_flush_locked(export, hdl);
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	bcache_trim();
+
+	return status;
+}
+
+static void bcache_negative_free(struct bcache_fsal_obj_handle *dir,
+				 struct bcache_negative *neg)
+{
+	glist_del(&neg->list);
+	dir->nnegatives--;
+	gsh_free(neg);
+}
+
+/**
+ * @brief Drop the clean blocks of a file and the names of a directory
+ *
+ * Called with the handle's mutex held.
+ */
+
+static void bcache_drop_locked(struct bcache_fsal_obj_handle *hdl)
+{
+	struct avltree_node *node, *next;
+	struct bcache_block *blk;
+	struct glist_head *glist, *glistn;
+
+	for (node = avltree_first(&hdl->blocks); node != NULL; node = next) {
+		next = avltree_next(node);
+		blk = avltree_container_of(node, struct bcache_block, node);
+		if (!bcache_dirty(blk))
+			bcache_block_free(hdl, blk);
+	}
+
+	glist_for_each_safe(glist, glistn, &hdl->negatives)
+		bcache_negative_free(hdl, glist_entry(glist,
+						      struct bcache_negative,
+						      list));
+
+	hdl->gen++;
+}
+
+void bcache_drop_blocks(struct bcache_fsal_obj_handle *hdl)
+{
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	bcache_drop_locked(hdl);
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+}
+
+/**
+ * @brief Take a new handle on in the cache
+ *
+ * The key must be set; the handle is put in the table the upcalls
+ * look keys up in.
+ */
+
+void bcache_handle_init(struct bcache_fsal_obj_handle *hdl)
+{
+	struct bcache_partition *part = bcache_partition(&hdl->key);
+	struct bcache_lost *lost;
+	struct glist_head *glist, *glistn;
+
+	PTHREAD_MUTEX_init(&hdl->mutex, NULL);
+	avltree_init(&hdl->blocks, bcache_block_cmpf, 0 /* flags */);
+	glist_init(&hdl->negatives);
+	hdl->change = hdl->obj_handle.attrs->change;
+
+	PTHREAD_MUTEX_lock(&part->mutex);
+	glist_add(&part->handles, &hdl->partition);
+	glist_for_each_safe(glist, glistn, &part->lost) {
+		lost = glist_entry(glist, struct bcache_lost, list);
+		if (lost->key.len != hdl->key.len ||
+		    memcmp(lost->key.addr, hdl->key.addr, hdl->key.len) != 0)
+			continue;
+		hdl->lost = lost->error;
+		glist_del(&lost->list);
+		gsh_free(lost);
+		break;
+	}
+	PTHREAD_MUTEX_unlock(&part->mutex);
+}
+
+/**
+ * @brief Remember a file whose writes are being dropped
+ *
+ * Called with the partition's mutex held.
+ */
+
+static void bcache_lost_add(struct bcache_partition *part,
+			    struct bcache_fsal_obj_handle *hdl,
+			    fsal_errors_t error)
+{
+	struct bcache_lost *lost;
+
+	lost = gsh_malloc(sizeof(*lost) + hdl->key.len);
+	if (lost == NULL) {
+		LogCrit(COMPONENT_FSAL,
+			"Could not remember a file with writes dropped");
+		return;
+	}
+
+	lost->error = error;
+	lost->key.addr = lost->addr;
+	lost->key.len = hdl->key.len;
+	memcpy(lost->addr, hdl->key.addr, hdl->key.len);
+	glist_add(&part->lost, &lost->list);
+}
+
+/**
+ * @brief Take the error of writes dropped from a file
+ *
+ * The error is reported once, to the COMMIT that asks first.
+ */
+
+fsal_status_t bcache_lost_writes(struct bcache_fsal_obj_handle *hdl)
+{
+	fsal_errors_t error;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	error = hdl->lost;
+	hdl->lost = ERR_FSAL_NO_ERROR;
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	return fsalstat(error, 0);
+}
+
+/**
+ * @brief Drop all a handle has in the cache, before it is freed
+ *
+ * Blocks still dirty are ones that could not be written back, even
+ * on release.  The file is remembered with the error, as is one whose
+ * dropped writes no COMMIT was told about yet.
+ */
+
+void bcache_handle_fini(struct bcache_fsal_obj_handle *hdl)
+{
+	struct bcache_partition *part = bcache_partition(&hdl->key);
+	struct avltree_node *node;
+
+	PTHREAD_MUTEX_lock(&part->mutex);
+	glist_del(&hdl->partition);
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	if (hdl->ndirty != 0) {
+		LogCrit(COMPONENT_FSAL,
+			"Dropping %" PRIu32 " blocks never written back",
+			hdl->ndirty);
+		bcache_lost_add(part, hdl,
+				hdl->flush_error != ERR_FSAL_NO_ERROR
+				? hdl->flush_error : ERR_FSAL_IO);
+	} else if (hdl->lost != ERR_FSAL_NO_ERROR) {
+		bcache_lost_add(part, hdl, hdl->lost);
+	}
+	PTHREAD_MUTEX_unlock(&part->mutex);
+
+	bcache_drop_locked(hdl);
+	while ((node = avltree_first(&hdl->blocks)) != NULL)
+		bcache_block_free(hdl, avltree_container_of(
+					  node, struct bcache_block, node));
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	PTHREAD_MUTEX_destroy(&hdl->mutex);
+}
+
+/**
+ * @brief Check the attributes the sub FSAL just returned
+ *
+ * If the change attribute moved other than by our own writes, the
+ * clean blocks and the negative names are dropped.  A file with dirty
+ * blocks is as long as they make it.
+ */
+
+void bcache_attrs_fixup(struct bcache_fsal_obj_handle *hdl)
+{
+	struct attrlist *attrs = hdl->obj_handle.attrs;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	if (attrs->change != hdl->change) {
+		if (!hdl->own_change)
+			bcache_drop_locked(hdl);
+		hdl->change = attrs->change;
+		hdl->own_change = false;
+	}
+	if (hdl->ndirty != 0 && hdl->dirty_size > attrs->filesize)
+		attrs->filesize = hdl->dirty_size;
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+}
+
+static struct bcache_negative *bcache_negative_find(
+		struct bcache_fsal_obj_handle *dir, const char *name)
+{
+	struct glist_head *glist;
+	struct bcache_negative *neg;
+
+	glist_for_each(glist, &dir->negatives) {
+		neg = glist_entry(glist, struct bcache_negative, list);
+		if (strcmp(neg->name, name) == 0)
+			return neg;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Tell if a directory is known not to have a name
+ */
+
+bool bcache_negative_lookup(struct bcache_fsal_obj_handle *dir,
+			    const char *name)
+{
+	struct bcache_negative *neg;
+	bool found = false;
+
+	if (BCACHE.params.negative_ttl == 0)
+		return false;
+
+	PTHREAD_MUTEX_lock(&dir->mutex);
+	neg = bcache_negative_find(dir, name);
+	if (neg != NULL && neg->expires > time(NULL))
+		found = true;
+	else if (neg != NULL)
+		bcache_negative_free(dir, neg);
+	PTHREAD_MUTEX_unlock(&dir->mutex);
+
+	return found;
+}
+
+/**
+ * @brief Remember a directory does not have a name
+ *
+ * Past Negative_Lookup_Max names the oldest is forgotten.
+ *
+ * @param[in] gen The directory's generation before the lookup, the
+ *                name is not kept if it moved since
+ */
+
+void bcache_negative_add(struct bcache_fsal_obj_handle *dir,
+			 const char *name, uint64_t gen)
+{
+	struct bcache_negative *neg, *old;
+	size_t len = strlen(name) + 1;
+
+	if (BCACHE.params.negative_ttl == 0)
+		return;
+
+	neg = gsh_malloc(sizeof(struct bcache_negative) + len);
+	if (neg == NULL)
+		return;
+	memcpy(neg->name, name, len);
+	neg->expires = time(NULL) + BCACHE.params.negative_ttl;
+
+	PTHREAD_MUTEX_lock(&dir->mutex);
+	if (dir->gen != gen) {
+		PTHREAD_MUTEX_unlock(&dir->mutex);
+		gsh_free(neg);
+		return;
+	}
+
+	old = bcache_negative_find(dir, name);
+	if (old != NULL)
+		bcache_negative_free(dir, old);
+	glist_add(&dir->negatives, &neg->list);
+	dir->nnegatives++;
+
+	while (dir->nnegatives > BCACHE.params.negative_max)
+		bcache_negative_free(dir, glist_entry(dir->negatives.prev,
+						      struct bcache_negative,
+						      list));
+	PTHREAD_MUTEX_unlock(&dir->mutex);
+}
+
+/**
+ * @brief Forget a directory does not have a name, it was just made
+ */
+
+void bcache_negative_remove(struct bcache_fsal_obj_handle *dir,
+			    const char *name)
+{
+	struct bcache_negative *neg;
+
+	if (BCACHE.params.negative_ttl == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&dir->mutex);
+	dir->gen++;
+	neg = bcache_negative_find(dir, name);
+	if (neg != NULL)
+		bcache_negative_free(dir, neg);
+	PTHREAD_MUTEX_unlock(&dir->mutex);
+}
+
+uint64_t bcache_gen(struct bcache_fsal_obj_handle *hdl)
+{
+	uint64_t gen;
+
+	PTHREAD_MUTEX_lock(&hdl->mutex);
+	gen = hdl->gen;
+	PTHREAD_MUTEX_unlock(&hdl->mutex);
+
+	return gen;
+}
+
+/**
+ * @brief Drop what is cached of the objects with a key
+ *
+ * There may be a handle for the object in each export over it.
+ */
+
+static void bcache_invalidate_key(struct gsh_buffdesc *key)
+{
+	struct bcache_partition *part = bcache_partition(key);
+	struct bcache_fsal_obj_handle *hdl;
+	struct glist_head *glist;
+
+	PTHREAD_MUTEX_lock(&part->mutex);
+	glist_for_each(glist, &part->handles) {
+		hdl = glist_entry(glist, struct bcache_fsal_obj_handle,
+				  partition);
+		if (hdl->key.len != key->len ||
+		    memcmp(hdl->key.addr, key->addr, key->len) != 0)
+			continue;
+		PTHREAD_MUTEX_lock(&hdl->mutex);
+		bcache_drop_locked(hdl);
+		PTHREAD_MUTEX_unlock(&hdl->mutex);
+	}
+	PTHREAD_MUTEX_unlock(&part->mutex);
+}
+
+/* Upcalls from the sub FSAL, passed on up once the cache is dropped
+ */
+
+static cache_inode_status_t bcache_up_invalidate(struct fsal_module *fsal,
+						 struct gsh_buffdesc *obj,
+						 uint32_t flags)
+{
+	bcache_invalidate_key(obj);
+
+	return next_ops.up_ops->invalidate(fsal, obj, flags);
+}
+
+static cache_inode_status_t bcache_up_update(struct fsal_module *fsal,
+					     struct gsh_buffdesc *obj,
+					     struct attrlist *attr,
+					     uint32_t flags)
+{
+	if (attr->mask & (ATTR_SIZE | ATTR_MTIME | ATTR_CHGTIME | ATTR_CHANGE))
+		bcache_invalidate_key(obj);
+
+	return next_ops.up_ops->update(fsal, obj, attr, flags);
+}
+
+static cache_inode_status_t bcache_up_invalidate_close(
+				struct fsal_module *fsal,
+				const struct fsal_up_vector *up_ops,
+				struct gsh_buffdesc *obj,
+				uint32_t flags)
+{
+	bcache_invalidate_key(obj);
+
+	return next_ops.up_ops->invalidate_close(fsal, up_ops, obj, flags);
+}
+
+/**
+ * @brief Make the upcall vector given to the sub FSALs
+ *
+ * A copy of the one given to us, with the upcalls that say an object
+ * changed behind our back caught.
+ */
+
+void bcache_up_ops_init(void)
+{
+	BCACHE.up_ops = *next_ops.up_ops;
+	BCACHE.up_ops.invalidate = bcache_up_invalidate;
+	BCACHE.up_ops.update = bcache_up_update;
+	BCACHE.up_ops.invalidate_close = bcache_up_invalidate_close;
+}
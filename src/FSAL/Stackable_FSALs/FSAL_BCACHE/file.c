@@ -0,0 +1,299 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright (C) Panasas Inc., 2011
+ * Author: Jim Lieb jlieb@panasas.com
+ *
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* file.c
+ * File I/O methods for BCACHE module
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include "fsal.h"
+#include "FSAL/access_check.h"
+#include "fsal_convert.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include "FSAL/fsal_commonlib.h"
+#include "bcache_methods.h"
+
+
+/** bcache_open
+ * called with appropriate locks taken at the cache inode level
+ *
+ * With Write_Back, blocks only partly written are read first, so a
+ * file opened to write is opened to read too.  The flags asked for
+ * are kept for bcache_status.
+ */
+
+fsal_status_t bcache_open(struct fsal_obj_handle *obj_hdl,
+			  fsal_openflags_t openflags)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	fsal_openflags_t subflags = openflags;
+
+	if (BCACHE.params.write_back && (openflags & FSAL_O_WRITE))
+		subflags |= FSAL_O_READ;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.open(handle->sub_handle, subflags);
+	op_ctx->fsal_export = &export->export;
+
+	if (!FSAL_IS_ERROR(status))
+		handle->openflags = openflags;
+
+	return status;
+}
+
+/* bcache_status
+ * Let the caller peek into the file's open/close state.
+ *
+ * The flags the caller opened with, not the wider ones the sub FSAL
+ * may have been opened with, or cache_inode_open would reopen it.
+ */
+
+fsal_openflags_t bcache_status(struct fsal_obj_handle *obj_hdl)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	fsal_openflags_t status =
+		handle->sub_handle->obj_ops.status(handle->sub_handle);
+	op_ctx->fsal_export = &export->export;
+
+	if (status == FSAL_O_CLOSED)
+		return status;
+	return handle->openflags;
+}
+
+/* bcache_read
+ * concurrency (locks) is managed in cache_inode_*
+ * Served from the blocks, see cache.c.
+ */
+
+fsal_status_t bcache_read(struct fsal_obj_handle *obj_hdl,
+			  uint64_t offset,
+			  size_t buffer_size, void *buffer,
+			  size_t *read_amount,
+			  bool *end_of_file)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	return bcache_cache_read(export, handle, offset, buffer_size, buffer,
+				 read_amount, end_of_file);
+}
+
+/* bcache_write
+ * concurrency (locks) is managed in cache_inode_*
+ * With Write_Back the data only goes to the blocks, and the write is
+ * unstable whatever the client asked: cache_inode commits it then.
+ */
+
+fsal_status_t bcache_write(struct fsal_obj_handle *obj_hdl,
+			   uint64_t offset,
+			   size_t buffer_size, void *buffer,
+			   size_t *write_amount, bool *fsal_stable)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	fsal_status_t status;
+
+	if (BCACHE.params.write_back) {
+		status = bcache_cache_write(export, handle, offset,
+					    buffer_size, buffer);
+		*write_amount = FSAL_IS_ERROR(status) ? 0 : buffer_size;
+		*fsal_stable = false;
+		return status;
+	}
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	status = handle->sub_handle->obj_ops.write(handle->sub_handle,
+						   offset,
+						   buffer_size,
+						   buffer,
+						   write_amount,
+						   fsal_stable);
+	op_ctx->fsal_export = &export->export;
+
+	if (!FSAL_IS_ERROR(status))
+		bcache_cache_update(handle, offset, *write_amount, buffer);
+
+	return status;
+}
+
+/* bcache_commit
+ * Commit a file range to storage.
+ * The dirty blocks, of the whole file, are written back first.
+ */
+
+fsal_status_t bcache_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			    off_t offset, size_t len)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	fsal_status_t status = bcache_lost_writes(handle);
+
+	if (FSAL_IS_ERROR(status))
+		return status;
+
+	status = bcache_flush(export, handle);
+	if (FSAL_IS_ERROR(status))
+		return status;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	status = handle->sub_handle->obj_ops.commit(handle->sub_handle,
+						    offset, len);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+/* bcache_lock_op
+ * lock a region of the file
+ * throw an error if the fd is not open.  The old fsal didn't
+ * check this.
+ */
+
+fsal_status_t bcache_lock_op(struct fsal_obj_handle *obj_hdl,
+			     void *p_owner,
+			     fsal_lock_op_t lock_op,
+			     fsal_lock_param_t *request_lock,
+			     fsal_lock_param_t *conflicting_lock)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.lock_op(handle->sub_handle,
+						    p_owner,
+						    lock_op,
+						    request_lock,
+						    conflicting_lock);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+/* bcache_close
+ * Close the file if it is still open.
+ * Yes, we ignor lock status.  Closing a file in POSIX
+ * releases all locks but that is state and cache inode's problem.
+ * The dirty blocks are written back first.  If that fails the sub
+ * FSAL's file is left open, so a later COMMIT, close or the release
+ * of the handle can try again.
+ */
+
+fsal_status_t bcache_close(struct fsal_obj_handle *obj_hdl)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	fsal_status_t status = bcache_flush(export, handle);
+
+	if (FSAL_IS_ERROR(status))
+		return status;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	status = handle->sub_handle->obj_ops.close(handle->sub_handle);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+/* bcache_lru_cleanup
+ * free non-essential resources at the request of cache inode's
+ * LRU processing identifying this handle as stale enough for resource
+ * trimming.
+ */
+
+fsal_status_t bcache_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+				 lru_actions_t requests)
+{
+	struct bcache_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct bcache_fsal_obj_handle,
+			     obj_handle);
+
+	struct bcache_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct bcache_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.lru_cleanup(handle->sub_handle,
+							requests);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
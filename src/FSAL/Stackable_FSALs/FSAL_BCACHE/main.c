@@ -0,0 +1,226 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* main.c
+ * Module core functions
+ *
+ * FSAL_BCACHE stacks on another FSAL like FSAL_NULL and caches the
+ * data of its files in blocks, in memory and optionally on a local
+ * disk, with writes kept until COMMIT if Write_Back is set.  It also
+ * remembers for a while names lookups did not find.  See cache.c.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "gsh_list.h"
+#include "FSAL/fsal_init.h"
+#include "bcache_methods.h"
+
+/* defined the set of attributes supported with POSIX */
+#define BCACHE_SUPPORTED_ATTRIBUTES (                    \
+	ATTR_TYPE     | ATTR_SIZE     |                  \
+	ATTR_FSID     | ATTR_FILEID   |                  \
+	ATTR_MODE     | ATTR_NUMLINKS | ATTR_OWNER     | \
+	ATTR_GROUP    | ATTR_ATIME    | ATTR_RAWDEV    | \
+	ATTR_CTIME    | ATTR_MTIME    | ATTR_SPACEUSED | \
+	ATTR_CHGTIME)
+
+/* FSAL name determines name of shared library: libfsal<name>.so */
+const char myname[] = "BCACHE";
+
+/* filesystem info for BCACHE */
+static struct fsal_staticfsinfo_t default_posix_info = {
+	.maxfilesize = UINT64_MAX,
+	.maxlink = _POSIX_LINK_MAX,
+	.maxnamelen = 1024,
+	.maxpathlen = 1024,
+	.no_trunc = true,
+	.chown_restricted = true,
+	.case_insensitive = false,
+	.case_preserving = true,
+	.link_support = true,
+	.symlink_support = true,
+	.lock_support = true,
+	.lock_support_owner = false,
+	.lock_support_async_block = false,
+	.named_attr = true,
+	.unique_handles = true,
+	.lease_time = {10, 0},
+	.acl_support = FSAL_ACLSUPPORT_ALLOW,
+	.cansettime = true,
+	.homogenous = true,
+	.supported_attrs = BCACHE_SUPPORTED_ATTRIBUTES,
+	.maxread = FSAL_MAXIOSIZE,
+	.maxwrite = FSAL_MAXIOSIZE,
+	.umask = 0,
+	.auth_exportpath_xdev = false,
+	.xattr_access_rights = 0400,	/* root=RW, owner=R */
+	.link_supports_permission_checks = true,
+};
+
+static struct config_item bcache_items[] = {
+	CONF_ITEM_UI32("Block_Size", 4096, FSAL_MAXIOSIZE, 1048576,
+		       bcache_fsal_module, params.block_size),
+	CONF_ITEM_UI64("Max_RAM", 0, UINT64_MAX, 268435456,
+		       bcache_fsal_module, params.max_ram),
+	CONF_ITEM_UI64("Max_Dirty", 0, UINT64_MAX, 67108864,
+		       bcache_fsal_module, params.max_dirty),
+	CONF_ITEM_PATH("Disk_Dir", 1, MAXPATHLEN, NULL,
+		       bcache_fsal_module, params.disk_dir),
+	CONF_ITEM_UI64("Max_Disk", 0, UINT64_MAX, 1073741824,
+		       bcache_fsal_module, params.max_disk),
+	CONF_ITEM_BOOL("Write_Back", false,
+		       bcache_fsal_module, params.write_back),
+	CONF_ITEM_UI32("Negative_Lookup_TTL", 0, 3600, 0,
+		       bcache_fsal_module, params.negative_ttl),
+	CONF_ITEM_UI32("Negative_Lookup_Max", 1, 65536, 256,
+		       bcache_fsal_module, params.negative_max),
+	CONFIG_EOL
+};
+
+static struct config_block bcache_block = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.fsal.bcache",
+	.blk_desc.name = "BCACHE",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = noop_conf_init,
+	.blk_desc.u.blk.params = bcache_items,
+	.blk_desc.u.blk.commit = noop_conf_commit
+};
+
+/* private helper for export object
+ */
+
+struct fsal_staticfsinfo_t *bcache_staticinfo(struct fsal_module *hdl)
+{
+	struct bcache_fsal_module *myself;
+
+	myself = container_of(hdl, struct bcache_fsal_module, fsal);
+	return &myself->fs_info;
+}
+
+/* Module methods
+ */
+
+/* init_config
+ * must be called with a reference taken (via lookup_fsal)
+ */
+
+static fsal_status_t init_config(struct fsal_module *fsal_hdl,
+				 config_file_t config_struct,
+				 struct config_error_type *err_type)
+{
+	struct bcache_fsal_module *bcache_me =
+	    container_of(fsal_hdl, struct bcache_fsal_module, fsal);
+	int rc;
+
+	/* get a copy of the defaults */
+	bcache_me->fs_info = default_posix_info;
+
+	(void) load_config_from_parse(config_struct,
+				      &bcache_block,
+				      bcache_me,
+				      true,
+				      err_type);
+	if (!config_error_is_harmless(err_type))
+		return fsalstat(ERR_FSAL_INVAL, 0);
+
+	/* Dirty blocks cannot be evicted, leave room for clean ones */
+	if (bcache_me->params.write_back &&
+	    bcache_me->params.max_dirty > bcache_me->params.max_ram / 2) {
+		LogWarn(COMPONENT_FSAL,
+			"BCACHE Max_Dirty lowered to half of Max_RAM");
+		bcache_me->params.max_dirty = bcache_me->params.max_ram / 2;
+	}
+
+	rc = bcache_cache_init();
+	if (rc != 0)
+		return fsalstat(posix2fsal_error(rc), rc);
+
+	display_fsinfo(&bcache_me->fs_info);
+	LogDebug(COMPONENT_FSAL,
+		 "FSAL INIT: Supported attributes mask = 0x%" PRIx64,
+		 bcache_me->fs_info.supported_attrs);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* Module initialization.
+ * Called by dlopen() to register the module
+ * keep a private pointer to me in myself
+ */
+
+/* my module private storage
+ */
+
+struct bcache_fsal_module BCACHE;
+struct next_ops next_ops;
+
+/* linkage to the exports and handle ops initializers
+ */
+
+MODULE_INIT void bcache_init(void)
+{
+	int retval, i;
+	struct fsal_module *myself = &BCACHE.fsal;
+
+	retval = register_fsal(myself, myname, FSAL_MAJOR_VERSION,
+			       FSAL_MINOR_VERSION, FSAL_ID_NO_PNFS);
+	if (retval != 0) {
+		fprintf(stderr, "BCACHE module failed to register");
+		return;
+	}
+	myself->m_ops.create_export = bcache_create_export;
+	myself->m_ops.init_config = init_config;
+
+	for (i = 0; i < BCACHE_HANDLE_PARTITIONS; i++) {
+		PTHREAD_MUTEX_init(&BCACHE.handles[i].mutex, NULL);
+		glist_init(&BCACHE.handles[i].handles);
+		glist_init(&BCACHE.handles[i].lost);
+	}
+	PTHREAD_MUTEX_init(&BCACHE.lru_mutex, NULL);
+	glist_init(&BCACHE.ram_lru);
+	glist_init(&BCACHE.disk_lru);
+	BCACHE.disk_fd = -1;
+}
+
+MODULE_FINI void bcache_unload(void)
+{
+	int retval, i;
+
+	retval = unregister_fsal(&BCACHE.fsal);
+	if (retval != 0) {
+		fprintf(stderr, "BCACHE module failed to unregister");
+		return;
+	}
+
+	bcache_cache_fini();
+	gsh_free(BCACHE.params.disk_dir);
+
+	for (i = 0; i < BCACHE_HANDLE_PARTITIONS; i++)
+		PTHREAD_MUTEX_destroy(&BCACHE.handles[i].mutex);
+	PTHREAD_MUTEX_destroy(&BCACHE.lru_mutex);
+}
@@ -0,0 +1,319 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * Copyright (C) Panasas Inc., 2011
+ * Author: Jim Lieb jlieb@panasas.com
+ *
+ * contributeur : Philippe DENIEL   philippe.deniel@cea.fr
+ *                Thomas LEIBOVICI  thomas.leibovici@cea.fr
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* file.c
+ * File I/O methods for PROF module
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include "fsal.h"
+#include "FSAL/access_check.h"
+#include "fsal_convert.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include "FSAL/fsal_commonlib.h"
+#include "prof_methods.h"
+
+
+/** prof_open
+ * called with appropriate locks taken at the cache inode level
+ */
+
+fsal_status_t prof_open(struct fsal_obj_handle *obj_hdl,
+			fsal_openflags_t openflags)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_OPEN);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.open(handle->sub_handle, openflags);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
+
+/* prof_status
+ * Let the caller peek into the file's open/close state.
+ */
+
+fsal_openflags_t prof_status(struct fsal_obj_handle *obj_hdl)
+{
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->sub_export;
+	fsal_openflags_t status =
+		handle->sub_handle->obj_ops.status(handle->sub_handle);
+	op_ctx->fsal_export = &export->export;
+
+	return status;
+}
+
+/* prof_read
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t prof_read(struct fsal_obj_handle *obj_hdl,
+			uint64_t offset,
+			size_t buffer_size, void *buffer,
+			size_t *read_amount,
+			bool *end_of_file)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_READ);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.read(handle->sub_handle, offset,
+						 buffer_size, buffer,
+						 read_amount, end_of_file);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status,
+		 FSAL_IS_ERROR(status) ? 0 : *read_amount);
+
+	return status;
+}
+
+/* prof_write
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t prof_write(struct fsal_obj_handle *obj_hdl,
+			 uint64_t offset,
+			 size_t buffer_size, void *buffer,
+			 size_t *write_amount, bool *fsal_stable)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_WRITE);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.write(handle->sub_handle,
+						  offset,
+						  buffer_size,
+						  buffer,
+						  write_amount,
+						  fsal_stable);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status,
+		 FSAL_IS_ERROR(status) ? 0 : *write_amount);
+
+	return status;
+}
+
+/* prof_commit
+ * Commit a file range to storage.
+ * for right now, fsync will have to do.
+ */
+
+fsal_status_t prof_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			  off_t offset, size_t len)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_COMMIT);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.commit(handle->sub_handle,
+						   offset, len);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
+
+/* prof_lock_op
+ * lock a region of the file
+ * throw an error if the fd is not open.  The old fsal didn't
+ * check this.
+ */
+
+fsal_status_t prof_lock_op(struct fsal_obj_handle *obj_hdl,
+			   void *p_owner,
+			   fsal_lock_op_t lock_op,
+			   fsal_lock_param_t *request_lock,
+			   fsal_lock_param_t *conflicting_lock)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_LOCK);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.lock_op(handle->sub_handle,
+						    p_owner,
+						    lock_op,
+						    request_lock,
+						    conflicting_lock);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
+
+/* prof_share_op
+ * pass share reservations down, NULL leaves them to the default
+ */
+
+fsal_status_t prof_share_op(struct fsal_obj_handle *obj_hdl, void *p_owner,
+			    fsal_share_param_t request_share)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_SHARE);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.share_op(handle->sub_handle,
+						     p_owner,
+						     request_share);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
+
+/* prof_close
+ * Close the file if it is still open.
+ * Yes, we ignor lock status.  Closing a file in POSIX
+ * releases all locks but that is state and cache inode's problem.
+ */
+
+fsal_status_t prof_close(struct fsal_obj_handle *obj_hdl)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_CLOSE);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.close(handle->sub_handle);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
+
+/* prof_lru_cleanup
+ * free non-essential resources at the request of cache inode's
+ * LRU processing identifying this handle as stale enough for resource
+ * trimming.
+ */
+
+fsal_status_t prof_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+			       lru_actions_t requests)
+{
+	struct prof_call call;
+
+	struct prof_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct prof_fsal_obj_handle,
+			     obj_handle);
+
+	struct prof_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct prof_fsal_export,
+			     export);
+
+	/* calling subfsal method */
+	prof_begin(&call, export, PROF_OP_LRU_CLEANUP);
+	op_ctx->fsal_export = export->sub_export;
+	fsal_status_t status =
+		handle->sub_handle->obj_ops.lru_cleanup(handle->sub_handle,
+							requests);
+	op_ctx->fsal_export = &export->export;
+	prof_end(&call, handle->sub_handle, status, 0);
+
+	return status;
+}
@@ -0,0 +1,613 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* main.c
+ * Module core functions
+ *
+ * FSAL_PROF stacks on another FSAL like FSAL_NULL and times every
+ * call it passes down.  For each method it keeps a latency
+ * histogram, the calls in flight, errors and bytes moved, over all
+ * exports and per export.  Calls slower than Outlier_Threshold are
+ * logged with the object's handle and the caller.  The statistics
+ * are read over DBus with ExportMgr's GetFSALStats, and can be
+ * logged every Dump_Interval seconds.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include "fsal.h"
+#include "gsh_list.h"
+#include "display.h"
+#include "FSAL/fsal_init.h"
+#ifdef USE_DBUS
+#include "gsh_dbus.h"
+#endif
+#include "server_stats_private.h"
+#include "prof_methods.h"
+
+/* defined the set of attributes supported with POSIX */
+#define PROF_SUPPORTED_ATTRIBUTES (                      \
+	ATTR_TYPE     | ATTR_SIZE     |                  \
+	ATTR_FSID     | ATTR_FILEID   |                  \
+	ATTR_MODE     | ATTR_NUMLINKS | ATTR_OWNER     | \
+	ATTR_GROUP    | ATTR_ATIME    | ATTR_RAWDEV    | \
+	ATTR_CTIME    | ATTR_MTIME    | ATTR_SPACEUSED | \
+	ATTR_CHGTIME)
+
+/* FSAL name determines name of shared library: libfsal<name>.so */
+const char myname[] = "PROF";
+
+const char *prof_op_names[PROF_OP_COUNT] = {
+	[PROF_OP_LOOKUP] = "lookup",
+	[PROF_OP_READDIR] = "readdir",
+	[PROF_OP_CREATE] = "create",
+	[PROF_OP_MKDIR] = "mkdir",
+	[PROF_OP_MKNODE] = "mknode",
+	[PROF_OP_SYMLINK] = "symlink",
+	[PROF_OP_READLINK] = "readlink",
+	[PROF_OP_GETATTRS] = "getattrs",
+	[PROF_OP_SETATTRS] = "setattrs",
+	[PROF_OP_LINK] = "link",
+	[PROF_OP_RENAME] = "rename",
+	[PROF_OP_UNLINK] = "unlink",
+	[PROF_OP_OPEN] = "open",
+	[PROF_OP_READ] = "read",
+	[PROF_OP_WRITE] = "write",
+	[PROF_OP_COMMIT] = "commit",
+	[PROF_OP_LOCK] = "lock_op",
+	[PROF_OP_SHARE] = "share_op",
+	[PROF_OP_CLOSE] = "close",
+	[PROF_OP_LRU_CLEANUP] = "lru_cleanup",
+	[PROF_OP_LIST_XATTRS] = "list_ext_attrs",
+	[PROF_OP_GET_XATTR] = "getextattr",
+	[PROF_OP_SET_XATTR] = "setextattr",
+	[PROF_OP_REMOVE_XATTR] = "remove_extattr",
+	[PROF_OP_LOOKUP_PATH] = "lookup_path",
+	[PROF_OP_CREATE_HANDLE] = "create_handle",
+	[PROF_OP_DYNAMIC_INFO] = "get_fs_dynamic_info",
+};
+
+/* filesystem info for PROF */
+static struct fsal_staticfsinfo_t default_posix_info = {
+	.maxfilesize = UINT64_MAX,
+	.maxlink = _POSIX_LINK_MAX,
+	.maxnamelen = 1024,
+	.maxpathlen = 1024,
+	.no_trunc = true,
+	.chown_restricted = true,
+	.case_insensitive = false,
+	.case_preserving = true,
+	.link_support = true,
+	.symlink_support = true,
+	.lock_support = true,
+	.lock_support_owner = false,
+	.lock_support_async_block = false,
+	.named_attr = true,
+	.unique_handles = true,
+	.lease_time = {10, 0},
+	.acl_support = FSAL_ACLSUPPORT_ALLOW,
+	.cansettime = true,
+	.homogenous = true,
+	.supported_attrs = PROF_SUPPORTED_ATTRIBUTES,
+	.maxread = FSAL_MAXIOSIZE,
+	.maxwrite = FSAL_MAXIOSIZE,
+	.umask = 0,
+	.auth_exportpath_xdev = false,
+	.xattr_access_rights = 0400,	/* root=RW, owner=R */
+	.link_supports_permission_checks = true,
+};
+
+static struct config_item prof_items[] = {
+	CONF_ITEM_UI32("Outlier_Threshold", 0, 600000000, 0,
+		       prof_fsal_module, params.outlier_threshold),
+	CONF_ITEM_UI32("Dump_Interval", 0, 86400, 0,
+		       prof_fsal_module, params.dump_interval),
+	CONFIG_EOL
+};
+
+static struct config_block prof_block = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.fsal.prof",
+	.blk_desc.name = "PROF",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = noop_conf_init,
+	.blk_desc.u.blk.params = prof_items,
+	.blk_desc.u.blk.commit = noop_conf_commit
+};
+
+/* private helper for export object
+ */
+
+struct fsal_staticfsinfo_t *prof_staticinfo(struct fsal_module *hdl)
+{
+	struct prof_fsal_module *myself;
+
+	myself = container_of(hdl, struct prof_fsal_module, fsal);
+	return &myself->fs_info;
+}
+
+/**
+ * @brief Set up the statistics of every method
+ *
+ * @param[in] stats   Statistics to set up
+ * @param[in] nshards Shards of each latency histogram
+ *
+ * @return false if out of memory.
+ */
+
+bool prof_stats_init(struct prof_stats *stats, uint32_t nshards)
+{
+	int op;
+
+	memset(stats, 0, sizeof(*stats));
+	for (op = 0; op < PROF_OP_COUNT; op++) {
+		if (!lat_hist_shards_init(&stats->op[op].latency, nshards)) {
+			prof_stats_destroy(stats);
+			return false;
+		}
+	}
+	return true;
+}
+
+void prof_stats_destroy(struct prof_stats *stats)
+{
+	int op;
+
+	for (op = 0; op < PROF_OP_COUNT; op++)
+		lat_hist_shards_destroy(&stats->op[op].latency);
+}
+
+/**
+ * @brief Zero the statistics of every method
+ *
+ * Calls in flight are left alone, they still have to return.
+ * Calls finishing meanwhile may or may not be counted.
+ */
+
+void prof_stats_reset(struct prof_stats *stats)
+{
+	struct prof_op_stats *st;
+	int op;
+
+	for (op = 0; op < PROF_OP_COUNT; op++) {
+		st = &stats->op[op];
+		atomic_store_uint64_t(&st->calls, 0);
+		atomic_store_uint64_t(&st->errors, 0);
+		atomic_store_uint64_t(&st->bytes, 0);
+		atomic_store_uint64_t(&st->outliers, 0);
+		memset(st->latency.shard, 0,
+		       st->latency.nshards * sizeof(struct lat_histogram));
+	}
+}
+
+/**
+ * @brief Reduce one method's statistics to what is reported
+ */
+
+void prof_summarize(struct prof_op_stats *st, struct prof_summary *sum)
+{
+	struct lat_histogram hist;
+	uint64_t count;
+
+	sum->calls = atomic_fetch_uint64_t(&st->calls);
+	sum->errors = atomic_fetch_uint64_t(&st->errors);
+	sum->inflight = atomic_fetch_uint64_t(&st->inflight);
+	sum->bytes = atomic_fetch_uint64_t(&st->bytes);
+	sum->outliers = atomic_fetch_uint64_t(&st->outliers);
+
+	lat_hist_shards_sum(&st->latency, &hist);
+	count = lat_hist_count(&hist);
+	sum->p50 = lat_hist_percentile(&hist, count, 50.0);
+	sum->p90 = lat_hist_percentile(&hist, count, 90.0);
+	sum->p99 = lat_hist_percentile(&hist, count, 99.0);
+	sum->p999 = lat_hist_percentile(&hist, count, 99.9);
+	sum->max = lat_hist_max(&hist);
+}
+
+/**
+ * @brief Log a call slower than Outlier_Threshold
+ *
+ * @param[in] call       The call
+ * @param[in] sub_handle The sub FSAL's object, or NULL if there is
+ *                       none or it may be gone
+ * @param[in] status     What the call returned
+ * @param[in] elapsed    How long it took
+ */
+
+static void prof_log_outlier(struct prof_call *call,
+			     struct fsal_obj_handle *sub_handle,
+			     fsal_status_t status, nsecs_elapsed_t elapsed)
+{
+	char str_handle[NFS4_FHSIZE * 2 + 1] = "(none)";
+	struct display_buffer dspbuf = {
+		sizeof(str_handle), str_handle, str_handle};
+	const char *client = "(internal)";
+	struct gsh_buffdesc key;
+	unsigned int uid = 0;
+
+	if (sub_handle != NULL) {
+		op_ctx->fsal_export = call->export->sub_export;
+		sub_handle->obj_ops.handle_to_key(sub_handle, &key);
+		op_ctx->fsal_export = &call->export->export;
+		(void) display_opaque_bytes(&dspbuf, key.addr, key.len);
+	}
+	if (op_ctx->client != NULL)
+		client = op_ctx->client->hostaddr_str;
+	if (op_ctx->creds != NULL)
+		uid = op_ctx->creds->caller_uid;
+
+	LogWarn(COMPONENT_FSAL,
+		"%s on export %" PRIu16 " took %" PRIu64
+		" usec (%s), handle %s, client %s, uid %u",
+		prof_op_names[call->op], call->export->export_id,
+		elapsed / NS_PER_USEC, msg_fsal_err(status.major),
+		str_handle, client, uid);
+}
+
+/**
+ * @brief Count a call down the stack that has returned
+ *
+ * @param[in] call       State from prof_begin
+ * @param[in] sub_handle The sub FSAL's object, for the outlier log
+ * @param[in] status     What the call returned
+ * @param[in] bytes      Bytes read or written
+ */
+
+void prof_end(struct prof_call *call, struct fsal_obj_handle *sub_handle,
+	      fsal_status_t status, uint64_t bytes)
+{
+	struct prof_op_stats *sts[2] = {
+		&PROF.stats.op[call->op],
+		&call->export->stats.op[call->op]
+	};
+	struct timespec end;
+	nsecs_elapsed_t elapsed;
+	bool outlier;
+	int i;
+
+	now(&end);
+	elapsed = timespec_diff(&call->start, &end);
+	outlier = PROF.params.outlier_threshold != 0 &&
+	    elapsed > PROF.params.outlier_threshold * NS_PER_USEC;
+
+	for (i = 0; i < 2; i++) {
+		(void)atomic_inc_uint64_t(&sts[i]->calls);
+		if (FSAL_IS_ERROR(status))
+			(void)atomic_inc_uint64_t(&sts[i]->errors);
+		if (bytes != 0)
+			(void)atomic_add_uint64_t(&sts[i]->bytes, bytes);
+		if (outlier)
+			(void)atomic_inc_uint64_t(&sts[i]->outliers);
+		lat_hist_shards_record(&sts[i]->latency, elapsed);
+		(void)atomic_dec_uint64_t(&sts[i]->inflight);
+	}
+
+	if (outlier)
+		prof_log_outlier(call, sub_handle, status, elapsed);
+}
+
+/**
+ * @brief Log the methods that were called
+ *
+ * @param[in] stats  Statistics to log
+ * @param[in] prefix What they cover
+ */
+
+static void prof_dump_stats(struct prof_stats *stats, const char *prefix)
+{
+	struct prof_summary sum;
+	int op;
+
+	for (op = 0; op < PROF_OP_COUNT; op++) {
+		prof_summarize(&stats->op[op], &sum);
+		if (sum.calls == 0 && sum.inflight == 0)
+			continue;
+		LogEvent(COMPONENT_FSAL,
+			 "%s %s: calls %" PRIu64 " errors %" PRIu64
+			 " inflight %" PRIu64 " bytes %" PRIu64
+			 " outliers %" PRIu64 " p50 %" PRIu64
+			 " p99 %" PRIu64 " max %" PRIu64 " usec",
+			 prefix, prof_op_names[op], sum.calls, sum.errors,
+			 sum.inflight, sum.bytes, sum.outliers,
+			 sum.p50 / NS_PER_USEC, sum.p99 / NS_PER_USEC,
+			 sum.max / NS_PER_USEC);
+	}
+}
+
+static void prof_dump(void)
+{
+	struct prof_fsal_export *exp;
+	struct glist_head *glist;
+	char prefix[32];
+
+	prof_dump_stats(&PROF.stats, "all exports");
+
+	PTHREAD_RWLOCK_rdlock(&PROF.fsal.lock);
+	glist_for_each(glist, &PROF.fsal.exports) {
+		exp = container_of(glist, struct prof_fsal_export,
+				   export.exports);
+		snprintf(prefix, sizeof(prefix), "export %" PRIu16,
+			 exp->export_id);
+		prof_dump_stats(&exp->stats, prefix);
+	}
+	PTHREAD_RWLOCK_unlock(&PROF.fsal.lock);
+}
+
+/**
+ * @brief Log the statistics every Dump_Interval seconds
+ *
+ * The delayed executor is not running yet when the FSAL is
+ * configured, so the dump has a thread of its own.
+ */
+
+static void *prof_dump_thread(void *arg)
+{
+	struct timespec then;
+	int rc;
+
+	SetNameFunction("prof_dump");
+
+	PTHREAD_MUTEX_lock(&PROF.dump_mutex);
+	while (PROF.dump_running) {
+		now(&then);
+		then.tv_sec += PROF.params.dump_interval;
+		do {
+			rc = pthread_cond_timedwait(&PROF.dump_cond,
+						    &PROF.dump_mutex, &then);
+		} while (PROF.dump_running && rc != ETIMEDOUT);
+		if (!PROF.dump_running)
+			break;
+		PTHREAD_MUTEX_unlock(&PROF.dump_mutex);
+		prof_dump();
+		PTHREAD_MUTEX_lock(&PROF.dump_mutex);
+	}
+	PTHREAD_MUTEX_unlock(&PROF.dump_mutex);
+
+	return NULL;
+}
+
+/* Module methods
+ */
+
+/* init_config
+ * must be called with a reference taken (via lookup_fsal)
+ */
+
+static fsal_status_t init_config(struct fsal_module *fsal_hdl,
+				 config_file_t config_struct,
+				 struct config_error_type *err_type)
+{
+	struct prof_fsal_module *prof_me =
+	    container_of(fsal_hdl, struct prof_fsal_module, fsal);
+	int rc;
+
+	/* get a copy of the defaults */
+	prof_me->fs_info = default_posix_info;
+
+	(void) load_config_from_parse(config_struct,
+				      &prof_block,
+				      prof_me,
+				      true,
+				      err_type);
+	if (!config_error_is_harmless(err_type))
+		return fsalstat(ERR_FSAL_INVAL, 0);
+
+	if (!prof_stats_init(&prof_me->stats, server_stats_shards())) {
+		LogCrit(COMPONENT_FSAL,
+			"Could not allocate PROF statistics");
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+	}
+
+	if (prof_me->params.dump_interval != 0) {
+		prof_me->dump_running = true;
+		rc = pthread_create(&prof_me->dump_thread, NULL,
+				    prof_dump_thread, NULL);
+		if (rc != 0) {
+			LogCrit(COMPONENT_FSAL,
+				"Could not start PROF dump thread: %s",
+				strerror(rc));
+			prof_me->dump_running = false;
+		}
+	}
+
+	display_fsinfo(&prof_me->fs_info);
+	LogDebug(COMPONENT_FSAL,
+		 "FSAL INIT: Supported attributes mask = 0x%" PRIx64,
+		 prof_me->fs_info.supported_attrs);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+#ifdef USE_DBUS
+
+/**
+ * @brief Append the methods that were called to a DBus reply
+ */
+
+static void prof_dbus_ops(struct prof_stats *stats, DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter, struct_iter;
+	struct prof_summary sum;
+	const char *name;
+	int op;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 FSAL_OP_STATS_TYPE, &array_iter);
+	for (op = 0; op < PROF_OP_COUNT; op++) {
+		prof_summarize(&stats->op[op], &sum);
+		if (sum.calls == 0 && sum.inflight == 0)
+			continue;
+		name = prof_op_names[op];
+		dbus_message_iter_open_container(&array_iter,
+						 DBUS_TYPE_STRUCT, NULL,
+						 &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_STRING, &name);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.calls);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.errors);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64,
+					       &sum.inflight);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.bytes);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64,
+					       &sum.outliers);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.p50);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.p90);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.p99);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.p999);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT64, &sum.max);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Append the statistics to a GetFSALStats reply
+ *
+ * The methods over all exports, then those of each export.
+ */
+
+static bool prof_extract_stats(struct fsal_module *fsal_hdl, void *iter)
+{
+	DBusMessageIter *iterp = iter;
+	DBusMessageIter array_iter, struct_iter;
+	struct prof_fsal_export *exp;
+	struct glist_head *glist;
+	struct timespec timestamp;
+
+	if (iterp == NULL)
+		return true;
+
+	now(&timestamp);
+	dbus_append_timestamp(iterp, &timestamp);
+
+	prof_dbus_ops(&PROF.stats, iterp);
+
+	dbus_message_iter_open_container(iterp, DBUS_TYPE_ARRAY,
+					 "(qa" FSAL_OP_STATS_TYPE ")",
+					 &array_iter);
+	PTHREAD_RWLOCK_rdlock(&fsal_hdl->lock);
+	glist_for_each(glist, &fsal_hdl->exports) {
+		exp = container_of(glist, struct prof_fsal_export,
+				   export.exports);
+		dbus_message_iter_open_container(&array_iter,
+						 DBUS_TYPE_STRUCT, NULL,
+						 &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter,
+					       DBUS_TYPE_UINT16,
+					       &exp->export_id);
+		prof_dbus_ops(&exp->stats, &struct_iter);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	PTHREAD_RWLOCK_unlock(&fsal_hdl->lock);
+	dbus_message_iter_close_container(iterp, &array_iter);
+
+	return true;
+}
+
+#endif				/* USE_DBUS */
+
+static void prof_reset_stats(struct fsal_module *fsal_hdl)
+{
+	struct prof_fsal_export *exp;
+	struct glist_head *glist;
+
+	prof_stats_reset(&PROF.stats);
+
+	PTHREAD_RWLOCK_rdlock(&fsal_hdl->lock);
+	glist_for_each(glist, &fsal_hdl->exports) {
+		exp = container_of(glist, struct prof_fsal_export,
+				   export.exports);
+		prof_stats_reset(&exp->stats);
+	}
+	PTHREAD_RWLOCK_unlock(&fsal_hdl->lock);
+}
+
+/* Module initialization.
+ * Called by dlopen() to register the module
+ * keep a private pointer to me in myself
+ */
+
+/* my module private storage
+ */
+
+struct prof_fsal_module PROF;
+struct next_ops next_ops;
+
+/* linkage to the exports and handle ops initializers
+ */
+
+MODULE_INIT void prof_init(void)
+{
+	int retval;
+	struct fsal_module *myself = &PROF.fsal;
+
+	retval = register_fsal(myself, myname, FSAL_MAJOR_VERSION,
+			       FSAL_MINOR_VERSION, FSAL_ID_NO_PNFS);
+	if (retval != 0) {
+		fprintf(stderr, "PROF module failed to register");
+		return;
+	}
+	myself->m_ops.create_export = prof_create_export;
+	myself->m_ops.init_config = init_config;
+#ifdef USE_DBUS
+	myself->m_ops.fsal_extract_stats = prof_extract_stats;
+#endif
+	myself->m_ops.fsal_reset_stats = prof_reset_stats;
+
+	PTHREAD_MUTEX_init(&PROF.dump_mutex, NULL);
+	pthread_cond_init(&PROF.dump_cond, NULL);
+}
+
+MODULE_FINI void prof_unload(void)
+{
+	int retval;
+
+	if (PROF.dump_running) {
+		PTHREAD_MUTEX_lock(&PROF.dump_mutex);
+		PROF.dump_running = false;
+		pthread_cond_signal(&PROF.dump_cond);
+		PTHREAD_MUTEX_unlock(&PROF.dump_mutex);
+		pthread_join(PROF.dump_thread, NULL);
+	}
+
+	retval = unregister_fsal(&PROF.fsal);
+	if (retval != 0) {
+		fprintf(stderr, "PROF module failed to unregister");
+		return;
+	}
+
+	prof_stats_destroy(&PROF.stats);
+	PTHREAD_MUTEX_destroy(&PROF.dump_mutex);
+	pthread_cond_destroy(&PROF.dump_cond);
+}
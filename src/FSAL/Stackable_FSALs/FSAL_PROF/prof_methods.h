@@ -0,0 +1,283 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* PROF methods for handles
+ */
+
+#ifndef PROF_METHODS_H
+#define PROF_METHODS_H
+
+#include "latency_histogram.h"
+
+/**
+ * @brief The methods PROF times
+ */
+
+enum prof_op {
+	PROF_OP_LOOKUP,
+	PROF_OP_READDIR,
+	PROF_OP_CREATE,
+	PROF_OP_MKDIR,
+	PROF_OP_MKNODE,
+	PROF_OP_SYMLINK,
+	PROF_OP_READLINK,
+	PROF_OP_GETATTRS,
+	PROF_OP_SETATTRS,
+	PROF_OP_LINK,
+	PROF_OP_RENAME,
+	PROF_OP_UNLINK,
+	PROF_OP_OPEN,
+	PROF_OP_READ,
+	PROF_OP_WRITE,
+	PROF_OP_COMMIT,
+	PROF_OP_LOCK,
+	PROF_OP_SHARE,
+	PROF_OP_CLOSE,
+	PROF_OP_LRU_CLEANUP,
+	PROF_OP_LIST_XATTRS,
+	PROF_OP_GET_XATTR,	/*< by name or id, value or attributes */
+	PROF_OP_SET_XATTR,
+	PROF_OP_REMOVE_XATTR,
+	PROF_OP_LOOKUP_PATH,
+	PROF_OP_CREATE_HANDLE,
+	PROF_OP_DYNAMIC_INFO,
+	PROF_OP_COUNT
+};
+
+extern const char *prof_op_names[PROF_OP_COUNT];
+
+/**
+ * @brief What is kept of one method
+ *
+ * The counters are updated atomically; calls, errors, bytes and
+ * outliers count completed calls, inflight those not yet returned.
+ */
+
+struct prof_op_stats {
+	uint64_t calls;
+	uint64_t errors;
+	uint64_t inflight;
+	uint64_t bytes;			/*< Read or written */
+	uint64_t outliers;		/*< Calls over Outlier_Threshold */
+	struct lat_hist_shards latency;	/*< Nanoseconds per call */
+};
+
+struct prof_stats {
+	struct prof_op_stats op[PROF_OP_COUNT];
+};
+
+/**
+ * @brief Percentiles and counters of one method, as reported
+ */
+
+struct prof_summary {
+	uint64_t calls;
+	uint64_t errors;
+	uint64_t inflight;
+	uint64_t bytes;
+	uint64_t outliers;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+bool prof_stats_init(struct prof_stats *stats, uint32_t nshards);
+void prof_stats_destroy(struct prof_stats *stats);
+void prof_stats_reset(struct prof_stats *stats);
+void prof_summarize(struct prof_op_stats *st, struct prof_summary *sum);
+
+/**
+ * @brief The PROF block
+ */
+
+struct prof_params {
+	uint32_t outlier_threshold;	/*< Microseconds, 0 off */
+	uint32_t dump_interval;		/*< Seconds, 0 off */
+};
+
+struct prof_fsal_module {
+	struct fsal_module fsal;
+	struct fsal_staticfsinfo_t fs_info;
+	struct prof_params params;
+	struct prof_stats stats;	/*< Over all exports */
+	pthread_t dump_thread;
+	pthread_mutex_t dump_mutex;
+	pthread_cond_t dump_cond;
+	bool dump_running;
+};
+
+extern struct prof_fsal_module PROF;
+
+struct next_ops {
+	struct export_ops exp_ops;	/*< Vector of operations */
+	struct fsal_obj_ops obj_ops;	/*< Shared handle methods vector */
+	struct fsal_dsh_ops dsh_ops;	/*< Shared handle methods vector */
+	const struct fsal_up_vector *up_ops;	/*< Upcall operations */
+};
+
+/**
+ * Structure used to store data for read_dirents callback.
+ *
+ * Before executing the upper level callback (it might be another
+ * stackable fsal or the inode cache), the context has to be restored.
+ */
+struct prof_readdir_state {
+	fsal_readdir_cb cb; /*< Callback to the upper layer. */
+	struct prof_fsal_export *exp; /*< Export of the current PROF. */
+	void *dir_state; /*< State to be sent to the next callback. */
+};
+
+extern struct next_ops next_ops;
+void prof_handle_ops_init(struct fsal_obj_ops *ops);
+
+/*
+ * PROF internal export
+ */
+struct prof_fsal_export {
+	struct fsal_export export;
+	struct fsal_export *sub_export;
+	uint16_t export_id;
+	struct prof_stats stats;	/*< Of this export alone */
+};
+
+fsal_status_t prof_lookup_path(struct fsal_export *exp_hdl,
+			       const char *path,
+			       struct fsal_obj_handle **handle);
+
+fsal_status_t prof_create_handle(struct fsal_export *exp_hdl,
+				 struct gsh_buffdesc *hdl_desc,
+				 struct fsal_obj_handle **handle);
+
+/*
+ * PROF internal object handle
+ *
+ * It contains a pointer to the fsal_obj_handle used by the subfsal.
+ */
+
+struct prof_fsal_obj_handle {
+	struct fsal_obj_handle obj_handle; /*< Handle containing PROF data.*/
+	struct fsal_obj_handle *sub_handle; /*< Handle of the sub fsal.*/
+};
+
+/**
+ * @brief A timed call down the stack
+ */
+
+struct prof_call {
+	struct prof_fsal_export *export;
+	enum prof_op op;
+	struct timespec start;
+};
+
+/**
+ * @brief Start timing a call to the sub FSAL
+ *
+ * @param[out] call   Timing state, passed to prof_end
+ * @param[in]  export The PROF export the call is made on
+ * @param[in]  op     The method called
+ */
+
+static inline void prof_begin(struct prof_call *call,
+			      struct prof_fsal_export *export,
+			      enum prof_op op)
+{
+	call->export = export;
+	call->op = op;
+	(void)atomic_inc_uint64_t(&PROF.stats.op[op].inflight);
+	(void)atomic_inc_uint64_t(&export->stats.op[op].inflight);
+	now(&call->start);
+}
+
+void prof_end(struct prof_call *call, struct fsal_obj_handle *sub_handle,
+	      fsal_status_t status, uint64_t bytes);
+
+	/* I/O management */
+fsal_status_t prof_open(struct fsal_obj_handle *obj_hdl,
+			fsal_openflags_t openflags);
+fsal_openflags_t prof_status(struct fsal_obj_handle *obj_hdl);
+fsal_status_t prof_read(struct fsal_obj_handle *obj_hdl,
+			uint64_t offset,
+			size_t buffer_size, void *buffer,
+			size_t *read_amount, bool *end_of_file);
+fsal_status_t prof_write(struct fsal_obj_handle *obj_hdl,
+			 uint64_t offset,
+			 size_t buffer_size, void *buffer,
+			 size_t *write_amount, bool *fsal_stable);
+fsal_status_t prof_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
+			  off_t offset, size_t len);
+fsal_status_t prof_lock_op(struct fsal_obj_handle *obj_hdl,
+			   void *p_owner,
+			   fsal_lock_op_t lock_op,
+			   fsal_lock_param_t *request_lock,
+			   fsal_lock_param_t *conflicting_lock);
+fsal_status_t prof_share_op(struct fsal_obj_handle *obj_hdl, void *p_owner,
+			    fsal_share_param_t request_share);
+fsal_status_t prof_close(struct fsal_obj_handle *obj_hdl);
+fsal_status_t prof_lru_cleanup(struct fsal_obj_handle *obj_hdl,
+			       lru_actions_t requests);
+
+/* extended attributes management */
+fsal_status_t prof_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
+				  unsigned int cookie,
+				  fsal_xattrent_t *xattrs_tab,
+				  unsigned int xattrs_tabsize,
+				  unsigned int *p_nb_returned,
+				  int *end_of_list);
+fsal_status_t prof_getextattr_id_by_name(struct fsal_obj_handle *obj_hdl,
+					 const char *xattr_name,
+					 unsigned int *pxattr_id);
+fsal_status_t prof_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
+					    const char *xattr_name,
+					    caddr_t buffer_addr,
+					    size_t buffer_size,
+					    size_t *p_output_size);
+fsal_status_t prof_getextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					  unsigned int xattr_id,
+					  caddr_t buffer_addr,
+					  size_t buffer_size,
+					  size_t *p_output_size);
+fsal_status_t prof_setextattr_value(struct fsal_obj_handle *obj_hdl,
+				    const char *xattr_name,
+				    caddr_t buffer_addr, size_t buffer_size,
+				    int create);
+fsal_status_t prof_setextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
+					  unsigned int xattr_id,
+					  caddr_t buffer_addr,
+					  size_t buffer_size);
+fsal_status_t prof_getextattr_attrs(struct fsal_obj_handle *obj_hdl,
+				    unsigned int xattr_id,
+				    struct attrlist *p_attrs);
+fsal_status_t prof_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
+					unsigned int xattr_id);
+fsal_status_t prof_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
+					  const char *xattr_name);
+
+/* Internal PROF method linkage to export object
+ */
+
+fsal_status_t prof_create_export(struct fsal_module *fsal_hdl,
+				 void *parse_node,
+				 struct config_error_type *err_type,
+				 const struct fsal_up_vector *up_ops);
+
+#endif /* PROF_METHODS_H */
@@ -346,6 +346,161 @@ nfsstat4 FSAL_encode_v4_multipath(XDR *xdrs, const uint32_t num_hosts,
 	return NFS4_OK;
 }
 
+/*
+ * Functions specific to FLEX_FILES layouts
+ */
+
+/**
+ * @brief Convenience function to encode a flex files loc_body
+ *
+ * This function encodes an ff_layout4 of one data server per mirror,
+ * each given the handle this server has for the file.  The data
+ * servers must export the same file system under the same Export_Id
+ * to recognize it.  They are loosely coupled: the client reaches them
+ * with the anonymous stateid and the AUTH_SYS credentials of @c user
+ * and @c group.
+ *
+ * @param[out] xdrs        XDR stream
+ * @param[in]  obj_hdl     The file
+ * @param[in]  stripe_unit Stripe unit, 0 for no striping
+ * @param[in]  num_mirrors Number of mirrors
+ * @param[in]  mirrors     The data server of each mirror
+ * @param[in]  user        User the client is to reach them as
+ * @param[in]  group       Group the client is to reach them as
+ * @param[in]  flags       ff_flags4 of the layout
+ * @param[in]  stats_hint  Seconds between LAYOUTSTATS, 0 for none
+ *
+ * @return NFS status codes.
+ */
+
+nfsstat4 FSAL_encode_flex_file_layout(XDR *xdrs,
+				      const struct fsal_obj_handle *obj_hdl,
+				      const length4 stripe_unit,
+				      const uint32_t num_mirrors,
+				      const fsal_ff_mirror_t *mirrors,
+				      const uid_t user, const gid_t group,
+				      const ff_flags4 flags,
+				      const uint32_t stats_hint)
+{
+	/* Handles of the file for NFSv3 and NFSv4 data servers */
+	char fh3_buf[NFS3_FHSIZE], fh4_buf[NFS4_FHSIZE];
+	nfs_fh3 fh3 = { .data.data_val = fh3_buf };
+	nfs_fh4 fh4 = { .nfs_fh4_val = fh4_buf };
+	/* Owner strings of the synthetic credentials */
+	char user_buf[16], group_buf[16];
+	fattr4_owner ds_user = { .utf8string_val = user_buf };
+	fattr4_owner_group ds_group = { .utf8string_val = group_buf };
+	stateid4 anonymous;
+	uint32_t one = 1;
+	length4 su = stripe_unit;
+	uint32_t n = num_mirrors, f = flags, hint = stats_hint;
+	uint32_t efficiency;
+	size_t i;
+
+	if (!nfs3_FSALToFhandle(&fh3, obj_hdl, op_ctx->export) ||
+	    !nfs4_FSALToFhandle(&fh4, obj_hdl, op_ctx->export)) {
+		LogMajor(COMPONENT_PNFS, "Failed making handles.");
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	memset(&anonymous, 0, sizeof(anonymous));
+	ds_user.utf8string_len = snprintf(user_buf, sizeof(user_buf), "%u",
+					  (unsigned int) user);
+	ds_group.utf8string_len = snprintf(group_buf, sizeof(group_buf),
+					   "%u", (unsigned int) group);
+
+	if (!xdr_length4(xdrs, &su) || !xdr_uint32_t(xdrs, &n)) {
+		LogMajor(COMPONENT_PNFS, "Failed encoding ff_layout4.");
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	for (i = 0; i < num_mirrors; i++) {
+		efficiency = mirrors[i].efficiency;
+
+		/* One data server in the mirror, with one handle */
+		if (!xdr_uint32_t(xdrs, &one) ||
+		    !xdr_fsal_deviceid(xdrs,
+				(struct pnfs_deviceid *)&mirrors[i].deviceid) ||
+		    !xdr_uint32_t(xdrs, &efficiency) ||
+		    !xdr_stateid4(xdrs, &anonymous) ||
+		    !xdr_uint32_t(xdrs, &one)) {
+			LogMajor(COMPONENT_PNFS, "Failed encoding mirror %zu.",
+				 i);
+			return NFS4ERR_SERVERFAULT;
+		}
+
+		if (mirrors[i].version == NFS_V3) {
+			if (!xdr_bytes(xdrs, &fh3.data.data_val,
+				       &fh3.data.data_len, NFS3_FHSIZE)) {
+				LogMajor(COMPONENT_PNFS,
+					 "Failed encoding FH %zu.", i);
+				return NFS4ERR_SERVERFAULT;
+			}
+		} else if (!xdr_nfs_fh4(xdrs, &fh4)) {
+			LogMajor(COMPONENT_PNFS, "Failed encoding FH %zu.", i);
+			return NFS4ERR_SERVERFAULT;
+		}
+
+		if (!xdr_fattr4_owner(xdrs, &ds_user) ||
+		    !xdr_fattr4_owner_group(xdrs, &ds_group)) {
+			LogMajor(COMPONENT_PNFS,
+				 "Failed encoding owner of mirror %zu.", i);
+			return NFS4ERR_SERVERFAULT;
+		}
+	}
+
+	if (!xdr_uint32_t(xdrs, &f) || !xdr_uint32_t(xdrs, &hint)) {
+		LogMajor(COMPONENT_PNFS, "Failed encoding ff_flags4.");
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Convenience function to encode a flex files da_addr_body
+ *
+ * This function encodes an ff_device_addr4 of a data server reached
+ * at one address by one NFS version, loosely coupled.
+ *
+ * @param[out] xdrs    XDR stream
+ * @param[in]  host    Address of the data server
+ * @param[in]  version NFS_V3, or NFS_V4 for NFSv4.1
+ * @param[in]  rsize   Largest READ the data server takes
+ * @param[in]  wsize   Largest WRITE the data server takes
+ *
+ * @return NFS status codes.
+ */
+
+nfsstat4 FSAL_encode_ff_device_addr(XDR *xdrs,
+				    const fsal_multipath_member_t *host,
+				    const uint32_t version,
+				    const uint32_t rsize,
+				    const uint32_t wsize)
+{
+	ff_device_versions4 ver = {
+		.ffdv_version = version,
+		.ffdv_minorversion = version == NFS_V3 ? 0 : 1,
+		.ffdv_rsize = rsize,
+		.ffdv_wsize = wsize,
+		.ffdv_tightly_coupled = false
+	};
+	uint32_t one = 1;
+	nfsstat4 nfs_status;
+
+	nfs_status = FSAL_encode_v4_multipath(xdrs, 1, host);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	if (!xdr_uint32_t(xdrs, &one) ||
+	    !xdr_ff_device_versions4(xdrs, &ver)) {
+		LogMajor(COMPONENT_PNFS, "Failed encoding ff_device_addr4.");
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	return NFS4_OK;
+}
+
 /**
  * @brief Convert POSIX error codes to NFS 4 error codes
  *
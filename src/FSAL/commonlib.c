@@ -67,6 +67,7 @@
 #include <uuid/uuid.h>
 #endif
 #include "fsal_api.h"
+#include "abstract_atomic.h"
 #include "FSAL/fsal_commonlib.h"
 #include "FSAL/access_check.h"
 #include "fsal_private.h"
@@ -1072,11 +1073,91 @@ static void posix_create_file_system(struct mntent *mnt)
 		fs->fsid.major, fs->fsid.minor);
 }
 
-static void posix_find_parent(struct fsal_filesystem *this)
+/**
+ * @brief Compare a path to the path of a file system
+ */
+
+static int fs_path_cmp(const char *path, size_t len,
+		       const struct fsal_filesystem *fs)
 {
-	struct glist_head *glist;
+	size_t min = len < fs->pathlen ? len : fs->pathlen;
+	int rc = memcmp(path, fs->path, min);
+
+	if (rc != 0)
+		return rc;
+	if (len == fs->pathlen)
+		return 0;
+	return len < fs->pathlen ? -1 : 1;
+}
+
+/** A file system and its place in posix_file_systems */
+struct fs_sorted {
 	struct fsal_filesystem *fs;
-	int plen = 0;
+	size_t order;
+};
+
+/**
+ * @brief Order file systems by path, then by mount order
+ */
+
+static int fs_path_sort_cmp(const void *a, const void *b)
+{
+	const struct fs_sorted *s1 = a;
+	const struct fs_sorted *s2 = b;
+	int rc = fs_path_cmp(s1->fs->path, s1->fs->pathlen, s2->fs);
+
+	if (rc != 0)
+		return rc;
+	return s1->order < s2->order ? -1 : s1->order != s2->order;
+}
+
+/**
+ * @brief Find the last mounted file system on exactly a path
+ *
+ * @param[in] sorted File systems sorted by fs_path_sort_cmp
+ * @param[in] count  Number of them
+ */
+
+static struct fsal_filesystem *fs_find_path(struct fs_sorted *sorted,
+					    size_t count, const char *path,
+					    size_t len)
+{
+	size_t lo = 0, hi = count, mid;
+
+	/* First entry not before path */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (fs_path_cmp(path, len, sorted[mid].fs) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == count || fs_path_cmp(path, len, sorted[lo].fs) != 0)
+		return NULL;
+
+	while (lo + 1 < count && fs_path_cmp(path, len, sorted[lo + 1].fs) == 0)
+		lo++;
+
+	return sorted[lo].fs;
+}
+
+/**
+ * @brief Attach a file system to the nearest one mounted above it
+ *
+ * Each ancestor directory of the path, from the nearest, is looked
+ * up in the sorted file systems, so building the tree takes
+ * O(n log n) rather than a scan of every file system for each.
+ *
+ * @param[in] this   File system to attach
+ * @param[in] sorted All file systems, sorted by fs_path_sort_cmp
+ * @param[in] count  Number of them
+ */
+
+static void posix_find_parent(struct fsal_filesystem *this,
+			      struct fs_sorted *sorted, size_t count)
+{
+	size_t len;
 
 	/* Check if it already has parent */
 	if (this->parent != NULL)
@@ -1086,32 +1167,16 @@ static void posix_find_parent(struct fsal_filesystem *this)
 	if (this->pathlen == 1 && this->path[0] == '/')
 		return;
 
-	glist_for_each(glist, &posix_file_systems) {
-		fs = glist_entry(glist, struct fsal_filesystem, filesystems);
-
-		/* If this path is longer than this path, then it
-		 * can't be a parent, or if it's shorter than the
-		 * current match;
-		 */
-		if (fs->pathlen >= this->pathlen ||
-		    fs->pathlen < plen)
-			continue;
-
-		/* Check for sub-string match */
-		if (strncmp(fs->path, this->path, fs->pathlen) != 0)
-			continue;
-
-		/* Differentiate between /fs1 and /fs10 for parent of
-		 * /fs10/fs2, however, if fs->path is "/", we need to
-		 * special case.
-		 */
-		if (fs->pathlen != 1 &&
-		    this->path[fs->pathlen] != '/')
-			continue;
+	/* Differentiate between /fs1 and /fs10 for parent of /fs10/fs2
+	 * by only trying prefixes ending before a '/', and "/" last.
+	 */
+	for (len = this->pathlen - 1; len > 0 && this->parent == NULL; len--)
+		if (this->path[len] == '/')
+			this->parent = fs_find_path(sorted, count,
+						    this->path, len);
 
-		this->parent = fs;
-		plen = fs->pathlen;
-	}
+	if (this->parent == NULL && this->path[0] == '/')
+		this->parent = fs_find_path(sorted, count, "/", 1);
 
 	if (this->parent == NULL) {
 		LogInfo(COMPONENT_FSAL,
@@ -1155,6 +1220,8 @@ int populate_posix_file_systems(bool force)
 	int retval = 0;
 	struct glist_head *glist;
 	struct fsal_filesystem *fs;
+	struct fs_sorted *sorted;
+	size_t count = 0, i;
 
 	PTHREAD_RWLOCK_wrlock(&fs_lock);
 
@@ -1187,12 +1254,36 @@ int populate_posix_file_systems(bool force)
 	endmntent(fp);
 
 	/* build tree of POSIX file systems */
+	glist_for_each(glist, &posix_file_systems)
+		count++;
+
+	sorted = gsh_malloc((count + 1) * sizeof(*sorted));
+	if (sorted == NULL) {
+		retval = ENOMEM;
+		LogCrit(COMPONENT_FSAL,
+			"Could not allocate file system tree");
+		goto out;
+	}
+
+	i = 0;
+	glist_for_each(glist, &posix_file_systems) {
+		sorted[i].fs = glist_entry(glist, struct fsal_filesystem,
+					   filesystems);
+		sorted[i].order = i;
+		i++;
+	}
+
+	qsort(sorted, count, sizeof(*sorted), fs_path_sort_cmp);
+
 	glist_for_each(glist, &posix_file_systems) {
 		posix_find_parent(glist_entry(glist,
 					      struct fsal_filesystem,
-					      filesystems));
+					      filesystems),
+				  sorted, count);
 	}
 
+	gsh_free(sorted);
+
 	/* show tree */
 	glist_for_each(glist, &posix_file_systems) {
 		fs = glist_entry(glist, struct fsal_filesystem, filesystems);
@@ -1448,8 +1539,7 @@ int claim_posix_filesystems(const char *path,
 			    struct fsal_filesystem **root_fs)
 {
 	int retval = 0;
-	struct fsal_filesystem *fs, *root = NULL;
-	struct glist_head *glist;
+	struct fsal_filesystem *root = NULL;
 	struct stat statbuf;
 	struct fsal_dev__ dev;
 
@@ -1463,14 +1553,8 @@ int claim_posix_filesystems(const char *path,
 	}
 	dev = posix2fsal_devt(statbuf.st_dev);
 
-	/* Scan POSIX file systems to find export root fs */
-	glist_for_each(glist, &posix_file_systems) {
-		fs = glist_entry(glist, struct fsal_filesystem, filesystems);
-		if (fs->dev.major == dev.major && fs->dev.minor == dev.minor) {
-			root = fs;
-			break;
-		}
-	}
+	/* Every POSIX file system is indexed by device */
+	root = lookup_dev_locked(&dev);
 
 	/* Check if we found a filesystem */
 	if (root == NULL) {
@@ -2026,4 +2110,92 @@ fsal_status_t fsal_acl_to_mode(struct attrlist *attrs)
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+struct fsal_sync_stats fsal_sync_stats;
+
+void fsal_sync_group_init(struct fsal_sync_group *sg)
+{
+	memset(sg, 0, sizeof(*sg));
+	PTHREAD_MUTEX_init(&sg->mtx, NULL);
+	PTHREAD_COND_init(&sg->cv, NULL);
+}
+
+void fsal_sync_group_destroy(struct fsal_sync_group *sg)
+{
+	PTHREAD_COND_destroy(&sg->cv);
+	PTHREAD_MUTEX_destroy(&sg->mtx);
+}
+
+/**
+ * @brief Make what was written to a file stable
+ *
+ * Waits for a sync of fd that starts after the call.  If one is
+ * already running, the range is pushed to writeback so the next sync
+ * has less left to do, then the caller waits for that next sync, made
+ * by the first waiter to find the file idle.  The sync is an
+ * fdatasync: the file size is kept, which is all the data needs.
+ *
+ * @param[in] sg     Sync group of the file
+ * @param[in] fd     Descriptor to sync, open for all the callers
+ * @param[in] offset Start of the range written
+ * @param[in] len    Length of the range, 0 for the whole file
+ *
+ * @return 0 or the errno of a sync that failed since the call.
+ */
+
+int fsal_sync_group_sync(struct fsal_sync_group *sg, int fd,
+			 uint64_t offset, uint64_t len)
+{
+	uint64_t target, mine;
+	int rc = 0;
+
+	(void)atomic_inc_uint64_t(&fsal_sync_stats.requests);
+
+	PTHREAD_MUTEX_lock(&sg->mtx);
+
+	/* The first sync to start after now covers us */
+	target = sg->started + 1;
+
+#ifdef SYNC_FILE_RANGE_WRITE
+	if (sg->running && len != 0) {
+		PTHREAD_MUTEX_unlock(&sg->mtx);
+		if (sync_file_range(fd, offset, len,
+				    SYNC_FILE_RANGE_WRITE) == 0)
+			(void)atomic_inc_uint64_t(
+					&fsal_sync_stats.writebacks);
+		PTHREAD_MUTEX_lock(&sg->mtx);
+	}
+#endif
+
+	while (sg->done < target) {
+		if (sg->running) {
+			pthread_cond_wait(&sg->cv, &sg->mtx);
+			continue;
+		}
+
+		/* Our turn to sync for everyone waiting */
+		sg->running = true;
+		mine = ++sg->started;
+		PTHREAD_MUTEX_unlock(&sg->mtx);
+
+		(void)atomic_inc_uint64_t(&fsal_sync_stats.syncs);
+		rc = fdatasync(fd) == 0 ? 0 : errno;
+
+		PTHREAD_MUTEX_lock(&sg->mtx);
+		if (rc != 0) {
+			sg->failed = mine;
+			sg->error = rc;
+		}
+		sg->done = mine;
+		sg->running = false;
+		pthread_cond_broadcast(&sg->cv);
+	}
+
+	/* Report any failure since we came, it may have been our data */
+	rc = sg->failed >= target ? sg->error : 0;
+
+	PTHREAD_MUTEX_unlock(&sg->mtx);
+
+	return rc;
+}
+
 /** @} */
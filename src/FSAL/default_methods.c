@@ -180,6 +180,49 @@ static size_t fs_da_addr_size(struct fsal_module *fsal_hdl)
 	return 0;
 }
 
+/**
+ * @brief Ignore a device error
+ */
+
+static nfsstat4 layouterror(struct fsal_module *fsal_hdl,
+			    const layouttype4 type,
+			    const struct pnfs_deviceid *deviceid,
+			    nfsstat4 status, nfs_opnum4 opnum)
+{
+	return NFS4_OK;
+}
+
+/**
+ * @brief Ignore device I/O statistics
+ */
+
+static nfsstat4 layoutstats(struct fsal_module *fsal_hdl,
+			    const layouttype4 type,
+			    const struct pnfs_deviceid *deviceid,
+			    const io_info4 *read, const io_info4 *write,
+			    XDR *lou_body)
+{
+	return NFS4_OK;
+}
+
+/**
+ * @brief No statistics to give
+ */
+
+static bool fsal_extract_stats(struct fsal_module *fsal_hdl, void *iter)
+{
+	return false;
+}
+
+/**
+ * @brief No statistics to zero
+ */
+
+static void fsal_reset_stats(struct fsal_module *fsal_hdl)
+{
+	/* return */
+}
+
 /**
  * @brief Try to create a FSAL pNFS data server
  *
@@ -233,6 +276,10 @@ struct fsal_ops def_fsal_ops = {
 	.fs_da_addr_size = fs_da_addr_size,
 	.fsal_pnfs_ds = fsal_pnfs_ds,
 	.fsal_pnfs_ds_ops = fsal_pnfs_ds_ops,
+	.layouterror = layouterror,
+	.layoutstats = layoutstats,
+	.fsal_extract_stats = fsal_extract_stats,
+	.fsal_reset_stats = fsal_reset_stats,
 };
 
 /* export_release
@@ -48,6 +48,11 @@
  * returns it after execution.
  *
  * Every async call returns 0 on success and a POSIX error code on error.
+ *
+ * With Upcall_Batch set, invalidations and updates for the top level
+ * vector that need no callback skip the fridge and go straight into
+ * the current batch (see fsal_up_batch.c).  The synchronous methods of
+ * the vector are never batched.
  */
 
 #include "config.h"
@@ -99,6 +104,11 @@ int up_async_invalidate(struct fridgethr *fr,
 	struct invalidate_args *args = NULL;
 	int rc = 0;
 
+	if (cache_param.upcall_batch.enabled && cb == NULL &&
+	    up_ops == &fsal_up_top &&
+	    up_batch_event(fsal, obj, flags, NULL, 0) == 0)
+		return 0;
+
 	args = gsh_malloc(sizeof(struct invalidate_args) + obj->len);
 	if (!args) {
 		rc = ENOMEM;
@@ -160,6 +170,15 @@ int up_async_update(struct fridgethr *fr,
 	struct update_args *args = NULL;
 	int rc = 0;
 
+	if (cache_param.upcall_batch.enabled && cb == NULL &&
+	    up_ops == &fsal_up_top) {
+		/* A batch has no one to tell about a bad update */
+		if (up_update_check(attr, flags) != CACHE_INODE_SUCCESS)
+			return EINVAL;
+		if (up_batch_event(fsal, obj, 0, attr, flags) == 0)
+			return 0;
+	}
+
 	args = gsh_malloc(sizeof(struct update_args) + obj->len);
 	if (!args) {
 		rc = ENOMEM;
@@ -0,0 +1,362 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup fsal_up
+ * @{
+ */
+
+/**
+ * @file fsal_up_batch.c
+ * @brief Batching of invalidate and update upcalls
+ *
+ * With Upcall_Batch set, asynchronous invalidations and attribute
+ * updates from the FSALs are not applied one by one.  They are collected in a batch,
+ * keyed by FSAL and object, so that all the upcalls for one object
+ * become a single event: invalidation flags are or-ed together, and
+ * updates with the same flags are merged field by field, the newest
+ * value winning except for fields the flags only let grow.  Updates
+ * that cannot be merged (different flags, or an ACL) turn into an
+ * attribute invalidation, which is always safe.
+ *
+ * A batch is handed to the general fridge Upcall_Batch_Delay ms after
+ * its first event, or as soon as it holds Upcall_Batch_Size objects.
+ * Each object is then looked up once and its attributes locked once.
+ *
+ * Batched upcalls report success at once; errors, including objects
+ * that are not cached, are only logged.  Upcalls with a completion
+ * callback are never batched, nor are the synchronous methods of
+ * fsal_up_top, whose callers expect the cache to have changed when
+ * they return.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "nfs_core.h"
+#include "log.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "fsal_up.h"
+#include "abstract_atomic.h"
+#include "abstract_mem.h"
+#include "delayed_exec.h"
+#include "city.h"
+#include "gsh_list.h"
+
+/** Hash buckets of a batch */
+#define UP_BATCH_BUCKETS 1024
+
+/**
+ * @brief The merged upcalls of one object
+ */
+
+struct up_event {
+	struct glist_head list;		/*< In the batch, oldest first */
+	struct up_event *next;		/*< In the hash bucket */
+	uint64_t hash;
+	struct fsal_module *fsal;
+	uint32_t inval;			/*< cache_inode_invalidate flags */
+	bool update;			/*< attr holds an update */
+	uint32_t upflags;		/*< Flags of the update */
+	struct attrlist attr;
+	struct gsh_buffdesc obj;
+	char key[];
+};
+
+/**
+ * @brief A batch of upcalls
+ */
+
+struct up_batch {
+	struct glist_head events;
+	uint32_t nevents;
+	struct up_event *buckets[UP_BATCH_BUCKETS];
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	struct up_batch *cur;	/*< Batch being filled */
+	bool timer;		/*< A delayed dispatch is queued */
+} up_batcher = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+};
+
+struct fsal_up_batch_stats fsal_up_batch_st;
+
+/**
+ * @brief Merge a time, the newest wins if only growth is allowed
+ */
+
+static void merge_time(struct timespec *to, const struct timespec *from,
+		       bool had, bool inc)
+{
+	if (!had || !inc || gsh_time_cmp(from, to) > 0)
+		*to = *from;
+}
+
+/**
+ * @brief Merge an update into an event
+ *
+ * @return false if the updates cannot be merged.
+ */
+
+static bool merge_update(struct up_event *ev, const struct attrlist *attr,
+			 uint32_t upflags)
+{
+	struct attrlist *to = &ev->attr;
+	attrmask_t had = to->mask;
+
+	if (upflags != ev->upflags ||
+	    FSAL_TEST_MASK(attr->mask | had, ATTR_ACL))
+		return false;
+
+	if (FSAL_TEST_MASK(attr->mask, ATTR_SIZE) &&
+	    (!FSAL_TEST_MASK(had, ATTR_SIZE) ||
+	     !(upflags & fsal_up_update_filesize_inc) ||
+	     attr->filesize > to->filesize))
+		to->filesize = attr->filesize;
+
+	if (FSAL_TEST_MASK(attr->mask, ATTR_SPACEUSED) &&
+	    (!FSAL_TEST_MASK(had, ATTR_SPACEUSED) ||
+	     !(upflags & fsal_up_update_spaceused_inc) ||
+	     attr->spaceused > to->spaceused))
+		to->spaceused = attr->spaceused;
+
+	if (FSAL_TEST_MASK(attr->mask, ATTR_MODE))
+		to->mode = attr->mode;
+	if (FSAL_TEST_MASK(attr->mask, ATTR_NUMLINKS))
+		to->numlinks = attr->numlinks;
+	if (FSAL_TEST_MASK(attr->mask, ATTR_OWNER))
+		to->owner = attr->owner;
+	if (FSAL_TEST_MASK(attr->mask, ATTR_GROUP))
+		to->group = attr->group;
+	if (FSAL_TEST_MASK(attr->mask, ATTR_CHANGE))
+		to->change = attr->change;
+
+	if (FSAL_TEST_MASK(attr->mask, ATTR_ATIME))
+		merge_time(&to->atime, &attr->atime,
+			   FSAL_TEST_MASK(had, ATTR_ATIME),
+			   upflags & fsal_up_update_atime_inc);
+	if (FSAL_TEST_MASK(attr->mask, ATTR_CREATION))
+		merge_time(&to->creation, &attr->creation,
+			   FSAL_TEST_MASK(had, ATTR_CREATION),
+			   upflags & fsal_up_update_creation_inc);
+	if (FSAL_TEST_MASK(attr->mask, ATTR_CTIME))
+		merge_time(&to->ctime, &attr->ctime,
+			   FSAL_TEST_MASK(had, ATTR_CTIME),
+			   upflags & fsal_up_update_ctime_inc);
+	if (FSAL_TEST_MASK(attr->mask, ATTR_MTIME))
+		merge_time(&to->mtime, &attr->mtime,
+			   FSAL_TEST_MASK(had, ATTR_MTIME),
+			   upflags & fsal_up_update_mtime_inc);
+	if (FSAL_TEST_MASK(attr->mask, ATTR_CHGTIME))
+		merge_time(&to->chgtime, &attr->chgtime,
+			   FSAL_TEST_MASK(had, ATTR_CHGTIME),
+			   upflags & fsal_up_update_chgtime_inc);
+
+	if (attr->expire_time_attr != 0)
+		to->expire_time_attr = attr->expire_time_attr;
+
+	to->mask |= attr->mask;
+	return true;
+}
+
+/**
+ * @brief Apply a batch
+ *
+ * @param[in] ctx Thread context, the batch is the argument
+ */
+
+static void up_batch_run(struct fridgethr_context *ctx)
+{
+	struct up_batch *batch = ctx->arg;
+	struct glist_head *node, *noden;
+	struct up_event *ev;
+	cache_inode_status_t rc;
+
+	glist_for_each_safe(node, noden, &batch->events) {
+		ev = glist_entry(node, struct up_event, list);
+
+		rc = up_apply_batched(ev->fsal, &ev->obj, ev->inval,
+				      ev->update ? &ev->attr : NULL,
+				      ev->upflags);
+		if (rc != CACHE_INODE_SUCCESS && rc != CACHE_INODE_NOT_FOUND)
+			LogDebug(COMPONENT_FSAL_UP,
+				 "Batched upcall failed: %s",
+				 cache_inode_err_str(rc));
+
+		glist_del(&ev->list);
+		gsh_free(ev);
+	}
+
+	(void)atomic_sub_uint64_t(&fsal_up_batch_st.depth, batch->nevents);
+	gsh_free(batch);
+}
+
+/**
+ * @brief Hand a batch to the general fridge
+ */
+
+static void up_batch_dispatch(struct up_batch *batch)
+{
+	struct fridgethr_context ctx;
+
+	if (batch == NULL)
+		return;
+
+	(void)atomic_inc_uint64_t(&fsal_up_batch_st.batches);
+
+	if (fridgethr_submit(general_fridge, up_batch_run, batch) != 0) {
+		/* Do it ourselves then */
+		memset(&ctx, 0, sizeof(ctx));
+		ctx.arg = batch;
+		up_batch_run(&ctx);
+	}
+}
+
+/**
+ * @brief Dispatch the current batch once its time is up
+ */
+
+static void up_batch_timer(void *arg)
+{
+	struct up_batch *batch;
+
+	PTHREAD_MUTEX_lock(&up_batcher.mtx);
+	batch = up_batcher.cur;
+	up_batcher.cur = NULL;
+	up_batcher.timer = false;
+	PTHREAD_MUTEX_unlock(&up_batcher.mtx);
+
+	up_batch_dispatch(batch);
+}
+
+/**
+ * @brief Add an upcall to the current batch
+ *
+ * @param[in] fsal    The FSAL
+ * @param[in] obj     Key of the object
+ * @param[in] inval   cache_inode_invalidate flags, may be 0
+ * @param[in] attr    Attribute update, NULL if none
+ * @param[in] upflags Flags of the update
+ *
+ * @return 0, or ENOMEM and the caller applies the upcall itself.
+ */
+
+int up_batch_event(struct fsal_module *fsal, struct gsh_buffdesc *obj,
+		   uint32_t inval, struct attrlist *attr, uint32_t upflags)
+{
+	struct up_batch *batch, *full = NULL;
+	struct up_event *ev;
+	uint64_t hash, depth;
+	uint32_t bucket;
+
+	hash = CityHash64WithSeed(obj->addr, obj->len, (uintptr_t) fsal);
+	bucket = hash % UP_BATCH_BUCKETS;
+
+	PTHREAD_MUTEX_lock(&up_batcher.mtx);
+
+	batch = up_batcher.cur;
+	if (batch == NULL) {
+		batch = gsh_calloc(1, sizeof(*batch));
+		if (batch == NULL)
+			goto nomem;
+		glist_init(&batch->events);
+		up_batcher.cur = batch;
+	}
+
+	for (ev = batch->buckets[bucket]; ev != NULL; ev = ev->next) {
+		if (ev->hash == hash && ev->fsal == fsal &&
+		    ev->obj.len == obj->len &&
+		    memcmp(ev->key, obj->addr, obj->len) == 0)
+			break;
+	}
+
+	if (ev != NULL) {
+		(void)atomic_inc_uint64_t(&fsal_up_batch_st.coalesced);
+	} else {
+		ev = gsh_calloc(1, sizeof(*ev) + obj->len);
+		if (ev == NULL)
+			goto nomem;
+		ev->hash = hash;
+		ev->fsal = fsal;
+		memcpy(ev->key, obj->addr, obj->len);
+		ev->obj.addr = ev->key;
+		ev->obj.len = obj->len;
+		ev->next = batch->buckets[bucket];
+		batch->buckets[bucket] = ev;
+		glist_add_tail(&batch->events, &ev->list);
+		batch->nevents++;
+
+		depth = atomic_inc_uint64_t(&fsal_up_batch_st.depth);
+		if (depth > atomic_fetch_uint64_t(&fsal_up_batch_st.max_depth))
+			atomic_store_uint64_t(&fsal_up_batch_st.max_depth,
+					      depth);
+	}
+
+	(void)atomic_inc_uint64_t(&fsal_up_batch_st.queued);
+
+	ev->inval |= inval;
+
+	if (attr != NULL) {
+		if (!ev->update) {
+			ev->update = true;
+			ev->upflags = upflags;
+			ev->attr = *attr;
+		} else if (!merge_update(ev, attr, upflags)) {
+			/* Let the FSAL tell us again */
+			ev->inval |= CACHE_INODE_INVALIDATE_ATTRS;
+			if ((upflags & fsal_up_nlink) && attr->numlinks == 0)
+				ev->inval |= CACHE_INODE_INVALIDATE_CLOSE;
+			if (FSAL_TEST_MASK(attr->mask, ATTR_ACL)) {
+				fsal_acl_status_t acl_status;
+
+				nfs4_acl_release_entry(attr->acl, &acl_status);
+			}
+		}
+	}
+
+	if (batch->nevents >= cache_param.upcall_batch.size) {
+		full = batch;
+		up_batcher.cur = NULL;
+	} else if (!up_batcher.timer) {
+		up_batcher.timer = true;
+		if (delayed_submit(up_batch_timer, NULL,
+				   (nsecs_elapsed_t)
+				   cache_param.upcall_batch.delay *
+				   NS_PER_MSEC) != 0) {
+			up_batcher.timer = false;
+			full = batch;
+			up_batcher.cur = NULL;
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&up_batcher.mtx);
+
+	up_batch_dispatch(full);
+	return 0;
+
+ nomem:
+	PTHREAD_MUTEX_unlock(&up_batcher.mtx);
+	return ENOMEM;
+}
+
+/** @} */
@@ -66,7 +66,7 @@ enum recall_resp_action {
 };
 
 static int schedule_delegrevoke_check(struct delegrecall_context *ctx,
-				      uint32_t delay);
+				      struct state_t *state, uint32_t delay);
 static int schedule_delegrecall_task(struct delegrecall_context *ctx,
 				     uint32_t delay);
 
@@ -119,24 +119,16 @@ cache_inode_status_t fsal_invalidate(struct fsal_module *fsal,
 }
 
 /**
- * @brief Update cached attributes
+ * @brief Check an attribute update
  *
- * @param[in] obj    Key to specify object
  * @param[in] attr   New attributes
  * @param[in] flags  Flags to govern update
  *
- * @return CACHE_INODE_SUCCESS or errors.
+ * @return CACHE_INODE_SUCCESS or CACHE_INODE_INVALID_ARGUMENT.
  */
 
-static cache_inode_status_t update(struct fsal_module *fsal,
-				   struct gsh_buffdesc *obj,
-				   struct attrlist *attr, uint32_t flags)
+cache_inode_status_t up_update_check(struct attrlist *attr, uint32_t flags)
 {
-	cache_entry_t *entry = NULL;
-	int rc = 0;
-	/* Have necessary changes been made? */
-	bool mutatis_mutandis = false;
-
 	/* These cannot be updated, changing any of them is
 	   tantamount to destroying and recreating the file. */
 	if (FSAL_TEST_MASK
@@ -156,23 +148,29 @@ static cache_inode_status_t update(struct fsal_module *fsal,
 		return CACHE_INODE_INVALID_ARGUMENT;
 	}
 
-	rc = up_get(fsal, obj, &entry);
-	if (rc != 0)
-		return rc;
-
-	/* Knock things out if the link count falls to 0. */
-
-	if ((flags & fsal_up_nlink) && (attr->numlinks == 0)) {
-		rc = cache_inode_invalidate(entry,
-					    (CACHE_INODE_INVALIDATE_ATTRS |
-					     CACHE_INODE_INVALIDATE_CLOSE));
-	}
-
-	if (rc != 0 || attr->mask == 0)
-		goto out;
+	return CACHE_INODE_SUCCESS;
+}
 
-	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+/**
+ * @brief Apply an attribute update to an entry
+ *
+ * Called with the attribute lock held for write.
+ *
+ * @param[in] entry  The entry
+ * @param[in] attr   New attributes
+ * @param[in] flags  Flags to govern update
+ *
+ * @return CACHE_INODE_SUCCESS, or CACHE_INODE_INCONSISTENT_ENTRY if
+ *         nothing changed and the attributes were invalidated.
+ */
 
+static cache_inode_status_t update_locked(cache_entry_t *entry,
+					  struct attrlist *attr,
+					  uint32_t flags)
+{
+	int rc = 0;
+	/* Have necessary changes been made? */
+	bool mutatis_mutandis = false;
 	struct attrlist *entry_attrs = entry->obj_handle->attrs;
 
 	if (attr->expire_time_attr != 0)
@@ -298,6 +296,48 @@ static cache_inode_status_t update(struct fsal_module *fsal,
 				       CACHE_INODE_INVALIDATE_GOT_LOCK);
 		rc = CACHE_INODE_INCONSISTENT_ENTRY;
 	}
+
+	return rc;
+}
+
+/**
+ * @brief Update cached attributes
+ *
+ * @param[in] obj    Key to specify object
+ * @param[in] attr   New attributes
+ * @param[in] flags  Flags to govern update
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t update(struct fsal_module *fsal,
+				   struct gsh_buffdesc *obj,
+				   struct attrlist *attr, uint32_t flags)
+{
+	cache_entry_t *entry = NULL;
+	int rc = 0;
+
+	rc = up_update_check(attr, flags);
+	if (rc != 0)
+		return rc;
+
+	rc = up_get(fsal, obj, &entry);
+	if (rc != 0)
+		return rc;
+
+	/* Knock things out if the link count falls to 0. */
+
+	if ((flags & fsal_up_nlink) && (attr->numlinks == 0)) {
+		rc = cache_inode_invalidate(entry,
+					    (CACHE_INODE_INVALIDATE_ATTRS |
+					     CACHE_INODE_INVALIDATE_CLOSE));
+	}
+
+	if (rc != 0 || attr->mask == 0)
+		goto out;
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+	rc = update_locked(entry, attr, flags);
 	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
 
  out:
@@ -305,6 +345,60 @@ static cache_inode_status_t update(struct fsal_module *fsal,
 	return rc;
 }
 
+/**
+ * @brief Apply the merged upcalls of one object
+ *
+ * The entry is looked up once and its attribute lock taken once for
+ * the update and the invalidation.  An update is applied first, so an
+ * invalidation that came before it in the batch still wins.
+ *
+ * @param[in] fsal   The FSAL
+ * @param[in] obj    Key of the object
+ * @param[in] inval  Merged cache_inode_invalidate flags, may be 0
+ * @param[in] attr   Merged attribute update, NULL if none
+ * @param[in] flags  Flags of the update
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+cache_inode_status_t up_apply_batched(struct fsal_module *fsal,
+				      struct gsh_buffdesc *obj,
+				      uint32_t inval, struct attrlist *attr,
+				      uint32_t flags)
+{
+	cache_entry_t *entry = NULL;
+	cache_inode_status_t rc;
+
+	rc = up_get(fsal, obj, &entry);
+	if (rc != 0)
+		return rc;
+
+	if (attr != NULL && (flags & fsal_up_nlink) && attr->numlinks == 0)
+		inval |= CACHE_INODE_INVALIDATE_ATTRS |
+			 CACHE_INODE_INVALIDATE_CLOSE;
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+
+	if (attr != NULL && attr->mask != 0)
+		rc = update_locked(entry, attr, flags);
+
+	if (inval & ~CACHE_INODE_INVALIDATE_CLOSE)
+		(void)cache_inode_invalidate(entry,
+					     (inval &
+					      ~CACHE_INODE_INVALIDATE_CLOSE) |
+					     CACHE_INODE_INVALIDATE_GOT_LOCK);
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	/* Closing must be done without the attribute lock */
+	if ((inval & CACHE_INODE_INVALIDATE_CLOSE) && is_open(entry))
+		(void)cache_inode_invalidate(entry,
+					     CACHE_INODE_INVALIDATE_CLOSE);
+
+	cache_inode_put(entry);
+	return rc;
+}
+
 /**
  * @brief Initiate a lock grant
  *
@@ -1397,7 +1491,7 @@ static int32_t delegrecall_completion_func(rpc_call_t *call,
 		}
 		break;
 	case DELEG_RET_WAIT:
-		if (schedule_delegrevoke_check(deleg_ctx, 1))
+		if (schedule_delegrevoke_check(deleg_ctx, state, 1))
 			goto out_revoke;
 		goto out_free;
 	case REVOKE:
@@ -1480,8 +1574,10 @@ void delegrecall_one(cache_entry_t *entry,
 	}
 
 	/* record the first attempt to recall this delegation */
-	if (clfl_stats->cfd_r_time == 0)
+	if (clfl_stats->cfd_r_time == 0) {
 		clfl_stats->cfd_r_time = time(NULL);
+		now(&clfl_stats->cfd_r_start);
+	}
 
 	if (str_valid)
 		LogFullDebug(COMPONENT_FSAL_UP, "Recalling delegation %s", str);
@@ -1661,7 +1757,7 @@ static void delegrevoke_check(void *ctx)
 				     "Not yet revoking the delegation for %s",
 				     str);
 
-		schedule_delegrevoke_check(deleg_ctx, 1);
+		schedule_delegrevoke_check(deleg_ctx, state, 1);
 		free_drc = false;
 	}
 
@@ -1722,21 +1818,60 @@ static int schedule_delegrecall_task(struct delegrecall_context *ctx,
 	return rc;
 }
 
+/**
+ * @brief Check again later whether a delegation must be revoked
+ *
+ * The check is kept in the delegation so DELEGRETURN can cancel it.
+ */
+
 static int schedule_delegrevoke_check(struct delegrecall_context *ctx,
-				      uint32_t delay)
+				      struct state_t *state, uint32_t delay)
 {
+	struct delayed_timer timer;
 	int rc = 0;
 
 	assert(ctx);
 
-	rc = delayed_submit(delegrevoke_check, ctx, delay * NS_PER_SEC);
-	if (rc)
+	rc = delayed_submit_timer(delegrevoke_check, ctx, delay * NS_PER_SEC,
+				  &timer);
+	if (rc) {
 		LogDebug(COMPONENT_THREAD,
 			 "delayed_submit failed with rc = %d", rc);
+		return rc;
+	}
+
+	PTHREAD_MUTEX_lock(&state->state_mutex);
+	state->state_data.deleg.sd_revoke_timer = timer;
+	PTHREAD_MUTEX_unlock(&state->state_mutex);
 
 	return rc;
 }
 
+/**
+ * @brief Cancel the revoke check of a returned delegation
+ *
+ * The check would only find the delegation gone and let the lease go;
+ * this does it now, without the timer firing.  A check already running
+ * is left to do that itself.  Call it without the state_lock, after
+ * the delegation was deleted.
+ *
+ * @param[in] state The delegation, with a reference held
+ */
+
+void delegrevoke_check_cancel(state_t *state)
+{
+	struct delayed_timer timer;
+	void *ctx;
+
+	PTHREAD_MUTEX_lock(&state->state_mutex);
+	timer = state->state_data.deleg.sd_revoke_timer;
+	memset(&state->state_data.deleg.sd_revoke_timer, 0, sizeof(timer));
+	PTHREAD_MUTEX_unlock(&state->state_mutex);
+
+	if (delayed_cancel(&timer, &ctx))
+		free_delegrecall_context(ctx);
+}
+
 state_status_t delegrecall_impl(cache_entry_t *entry)
 {
 	struct glist_head *glist, *glist_n;
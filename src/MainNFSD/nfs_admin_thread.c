@@ -40,6 +40,7 @@
 #include "cache_inode_lru.h"
 #include "idmapper.h"
 #include "delayed_exec.h"
+#include "gsh_numa.h"
 #include "export_mgr.h"
 #include "fsal.h"
 #ifdef USE_DBUS
@@ -354,6 +355,7 @@ void admin_halt(void)
 
 static void do_shutdown(void)
 {
+	uint32_t node;
 	int rc = 0;
 	bool disorderly = false;
 
@@ -383,20 +385,24 @@ static void do_shutdown(void)
 	Clean_RPC();
 
 	LogEvent(COMPONENT_MAIN, "Stopping request decoder threads");
-	rc = fridgethr_sync_command(req_fridge, fridgethr_comm_stop, 120);
-
-	if (rc == ETIMEDOUT) {
-		LogMajor(COMPONENT_THREAD,
-			 "Shutdown timed out, cancelling threads!");
-		fridgethr_cancel(req_fridge);
-		disorderly = true;
-	} else if (rc != 0) {
-		LogMajor(COMPONENT_THREAD,
-			 "Failed to shut down the request thread fridge: %d!",
-			 rc);
-		disorderly = true;
-	} else {
-		LogEvent(COMPONENT_THREAD, "Request threads shut down.");
+	for (node = 0; node < gsh_numa_nodes(); node++) {
+		rc = fridgethr_sync_command(req_fridge[node],
+					    fridgethr_comm_stop, 120);
+
+		if (rc == ETIMEDOUT) {
+			LogMajor(COMPONENT_THREAD,
+				 "Shutdown timed out, cancelling threads!");
+			fridgethr_cancel(req_fridge[node]);
+			disorderly = true;
+		} else if (rc != 0) {
+			LogMajor(COMPONENT_THREAD,
+				 "Failed to shut down the request thread fridge: %d!",
+				 rc);
+			disorderly = true;
+		} else {
+			LogEvent(COMPONENT_THREAD,
+				 "Request threads shut down.");
+		}
 	}
 
 	LogEvent(COMPONENT_MAIN, "Stopping worker threads");
@@ -432,6 +438,20 @@ static void do_shutdown(void)
 		LogEvent(COMPONENT_THREAD, "Reaper thread shut down.");
 	}
 
+	rc = cache_inode_readahead_pkgshutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down read-ahead threads: %d", rc);
+		disorderly = true;
+	}
+
+	rc = cache_inode_warm_pkgshutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down warm restart thread: %d", rc);
+		disorderly = true;
+	}
+
 	LogEvent(COMPONENT_MAIN, "Stopping LRU thread.");
 	rc = cache_inode_lru_pkgshutdown();
 	if (rc != 0) {
@@ -62,8 +62,10 @@
 #include "fridgethr.h"
 #include "idmapper.h"
 #include "delayed_exec.h"
+#include "gsh_numa.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "server_stats.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
@@ -386,6 +388,8 @@ static void nfs_Start_threads(void)
 	LogEvent(COMPONENT_THREAD, "Starting delayed executor.");
 	delayed_start();
 
+	server_stats_init();
+
 	/* Starting the thread dedicated to signal handling */
 	rc = pthread_create(&sigmgr_thrid, &attr_thr, sigmgr_thread, NULL);
 	if (rc != 0) {
@@ -503,6 +507,9 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	char GssError[MAXNAMLEN + 1];
 #endif
 
+	/* NUMA nodes, before any thread pool is split over them */
+	gsh_numa_init(nfs_param.core_param.numa_pools);
+
 #ifdef USE_DBUS
 	/* DBUS init */
 	gsh_dbus_pkginit();
@@ -518,6 +525,12 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 			 "Unable to initialize LRU subsystem: %d.", rc);
 	}
 
+	rc = cache_inode_readahead_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize read-ahead: %d.", rc);
+	}
+
 	/* acls cache may be needed by exports_pkginit */
 	LogDebug(COMPONENT_INIT, "Now building NFSv4 ACL cache");
 	if (nfs4_acls_init() != 0)
@@ -526,7 +539,16 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 
 	/* finish the job with exports by caching the root entries
 	 */
+	server_stats_startup_begin(STARTUP_EXPORT_ROOTS);
 	exports_pkginit();
+	server_stats_startup_end(STARTUP_EXPORT_ROOTS);
+
+	/* prefetch the entries saved by the last run */
+	rc = cache_inode_warm_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize warm restart: %d.", rc);
+	}
 
 	nfs41_session_pool =
 	    pool_init("NFSv4.1 session pool", sizeof(nfs41_session_t),
@@ -695,7 +717,9 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Creates the pseudo fs */
 	LogDebug(COMPONENT_INIT, "Now building pseudo fs");
 
+	server_stats_startup_begin(STARTUP_PSEUDOFS);
 	create_pseudofs();
+	server_stats_startup_end(STARTUP_PSEUDOFS);
 
 	LogInfo(COMPONENT_INIT,
 		"NFSv4 pseudo file system successfully initialized");
@@ -706,10 +730,12 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Create stable storage directory, this needs to be done before
 	 * starting the recovery thread.
 	 */
+	server_stats_startup_begin(STARTUP_RECOVERY);
 	nfs4_create_recov_dir();
 
 	/* read in the client IDs */
 	nfs4_load_recov_clids(NULL);
+	server_stats_startup_end(STARTUP_RECOVERY);
 
 	/* Start grace period */
 	nfs4_start_grace(NULL);
@@ -834,12 +860,15 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	init_complete = true;
 
 	/* Spawns service threads */
+	server_stats_startup_begin(STARTUP_SERVICES);
 	nfs_Start_threads();
 
 	if (nfs_param.core_param.enable_NLM) {
 		/* NSM Unmonitor all */
 		nsm_unmonitor_all();
 	}
+	server_stats_startup_end(STARTUP_SERVICES);
+	server_stats_startup_done();
 
 	LogEvent(COMPONENT_INIT,
 		 "-------------------------------------------------");
@@ -42,6 +42,7 @@
 #include "nfs_init.h"
 #include "nfs_exports.h"
 #include "pnfs_utils.h"
+#include "server_stats.h"
 
 /**
  * @brief LTTng trace enabling magic
@@ -433,7 +434,9 @@ int main(int argc, char *argv[])
 	/* We need all the fsal modules loaded so we can have
 	 * the list available at exports parsing time.
 	 */
+	server_stats_startup_begin(STARTUP_FSALS);
 	start_fsals();
+	server_stats_startup_end(STARTUP_FSALS);
 
 	/* parse configuration file */
 
@@ -464,7 +467,9 @@ int main(int argc, char *argv[])
 	/* Load export entries from parsed file
 	 * returns the number of export entries.
 	 */
+	server_stats_startup_begin(STARTUP_EXPORTS);
 	rc = ReadExports(config_struct, &err_type);
+	server_stats_startup_end(STARTUP_EXPORTS);
 	if (rc < 0) {
 		LogCrit(COMPONENT_INIT,
 			  "Error while parsing export entries");
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <sys/file.h>		/* for having FNDELAY */
 #include <sys/select.h>
@@ -56,6 +57,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "fridgethr.h"
+#include "gsh_numa.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -65,18 +67,50 @@
 struct rpc_evchan {
 	uint32_t chan_id;	/*< Channel ID */
 	pthread_t thread_id;	/*< POSIX thread ID */
+	uint32_t n_xprts;	/*< TCP connections served */
+	uint64_t load;		/*< Requests decoded in this period */
+	uint32_t node;		/*< NUMA node it runs and decodes on */
+	GSH_CACHE_PAD(0);
 };
 
-#define N_TCP_EVENT_CHAN  3	/*< We don't really want to have too many,
-				   relative to the number of available cores. */
-#define UDP_EVENT_CHAN    0	/*< Put UDP on a dedicated channel */
-#define TCP_RDVS_CHAN     1	/*< Accepts new tcp connections */
-#define TCP_EVCHAN_0      2
-#define N_EVENT_CHAN (N_TCP_EVENT_CHAN + 2)
+#define N_TCP_EVENT_CHAN  3	/*< Fewest TCP channels by default */
+#define CPUS_PER_TCP_EVENT_CHAN 4	/*< We don't really want to have too
+					   many, relative to the number of
+					   available cores. */
+#define TCP_RDVS_CHAN     0	/*< Accepts new tcp connections */
+#define TCP_EVCHAN_0      1
+#define N_EVENT_CHAN (TCP_EVCHAN_0 + RPC_MAX_TCP_EVENT_CHAN + \
+		      RPC_MAX_UDP_SOCKETS)
 
 static struct rpc_evchan rpc_evchan[N_EVENT_CHAN];
+static int n_tcp_evchan;	/*< TCP channels, from TCP_EVCHAN_0 */
+static int udp_evchan_0;	/*< UDP socket i of every service is on
+				   channel udp_evchan_0 + i */
+static int n_evchan;		/*< Channels in use */
 
-struct fridgethr *req_fridge;	/*< Decoder thread pool */
+/**
+ * Rebalancing of TCP connections between channels.  At the end of each
+ * period the busiest channel is compared with the mean, and while it is
+ * too far above, a connection is moved from it to the least loaded one
+ * the next time it is rearmed.
+ */
+
+#define EVCHAN_BALANCE_PERIOD 1	/*< Seconds */
+#define EVCHAN_BALANCE_MIN_LOAD 64	/*< Requests in a period, below which
+					   a channel is never too busy */
+
+static struct {
+	pthread_mutex_t mtx;	/*< Held to end a period */
+	time_t next;		/*< End of the current period */
+	int from;		/*< Channel to move connections off */
+	int to;			/*< Channel to move them to */
+	int32_t moves;		/*< Connections left to move */
+} evchan_balance = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+};
+
+struct fridgethr *req_fridge[GSH_NUMA_MAX_NODES]; /*< Decoder thread
+						       pools, per node */
 struct nfs_req_st nfs_req_st;	/*< Shared request queues */
 
 const char *req_q_s[N_REQ_QUEUES] = {
@@ -143,6 +177,14 @@ int tcp_socket[P_COUNT];
 SVCXPRT *udp_xprt[P_COUNT];
 SVCXPRT *tcp_xprt[P_COUNT];
 
+/* More UDP sockets on the same ports, when RPC_UDP_Sockets > 1 */
+static int udp_socket_extra[P_COUNT][RPC_MAX_UDP_SOCKETS - 1];
+static int n_udp_socket_extra[P_COUNT];
+
+/* Listening sockets of the TCP channels, with RPC_TCP_Channel_Listeners */
+static int tcp_socket_extra[P_COUNT][RPC_MAX_TCP_EVENT_CHAN];
+static int n_tcp_socket_extra[P_COUNT];
+
 /* Flag to indicate if V6 interfaces on the host are enabled */
 bool v6disabled;
 
@@ -230,73 +272,139 @@ static void close_rpc_fd(void)
 {
 	protos p;
 
+	int i;
+
 	for (p = P_NFS; p < P_COUNT; p++) {
 		if (udp_socket[p] != -1)
 			close(udp_socket[p]);
 		if (tcp_socket[p] != -1)
 			close(tcp_socket[p]);
+		for (i = 0; i < n_udp_socket_extra[p]; i++)
+			close(udp_socket_extra[p][i]);
+		for (i = 0; i < n_tcp_socket_extra[p]; i++)
+			close(tcp_socket_extra[p][i]);
 	}
 }
 
-void Create_udp(protos prot)
+/**
+ * @brief Create the SVCXPRT of a UDP socket
+ *
+ * @param[in] prot Protocol
+ * @param[in] fd   Bound socket
+ * @param[in] chan Event channel to serve it
+ *
+ * @return The new transport.
+ */
+static SVCXPRT *Create_udp_xprt(protos prot, int fd, int chan)
 {
-	udp_xprt[prot] =
-	    svc_dg_create(udp_socket[prot],
-			  nfs_param.core_param.rpc.max_send_buffer_size,
-			  nfs_param.core_param.rpc.max_recv_buffer_size);
-	if (udp_xprt[prot] == NULL)
+	SVCXPRT *xprt;
+	gsh_xprt_private_t *xu;
+
+	xprt = svc_dg_create(fd,
+			     nfs_param.core_param.rpc.max_send_buffer_size,
+			     nfs_param.core_param.rpc.max_recv_buffer_size);
+	if (xprt == NULL)
 		LogFatal(COMPONENT_DISPATCH, "Cannot allocate %s/UDP SVCXPRT",
 			 tags[prot]);
 
 	/* Hook xp_getreq */
-	(void)SVC_CONTROL(udp_xprt[prot], SVCSET_XP_GETREQ, nfs_rpc_getreq_ng);
+	(void)SVC_CONTROL(xprt, SVCSET_XP_GETREQ, nfs_rpc_getreq_ng);
 
 	/* Hook xp_free_user_data (finalize/free private data) */
-	(void)SVC_CONTROL(udp_xprt[prot], SVCSET_XP_FREE_USER_DATA,
+	(void)SVC_CONTROL(xprt, SVCSET_XP_FREE_USER_DATA,
 			  nfs_rpc_free_user_data);
 
 	/* Setup private data */
-	(udp_xprt[prot])->xp_u1 =
-		alloc_gsh_xprt_private(udp_xprt[prot],
-				       XPRT_PRIVATE_FLAG_NONE);
+	xu = alloc_gsh_xprt_private(xprt, XPRT_PRIVATE_FLAG_NONE);
+	xu->evchan = chan;
+	xprt->xp_u1 = xu;
+
+	/* Several datagrams per recvmmsg/sendmmsg.  Replies go out when
+	 * the xprt is unlocked, which the dispatcher always does. */
+	if (nfs_param.core_param.rpc.udp_batch > 1 &&
+	    !svc_dg_enable_mmsg(xprt, nfs_param.core_param.rpc.udp_batch))
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot batch datagrams on %s/UDP socket %d",
+			tags[prot], fd);
 
 	/* bind xprt to channel--unregister it from the global event
 	 * channel (if applicable) */
-	(void)svc_rqst_evchan_reg(rpc_evchan[UDP_EVENT_CHAN].chan_id,
-				  udp_xprt[prot], SVC_RQST_FLAG_XPRT_UREG);
+	(void)svc_rqst_evchan_reg(rpc_evchan[chan].chan_id,
+				  xprt, SVC_RQST_FLAG_XPRT_UREG);
+	return xprt;
 }
 
-void Create_tcp(protos prot)
+void Create_udp(protos prot)
+{
+	int i;
+
+	udp_xprt[prot] = Create_udp_xprt(prot, udp_socket[prot],
+					 udp_evchan_0);
+
+	/* Only the first xprt is registered with rpcbind, the others
+	 * share its port and are dispatched the same way */
+	for (i = 0; i < n_udp_socket_extra[prot]; i++)
+		(void)Create_udp_xprt(prot, udp_socket_extra[prot][i],
+				      udp_evchan_0 + 1 + i);
+}
+
+/**
+ * @brief Create the SVCXPRT of a TCP listening socket
+ *
+ * @param[in] prot Protocol
+ * @param[in] fd   Bound socket
+ * @param[in] chan Event channel to serve it, and the connections it
+ *                 accepts unless it is TCP_RDVS_CHAN
+ *
+ * @return The new transport.
+ */
+static SVCXPRT *Create_tcp_xprt(protos prot, int fd, int chan)
 {
-	tcp_xprt[prot] =
-		svc_vc_create2(tcp_socket[prot],
-			       nfs_param.core_param.rpc.max_send_buffer_size,
-			       nfs_param.core_param.rpc.max_recv_buffer_size,
-			       SVC_VC_CREATE_LISTEN);
-	if (tcp_xprt[prot] == NULL)
+	SVCXPRT *xprt;
+	gsh_xprt_private_t *xu;
+
+	xprt = svc_vc_create2(fd,
+			      nfs_param.core_param.rpc.max_send_buffer_size,
+			      nfs_param.core_param.rpc.max_recv_buffer_size,
+			      SVC_VC_CREATE_LISTEN);
+	if (xprt == NULL)
 		LogFatal(COMPONENT_DISPATCH, "Cannot allocate %s/TCP SVCXPRT",
 			 tags[prot]);
 
 	/* bind xprt to channel--unregister it from the global event
 	 * channel (if applicable) */
-	(void)svc_rqst_evchan_reg(rpc_evchan[TCP_RDVS_CHAN].chan_id,
-				  tcp_xprt[prot], SVC_RQST_FLAG_XPRT_UREG);
+	(void)svc_rqst_evchan_reg(rpc_evchan[chan].chan_id,
+				  xprt, SVC_RQST_FLAG_XPRT_UREG);
 
 	/* Hook xp_getreq */
-	(void)SVC_CONTROL(tcp_xprt[prot], SVCSET_XP_GETREQ, nfs_rpc_getreq_ng);
+	(void)SVC_CONTROL(xprt, SVCSET_XP_GETREQ, nfs_rpc_getreq_ng);
 
 	/* Hook xp_recv_user_data -- allocate new xprts to event channels */
-	(void)SVC_CONTROL(tcp_xprt[prot], SVCSET_XP_RECV_USER_DATA,
+	(void)SVC_CONTROL(xprt, SVCSET_XP_RECV_USER_DATA,
 			  nfs_rpc_recv_user_data);
 
 	/* Hook xp_free_user_data (finalize/free private data) */
-	(void)SVC_CONTROL(tcp_xprt[prot], SVCSET_XP_FREE_USER_DATA,
+	(void)SVC_CONTROL(xprt, SVCSET_XP_FREE_USER_DATA,
 			  nfs_rpc_free_user_data);
 
 	/* Setup private data */
-	(tcp_xprt[prot])->xp_u1 =
-		alloc_gsh_xprt_private(tcp_xprt[prot],
-				       XPRT_PRIVATE_FLAG_NONE);
+	xu = alloc_gsh_xprt_private(xprt, XPRT_PRIVATE_FLAG_NONE);
+	xu->evchan = chan;
+	xprt->xp_u1 = xu;
+	return xprt;
+}
+
+void Create_tcp(protos prot)
+{
+	int i;
+
+	tcp_xprt[prot] = Create_tcp_xprt(prot, tcp_socket[prot],
+					 TCP_RDVS_CHAN);
+
+	/* As for UDP, only the first one is registered with rpcbind */
+	for (i = 0; i < n_tcp_socket_extra[prot]; i++)
+		(void)Create_tcp_xprt(prot, tcp_socket_extra[prot][i],
+				      TCP_EVCHAN_0 + i);
 }
 
 /**
@@ -490,6 +598,103 @@ static int Bind_sockets_V4(void)
 	return rc;
 }
 
+/**
+ * @brief Open a socket sharing the address of a bound one
+ *
+ * @param[in] p    Protocol, for messages
+ * @param[in] type SOCK_DGRAM or SOCK_STREAM
+ * @param[in] i    Index of the socket, for messages
+ * @param[in] addr Address the first socket of the service is bound to
+ * @param[in] si   Socket info of that socket
+ *
+ * @return The bound socket, -1 on error.
+ */
+static int Bind_reuseport_socket(protos p, int type, int i,
+				 struct t_bind *addr,
+				 struct __rpc_sockinfo *si)
+{
+	const char *kind = type == SOCK_DGRAM ? "udp" : "tcp";
+	int one = 1;
+	int fd;
+
+	fd = socket(si->si_af, type, si->si_proto);
+	if (fd == -1) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot allocate %s socket %d for %s, error %d(%s)",
+			kind, i, tags[p], errno, strerror(errno));
+		return -1;
+	}
+
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+	    (type == SOCK_DGRAM && fcntl(fd, F_SETFL, FNDELAY) == -1) ||
+	    bind(fd, (struct sockaddr *)addr->addr.buf,
+		 (socklen_t) si->si_alen)) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot set up %s socket %d for %s, error %d(%s)",
+			kind, i, tags[p], errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * @brief Open and bind the additional sockets of each service
+ *
+ * They are bound to the address of the first one, which has
+ * SO_REUSEPORT set, so the kernel spreads the datagrams and the
+ * connections of different clients over all of them.  The UDP ones
+ * are for RPC_UDP_Sockets, the TCP ones are the listeners of the TCP
+ * event channels.  If one fails, the service keeps the sockets it
+ * already has.
+ */
+static void Bind_extra_sockets(void)
+{
+	protos p;
+	int i, fd;
+
+	for (p = P_NFS; p < P_COUNT; p++) {
+		proto_data *pdatap = &pdata[p];
+
+		n_udp_socket_extra[p] = 0;
+		n_tcp_socket_extra[p] = 0;
+		if (!nfs_protocol_enabled(p))
+			continue;
+
+		for (i = 1; i < nfs_param.core_param.rpc.udp_sockets; i++) {
+			fd = Bind_reuseport_socket(p, SOCK_DGRAM, i,
+						   &pdatap->bindaddr_udp6,
+						   &pdatap->si_udp6);
+			if (fd == -1)
+				break;
+			udp_socket_extra[p][n_udp_socket_extra[p]++] = fd;
+		}
+
+		if (n_udp_socket_extra[p] != 0)
+			LogInfo(COMPONENT_DISPATCH,
+				"%s has %d udp sockets", tags[p],
+				n_udp_socket_extra[p] + 1);
+
+		if (!nfs_param.core_param.rpc.tcp_chan_listeners)
+			continue;
+
+		for (i = 0; i < n_tcp_evchan; i++) {
+			fd = Bind_reuseport_socket(p, SOCK_STREAM, i + 1,
+						   &pdatap->bindaddr_tcp6,
+						   &pdatap->si_tcp6);
+			if (fd == -1)
+				break;
+			tcp_socket_extra[p][n_tcp_socket_extra[p]++] = fd;
+		}
+
+		LogInfo(COMPONENT_DISPATCH,
+			"%s has %d tcp listeners", tags[p],
+			n_tcp_socket_extra[p] + 1);
+	}
+}
+
 void Bind_sockets(void)
 {
 	int	rc = 0;
@@ -510,6 +715,8 @@ void Bind_sockets(void)
 				 "Error binding to V6 interface. Cannot continue.");
 	}
 
+	Bind_extra_sockets();
+
 	LogInfo(COMPONENT_DISPATCH,
 		"Bind_sockets() successful, v6disabled = %d", v6disabled);
 }
@@ -535,6 +742,17 @@ static int alloc_socket_setopts(int p)
 		return -1;
 	}
 
+	/* Lets the sockets of Bind_extra_sockets share the port */
+	if (nfs_param.core_param.rpc.udp_sockets > 1 &&
+	    setsockopt(udp_socket[p],
+		       SOL_SOCKET, SO_REUSEPORT,
+		       &one, sizeof(one))) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot set SO_REUSEPORT on udp socket for %s, error %d(%s), using one udp socket",
+			tags[p], errno, strerror(errno));
+		nfs_param.core_param.rpc.udp_sockets = 1;
+	}
+
 	if (setsockopt(tcp_socket[p],
 		       SOL_SOCKET, SO_REUSEADDR,
 		       &one, sizeof(one))) {
@@ -545,6 +763,16 @@ static int alloc_socket_setopts(int p)
 		return -1;
 	}
 
+	if (nfs_param.core_param.rpc.tcp_chan_listeners &&
+	    setsockopt(tcp_socket[p],
+		       SOL_SOCKET, SO_REUSEPORT,
+		       &one, sizeof(one))) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot set SO_REUSEPORT on tcp socket for %s, error %d(%s), using one tcp listener",
+			tags[p], errno, strerror(errno));
+		nfs_param.core_param.rpc.tcp_chan_listeners = false;
+	}
+
 	/* We prefer using non-blocking socket
 	 * in the specific case */
 	if (fcntl(udp_socket[p], F_SETFL, FNDELAY) == -1) {
@@ -743,6 +971,51 @@ void Register_program(protos prot, int flag, int vers)
 	}
 }
 
+/**
+ * @brief Number of TCP event channels
+ *
+ * RPC_TCP_Event_Channels, or one per CPUS_PER_TCP_EVENT_CHAN online
+ * CPUs and at least N_TCP_EVENT_CHAN if that is 0, but no more than
+ * RPC_MAX_TCP_EVENT_CHAN.  With NUMA worker pools, rounded to a multiple
+ * of the nodes so that every node has as many, up if that fits.
+ */
+static int tcp_evchan_count(void)
+{
+	long n = nfs_param.core_param.rpc.tcp_evchans;
+	long nnodes = gsh_numa_nodes();
+
+	if (n == 0) {
+		n = sysconf(_SC_NPROCESSORS_ONLN) / CPUS_PER_TCP_EVENT_CHAN;
+		if (n < N_TCP_EVENT_CHAN)
+			n = N_TCP_EVENT_CHAN;
+	}
+	if (n > RPC_MAX_TCP_EVENT_CHAN)
+		n = RPC_MAX_TCP_EVENT_CHAN;
+	n = (n + nnodes - 1) / nnodes * nnodes;
+	if (n > RPC_MAX_TCP_EVENT_CHAN)
+		n = RPC_MAX_TCP_EVENT_CHAN / nnodes * nnodes;
+	return n;
+}
+
+/**
+ * @brief NUMA node of an event channel
+ *
+ * The TCP channels, and the UDP ones, are dealt out to the nodes in
+ * turn.  The rendezvous channel is on node 0.
+ *
+ * @param[in] ix Index of the channel
+ */
+static uint32_t evchan_node(int ix)
+{
+	uint32_t nnodes = gsh_numa_nodes();
+
+	if (ix >= udp_evchan_0)
+		return (ix - udp_evchan_0) % nnodes;
+	if (ix >= TCP_EVCHAN_0)
+		return (ix - TCP_EVCHAN_0) % nnodes;
+	return 0;
+}
+
 /**
  * @brief Init the svc descriptors for the nfs daemon
  *
@@ -782,6 +1055,11 @@ void nfs_Init_svc(void)
 	svc_params.gss_ctx_hash_partitions = 17;
 	svc_params.gss_max_idle_gen = 1024;	/* GSS ctx cache expiration */
 	svc_params.gss_max_gc = 200;
+#ifdef _HAVE_GSSAPI
+	if (nfs_param.krb5_param.active_krb5)
+		svc_params.gss_defer_min =
+			nfs_param.krb5_param.unwrap_offload_size;
+#endif
 	svc_params.ioq_thrd_max = /* max ioq worker threads */
 		nfs_param.core_param.rpc.ioq_thrd_max;
 
@@ -810,7 +1088,14 @@ void nfs_Init_svc(void)
 		LogCrit(COMPONENT_INIT, "Failed redirecting TI-RPC __free");
 #endif				/* TIRPC_SET_ALLOCATORS */
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	n_tcp_evchan = tcp_evchan_count();
+	udp_evchan_0 = TCP_EVCHAN_0 + n_tcp_evchan;
+	n_evchan = udp_evchan_0 + nfs_param.core_param.rpc.udp_sockets;
+	LogInfo(COMPONENT_DISPATCH, "%d event channels, %d for tcp",
+		n_evchan, n_tcp_evchan);
+
+	for (ix = 0; ix < n_evchan; ++ix) {
+		rpc_evchan[ix].node = evchan_node(ix);
 		rpc_evchan[ix].chan_id = 0;
 		code = svc_rqst_new_evchan(&rpc_evchan[ix].chan_id,
 					   NULL /* u_data */,
@@ -955,10 +1240,10 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	int ix, code = 0;
 
 	/* Start event channel service threads */
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_evchan; ++ix) {
 		code = pthread_create(&rpc_evchan[ix].thread_id, attr_thr,
 				      rpc_dispatcher_thread,
-				      (void *)&rpc_evchan[ix].chan_id);
+				      (void *)&rpc_evchan[ix]);
 		if (code != 0)
 			LogFatal(COMPONENT_THREAD,
 				 "Could not create rpc_dispatcher_thread #%u, error = %d (%s)",
@@ -966,26 +1251,45 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	}
 	LogInfo(COMPONENT_THREAD,
 		"%d rpc dispatcher threads were started successfully",
-		N_EVENT_CHAN);
+		n_evchan);
 }
 
 void nfs_rpc_dispatch_stop(void)
 {
 	int ix;
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_evchan; ++ix) {
 		svc_rqst_thrd_signal(rpc_evchan[ix].chan_id,
 				     SVC_RQST_SIGNAL_SHUTDOWN);
 	}
 }
 
+/**
+ * @brief TCP channel with the fewest connections
+ */
+static int evchan_least_xprts(void)
+{
+	uint32_t n, min = UINT32_MAX;
+	int ix, chan = TCP_EVCHAN_0;
+
+	for (ix = TCP_EVCHAN_0; ix < udp_evchan_0; ++ix) {
+		n = atomic_fetch_uint32_t(&rpc_evchan[ix].n_xprts);
+		if (n < min) {
+			min = n;
+			chan = ix;
+		}
+	}
+	return chan;
+}
+
 /**
  * @brief Rendezvous callout.  This routine will be called by TI-RPC
  *        after newxprt has been accepted.
  *
- * Register newxprt on a TCP event channel.  Balancing events/channels
- * could become involved.  To start with, just cycle through them as
- * new connections are accepted.
+ * Register newxprt on a TCP event channel.  A connection accepted by
+ * the listener of a TCP channel stays there.  Those of the rendezvous
+ * channel go to the channel with the fewest connections if rebalancing
+ * is on, else cycle through the channels.
  *
  * @param[in] xprt    Transport
  * @param[in] newxprt Newly created transport
@@ -999,24 +1303,36 @@ static u_int nfs_rpc_recv_user_data(SVCXPRT *xprt, SVCXPRT *newxprt,
 {
 	static uint32_t next_chan = TCP_EVCHAN_0;
 	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	gsh_xprt_private_t *pxu = (gsh_xprt_private_t *) xprt->xp_u1;
+	gsh_xprt_private_t *xu;
 	uint32_t tchan;
 
-	PTHREAD_MUTEX_lock(&mtx);
+	/* setup private data (freed when xprt is destroyed) */
+	xu = alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+
+	if (pxu != NULL && pxu->evchan != TCP_RDVS_CHAN) {
+		tchan = pxu->evchan;
+	} else if (nfs_param.core_param.rpc.tcp_rebalance) {
+		tchan = evchan_least_xprts();
+	} else {
+		PTHREAD_MUTEX_lock(&mtx);
 
-	tchan = next_chan;
-	assert((next_chan >= TCP_EVCHAN_0) && (next_chan < N_EVENT_CHAN));
-	if (++next_chan >= N_EVENT_CHAN)
-		next_chan = TCP_EVCHAN_0;
+		tchan = next_chan;
+		assert((next_chan >= TCP_EVCHAN_0) &&
+		       (next_chan < udp_evchan_0));
+		if (++next_chan >= udp_evchan_0)
+			next_chan = TCP_EVCHAN_0;
 
-	/* setup private data (freed when xprt is destroyed) */
-	newxprt->xp_u1 =
-	    alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+		PTHREAD_MUTEX_unlock(&mtx);
+	}
+
+	xu->evchan = tchan;
+	newxprt->xp_u1 = xu;
+	atomic_inc_uint32_t(&rpc_evchan[tchan].n_xprts);
 
 	/* NB: xu->drc is allocated on first request--we need shared
 	 * TCP DRC for v3, but per-connection for v4 */
 
-	PTHREAD_MUTEX_unlock(&mtx);
-
 	(void)svc_rqst_evchan_reg(rpc_evchan[tchan].chan_id, newxprt,
 				  SVC_RQST_FLAG_NONE);
 
@@ -1030,35 +1346,167 @@ static u_int nfs_rpc_recv_user_data(SVCXPRT *xprt, SVCXPRT *newxprt,
  */
 static void nfs_rpc_free_user_data(SVCXPRT *xprt)
 {
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+
 	if (xprt->xp_u2) {
 		nfs_dupreq_put_drc(xprt, xprt->xp_u2, DRC_FLAG_RELEASE);
 		xprt->xp_u2 = NULL;
 	}
+	if (xu != NULL && xprt->xp_type == XPRT_TCP)
+		atomic_dec_uint32_t(&rpc_evchan[xu->evchan].n_xprts);
 	free_gsh_xprt_private(xprt);
 }
 
+/**
+ * @brief End a rebalancing period
+ *
+ * Looks at the requests each TCP channel decoded during the period.
+ * If the busiest one is more than a quarter above the mean, and not
+ * nearly idle, one of its connections will move to the least busy one
+ * of the same NUMA node.
+ *
+ * @param[in] now Current time
+ */
+static void evchan_balance_period(time_t now)
+{
+	uint64_t load[N_EVENT_CHAN];
+	uint64_t total = 0, max = 0, min = UINT64_MAX;
+	int ix, from = -1, to = -1;
+
+	if (pthread_mutex_trylock(&evchan_balance.mtx) != 0)
+		return;
+
+	if (now < evchan_balance.next) {
+		PTHREAD_MUTEX_unlock(&evchan_balance.mtx);
+		return;
+	}
+
+	for (ix = TCP_EVCHAN_0; ix < udp_evchan_0; ++ix) {
+		load[ix] = atomic_postclear_uint64_t_bits(&rpc_evchan[ix].load,
+							  UINT64_MAX);
+		total += load[ix];
+		if (load[ix] > max &&
+		    atomic_fetch_uint32_t(&rpc_evchan[ix].n_xprts) > 1) {
+			max = load[ix];
+			from = ix;
+		}
+	}
+
+	for (ix = TCP_EVCHAN_0; from != -1 && ix < udp_evchan_0; ++ix) {
+		if (rpc_evchan[ix].node == rpc_evchan[from].node &&
+		    load[ix] < min) {
+			min = load[ix];
+			to = ix;
+		}
+	}
+
+	if (from != -1 && from != to && max >= EVCHAN_BALANCE_MIN_LOAD &&
+	    max * n_tcp_evchan > total + total / 4) {
+		LogDebug(COMPONENT_DISPATCH,
+			 "moving a connection from channel %d (%" PRIu64
+			 " requests) to %d (%" PRIu64 ")",
+			 from, max, to, min);
+		evchan_balance.from = from;
+		evchan_balance.to = to;
+		atomic_store_int32_t(&evchan_balance.moves, 1);
+	} else {
+		atomic_store_int32_t(&evchan_balance.moves, 0);
+	}
+
+	evchan_balance.next = now + EVCHAN_BALANCE_PERIOD;
+	PTHREAD_MUTEX_unlock(&evchan_balance.mtx);
+}
+
+/**
+ * @brief Rearm a transport after decoding, rebalancing if needed
+ *
+ * Accounts the requests decoded on the channel of a TCP connection
+ * and, if that channel is the one connections are moved off, moves the
+ * connection rather than rearming it where it is.
+ *
+ * @param[in] xprt  Transport
+ * @param[in] nreqs Requests just decoded from it
+ */
+static void nfs_rpc_rearm_xprt(SVCXPRT *xprt, uint32_t nreqs)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	time_t now;
+	int to;
+
+	if (!nfs_param.core_param.rpc.tcp_rebalance || xu == NULL ||
+	    xprt->xp_type != XPRT_TCP) {
+		(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+		return;
+	}
+
+	(void)atomic_add_uint64_t(&rpc_evchan[xu->evchan].load, nreqs);
+
+	now = time(NULL);
+	if (now >= evchan_balance.next)
+		evchan_balance_period(now);
+
+	if (xu->evchan != evchan_balance.from ||
+	    atomic_fetch_int32_t(&evchan_balance.moves) <= 0 ||
+	    atomic_dec_int32_t(&evchan_balance.moves) < 0) {
+		(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+		return;
+	}
+
+	to = evchan_balance.to;
+	atomic_dec_uint32_t(&rpc_evchan[xu->evchan].n_xprts);
+	atomic_inc_uint32_t(&rpc_evchan[to].n_xprts);
+	xu->evchan = to;
+	(void)svc_rqst_evchan_move(rpc_evchan[to].chan_id, xprt,
+				   SVC_RQST_FLAG_NONE);
+}
+
 uint32_t nfs_rpc_outstanding_reqs_est(void)
 {
 	static uint32_t ctr;
 	static uint32_t nreqs;
 	struct req_q_pair *qpair;
-	uint32_t treqs;
+	uint32_t treqs, node;
 	int ix;
 
 	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
 		return atomic_fetch_uint32_t(&nreqs);
 
 	treqs = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		treqs += atomic_fetch_uint32_t(&qpair->producer.size);
-		treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
+	for (node = 0; node < nfs_req_st.nnodes; node++) {
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			qpair = &(nfs_req_st.node[node].nfs_request_q.qset[ix]);
+			treqs += atomic_fetch_uint32_t(&qpair->producer.size);
+			treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
+		}
 	}
 
 	atomic_store_uint32_t(&nreqs, treqs);
 	return treqs;
 }
 
+/**
+ * @brief Requests queued on a NUMA node and where they ran
+ *
+ * @param[in]  node The node
+ * @param[out] st   Its counters
+ */
+void nfs_rpc_node_stats(uint32_t node, struct nfs_node_stats *st)
+{
+	struct req_q_node *n = &nfs_req_st.node[node];
+	struct req_q_pair *qpair;
+	int ix;
+
+	st->enqueued = atomic_fetch_uint64_t(&n->enqueued);
+	st->local = atomic_fetch_uint64_t(&n->local);
+	st->remote = atomic_fetch_uint64_t(&n->remote);
+	st->queued = 0;
+	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+		qpair = &(n->nfs_request_q.qset[ix]);
+		st->queued += atomic_fetch_uint32_t(&qpair->producer.size);
+		st->queued += atomic_fetch_uint32_t(&qpair->consumer.size);
+	}
+}
+
 static inline bool stallq_should_unstall(SVCXPRT *xprt)
 {
 	return ((xprt->xp_requests
@@ -1169,7 +1617,7 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 		int rc = 0;
 
 		LogDebug(COMPONENT_DISPATCH, "starting stallq service thread");
-		rc = fridgethr_submit(req_fridge, thr_stallq,
+		rc = fridgethr_submit(req_fridge[0], thr_stallq,
 				      NULL /* no arg */);
 		if (rc != 0)
 			LogCrit(COMPONENT_DISPATCH,
@@ -1180,10 +1628,18 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	return true;
 }
 
+/**
+ * @brief Set up the request queues and decoder pools
+ *
+ * Each NUMA node gets its own queues and decoder threads, bound to
+ * it, so that requests are read and queued in its memory.
+ */
 void nfs_rpc_queue_init(void)
 {
 	struct fridgethr_params reqparams;
+	struct req_q_node *node;
 	struct req_q_pair *qpair;
+	uint32_t n;
 	int rc = 0;
 	int ix;
 
@@ -1198,26 +1654,34 @@ void nfs_rpc_queue_init(void)
 	reqparams.deferment = fridgethr_defer_block;
 	reqparams.block_delay =
 		nfs_param.core_param.decoder_fridge_block_timeout;
+	reqparams.numa_bind = true;
 
-	/* decoder thread pool */
-	rc = fridgethr_init(&req_fridge, "decoder", &reqparams);
-	if (rc != 0)
-		LogFatal(COMPONENT_DISPATCH,
-			 "Unable to initialize decoder thread pool: %d", rc);
+	nfs_req_st.nnodes = gsh_numa_nodes();
+	for (n = 0; n < nfs_req_st.nnodes; n++) {
+		node = &nfs_req_st.node[n];
 
-	/* queues */
-	pthread_spin_init(&nfs_req_st.reqs.sp, PTHREAD_PROCESS_PRIVATE);
-	nfs_req_st.reqs.size = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		qpair->s = req_q_s[ix];
-		nfs_rpc_q_init(&qpair->producer);
-		nfs_rpc_q_init(&qpair->consumer);
-	}
+		/* decoder thread pool */
+		reqparams.numa_node = n;
+		rc = fridgethr_init(&req_fridge[n], "decoder", &reqparams);
+		if (rc != 0)
+			LogFatal(COMPONENT_DISPATCH,
+				 "Unable to initialize decoder thread pool: %d",
+				 rc);
+
+		/* queues */
+		pthread_spin_init(&node->sp, PTHREAD_PROCESS_PRIVATE);
+		node->size = 0;
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			qpair = &(node->nfs_request_q.qset[ix]);
+			qpair->s = req_q_s[ix];
+			nfs_rpc_q_init(&qpair->producer);
+			nfs_rpc_q_init(&qpair->consumer);
+		}
 
-	/* waitq */
-	glist_init(&nfs_req_st.reqs.wait_list);
-	nfs_req_st.reqs.waiters = 0;
+		/* waitq */
+		glist_init(&node->wait_list);
+		node->waiters = 0;
+	}
 
 	/* stallq */
 	gsh_mutex_init(&nfs_req_st.stallq.mtx, NULL);
@@ -1239,11 +1703,75 @@ uint32_t get_dequeue_count(void)
 	return dequeued_reqs;
 }
 
+/**
+ * @brief NUMA node a transport's requests are decoded and queued on
+ *
+ * @param[in] xprt Transport
+ */
+static inline uint32_t xprt_node(SVCXPRT *xprt)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+
+	return xu != NULL ? rpc_evchan[xu->evchan].node : 0;
+}
+
+/**
+ * @brief Wake a worker waiting on a node
+ *
+ * @param[in] node The node
+ *
+ * @return true if one was waiting.
+ */
+static bool nfs_rpc_wake_node(struct req_q_node *node)
+{
+	wait_q_entry_t *wqe;
+
+	/* SPIN LOCKED */
+	pthread_spin_lock(&node->sp);
+	if (!node->waiters) {
+		/* ! SPIN LOCKED */
+		pthread_spin_unlock(&node->sp);
+		return false;
+	}
+
+	wqe = glist_first_entry(&node->wait_list, wait_q_entry_t, waitq);
+
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "node->waiters %u signal wqe %p",
+		     node->waiters, wqe);
+
+	/* release 1 waiter */
+	glist_del(&wqe->waitq);
+	--(node->waiters);
+	--(wqe->waiters);
+	/* ! SPIN LOCKED */
+	pthread_spin_unlock(&node->sp);
+	PTHREAD_MUTEX_lock(&wqe->lwe.mtx);
+	/* XXX reliable handoff */
+	wqe->flags |= Wqe_LFlag_SyncDone;
+	if (wqe->flags & Wqe_LFlag_WaitSync)
+		pthread_cond_signal(&wqe->lwe.cv);
+	PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
+	return true;
+}
+
+/**
+ * @brief Queue a request for the workers
+ *
+ * A request from a transport is queued on the node of its event
+ * channel, others on the node of the calling thread.  A worker of
+ * that node is woken if one waits, else one of another node, which
+ * counts as a handoff when it takes the request.
+ *
+ * @param[in] reqdata The request
+ */
 void nfs_rpc_enqueue_req(request_data_t *reqdata)
 {
 	struct req_q_set *nfs_request_q;
+	struct req_q_node *node;
 	struct req_q_pair *qpair;
 	struct req_q *q;
+	uint32_t home, ix;
 
 #if defined(HAVE_BLKIN)
 	BLKIN_TIMESTAMP(
@@ -1252,7 +1780,12 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 		"enqueue-enter");
 #endif
 
-	nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	if (reqdata->rtype == NFS_REQUEST)
+		home = xprt_node(reqdata->r_u.req.xprt);
+	else
+		home = gsh_numa_node();
+	node = &nfs_req_st.node[home];
+	nfs_request_q = &node->nfs_request_q;
 
 	switch (reqdata->rtype) {
 	case NFS_REQUEST:
@@ -1294,6 +1827,7 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 	pthread_spin_unlock(&q->sp);
 
 	atomic_inc_uint32_t(&enqueued_reqs);
+	(void)atomic_inc_uint64_t(&node->enqueued);
 
 #if defined(HAVE_BLKIN)
 	/* log the queue depth */
@@ -1314,37 +1848,14 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 		 q, qpair->s, &qpair->producer, &qpair->consumer, q->size,
 		 enqueued_reqs, dequeued_reqs);
 
-	/* potentially wakeup some thread */
-
-	/* global waitq */
-	{
-		wait_q_entry_t *wqe;
-
-		/* SPIN LOCKED */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		if (nfs_req_st.reqs.waiters) {
-			wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
-						wait_q_entry_t, waitq);
+	/* potentially wakeup some thread, of the node if one waits */
+	if (nfs_rpc_wake_node(node))
+		goto out;
 
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
-
-			/* release 1 waiter */
-			glist_del(&wqe->waitq);
-			--(nfs_req_st.reqs.waiters);
-			--(wqe->waiters);
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-			PTHREAD_MUTEX_lock(&wqe->lwe.mtx);
-			/* XXX reliable handoff */
-			wqe->flags |= Wqe_LFlag_SyncDone;
-			if (wqe->flags & Wqe_LFlag_WaitSync)
-				pthread_cond_signal(&wqe->lwe.cv);
-			PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
-		} else
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
+	for (ix = 1; ix < nfs_req_st.nnodes; ix++) {
+		if (nfs_rpc_wake_node(
+			&nfs_req_st.node[(home + ix) % nfs_req_st.nnodes]))
+			break;
 	}
 
  out:
@@ -1409,20 +1920,25 @@ request_data_t *nfs_rpc_consume_req(struct req_q_pair *qpair)
 	return reqdata;
 }
 
-request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+/**
+ * @brief Take a request from the queues of a node
+ *
+ * @param[in] node The node
+ *
+ * @return The request, NULL if there is none.
+ */
+static request_data_t *nfs_rpc_dequeue_node(struct req_q_node *node)
 {
 	request_data_t *reqdata = NULL;
-	struct req_q_set *nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	struct req_q_set *nfs_request_q = &node->nfs_request_q;
 	struct req_q_pair *qpair;
 	uint32_t ix, slot;
-	struct timespec timeout;
 
 	/* XXX: the following stands in for a more robust/flexible
 	 * weighting function */
 
 	/* slot in 1..4 */
- retry_deq:
-	slot = (nfs_rpc_q_next_slot() % 4);
+	slot = (nfs_rpc_q_next_slot(node) % 4);
 	for (ix = 0; ix < 4; ++ix) {
 		switch (slot) {
 		case 0:
@@ -1463,6 +1979,43 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 
 	}			/* for */
 
+	return reqdata;
+}
+
+/**
+ * @brief Take a request for a worker, waiting for one if need be
+ *
+ * Requests of the worker's node come first; only when it has none
+ * does the worker take those of another node.
+ *
+ * @param[in] worker The worker
+ *
+ * @return The request, NULL if the worker should stop.
+ */
+request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+{
+	request_data_t *reqdata = NULL;
+	struct req_q_node *home = &nfs_req_st.node[worker->node];
+	struct req_q_node *node;
+	uint32_t ix;
+	struct timespec timeout;
+
+ retry_deq:
+	reqdata = nfs_rpc_dequeue_node(home);
+	if (reqdata) {
+		(void)atomic_inc_uint64_t(&home->local);
+	} else {
+		for (ix = 1; ix < nfs_req_st.nnodes; ix++) {
+			node = &nfs_req_st.node[(worker->node + ix) %
+						nfs_req_st.nnodes];
+			reqdata = nfs_rpc_dequeue_node(node);
+			if (reqdata) {
+				(void)atomic_inc_uint64_t(&node->remote);
+				break;
+			}
+		}
+	}
+
 	/* wait */
 	if (!reqdata) {
 		struct fridgethr_context *ctx =
@@ -1474,10 +2027,10 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 		wqe->flags = Wqe_LFlag_WaitSync;
 		wqe->waiters = 1;
 		/* XXX functionalize */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		glist_add_tail(&nfs_req_st.reqs.wait_list, &wqe->waitq);
-		++(nfs_req_st.reqs.waiters);
-		pthread_spin_unlock(&nfs_req_st.reqs.sp);
+		pthread_spin_lock(&home->sp);
+		glist_add_tail(&home->wait_list, &wqe->waitq);
+		++(home->waiters);
+		pthread_spin_unlock(&home->sp);
 		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
 			timeout.tv_sec = time(NULL) + 5;
 			timeout.tv_nsec = 0;
@@ -1486,19 +2039,19 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 			if (fridgethr_you_should_break(ctx)) {
 				/* We are returning;
 				 * so take us out of the waitq */
-				pthread_spin_lock(&nfs_req_st.reqs.sp);
+				pthread_spin_lock(&home->sp);
 				if (wqe->waitq.next != NULL
 				    || wqe->waitq.prev != NULL) {
 					/* Element is still in wqitq,
 					 * remove it */
 					glist_del(&wqe->waitq);
-					--(nfs_req_st.reqs.waiters);
+					--(home->waiters);
 					--(wqe->waiters);
 					wqe->flags &=
 					    ~(Wqe_LFlag_WaitSync |
 					      Wqe_LFlag_SyncDone);
 				}
-				pthread_spin_unlock(&nfs_req_st.reqs.sp);
+				pthread_spin_unlock(&home->sp);
 				PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
 				return NULL;
 			}
@@ -1931,11 +2484,13 @@ void thr_decode_rpc_requests(struct fridgethr_context *thr_ctx)
 {
 	enum xprt_stat stat;
 	SVCXPRT *xprt = (SVCXPRT *) thr_ctx->arg;
+	uint32_t nreqs = 0;
 
 	LogFullDebug(COMPONENT_RPC, "enter xprt=%p", xprt);
 
 	do {
 		stat = thr_decode_rpc_request(NULL, xprt);
+		nreqs++;
 	} while (thr_continue_decoding(xprt, stat));
 
 	LogDebug(COMPONENT_DISPATCH, "exiting, stat=%s", xprt_stat_s[stat]);
@@ -1943,7 +2498,7 @@ void thr_decode_rpc_requests(struct fridgethr_context *thr_ctx)
 	/* order MUST be SVC_DESTROY, gsh_xprt_unref
 	 * (current refcnt balancing) */
 	if (stat != XPRT_DIED)
-		(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+		nfs_rpc_rearm_xprt(xprt, nreqs);
 	else
 		SVC_DESTROY(xprt);
 
@@ -2028,6 +2583,9 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 		LogFullDebug(COMPONENT_DISPATCH,
 			     "An initial RQUOTA request from a new client %d",
 			     rpc_fd);
+	else if (xprt->xp_type == XPRT_UDP)
+		LogFullDebug(COMPONENT_DISPATCH, "A UDP request fd %d",
+			     rpc_fd);
 	else
 		LogFullDebug(COMPONENT_DISPATCH,
 			     "An NFS TCP request from an already connected client %d",
@@ -2080,8 +2638,9 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 
 	LogFullDebug(COMPONENT_DISPATCH, "before fridgethr_get");
 
-	/* schedule a thread to decode */
-	code = fridgethr_submit(req_fridge, thr_decode_rpc_requests, xprt);
+	/* schedule a thread of the channel's node to decode */
+	code = fridgethr_submit(req_fridge[xprt_node(xprt)],
+				thr_decode_rpc_requests, xprt);
 	if (code == ETIMEDOUT) {
 		LogFullDebug(COMPONENT_RPC,
 			     "Decode dispatch timed out, rearming. xprt=%p",
@@ -2101,27 +2660,70 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 	return true;
 }
 
+/**
+ * @brief Pin the calling channel thread to a CPU
+ *
+ * Channel ix goes on the ix-th CPU the thread may run on, modulo
+ * their number: those of its NUMA node if it is bound to one.
+ *
+ * @param[in] ix Index of the channel
+ */
+static void evchan_set_affinity(int ix)
+{
+	cpu_set_t allowed, cpus;
+	int cpu, n, rc;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 ||
+	    CPU_COUNT(&allowed) == 0) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot get the CPUs of the process, error %d(%s)",
+			errno, strerror(errno));
+		return;
+	}
+
+	n = ix % CPU_COUNT(&allowed);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &allowed) && n-- == 0)
+			break;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (rc != 0)
+		LogWarn(COMPONENT_DISPATCH,
+			"Cannot pin event channel %d to CPU %d, error %d(%s)",
+			ix, cpu, rc, strerror(rc));
+	else
+		LogDebug(COMPONENT_DISPATCH,
+			 "Event channel %d pinned to CPU %d", ix, cpu);
+}
+
 /**
  * @brief Thread used to service an (epoll, etc) event channel.
  *
- * @param[in] arg Poitner to ID of the associated event channel
+ * @param[in] arg Pointer to the struct rpc_evchan of the channel
  *
  * @return Pointer to the result (but this function will mostly loop forever).
  *
  */
 static void *rpc_dispatcher_thread(void *arg)
 {
-	int32_t chan_id = *((int32_t *) arg);
+	struct rpc_evchan *evchan = arg;
 
 	SetNameFunction("disp");
 
+	gsh_numa_bind(evchan->node);
+
+	if (nfs_param.core_param.rpc.evchan_affinity)
+		evchan_set_affinity((evchan - rpc_evchan) / gsh_numa_nodes());
+
 	/* Calling dispatcher main loop */
 	LogInfo(COMPONENT_DISPATCH, "Entering nfs/rpc dispatcher");
 
 	LogDebug(COMPONENT_DISPATCH, "My pthread id is %p",
 		 (caddr_t) pthread_self());
 
-	svc_rqst_thrd_run(chan_id, SVC_RQST_FLAG_NONE);
+	svc_rqst_thrd_run(evchan->chan_id, SVC_RQST_FLAG_NONE);
 
 	return NULL;
 }				/* rpc_dispatcher_thread */
@@ -2157,5 +2759,12 @@ static int nfs_rpc_get_args(nfs_request_t *reqnfs)
 		return false;
 	}
 
+#ifdef _HAVE_GSSAPI
+	/* A large RPCSEC_GSS body was only read off the connection,
+	 * nfs_rpc_execute() unwraps and decodes it */
+	if (svcauth_gss_args_deferred(&reqnfs->svc))
+		reqnfs->lookahead.flags |= NFS_LOOKAHEAD_DEFERRED;
+#endif
+
 	return true;
 }
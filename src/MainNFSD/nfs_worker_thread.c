@@ -60,6 +60,7 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "gsh_numa.h"
 
 #ifdef USE_LTTNG
 #include "gsh_lttng/nfs_rpc.h"
@@ -67,7 +68,7 @@
 
 pool_t *request_pool;
 
-static struct fridgethr *worker_fridge;
+static struct fridgethr *worker_fridge[GSH_NUMA_MAX_NODES]; /*< Per node */
 
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
@@ -796,6 +797,27 @@ void nfs_rpc_execute(request_data_t *reqdata)
 		&reqdata->r_u.req.xprt->blkin.endp,
 		"rpc_execute-have-clientid");
 #endif
+
+#ifdef _HAVE_GSSAPI
+	/* The decoder left a large krb5i/krb5p body wrapped, check or
+	 * decrypt it here, in parallel with the decoding of later calls */
+	if (reqdata->r_u.req.lookahead.flags & NFS_LOOKAHEAD_DEFERRED
+	    && !svcauth_gss_complete_args(&reqdata->r_u.req.svc,
+					  reqdesc->xdr_decode_func,
+					  (caddr_t) arg_nfs)) {
+		LogInfo(COMPONENT_DISPATCH,
+			"RPCSEC_GSS unwrap failed for Program %d, Version %d, Function %d xid=%u",
+			(int)reqdata->r_u.req.svc.rq_prog,
+			(int)reqdata->r_u.req.svc.rq_vers,
+			(int)reqdata->r_u.req.svc.rq_proc,
+			reqdata->r_u.req.svc.rq_xid);
+		res_nfs = NULL;
+		DISP_SLOCK(xprt);
+		svcerr_decode(xprt, &reqdata->r_u.req.svc);
+		goto freeargs;
+	}
+#endif
+
 	/* If req is uncacheable, or if req is v41+, nfs_dupreq_start will do
 	 * nothing but allocate a result object and mark the request (ie, the
 	 * path is short, lockless, and does no hash/search). */
@@ -1480,6 +1502,7 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 	char thr_name[32];
 
 	wd->worker_index = atomic_inc_uint32_t(&worker_indexer);
+	wd->node = gsh_numa_node();
 	snprintf(thr_name, sizeof(thr_name), "work-%u", wd->worker_index);
 	SetNameFunction(thr_name);
 
@@ -1591,32 +1614,50 @@ static void worker_run(struct fridgethr_context *ctx)
 	}
 }
 
+/**
+ * @brief Start the workers
+ *
+ * Nb_Worker workers, split into a pool per NUMA node bound to it.  A
+ * node left without workers has no pool, the others take its requests.
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
 int worker_init(void)
 {
 	struct fridgethr_params frp;
+	uint32_t node;
 	int rc = 0;
 
 	memset(&frp, 0, sizeof(struct fridgethr_params));
-	frp.thr_max = nfs_param.core_param.nb_worker;
-	frp.thr_min = nfs_param.core_param.nb_worker;
 	frp.flavor = fridgethr_flavor_looper;
 	frp.thread_initialize = worker_thread_initializer;
 	frp.thread_finalize = worker_thread_finalizer;
 	frp.wake_threads = nfs_rpc_queue_awaken;
 	frp.wake_threads_arg = &nfs_req_st;
+	frp.numa_bind = true;
 
-	rc = fridgethr_init(&worker_fridge, "Wrk", &frp);
-	if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Unable to initialize worker fridge: %d", rc);
-		return rc;
-	}
-
-	rc = fridgethr_populate(worker_fridge, worker_run, NULL);
+	for (node = 0; node < gsh_numa_nodes(); node++) {
+		frp.thr_max = gsh_numa_share(nfs_param.core_param.nb_worker,
+					     node);
+		if (frp.thr_max == 0)
+			continue;
+		frp.thr_min = frp.thr_max;
+		frp.numa_node = node;
+
+		rc = fridgethr_init(&worker_fridge[node], "Wrk", &frp);
+		if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Unable to initialize worker fridge: %d", rc);
+			return rc;
+		}
 
-	if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Unable to populate worker fridge: %d", rc);
+		rc = fridgethr_populate(worker_fridge[node], worker_run, NULL);
+		if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Unable to populate worker fridge: %d", rc);
+			return rc;
+		}
 	}
 
 	return rc;
@@ -1624,17 +1665,26 @@ int worker_init(void)
 
 int worker_shutdown(void)
 {
-	int rc = fridgethr_sync_command(worker_fridge,
-					fridgethr_comm_stop,
-					120);
-
-	if (rc == ETIMEDOUT) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Shutdown timed out, cancelling threads.");
-		fridgethr_cancel(worker_fridge);
-	} else if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Failed shutting down worker threads: %d", rc);
+	uint32_t node;
+	int rc, ret = 0;
+
+	for (node = 0; node < gsh_numa_nodes(); node++) {
+		if (worker_fridge[node] == NULL)
+			continue;
+		rc = fridgethr_sync_command(worker_fridge[node],
+					    fridgethr_comm_stop,
+					    120);
+
+		if (rc == ETIMEDOUT) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Shutdown timed out, cancelling threads.");
+			fridgethr_cancel(worker_fridge[node]);
+		} else if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Failed shutting down worker threads: %d", rc);
+		}
+		if (rc != 0)
+			ret = rc;
 	}
-	return rc;
+	return ret;
 }
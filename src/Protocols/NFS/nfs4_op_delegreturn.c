@@ -67,7 +67,7 @@ int nfs4_op_delegreturn(struct nfs_argop4 *op, compound_data_t *data,
 	DELEGRETURN4res * const res_DELEGRETURN4 =
 	    &resp->nfs_resop4_u.opdelegreturn;
 
-	state_status_t state_status;
+	state_status_t state_status = STATE_ESTALE;
 	state_t *state_found;
 	const char *tag = "DELEGRETURN";
 	state_owner_t *owner;
@@ -140,6 +140,10 @@ int nfs4_op_delegreturn(struct nfs_argop4 *op, compound_data_t *data,
 
 	PTHREAD_RWLOCK_unlock(&data->current_entry->state_lock);
 
+	/* A recall waiting for this return needs no more checks */
+	if (state_status == STATE_SUCCESS)
+		delegrevoke_check_cancel(state_found);
+
 	dec_state_t_ref(state_found);
 
 	return res_DELEGRETURN4->status;
@@ -534,6 +534,44 @@ void nfs4_op_layoutget_Free(nfs_resop4 *res)
 
 }				/* nfs41_op_layoutget_Free */
 
+/**
+ * @brief Find the FSAL that issued a deviceid
+ *
+ * @param[in] deviceid The deviceid, as sent by the client
+ * @param[in] tag      Operation, for the log
+ *
+ * @return The FSAL, NULL if there is none.
+ */
+
+static struct fsal_module *device_fsal(const struct pnfs_deviceid *deviceid,
+				       const char *tag)
+{
+	struct fsal_module *fsal = NULL;
+
+	if (deviceid->fsal_id < FSAL_ID_COUNT)
+		fsal = pnfs_fsal[deviceid->fsal_id];
+
+	if (fsal == NULL)
+		LogInfo(COMPONENT_PNFS,
+			"%s with invalid or inactive fsal id %0hhx",
+			tag, deviceid->fsal_id);
+
+	return fsal;
+}
+
+/**
+ * @brief The NFS4_OP_LAYOUTERROR operation
+ *
+ * Each error is passed to the FSAL that issued its device, which may
+ * stop handing the device out.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862 p. 69
+ */
+
 int nfs4_op_layouterror(struct nfs_argop4 *op, compound_data_t *data,
 		      struct nfs_resop4 *resp)
 {
@@ -545,16 +583,67 @@ int nfs4_op_layouterror(struct nfs_argop4 *op, compound_data_t *data,
 					&resp->nfs_resop4_u.oplayouterror;
 	/* NFSv4.2 status code */
 	nfsstat4 nfs_status = 0;
+	/* The layout the errors were had through */
+	state_t *layout_state = NULL;
+	layouttype4 type;
+	struct pnfs_deviceid *deviceid;
+	struct fsal_module *fsal;
+	device_error4 *error;
+	u_int i;
+
+	resp->resop = NFS4_OP_LAYOUTERROR;
+
+	nfs_status = nfs4_sanity_check_FH(data, REGULAR_FILE, false);
 
-	LogEvent(COMPONENT_PNFS,
-		 "LAYOUTERROR OP %d status %d offset: %" PRIu64
-		 " length: %" PRIu64,
-		 arg_LAYOUTERROR4->lea_errors.de_opnum,
-		 arg_LAYOUTERROR4->lea_errors.de_status,
-		 arg_LAYOUTERROR4->lea_offset,
-		 arg_LAYOUTERROR4->lea_length);
+	if (nfs_status != NFS4_OK)
+		goto out;
+
+	nfs_status = nfs4_Check_Stateid(&arg_LAYOUTERROR4->lea_stateid,
+					data->current_entry,
+					&layout_state, data,
+					STATEID_SPECIAL_CURRENT,
+					0,
+					false,
+					"LAYOUTERROR");
+
+	if (nfs_status != NFS4_OK)
+		goto out;
+
+	if (layout_state->state_type != STATE_TYPE_LAYOUT) {
+		nfs_status = NFS4ERR_BAD_STATEID;
+		goto out;
+	}
+
+	type = layout_state->state_data.layout.state_layout_type;
+
+	for (i = 0; i < arg_LAYOUTERROR4->lea_errors.lea_errors_len; i++) {
+		error = &arg_LAYOUTERROR4->lea_errors.lea_errors_val[i];
+
+		LogEvent(COMPONENT_PNFS,
+			 "LAYOUTERROR OP %d status %d offset: %" PRIu64
+			 " length: %" PRIu64,
+			 error->de_opnum, error->de_status,
+			 arg_LAYOUTERROR4->lea_offset,
+			 arg_LAYOUTERROR4->lea_length);
+
+		deviceid = (struct pnfs_deviceid *)error->de_deviceid;
+		fsal = device_fsal(deviceid, "LAYOUTERROR");
+		if (fsal == NULL) {
+			nfs_status = NFS4ERR_INVAL;
+			goto out;
+		}
 
-	/** @todo: what else do we want to do with this error ???  */
+		nfs_status = fsal->m_ops.layouterror(fsal, type, deviceid,
+						     error->de_status,
+						     error->de_opnum);
+		if (nfs_status != NFS4_OK)
+			goto out;
+	}
+
+ out:
+
+	if (layout_state != NULL)
+		dec_state_t_ref(layout_state);
 
 	res_LAYOUTERROR4->ler_status = nfs_status;
 
@@ -565,6 +654,19 @@ void nfs4_op_layouterror_Free(nfs_resop4 *res)
 {
 }
 
+/**
+ * @brief The NFS4_OP_LAYOUTSTATS operation
+ *
+ * The statistics are passed to the FSAL that issued the device, with
+ * the type of the layout the stateid is of.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC7862 p. 70
+ */
+
 int nfs4_op_layoutstats(struct nfs_argop4 *op, compound_data_t *data,
 		      struct nfs_resop4 *resp)
 {
@@ -574,23 +676,83 @@ int nfs4_op_layoutstats(struct nfs_argop4 *op, compound_data_t *data,
 	/* Convenience alias for response */
 	LAYOUTSTATS4res * const res_LAYOUTSTATS4 =
 					&resp->nfs_resop4_u.oplayoutstats;
+	/* Convenience alias for the layout type-specific update */
+	layoutupdate4 * const update = &arg_LAYOUTSTATS4->lsa_layoutupdate;
 	/* NFSv4.2 status code */
 	nfsstat4 nfs_status = 0;
+	/* The layout the statistics are of */
+	state_t *layout_state = NULL;
+	layouttype4 type;
+	struct pnfs_deviceid *deviceid;
+	struct fsal_module *fsal;
+	XDR lou_body;
 
-	LogEvent(COMPONENT_PNFS,
-		 "LAYOUTSTATS offset %" PRIu64 " length %" PRIu64,
-		 arg_LAYOUTSTATS4->lsa_offset,
-		 arg_LAYOUTSTATS4->lsa_length);
+	resp->resop = NFS4_OP_LAYOUTSTATS;
+
+	nfs_status = nfs4_sanity_check_FH(data, REGULAR_FILE, false);
+
+	if (nfs_status != NFS4_OK)
+		goto out;
 
-	LogEvent(COMPONENT_PNFS,
-		 "LAYOUTSTATS read count %u bytes %" PRIu64
+	nfs_status = nfs4_Check_Stateid(&arg_LAYOUTSTATS4->lsa_stateid,
+					data->current_entry,
+					&layout_state, data,
+					STATEID_SPECIAL_CURRENT,
+					0,
+					false,
+					"LAYOUTSTATS");
+
+	if (nfs_status != NFS4_OK)
+		goto out;
+
+	if (layout_state->state_type != STATE_TYPE_LAYOUT) {
+		nfs_status = NFS4ERR_BAD_STATEID;
+		goto out;
+	}
+
+	type = layout_state->state_data.layout.state_layout_type;
+
+	/* The body is read as the layout's type */
+	if (update->lou_body.lou_body_len != 0 && update->lou_type != type) {
+		nfs_status = NFS4ERR_INVAL;
+		goto out;
+	}
+
+	LogDebug(COMPONENT_PNFS,
+		 "LAYOUTSTATS offset %" PRIu64 " length %" PRIu64
+		 " read count %u bytes %" PRIu64
 		 " write count %u bytes %" PRIu64,
+		 arg_LAYOUTSTATS4->lsa_offset,
+		 arg_LAYOUTSTATS4->lsa_length,
 		 arg_LAYOUTSTATS4->lsa_read.ii_count,
 		 arg_LAYOUTSTATS4->lsa_read.ii_bytes,
 		 arg_LAYOUTSTATS4->lsa_write.ii_count,
 		 arg_LAYOUTSTATS4->lsa_write.ii_bytes);
 
-	/** @todo: what else do we want to do with the stats ???  */
+	deviceid = (struct pnfs_deviceid *)arg_LAYOUTSTATS4->lsa_deviceid;
+	fsal = device_fsal(deviceid, "LAYOUTSTATS");
+	if (fsal == NULL) {
+		nfs_status = NFS4ERR_INVAL;
+		goto out;
+	}
+
+	if (update->lou_body.lou_body_len != 0)
+		xdrmem_create(&lou_body, update->lou_body.lou_body_val,
+			      update->lou_body.lou_body_len, XDR_DECODE);
+
+	nfs_status = fsal->m_ops.layoutstats(fsal, type, deviceid,
+					     &arg_LAYOUTSTATS4->lsa_read,
+					     &arg_LAYOUTSTATS4->lsa_write,
+					     update->lou_body.lou_body_len != 0
+						? &lou_body : NULL);
+
+	if (update->lou_body.lou_body_len != 0)
+		xdr_destroy(&lou_body);
+
+ out:
+
+	if (layout_state != NULL)
+		dec_state_t_ref(layout_state);
 
 	res_LAYOUTSTATS4->lsr_status = nfs_status;
 
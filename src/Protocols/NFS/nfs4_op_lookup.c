@@ -118,14 +118,14 @@ int nfs4_op_lookup(struct nfs_argop4 *op, compound_data_t *data,
 	PTHREAD_RWLOCK_rdlock(&file_entry->attr_lock);
 
 	if (file_entry->type == DIRECTORY &&
-	    file_entry->object.dir.junction_export != NULL) {
+	    file_entry->object.dir->junction_export != NULL) {
 		/* Handle junction */
 		cache_entry_t *entry = NULL;
 
 		/* Attempt to get a reference to the export across the
 		 * junction.
 		 */
-		if (!export_ready(file_entry->object.dir.junction_export)) {
+		if (!export_ready(file_entry->object.dir->junction_export)) {
 			/* If we could not get a reference, return stale.
 			 * Release attr_lock
 			 */
@@ -136,14 +136,14 @@ int nfs4_op_lookup(struct nfs_argop4 *op, compound_data_t *data,
 			goto out;
 		}
 
-		get_gsh_export_ref(file_entry->object.dir.junction_export);
+		get_gsh_export_ref(file_entry->object.dir->junction_export);
 
 		/* Release any old export reference */
 		if (op_ctx->export != NULL)
 			put_gsh_export(op_ctx->export);
 
 		/* Stash the new export in the compound data. */
-		op_ctx->export = file_entry->object.dir.junction_export;
+		op_ctx->export = file_entry->object.dir->junction_export;
 		op_ctx->fsal_export = op_ctx->export->fsal_export;
 
 		/* Release attr_lock */
@@ -1076,10 +1076,17 @@ static void do_delegation(OPEN4args *arg_OPEN4, OPEN4res *res_OPEN4,
 	bool prerecall;
 	struct file_deleg_stats *fdeleg_stats =
 				&data->current_entry->object.file.fdeleg_stats;
+	struct timespec ts;
 
 	/* This will be updated later if we actually delegate */
 	resok->delegation.delegation_type = OPEN_DELEGATE_NONE;
 
+	/* Update delegation open stats */
+	now(&ts);
+	deleg_policy_open(fdeleg_stats, clientid->cid_clientid,
+			  arg_OPEN4->share_access & OPEN4_SHARE_ACCESS_WRITE,
+			  timespec_to_nsecs(&ts));
+
 	/* Client doesn't want a delegation. */
 	if (arg_OPEN4->share_access & OPEN4_SHARE_ACCESS_WANT_NO_DELEG) {
 		resok->delegation.open_delegation4_u.
@@ -1099,11 +1106,6 @@ static void do_delegation(OPEN4args *arg_OPEN4, OPEN4res *res_OPEN4,
 	if (can_we_grant_deleg(data->current_entry, open_state) &&
 	    should_we_grant_deleg(data->current_entry, clientid, open_state,
 				  arg_OPEN4, owner, &prerecall)) {
-		/* Update delegation open stats */
-		if (fdeleg_stats->fds_num_opens == 0)
-			fdeleg_stats->fds_first_open = time(NULL);
-		fdeleg_stats->fds_num_opens++;
-
 		LogDebug(COMPONENT_STATE, "Attempting to grant delegation");
 		get_delegation(data, arg_OPEN4, open_state, owner, clientid,
 			       resok, prerecall);
@@ -250,8 +250,15 @@ int nfs4_op_putfh(struct nfs_argop4 *op, compound_data_t *data,
 		}
 
 		/* Build the pentry.  Refcount +1. */
-		cache_status = cache_inode_get(&fsal_data,
-					       &file_entry);
+		if (v4_handle->fhflags1 & FH_CACHE_HINT)
+			cache_status = cache_inode_get_hinted(
+				&fsal_data,
+				nfs_fh_hint(v4_handle->fsopaque,
+					    v4_handle->fs_len),
+				&file_entry);
+		else
+			cache_status = cache_inode_get(&fsal_data,
+						       &file_entry);
 		if (cache_status != CACHE_INODE_SUCCESS) {
 			res_PUTFH4->status = nfs4_Errno(cache_status);
 			return res_PUTFH4->status;
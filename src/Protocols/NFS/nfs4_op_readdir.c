@@ -136,7 +136,7 @@ cache_inode_status_t nfs4_readdir_callback(void *opaque,
 	 */
 	if (cb_parms->attr_allowed &&
 	    entry->type == DIRECTORY &&
-	    entry->object.dir.junction_export != NULL &&
+	    entry->object.dir->junction_export != NULL &&
 	    cb_state == CB_ORIGINAL) {
 		/* This is a junction. Code used to not recognize this
 		 * which resulted in readdir giving different attributes
@@ -148,27 +148,27 @@ cache_inode_status_t nfs4_readdir_callback(void *opaque,
 		LogDebug(COMPONENT_EXPORT,
 			 "Offspring DIR %s is a junction Export_id %d Path %s",
 			 cb_parms->name,
-			 entry->object.dir.junction_export->export_id,
-			 entry->object.dir.junction_export->fullpath);
+			 entry->object.dir->junction_export->export_id,
+			 entry->object.dir->junction_export->fullpath);
 
 		/* Get a reference to the export and stash it in
 		 * compound data.
 		 */
-		if (!export_ready(entry->object.dir.junction_export)) {
+		if (!export_ready(entry->object.dir->junction_export)) {
 			/* Export is in the process of being released.
 			 * Pretend it's not actually a junction.
 			 */
 			goto not_junction;
 		}
 
-		get_gsh_export_ref(entry->object.dir.junction_export);
+		get_gsh_export_ref(entry->object.dir->junction_export);
 
 		/* Save the compound data context */
 		tracker->save_export_perms = *op_ctx->export_perms;
 		tracker->saved_gsh_export = op_ctx->export;
 
 		/* Cross the junction */
-		op_ctx->export = entry->object.dir.junction_export;
+		op_ctx->export = entry->object.dir->junction_export;
 		op_ctx->fsal_export = op_ctx->export->fsal_export;
 
 		/* Build the credentials */
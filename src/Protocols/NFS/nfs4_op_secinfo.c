@@ -101,32 +101,32 @@ int nfs4_op_secinfo(struct nfs_argop4 *op, compound_data_t *data,
 	PTHREAD_RWLOCK_rdlock(&entry_src->attr_lock);
 
 	if (entry_src->type == DIRECTORY &&
-	    entry_src->object.dir.junction_export != NULL) {
+	    entry_src->object.dir->junction_export != NULL) {
 		/* Handle junction */
 		cache_entry_t *entry = NULL;
 
 		/* Try to get a reference to the export. */
-		if (!export_ready(entry_src->object.dir.junction_export)) {
+		if (!export_ready(entry_src->object.dir->junction_export)) {
 			/* Export has gone bad. */
 			/* Release attr_lock */
 			PTHREAD_RWLOCK_unlock(&entry_src->attr_lock);
 			LogDebug(COMPONENT_EXPORT,
 				 "NFS4ERR_STALE On Export_Id %d Path %s",
 				 entry_src->object.dir
-					.junction_export->export_id,
+					->junction_export->export_id,
 				 entry_src->object.dir
-					.junction_export->fullpath);
+					->junction_export->fullpath);
 			res_SECINFO4->status = NFS4ERR_STALE;
 			goto out;
 		}
 
-		get_gsh_export_ref(entry_src->object.dir.junction_export);
+		get_gsh_export_ref(entry_src->object.dir->junction_export);
 
 		/* Save the compound data context */
 		save_export_perms = *op_ctx->export_perms;
 		saved_gsh_export = op_ctx->export;
 
-		op_ctx->export = entry_src->object.dir.junction_export;
+		op_ctx->export = entry_src->object.dir->junction_export;
 		op_ctx->fsal_export = op_ctx->export->fsal_export;
 
 		/* Release attr_lock */
@@ -444,7 +444,7 @@ bool pseudo_mount_export(struct gsh_export *export)
 	/* Now that all entries are added to pseudofs tree, and we are pointing
 	 * to the final node, make it a proper junction.
 	 */
-	state.dirent->object.dir.junction_export = export;
+	state.dirent->object.dir->junction_export = export;
 
 	/* And fill in the mounted on information for the export. */
 	PTHREAD_RWLOCK_wrlock(&export->lock);
@@ -573,7 +573,7 @@ void pseudo_unmount_export(struct gsh_export *export)
 		PTHREAD_RWLOCK_wrlock(&export->lock);
 
 		/* Make the node not accessible from the junction node. */
-		junction_inode->object.dir.junction_export = NULL;
+		junction_inode->object.dir->junction_export = NULL;
 
 		/* Detach the export from the inode */
 		export->exp_junction_inode = NULL;
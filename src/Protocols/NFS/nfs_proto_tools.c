@@ -328,36 +328,43 @@ static fattr_xdr_result decode_supported_attrs(XDR *xdr,
  * FATTR4_TYPE
  */
 
-static fattr_xdr_result encode_type(XDR *xdr, struct xdr_attrs_args *args)
+static inline bool nfs4_type_of(object_file_type_t type, uint32_t *file_type)
 {
-	uint32_t file_type;
-
-	switch (args->attrs->type) {
+	switch (type) {
 	case REGULAR_FILE:
 	case EXTENDED_ATTR:
-		file_type = NF4REG;	/* Regular file */
+		*file_type = NF4REG;	/* Regular file */
 		break;
 	case DIRECTORY:
-		file_type = NF4DIR;	/* Directory */
+		*file_type = NF4DIR;	/* Directory */
 		break;
 	case BLOCK_FILE:
-		file_type = NF4BLK;	/* Special File - block device */
+		*file_type = NF4BLK;	/* Special File - block device */
 		break;
 	case CHARACTER_FILE:
-		file_type = NF4CHR;	/* Special File - character device */
+		*file_type = NF4CHR;	/* Special File - character device */
 		break;
 	case SYMBOLIC_LINK:
-		file_type = NF4LNK;	/* Symbolic Link */
+		*file_type = NF4LNK;	/* Symbolic Link */
 		break;
 	case SOCKET_FILE:
-		file_type = NF4SOCK;	/* Special File - socket */
+		*file_type = NF4SOCK;	/* Special File - socket */
 		break;
 	case FIFO_FILE:
-		file_type = NF4FIFO;	/* Special File - fifo */
+		*file_type = NF4FIFO;	/* Special File - fifo */
 		break;
 	default:		/* includes NO_FILE_TYPE & FS_JUNCTION: */
-		return FATTR_XDR_FAILED;	/* silently skip bogus? */
+		return false;	/* silently skip bogus? */
 	}			/* switch( pattr->type ) */
+	return true;
+}
+
+static fattr_xdr_result encode_type(XDR *xdr, struct xdr_attrs_args *args)
+{
+	uint32_t file_type;
+
+	if (!nfs4_type_of(args->attrs->type, &file_type))
+		return FATTR_XDR_FAILED;
 	if (!xdr_u_int32_t(xdr, &file_type))
 		return FATTR_XDR_FAILED;
 	return FATTR_XDR_SUCCESS;
@@ -545,19 +552,24 @@ static fattr_xdr_result decode_namedattrsupport(XDR *xdr,
  * FATTR4_FSID
  */
 
-static fattr_xdr_result encode_fsid(XDR *xdr, struct xdr_attrs_args *args)
+static inline void nfs4_fsid_of(struct xdr_attrs_args *args, fsid4 *fsid)
 {
-	fsid4 fsid = {0, 0};
-
 	if (args->data != NULL &&
 	    (op_ctx->export->options_set &
 	     EXPORT_OPTION_FSID_SET) != 0) {
-		fsid.major = op_ctx->export->filesystem_id.major;
-		fsid.minor = op_ctx->export->filesystem_id.minor;
+		fsid->major = op_ctx->export->filesystem_id.major;
+		fsid->minor = op_ctx->export->filesystem_id.minor;
 	} else {
-		fsid.major = args->attrs->fsid.major;
-		fsid.minor = args->attrs->fsid.minor;
+		fsid->major = args->attrs->fsid.major;
+		fsid->minor = args->attrs->fsid.minor;
 	}
+}
+
+static fattr_xdr_result encode_fsid(XDR *xdr, struct xdr_attrs_args *args)
+{
+	fsid4 fsid;
+
+	nfs4_fsid_of(args, &fsid);
 
 	if (!xdr_u_int64_t(xdr, &fsid.major))
 		return FATTR_XDR_FAILED;
@@ -3327,6 +3339,236 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 	}
 }
 
+/*
+ * Precompiled encoders
+ *
+ * Nearly all GETATTR and READDIR requests ask for one of a handful of
+ * bitmaps, those the Linux client uses to fill its attribute cache, for
+ * READDIRPLUS (the same plus rdattr_error and filehandle), for a plain
+ * READDIR and for post operation attributes.  Each of those has an
+ * encoder instantiated from fattr4_fast_encode with a constant mask, so
+ * it is straight line code writing the fixed size attributes directly
+ * into the buffer, one XDR_INLINE per run.  The output is the same as
+ * the fattr4tab encoders give, which are still used for any other
+ * bitmap.
+ */
+
+#define FATTR4_BIT(attr) ((uint32_t) 1 << ((attr) % 32))
+#define FATTR4_HAS(word, attr) (((word) & FATTR4_BIT(attr)) != 0)
+#define FATTR4_LEN(word, attr, len) (FATTR4_HAS(word, attr) ? (len) : 0)
+
+#define FATTR4_FAST_CACHE0 (FATTR4_BIT(FATTR4_CHANGE) |			\
+			    FATTR4_BIT(FATTR4_SIZE))
+#define FATTR4_FAST_CACHE1 (FATTR4_BIT(FATTR4_TIME_METADATA) |		\
+			    FATTR4_BIT(FATTR4_TIME_MODIFY))
+#define FATTR4_FAST_GETATTR0 (FATTR4_BIT(FATTR4_TYPE) |			\
+			      FATTR4_FAST_CACHE0 |			\
+			      FATTR4_BIT(FATTR4_FSID) |			\
+			      FATTR4_BIT(FATTR4_FILEID))
+#define FATTR4_FAST_GETATTR1 (FATTR4_BIT(FATTR4_MODE) |			\
+			      FATTR4_BIT(FATTR4_NUMLINKS) |		\
+			      FATTR4_BIT(FATTR4_OWNER) |		\
+			      FATTR4_BIT(FATTR4_OWNER_GROUP) |		\
+			      FATTR4_BIT(FATTR4_RAWDEV) |		\
+			      FATTR4_BIT(FATTR4_SPACE_USED) |		\
+			      FATTR4_BIT(FATTR4_TIME_ACCESS) |		\
+			      FATTR4_FAST_CACHE1 |			\
+			      FATTR4_BIT(FATTR4_MOUNTED_ON_FILEID))
+#define FATTR4_FAST_READDIRPLUS0 (FATTR4_FAST_GETATTR0 |		\
+				  FATTR4_BIT(FATTR4_RDATTR_ERROR) |	\
+				  FATTR4_BIT(FATTR4_FILEHANDLE))
+#define FATTR4_FAST_READDIR0 (FATTR4_BIT(FATTR4_RDATTR_ERROR) |		\
+			      FATTR4_BIT(FATTR4_FILEID))
+#define FATTR4_FAST_READDIR1 FATTR4_BIT(FATTR4_MOUNTED_ON_FILEID)
+
+static inline int32_t *fattr4_put_u64(int32_t *p, uint64_t v)
+{
+	IXDR_PUT_U_INT32(p, v >> 32);
+	IXDR_PUT_U_INT32(p, v);
+	return p;
+}
+
+static inline int32_t *fattr4_put_time(int32_t *p, const struct timespec *ts)
+{
+	p = fattr4_put_u64(p, ts->tv_sec);
+	IXDR_PUT_U_INT32(p, ts->tv_nsec);
+	return p;
+}
+
+/**
+ * @brief Encode the attributes of words 0 and 1 of a precompiled bitmap
+ *
+ * Only attributes of the FATTR4_FAST_* masks are handled, all of them
+ * below the maximum attribute index of any minor version.
+ *
+ * @param[in] xdr  Stream to encode into
+ * @param[in] args Attributes
+ * @param[in] w0   Word 0 of the bitmap, a constant
+ * @param[in] w1   Word 1 of the bitmap, a constant
+ *
+ * @return true on success.
+ */
+
+static inline __attribute__((always_inline))
+bool fattr4_fast_encode(XDR *xdr, struct xdr_attrs_args *args,
+			const uint32_t w0, const uint32_t w1)
+{
+	struct attrlist *attrs = args->attrs;
+	uint32_t file_type;
+	fsid4 fsid;
+	int32_t *p;
+	u_int len;
+
+	len = FATTR4_LEN(w0, FATTR4_TYPE, 4) +
+	      FATTR4_LEN(w0, FATTR4_CHANGE, 8) +
+	      FATTR4_LEN(w0, FATTR4_SIZE, 8) +
+	      FATTR4_LEN(w0, FATTR4_FSID, 16) +
+	      FATTR4_LEN(w0, FATTR4_RDATTR_ERROR, 4);
+	if (len != 0) {
+		p = XDR_INLINE(xdr, len);
+		if (p == NULL)
+			return false;
+		if (FATTR4_HAS(w0, FATTR4_TYPE)) {
+			if (!nfs4_type_of(attrs->type, &file_type))
+				return false;
+			IXDR_PUT_U_INT32(p, file_type);
+		}
+		if (FATTR4_HAS(w0, FATTR4_CHANGE))
+			p = fattr4_put_u64(p, attrs->change);
+		if (FATTR4_HAS(w0, FATTR4_SIZE))
+			p = fattr4_put_u64(p, attrs->filesize);
+		if (FATTR4_HAS(w0, FATTR4_FSID)) {
+			nfs4_fsid_of(args, &fsid);
+			p = fattr4_put_u64(p, fsid.major);
+			p = fattr4_put_u64(p, fsid.minor);
+		}
+		if (FATTR4_HAS(w0, FATTR4_RDATTR_ERROR))
+			IXDR_PUT_U_INT32(p, args->rdattr_error);
+	}
+
+	if (FATTR4_HAS(w0, FATTR4_FILEHANDLE) &&
+	    encode_filehandle(xdr, args) != FATTR_XDR_SUCCESS)
+		return false;
+
+	len = FATTR4_LEN(w0, FATTR4_FILEID, 8) +
+	      FATTR4_LEN(w1, FATTR4_MODE, 4) +
+	      FATTR4_LEN(w1, FATTR4_NUMLINKS, 4);
+	if (len != 0) {
+		p = XDR_INLINE(xdr, len);
+		if (p == NULL)
+			return false;
+		if (FATTR4_HAS(w0, FATTR4_FILEID))
+			p = fattr4_put_u64(p, attrs->fileid);
+		if (FATTR4_HAS(w1, FATTR4_MODE))
+			IXDR_PUT_U_INT32(p, fsal2unix_mode(attrs->mode));
+		if (FATTR4_HAS(w1, FATTR4_NUMLINKS))
+			IXDR_PUT_U_INT32(p, attrs->numlinks);
+	}
+
+	if (FATTR4_HAS(w1, FATTR4_OWNER) &&
+	    !xdr_encode_nfs4_owner(xdr, attrs->owner))
+		return false;
+	if (FATTR4_HAS(w1, FATTR4_OWNER_GROUP) &&
+	    !xdr_encode_nfs4_group(xdr, attrs->group))
+		return false;
+
+	len = FATTR4_LEN(w1, FATTR4_RAWDEV, 8) +
+	      FATTR4_LEN(w1, FATTR4_SPACE_USED, 8) +
+	      FATTR4_LEN(w1, FATTR4_TIME_ACCESS, 12) +
+	      FATTR4_LEN(w1, FATTR4_TIME_METADATA, 12) +
+	      FATTR4_LEN(w1, FATTR4_TIME_MODIFY, 12) +
+	      FATTR4_LEN(w1, FATTR4_MOUNTED_ON_FILEID, 8);
+	if (len != 0) {
+		p = XDR_INLINE(xdr, len);
+		if (p == NULL)
+			return false;
+		if (FATTR4_HAS(w1, FATTR4_RAWDEV)) {
+			IXDR_PUT_U_INT32(p, attrs->rawdev.major);
+			IXDR_PUT_U_INT32(p, attrs->rawdev.minor);
+		}
+		if (FATTR4_HAS(w1, FATTR4_SPACE_USED))
+			p = fattr4_put_u64(p, attrs->spaceused);
+		if (FATTR4_HAS(w1, FATTR4_TIME_ACCESS))
+			p = fattr4_put_time(p, &attrs->atime);
+		if (FATTR4_HAS(w1, FATTR4_TIME_METADATA))
+			p = fattr4_put_time(p, &attrs->ctime);
+		if (FATTR4_HAS(w1, FATTR4_TIME_MODIFY))
+			p = fattr4_put_time(p, &attrs->mtime);
+		if (FATTR4_HAS(w1, FATTR4_MOUNTED_ON_FILEID))
+			p = fattr4_put_u64(p, args->mounted_on_fileid);
+	}
+
+	return true;
+}
+
+static bool fattr4_fast_getattr(XDR *xdr, struct xdr_attrs_args *args)
+{
+	return fattr4_fast_encode(xdr, args, FATTR4_FAST_GETATTR0,
+				  FATTR4_FAST_GETATTR1);
+}
+
+static bool fattr4_fast_readdirplus(XDR *xdr, struct xdr_attrs_args *args)
+{
+	return fattr4_fast_encode(xdr, args, FATTR4_FAST_READDIRPLUS0,
+				  FATTR4_FAST_GETATTR1);
+}
+
+static bool fattr4_fast_readdir(XDR *xdr, struct xdr_attrs_args *args)
+{
+	return fattr4_fast_encode(xdr, args, FATTR4_FAST_READDIR0,
+				  FATTR4_FAST_READDIR1);
+}
+
+static bool fattr4_fast_cache(XDR *xdr, struct xdr_attrs_args *args)
+{
+	return fattr4_fast_encode(xdr, args, FATTR4_FAST_CACHE0,
+				  FATTR4_FAST_CACHE1);
+}
+
+static const struct fattr4_fast {
+	uint32_t map[2];	/*< Words 0 and 1, word 2 is empty */
+	bool (*encode)(XDR *xdr, struct xdr_attrs_args *args);
+	const char *name;
+} fattr4_fast_tab[] = {
+	{ {FATTR4_FAST_READDIRPLUS0, FATTR4_FAST_GETATTR1},
+	  fattr4_fast_readdirplus, "readdirplus" },
+	{ {FATTR4_FAST_GETATTR0, FATTR4_FAST_GETATTR1},
+	  fattr4_fast_getattr, "getattr" },
+	{ {FATTR4_FAST_READDIR0, FATTR4_FAST_READDIR1},
+	  fattr4_fast_readdir, "readdir" },
+	{ {FATTR4_FAST_CACHE0, FATTR4_FAST_CACHE1},
+	  fattr4_fast_cache, "cache" },
+};
+
+/**
+ * @brief Find the precompiled encoder for a bitmap
+ *
+ * @param[in] Bitmap Bitmap of attributes being requested
+ *
+ * @return The encoder or NULL if the bitmap has none.
+ */
+
+static inline const struct fattr4_fast *fattr4_fast_lookup(
+						struct bitmap4 *Bitmap)
+{
+	int i;
+
+	if (!nfs_param.nfsv4_param.fast_fattr_encode ||
+	    Bitmap->bitmap4_len < 2 ||
+	    (Bitmap->bitmap4_len > 2 && Bitmap->map[2] != 0))
+		return NULL;
+
+	for (i = 0;
+	     i < sizeof(fattr4_fast_tab) / sizeof(fattr4_fast_tab[0]);
+	     i++) {
+		if (Bitmap->map[0] == fattr4_fast_tab[i].map[0] &&
+		    Bitmap->map[1] == fattr4_fast_tab[i].map[1])
+			return &fattr4_fast_tab[i];
+	}
+
+	return NULL;
+}
+
 /**
  * @brief Converts FSAL Attributes to NFSv4 Fattr buffer.
  *
@@ -3352,6 +3594,7 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 	fsal_dynamicfsinfo_t dynamicinfo;
 	XDR attr_body;
 	fattr_xdr_result xdr_res;
+	const struct fattr4_fast *fast;
 
 	/* basic init */
 	memset(Fattr, 0, sizeof(*Fattr));
@@ -3376,6 +3619,20 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 	if (args->dynamicinfo == NULL)
 		args->dynamicinfo = &dynamicinfo;
 
+	fast = fattr4_fast_lookup(Bitmap);
+	if (fast != NULL) {
+		if (!fast->encode(&attr_body, args)) {
+			LogFullDebug(COMPONENT_NFS_V4,
+				     "Encode FAILED for %s attrs", fast->name);
+			goto err;
+		}
+		Fattr->attrmask.bitmap4_len = 2;
+		Fattr->attrmask.map[0] = fast->map[0];
+		Fattr->attrmask.map[1] = fast->map[1];
+		LogFullDebug(COMPONENT_NFS_V4, "Encoded %s attrs", fast->name);
+		goto out;
+	}
+
 	for (attribute_to_set = next_attr_from_bitmap(Bitmap, -1);
 	     attribute_to_set != -1;
 	     attribute_to_set =
@@ -3409,6 +3666,8 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 		}
 		/* mark the attribute in the bitmap should be new bitmap btw */
 	}
+
+ out:
 	LastOffset = xdr_getpos(&attr_body);	/* dumb but for now */
 	xdr_destroy(&attr_body);
 
@@ -3810,6 +4069,32 @@ void nfs4_bitmap4_Remove_Unsupported(struct bitmap4 *bitmap)
 	}
 }
 
+/**
+ * @brief Get the write verifier for WRITE and COMMIT
+ *
+ * Gathered writes are lost when the server restarts, but an FSAL with
+ * its own verifier (GPFS) keeps it across that.  With Write_Gather
+ * set, the server verifier, which changes on every start, is mixed
+ * into the FSAL one.
+ *
+ * @param[out] verf_desc Buffer for the verifier
+ */
+
+void nfs4_write_verifier(struct gsh_buffdesc *verf_desc)
+{
+	unsigned char *verf = verf_desc->addr;
+	unsigned int i;
+
+	op_ctx->fsal_export->exp_ops.get_write_verifier(verf_desc);
+
+	if (!cache_param.write_gather.enabled ||
+	    memcmp(verf, NFS4_write_verifier, sizeof(verifier4)) == 0)
+		return;
+
+	for (i = 0; i < sizeof(verifier4); i++)
+		verf[i] ^= NFS4_write_verifier[i];
+}
+
 /**
  *
  * nfs4_Fattr_Supported: Checks if an attribute is supported.
@@ -36,7 +36,7 @@
  *   IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
  *   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
- * This code was derived from RFCTBD10.
+ * This code was derived from RFC 8435.
  * Please reproduce this note if possible.
  */
 
@@ -78,9 +78,18 @@ struct ff_mirror4 {
     ff_data_server4         ffm_data_servers<>;
 };
 
+typedef uint32_t            ff_flags4;
+
+const FF_FLAGS_NO_LAYOUTCOMMIT   = 0x00000001;
+const FF_FLAGS_NO_IO_THRU_MDS    = 0x00000002;
+const FF_FLAGS_NO_READ_IO        = 0x00000004;
+const FF_FLAGS_WRITE_ONE_MIRROR  = 0x00000008;
+
 struct ff_layout4 {
     length4                 ffl_stripe_unit;
     ff_mirror4              ffl_mirrors<>;
+    ff_flags4               ffl_flags;
+    uint32_t                ffl_stats_collect_hint;
 };
 
 struct ff_ioerr4 {
@@ -91,10 +100,13 @@ struct ff_ioerr4 {
 };
 
 struct ff_io_latency4 {
-        nfstime4       ffil_min;
-        nfstime4       ffil_max;
-        nfstime4       ffil_avg;
-        uint32_t       ffil_count;
+        uint64_t       ffil_ops_requested;
+        uint64_t       ffil_bytes_requested;
+        uint64_t       ffil_ops_completed;
+        uint64_t       ffil_bytes_completed;
+        uint64_t       ffil_bytes_not_delivered;
+        nfstime4       ffil_total_busy_time;
+        nfstime4       ffil_aggregate_completion_time;
 };
 
 struct ff_layoutupdate4 {
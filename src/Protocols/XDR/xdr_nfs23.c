@@ -487,16 +487,78 @@ nfstime3 *objp;
 	return (true);
 }
 
+/*
+ * The hot NFSv3 types are also coded inline, rpcgen -i style: the
+ * fixed size part of the structure is reserved and checked once with
+ * XDR_INLINE.  When the stream cannot give that many contiguous bytes
+ * the generated per field code below is used.
+ */
+
+#define FATTR3_UNITS 21
+
+static inline int32_t *fattr3_put(int32_t *buf, fattr3 *objp)
+{
+	IXDR_PUT_ENUM(buf, objp->type);
+	IXDR_PUT_U_INT32(buf, objp->mode);
+	IXDR_PUT_U_INT32(buf, objp->nlink);
+	IXDR_PUT_U_INT32(buf, objp->uid);
+	IXDR_PUT_U_INT32(buf, objp->gid);
+	IXDR_PUT_U_INT64(buf, objp->size);
+	IXDR_PUT_U_INT64(buf, objp->used);
+	IXDR_PUT_U_INT32(buf, objp->rdev.specdata1);
+	IXDR_PUT_U_INT32(buf, objp->rdev.specdata2);
+	IXDR_PUT_U_INT64(buf, objp->fsid);
+	IXDR_PUT_U_INT64(buf, objp->fileid);
+	IXDR_PUT_U_INT32(buf, objp->atime.tv_sec);
+	IXDR_PUT_U_INT32(buf, objp->atime.tv_nsec);
+	IXDR_PUT_U_INT32(buf, objp->mtime.tv_sec);
+	IXDR_PUT_U_INT32(buf, objp->mtime.tv_nsec);
+	IXDR_PUT_U_INT32(buf, objp->ctime.tv_sec);
+	IXDR_PUT_U_INT32(buf, objp->ctime.tv_nsec);
+	return buf;
+}
+
+static inline int32_t *fattr3_get(int32_t *buf, fattr3 *objp)
+{
+	objp->type = IXDR_GET_ENUM(buf, ftype3);
+	objp->mode = IXDR_GET_U_INT32(buf);
+	objp->nlink = IXDR_GET_U_INT32(buf);
+	objp->uid = IXDR_GET_U_INT32(buf);
+	objp->gid = IXDR_GET_U_INT32(buf);
+	objp->size = IXDR_GET_U_INT64(buf);
+	objp->used = IXDR_GET_U_INT64(buf);
+	objp->rdev.specdata1 = IXDR_GET_U_INT32(buf);
+	objp->rdev.specdata2 = IXDR_GET_U_INT32(buf);
+	objp->fsid = IXDR_GET_U_INT64(buf);
+	objp->fileid = IXDR_GET_U_INT64(buf);
+	objp->atime.tv_sec = IXDR_GET_U_INT32(buf);
+	objp->atime.tv_nsec = IXDR_GET_U_INT32(buf);
+	objp->mtime.tv_sec = IXDR_GET_U_INT32(buf);
+	objp->mtime.tv_nsec = IXDR_GET_U_INT32(buf);
+	objp->ctime.tv_sec = IXDR_GET_U_INT32(buf);
+	objp->ctime.tv_nsec = IXDR_GET_U_INT32(buf);
+	return buf;
+}
+
 bool xdr_fattr3(xdrs, objp)
 register XDR *xdrs;
 fattr3 *objp;
 {
-
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	register int32_t *buf;
+
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = XDR_INLINE(xdrs, FATTR3_UNITS * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			fattr3_put(buf, objp);
+			return (true);
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = XDR_INLINE(xdrs, FATTR3_UNITS * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			fattr3_get(buf, objp);
+			return (true);
+		}
+	}
 
 	if (!xdr_ftype3(xdrs, &objp->type))
 		return (false);
@@ -531,12 +593,17 @@ bool xdr_post_op_attr(xdrs, objp)
 register XDR *xdrs;
 post_op_attr *objp;
 {
+	register int32_t *buf;
 
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	if (xdrs->x_op == XDR_ENCODE && objp->attributes_follow == TRUE) {
+		buf = XDR_INLINE(xdrs,
+				 (1 + FATTR3_UNITS) * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_BOOL(buf, XDR_TRUE);
+			fattr3_put(buf, &objp->post_op_attr_u.attributes);
+			return (true);
+		}
+	}
 
 	if (!xdr_bool(xdrs, &objp->attributes_follow))
 		return (false);
@@ -1238,21 +1305,33 @@ bool xdr_READ3args(xdrs, objp)
 register XDR *xdrs;
 READ3args *objp;
 {
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	register int32_t *buf;
 	struct nfs_request_lookahead *lkhd =
 	    xdrs->x_public ? (struct nfs_request_lookahead *)xdrs->
 	    x_public : &dummy_lookahead;
 
 	if (!xdr_nfs_fh3(xdrs, &objp->file))
 		return (false);
-	if (!xdr_offset3(xdrs, &objp->offset))
-		return (false);
-	if (!xdr_count3(xdrs, &objp->count))
-		return (false);
+	buf = NULL;
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = XDR_INLINE(xdrs, 3 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_U_INT64(buf, objp->offset);
+			IXDR_PUT_U_INT32(buf, objp->count);
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = XDR_INLINE(xdrs, 3 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->offset = IXDR_GET_U_INT64(buf);
+			objp->count = IXDR_GET_U_INT32(buf);
+		}
+	}
+	if (buf == NULL) {
+		if (!xdr_offset3(xdrs, &objp->offset))
+			return (false);
+		if (!xdr_count3(xdrs, &objp->count))
+			return (false);
+	}
 	lkhd->flags = NFS_LOOKAHEAD_READ;
 	(lkhd->read)++;
 	return (true);
@@ -1262,19 +1341,30 @@ bool xdr_READ3resok(xdrs, objp)
 register XDR *xdrs;
 READ3resok *objp;
 {
-
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	register int32_t *buf;
 
 	if (!xdr_post_op_attr(xdrs, &objp->file_attributes))
 		return (false);
-	if (!xdr_count3(xdrs, &objp->count))
-		return (false);
-	if (!xdr_bool(xdrs, &objp->eof))
-		return (false);
+	buf = NULL;
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = XDR_INLINE(xdrs, 2 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_U_INT32(buf, objp->count);
+			IXDR_PUT_BOOL(buf, objp->eof ? XDR_TRUE : XDR_FALSE);
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = XDR_INLINE(xdrs, 2 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->count = IXDR_GET_U_INT32(buf);
+			objp->eof = IXDR_GET_BOOL(buf);
+		}
+	}
+	if (buf == NULL) {
+		if (!xdr_count3(xdrs, &objp->count))
+			return (false);
+		if (!xdr_bool(xdrs, &objp->eof))
+			return (false);
+	}
 	if (!xdr_bytes
 	    (xdrs, (char **)&objp->data.data_val,
 	     &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
@@ -1344,23 +1434,37 @@ bool xdr_WRITE3args(xdrs, objp)
 register XDR *xdrs;
 WRITE3args *objp;
 {
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	register int32_t *buf;
 	struct nfs_request_lookahead *lkhd =
 	    xdrs->x_public ? (struct nfs_request_lookahead *)xdrs->
 	    x_public : &dummy_lookahead;
 
 	if (!xdr_nfs_fh3(xdrs, &objp->file))
 		return (false);
-	if (!xdr_offset3(xdrs, &objp->offset))
-		return (false);
-	if (!xdr_count3(xdrs, &objp->count))
-		return (false);
-	if (!xdr_stable_how(xdrs, &objp->stable))
-		return (false);
+	buf = NULL;
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_U_INT64(buf, objp->offset);
+			IXDR_PUT_U_INT32(buf, objp->count);
+			IXDR_PUT_ENUM(buf, objp->stable);
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->offset = IXDR_GET_U_INT64(buf);
+			objp->count = IXDR_GET_U_INT32(buf);
+			objp->stable = IXDR_GET_ENUM(buf, stable_how);
+		}
+	}
+	if (buf == NULL) {
+		if (!xdr_offset3(xdrs, &objp->offset))
+			return (false);
+		if (!xdr_count3(xdrs, &objp->count))
+			return (false);
+		if (!xdr_stable_how(xdrs, &objp->stable))
+			return (false);
+	}
 	if (!xdr_bytes
 	    (xdrs, (char **)&objp->data.data_val,
 	     &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
@@ -1374,15 +1478,27 @@ bool xdr_WRITE3resok(xdrs, objp)
 register XDR *xdrs;
 WRITE3resok *objp;
 {
-
-#if defined(_LP64) || defined(_KERNEL)
-	register int __attribute__ ((__unused__)) * buf;
-#else
-	register long __attribute__ ((__unused__)) * buf;
-#endif
+	register int32_t *buf;
 
 	if (!xdr_wcc_data(xdrs, &objp->file_wcc))
 		return (false);
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_U_INT32(buf, objp->count);
+			IXDR_PUT_ENUM(buf, objp->committed);
+			memcpy(buf, objp->verf, NFS3_WRITEVERFSIZE);
+			return (true);
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->count = IXDR_GET_U_INT32(buf);
+			objp->committed = IXDR_GET_ENUM(buf, stable_how);
+			memcpy(objp->verf, buf, NFS3_WRITEVERFSIZE);
+			return (true);
+		}
+	}
 	if (!xdr_count3(xdrs, &objp->count))
 		return (false);
 	if (!xdr_stable_how(xdrs, &objp->committed))
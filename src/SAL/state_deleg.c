@@ -130,6 +130,11 @@ void init_new_deleg_state(union state_data *deleg_state,
 
 	clfile_entry->cfd_rs_time = 0;
 	clfile_entry->cfd_r_time = 0;
+	clfile_entry->cfd_r_start.tv_sec = 0;
+	clfile_entry->cfd_r_start.tv_nsec = 0;
+
+	memset(&deleg_state->deleg.sd_revoke_timer, 0,
+	       sizeof(deleg_state->deleg.sd_revoke_timer));
 }
 
 /**
@@ -300,10 +305,21 @@ void deleg_heuristics_recall(cache_entry_t *entry,
 	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
 	/* Update delegation stats for file. */
 	struct file_deleg_stats *statistics = &entry->object.file.fdeleg_stats;
+	struct cf_deleg_stats *clfile_stats =
+		&deleg->state_data.deleg.sd_clfile_stats;
+	struct timespec ts;
 
 	statistics->fds_curr_delegations--;
 	statistics->fds_recall_count++;
 
+	/* Returned after we asked for it back */
+	if (clfile_stats->cfd_r_time != 0) {
+		now(&ts);
+		deleg_policy_recalled(statistics,
+				      timespec_diff(&clfile_stats->cfd_r_start,
+						    &ts));
+	}
+
 	/* Update delegation stats for client. */
 	dec_grants(client->gsh_client);
 	client->curr_deleg_grants--;
@@ -344,6 +360,17 @@ bool init_deleg_heuristics(cache_entry_t *entry)
 	statistics->fds_avg_hold = 0;
 	statistics->fds_num_opens = 0;
 	statistics->fds_first_open = 0;
+	statistics->fds_last_client = 0;
+	statistics->fds_run = 0;
+	statistics->fds_rrun = 0;
+	statistics->fds_avg_run = 0;
+	statistics->fds_avg_rrun = 0;
+	statistics->fds_switches = 0;
+	statistics->fds_write_opens = 0;
+	statistics->fds_avg_recall = 0;
+	statistics->fds_avg_gap = 0;
+	statistics->fds_seen_grants = 0;
+	statistics->fds_last_open = 0;
 
 	return true;
 }
@@ -427,6 +454,17 @@ bool should_we_grant_deleg(cache_entry_t *entry, nfs_client_id_t *client,
 	if (client->num_revokes > 2) /* more than 2 revokes */
 		return false;
 
+	/* Check if the file's history says it is worth it */
+	if (nfs_param.nfsv4_param.adaptive_delegations &&
+	    !deleg_policy_grant(file_stats,
+				args->share_access & OPEN4_SHARE_ACCESS_WRITE
+					? OPEN_DELEGATE_WRITE
+					: OPEN_DELEGATE_READ)) {
+		LogFullDebug(COMPONENT_STATE,
+			     "Access history does not favour a delegation");
+		return false;
+	}
+
 	LogDebug(COMPONENT_STATE, "Let's delegate!!");
 	return true;
 }
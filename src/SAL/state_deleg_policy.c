@@ -0,0 +1,271 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup SAL
+ * @{
+ */
+
+/**
+ * @file state_deleg_policy.c
+ * @brief Adaptive delegation grant policy
+ *
+ * Every OPEN of a file is recorded in its file_deleg_stats.  A run is
+ * a sequence of opens that a delegation would have served: for a
+ * write delegation the opens by one client, for a read delegation
+ * the opens until the next write open.  The decayed mean
+ * run length is how many opens a delegation granted now can be
+ * expected to serve, all but the first of them without reaching the
+ * server; of a read run, only the share of its client, which the
+ * mean write run gives.  A file on which no run has ever ended has nothing to
+ * recall; otherwise each run, so each grant, ends in a recall,
+ * costed by the file's measured recall latency, or the server's, or
+ * Deleg_Recall_Cost.  A delegation is granted when the opens it
+ * saves, at Deleg_Open_Cost each, are worth at least the recall.
+ *
+ * Opens served under a delegation are not seen here.  They are
+ * estimated from how long the delegation was out and how often the
+ * file is opened when it has none.
+ *
+ * Callers hold the entry's state_lock for write.  Nothing here calls
+ * out of this file, so test_deleg_policy can replay traces against
+ * it.
+ */
+
+#include "config.h"
+#include <time.h>
+#include "abstract_atomic.h"
+#include "gsh_config.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+
+/** Fixed point of the mean run lengths */
+#define DELEG_RUN_SHIFT 4
+#define DELEG_RUN_ONE (1 << DELEG_RUN_SHIFT)
+
+/** Most opens a delegated run is credited with */
+#define DELEG_UNSEEN_MAX 65536
+
+struct deleg_policy_stats deleg_policy_st;
+
+/**
+ * @brief Decay a mean by a quarter towards a new sample
+ */
+
+static inline uint32_t deleg_decay(uint32_t avg, uint32_t sample)
+{
+	return avg - avg / 4 + sample / 4;
+}
+
+/**
+ * @brief End a run, folding it into the mean run length
+ */
+
+static void deleg_run_end(uint32_t *avg, uint32_t *run, bool first)
+{
+	uint32_t sample = *run << DELEG_RUN_SHIFT;
+
+	*avg = first ? sample : deleg_decay(*avg, sample);
+	*run = 0;
+}
+
+/**
+ * @brief Record an OPEN of a file
+ *
+ * If a delegation was granted at the previous open, the opens its
+ * holder made since then did not reach us; the run is credited with
+ * as many as the file's usual gap between opens fits in the time.
+ *
+ * @param[in,out] fds    Delegation stats of the file
+ * @param[in]     client Client opening the file
+ * @param[in]     write  Whether the open asks for write access
+ * @param[in]     when   Time of the open
+ */
+
+void deleg_policy_open(struct file_deleg_stats *fds, clientid4 client,
+		       bool write, nsecs_elapsed_t when)
+{
+	uint64_t gap = 0, unseen = 0;
+
+	(void)atomic_inc_uint64_t(&deleg_policy_st.opens);
+
+	if (fds->fds_num_opens == 0) {
+		fds->fds_first_open = time(NULL);
+		goto record;
+	}
+
+	if (when > fds->fds_last_open)
+		gap = (when - fds->fds_last_open) / NS_PER_USEC;
+
+	if (fds->fds_delegation_count != fds->fds_seen_grants) {
+		/* This open is one of those the gap should hold */
+		if (fds->fds_avg_gap != 0)
+			unseen = gap / fds->fds_avg_gap;
+		if (unseen > 0)
+			unseen--;
+		if (unseen > DELEG_UNSEEN_MAX)
+			unseen = DELEG_UNSEEN_MAX;
+		fds->fds_run += unseen;
+		fds->fds_rrun += unseen;
+	} else {
+		if (gap > UINT32_MAX)
+			gap = UINT32_MAX;
+		if (gap == 0)
+			gap = 1;
+		fds->fds_avg_gap = fds->fds_avg_gap == 0 ? gap :
+			deleg_decay(fds->fds_avg_gap, gap);
+	}
+
+	if (client != fds->fds_last_client) {
+		deleg_run_end(&fds->fds_avg_run, &fds->fds_run,
+			      fds->fds_switches == 0);
+		fds->fds_switches++;
+	}
+
+	/* Even its own client's write open breaks a read delegation */
+	if (write) {
+		deleg_run_end(&fds->fds_avg_rrun, &fds->fds_rrun,
+			      fds->fds_write_opens == 0);
+		fds->fds_write_opens++;
+	}
+
+ record:
+	fds->fds_num_opens++;
+	fds->fds_last_client = client;
+	fds->fds_last_open = when;
+	fds->fds_seen_grants = fds->fds_delegation_count;
+	fds->fds_run++;
+	fds->fds_rrun++;
+}
+
+/**
+ * @brief Expected cost of recalling a delegation on a file
+ *
+ * @return Microseconds.
+ */
+
+static uint64_t deleg_recall_cost(const struct file_deleg_stats *fds)
+{
+	uint64_t recalls;
+
+	if (fds->fds_avg_recall != 0)
+		return fds->fds_avg_recall;
+
+	recalls = atomic_fetch_uint64_t(&deleg_policy_st.recalls);
+	if (recalls != 0)
+		return atomic_fetch_uint64_t(&deleg_policy_st.recall_usec) /
+			recalls;
+
+	return nfs_param.nfsv4_param.deleg_recall_cost;
+}
+
+/**
+ * @brief Decide whether a delegation is worth granting
+ *
+ * The file's last open must have been recorded with
+ * deleg_policy_open.
+ *
+ * @param[in] fds  Delegation stats of the file
+ * @param[in] type Delegation that would be granted
+ *
+ * @return true if the delegation should be granted.
+ */
+
+bool deleg_policy_grant(const struct file_deleg_stats *fds,
+			open_delegation_type4 type)
+{
+	uint32_t run, avg, switches;
+	uint64_t expected, saved, benefit, cost = 0;
+
+	if (type == OPEN_DELEGATE_WRITE) {
+		run = fds->fds_run;
+		avg = fds->fds_avg_run;
+		switches = fds->fds_switches;
+	} else {
+		run = fds->fds_rrun;
+		avg = fds->fds_avg_rrun;
+		switches = fds->fds_write_opens;
+	}
+
+	/* A run going on for longer than usual counts as it is */
+	expected = (uint64_t)run << DELEG_RUN_SHIFT;
+	if (avg > expected)
+		expected = avg;
+
+	saved = expected > DELEG_RUN_ONE ? expected - DELEG_RUN_ONE : 0;
+
+	/* Other readers' opens in a read run are not saved by this
+	   delegation, only the share that is its client's */
+	if (type != OPEN_DELEGATE_WRITE && fds->fds_switches != 0) {
+		avg = fds->fds_avg_run;
+		if (avg < fds->fds_run << DELEG_RUN_SHIFT)
+			avg = fds->fds_run << DELEG_RUN_SHIFT;
+		saved = avg > DELEG_RUN_ONE ?
+			saved * (avg - DELEG_RUN_ONE) / avg : 0;
+	}
+
+	benefit = (saved * nfs_param.nfsv4_param.deleg_open_cost) >>
+		  DELEG_RUN_SHIFT;
+
+	if (switches != 0)
+		cost = deleg_recall_cost(fds);
+
+	if (benefit < cost) {
+		(void)atomic_inc_uint64_t(&deleg_policy_st.declined);
+		return false;
+	}
+
+	(void)atomic_inc_uint64_t(&deleg_policy_st.granted);
+	(void)atomic_add_uint64_t(&deleg_policy_st.saved_opens,
+				  saved >> DELEG_RUN_SHIFT);
+	return true;
+}
+
+/**
+ * @brief Record how long a recalled delegation took to come back
+ *
+ * @param[in,out] fds     Delegation stats of the file
+ * @param[in]     latency From the first CB_RECALL to the return
+ */
+
+void deleg_policy_recalled(struct file_deleg_stats *fds,
+			   nsecs_elapsed_t latency)
+{
+	uint64_t usec = latency / NS_PER_USEC;
+	uint64_t max;
+
+	if (usec > UINT32_MAX)
+		usec = UINT32_MAX;
+	if (usec == 0)
+		usec = 1;
+
+	fds->fds_avg_recall = fds->fds_avg_recall == 0 ? usec :
+		deleg_decay(fds->fds_avg_recall, usec);
+
+	(void)atomic_inc_uint64_t(&deleg_policy_st.recalls);
+	(void)atomic_add_uint64_t(&deleg_policy_st.recall_usec, usec);
+
+	max = atomic_fetch_uint64_t(&deleg_policy_st.recall_usec_max);
+	if (usec > max)
+		atomic_store_uint64_t(&deleg_policy_st.recall_usec_max, usec);
+}
+
+/** @} */
@@ -56,9 +56,9 @@
 void
 cache_inode_avl_init(cache_entry_t *entry)
 {
-	avltree_init(&entry->object.dir.avl.t, avl_dirent_hk_cmpf,
+	avltree_init(&entry->object.dir->avl.t, avl_dirent_hk_cmpf,
 		     0 /* flags */);
-	avltree_init(&entry->object.dir.avl.c, avl_dirent_hk_cmpf,
+	avltree_init(&entry->object.dir->avl.c, avl_dirent_hk_cmpf,
 		     0 /* flags */);
 }
 
@@ -85,14 +85,14 @@ avltree_inline_lookup(
 void
 avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v)
 {
-	struct avltree *t = &entry->object.dir.avl.t;
+	struct avltree *t = &entry->object.dir->avl.t;
 	struct avltree_node *node;
 
 	assert(!(v->flags & DIR_ENTRY_FLAG_DELETED));
 
 	node = avltree_inline_lookup(&v->node_hk, t);
 	assert(node);
-	avltree_remove(&v->node_hk, &entry->object.dir.avl.t);
+	avltree_remove(&v->node_hk, &entry->object.dir->avl.t);
 
 #if EXTRA_CHECK_DELETED_WORKED
 	node = avltree_inline_lookup(&v->node_hk, c);
@@ -103,15 +103,15 @@ avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v)
 	cache_inode_key_delete(&v->ckey);
 
 	/* save cookie in deleted avl */
-	avltree_insert(&v->node_hk, &entry->object.dir.avl.c);
+	avltree_insert(&v->node_hk, &entry->object.dir->avl.c);
 }
 
 void
 avl_dirent_clear_deleted(cache_entry_t *entry,
 			 cache_inode_dir_entry_t *v)
 {
-	struct avltree *t = &entry->object.dir.avl.t;
-	struct avltree *c = &entry->object.dir.avl.c;
+	struct avltree *t = &entry->object.dir->avl.t;
+	struct avltree *c = &entry->object.dir->avl.c;
 	struct avltree_node *node;
 
 	node = avltree_inline_lookup(&v->node_hk, c);
@@ -132,8 +132,8 @@ cache_inode_avl_insert_impl(cache_entry_t *entry,
 {
 	int code = -1;
 	struct avltree_node *node;
-	struct avltree *t = &entry->object.dir.avl.t;
-	struct avltree *c = &entry->object.dir.avl.c;
+	struct avltree *t = &entry->object.dir->avl.t;
+	struct avltree *c = &entry->object.dir->avl.c;
 
 	/* first check for a previously-deleted entry */
 	node = avltree_inline_lookup(&v->node_hk, c);
@@ -181,13 +181,13 @@ cache_inode_avl_insert_impl(cache_entry_t *entry,
 	case 0:
 		/* success, note iterations */
 		v->hk.p = j + j2;
-		if (entry->object.dir.avl.collisions < v->hk.p)
-			entry->object.dir.avl.collisions = v->hk.p;
+		if (entry->object.dir->avl.collisions < v->hk.p)
+			entry->object.dir->avl.collisions = v->hk.p;
 
 		LogDebug(COMPONENT_CACHE_INODE,
 			 "inserted new dirent on entry=%p cookie=%" PRIu64
 			 " collisions %d", entry, v->hk.k,
-			 entry->object.dir.avl.collisions);
+			 entry->object.dir->avl.collisions);
 		break;
 	default:
 		/* already inserted, or, keep trying at current j, j2 */
@@ -292,8 +292,8 @@ cache_inode_avl_qp_insert(cache_entry_t *entry,
 cache_inode_dir_entry_t *
 cache_inode_avl_lookup_k(cache_entry_t *entry, uint64_t k, uint32_t flags)
 {
-	struct avltree *t = &entry->object.dir.avl.t;
-	struct avltree *c = &entry->object.dir.avl.c;
+	struct avltree *t = &entry->object.dir->avl.t;
+	struct avltree *c = &entry->object.dir->avl.c;
 	cache_inode_dir_entry_t dirent_key[1], *dirent = NULL;
 	struct avltree_node *node, *node2;
 
@@ -341,7 +341,7 @@ out:
 cache_inode_dir_entry_t *
 cache_inode_avl_qp_lookup_s(cache_entry_t *entry, const char *name, int maxj)
 {
-	struct avltree *t = &entry->object.dir.avl.t;
+	struct avltree *t = &entry->object.dir->avl.t;
 	struct avltree_node *node;
 	cache_inode_dir_entry_t *v2;
 #if AVL_HASH_MURMUR3
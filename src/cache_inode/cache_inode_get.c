@@ -186,57 +186,67 @@ void clean_mapping(cache_entry_t *entry)
 }
 
 /**
- *
- * @brief Gets an entry by using its fsdata as a key and caches it if needed.
- *
- * Gets an entry by using its fsdata as a key and caches it if needed.
+ * @brief Look up a cached entry by fsdata and the hash of its key
  *
  * If a cache entry is returned, its refcount is incremented by one.
  *
  * @param[in]  fsdata     File system data
+ * @param[in]  hk         Hash of fsdata->fh_desc
  * @param[out] entry      The entry
  *
- * @return CACHE_INODE_SUCCESS or errors.
+ * @return CACHE_INODE_SUCCESS, CACHE_INODE_NOT_FOUND if not cached,
+ *         or errors.
  */
-cache_inode_status_t
-cache_inode_get(cache_inode_fsal_data_t *fsdata,
-		cache_entry_t **entry)
+static cache_inode_status_t
+cache_inode_get_cached(cache_inode_fsal_data_t *fsdata, uint64_t hk,
+		       cache_entry_t **entry)
 {
-	fsal_status_t fsal_status = { 0, 0 };
-	struct fsal_export *exp_hdl = NULL;
-	struct fsal_obj_handle *new_hdl;
-	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 	cih_latch_t latch;
 	cache_inode_key_t key;
 
 	key.fsal = fsdata->export->fsal;
+	key.kv = fsdata->fh_desc;
+	key.hk = hk;
 
-	(void) cih_hash_key(&key, fsdata->export->fsal, &fsdata->fh_desc,
-			    CIH_HASH_KEY_PROTOTYPE);
-
-	(void)atomic_inc_uint64_t(&cache_stp->inode_req);
-	/* Do lookup */
 	*entry =
 	    cih_get_by_key_latched(&key, &latch,
 				  CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
 				  __func__, __LINE__);
-	if (*entry) {
-		/* take an extra reference within the critical section */
-		(void) cache_inode_lru_ref(*entry, LRU_REQ_INITIAL);
-		cih_latch_rele(&latch);
+	if (*entry == NULL)
+		return CACHE_INODE_NOT_FOUND;
 
-		if (!check_mapping(*entry, op_ctx->export)) {
-			/* Return error instead of entry */
-			cache_inode_put(*entry);
-			*entry = NULL;
-			return CACHE_INODE_MALLOC_ERROR;
-		}
-		(void)atomic_inc_uint64_t(&cache_stp->inode_hit);
+	/* take an extra reference within the critical section */
+	(void) cache_inode_lru_ref(*entry, LRU_REQ_INITIAL);
+	cih_latch_rele(&latch);
 
-		return CACHE_INODE_SUCCESS;
+	if (!check_mapping(*entry, op_ctx->export)) {
+		/* Return error instead of entry */
+		cache_inode_put(*entry);
+		*entry = NULL;
+		return CACHE_INODE_MALLOC_ERROR;
 	}
+	(void)atomic_inc_uint64_t(&cache_stp->inode_hit);
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Make an entry for fsdata after a cache miss
+ *
+ * @param[in]  fsdata     File system data
+ * @param[out] entry      The entry
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+static cache_inode_status_t
+cache_inode_get_new(cache_inode_fsal_data_t *fsdata,
+		    cache_entry_t **entry)
+{
+	fsal_status_t fsal_status = { 0, 0 };
+	struct fsal_export *exp_hdl = NULL;
+	struct fsal_obj_handle *new_hdl;
+	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
-	/* Cache miss, allocate a new entry */
 	exp_hdl = fsdata->export;
 	fsal_status =
 	    exp_hdl->exp_ops.create_handle(exp_hdl, &fsdata->fh_desc,
@@ -260,8 +270,82 @@ cache_inode_get(cache_inode_fsal_data_t *fsdata,
 	/* If we have an entry, we succeeded.  Don't propagate any
 	   ENTRY_EXISTS errors upward. */
 	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ *
+ * @brief Gets an entry by using its fsdata as a key and caches it if needed.
+ *
+ * Gets an entry by using its fsdata as a key and caches it if needed.
+ *
+ * If a cache entry is returned, its refcount is incremented by one.
+ *
+ * @param[in]  fsdata     File system data
+ * @param[out] entry      The entry
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+cache_inode_status_t
+cache_inode_get(cache_inode_fsal_data_t *fsdata,
+		cache_entry_t **entry)
+{
+	cache_inode_status_t status;
+
+	(void)atomic_inc_uint64_t(&cache_stp->inode_req);
+
+	status = cache_inode_get_cached(fsdata, cih_hash_fh(&fsdata->fh_desc),
+					entry);
+	if (status != CACHE_INODE_NOT_FOUND)
+		return status;
+
+	/* Cache miss, allocate a new entry */
+	return cache_inode_get_new(fsdata, entry);
 }				/* cache_inode_get */
 
+/**
+ * @brief Gets an entry by fsdata and the cache hint of its handle
+ *
+ * Like cache_inode_get, but the key is looked up under the hash
+ * carried in the handle (see FH_CACHE_HINT) rather than one computed
+ * from it.  As the key itself is compared, a wrong hint can only
+ * miss; the key is then hashed and looked up again.
+ *
+ * @param[in]  fsdata     File system data
+ * @param[in]  hint       Cache hint from the handle
+ * @param[out] entry      The entry
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+cache_inode_status_t
+cache_inode_get_hinted(cache_inode_fsal_data_t *fsdata, uint64_t hint,
+		       cache_entry_t **entry)
+{
+	cache_inode_status_t status;
+	uint64_t hk;
+
+	(void)atomic_inc_uint64_t(&cache_stp->inode_req);
+
+	status = cache_inode_get_cached(fsdata, hint, entry);
+	if (status != CACHE_INODE_NOT_FOUND) {
+		(void)atomic_inc_uint64_t(&cache_stp->fh_hint_hit);
+		return status;
+	}
+
+	(void)atomic_inc_uint64_t(&cache_stp->fh_hint_miss);
+
+	/* A good hint for an entry no longer cached needs no second
+	   look */
+	hk = cih_hash_fh(&fsdata->fh_desc);
+	if (hk != hint) {
+		(void)atomic_inc_uint64_t(&cache_stp->fh_hint_bad);
+		status = cache_inode_get_cached(fsdata, hk, entry);
+		if (status != CACHE_INODE_NOT_FOUND)
+			return status;
+	}
+
+	return cache_inode_get_new(fsdata, entry);
+}
+
 /**
  * @brief Get an initial reference to a cache entry by its key.
  *
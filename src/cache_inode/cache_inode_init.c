@@ -63,6 +63,14 @@ cache_inode_init(void)
 		status = CACHE_INODE_INVALID_ARGUMENT;
 	}
 
+	cache_inode_dir_pool =
+	    pool_init("Directory Pool", sizeof(struct cache_inode_dir),
+		      pool_basic_substrate, NULL, NULL, NULL);
+	if (!(cache_inode_dir_pool)) {
+		LogCrit(COMPONENT_CACHE_INODE, "Can't init Directory Pool");
+		status = CACHE_INODE_INVALID_ARGUMENT;
+	}
+
 	cih_pkginit();
 
 	return status;
@@ -79,8 +87,9 @@ cache_inode_destroyer(void)
 	/* Destroy the cache inode AVL tree */
 	cih_pkgdestroy();
 
-	/* Destroy the cache inode entry pool */
+	/* Destroy the cache inode entry and directory pools */
 	pool_destroy(cache_inode_entry_pool);
+	pool_destroy(cache_inode_dir_pool);
 }
 
 /** @} */
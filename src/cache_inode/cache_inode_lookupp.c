@@ -107,7 +107,7 @@ cache_inode_lookupp_impl(cache_entry_t *entry,
 
 	/* Try to lookup by key (fh) */
 	*parent =
-	    cache_inode_get_keyed(&entry->object.dir.parent,
+	    cache_inode_get_keyed(&entry->object.dir->parent,
 				  CIG_KEYED_FLAG_NONE, &status);
 	if (!(*parent)) {
 		/* If we didn't find it, drop the read lock, get a write
@@ -142,7 +142,7 @@ cache_inode_lookupp_impl(cache_entry_t *entry,
 			return status;
 
 		/* Dup keys */
-		cache_inode_key_dup(&entry->object.dir.parent,
+		cache_inode_key_dup(&entry->object.dir->parent,
 				    &((*parent)->fh_hk.key));
 	}
 
@@ -413,8 +413,10 @@ cache_inode_lru_clean(cache_entry_t *entry)
 		}
 	}
 
-	if (entry->type == DIRECTORY)
-		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+	/* Release dirents and the directory state itself */
+	cache_inode_release_dir_state(entry);
+	cache_inode_wgather_release(entry);
+	cache_inode_readahead_release(entry);
 
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
@@ -1564,4 +1566,47 @@ lru_wake_thread(void)
 	fridgethr_wake(lru_fridge);
 }
 
+/**
+ * @brief Visit the most recently used entries of a lane
+ *
+ * Up to max entries of the lane are visited from the MRU end of L1,
+ * then, if L1 runs out, from the MRU end of L2, where the LRU thread
+ * demotes entries that are cached but idle.  The lane's lock is held,
+ * so cb must not block, allocate or take anything but a trylock on
+ * the entry's own locks.
+ *
+ * @param[in] lane  The lane, below LRU_N_Q_LANES
+ * @param[in] max   Entries visited
+ * @param[in] cb    Called with each entry and its place in the lane,
+ *                  0 for the most recently used; false stops
+ * @param[in] state Passed to cb
+ */
+
+void cache_inode_lru_foreach_hot(uint32_t lane, uint32_t max,
+				 bool (*cb)(cache_entry_t *entry,
+					    uint32_t rank, void *state),
+				 void *state)
+{
+	struct lru_q_lane *qlane = &LRU[lane];
+	struct lru_q *q[2] = { &qlane->L1, &qlane->L2 };
+	struct glist_head *glist;
+	cache_entry_t *entry;
+	uint32_t rank = 0;
+	int i;
+	bool stop = false;
+
+	QLOCK(qlane);
+	for (i = 0; i < 2 && !stop; i++) {
+		for (glist = q[i]->q.prev;
+		     glist != &q[i]->q && rank < max && !stop;
+		     glist = glist->prev) {
+			entry = container_of(glist, cache_entry_t, lru.q);
+			/* Skip entries on their way out */
+			if (entry->fh_hk.inavl)
+				stop = !cb(entry, rank++, state);
+		}
+	}
+	QUNLOCK(qlane);
+}
+
 /** @} */
@@ -54,6 +54,7 @@
 #include <stdbool.h>
 
 pool_t *cache_inode_entry_pool;
+pool_t *cache_inode_dir_pool;
 
 const char *
 cache_inode_err_str(cache_inode_status_t err)
@@ -294,6 +295,17 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 	glist_init(&nentry->export_list);
 	glist_init(&nentry->layoutrecall_list);
 
+	if (nentry->type == DIRECTORY) {
+		nentry->object.dir = pool_alloc(cache_inode_dir_pool, NULL);
+		if (nentry->object.dir == NULL) {
+			LogCrit(COMPONENT_CACHE_INODE,
+				"can't allocate directory state");
+			status = CACHE_INODE_MALLOC_ERROR;
+			goto out;
+		}
+		(void)atomic_inc_uint64_t(&cache_stp->inode_dirs);
+	}
+
 	/* See if someone raced us. */
 	oentry =
 	    cih_get_by_key_latched(&key, &latch, CIH_GET_WLOCK, __func__,
@@ -342,6 +354,8 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		memset(&nentry->object.file.share_state, 0,
 		       sizeof(cache_inode_share_t));
 		nentry->object.file.write_delegated = false;
+		nentry->object.file.wgather = NULL;
+		nentry->object.file.readahead = NULL;
 
 		/* Init statistics used for intelligently granting delegations*/
 		init_deleg_heuristics(nentry);
@@ -364,9 +378,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 						   CACHE_INODE_DIR_POPULATED);
 		}
 
-		nentry->object.dir.avl.collisions = 0;
-		nentry->object.dir.nbactive = 0;
-		glist_init(&nentry->object.dir.export_roots);
+		nentry->object.dir->avl.collisions = 0;
+		nentry->object.dir->nbactive = 0;
+		glist_init(&nentry->object.dir->export_roots);
 		/* init avl tree */
 		cache_inode_avl_init(nentry);
 		break;
@@ -461,6 +475,8 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		if (has_hashkey)
 			cache_inode_key_delete(&nentry->fh_hk.key);
 
+		cache_inode_release_dir_state(nentry);
+
 		/* Release the new entry we acquired. */
 		cache_inode_lru_putback(nentry, LRU_FLAG_NONE);
 	}
@@ -742,7 +758,7 @@ cache_inode_print_dir(cache_entry_t *entry)
 		return;
 	}
 
-	dirent_node = avltree_first(&entry->object.dir.avl.t);
+	dirent_node = avltree_first(&entry->object.dir->avl.t);
 	do {
 		dirent =
 		    avltree_container_of(dirent_node, cache_inode_dir_entry_t,
@@ -781,11 +797,11 @@ cache_inode_release_dirents(cache_entry_t *entry,
 
 	switch (which) {
 	case CACHE_INODE_AVL_NAMES:
-		tree = &entry->object.dir.avl.t;
+		tree = &entry->object.dir->avl.t;
 		break;
 
 	case CACHE_INODE_AVL_COOKIES:
-		tree = &entry->object.dir.avl.c;
+		tree = &entry->object.dir->avl.c;
 		break;
 
 	case CACHE_INODE_AVL_BOTH:
@@ -815,14 +831,43 @@ cache_inode_release_dirents(cache_entry_t *entry,
 			dirent_node = next_dirent_node;
 		}
 
-		if (tree == &entry->object.dir.avl.t) {
-			entry->object.dir.nbactive = 0;
+		if (tree == &entry->object.dir->avl.t) {
+			entry->object.dir->nbactive = 0;
 			atomic_clear_uint32_t_bits(&entry->flags,
 						   CACHE_INODE_DIR_POPULATED);
 		}
 	}
 }
 
+/**
+ * @brief Release the directory state of an entry
+ *
+ * Frees any cached dirents and returns the directory state to its
+ * pool.  Does nothing for entries that are not directories or whose
+ * directory state was never allocated.
+ *
+ * @param[in] entry Entry being cleaned or discarded
+ */
+void
+cache_inode_release_dir_state(cache_entry_t *entry)
+{
+	struct cache_inode_dir *dir;
+
+	if (entry->type != DIRECTORY || entry->object.dir == NULL)
+		return;
+
+	cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+
+	dir = entry->object.dir;
+	entry->object.dir = NULL;
+
+	if (dir->parent.kv.addr)
+		cache_inode_key_delete(&dir->parent);
+
+	pool_free(cache_inode_dir_pool, dir);
+	(void)atomic_dec_uint64_t(&cache_stp->inode_dirs);
+}
+
 /**
  * @brief Lock attributes and check they are trustworthy
  *
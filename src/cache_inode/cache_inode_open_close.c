@@ -172,6 +172,8 @@ cache_inode_open(cache_entry_t *entry,
 	 * read/write */
 	if ((current_flags != FSAL_O_RDWR) && (current_flags != FSAL_O_CLOSED)
 	    && (current_flags != openflags)) {
+		(void)cache_inode_wgather_flush_range(entry, 0, 0);
+
 		/* If the FSAL has reopen method, we just use it instead
 		 * of closing and opening the file again. This avoids
 		 * losing any lock state due to closing the file!
@@ -286,6 +288,12 @@ cache_inode_close(cache_entry_t *entry, uint32_t flags)
 		goto unlock;
 	}
 
+	/* CLOSE flushes gathered writes even if the file stays open */
+	if ((flags & CACHE_INODE_FLAG_REALLYCLOSE)
+	    || !cache_inode_lru_caching_fds()
+	    || (entry->obj_handle->attrs->numlinks == 0))
+		(void)cache_inode_wgather_flush_range(entry, 0, 0);
+
 	/* If file is pinned, do not close it.  This should
 	   be refined.  (A non return_on_close layout should not prevent
 	   the file from closing.) */
@@ -96,6 +96,10 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 	bool attributes_locked = false;
 	/* TRUE if we opened a previously closed FD */
 	bool opened = false;
+	/* True if the write was gathered rather than passed down */
+	bool gathered = false;
+	/* True if the read was served from read-ahead */
+	bool cached = false;
 
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
@@ -157,8 +161,22 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		loflags = obj_hdl->obj_ops.status(obj_hdl);
 	}
 
+	if (io_direction == CACHE_INODE_WRITE && !*sync)
+		gathered = cache_inode_wgather_write(entry, offset, io_size,
+						     buffer, bytes_moved);
+
+	/* Gathered writes under this I/O must reach the FSAL first */
+	if (!gathered)
+		(void)cache_inode_wgather_flush_range(entry, offset, io_size);
+
+	if (io_direction == CACHE_INODE_READ)
+		cached = cache_inode_readahead_read(entry, offset, io_size,
+						    buffer, bytes_moved, eof);
+
 	/* Call FSAL_read or FSAL_write */
-	if (io_direction == CACHE_INODE_READ) {
+	if (gathered || cached) {
+		fsal_status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	} else if (io_direction == CACHE_INODE_READ) {
 		fsal_status =
 		    obj_hdl->obj_ops.read(obj_hdl, offset, io_size,
 				       buffer, bytes_moved, eof);
@@ -193,6 +211,11 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		}
 	}
 
+	/* Whatever was read ahead here is stale now */
+	if (io_direction == CACHE_INODE_WRITE ||
+	    io_direction == CACHE_INODE_WRITE_PLUS)
+		cache_inode_readahead_invalidate(entry, offset, io_size);
+
 	LogFullDebug(COMPONENT_FSAL,
 		     "cache_inode_rdwr: FSAL IO operation returned %d, asked_size=%zu, effective_size=%zu",
 		     fsal_status.major, io_size, *bytes_moved);
@@ -268,8 +291,17 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 	attributes_locked = true;
-	if (io_direction == CACHE_INODE_WRITE ||
-	    io_direction == CACHE_INODE_WRITE_PLUS) {
+	if (gathered) {
+		/* The FSAL has not seen it, so it cannot tell */
+		cache_inode_wgather_fixup_attrs(entry);
+		cache_inode_set_time_current(&obj_hdl->attrs->mtime);
+		obj_hdl->attrs->ctime = obj_hdl->attrs->mtime;
+		obj_hdl->attrs->chgtime = obj_hdl->attrs->mtime;
+		obj_hdl->attrs->change =
+		    timespec_to_nsecs(&obj_hdl->attrs->chgtime);
+		entry->change_time = obj_hdl->attrs->change;
+	} else if (io_direction == CACHE_INODE_WRITE ||
+		   io_direction == CACHE_INODE_WRITE_PLUS) {
 		status = cache_inode_refresh_attrs(entry);
 		if (status != CACHE_INODE_SUCCESS)
 			goto out;
@@ -85,6 +85,44 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_BOOL("Write_Gather", false,
+		       cache_inode_parameter, write_gather.enabled),
+	CONF_ITEM_UI32("Write_Gather_Size", 4096, 64 * 1024 * 1024,
+		       1024 * 1024,
+		       cache_inode_parameter, write_gather.size),
+	CONF_ITEM_UI32("Write_Gather_Delay", 1, 10000, 50,
+		       cache_inode_parameter, write_gather.delay),
+	CONF_ITEM_UI64("Write_Gather_Max_Memory", 0, UINT64_MAX,
+		       256 * 1024 * 1024,
+		       cache_inode_parameter, write_gather.max_memory),
+	CONF_ITEM_BOOL("Read_Ahead", false,
+		       cache_inode_parameter, read_ahead.enabled),
+	CONF_ITEM_UI32("Read_Ahead_Block_Size", 4096, 16 * 1024 * 1024,
+		       1024 * 1024,
+		       cache_inode_parameter, read_ahead.block_size),
+	CONF_ITEM_UI32("Read_Ahead_Blocks", 1, 64, 4,
+		       cache_inode_parameter, read_ahead.blocks),
+	CONF_ITEM_UI64("Read_Ahead_Max_Memory", 0, UINT64_MAX,
+		       256 * 1024 * 1024,
+		       cache_inode_parameter, read_ahead.max_memory),
+	CONF_ITEM_UI32("Read_Ahead_Threads", 1, 256, 8,
+		       cache_inode_parameter, read_ahead.threads),
+	CONF_ITEM_BOOL("Upcall_Batch", false,
+		       cache_inode_parameter, upcall_batch.enabled),
+	CONF_ITEM_UI32("Upcall_Batch_Delay", 1, 1000, 10,
+		       cache_inode_parameter, upcall_batch.delay),
+	CONF_ITEM_UI32("Upcall_Batch_Size", 1, 65536, 1024,
+		       cache_inode_parameter, upcall_batch.size),
+	CONF_ITEM_PATH("Warm_Restart_File", 1, MAXPATHLEN, NULL,
+		       cache_inode_parameter, warm.file),
+	CONF_ITEM_UI32("Warm_Restart_Interval", 10, 24 * 3600, 300,
+		       cache_inode_parameter, warm.interval),
+	CONF_ITEM_UI32("Warm_Restart_Entries", 1, 10000000, 50000,
+		       cache_inode_parameter, warm.entries),
+	CONF_ITEM_UI32("Warm_Restart_Rate", 0, UINT32_MAX, 2000,
+		       cache_inode_parameter, warm.rate),
+	CONF_ITEM_BOOL("Warm_Restart_Readdir", true,
+		       cache_inode_parameter, warm.readdir),
 	CONFIG_EOL
 };
 
@@ -0,0 +1,655 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file cache_inode_readahead.c
+ * @brief Sequential read-ahead
+ *
+ * With Read_Ahead set, each file watches the offsets of its READs.
+ * Once two reads in a row follow each other (give or take a block, as
+ * clients send their reads in parallel), the blocks of
+ * Read_Ahead_Block_Size bytes from the current read up to
+ * Read_Ahead_Blocks past it are read from the FSAL by the read-ahead
+ * threads.  Later READs that fall entirely within filled blocks are
+ * copied from them without calling the FSAL.
+ *
+ * Filled blocks of all files share one LRU and Read_Ahead_Max_Memory
+ * bytes; a file keeps at most twice Read_Ahead_Blocks blocks.  A file
+ * drops its blocks on any write through this server (gathered or not),
+ * a size change, a content invalidation from the FSAL, and when its
+ * change attribute moves.  Each of these bumps a generation number of
+ * the file, so a fill that was already running when it happened is
+ * thrown away when it completes.
+ *
+ * Locking: the read-ahead mutex of a file nests inside the content
+ * lock, and the mutex of the shared LRU inside that.  Evicting the
+ * block of another file only ever trylocks its mutex.  A fill holds
+ * the content lock for read while it reads, like any READ, and skips
+ * the read if the file is not open.
+ */
+
+#include "config.h"
+#include "fsal.h"
+
+#include "log.h"
+#include "abstract_atomic.h"
+#include "abstract_mem.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "nfs_core.h"
+#include "export_mgr.h"
+#include "fridgethr.h"
+#include "gsh_list.h"
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+/** Reads in a row that make a file sequential */
+#define RA_MIN_SEQ 2
+
+/**
+ * @brief A block of a file read ahead
+ */
+
+struct ra_block {
+	struct glist_head file_list;	/*< In the blocks of the file */
+	struct glist_head lru;		/*< In ra_lru, once filled */
+	cache_entry_t *entry;		/*< File, referenced while filling */
+	struct gsh_export *export;	/*< Export to fill in */
+	uint64_t offset;		/*< Offset in the file */
+	size_t len;			/*< Bytes read */
+	bool eof;			/*< Block ends the file */
+	bool filling;			/*< Read not done yet */
+	uint64_t gen;			/*< Generation of the file at submit */
+	uint64_t change;		/*< Change attribute at submit */
+	char *data;
+};
+
+/**
+ * @brief Read-ahead state of a file
+ */
+
+struct cache_inode_readahead {
+	pthread_mutex_t mtx;	/*< Protects everything below */
+	uint64_t next;		/*< End of the furthest sequential read */
+	uint32_t seq;		/*< Sequential reads in a row */
+	uint64_t gen;		/*< Bumped on every invalidation */
+	uint32_t nblocks;	/*< Blocks in the list */
+	struct glist_head blocks;	/*< Oldest first */
+};
+
+/** Filled blocks of all files, most recently used first */
+static struct {
+	pthread_mutex_t mtx;
+	struct glist_head lru;
+	uint64_t bytes;		/*< Data of all blocks, filled or not */
+} ra_lru = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.lru = GLIST_HEAD_INIT(ra_lru.lru),
+};
+
+struct cache_ra_stats cache_ra_st;
+
+static struct fridgethr *ra_fridge;
+
+/**
+ * @brief Get the read-ahead state of a file, creating it if asked
+ */
+
+static struct cache_inode_readahead *ra_get(cache_entry_t *entry,
+					    bool create)
+{
+	struct cache_inode_readahead *ra = entry->object.file.readahead;
+
+	if (ra != NULL || !create)
+		return ra;
+
+	ra = gsh_calloc(1, sizeof(*ra));
+	if (ra == NULL)
+		return NULL;
+
+	PTHREAD_MUTEX_init(&ra->mtx, NULL);
+	glist_init(&ra->blocks);
+
+	if (!atomic_cas_voidptr((void **)&entry->object.file.readahead,
+				NULL, ra)) {
+		/* Another reader got there first */
+		PTHREAD_MUTEX_destroy(&ra->mtx);
+		gsh_free(ra);
+		ra = entry->object.file.readahead;
+	}
+
+	return ra;
+}
+
+/**
+ * @brief Free a block
+ *
+ * The mutex of its file must be held, and the block must not be
+ * filling.
+ */
+
+static void ra_block_free(struct cache_inode_readahead *ra,
+			  struct ra_block *blk)
+{
+	glist_del(&blk->file_list);
+	ra->nblocks--;
+
+	PTHREAD_MUTEX_lock(&ra_lru.mtx);
+	if (!glist_null(&blk->lru))
+		glist_del(&blk->lru);
+	ra_lru.bytes -= cache_param.read_ahead.block_size;
+	PTHREAD_MUTEX_unlock(&ra_lru.mtx);
+
+	gsh_free(blk->data);
+	gsh_free(blk);
+}
+
+/**
+ * @brief Drop the filled blocks of a file that overlap a range
+ *
+ * The mutex of the file must be held.  Blocks still filling are left
+ * to see the new generation when they complete.
+ */
+
+static void ra_drop(struct cache_inode_readahead *ra, uint64_t offset,
+		    uint64_t length)
+{
+	struct glist_head *node, *noden;
+	struct ra_block *blk;
+	uint64_t bs = cache_param.read_ahead.block_size;
+
+	ra->gen++;
+
+	glist_for_each_safe(node, noden, &ra->blocks) {
+		blk = glist_entry(node, struct ra_block, file_list);
+		if (blk->filling)
+			continue;
+		if (length != 0 &&
+		    (blk->offset >= offset + length ||
+		     blk->offset + bs <= offset))
+			continue;
+		ra_block_free(ra, blk);
+	}
+}
+
+/**
+ * @brief Make room for a new block
+ *
+ * Called with the mutex of ra held.  Evicts least recently used blocks
+ * of any file, skipping files that are busy, until the new block fits
+ * in Read_Ahead_Max_Memory.
+ *
+ * @return true if the block may be allocated.
+ */
+
+static bool ra_reserve(struct cache_inode_readahead *ra)
+{
+	uint64_t bs = cache_param.read_ahead.block_size;
+	uint64_t max = cache_param.read_ahead.max_memory;
+	struct glist_head *node, *prev;
+	struct cache_inode_readahead *owner;
+	struct ra_block *blk;
+	bool ok;
+
+	PTHREAD_MUTEX_lock(&ra_lru.mtx);
+
+	for (node = ra_lru.lru.prev;
+	     ra_lru.bytes + bs > max && node != &ra_lru.lru;
+	     node = prev) {
+		prev = node->prev;
+		blk = glist_entry(node, struct ra_block, lru);
+		owner = blk->entry->object.file.readahead;
+
+		if (owner != ra && pthread_mutex_trylock(&owner->mtx) != 0)
+			continue;
+
+		glist_del(&blk->lru);
+		glist_del(&blk->file_list);
+		owner->nblocks--;
+		ra_lru.bytes -= bs;
+
+		if (owner != ra)
+			PTHREAD_MUTEX_unlock(&owner->mtx);
+
+		gsh_free(blk->data);
+		gsh_free(blk);
+		(void)atomic_inc_uint64_t(&cache_ra_st.evicted);
+	}
+
+	ok = ra_lru.bytes + bs <= max;
+	if (ok)
+		ra_lru.bytes += bs;
+
+	PTHREAD_MUTEX_unlock(&ra_lru.mtx);
+
+	return ok;
+}
+
+/**
+ * @brief Read a block from the FSAL
+ *
+ * @param[in] ctx Thread context, the block is the argument
+ */
+
+static void ra_fill(struct fridgethr_context *ctx)
+{
+	struct ra_block *blk = ctx->arg;
+	cache_entry_t *entry = blk->entry;
+	struct gsh_export *export = blk->export;
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct cache_inode_readahead *ra = entry->object.file.readahead;
+	struct root_op_context root_op_context;
+	fsal_status_t status = { ERR_FSAL_NOT_OPENED, 0 };
+	size_t moved = 0;
+	bool eof = false;
+
+	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+
+	if (obj_hdl->obj_ops.status(obj_hdl) & FSAL_O_READ) {
+		init_root_op_context(&root_op_context, export,
+				     export->fsal_export, 0, 0,
+				     UNKNOWN_REQUEST);
+
+		/* What is gathered for this block must be there first */
+		(void)cache_inode_wgather_flush_range(
+			entry, blk->offset, cache_param.read_ahead.block_size);
+
+		status = obj_hdl->obj_ops.read(obj_hdl, blk->offset,
+					       cache_param.read_ahead.block_size,
+					       blk->data, &moved, &eof);
+
+		release_root_op_context();
+	}
+
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+
+	blk->filling = false;
+	blk->export = NULL;
+
+	if (FSAL_IS_ERROR(status) || blk->gen != ra->gen) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "Dropping read-ahead at %" PRIu64
+			     " of entry %p, status %d",
+			     blk->offset, entry, status.major);
+		ra_block_free(ra, blk);
+	} else {
+		blk->len = moved;
+		blk->eof = eof;
+		PTHREAD_MUTEX_lock(&ra_lru.mtx);
+		glist_add(&ra_lru.lru, &blk->lru);
+		PTHREAD_MUTEX_unlock(&ra_lru.mtx);
+		(void)atomic_inc_uint64_t(&cache_ra_st.fills);
+	}
+
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+
+	put_gsh_export(export);
+	cache_inode_put(entry);
+}
+
+/**
+ * @brief Find the block of a file at an offset
+ */
+
+static struct ra_block *ra_find(struct cache_inode_readahead *ra,
+				uint64_t offset)
+{
+	struct glist_head *node;
+	struct ra_block *blk;
+
+	glist_for_each(node, &ra->blocks) {
+		blk = glist_entry(node, struct ra_block, file_list);
+		if (blk->offset == offset)
+			return blk;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Start reading a block
+ *
+ * Called with the mutex of ra held.
+ *
+ * @return false if no more blocks should be started.
+ */
+
+static bool ra_submit(cache_entry_t *entry, struct cache_inode_readahead *ra,
+		      uint64_t offset)
+{
+	struct glist_head *node;
+	struct ra_block *blk, *old = NULL;
+
+	/* Make room in the file first, oldest filled block goes */
+	if (ra->nblocks >= 2 * cache_param.read_ahead.blocks) {
+		glist_for_each(node, &ra->blocks) {
+			blk = glist_entry(node, struct ra_block, file_list);
+			if (!blk->filling) {
+				old = blk;
+				break;
+			}
+		}
+		if (old == NULL)
+			return false;
+		ra_block_free(ra, old);
+	}
+
+	if (!ra_reserve(ra))
+		return false;
+
+	blk = gsh_calloc(1, sizeof(*blk));
+	if (blk != NULL)
+		blk->data = gsh_malloc(cache_param.read_ahead.block_size);
+	if (blk == NULL || blk->data == NULL)
+		goto nomem;
+
+	if (cache_inode_lru_ref(entry, LRU_FLAG_NONE) != CACHE_INODE_SUCCESS)
+		goto nomem;
+
+	get_gsh_export_ref(op_ctx->export);
+	blk->entry = entry;
+	blk->export = op_ctx->export;
+	blk->offset = offset;
+	blk->filling = true;
+	blk->gen = ra->gen;
+	blk->change = entry->obj_handle->attrs->change;
+	glist_add_tail(&ra->blocks, &blk->file_list);
+	ra->nblocks++;
+
+	if (fridgethr_submit(ra_fridge, ra_fill, blk) != 0) {
+		blk->filling = false;
+		put_gsh_export(blk->export);
+		cache_inode_put(entry);
+		ra_block_free(ra, blk);
+		return false;
+	}
+
+	return true;
+
+ nomem:
+	if (blk != NULL) {
+		gsh_free(blk->data);
+		gsh_free(blk);
+	}
+	PTHREAD_MUTEX_lock(&ra_lru.mtx);
+	ra_lru.bytes -= cache_param.read_ahead.block_size;
+	PTHREAD_MUTEX_unlock(&ra_lru.mtx);
+	return false;
+}
+
+/**
+ * @brief Copy a read from filled blocks
+ *
+ * Called with the mutex of ra held.
+ *
+ * @return true if the whole read, or all of it up to the end of the
+ *         file, was copied.
+ */
+
+static bool ra_copy(cache_entry_t *entry, struct cache_inode_readahead *ra,
+		    uint64_t offset, size_t io_size, char *buffer,
+		    size_t *bytes_moved, bool *eof)
+{
+	uint64_t bs = cache_param.read_ahead.block_size;
+	uint64_t pos = offset, end = offset + io_size;
+	struct ra_block *blk;
+	size_t n;
+	bool at_eof = false;
+
+	while (pos < end) {
+		blk = ra_find(ra, pos - pos % bs);
+		if (blk == NULL || blk->filling)
+			return false;
+
+		if (blk->change != entry->obj_handle->attrs->change) {
+			/* Changed behind our back */
+			ra_drop(ra, 0, 0);
+			return false;
+		}
+
+		PTHREAD_MUTEX_lock(&ra_lru.mtx);
+		glist_del(&blk->lru);
+		glist_add(&ra_lru.lru, &blk->lru);
+		PTHREAD_MUTEX_unlock(&ra_lru.mtx);
+
+		if (pos >= blk->offset + blk->len) {
+			/* Past what the FSAL had */
+			if (!blk->eof)
+				return false;
+			at_eof = true;
+			break;
+		}
+
+		n = MIN(end, blk->offset + blk->len) - pos;
+		memcpy(buffer + (pos - offset), blk->data + (pos - blk->offset),
+		       n);
+		pos += n;
+
+		if (pos == blk->offset + blk->len && blk->eof) {
+			at_eof = true;
+			break;
+		}
+	}
+
+	*bytes_moved = pos - offset;
+	*eof = at_eof;
+
+	return true;
+}
+
+/**
+ * @brief Serve a READ from read-ahead and read further ahead
+ *
+ * The caller holds the content lock and has the file open for read.
+ * If this returns false, the caller must read from the FSAL itself.
+ *
+ * @param[in]  entry       The file
+ * @param[in]  offset      Offset of the read
+ * @param[in]  io_size     Size of the read
+ * @param[out] buffer      Where to put the data
+ * @param[out] bytes_moved Bytes read
+ * @param[out] eof         Whether the read reached the end of the file
+ *
+ * @return true if the read was served.
+ */
+
+bool cache_inode_readahead_read(cache_entry_t *entry, uint64_t offset,
+				size_t io_size, void *buffer,
+				size_t *bytes_moved, bool *eof)
+{
+	struct cache_inode_readahead *ra;
+	uint64_t bs = cache_param.read_ahead.block_size;
+	uint64_t end = offset + io_size, pos, stop, filesize;
+	struct ra_block *blk;
+	bool hit;
+
+	if (!cache_param.read_ahead.enabled || ra_fridge == NULL ||
+	    io_size == 0 || end < offset)
+		return false;
+
+	ra = ra_get(entry, true);
+	if (ra == NULL)
+		return false;
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+
+	/* Reads in flight arrive a little out of order */
+	if (offset == 0 ||
+	    (offset + bs >= ra->next && offset <= ra->next + bs)) {
+		if (ra->seq < RA_MIN_SEQ)
+			ra->seq++;
+		if (end > ra->next || offset == 0)
+			ra->next = end;
+	} else {
+		ra->seq = 0;
+		ra->next = end;
+	}
+
+	hit = ra_copy(entry, ra, offset, io_size, buffer, bytes_moved, eof);
+
+	if (ra->seq >= RA_MIN_SEQ) {
+		filesize = entry->obj_handle->attrs->filesize;
+		stop = end + (uint64_t) cache_param.read_ahead.blocks * bs;
+		/* From the first block after this read: on a miss the
+		 * caller reads the range itself */
+		for (pos = end + (bs - end % bs) % bs; pos < stop;
+		     pos += bs) {
+			blk = ra_find(ra, pos);
+			if (blk != NULL) {
+				if (!blk->filling && blk->eof)
+					break;
+				continue;
+			}
+			/* Only a hint, the file may have grown since */
+			if (pos >= filesize && pos > offset)
+				break;
+			if (!ra_submit(entry, ra, pos))
+				break;
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+
+	(void)atomic_inc_uint64_t(hit ? &cache_ra_st.hits
+				      : &cache_ra_st.misses);
+
+	return hit;
+}
+
+/**
+ * @brief Drop read-ahead data of a file that a change makes stale
+ *
+ * Called after a write has reached the FSAL (or been gathered), and on
+ * anything else that changes the content of the file.
+ *
+ * @param[in] entry  The file
+ * @param[in] offset Start of the changed range
+ * @param[in] length Length of the range, 0 for everything
+ */
+
+void cache_inode_readahead_invalidate(cache_entry_t *entry, uint64_t offset,
+				      uint64_t length)
+{
+	struct cache_inode_readahead *ra;
+
+	if (entry->type != REGULAR_FILE)
+		return;
+
+	ra = ra_get(entry, false);
+	if (ra == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	ra_drop(ra, offset, length);
+	ra->seq = 0;
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+}
+
+/**
+ * @brief Free the read-ahead state of a file being cleaned
+ *
+ * Fills hold a reference, so none is running.
+ *
+ * @param[in] entry The file
+ */
+
+void cache_inode_readahead_release(cache_entry_t *entry)
+{
+	struct cache_inode_readahead *ra;
+
+	if (entry->type != REGULAR_FILE ||
+	    entry->object.file.readahead == NULL)
+		return;
+
+	ra = entry->object.file.readahead;
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	ra_drop(ra, 0, 0);
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+
+	entry->object.file.readahead = NULL;
+	PTHREAD_MUTEX_destroy(&ra->mtx);
+	gsh_free(ra);
+}
+
+/**
+ * @brief Start the read-ahead threads
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int cache_inode_readahead_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (!cache_param.read_ahead.enabled || ra_fridge != NULL)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = cache_param.read_ahead.threads;
+	frp.thread_delay = 10;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&ra_fridge, "Read_Ahead", &frp);
+	if (rc != 0)
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize read-ahead fridge: %d", rc);
+
+	return rc;
+}
+
+/**
+ * @brief Stop the read-ahead threads
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int cache_inode_readahead_pkgshutdown(void)
+{
+	int rc;
+
+	if (ra_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(ra_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Shutdown timed out, cancelling read-ahead threads.");
+		fridgethr_cancel(ra_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Failed shutting down read-ahead threads: %d", rc);
+	}
+
+	return rc;
+}
+
+/** @} */
@@ -141,7 +141,7 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 		     directory, name, newname);
 
 	/* If no active entry, do nothing */
-	if (directory->object.dir.nbactive == 0) {
+	if (directory->object.dir->nbactive == 0) {
 		if (!
 		    ((directory->flags & CACHE_INODE_TRUST_CONTENT)
 		     && (directory->flags & CACHE_INODE_DIR_POPULATED))) {
@@ -185,7 +185,7 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 	case CACHE_INODE_DIRENT_OP_REMOVE:
 		/* mark deleted */
 		avl_dirent_set_deleted(directory, dirent);
-		directory->object.dir.nbactive--;
+		directory->object.dir->nbactive--;
 		break;
 
 	case CACHE_INODE_DIRENT_OP_RENAME:
@@ -310,7 +310,7 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 		*dir_entry = new_dir_entry;
 
 	/* we're going to succeed */
-	parent->object.dir.nbactive++;
+	parent->object.dir->nbactive++;
 
 	return status;
 }
@@ -418,7 +418,7 @@ populate_dirent(const char *name, void *dir_state,
 
 	if (cache_entry->type == DIRECTORY) {
 		/* Insert Parent's key */
-		cache_inode_key_dup(&cache_entry->object.dir.parent,
+		cache_inode_key_dup(&cache_entry->object.dir->parent,
 				    &state->directory->fh_hk.key);
 	}
 
@@ -704,13 +704,13 @@ cache_inode_readdir(cache_entry_t *directory,
 
 	} else {
 		/* initial readdir */
-		dirent_node = avltree_first(&directory->object.dir.avl.t);
+		dirent_node = avltree_first(&directory->object.dir->avl.t);
 	}
 
 	LogFullDebug(COMPONENT_NFS_READDIR,
 		     "About to readdir in cache_inode_readdir: directory=%p cookie=%"
 		     PRIu64 " collisions %d",
-		     directory, cookie, directory->object.dir.avl.collisions);
+		     directory, cookie, directory->object.dir->avl.collisions);
 
 	/* Now satisfy the request from the cached readdir--stop when either
 	 * the requested sequence or dirent sequence is exhausted */
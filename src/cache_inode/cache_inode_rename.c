@@ -233,7 +233,7 @@ cache_inode_rename(cache_entry_t *dir_src,
 		/* Get attr_lock for looking at junction_export */
 		PTHREAD_RWLOCK_rdlock(&lookup_src->attr_lock);
 
-		if (lookup_src->object.dir.junction_export != NULL ||
+		if (lookup_src->object.dir->junction_export != NULL ||
 		    atomic_fetch_int32_t(&lookup_src->exp_root_refcount)
 		    != 0) {
 			/* Trying to rename an export mount point */
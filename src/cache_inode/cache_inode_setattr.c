@@ -104,6 +104,9 @@ cache_inode_setattr(cache_entry_t *entry,
 	if (attr->mask & (ATTR_SIZE | ATTR4_SPACE_RESERVED)) {
 		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
 		content_locked = true;
+		/* Gathered writes must not land after the truncate */
+		(void)cache_inode_wgather_flush_range(entry, 0, 0);
+		cache_inode_readahead_invalidate(entry, 0, 0);
 	}
 
 	/* Test for the following condition from chown(2):
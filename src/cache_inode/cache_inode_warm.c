@@ -0,0 +1,621 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file cache_inode_warm.c
+ * @brief Warm restart of the cache
+ *
+ * With Warm_Restart_File set, the Warm_Restart_Entries most recently
+ * used entries, of L1 then of L2, are saved to it every
+ * Warm_Restart_Interval seconds and at shutdown: the handle key of
+ * each, its export, type and, for a directory, the key of its parent.
+ * The hottest entries of every lane come first.
+ *
+ * At startup the same thread prefetches the saved entries into the
+ * cache, at most Warm_Restart_Rate a second, hottest first, and with
+ * Warm_Restart_Readdir the contents of the saved directories, so that
+ * the first clients after a restart or failover, most of them
+ * reclaiming during grace, find the cache warm.  A saved directory
+ * gets its parent back, so LOOKUPP does not go to the FSAL.
+ *
+ * The file is host endian and only meant to be read back by the
+ * server that wrote it.  It is written to a temporary file then
+ * renamed over, so a crash leaves the previous snapshot.
+ */
+
+#include "config.h"
+#include "fsal.h"
+
+#include "log.h"
+#include "abstract_atomic.h"
+#include "abstract_mem.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "cache_inode_hash.h"
+#include "nfs_core.h"
+#include "export_mgr.h"
+#include "fridgethr.h"
+#include "sal_functions.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** "GWR1" */
+#define WARM_MAGIC 0x47575231
+
+struct warm_header {
+	uint32_t magic;
+	uint32_t count;		/*< Records that follow */
+};
+
+/**
+ * @brief A saved entry, followed by its key then its parent's
+ */
+
+struct warm_record {
+	uint16_t export_id;
+	uint8_t type;
+	uint8_t pad;
+	uint16_t key_len;
+	uint16_t parent_len;	/*< 0 unless a directory with a known parent */
+};
+
+/**
+ * @brief An entry taken by a snapshot
+ */
+
+struct warm_item {
+	uint32_t rank;		/*< Place in its lane, 0 the hottest */
+	struct warm_record rec;
+	char data[];
+};
+
+/**
+ * @brief Room the entries of a lane are copied into
+ *
+ * It is allocated before the lane is locked, so that taking the
+ * snapshot does not allocate under the lane's lock.
+ */
+
+struct warm_chunk {
+	struct warm_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/** Room for the first lane, doubled until a lane fits */
+#define WARM_CHUNK (64 * 1024)
+
+struct warm_snapshot {
+	struct warm_item **items;
+	uint32_t count;
+	uint32_t alloc;
+	struct warm_chunk *chunks;	/*< Newest first, items point in */
+	size_t chunk_size;		/*< Room for the next lane */
+	bool full;			/*< The newest chunk ran out */
+};
+
+static struct fridgethr *warm_fridge;
+
+/** Serializes saves, which share the temporary file */
+static pthread_mutex_t warm_save_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** Set once the saved entries have been prefetched (or not) */
+static bool warm_started;
+
+/**
+ * @brief Take a copy of an entry's keys, under its lane's lock
+ *
+ * The copy goes into the newest chunk of the snapshot, and a pointer
+ * to it into the items, which have room for the whole lane.
+ *
+ * @return false if the chunk is full.
+ */
+
+static bool warm_collect(cache_entry_t *entry, uint32_t rank, void *state)
+{
+	struct warm_snapshot *snap = state;
+	struct warm_chunk *chunk = snap->chunks;
+	struct gsh_export *export = atomic_fetch_voidptr(&entry->first_export);
+	struct gsh_buffdesc *key = &entry->fh_hk.key.kv;
+	struct gsh_buffdesc *parent = NULL;
+	struct warm_item *item = NULL;
+	bool locked = false;
+	size_t need;
+
+	if (export == NULL || key->len > UINT16_MAX)
+		return true;
+
+	/* The lane lock is held, so the parent is only taken if it
+	   comes for free */
+	if (entry->type == DIRECTORY &&
+	    pthread_rwlock_tryrdlock(&entry->content_lock) == 0) {
+		locked = true;
+		if (entry->object.dir != NULL &&
+		    entry->object.dir->parent.kv.addr != NULL &&
+		    entry->object.dir->parent.kv.len <= UINT16_MAX)
+			parent = &entry->object.dir->parent.kv;
+	}
+
+	/* Keep the next item aligned */
+	need = (sizeof(*item) + key->len +
+		(parent != NULL ? parent->len : 0) + 7) & ~(size_t)7;
+	if (chunk->size - chunk->used < need) {
+		snap->full = true;
+	} else {
+		item = (struct warm_item *)(chunk->data + chunk->used);
+		chunk->used += need;
+		item->rank = rank;
+		item->rec.export_id = export->export_id;
+		item->rec.type = entry->type;
+		item->rec.pad = 0;
+		item->rec.key_len = key->len;
+		item->rec.parent_len = parent != NULL ? parent->len : 0;
+		memcpy(item->data, key->addr, key->len);
+		if (parent != NULL)
+			memcpy(item->data + key->len, parent->addr,
+			       parent->len);
+		snap->items[snap->count++] = item;
+	}
+
+	if (locked)
+		pthread_rwlock_unlock(&entry->content_lock);
+
+	return item != NULL;
+}
+
+/**
+ * @brief Take copies of the hottest entries of a lane
+ *
+ * If the lane does not fit in the room allocated for it, its copies
+ * are dropped and it is taken again with twice the room.
+ *
+ * @return false if memory ran out.
+ */
+
+static bool warm_collect_lane(struct warm_snapshot *snap, uint32_t lane)
+{
+	uint32_t entries = cache_param.warm.entries;
+	uint32_t count = snap->count;
+	struct warm_item **items;
+	struct warm_chunk *chunk;
+
+	if (snap->alloc - snap->count < entries) {
+		items = gsh_realloc(snap->items,
+				    ((size_t)snap->count + entries) *
+				    sizeof(*items));
+		if (items == NULL)
+			return false;
+		snap->items = items;
+		snap->alloc = snap->count + entries;
+	}
+
+	for (;;) {
+		chunk = gsh_malloc(sizeof(*chunk) + snap->chunk_size);
+		if (chunk == NULL)
+			return false;
+		chunk->size = snap->chunk_size;
+		chunk->used = 0;
+		chunk->next = snap->chunks;
+		snap->chunks = chunk;
+		snap->full = false;
+
+		cache_inode_lru_foreach_hot(lane, entries, warm_collect, snap);
+		if (!snap->full)
+			return true;
+
+		snap->count = count;
+		snap->chunks = chunk->next;
+		gsh_free(chunk);
+		snap->chunk_size *= 2;
+	}
+}
+
+static int warm_rank_cmpf(const void *a, const void *b)
+{
+	const struct warm_item *i1 = *(struct warm_item **)a;
+	const struct warm_item *i2 = *(struct warm_item **)b;
+
+	return i1->rank < i2->rank ? -1 : i1->rank != i2->rank;
+}
+
+/**
+ * @brief Save the hottest entries to Warm_Restart_File now
+ */
+
+void cache_inode_warm_save(void)
+{
+	struct warm_snapshot snap;
+	struct warm_header hdr;
+	struct warm_chunk *chunk;
+	char *tmp = NULL;
+	FILE *fp = NULL;
+	uint32_t count, i;
+	struct timespec start, end;
+	int rc = 0;
+
+	if (cache_param.warm.file == NULL)
+		return;
+
+	memset(&snap, 0, sizeof(snap));
+	snap.chunk_size = WARM_CHUNK;
+	tmp = gsh_malloc(strlen(cache_param.warm.file) + 5);
+	if (tmp == NULL) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Could not allocate warm restart snapshot");
+		goto out_free;
+	}
+
+	PTHREAD_MUTEX_lock(&warm_save_mtx);
+	now(&start);
+
+	/* Lanes fill unevenly, so each may give all the entries saved */
+	for (i = 0; i < LRU_N_Q_LANES; i++) {
+		if (!warm_collect_lane(&snap, i)) {
+			LogMajor(COMPONENT_CACHE_INODE,
+				 "Could not allocate warm restart snapshot, saving %"
+				 PRIu32 " entries", snap.count);
+			break;
+		}
+	}
+
+	/* Interleave the lanes, hottest first */
+	qsort(snap.items, snap.count, sizeof(*snap.items), warm_rank_cmpf);
+	count = snap.count < cache_param.warm.entries ?
+		snap.count : cache_param.warm.entries;
+
+	sprintf(tmp, "%s.tmp", cache_param.warm.file);
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		rc = errno;
+		goto err;
+	}
+
+	hdr.magic = WARM_MAGIC;
+	hdr.count = count;
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		goto err_write;
+
+	for (i = 0; i < count; i++) {
+		struct warm_item *item = snap.items[i];
+
+		if (fwrite(&item->rec, sizeof(item->rec), 1, fp) != 1 ||
+		    fwrite(item->data, item->rec.key_len +
+			   item->rec.parent_len, 1, fp) != 1)
+			goto err_write;
+	}
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+		goto err_write;
+
+	rc = fclose(fp);
+	fp = NULL;
+	if (rc != 0 || rename(tmp, cache_param.warm.file) != 0) {
+		rc = errno;
+		goto err;
+	}
+
+	now(&end);
+	LogDebug(COMPONENT_CACHE_INODE,
+		 "Saved %" PRIu32 " hot entries to %s in %" PRIu64 " ms",
+		 count, cache_param.warm.file,
+		 timespec_diff(&start, &end) / NS_PER_MSEC);
+	goto out;
+
+ err_write:
+	rc = errno;
+ err:
+	LogWarn(COMPONENT_CACHE_INODE,
+		"Could not save hot entries to %s: %s",
+		cache_param.warm.file, strerror(rc));
+	if (fp != NULL)
+		fclose(fp);
+	unlink(tmp);
+ out:
+	PTHREAD_MUTEX_unlock(&warm_save_mtx);
+ out_free:
+	while (snap.chunks != NULL) {
+		chunk = snap.chunks;
+		snap.chunks = chunk->next;
+		gsh_free(chunk);
+	}
+	gsh_free(snap.items);
+	gsh_free(tmp);
+}
+
+static cache_inode_status_t
+warm_readdir_cb(void *opaque, cache_entry_t *entry,
+		const struct attrlist *attr, uint64_t mounted_on_fileid,
+		enum cb_state cb_state)
+{
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Bring one saved entry back into the cache
+ *
+ * @return Number of entries cached, counting directory contents.
+ */
+
+static uint32_t warm_prefetch_one(const struct warm_record *rec,
+				  char *key, char *parent)
+{
+	struct gsh_export *export = get_gsh_export(rec->export_id);
+	struct root_op_context root_op_context;
+	cache_inode_fsal_data_t fsdata;
+	struct gsh_buffdesc parent_desc;
+	cache_entry_t *entry;
+	cache_inode_status_t status;
+	unsigned int nbfound = 0;
+	bool eod;
+
+	if (export == NULL)
+		return 0;
+
+	init_root_op_context(&root_op_context, export, export->fsal_export,
+			     0, 0, UNKNOWN_REQUEST);
+
+	fsdata.export = export->fsal_export;
+	fsdata.fh_desc.addr = key;
+	fsdata.fh_desc.len = rec->key_len;
+
+	status = cache_inode_get(&fsdata, &entry);
+	if (status != CACHE_INODE_SUCCESS) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "Could not prefetch entry of export %" PRIu16
+			     ": %s", rec->export_id,
+			     cache_inode_err_str(status));
+		goto out;
+	}
+
+	if (entry->type == DIRECTORY && rec->parent_len != 0) {
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		if (entry->object.dir != NULL &&
+		    entry->object.dir->parent.kv.addr == NULL) {
+			parent_desc.addr = parent;
+			parent_desc.len = rec->parent_len;
+			(void)cih_hash_key(&entry->object.dir->parent,
+					   export->fsal_export->fsal,
+					   &parent_desc, CIH_HASH_NONE);
+		}
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
+
+	if (entry->type == DIRECTORY && cache_param.warm.readdir)
+		(void)cache_inode_readdir(entry, 0, &nbfound, &eod, 0,
+					  warm_readdir_cb, NULL);
+
+	cache_inode_put(entry);
+	nbfound++;
+
+ out:
+	release_root_op_context();
+	put_gsh_export(export);
+	return nbfound;
+}
+
+/**
+ * @brief Wait until prefetching done entries is within the rate
+ */
+
+static void warm_throttle(const struct timespec *start, uint64_t done)
+{
+	struct timespec ts;
+	nsecs_elapsed_t due, elapsed;
+
+	if (cache_param.warm.rate == 0)
+		return;
+
+	due = done * NS_PER_SEC / cache_param.warm.rate;
+	now(&ts);
+	elapsed = timespec_diff(start, &ts);
+	if (elapsed >= due)
+		return;
+
+	due -= elapsed;
+	ts.tv_sec = due / NS_PER_SEC;
+	ts.tv_nsec = due % NS_PER_SEC;
+	(void)nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Prefetch the entries saved in Warm_Restart_File
+ */
+
+static void warm_prefetch(struct fridgethr_context *ctx)
+{
+	const struct warm_header *hdr;
+	struct warm_record rec;
+	struct timespec start, end;
+	struct stat st;
+	uint64_t done = 0;
+	uint32_t i, entries = 0;
+	char *buf = NULL, *pos, *lim;
+	FILE *fp;
+
+	fp = fopen(cache_param.warm.file, "r");
+	if (fp == NULL) {
+		if (errno != ENOENT)
+			LogWarn(COMPONENT_CACHE_INODE,
+				"Could not open %s: %s",
+				cache_param.warm.file, strerror(errno));
+		return;
+	}
+
+	if (fstat(fileno(fp), &st) != 0 ||
+	    st.st_size < (off_t)sizeof(*hdr))
+		goto bad;
+
+	buf = gsh_malloc(st.st_size);
+	if (buf == NULL || fread(buf, st.st_size, 1, fp) != 1)
+		goto bad;
+
+	hdr = (const struct warm_header *)buf;
+	if (hdr->magic != WARM_MAGIC)
+		goto bad;
+
+	now(&start);
+
+	pos = buf + sizeof(*hdr);
+	lim = buf + st.st_size;
+	for (i = 0; i < hdr->count; i++) {
+		/* Records follow keys of any length, so are not aligned */
+		if (lim - pos < (ptrdiff_t)sizeof(rec))
+			break;
+		memcpy(&rec, pos, sizeof(rec));
+		if (lim - pos - sizeof(rec) <
+		    (size_t)rec.key_len + rec.parent_len)
+			break;
+		pos += sizeof(rec);
+
+		if (fridgethr_you_should_break(ctx))
+			break;
+
+		warm_throttle(&start, done);
+		done += warm_prefetch_one(&rec, pos, pos + rec.key_len);
+		entries++;
+
+		pos += rec.key_len + rec.parent_len;
+	}
+
+	now(&end);
+	LogEvent(COMPONENT_CACHE_INODE,
+		 "Prefetched %" PRIu32 " of %" PRIu32
+		 " saved entries, %" PRIu64 " with directory contents, in %"
+		 PRIu64 " ms, %s grace",
+		 entries, hdr->count, done,
+		 timespec_diff(&start, &end) / NS_PER_MSEC,
+		 nfs_in_grace() ? "within" : "after");
+
+	fclose(fp);
+	gsh_free(buf);
+	return;
+
+ bad:
+	LogWarn(COMPONENT_CACHE_INODE,
+		"Ignoring unreadable warm restart file %s",
+		cache_param.warm.file);
+	fclose(fp);
+	gsh_free(buf);
+}
+
+/**
+ * @brief Prefetch once, then save every Warm_Restart_Interval
+ */
+
+static void warm_run(struct fridgethr_context *ctx)
+{
+	if (!warm_started) {
+		warm_prefetch(ctx);
+		warm_started = true;
+		return;
+	}
+
+	cache_inode_warm_save();
+}
+
+/**
+ * @brief Start warm restart, prefetching the saved entries
+ *
+ * Called once the exports are set up.
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int cache_inode_warm_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (cache_param.warm.file == NULL || warm_fridge != NULL)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = cache_param.warm.interval;
+	frp.flavor = fridgethr_flavor_looper;
+
+	rc = fridgethr_init(&warm_fridge, "Cache_Warm", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize warm restart fridge: %d", rc);
+		return rc;
+	}
+
+	rc = fridgethr_submit(warm_fridge, warm_run, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to start warm restart thread: %d", rc);
+		fridgethr_destroy(warm_fridge);
+		warm_fridge = NULL;
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Stop warm restart, saving the hot entries a last time
+ *
+ * Called before the exports are removed.
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int cache_inode_warm_pkgshutdown(void)
+{
+	int rc;
+
+	if (warm_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(warm_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Shutdown timed out, cancelling warm restart thread.");
+		fridgethr_cancel(warm_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Failed shutting down warm restart thread: %d", rc);
+	}
+
+	/* Only save over the file once it has been read */
+	if (warm_started)
+		cache_inode_warm_save();
+
+	if (rc == 0)
+		fridgethr_destroy(warm_fridge);
+	warm_fridge = NULL;
+	warm_started = false;
+
+	return rc;
+}
+
+/** @} */
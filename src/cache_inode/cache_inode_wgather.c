@@ -0,0 +1,578 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file cache_inode_wgather.c
+ * @brief Gathering of unstable writes
+ *
+ * With Write_Gather set, small UNSTABLE writes are not passed to the
+ * FSAL one by one.  Each file collects a run of adjacent or overlapping
+ * writes in one buffer, which is written with a single FSAL write when
+ * it reaches Write_Gather_Size, when Write_Gather_Delay has passed
+ * since the run started, or before anything that must see the data: a
+ * COMMIT, a real close or reopen of the file, a truncate, and any read
+ * or ungathered write that overlaps the run.  A write that does not
+ * continue the run flushes it and starts a new one.  Once the
+ * gathered buffers of all files hold Write_Gather_Max_Memory bytes,
+ * writes go straight to the FSAL again, and the runs already gathered
+ * are written out in the background rather than when they are due.
+ *
+ * Gathered data lives only in server memory, which UNSTABLE allows: it
+ * is lost if the server stops, and since the write verifier is the
+ * server's start time clients see the new verifier and send the data
+ * again.  A background flush that fails drops the run and leaves its
+ * error on the file for the next COMMIT to return.
+ *
+ * Locking: the gather mutex nests inside the content lock, which
+ * nests inside the attribute lock.  The list of pending runs nests
+ * inside the gather mutex.  Runs are only started and flushed
+ * with the content lock held and the file open for write, and every
+ * close or reopen flushes first, so a pending run always has a
+ * descriptor to go to.
+ */
+
+#include "config.h"
+#include "fsal.h"
+
+#include "log.h"
+#include "abstract_atomic.h"
+#include "abstract_mem.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "nfs_core.h"
+#include "export_mgr.h"
+#include "delayed_exec.h"
+#include "gsh_list.h"
+
+#include <string.h>
+#include <pthread.h>
+
+/** Initial size of a gather buffer; it doubles up to Write_Gather_Size */
+#define WGATHER_MIN_BUF (64 * 1024)
+
+/**
+ * @brief Gathered writes of a file
+ */
+
+struct cache_inode_wgather {
+	pthread_mutex_t mtx;	/*< Protects everything below */
+	char *buf;		/*< Gathered data, NULL between runs */
+	size_t size;		/*< Allocated size of buf */
+	uint64_t offset;	/*< File offset of buf[0] */
+	size_t len;		/*< Bytes gathered */
+	bool flush_queued;	/*< A delayed flush holds references */
+	struct gsh_export *export;	/*< Export for the delayed flush */
+	fsal_status_t error;	/*< Failed flush, for the next COMMIT */
+	cache_entry_t *entry;	/*< The file, while flush_queued */
+	struct glist_head runs;	/*< On wgather_runs while flush_queued */
+};
+
+/** Bytes held in gather buffers across all files */
+static uint64_t wgather_bytes;
+
+/** Files with a delayed flush queued, so with a run most likely */
+static struct glist_head wgather_runs = GLIST_HEAD_INIT(wgather_runs);
+static pthread_mutex_t wgather_runs_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** A flush of every run is queued, for memory pressure */
+static uint32_t wgather_draining;
+
+/**
+ * @brief Get the gather state of a file, creating it if asked
+ */
+
+static struct cache_inode_wgather *wgather_get(cache_entry_t *entry,
+					       bool create)
+{
+	struct cache_inode_wgather *wg = entry->object.file.wgather;
+
+	if (wg != NULL || !create)
+		return wg;
+
+	wg = gsh_calloc(1, sizeof(*wg));
+	if (wg == NULL)
+		return NULL;
+
+	PTHREAD_MUTEX_init(&wg->mtx, NULL);
+
+	if (!atomic_cas_voidptr((void **)&entry->object.file.wgather,
+				NULL, wg)) {
+		/* Another writer got there first */
+		PTHREAD_MUTEX_destroy(&wg->mtx);
+		gsh_free(wg);
+		wg = entry->object.file.wgather;
+	}
+
+	return wg;
+}
+
+/**
+ * @brief Drop the buffer of a run
+ */
+
+static void wgather_drop(struct cache_inode_wgather *wg)
+{
+	if (wg->buf == NULL)
+		return;
+
+	(void)atomic_sub_uint64_t(&wgather_bytes, wg->size);
+	gsh_free(wg->buf);
+	wg->buf = NULL;
+	wg->size = 0;
+	wg->len = 0;
+}
+
+/**
+ * @brief Write out the current run
+ *
+ * The gather mutex and the content lock must be held.  The write is
+ * made with root credentials, in the caller's export or, from the
+ * delayed flush, in the export of the run.
+ *
+ * @param[in] entry  The file
+ * @param[in] wg     Its gather state
+ *
+ * @return The FSAL status of the write.
+ */
+
+static fsal_status_t wgather_flush_run(cache_entry_t *entry,
+				       struct cache_inode_wgather *wg)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct root_op_context root_op_context;
+	struct gsh_export *export;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	size_t done = 0, moved;
+	bool fsal_sync;
+
+	if (wg->len == 0)
+		return status;
+
+	if (!(obj_hdl->obj_ops.status(obj_hdl) & FSAL_O_WRITE)) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Entry %p has %zu gathered bytes and is not open for write",
+			entry, wg->len);
+		status = fsalstat(ERR_FSAL_NOT_OPENED, 0);
+		goto out;
+	}
+
+	export = op_ctx != NULL && op_ctx->export != NULL ? op_ctx->export
+							  : wg->export;
+	init_root_op_context(&root_op_context, export, export->fsal_export,
+			     0, 0, UNKNOWN_REQUEST);
+
+	while (done < wg->len) {
+		fsal_sync = false;
+		status = obj_hdl->obj_ops.write(obj_hdl, wg->offset + done,
+						wg->len - done, wg->buf + done,
+						&moved, &fsal_sync);
+		if (FSAL_IS_ERROR(status))
+			break;
+		if (moved == 0) {
+			status = fsalstat(ERR_FSAL_IO, 0);
+			break;
+		}
+		done += moved;
+	}
+
+	release_root_op_context();
+
+	LogFullDebug(COMPONENT_CACHE_INODE,
+		     "Flushed %zu of %zu gathered bytes at %" PRIu64
+		     " of entry %p, status %d",
+		     done, wg->len, wg->offset, entry, status.major);
+
+ out:
+	if (FSAL_IS_ERROR(status)) {
+		LogEvent(COMPONENT_CACHE_INODE,
+			 "Flush of %zu gathered bytes of entry %p failed with %s",
+			 wg->len, entry, msg_fsal_err(status.major));
+		wg->error = status;
+	}
+
+	wgather_drop(wg);
+
+	/* Our idea of size and times can go now */
+	atomic_clear_uint32_t_bits(&entry->flags, CACHE_INODE_TRUST_ATTRS);
+
+	return status;
+}
+
+/**
+ * @brief The delayed flush of a run
+ *
+ * @param[in] arg The file, with a reference held for us
+ */
+
+static void wgather_flush_delayed(void *arg)
+{
+	cache_entry_t *entry = arg;
+	struct cache_inode_wgather *wg = entry->object.file.wgather;
+	struct gsh_export *export;
+
+	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+	PTHREAD_MUTEX_lock(&wg->mtx);
+
+	(void)wgather_flush_run(entry, wg);
+
+	export = wg->export;
+	wg->export = NULL;
+	wg->flush_queued = false;
+
+	PTHREAD_MUTEX_lock(&wgather_runs_mtx);
+	glist_del(&wg->runs);
+	PTHREAD_MUTEX_unlock(&wgather_runs_mtx);
+
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+	put_gsh_export(export);
+	cache_inode_put(entry);
+}
+
+/**
+ * @brief Write out every run, as memory ran short
+ *
+ * Each file on wgather_runs is flushed in turn, with a reference of
+ * our own, then left for its delayed flush to drop.  Files that join
+ * the list meanwhile are new runs, which may wait for their time.
+ *
+ * @param[in] arg Unused
+ */
+
+static void wgather_flush_all(void *arg)
+{
+	struct cache_inode_wgather *wg;
+	cache_entry_t *entry;
+	size_t n;
+
+	PTHREAD_MUTEX_lock(&wgather_runs_mtx);
+	n = glist_length(&wgather_runs);
+	PTHREAD_MUTEX_unlock(&wgather_runs_mtx);
+
+	LogDebug(COMPONENT_CACHE_INODE,
+		 "Write_Gather_Max_Memory reached, flushing %zu files", n);
+
+	while (n-- > 0) {
+		PTHREAD_MUTEX_lock(&wgather_runs_mtx);
+		wg = glist_first_entry(&wgather_runs,
+				       struct cache_inode_wgather, runs);
+		entry = NULL;
+		if (wg != NULL) {
+			/* Its delayed flush holds a reference until the
+			   file leaves the list */
+			glist_del(&wg->runs);
+			glist_add_tail(&wgather_runs, &wg->runs);
+			if (cache_inode_lru_ref(wg->entry, LRU_FLAG_NONE) ==
+			    CACHE_INODE_SUCCESS)
+				entry = wg->entry;
+		}
+		PTHREAD_MUTEX_unlock(&wgather_runs_mtx);
+
+		if (wg == NULL)
+			break;
+		if (entry == NULL)
+			continue;
+
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		PTHREAD_MUTEX_lock(&wg->mtx);
+		(void)wgather_flush_run(entry, wg);
+		PTHREAD_MUTEX_unlock(&wg->mtx);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+		cache_inode_put(entry);
+	}
+
+	atomic_store_uint32_t(&wgather_draining, 0);
+}
+
+/**
+ * @brief Queue a flush of every run, unless one is queued
+ */
+
+static void wgather_pressure(void)
+{
+	if (atomic_postset_uint32_t_bits(&wgather_draining, 1) != 0)
+		return;
+
+	if (delayed_submit(wgather_flush_all, NULL, 0) != 0)
+		atomic_store_uint32_t(&wgather_draining, 0);
+}
+
+/**
+ * @brief Make sure a new run will be flushed in time
+ *
+ * The gather mutex must be held.  If no delayed flush can be queued
+ * the run is written at once.
+ */
+
+static void wgather_queue(cache_entry_t *entry,
+			  struct cache_inode_wgather *wg)
+{
+	if (wg->flush_queued)
+		return;
+
+	if (cache_inode_lru_ref(entry, LRU_FLAG_NONE) != CACHE_INODE_SUCCESS) {
+		(void)wgather_flush_run(entry, wg);
+		return;
+	}
+
+	get_gsh_export_ref(op_ctx->export);
+	wg->export = op_ctx->export;
+	wg->entry = entry;
+	wg->flush_queued = true;
+
+	PTHREAD_MUTEX_lock(&wgather_runs_mtx);
+	glist_add_tail(&wgather_runs, &wg->runs);
+	PTHREAD_MUTEX_unlock(&wgather_runs_mtx);
+
+	if (delayed_submit(wgather_flush_delayed, entry,
+			   (nsecs_elapsed_t) cache_param.write_gather.delay *
+			   NS_PER_MSEC) != 0) {
+		PTHREAD_MUTEX_lock(&wgather_runs_mtx);
+		glist_del(&wg->runs);
+		PTHREAD_MUTEX_unlock(&wgather_runs_mtx);
+		wg->flush_queued = false;
+		wg->export = NULL;
+		put_gsh_export(op_ctx->export);
+		cache_inode_put(entry);
+		(void)wgather_flush_run(entry, wg);
+	}
+}
+
+/**
+ * @brief Try to gather an UNSTABLE write
+ *
+ * The caller holds the content lock and has the file open for write.
+ * If this returns false, the caller must pass the write to the FSAL
+ * itself, after cache_inode_wgather_flush_range.  Flushes the write
+ * causes report their errors through the next COMMIT.
+ *
+ * @param[in]  entry       The file
+ * @param[in]  offset      Offset of the write
+ * @param[in]  io_size     Size of the write
+ * @param[in]  buffer      Data to write
+ * @param[out] bytes_moved Bytes gathered
+ *
+ * @return true if the write was gathered.
+ */
+
+bool cache_inode_wgather_write(cache_entry_t *entry, uint64_t offset,
+			       size_t io_size, void *buffer,
+			       size_t *bytes_moved)
+{
+	struct cache_inode_wgather *wg;
+	uint64_t end = offset + io_size;
+	size_t need, size;
+	char *buf;
+
+	if (!cache_param.write_gather.enabled || io_size == 0 ||
+	    io_size >= cache_param.write_gather.size || end < offset)
+		return false;
+
+	wg = wgather_get(entry, true);
+	if (wg == NULL)
+		return false;
+
+	PTHREAD_MUTEX_lock(&wg->mtx);
+
+	/* A write that does not continue the run ends it */
+	if (wg->len != 0 &&
+	    (offset < wg->offset || offset > wg->offset + wg->len ||
+	     end - wg->offset > cache_param.write_gather.size))
+		(void)wgather_flush_run(entry, wg);
+
+	if (wg->len == 0)
+		wg->offset = offset;
+
+	need = end - wg->offset;
+	if (need > wg->size) {
+		size = wg->size != 0 ? wg->size : WGATHER_MIN_BUF;
+		while (size < need)
+			size *= 2;
+		if (size > cache_param.write_gather.size)
+			size = cache_param.write_gather.size;
+
+		/* Under memory pressure, write through, and get the
+		   other runs out of memory */
+		if (atomic_add_uint64_t(&wgather_bytes, size - wg->size) >
+		    cache_param.write_gather.max_memory) {
+			(void)atomic_sub_uint64_t(&wgather_bytes,
+						  size - wg->size);
+			wgather_pressure();
+			goto write_through;
+		}
+
+		buf = gsh_realloc(wg->buf, size);
+		if (buf == NULL) {
+			(void)atomic_sub_uint64_t(&wgather_bytes,
+						  size - wg->size);
+			goto write_through;
+		}
+		wg->buf = buf;
+		wg->size = size;
+	}
+
+	memcpy(wg->buf + (offset - wg->offset), buffer, io_size);
+	if (need > wg->len)
+		wg->len = need;
+	*bytes_moved = io_size;
+
+	if (wg->len == cache_param.write_gather.size)
+		(void)wgather_flush_run(entry, wg);
+	else
+		wgather_queue(entry, wg);
+
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+	return true;
+
+ write_through:
+	(void)wgather_flush_run(entry, wg);
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+	return false;
+}
+
+/**
+ * @brief Flush the run of a file if it overlaps a range
+ *
+ * The caller holds the content lock.  Errors are also kept for the
+ * next COMMIT.
+ *
+ * @param[in] entry  The file
+ * @param[in] offset Start of the range
+ * @param[in] length Length of the range, 0 for everything
+ *
+ * @return The status of the flush.
+ */
+
+fsal_status_t cache_inode_wgather_flush_range(cache_entry_t *entry,
+					      uint64_t offset, size_t length)
+{
+	struct cache_inode_wgather *wg;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+	if (entry->type != REGULAR_FILE)
+		return status;
+
+	wg = wgather_get(entry, false);
+	if (wg == NULL)
+		return status;
+
+	PTHREAD_MUTEX_lock(&wg->mtx);
+	if (wg->len != 0 &&
+	    (length == 0 ||
+	     (offset < wg->offset + wg->len && offset + length > wg->offset)))
+		status = wgather_flush_run(entry, wg);
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+
+	return status;
+}
+
+/**
+ * @brief Flush a file for COMMIT
+ *
+ * Writes out the run and returns, once, the error of any flush that
+ * failed since the last COMMIT.  The caller holds the content lock.
+ *
+ * @param[in] entry The file
+ *
+ * @return The FSAL status.
+ */
+
+fsal_status_t cache_inode_wgather_commit(cache_entry_t *entry)
+{
+	struct cache_inode_wgather *wg = wgather_get(entry, false);
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+	if (wg == NULL)
+		return status;
+
+	PTHREAD_MUTEX_lock(&wg->mtx);
+	(void)wgather_flush_run(entry, wg);
+	status = wg->error;
+	wg->error = fsalstat(ERR_FSAL_NO_ERROR, 0);
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+
+	return status;
+}
+
+/**
+ * @brief Account for gathered data in the attributes of a file
+ *
+ * Called with the attribute lock held for write, after the attributes
+ * have been loaded from the FSAL, which has not seen the run yet.
+ *
+ * @param[in] entry The file
+ */
+
+void cache_inode_wgather_fixup_attrs(cache_entry_t *entry)
+{
+	struct cache_inode_wgather *wg = wgather_get(entry, false);
+	struct attrlist *attrs = entry->obj_handle->attrs;
+	uint64_t end;
+
+	if (wg == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&wg->mtx);
+	end = wg->len != 0 ? wg->offset + wg->len : 0;
+	PTHREAD_MUTEX_unlock(&wg->mtx);
+
+	if (end > attrs->filesize)
+		attrs->filesize = end;
+	if (end > attrs->spaceused)
+		attrs->spaceused = end;
+}
+
+/**
+ * @brief Free the gather state of a file being cleaned
+ *
+ * Every close flushes, so nothing should be left.
+ *
+ * @param[in] entry The file
+ */
+
+void cache_inode_wgather_release(cache_entry_t *entry)
+{
+	struct cache_inode_wgather *wg;
+
+	if (entry->type != REGULAR_FILE || entry->object.file.wgather == NULL)
+		return;
+
+	wg = entry->object.file.wgather;
+	entry->object.file.wgather = NULL;
+
+	if (wg->len != 0)
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Dropping %zu gathered bytes of entry %p",
+			wg->len, entry);
+
+	wgather_drop(wg);
+	PTHREAD_MUTEX_destroy(&wg->mtx);
+	gsh_free(wg);
+}
+
+/** @} */
@@ -145,4 +145,36 @@ fsal_status_t fsal_rename_access(struct fsal_obj_handle *old_dir_hdl,
 				 bool isdir);
 fsal_status_t fsal_mode_to_acl(struct attrlist *attrs, fsal_acl_t *sacl);
 fsal_status_t fsal_acl_to_mode(struct attrlist *attrs);
+
+/**
+ * @brief Group commit of one file
+ *
+ * Concurrent stable writes and COMMITs of a file share one fdatasync:
+ * whoever finds no sync running starts one, and everyone who arrived
+ * before it started is done when it returns.
+ */
+
+struct fsal_sync_group {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	uint64_t started;	/*< Syncs started */
+	uint64_t done;		/*< Syncs completed */
+	uint64_t failed;	/*< Number of the last sync that failed */
+	int error;		/*< Its errno */
+	bool running;
+};
+
+/** Counters of all sync groups */
+struct fsal_sync_stats {
+	uint64_t requests;	/*< Syncs asked for */
+	uint64_t syncs;		/*< Syncs made */
+	uint64_t writebacks;	/*< Ranges pushed while waiting */
+};
+
+extern struct fsal_sync_stats fsal_sync_stats;
+
+void fsal_sync_group_init(struct fsal_sync_group *sg);
+void fsal_sync_group_destroy(struct fsal_sync_group *sg);
+int fsal_sync_group_sync(struct fsal_sync_group *sg, int fd,
+			 uint64_t offset, uint64_t len);
 #endif				/* FSAL_COMMONLIB_H */
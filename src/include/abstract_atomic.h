@@ -66,12 +66,20 @@
  * uint64_t atomic_postclear_uint64_t_bits(uint64_t *var,
  * uint64_t atomic_postset_uint64_t_bits(uint64_t *var,
  *
+ * Exchange and compare-and-swap are provided for uint64_t and void*:
+ *
+ * uint64_t atomic_exchange_uint64_t(uint64_t *var, uint64_t val)
+ * void *atomic_exchange_voidptr(void **var, void *val)
+ * bool atomic_cas_uint64_t(uint64_t *var, uint64_t oldval, uint64_t newval)
+ * bool atomic_cas_voidptr(void **var, void *oldval, void *newval)
+ *
  */
 
 #ifndef _ABSTRACT_ATOMIC_H
 #define _ABSTRACT_ATOMIC_H
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 
 #undef GCC_SYNC_FUNCTIONS
@@ -2470,4 +2478,110 @@ static inline void atomic_store_uint8_t(uint8_t *var, uint8_t val)
 	(void)__sync_lock_test_and_set(var, val);
 }
 #endif
+
+/*
+ * Exchange and compare-and-swap
+ */
+
+/**
+ * @brief Atomically exchange a uint64_t
+ *
+ * This function atomically stores a new value and returns the value
+ * it replaced.
+ *
+ * @param[in,out] var Pointer to the variable to modify
+ * @param[in]     val The value to store
+ *
+ * @return The previous value of var.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline uint64_t atomic_exchange_uint64_t(uint64_t *var, uint64_t val)
+{
+	return __atomic_exchange_n(var, val, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline uint64_t atomic_exchange_uint64_t(uint64_t *var, uint64_t val)
+{
+	return __sync_lock_test_and_set(var, val);
+}
+#endif
+
+/**
+ * @brief Atomically exchange a void pointer
+ *
+ * This function atomically stores a new pointer and returns the
+ * pointer it replaced.
+ *
+ * @param[in,out] var Pointer to the pointer to modify
+ * @param[in]     val The pointer to store
+ *
+ * @return The previous value of var.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline void *atomic_exchange_voidptr(void **var, void *val)
+{
+	return __atomic_exchange_n(var, val, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline void *atomic_exchange_voidptr(void **var, void *val)
+{
+	return __sync_lock_test_and_set(var, val);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap a uint64_t
+ *
+ * This function stores newval in var if and only if var still holds
+ * oldval.
+ *
+ * @param[in,out] var    Pointer to the variable to modify
+ * @param[in]     oldval The value var is expected to hold
+ * @param[in]     newval The value to store
+ *
+ * @return true if the value was swapped.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t oldval,
+				       uint64_t newval)
+{
+	return __atomic_compare_exchange_n(var, &oldval, newval, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t oldval,
+				       uint64_t newval)
+{
+	return __sync_bool_compare_and_swap(var, oldval, newval);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap a void pointer
+ *
+ * This function stores newval in var if and only if var still holds
+ * oldval.
+ *
+ * @param[in,out] var    Pointer to the pointer to modify
+ * @param[in]     oldval The pointer var is expected to hold
+ * @param[in]     newval The pointer to store
+ *
+ * @return true if the pointer was swapped.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_voidptr(void **var, void *oldval, void *newval)
+{
+	return __atomic_compare_exchange_n(var, &oldval, newval, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_voidptr(void **var, void *oldval, void *newval)
+{
+	return __sync_bool_compare_and_swap(var, oldval, newval);
+}
+#endif
 #endif				/* !_ABSTRACT_ATOMIC_H */
@@ -152,6 +152,74 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Gathering of UNSTABLE writes (see cache_inode_wgather.c) */
+	struct {
+		/** Whether to gather.  Defaults to false, settable
+		    with Write_Gather. */
+		bool enabled;
+		/** Largest run gathered before it is written.  Defaults
+		    to 1MiB, settable with Write_Gather_Size. */
+		uint32_t size;
+		/** Milliseconds a run may wait before it is written.
+		    Defaults to 50, settable with Write_Gather_Delay. */
+		uint32_t delay;
+		/** Bytes all gather buffers may hold before writes go
+		    straight to the FSAL.  Defaults to 256MiB, settable
+		    with Write_Gather_Max_Memory. */
+		uint64_t max_memory;
+	} write_gather;
+	/** Sequential read-ahead (see cache_inode_readahead.c) */
+	struct {
+		/** Whether to read ahead.  Defaults to false, settable
+		    with Read_Ahead. */
+		bool enabled;
+		/** Size of a block read ahead.  Defaults to 1MiB,
+		    settable with Read_Ahead_Block_Size. */
+		uint32_t block_size;
+		/** Blocks read ahead of a sequential reader.  Defaults
+		    to 4, settable with Read_Ahead_Blocks. */
+		uint32_t blocks;
+		/** Bytes all blocks may hold.  Defaults to 256MiB,
+		    settable with Read_Ahead_Max_Memory. */
+		uint64_t max_memory;
+		/** Threads reading ahead.  Defaults to 8, settable with
+		    Read_Ahead_Threads. */
+		uint32_t threads;
+	} read_ahead;
+	/** Batching of FSAL upcalls (see fsal_up_batch.c) */
+	struct {
+		/** Whether to batch asynchronous invalidate and update
+		    upcalls.  Defaults to false, settable with
+		    Upcall_Batch. */
+		bool enabled;
+		/** Milliseconds a batch collects upcalls.  Defaults to
+		    10, settable with Upcall_Batch_Delay. */
+		uint32_t delay;
+		/** Objects in a batch before it is applied at once.
+		    Defaults to 1024, settable with Upcall_Batch_Size. */
+		uint32_t size;
+	} upcall_batch;
+	/** Warm restart (see cache_inode_warm.c) */
+	struct {
+		/** File the hottest entries are saved to and
+		    prefetched from at startup.  Unset by default, which
+		    disables warm restart, settable with
+		    Warm_Restart_File. */
+		char *file;
+		/** Seconds between saves.  Defaults to 300, settable
+		    with Warm_Restart_Interval. */
+		uint32_t interval;
+		/** Most entries saved.  Defaults to 50000, settable
+		    with Warm_Restart_Entries. */
+		uint32_t entries;
+		/** Entries prefetched per second, 0 for no limit.
+		    Defaults to 2000, settable with Warm_Restart_Rate. */
+		uint32_t rate;
+		/** Whether the contents of saved directories are
+		    prefetched too.  Defaults to true, settable with
+		    Warm_Restart_Readdir. */
+		bool readdir;
+	} warm;
 };
 
 /** @} */
@@ -207,10 +275,26 @@ struct cache_stats {
 	uint64_t inode_conf;
 	uint64_t inode_added;
 	uint64_t inode_mapping;
+	uint64_t inode_dirs;	/*< Directory states currently allocated */
+	uint64_t fh_hint_hit;	/*< Handles found by their cache hint */
+	uint64_t fh_hint_miss;	/*< Hinted handles not found by it */
+	uint64_t fh_hint_bad;	/*< Hints not matching the handle */
 };
 
 extern struct cache_stats *cache_stp;
 
+/**
+ * Read-ahead statistics.
+ */
+struct cache_ra_stats {
+	uint64_t hits;		/*< READs served from read-ahead */
+	uint64_t misses;	/*< READs that went to the FSAL */
+	uint64_t fills;		/*< Blocks read ahead */
+	uint64_t evicted;	/*< Blocks dropped for memory */
+};
+
+extern struct cache_ra_stats cache_ra_st;
+
 /**
  * Indicate whether this is a read or write operation, for
  * cache_inode_rdwr.
@@ -378,6 +462,25 @@ struct file_deleg_stats {
 	uint32_t fds_num_opens;         /* total num of opens so far. */
 	time_t fds_first_open;          /* time that we started recording
 					   num_opens */
+	/* Access history for the adaptive grant policy */
+	clientid4 fds_last_client;      /* client of the last open */
+	uint32_t fds_run;               /* opens in a row by last client */
+	uint32_t fds_rrun;              /* opens since the last write
+					   open */
+	uint32_t fds_avg_run;           /* decayed mean of fds_run, in
+					   1/16ths */
+	uint32_t fds_avg_rrun;          /* decayed mean of fds_rrun, in
+					   1/16ths */
+	uint32_t fds_switches;          /* opens by another client */
+	uint32_t fds_write_opens;       /* write opens after the first
+					   open */
+	uint32_t fds_avg_recall;        /* decayed mean recall latency,
+					   usec */
+	uint32_t fds_avg_gap;           /* decayed mean usec between opens
+					   while not delegated */
+	uint32_t fds_seen_grants;       /* fds_delegation_count at the last
+					   open */
+	nsecs_elapsed_t fds_last_open;  /* time of the last open */
 };
 
 /**
@@ -439,22 +542,32 @@ struct file_deleg_stats {
  */
 
 struct cache_entry_t {
-	/** Reader-writer lock for attributes */
-	pthread_rwlock_t attr_lock;
+	/* The fields up to and including lru are touched on every lookup,
+	   reference and release; they are kept together so that the common
+	   paths stay within the entry's first cache line.  Locks, lists and
+	   type-specific data follow. */
 	/** The FSAL Handle */
 	struct fsal_obj_handle *obj_handle;
+	/** The type of the entry */
+	object_file_type_t type;
+	/** Flags for this entry */
+	uint32_t flags;
+	/** Atomic pointer to the first mapped export for fast path */
+	void *first_export;
+	/** New style LRU link */
+	cache_inode_lru_t lru;
 	/** FH hash linkage */
 	struct {
 		struct avltree_node node_k;	/*< AVL node in tree */
 		cache_inode_key_t key;	/*< Key of this entry */
 		bool inavl;
 	} fh_hk;
-	/** The type of the entry */
-	object_file_type_t type;
-	/** Flags for this entry */
-	uint32_t flags;
 	/** refcount for number of active icreate */
 	int32_t icreate_refcnt;
+	/** There is one export root reference counted for each export
+	    for which this entry is a root for. This field is used
+	    with the atomic inc/dec/fetch routines. */
+	int32_t exp_root_refcount;
 	/** The time of the last operation ganesha knows about.  We
 	    can ue this for change_info4, but atomic MUST be set to
 	    false.  Don't use it for anything else (servicing getattr,
@@ -462,12 +575,8 @@ struct cache_entry_t {
 	time_t change_time;
 	/** Time at which we last refreshed attributes. */
 	time_t attr_time;
-	/** New style LRU link */
-	cache_inode_lru_t lru;
-	/** There is one export root reference counted for each export
-	    for which this entry is a root for. This field is used
-	    with the atomic inc/dec/fetch routines. */
-	int32_t exp_root_refcount;
+	/** Reader-writer lock for attributes */
+	pthread_rwlock_t attr_lock;
 	/** This is separated out from the content lock, since there
 	    are state oerations that don't affect anything guarded by
 	    content (for example, a layout return or request has no
@@ -475,17 +584,15 @@ struct cache_entry_t {
 	    be released and reacquired several times in an operation
 	    that should not see changes in state. */
 	pthread_rwlock_t state_lock;
+	/** Lock on type-specific cached content.  See locking
+	    discipline for details. */
+	pthread_rwlock_t content_lock;
 	/** States on this cache entry */
 	struct glist_head list_of_states;
 	/** Exports per entry (protected by attr_lock) */
 	struct glist_head export_list;
-	/** Atomic pointer to the first mapped export for fast path */
-	void *first_export;
 	/** Layout recalls on this entry */
 	struct glist_head layoutrecall_list;
-	/** Lock on type-specific cached content.  See locking
-	    discipline for details. */
-	pthread_rwlock_t content_lock;
 	/** Filetype specific data, discriminated by the type field.
 	    Note that data for special files is in
 	    attributes.rawdev */
@@ -504,31 +611,50 @@ struct cache_entry_t {
 					      * happening at the moment which
 					      * prevents delegations from being
 					      * granted */
+			/** Gathered UNSTABLE writes, allocated on the
+			    first one */
+			struct cache_inode_wgather *wgather;
+			/** Sequential read-ahead, allocated on the first
+			    read with Read_Ahead set */
+			struct cache_inode_readahead *readahead;
 		} file;		/*< REGULAR_FILE data */
 
-		struct {
-			/** Number of known active children */
-			uint32_t nbactive;
-			/** The parent of this directory ('..') */
-			cache_inode_key_t parent;
-			struct {
-				/** Children */
-				struct avltree t;
-				/** Persist cookies */
-				struct avltree c;
-				/** Heuristic. Expect 0. */
-				uint32_t collisions;
-			} avl;
-			/** If this is a junction, the export this node points
-			    to. Protected by the attr_lock. */
-			struct gsh_export *junction_export;
-			/** List of exports that have this cache inode
-			    as their root. Protected by the attr_lock. */
-			struct glist_head export_roots;
-		} dir;		/*< DIRECTORY data */
+		/** DIRECTORY data, allocated from cache_inode_dir_pool
+		    when the entry is created as a directory and released
+		    when the entry is cleaned. */
+		struct cache_inode_dir *dir;
 	} object;
 };
 
+/**
+ * @brief Directory specific part of a cache entry
+ *
+ * The dirent trees dominate the size of a directory entry, so they
+ * are kept out of line rather than widening the union every cache
+ * entry carries.
+ */
+
+struct cache_inode_dir {
+	/** Number of known active children */
+	uint32_t nbactive;
+	/** The parent of this directory ('..') */
+	cache_inode_key_t parent;
+	struct {
+		/** Children */
+		struct avltree t;
+		/** Persist cookies */
+		struct avltree c;
+		/** Heuristic. Expect 0. */
+		uint32_t collisions;
+	} avl;
+	/** If this is a junction, the export this node points
+	    to. Protected by the attr_lock. */
+	struct gsh_export *junction_export;
+	/** List of exports that have this cache inode
+	    as their root. Protected by the attr_lock. */
+	struct glist_head export_roots;
+};
+
 /**
  * @brief Represents one of the many-many links between inodes and exports.
  *
@@ -560,6 +686,8 @@ typedef struct cache_inode_fsal_data {
 
 /** Cache entries pool */
 extern pool_t *cache_inode_entry_pool;
+/** Directory state pool */
+extern pool_t *cache_inode_dir_pool;
 
 /**
  * Type-specific data passed to cache_inode_new_entry
@@ -671,6 +799,9 @@ bool check_mapping(cache_entry_t *entry,
 void clean_mapping(cache_entry_t *entry);
 cache_inode_status_t cache_inode_get(cache_inode_fsal_data_t *fsdata,
 				     cache_entry_t **entry);
+cache_inode_status_t cache_inode_get_hinted(cache_inode_fsal_data_t *fsdata,
+					    uint64_t hint,
+					    cache_entry_t **entry);
 cache_entry_t *cache_inode_get_keyed(cache_inode_key_t *key,
 				     uint32_t flags,
 				     cache_inode_status_t *status);
@@ -738,6 +869,27 @@ cache_inode_status_t cache_inode_open(cache_entry_t *entry,
 				      fsal_openflags_t openflags,
 				      uint32_t flags);
 cache_inode_status_t cache_inode_close(cache_entry_t *entry, uint32_t flags);
+
+bool cache_inode_wgather_write(cache_entry_t *entry, uint64_t offset,
+			       size_t io_size, void *buffer,
+			       size_t *bytes_moved);
+fsal_status_t cache_inode_wgather_flush_range(cache_entry_t *entry,
+					      uint64_t offset, size_t length);
+fsal_status_t cache_inode_wgather_commit(cache_entry_t *entry);
+void cache_inode_wgather_fixup_attrs(cache_entry_t *entry);
+void cache_inode_wgather_release(cache_entry_t *entry);
+
+bool cache_inode_readahead_read(cache_entry_t *entry, uint64_t offset,
+				size_t io_size, void *buffer,
+				size_t *bytes_moved, bool *eof);
+void cache_inode_readahead_invalidate(cache_entry_t *entry, uint64_t offset,
+				      uint64_t length);
+void cache_inode_readahead_release(cache_entry_t *entry);
+int cache_inode_readahead_pkginit(void);
+int cache_inode_readahead_pkgshutdown(void);
+void cache_inode_warm_save(void);
+int cache_inode_warm_pkginit(void);
+int cache_inode_warm_pkgshutdown(void);
 void cache_inode_adjust_openflags(cache_entry_t *entry);
 
 cache_inode_status_t cache_inode_create(cache_entry_t *entry_parent,
@@ -856,6 +1008,7 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(
 
 void cache_inode_release_dirents(cache_entry_t *entry,
 				 cache_inode_avl_which_t which);
+void cache_inode_release_dir_state(cache_entry_t *entry);
 
 void cache_inode_kill_entry(cache_entry_t *entry);
 
@@ -980,6 +1133,11 @@ cache_inode_refresh_attrs(cache_entry_t *entry)
 		goto out;
 	}
 
+	/* The FSAL has not seen gathered writes yet */
+	if (entry->type == REGULAR_FILE &&
+	    entry->object.file.wgather != NULL)
+		cache_inode_wgather_fixup_attrs(entry);
+
 	cache_inode_fixup_md(entry);
 
  out:
@@ -208,6 +208,19 @@ cih_fhcache_inline_lookup(const struct avltree *tree,
 #define CIH_HASH_NONE           0x0000
 #define CIH_HASH_KEY_PROTOTYPE  0x0001
 
+/**
+ * @brief Hash a cache key
+ *
+ * @param fh_desc [in] Key bytes, as from handle_to_key or extract_handle
+ *
+ * @return The hash the entry of that key is stored under.
+ */
+static inline uint64_t
+cih_hash_fh(const struct gsh_buffdesc *fh_desc)
+{
+	return CityHash64WithSeed(fh_desc->addr, fh_desc->len, 557);
+}
+
 /**
  * @brief Convenience function to compute hash for cache_entry_t
  *
@@ -240,8 +253,7 @@ cih_hash_key(cache_inode_key_t *key,
 	}
 
 	/* hash it */
-	key->hk =
-	    CityHash64WithSeed(fh_desc->addr, fh_desc->len, 557);
+	key->hk = cih_hash_fh(fh_desc);
 
 	return true;
 }
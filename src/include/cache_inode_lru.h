@@ -156,6 +156,10 @@ void cache_inode_unpinnable(cache_entry_t *entry);
 void cache_inode_dec_pin_ref(cache_entry_t *entry, bool closefile);
 bool cache_inode_is_pinned(cache_entry_t *entry);
 void cache_inode_lru_kill_for_shutdown(cache_entry_t *entry);
+void cache_inode_lru_foreach_hot(uint32_t lane, uint32_t max,
+				 bool (*cb)(cache_entry_t *entry,
+					    uint32_t rank, void *state),
+				 void *state);
 
 /**
  *
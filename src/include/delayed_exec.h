@@ -37,6 +37,11 @@
  * would make the internal logic rather snarly and the initialization
  * parameters even more recondite.
  *
+ * A task submitted with delayed_submit_timer can be cancelled until
+ * it starts to run.  Tasks run no earlier than asked and at most a
+ * couple of milliseconds late, on one of Delayed_Exec_Threads
+ * threads, in no particular order.
+ *
  * @{
  */
 
@@ -53,9 +58,41 @@
 #include <stdbool.h>
 #include "gsh_types.h"
 
+struct delayed_task;
+
+/**
+ * @brief A submitted task, to cancel it
+ *
+ * All zero is no task.  It stays safe to cancel after the task ran.
+ */
+
+struct delayed_timer {
+	struct delayed_task *task;
+	uint64_t seq;
+};
+
+/**
+ * @brief Counters of the delayed executor, over all its threads
+ */
+
+struct delayed_stats {
+	uint64_t submitted;	/*< Tasks submitted */
+	uint64_t cancelled;	/*< Tasks cancelled before running */
+	uint64_t run;		/*< Tasks run */
+	uint64_t batches;	/*< Batches taken off the run queues */
+	uint64_t stolen;	/*< Tasks run by another thread than theirs */
+	uint64_t pending;	/*< Tasks waiting for their time */
+	uint64_t queued;	/*< Tasks due, waiting for a thread */
+	uint64_t max_queued;	/*< Most tasks ever due on one thread */
+};
+
 void delayed_start(void);
 void delayed_shutdown(void);
 int delayed_submit(void (*)(void *), void *, nsecs_elapsed_t);
+int delayed_submit_timer(void (*)(void *), void *, nsecs_elapsed_t,
+			 struct delayed_timer *);
+bool delayed_cancel(struct delayed_timer *, void **);
+void delayed_get_stats(struct delayed_stats *);
 
 #endif				/* DELAYED_EXEC_H */
 
@@ -57,6 +57,10 @@ struct gsh_export {
 	struct glist_head exp_list;
 	/** gsh_exports are kept in an AVL tree by export_id */
 	struct avltree_node node_k;
+	/** Exports with the same full path, in the trie by path */
+	struct glist_head exp_path_list;
+	/** Exports with the same pseudo path, in the trie by pseudo path */
+	struct glist_head exp_pseudo_list;
 	/** The list of cache inode entries belonging to this export */
 	struct glist_head entry_list;
 	/** List of NFS v4 state belonging to this export */
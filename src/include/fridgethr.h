@@ -49,8 +49,8 @@
 
 struct fridgethr;
 
-/*< Decoder thread pool */
-extern struct fridgethr *req_fridge;
+/*< Decoder thread pools, one per NUMA node */
+extern struct fridgethr *req_fridge[];
 
 /**
  * @brief Per-worker data.  Some of this will be destroyed.
@@ -59,6 +59,7 @@ extern struct fridgethr *req_fridge;
 typedef struct nfs_worker_data {
 	wait_q_entry_t wqe;	/*< Queue for coordinating with decoder */
 	unsigned int worker_index;	/*< Index for log messages */
+	uint32_t node;		/*< NUMA node of the worker's pool */
 } nfs_worker_data_t;
 
 /**
@@ -179,6 +180,12 @@ struct fridgethr_params {
 	void (*wake_threads)(void *);
 	/* Argument for wake_threads */
 	void *wake_threads_arg;
+	/**
+	 * Bind threads to NUMA node numa_node before they are
+	 * initialized, see gsh_numa_bind.
+	 */
+	bool numa_bind;
+	uint32_t numa_node;
 };
 
 /**
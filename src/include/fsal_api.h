@@ -318,7 +318,7 @@ struct fsal_up_vector;		/* From fsal_up.h */
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 2
 
 /* Forward references for object methods */
 
@@ -615,6 +615,63 @@ struct fsal_ops {
  */
 	 void (*fsal_pnfs_ds_ops)(struct fsal_pnfs_ds_ops *ops);
 
+/**
+ * @brief Take note of an error a client got from a pNFS device
+ *
+ * Called for each device_error4 of a LAYOUTERROR and of the ioerr
+ * reports the FSAL decodes from a layoutreturn body.
+ *
+ * @param[in] fsal_hdl FSAL module
+ * @param[in] type     The type of layout that specified the device
+ * @param[in] deviceid The device that failed
+ * @param[in] status   The error the client got
+ * @param[in] opnum    The operation that failed
+ *
+ * @return Valid error codes in RFC 7862, p. 69.
+ */
+	 nfsstat4(*layouterror)(struct fsal_module *fsal_hdl,
+				const layouttype4 type,
+				const struct pnfs_deviceid *deviceid,
+				nfsstat4 status, nfs_opnum4 opnum);
+
+/**
+ * @brief Take note of the I/O a client did to a pNFS device
+ *
+ * @param[in] fsal_hdl FSAL module
+ * @param[in] type     The type of layout that specified the device
+ * @param[in] deviceid The device used
+ * @param[in] read     Reads done
+ * @param[in] write    Writes done
+ * @param[in] lou_body Layout type-specific update, or NULL
+ *
+ * @return Valid error codes in RFC 7862, p. 70.
+ */
+	 nfsstat4(*layoutstats)(struct fsal_module *fsal_hdl,
+				const layouttype4 type,
+				const struct pnfs_deviceid *deviceid,
+				const io_info4 *read, const io_info4 *write,
+				XDR *lou_body);
+
+/**
+ * @brief Append the FSAL's statistics to a DBus reply
+ *
+ * With iter NULL nothing is appended; the FSAL only tells whether it
+ * keeps statistics at all.
+ *
+ * @param[in] fsal_hdl FSAL module
+ * @param[in] iter     DBusMessageIter to append to, or NULL
+ *
+ * @return true if the FSAL keeps statistics.
+ */
+	 bool (*fsal_extract_stats)(struct fsal_module *fsal_hdl, void *iter);
+
+/**
+ * @brief Zero the FSAL's statistics
+ *
+ * @param[in] fsal_hdl FSAL module
+ */
+	 void (*fsal_reset_stats)(struct fsal_module *fsal_hdl);
+
 /**@}*/
 };
 
@@ -314,6 +314,27 @@ cache_inode_status_t fsal_invalidate(struct fsal_module *fsal,
 				     struct gsh_buffdesc *handle,
 				     uint32_t flags);
 
+/**
+ * @brief Counters of upcall batching
+ */
+struct fsal_up_batch_stats {
+	uint64_t queued;	/*< Upcalls batched */
+	uint64_t coalesced;	/*< Upcalls merged into a pending one */
+	uint64_t batches;	/*< Batches applied */
+	uint64_t depth;		/*< Objects waiting in batches */
+	uint64_t max_depth;	/*< Most objects ever waiting */
+};
+
+extern struct fsal_up_batch_stats fsal_up_batch_st;
+
+int up_batch_event(struct fsal_module *fsal, struct gsh_buffdesc *obj,
+		   uint32_t inval, struct attrlist *attr, uint32_t upflags);
+cache_inode_status_t up_update_check(struct attrlist *attr, uint32_t flags);
+cache_inode_status_t up_apply_batched(struct fsal_module *fsal,
+				      struct gsh_buffdesc *obj,
+				      uint32_t inval, struct attrlist *attr,
+				      uint32_t flags);
+
 cache_inode_status_t up_get(struct fsal_module *fsal,
 			    struct gsh_buffdesc *handle,
 			    cache_entry_t **entry);
@@ -157,6 +157,21 @@ typedef enum protos {
  */
 #define NFS_DEFAULT_RECV_BUFFER_SIZE 1048576
 
+/**
+ * Default value for core_param.rpc.udp_batch
+ */
+#define RPC_DEFAULT_UDP_BATCH 16
+
+/**
+ * Upper bound of core_param.rpc.udp_sockets
+ */
+#define RPC_MAX_UDP_SOCKETS 16
+
+/**
+ * Upper bound of core_param.rpc.tcp_evchans
+ */
+#define RPC_MAX_TCP_EVENT_CHAN 64
+
 /**
  * @brief Support NFSv3
  */
@@ -318,6 +333,31 @@ typedef struct nfs_core_param {
 		/** TIRPC ioq max simultaneous io threads.  Defaults to
 		    200 and settable by RPC_Ioq_ThrdMax. */
 		uint32_t ioq_thrd_max;
+		/** Datagrams received or sent per system call on UDP
+		    transports, 1 disables batching.  Defaults to
+		    RPC_DEFAULT_UDP_BATCH and settable by RPC_UDP_Batch. */
+		uint32_t udp_batch;
+		/** UDP sockets per service, bound to the same port with
+		    SO_REUSEPORT, each served by its own event channel.
+		    Defaults to 1 and settable by RPC_UDP_Sockets. */
+		uint32_t udp_sockets;
+		/** Event channels serving TCP connections, 0 to derive
+		    it from the number of CPUs.  Defaults to 0 and
+		    settable by RPC_TCP_Event_Channels. */
+		uint32_t tcp_evchans;
+		/** Give every TCP event channel a listening socket of
+		    its own on each service port, with SO_REUSEPORT, so
+		    that connections are accepted where they are served.
+		    Defaults to false and settable by
+		    RPC_TCP_Channel_Listeners. */
+		bool tcp_chan_listeners;
+		/** Pin event channel threads to CPUs.  Defaults to false
+		    and settable by RPC_Event_Channel_Affinity. */
+		bool evchan_affinity;
+		/** Move TCP connections from busy event channels to idle
+		    ones.  Defaults to false and settable by
+		    RPC_TCP_Rebalance. */
+		bool tcp_rebalance;
 	} rpc;
 	/** How long (in seconds) to let unused decoder threads wait before
 	    exiting.  Settable with Decoder_Fridge_Expiration_Delay. */
@@ -346,11 +386,37 @@ typedef struct nfs_core_param {
 	bool enable_RQUOTA;
 	/** Whether to use fast stats.  Defaults to false. */
 	bool enable_FASTSTATS;
+	/** Whether to keep per operation latency histograms for
+	    percentile reporting.  Defaults to false and is settable
+	    with Enable_Latency_Histograms. */
+	bool enable_latency_hist;
+	/** Number of shards for global and per export statistics,
+	    0 meaning one per online CPU.  Settable with
+	    Stats_Shards. */
+	uint32_t stats_shards;
 	/** Whether to use short NFS file handle to accommodate VMware
 	    NFS client. Enable this if you have a VMware NFSv3 client.
 	    VMware NFSv3 client has a max limit of 56 byte file handles!
 	    Defaults to false. */
 	bool short_file_handle;
+	/** Whether to append the cache hash key of the object to the
+	    file handles the server hands out, so that PUTFH and NFSv3
+	    handle decoding find a cached entry without hashing the
+	    handle.  Handles without it are still accepted.  Defaults
+	    to false and is settable with File_Handle_Hints. */
+	bool fh_hints;
+	/** Number of threads that look up and cache the export roots
+	    at startup.  Defaults to 4 and is settable with
+	    Export_Init_Threads. */
+	uint32_t export_init_threads;
+	/** Number of threads of the delayed executor, each with its
+	    own timer wheel.  Defaults to 4 and is settable with
+	    Delayed_Exec_Threads. */
+	uint32_t delayed_exec_threads;
+	/** Split event channels, decoders and Nb_Worker workers into
+	    a pool per NUMA node, bound to its CPUs and memory.
+	    Defaults to false and is settable with NUMA_Worker_Pools. */
+	bool numa_pools;
 	/** How long the server will trust information it got by
 	    calling getgroups() when "Manage_Gids = TRUE" is
 	    used in a export entry. */
@@ -395,6 +461,16 @@ typedef struct nfs_core_param {
  */
 #define DELEG_RECALL_RETRY_DELAY_DEFAULT 1
 
+/**
+ * @brief Default value of deleg_open_cost, in microseconds.
+ */
+#define DELEG_OPEN_COST_DEFAULT 500
+
+/**
+ * @brief Default value of deleg_recall_cost, in microseconds.
+ */
+#define DELEG_RECALL_COST_DEFAULT 10000
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -431,10 +507,26 @@ typedef struct nfs_version4_parameter {
 	bool allow_delegations;
 	/** Delay after which server will retry a recall in case of failures */
 	uint32_t deleg_recall_retry_delay;
+	/** Whether to grant delegations from the access history of
+	    each file.  Defaults to false and settable with
+	    Adaptive_Delegations. */
+	bool adaptive_delegations;
+	/** What an OPEN a delegation saves costs, in microseconds.
+	    Defaults to DELEG_OPEN_COST_DEFAULT and settable with
+	    Deleg_Open_Cost. */
+	uint32_t deleg_open_cost;
+	/** Cost of a recall until one has been measured, in
+	    microseconds.  Defaults to DELEG_RECALL_COST_DEFAULT and
+	    settable with Deleg_Recall_Cost. */
+	uint32_t deleg_recall_cost;
 	/** Whether this a pNFS MDS server. Defaults to false */
 	bool pnfs_mds;
 	/** Whether this a pNFS DS server. Defaults to false */
 	bool pnfs_ds;
+	/** Whether common attribute bitmaps use the precompiled
+	    encoders.  Defaults to true and settable with
+	    Fast_Fattr_Encode. */
+	bool fast_fattr_encode;
 } nfs_version4_parameter_t;
 
 /** @} */
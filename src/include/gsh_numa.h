@@ -0,0 +1,69 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @defgroup numa NUMA placement of service threads
+ * @{
+ */
+
+/**
+ * @file gsh_numa.h
+ * @brief NUMA nodes and binding threads to them
+ *
+ * With NUMA_Worker_Pools the event channels, decoders and workers are
+ * split into one pool per NUMA node the process may run on.  A thread
+ * bound to a node runs only on its CPUs and allocates memory from it
+ * first.  Nodes are numbered densely from 0, skipping those without a
+ * CPU the process may use; without NUMA_Worker_Pools, or on a machine
+ * with a single node, there is one node and nothing is bound.
+ */
+
+#ifndef GSH_NUMA_H
+#define GSH_NUMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Most NUMA nodes pools are made for, the others share them */
+#define GSH_NUMA_MAX_NODES 64
+
+/** Node of the calling thread, 0 if it is not bound */
+extern __thread uint32_t gsh_numa_this_node;
+
+void gsh_numa_init(bool pools);
+uint32_t gsh_numa_nodes(void);
+void gsh_numa_bind(uint32_t node);
+uint32_t gsh_numa_share(uint32_t total, uint32_t node);
+
+/**
+ * @brief Node the calling thread is bound to
+ *
+ * @return The node, 0 for threads that are not bound.
+ */
+
+static inline uint32_t gsh_numa_node(void)
+{
+	return gsh_numa_this_node;
+}
+
+#endif				/* GSH_NUMA_H */
+
+/** @} */
@@ -52,6 +52,7 @@
 #define NFS_LOOKAHEAD_LOOKUP 0x0400
 #define NFS_LOOKAHEAD_READLINK 0x0800
 /* ... */
+#define NFS_LOOKAHEAD_DEFERRED 0x8000 /* args left wrapped, see below */
 
 struct nfs_request_lookahead {
 	uint32_t flags;
@@ -64,7 +65,8 @@ struct nfs_request_lookahead {
 			  NFS_LOOKAHEAD_WRITE |		\
 			  NFS_LOOKAHEAD_COMMIT |	\
 			  NFS_LOOKAHEAD_LAYOUTCOMMIT |	\
-			  NFS_LOOKAHEAD_READDIR)))
+			  NFS_LOOKAHEAD_READDIR |	\
+			  NFS_LOOKAHEAD_DEFERRED)))
 
 
 #define XDR_ARRAY_MAXLEN 1024
@@ -130,6 +132,11 @@ typedef struct nfs_krb5_param {
 	    Kerberos support is compiled in) and settable with
 	    Active_krb5 */
 	bool active_krb5;
+	/** RPCSEC_GSS integrity and privacy bodies of at least this
+	    many bytes are unwrapped by the worker rather than the
+	    decoder thread, 0 to never defer.  Settable with
+	    Unwrap_Offload_Size. */
+	uint32_t unwrap_offload_size;
 } nfs_krb5_parameter_t;
 /** @} */
 /** @} */
@@ -155,6 +162,7 @@ typedef struct gsh_xprt_private {
 	SVCXPRT *xprt;
 	struct glist_head stallq;
 	uint16_t flags;
+	uint16_t evchan;	/* dispatcher event channel index */
 } gsh_xprt_private_t;
 
 static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
@@ -164,6 +172,7 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 
 	xu->xprt = xprt;
 	xu->flags = flags;
+	xu->evchan = 0;
 
 	return xu;
 }
@@ -0,0 +1,138 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @defgroup Server statistics management
+ * @{
+ */
+
+/**
+ * @file latency_histogram.h
+ * @brief Log-linear latency histograms
+ *
+ * Latencies (in nanoseconds) are counted in HDR style buckets: values
+ * below LAT_HIST_SUB_BUCKETS have a bucket each, above that every
+ * power of two is split into LAT_HIST_SUB_BUCKETS linear buckets, so
+ * the value reported for a bucket is within 1/LAT_HIST_SUB_BUCKETS of
+ * any value counted in it.  Values of 2^(LAT_HIST_MAX_BIT + 1)
+ * nanoseconds (about eighteen minutes) and more are counted apart, in
+ * the LAT_HIST_OVERFLOW bucket after the last real one.
+ *
+ * Recording is a single atomic increment.  A sharded histogram gives
+ * each thread its own shard so that concurrent recorders do not share
+ * cache lines; readers sum the shards.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "abstract_atomic.h"
+
+#define LAT_HIST_SUB_BITS 3
+#define LAT_HIST_SUB_BUCKETS (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_BIT 39
+#define LAT_HIST_OVERFLOW \
+	((LAT_HIST_MAX_BIT - LAT_HIST_SUB_BITS + 2) * LAT_HIST_SUB_BUCKETS)
+#define LAT_HIST_BUCKETS (LAT_HIST_OVERFLOW + 1)
+
+/** Upper bound on the number of shards of a sharded histogram */
+#define LAT_HIST_MAX_SHARDS 64
+
+struct lat_histogram {
+	uint64_t bucket[LAT_HIST_BUCKETS];
+};
+
+struct lat_hist_shards {
+	uint32_t nshards;
+	struct lat_histogram *shard;	/*< nshards histograms */
+};
+
+/**
+ * @brief Map a value to its bucket
+ *
+ * @param[in] val Value in nanoseconds
+ *
+ * @return Index into lat_histogram::bucket.
+ */
+
+static inline unsigned int lat_hist_index(uint64_t val)
+{
+	unsigned int msb;
+
+	if (val < LAT_HIST_SUB_BUCKETS)
+		return val;
+
+	msb = 63 - __builtin_clzll(val);
+	if (msb > LAT_HIST_MAX_BIT)
+		return LAT_HIST_OVERFLOW;
+
+	return (msb - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB_BUCKETS +
+	    ((val >> (msb - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief Count a value in a histogram
+ *
+ * @param[in] hist Histogram to update
+ * @param[in] val  Value in nanoseconds
+ */
+
+static inline void lat_hist_record(struct lat_histogram *hist, uint64_t val)
+{
+	(void)atomic_inc_uint64_t(&hist->bucket[lat_hist_index(val)]);
+}
+
+uint64_t lat_hist_bucket_value(unsigned int idx);
+uint64_t lat_hist_count(const struct lat_histogram *hist);
+uint64_t lat_hist_max(const struct lat_histogram *hist);
+uint64_t lat_hist_percentile(const struct lat_histogram *hist,
+			     uint64_t count, double pct);
+void lat_hist_add(struct lat_histogram *sum,
+		  const struct lat_histogram *hist);
+void lat_hist_delta(struct lat_histogram *delta,
+		    const struct lat_histogram *now,
+		    const struct lat_histogram *then);
+
+bool lat_hist_shards_init(struct lat_hist_shards *hs, uint32_t nshards);
+void lat_hist_shards_destroy(struct lat_hist_shards *hs);
+uint32_t lat_hist_thread_shard(void);
+void lat_hist_shards_sum(struct lat_hist_shards *hs,
+			 struct lat_histogram *sum);
+
+/**
+ * @brief Count a value in the calling thread's shard
+ *
+ * @param[in] hs  Sharded histogram
+ * @param[in] val Value in nanoseconds
+ */
+
+static inline void lat_hist_shards_record(struct lat_hist_shards *hs,
+					  uint64_t val)
+{
+	lat_hist_record(&hs->shard[lat_hist_thread_shard() % hs->nshards],
+			val);
+}
+
+#endif				/* LATENCY_HISTOGRAM_H */
+
+/** @} */
@@ -154,6 +154,16 @@ void _9p_rdma_cleanup_conn(msk_trans_t *trans);
 
 /* in nfs_rpc_dispatcher_thread.c */
 
+/**
+ * @brief Requests of a NUMA node
+ */
+struct nfs_node_stats {
+	uint64_t enqueued;	/*< Queued on the node */
+	uint64_t local;		/*< Taken by workers of the node */
+	uint64_t remote;	/*< Handed off to workers of another node */
+	uint64_t queued;	/*< Waiting now */
+};
+
 void Clean_RPC(void);
 void nfs_Init_svc(void);
 void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr);
@@ -163,6 +173,7 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker);
 void nfs_rpc_enqueue_req(request_data_t *req);
 uint32_t get_dequeue_count(void);
 uint32_t get_enqueue_count(void);
+void nfs_rpc_node_stats(uint32_t node, struct nfs_node_stats *st);
 
 /* in nfs_worker_thread.c */
 
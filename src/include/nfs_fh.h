@@ -45,6 +45,7 @@
 
 #define GANESHA_FH_VERSION 0x43
 #define FILE_HANDLE_V4_FLAG_DS	0x01 /*< handle for a DS */
+#define FH_CACHE_HINT		0x02 /*< cache hash key follows fsopaque */
 #define FH_FSAL_BIG_ENDIAN	0x40 /*< FSAL FH is big endian */
 
 /**
@@ -41,6 +41,29 @@
 #include "export_mgr.h"
 #include "nfs_fh.h"
 
+/** Size of the cache hint following fsopaque, see FH_CACHE_HINT */
+#define FH_HINT_SIZE sizeof(uint64_t)
+
+/**
+ * @brief Get the cache hint of a handle
+ *
+ * The hint is the hash of the cache key, in the byte order of the
+ * server that made the handle.  It is not aligned.
+ *
+ * @param[in] fsopaque The handle opaque
+ * @param[in] fs_len   Its length
+ *
+ * @return The hint.
+ */
+
+static inline uint64_t nfs_fh_hint(const uint8_t *fsopaque, uint8_t fs_len)
+{
+	uint64_t hint;
+
+	memcpy(&hint, fsopaque + fs_len, sizeof(hint));
+	return hint;
+}
+
 /**
  * @brief Get the actual size of a v3 handle based on the sized fsopaque
  *
@@ -53,6 +76,8 @@ static inline size_t nfs3_sizeof_handle(struct file_handle_v3 *hdl)
 	int hsize = 0;
 
 	hsize = offsetof(struct file_handle_v3, fsopaque) + hdl->fs_len;
+	if (hdl->fhflags1 & FH_CACHE_HINT)
+		hsize += FH_HINT_SIZE;
 
 	/* correct packet's fh length so it's divisible by 4 to trick dNFS into
 	   working. This is essentially sending the padding. */
@@ -74,7 +99,12 @@ int nfs4_AllocateFH(nfs_fh4 *);
 
 static inline size_t nfs4_sizeof_handle(struct file_handle_v4 *hdl)
 {
-	return offsetof(struct file_handle_v4, fsopaque)+hdl->fs_len;
+	size_t hsize = offsetof(struct file_handle_v4, fsopaque)+hdl->fs_len;
+
+	if (hdl->fhflags1 & FH_CACHE_HINT)
+		hsize += FH_HINT_SIZE;
+
+	return hsize;
 }
 
 #define LEN_FH_STR 1024
@@ -36,6 +36,7 @@
 #define NFS_REQ_QUEUE_H
 
 #include "gsh_list.h"
+#include "gsh_numa.h"
 #include "wait_queue.h"
 
 struct req_q {
@@ -67,15 +68,30 @@ struct req_q_set {
 	struct req_q_pair qset[N_REQ_QUEUES];
 };
 
+/**
+ * @brief The request queues of a NUMA node
+ *
+ * Requests decoded on the node's event channels are queued here, and
+ * the node's workers wait on wait_list.  A worker takes requests of
+ * another node only when its own are empty.
+ */
+
+struct req_q_node {
+	uint32_t ctr;
+	struct req_q_set nfs_request_q;
+	uint64_t size;
+	pthread_spinlock_t sp;
+	struct glist_head wait_list;
+	uint32_t waiters;
+	uint64_t enqueued;	/*< Requests queued on the node */
+	uint64_t local;		/*< Taken by workers of the node */
+	uint64_t remote;	/*< Handed off to workers of another node */
+	GSH_CACHE_PAD(0);
+};
+
 struct nfs_req_st {
-	struct {
-		uint32_t ctr;
-		struct req_q_set nfs_request_q;
-		uint64_t size;
-		pthread_spinlock_t sp;
-		struct glist_head wait_list;
-		uint32_t waiters;
-	} reqs;
+	struct req_q_node node[GSH_NUMA_MAX_NODES];
+	uint32_t nnodes;	/*< Nodes in use, 1 without NUMA pools */
 	GSH_CACHE_PAD(1);
 	struct {
 		pthread_mutex_t mtx;
@@ -97,12 +113,12 @@ static inline void nfs_rpc_q_init(struct req_q *q)
 	q->waiters = 0;
 }
 
-static inline uint32_t nfs_rpc_q_next_slot(void)
+static inline uint32_t nfs_rpc_q_next_slot(struct req_q_node *node)
 {
-	uint32_t ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+	uint32_t ix = atomic_inc_uint32_t(&node->ctr);
 
 	if (!ix)
-		ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+		ix = atomic_inc_uint32_t(&node->ctr);
 	return ix;
 }
 
@@ -111,15 +127,19 @@ static inline void nfs_rpc_queue_awaken(void *arg)
 	struct nfs_req_st *st = arg;
 	struct glist_head *g = NULL;
 	struct glist_head *n = NULL;
-
-	pthread_spin_lock(&st->reqs.sp);
-	glist_for_each_safe(g, n, &st->reqs.wait_list) {
-		wait_q_entry_t *wqe = glist_entry(g, wait_q_entry_t, waitq);
-
-		pthread_cond_signal(&wqe->lwe.cv);
-		pthread_cond_signal(&wqe->rwe.cv);
+	uint32_t ix;
+
+	for (ix = 0; ix < st->nnodes; ix++) {
+		pthread_spin_lock(&st->node[ix].sp);
+		glist_for_each_safe(g, n, &st->node[ix].wait_list) {
+			wait_q_entry_t *wqe =
+				glist_entry(g, wait_q_entry_t, waitq);
+
+			pthread_cond_signal(&wqe->lwe.cv);
+			pthread_cond_signal(&wqe->rwe.cv);
+		}
+		pthread_spin_unlock(&st->node[ix].sp);
 	}
-	pthread_spin_unlock(&st->reqs.sp);
 }
 
 #endif				/* NFS_REQ_QUEUE_H */
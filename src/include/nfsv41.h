@@ -2838,7 +2838,10 @@ extern "C" {
 		offset4         lea_offset;
 		length4         lea_length;
 		stateid4        lea_stateid;
-		device_error4   lea_errors;
+		struct {
+			u_int lea_errors_len;
+			device_error4 *lea_errors_val;
+		} lea_errors;
 	};
 	typedef struct LAYOUTERROR4args LAYOUTERROR4args;
 
@@ -2859,6 +2862,7 @@ extern "C" {
 		stateid4        lsa_stateid;
 		io_info4        lsa_read;
 		io_info4        lsa_write;
+		deviceid4       lsa_deviceid;
 		layoutupdate4   lsa_layoutupdate;
 	};
 	typedef struct LAYOUTSTATS4args LAYOUTSTATS4args;
@@ -2907,12 +2911,21 @@ extern "C" {
 	};
 	typedef struct ff_mirror4 ff_mirror4;
 
+	typedef uint32_t ff_flags4;
+
+#define FF_FLAGS_NO_LAYOUTCOMMIT 0x00000001
+#define FF_FLAGS_NO_IO_THRU_MDS 0x00000002
+#define FF_FLAGS_NO_READ_IO 0x00000004
+#define FF_FLAGS_WRITE_ONE_MIRROR 0x00000008
+
 	struct ff_layout4 {
 		length4 ffl_stripe_unit;
 		struct {
 			u_int ffl_mirrors_len;
 			ff_mirror4 *ffl_mirrors_val;
 		} ffl_mirrors;
+		ff_flags4 ffl_flags;
+		uint32_t ffl_stats_collect_hint;
 	};
 	typedef struct ff_layout4 ff_layout4;
 
@@ -2928,10 +2941,13 @@ extern "C" {
 	typedef struct ff_ioerr4 ff_ioerr4;
 
 	struct ff_io_latency4 {
-		nfstime4 ffil_min;
-		nfstime4 ffil_max;
-		nfstime4 ffil_avg;
-		uint32_t ffil_count;
+		uint64_t ffil_ops_requested;
+		uint64_t ffil_bytes_requested;
+		uint64_t ffil_ops_completed;
+		uint64_t ffil_bytes_completed;
+		uint64_t ffil_bytes_not_delivered;
+		nfstime4 ffil_total_busy_time;
+		nfstime4 ffil_aggregate_completion_time;
 	};
 	typedef struct ff_io_latency4 ff_io_latency4;
 
@@ -3627,6 +3643,7 @@ extern "C" {
 	{
 		u_int32_t *map = objp->map;
 		u_int i, mapsize;
+		int32_t *buf;
 
 /* short circuit the free pass (done at the end) because we don't
  * allocate an array in the "conventional" sense here.  There is
@@ -3634,6 +3651,18 @@ extern "C" {
  */
 		if (xdrs->x_op == XDR_FREE)
 			return true;
+/* a bitmap that fits is coded in one XDR_INLINE, see xdr_nfs23.c */
+		if (xdrs->x_op == XDR_ENCODE &&
+		    objp->bitmap4_len <= BITMAP4_MAPLEN) {
+			buf = XDR_INLINE(xdrs, (1 + objp->bitmap4_len) *
+					 BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				IXDR_PUT_U_INT32(buf, objp->bitmap4_len);
+				for (i = 0; i < objp->bitmap4_len; i++)
+					IXDR_PUT_U_INT32(buf, map[i]);
+				return true;
+			}
+		}
 /* for the same reason, calling xdr_array doesn't work for us (we need
  * to accept bitmaps bigger than BITMAP4_MAPLEN, but throw the rest away
  * so manually do the looping and skip the end
@@ -3641,6 +3670,15 @@ extern "C" {
 		if (!inline_xdr_u_int(xdrs, &objp->bitmap4_len))
 			return false;
 		mapsize = MIN(objp->bitmap4_len, BITMAP4_MAPLEN);
+		if (xdrs->x_op == XDR_DECODE &&
+		    mapsize == objp->bitmap4_len) {
+			buf = XDR_INLINE(xdrs, mapsize * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				for (i = 0; i < mapsize; i++)
+					map[i] = IXDR_GET_U_INT32(buf);
+				return true;
+			}
+		}
 		for (i = 0; i < mapsize; i++)
 			if (!inline_xdr_u_int32_t(xdrs, &map[i]))
 				return false;
@@ -3700,12 +3738,52 @@ extern "C" {
 	static inline bool xdr_nfs_fh4(XDR * xdrs, nfs_fh4 *objp)
 	{
 		file_handle_v4_t *fh;
+		int32_t *buf;
+		u_int len;
 
 		if (xdrs->x_op == XDR_ENCODE &&
 		    objp->nfs_fh4_len >= offsetof(file_handle_v4_t, fsopaque)) {
 			fh = (file_handle_v4_t *)objp->nfs_fh4_val;
 			fh->id.exports = htons(fh->id.exports);
 		}
+		if (xdrs->x_op == XDR_ENCODE &&
+		    objp->nfs_fh4_len <= NFS4_FHSIZE) {
+			len = RNDUP(objp->nfs_fh4_len);
+			buf = XDR_INLINE(xdrs, BYTES_PER_XDR_UNIT + len);
+			if (buf != NULL) {
+				IXDR_PUT_U_INT32(buf, objp->nfs_fh4_len);
+				if (len != 0) {
+					buf[len / BYTES_PER_XDR_UNIT - 1] = 0;
+					memcpy(buf, objp->nfs_fh4_val,
+					       objp->nfs_fh4_len);
+				}
+				return true;
+			}
+		}
+		if (xdrs->x_op == XDR_DECODE) {
+			/* inline_xdr_bytes, with the body in one piece */
+			if (!inline_xdr_u_int(xdrs, &objp->nfs_fh4_len) ||
+			    objp->nfs_fh4_len > NFS4_FHSIZE)
+				return false;
+			len = objp->nfs_fh4_len;
+			if (len == 0)
+				return true;
+			if (objp->nfs_fh4_val == NULL)
+				objp->nfs_fh4_val = mem_alloc(len);
+			if (objp->nfs_fh4_val == NULL)
+				return false;
+			buf = XDR_INLINE(xdrs, RNDUP(len));
+			if (buf != NULL)
+				memcpy(objp->nfs_fh4_val, buf, len);
+			else if (!inline_xdr_getopaque(xdrs,
+						       objp->nfs_fh4_val, len))
+				return false;
+			if (len >= offsetof(file_handle_v4_t, fsopaque)) {
+				fh = (file_handle_v4_t *)objp->nfs_fh4_val;
+				fh->id.exports = ntohs(fh->id.exports);
+			}
+			return true;
+		}
 		if (!inline_xdr_bytes
 		    (xdrs, (char **)&objp->nfs_fh4_val,
 		     &objp->nfs_fh4_len, NFS4_FHSIZE))
@@ -4003,8 +4081,37 @@ extern "C" {
 		return true;
 	}
 
+	static inline int32_t *stateid4_put(int32_t *buf, stateid4 *objp)
+	{
+		IXDR_PUT_U_INT32(buf, objp->seqid);
+		memcpy(buf, objp->other, sizeof(objp->other));
+		return buf + sizeof(objp->other) / BYTES_PER_XDR_UNIT;
+	}
+
+	static inline int32_t *stateid4_get(int32_t *buf, stateid4 *objp)
+	{
+		objp->seqid = IXDR_GET_U_INT32(buf);
+		memcpy(objp->other, buf, sizeof(objp->other));
+		return buf + sizeof(objp->other) / BYTES_PER_XDR_UNIT;
+	}
+
 	static inline bool xdr_stateid4(XDR * xdrs, stateid4 *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				stateid4_put(buf, objp);
+				return true;
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				stateid4_get(buf, objp);
+				return true;
+			}
+		}
 		if (!inline_xdr_u_int32_t(xdrs, &objp->seqid))
 			return false;
 		if (!xdr_opaque(xdrs, objp->other, 12))
@@ -6128,6 +6235,25 @@ extern "C" {
 
 	static inline bool xdr_READ4args(XDR * xdrs, READ4args *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 7 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				buf = stateid4_put(buf, &objp->stateid);
+				IXDR_PUT_U_INT64(buf, objp->offset);
+				IXDR_PUT_U_INT32(buf, objp->count);
+				return true;
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 7 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				buf = stateid4_get(buf, &objp->stateid);
+				objp->offset = IXDR_GET_U_INT64(buf);
+				objp->count = IXDR_GET_U_INT32(buf);
+				return true;
+			}
+		}
 		if (!xdr_stateid4(xdrs, &objp->stateid))
 			return false;
 		if (!xdr_offset4(xdrs, &objp->offset))
@@ -6139,6 +6265,20 @@ extern "C" {
 
 	static inline bool xdr_READ4resok(XDR * xdrs, READ4resok *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE &&
+		    objp->data.data_len <= XDR_BYTES_MAXLEN_IO) {
+			buf = XDR_INLINE(xdrs, 2 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				IXDR_PUT_BOOL(buf,
+					      objp->eof ? XDR_TRUE : XDR_FALSE);
+				IXDR_PUT_U_INT32(buf, objp->data.data_len);
+				return inline_xdr_putopaque(xdrs,
+							    objp->data.data_val,
+							    objp->data.data_len);
+			}
+		}
 		if (!inline_xdr_bool(xdrs, &objp->eof))
 			return false;
 		if (!inline_xdr_bytes
@@ -6515,12 +6655,31 @@ extern "C" {
 
 	static inline bool xdr_WRITE4args(XDR * xdrs, WRITE4args *objp)
 	{
-		if (!xdr_stateid4(xdrs, &objp->stateid))
-			return false;
-		if (!xdr_offset4(xdrs, &objp->offset))
-			return false;
-		if (!xdr_stable_how4(xdrs, &objp->stable))
-			return false;
+		int32_t *buf = NULL;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 7 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				buf = stateid4_put(buf, &objp->stateid);
+				IXDR_PUT_U_INT64(buf, objp->offset);
+				IXDR_PUT_ENUM(buf, objp->stable);
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 7 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				buf = stateid4_get(buf, &objp->stateid);
+				objp->offset = IXDR_GET_U_INT64(buf);
+				objp->stable = IXDR_GET_ENUM(buf, stable_how4);
+			}
+		}
+		if (buf == NULL) {
+			if (!xdr_stateid4(xdrs, &objp->stateid))
+				return false;
+			if (!xdr_offset4(xdrs, &objp->offset))
+				return false;
+			if (!xdr_stable_how4(xdrs, &objp->stable))
+				return false;
+		}
 		if (!inline_xdr_bytes
 		    (xdrs, (char **)&objp->data.data_val,
 		     &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
@@ -6530,6 +6689,28 @@ extern "C" {
 
 	static inline bool xdr_WRITE4resok(XDR * xdrs, WRITE4resok *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				IXDR_PUT_U_INT32(buf, objp->count);
+				IXDR_PUT_ENUM(buf, objp->committed);
+				memcpy(buf, objp->writeverf,
+				       NFS4_VERIFIER_SIZE);
+				return true;
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 4 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				objp->count = IXDR_GET_U_INT32(buf);
+				objp->committed =
+					IXDR_GET_ENUM(buf, stable_how4);
+				memcpy(objp->writeverf, buf,
+				       NFS4_VERIFIER_SIZE);
+				return true;
+			}
+		}
 		if (!xdr_count4(xdrs, &objp->count))
 			return false;
 		if (!xdr_stable_how4(xdrs, &objp->committed))
@@ -7419,6 +7600,34 @@ extern "C" {
 
 	static inline bool xdr_SEQUENCE4args(XDR * xdrs, SEQUENCE4args *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 8 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				memcpy(buf, objp->sa_sessionid,
+				       NFS4_SESSIONID_SIZE);
+				buf += NFS4_SESSIONID_SIZE / BYTES_PER_XDR_UNIT;
+				IXDR_PUT_U_INT32(buf, objp->sa_sequenceid);
+				IXDR_PUT_U_INT32(buf, objp->sa_slotid);
+				IXDR_PUT_U_INT32(buf, objp->sa_highest_slotid);
+				IXDR_PUT_BOOL(buf, objp->sa_cachethis
+					      ? XDR_TRUE : XDR_FALSE);
+				return true;
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 8 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				memcpy(objp->sa_sessionid, buf,
+				       NFS4_SESSIONID_SIZE);
+				buf += NFS4_SESSIONID_SIZE / BYTES_PER_XDR_UNIT;
+				objp->sa_sequenceid = IXDR_GET_U_INT32(buf);
+				objp->sa_slotid = IXDR_GET_U_INT32(buf);
+				objp->sa_highest_slotid = IXDR_GET_U_INT32(buf);
+				objp->sa_cachethis = IXDR_GET_BOOL(buf);
+				return true;
+			}
+		}
 		if (!xdr_sessionid4(xdrs, objp->sa_sessionid))
 			return false;
 		if (!xdr_sequenceid4(xdrs, &objp->sa_sequenceid))
@@ -7434,6 +7643,37 @@ extern "C" {
 
 	static inline bool xdr_SEQUENCE4resok(XDR * xdrs, SEQUENCE4resok *objp)
 	{
+		int32_t *buf;
+
+		if (xdrs->x_op == XDR_ENCODE) {
+			buf = XDR_INLINE(xdrs, 9 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				memcpy(buf, objp->sr_sessionid,
+				       NFS4_SESSIONID_SIZE);
+				buf += NFS4_SESSIONID_SIZE / BYTES_PER_XDR_UNIT;
+				IXDR_PUT_U_INT32(buf, objp->sr_sequenceid);
+				IXDR_PUT_U_INT32(buf, objp->sr_slotid);
+				IXDR_PUT_U_INT32(buf, objp->sr_highest_slotid);
+				IXDR_PUT_U_INT32(buf,
+						 objp->sr_target_highest_slotid);
+				IXDR_PUT_U_INT32(buf, objp->sr_status_flags);
+				return true;
+			}
+		} else if (xdrs->x_op == XDR_DECODE) {
+			buf = XDR_INLINE(xdrs, 9 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				memcpy(objp->sr_sessionid, buf,
+				       NFS4_SESSIONID_SIZE);
+				buf += NFS4_SESSIONID_SIZE / BYTES_PER_XDR_UNIT;
+				objp->sr_sequenceid = IXDR_GET_U_INT32(buf);
+				objp->sr_slotid = IXDR_GET_U_INT32(buf);
+				objp->sr_highest_slotid = IXDR_GET_U_INT32(buf);
+				objp->sr_target_highest_slotid =
+					IXDR_GET_U_INT32(buf);
+				objp->sr_status_flags = IXDR_GET_U_INT32(buf);
+				return true;
+			}
+		}
 		if (!xdr_sessionid4(xdrs, objp->sr_sessionid))
 			return false;
 		if (!xdr_sequenceid4(xdrs, &objp->sr_sequenceid))
@@ -7903,6 +8143,17 @@ extern "C" {
 		return true;
 	}
 
+	static inline bool xdr_device_error4(XDR *xdrs, device_error4 *objp)
+	{
+		if (!xdr_deviceid4(xdrs, objp->de_deviceid))
+			return false;
+		if (!xdr_nfsstat4(xdrs, &objp->de_status))
+			return false;
+		if (!inline_xdr_enum(xdrs, (enum_t *)&objp->de_opnum))
+			return false;
+		return true;
+	}
+
 	static inline bool xdr_LAYOUTERROR4args(XDR * xdrs,
 						LAYOUTERROR4args *objp)
 	{
@@ -7912,11 +8163,12 @@ extern "C" {
 			return false;
 		if (!xdr_stateid4(xdrs, &objp->lea_stateid))
 			return false;
-		if (!xdr_deviceid4(xdrs, objp->lea_errors.de_deviceid))
-			return false;
-		if (!xdr_nfsstat4(xdrs, &objp->lea_errors.de_status))
-			return false;
-		if (!inline_xdr_enum(xdrs, (enum_t *)objp->lea_errors.de_opnum))
+		if (!xdr_array(xdrs,
+			       (char **)&objp->lea_errors.lea_errors_val,
+			       &objp->lea_errors.lea_errors_len,
+			       XDR_ARRAY_MAXLEN,
+			       sizeof(device_error4),
+			       (xdrproc_t) xdr_device_error4))
 			return false;
 		return true;
 	}
@@ -7946,6 +8198,8 @@ extern "C" {
 			return false;
 		if (!inline_xdr_u_int64_t(xdrs, &objp->lsa_write.ii_bytes))
 			return false;
+		if (!xdr_deviceid4(xdrs, objp->lsa_deviceid))
+			return false;
 		if (!xdr_layoutupdate4(xdrs, &objp->lsa_layoutupdate))
 			return false;
 		return true;
@@ -8648,8 +8902,42 @@ extern "C" {
 
 	static inline bool xdr_COMPOUND4args(XDR * xdrs, COMPOUND4args *objp)
 	{
+		int32_t *buf;
+		u_int i;
+
 		if (!xdr_utf8str_cs(xdrs, &objp->tag))
 			return false;
+		/* minorversion and the op count in one piece, then
+		 * xdr_array's work for the ops
+		 */
+		if (xdrs->x_op == XDR_DECODE &&
+		    objp->argarray.argarray_val == NULL) {
+			buf = XDR_INLINE(xdrs, 2 * BYTES_PER_XDR_UNIT);
+			if (buf != NULL) {
+				objp->minorversion = IXDR_GET_U_INT32(buf);
+				objp->argarray.argarray_len =
+					IXDR_GET_U_INT32(buf);
+				/* decoder hint */
+				if (objp->minorversion > 0)
+					xdrs->x_flags &= ~XDR_FLAG_CKSUM;
+				if (objp->argarray.argarray_len >
+				    XDR_ARRAY_MAXLEN)
+					return false;
+				if (objp->argarray.argarray_len == 0)
+					return true;
+				objp->argarray.argarray_val =
+				    mem_zalloc(objp->argarray.argarray_len *
+					       sizeof(nfs_argop4));
+				if (objp->argarray.argarray_val == NULL)
+					return false;
+				for (i = 0; i < objp->argarray.argarray_len;
+				     i++)
+					if (!xdr_nfs_argop4(xdrs,
+						&objp->argarray.argarray_val[i]))
+						return false;
+				return true;
+			}
+		}
 		if (!inline_xdr_u_int32_t(xdrs, &objp->minorversion))
 			return false;
 		/* decoder hint */
@@ -9150,16 +9438,9 @@ extern "C" {
 			       XDR_ARRAY_MAXLEN, sizeof(ff_mirror4),
 			       (xdrproc_t) xdr_ff_mirror4))
 			return false;
-		return true;
-	}
-
-	static inline bool xdr_device_error4(XDR *xdrs, device_error4 *objp)
-	{
-		if (!xdr_deviceid4(xdrs, objp->de_deviceid))
-			return false;
-		if (!xdr_nfsstat4(xdrs, &objp->de_status))
+		if (!xdr_uint32_t(xdrs, &objp->ffl_flags))
 			return false;
-		if (!xdr_nfs_opnum4(xdrs, &objp->de_opnum))
+		if (!xdr_uint32_t(xdrs, &objp->ffl_stats_collect_hint))
 			return false;
 		return true;
 	}
@@ -9184,13 +9465,19 @@ extern "C" {
 
 	static inline bool xdr_ff_io_latency4(XDR *xdrs, ff_io_latency4 *objp)
 	{
-		if (!xdr_nfstime4 (xdrs, &objp->ffil_min))
+		if (!xdr_uint64_t(xdrs, &objp->ffil_ops_requested))
+			return false;
+		if (!xdr_uint64_t(xdrs, &objp->ffil_bytes_requested))
+			return false;
+		if (!xdr_uint64_t(xdrs, &objp->ffil_ops_completed))
+			return false;
+		if (!xdr_uint64_t(xdrs, &objp->ffil_bytes_completed))
 			return false;
-		if (!xdr_nfstime4 (xdrs, &objp->ffil_max))
+		if (!xdr_uint64_t(xdrs, &objp->ffil_bytes_not_delivered))
 			return false;
-		if (!xdr_nfstime4 (xdrs, &objp->ffil_avg))
+		if (!xdr_nfstime4(xdrs, &objp->ffil_total_busy_time))
 			return false;
-		if (!xdr_uint32_t (xdrs, &objp->ffil_count))
+		if (!xdr_nfstime4(xdrs, &objp->ffil_aggregate_completion_time))
 			return false;
 		return true;
 	}
@@ -225,6 +225,32 @@ nfsstat4 FSAL_encode_file_layout(XDR *xdrs,
 nfsstat4 FSAL_encode_v4_multipath(XDR *xdrs, const uint32_t num_hosts,
 				  const fsal_multipath_member_t *hosts);
 
+/**
+ * The data server of one mirror of a flex files layout, for
+ * FSAL_encode_flex_file_layout.
+ */
+
+typedef struct fsal_ff_mirror {
+	struct pnfs_deviceid deviceid;	/*< Device of the data server */
+	uint32_t efficiency;		/*< Higher is preferred for reads */
+	uint32_t version;		/*< NFS_V3 or NFS_V4 (4.1) */
+} fsal_ff_mirror_t;
+
+nfsstat4 FSAL_encode_flex_file_layout(XDR *xdrs,
+				      const struct fsal_obj_handle *obj_hdl,
+				      const length4 stripe_unit,
+				      const uint32_t num_mirrors,
+				      const fsal_ff_mirror_t *mirrors,
+				      const uid_t user, const gid_t group,
+				      const ff_flags4 flags,
+				      const uint32_t stats_hint);
+
+nfsstat4 FSAL_encode_ff_device_addr(XDR *xdrs,
+				    const fsal_multipath_member_t *host,
+				    const uint32_t version,
+				    const uint32_t rsize,
+				    const uint32_t wsize);
+
 nfsstat4 posix2nfs4_error(int posix_errorcode);
 
 /*
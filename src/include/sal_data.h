@@ -46,6 +46,7 @@
 
 #include "abstract_atomic.h"
 #include "abstract_mem.h"
+#include "delayed_exec.h"
 #include "hashtable.h"
 #include "fsal_pnfs.h"
 #include "config_parsing.h"
@@ -309,6 +310,8 @@ struct cf_deleg_stats {
 	time_t cfd_rs_time;                   /* time when the client responsed
 						 NFS4_OK for a recall. */
 	time_t cfd_r_time;               /* time of the recall attempt */
+	struct timespec cfd_r_start;     /* precise time of the first recall
+					    attempt, for recall latency */
 };
 
 /**
@@ -330,6 +333,8 @@ struct state_deleg {
 	time_t sd_grant_time;               /* time of successful delegation */
 	enum deleg_state sd_state;
 	struct cf_deleg_stats sd_clfile_stats;  /* client specific */
+	struct delayed_timer sd_revoke_timer;	/* pending revoke check,
+						   under state_mutex */
 };
 
 /**
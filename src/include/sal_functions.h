@@ -824,12 +824,36 @@ void init_new_deleg_state(union state_data *deleg_state,
 void deleg_heuristics_recall(cache_entry_t *entry,
 			     state_owner_t *owner,
 			     struct state_t *deleg);
+
+/**
+ * @brief Counters of the adaptive delegation policy
+ */
+
+struct deleg_policy_stats {
+	uint64_t opens;		/*< Opens recorded */
+	uint64_t granted;	/*< Delegations the policy let through */
+	uint64_t declined;	/*< Delegations the policy refused */
+	uint64_t saved_opens;	/*< Opens the granted ones should save */
+	uint64_t recalls;	/*< Recalls whose latency was measured */
+	uint64_t recall_usec;	/*< Total latency of those recalls */
+	uint64_t recall_usec_max; /*< Longest of them */
+};
+
+extern struct deleg_policy_stats deleg_policy_st;
+
+void deleg_policy_open(struct file_deleg_stats *fds, clientid4 client,
+		       bool write, nsecs_elapsed_t when);
+bool deleg_policy_grant(const struct file_deleg_stats *fds,
+			open_delegation_type4 type);
+void deleg_policy_recalled(struct file_deleg_stats *fds,
+			   nsecs_elapsed_t latency);
 void get_deleg_perm(cache_entry_t *entry, nfsace4 *permissions,
 		    open_delegation_type4 type);
 void update_delegation_stats(cache_entry_t *entry,
 			     state_owner_t *owner,
 			     struct state_t *deleg);
 state_status_t delegrecall_impl(cache_entry_t *entry);
+void delegrevoke_check_cancel(state_t *state);
 nfsstat4 deleg_revoke(cache_entry_t *entry, struct state_t *deleg_state);
 void state_deleg_revoke(cache_entry_t *entry, state_t *state);
 bool state_deleg_conflict(cache_entry_t *entry, bool write);
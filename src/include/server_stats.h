@@ -41,6 +41,8 @@
 
 #include <sys/types.h>
 
+void server_stats_init(void);
+
 void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup);
 
 #ifdef _USE_9P
@@ -64,5 +66,20 @@ void inc_revokes(struct gsh_client *client);
 void inc_recalls(struct gsh_client *client);
 void inc_failed_recalls(struct gsh_client *client);
 
+/** Phases of server startup, timed for ShowStartup */
+enum startup_phase {
+	STARTUP_FSALS,		/*< Loading the FSALs */
+	STARTUP_EXPORTS,	/*< Reading exports, creating FSAL exports */
+	STARTUP_EXPORT_ROOTS,	/*< Looking up and caching export roots */
+	STARTUP_PSEUDOFS,	/*< Building the pseudo file system */
+	STARTUP_RECOVERY,	/*< Reading clients to recover */
+	STARTUP_SERVICES,	/*< Starting the service threads */
+	STARTUP_PHASES
+};
+
+void server_stats_startup_begin(enum startup_phase phase);
+void server_stats_startup_end(enum startup_phase phase);
+void server_stats_startup_done(void);
+
 #endif				/* !SERVER_STATS_H */
 /** @} */
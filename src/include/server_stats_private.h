@@ -61,7 +61,13 @@ struct nfsv42_stats;
 struct deleg_stats;
 struct _9p_stats;
 
+/* The NFS, MNT, NLM and RQUOTA structs are arrays of nshards (0
+ * meaning 1) cache aligned shards, allocated lock free on first use.
+ * 9P and delegation stats are not sharded.
+ */
+
 struct gsh_stats {
+	uint32_t nshards;
 	struct nfsv3_stats *nfsv3;
 	struct mnt_stats *mnt;
 	struct nlmv4_stats *nlm4;
@@ -235,14 +241,85 @@ struct export_stats {
 	.direction = "out"  \
 }
 
+/* name, count, latency p50, p90, p99, p99.9, max,
+ * queue wait p50, p99, p99.9, max (nsecs) */
+#define LAT_PERCENTILES_ARRAY_TYPE "(stttttttttt)"
+#define LAT_PERCENTILES_REPLY			\
+{						\
+	.name = "latency",			\
+	.type = DBUS_TYPE_ARRAY_AS_STRING	\
+		LAT_PERCENTILES_ARRAY_TYPE,	\
+	.direction = "out"			\
+}
+
+/* node, requests queued on it, taken by its workers, handed off to
+ * workers of another node, waiting now */
+#define NUMA_NODES_ARRAY_TYPE "(utttt)"
+#define NUMA_NODES_REPLY			\
+{						\
+	.name = "nodes",			\
+	.type = DBUS_TYPE_ARRAY_AS_STRING	\
+		NUMA_NODES_ARRAY_TYPE,		\
+	.direction = "out"			\
+}
+
+#define LAT_OP_ARG            \
+{                             \
+	.name = "op_name",    \
+	.type = "s",          \
+	.direction = "in"     \
+}
+
+#define LAT_WINDOW_ARG        \
+{                             \
+	.name = "window",     \
+	.type = "u",          \
+	.direction = "in"     \
+}
+
+/* (bucket upper bound in nsecs, count) of non-empty buckets */
+#define LAT_HISTOGRAM_REPLY   \
+{                             \
+	.name = "latency",    \
+	.type = "a(tt)",      \
+	.direction = "out"    \
+},                            \
+{                             \
+	.name = "queue_wait", \
+	.type = "a(tt)",      \
+	.direction = "out"    \
+}
+
+#define FSAL_NAME_ARG         \
+{                             \
+	.name = "fsal_name",  \
+	.type = "s",          \
+	.direction = "in"     \
+}
+
+/* name, calls, errors, in flight, bytes, outliers,
+ * latency p50, p90, p99, p99.9, max (nsecs) */
+#define FSAL_OP_STATS_TYPE "(stttttttttt)"
+#define FSAL_STATS_REPLY				\
+{							\
+	.name = "fsal_ops",				\
+	.type = DBUS_TYPE_ARRAY_AS_STRING		\
+		FSAL_OP_STATS_TYPE,			\
+	.direction = "out"				\
+},							\
+{							\
+	.name = "export_ops",				\
+	.type = "a(qa" FSAL_OP_STATS_TYPE ")",		\
+	.direction = "out"				\
+}
 
 void server_stats_summary(DBusMessageIter *iter, struct gsh_stats *st);
-void server_dbus_v3_iostats(struct nfsv3_stats *v3p, DBusMessageIter *iter);
-void server_dbus_v40_iostats(struct nfsv40_stats *v40p, DBusMessageIter *iter);
-void server_dbus_v41_iostats(struct nfsv41_stats *v41p, DBusMessageIter *iter);
-void server_dbus_v41_layouts(struct nfsv41_stats *v41p, DBusMessageIter *iter);
-void server_dbus_v42_iostats(struct nfsv41_stats *v42p, DBusMessageIter *iter);
-void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter);
+void server_dbus_v3_iostats(struct gsh_stats *st, DBusMessageIter *iter);
+void server_dbus_v40_iostats(struct gsh_stats *st, DBusMessageIter *iter);
+void server_dbus_v41_iostats(struct gsh_stats *st, DBusMessageIter *iter);
+void server_dbus_v41_layouts(struct gsh_stats *st, DBusMessageIter *iter);
+void server_dbus_v42_iostats(struct gsh_stats *st, DBusMessageIter *iter);
+void server_dbus_v42_layouts(struct gsh_stats *st, DBusMessageIter *iter);
 void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter);
 void server_dbus_all_iostats(struct export_stats *export_statistics,
 			     DBusMessageIter *iter);
@@ -251,6 +328,21 @@ void server_dbus_total_ops(struct export_stats *export_st,
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void fsal_sync_dbus_show(DBusMessageIter *iter);
+void fsal_up_dbus_show(DBusMessageIter *iter);
+void delayed_dbus_show(DBusMessageIter *iter);
+void numa_dbus_show(DBusMessageIter *iter);
+void deleg_policy_dbus_show(DBusMessageIter *iter);
+void startup_dbus_show(DBusMessageIter *iter);
+bool arg_latency_op(DBusMessageIter *args, char **opname, char **errormsg);
+bool arg_latency_window(DBusMessageIter *args, uint32_t *window,
+			char **errormsg);
+void server_dbus_latency_percentiles(struct gsh_stats *st,
+				     DBusMessageIter *iter);
+void global_dbus_latency_percentiles(uint32_t window, DBusMessageIter *iter);
+bool server_stats_has_latency(struct gsh_stats *st, const char *opname);
+void server_dbus_latency_histogram(struct gsh_stats *st, const char *opname,
+				   DBusMessageIter *iter);
 
 #ifdef _USE_9P
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
@@ -264,8 +356,7 @@ void server_dbus_9p_opstats(struct _9p_stats *_9pp, u8 opcode,
 #endif				/* USE_DBUS */
 
 void server_stats_free(struct gsh_stats *statsp);
-
-void server_stats_init(void);
+uint32_t server_stats_shards(void);
 
 #endif				/* !SERVER_STATS_PRIVATE_H */
 /** @} */
@@ -68,6 +68,7 @@ typedef gss_union_ctx_id_desc *gss_union_ctx_id_t;
 #define SVC_RPC_GSS_FLAG_NONE    0x0000
 #define SVC_RPC_GSS_FLAG_MSPAC   0x0001
 #define SVC_RPC_GSS_FLAG_LOCKED  0x0002
+#define SVC_RPC_GSS_FLAG_UNHASHED 0x0004
 
 struct svc_rpc_gss_data {
 	struct opr_rbtree_node node_k;
@@ -97,6 +98,23 @@ struct svc_rpc_gss_data {
 	uint32_t endtime;
 };
 
+/*
+ * Integrity or privacy call body, read off the transport but not yet
+ * checked or decrypted.
+ */
+struct svc_rpc_gss_body {
+	gss_buffer_desc databuf;	/* databody_integ */
+	gss_buffer_desc wrapbuf;	/* checksum or databody_priv */
+	rpc_gss_svc_t svc;
+	u_int seq;
+};
+
+static inline u_int
+svc_rpc_gss_body_len(struct svc_rpc_gss_body *body)
+{
+	return (body->databuf.length + body->wrapbuf.length);
+}
+
 bool svcauth_gss_destroy(SVCAUTH *auth);
 
 static inline struct
@@ -138,7 +156,7 @@ unref_svc_rpc_gss_data(struct svc_rpc_gss_data *gd,
 		mutex_unlock(&gd->lock);
 }
 
-void authgss_hash_init();
+int authgss_hash_init();
 struct svc_rpc_gss_data *authgss_ctx_hash_get(struct rpc_gss_cred *gc);
 bool authgss_ctx_hash_set(struct svc_rpc_gss_data *gd);
 bool authgss_ctx_hash_del(struct svc_rpc_gss_data *gd);
@@ -148,4 +166,31 @@ bool svcauth_gss_release_cred(void);
 bool svcauth_gss_import_name(char *service);
 bool svcauth_gss_set_svc_name(gss_name_t name);
 
+/*
+ * Server side wrap and unwrap.  Only the GSS calls are made under
+ * ctx_lock, marshalling is left out of it.
+ */
+bool rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
+		       gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
+		       u_int seq, mutex_t *ctx_lock);
+bool xdr_rpc_gss_body(XDR *xdrs, struct svc_rpc_gss_body *body);
+bool rpc_gss_unwrap_body(struct svc_rpc_gss_body *body, xdrproc_t xdr_func,
+			 caddr_t xdr_ptr, gss_ctx_id_t ctx, gss_qop_t qop,
+			 mutex_t *ctx_lock);
+void rpc_gss_release_body(struct svc_rpc_gss_body *body);
+
+/*
+ * Calls with a body of at least svc_init_params.gss_defer_min bytes
+ * leave SVC_GETARGS still wrapped, the server finishes decoding them
+ * with svcauth_gss_complete_args() on another thread.
+ */
+bool svcauth_gss_complete_args(struct svc_req *req, xdrproc_t xdr_func,
+			       caddr_t xdr_ptr);
+
+static inline bool
+svcauth_gss_args_deferred(struct svc_req *req)
+{
+	return (req->rq_cred.oa_flavor == RPCSEC_GSS && req->rq_ap2);
+}
+
 #endif				/* GSS_INTERNAL_H */
@@ -138,6 +138,7 @@ typedef struct svc_init_params {
 	u_int gss_max_ctx;
 	u_int gss_max_idle_gen;
 	u_int gss_max_gc;
+	u_int gss_defer_min;	/* defer unwrap of larger bodies, 0 never */
 	u_int ioq_thrd_max;
 } svc_init_params;
 
@@ -862,6 +863,13 @@ extern void free_rpc_msg(struct rpc_msg *);
  */
 int svc_dg_enablecache(SVCXPRT *, const u_int);
 
+/*
+ * svc_dg_enable_mmsg() makes a dg transport receive and send up to the
+ * given number of datagrams per system call.  Replies are queued and
+ * sent when the transport is unlocked with SVC_UNLOCK.
+ */
+int svc_dg_enable_mmsg(SVCXPRT *, const u_int);
+
 int __rpc_get_local_uid(SVCXPRT *, uid_t *);
 
 __END_DECLS
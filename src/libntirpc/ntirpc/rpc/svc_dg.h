@@ -66,6 +66,7 @@ struct svc_dg_data {
 
 	struct msghdr su_msghdr;	/* msghdr received from clnt */
 	unsigned char su_cmsg[SVC_CMSG_LEN];	/* cmsghdr received from clnt */
+	struct svc_dg_mmsg *su_mmsg;	/* batching, see svc_dg_enable_mmsg */
 };
 
 #define __rpcb_get_dg_xidp(x) (&((struct svc_dg_data *)(x)->xp_p2)->su_xid)
@@ -57,6 +57,8 @@
  *  svc_rqst_init_xprt -- init svc_rqst part of xprt handle
  *  svc_rqst_new_evchan -- create event channel
  *  svc_rqst_evchan_reg -- set {xprt, dispatcher} mapping
+ *  svc_rqst_evchan_move -- move a disarmed xprt to another channel, and
+ *   rearm it there
  *  svc_rqst_foreach_xprt -- scan registered xprts at id (or 0 for all)
  *  svc_rqst_thrd_run -- enter dispatch loop at id
  *  svc_rqst_thrd_signal --request thread to run a callout function which
@@ -75,6 +77,7 @@ int svc_rqst_new_evchan(uint32_t *chan_id /* OUT */ , void *u_data,
 			uint32_t flags);
 int svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags);
 int svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t flags);
+int svc_rqst_evchan_move(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags);
 
 int svc_rqst_xprt_register(SVCXPRT *xprt, SVCXPRT *newxprt);
 int svc_rqst_thrd_run(uint32_t chan_id, uint32_t flags);
@@ -382,6 +382,20 @@ struct xdr_discrim {
 #define IXDR_PUT_SHORT(buf, v)  IXDR_PUT_LONG((buf), (v))
 #define IXDR_PUT_U_SHORT(buf, v) IXDR_PUT_LONG((buf), (v))
 
+/*
+ * 64-bit quantities take two units, most significant first.
+ * IXDR_PUT_U_INT64 is a statement and evaluates v twice.
+ */
+#define IXDR_GET_U_INT64(buf)						\
+	((buf) += 2,							\
+	 ((u_int64_t)ntohl((u_int32_t)(buf)[-2]) << 32) |		\
+	 (u_int64_t)ntohl((u_int32_t)(buf)[-1]))
+#define IXDR_PUT_U_INT64(buf, v)					\
+	do {								\
+		IXDR_PUT_U_INT32((buf), (u_int64_t)(v) >> 32);		\
+		IXDR_PUT_U_INT32((buf), (v));				\
+	} while (0)
+
 /*
  * In-line routines for vector encode/decode of primitive data types.
  * Intermediate speed, avoids function calls in most cases, at the expense of
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <rpc/rpc.h>
 #include <rpc/types.h>
 #include "rpc_com.h"
@@ -40,11 +41,22 @@
 #include <rpc/gss_internal.h>
 #include "svc_internal.h"
 
-/* GSS context cache */
+/* GSS context cache
+ *
+ * Contexts are kept in a partitioned tree with a per partition LRU.
+ * In front of every partition sits a direct mapped array of slots,
+ * which is searched without taking the partition lock.  A slot owns a
+ * reference on the context it points to.  A lookup takes the slot's
+ * reference with an exchange, checks the context and puts it back, so
+ * a context can't be freed under it.  Contexts are marked UNHASHED
+ * before leaving the tree, the lookup that finds one of them in its
+ * hands does not return it, and does not leave it in the slot.
+ */
 
 struct authgss_x_part {
 	uint32_t gen;
 	 TAILQ_HEAD(ctx_tailq, svc_rpc_gss_data) lru_q;
+	struct svc_rpc_gss_data **cache;
 };
 
 struct authgss_hash_st {
@@ -91,7 +103,26 @@ svc_rpc_gss_cmpf(const struct opr_rbtree_node *lhs,
 	return (1);
 }
 
-void
+/* Free the partitions set up before a failed authgss_hash_init() */
+static void
+authgss_hash_free(int nparts)
+{
+	struct authgss_x_part *axp;
+	int ix;
+
+	for (ix = 0; ix < nparts; ++ix) {
+		axp = (struct authgss_x_part *)authgss_hash_st.xt.tree[ix].u1;
+		mem_free(axp->cache, authgss_hash_st.xt.cachesz *
+			 sizeof(struct svc_rpc_gss_data *));
+		mem_free(axp, sizeof(struct authgss_x_part));
+		authgss_hash_st.xt.tree[ix].u1 = NULL;
+	}
+	mem_free(authgss_hash_st.xt.tree,
+		 authgss_hash_st.xt.npart * sizeof(struct rbtree_x_part));
+	authgss_hash_st.xt.tree = NULL;
+}
+
+int
 authgss_hash_init()
 {
 	int ix, code = 0;
@@ -105,28 +136,34 @@ authgss_hash_init()
 	code =
 	    rbtx_init(&authgss_hash_st.xt, svc_rpc_gss_cmpf,
 		      __svc_params->gss.ctx_hash_partitions,
-		      RBT_X_FLAG_ALLOC | RBT_X_FLAG_CACHE_RT);
-	if (code)
+		      RBT_X_FLAG_ALLOC);
+	if (code) {
 		__warnx(TIRPC_DEBUG_FLAG_RPCSEC_GSS, "%s: rbtx_init failed",
 			__func__);
+		goto unlock;
+	}
 
-	/* init read-through cache */
 	for (ix = 0; ix < __svc_params->gss.ctx_hash_partitions; ++ix) {
 		struct rbtree_x_part *xp = &(authgss_hash_st.xt.tree[ix]);
 		struct authgss_x_part *axp;
-		xp->cache =
-		    mem_zalloc(authgss_hash_st.xt.cachesz *
-			       sizeof(struct opr_rbtree_node *));
-		if (unlikely(!xp->cache)) {
+
+		/* partition ctx LRU and lookup cache */
+		axp = (struct authgss_x_part *)
+		    mem_zalloc(sizeof(struct authgss_x_part));
+		if (axp)
+			axp->cache =
+			    mem_zalloc(authgss_hash_st.xt.cachesz *
+				       sizeof(struct svc_rpc_gss_data *));
+		if (unlikely(!axp || !axp->cache)) {
 			__warnx(TIRPC_DEBUG_FLAG_RPCSEC_GSS,
-				"%s: rbtx cache partition alloc failed",
+				"%s: ctx cache partition alloc failed",
 				__func__);
-			authgss_hash_st.xt.cachesz = 0;
-			break;
+			if (axp)
+				mem_free(axp, sizeof(struct authgss_x_part));
+			authgss_hash_free(ix);
+			code = ENOMEM;
+			goto unlock;
 		}
-		/* partition ctx LRU */
-		axp = (struct authgss_x_part *)
-		    mem_alloc(sizeof(struct authgss_x_part));
 		TAILQ_INIT(&axp->lru_q);
 		xp->u1 = axp;
 	}
@@ -138,42 +175,102 @@ authgss_hash_init()
 
  unlock:
 	mutex_unlock(&authgss_hash_st.lock);
+	return (code);
 }
 
-#define cond_init_authgss_hash() { \
-		do { \
-			if (!authgss_hash_st.initialized) \
-				authgss_hash_init(); \
-		} while (0); \
+/* false if the cache could not be set up */
+#define cond_init_authgss_hash() \
+	(likely(authgss_hash_st.initialized) || !authgss_hash_init())
+
+static inline struct svc_rpc_gss_data **
+authgss_ctx_slot(struct authgss_x_part *axp, uint32_t k)
+{
+	/* k selected the partition, skip those bits */
+	return (&axp->cache[(k / authgss_hash_st.xt.npart)
+			    % authgss_hash_st.xt.cachesz]);
+}
+
+/* Give the reference taken from a slot back to it, or drop it */
+static inline void
+authgss_ctx_slot_put(struct svc_rpc_gss_data **slot,
+		     struct svc_rpc_gss_data *gd)
+{
+	if (!atomic_cas_voidptr((void **)slot, NULL, gd)) {
+		/* refilled meanwhile */
+		unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
+		return;
 	}
 
+	/* raced with authgss_ctx_unhash(), whoever clears the slot
+	 * drops its reference */
+	if (unlikely(atomic_fetch_uint32_t(&gd->flags)
+		     & SVC_RPC_GSS_FLAG_UNHASHED)
+	    && atomic_cas_voidptr((void **)slot, gd, NULL))
+		unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
+}
+
+/* Called with the partition locked, after removal from the tree */
+static inline void
+authgss_ctx_unhash(struct authgss_x_part *axp, struct svc_rpc_gss_data *gd)
+{
+	(void)atomic_set_uint32_t_bits(&gd->flags, SVC_RPC_GSS_FLAG_UNHASHED);
+
+	if (atomic_cas_voidptr((void **)authgss_ctx_slot(axp, gd->hk.k),
+			       gd, NULL))
+		unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
+}
+
 struct svc_rpc_gss_data *
 authgss_ctx_hash_get(struct rpc_gss_cred *gc)
 {
-	struct svc_rpc_gss_data gk, *gd = NULL;
+	struct svc_rpc_gss_data gk, *gd = NULL, *old;
+	struct svc_rpc_gss_data **slot;
 	gss_union_ctx_id_desc *gss_ctx;
 	struct opr_rbtree_node *ngd;
 	struct authgss_x_part *axp;
 	struct rbtree_x_part *t;
 
-	cond_init_authgss_hash();
+	if (!cond_init_authgss_hash())
+		return (NULL);
 
 	gss_ctx = (gss_union_ctx_id_desc *) (gc->gc_ctx.value);
 	gk.hk.k = gss_ctx_hash(gss_ctx);
 
 	t = rbtx_partition_of_scalar(&authgss_hash_st.xt, gk.hk.k);
+	axp = (struct authgss_x_part *)t->u1;
+
+	slot = authgss_ctx_slot(axp, gk.hk.k);
+	gd = atomic_exchange_voidptr((void **)slot, NULL);
+	if (gd) {
+		if (likely(gd->hk.k == gk.hk.k
+			   && !(atomic_fetch_uint32_t(&gd->flags)
+				& SVC_RPC_GSS_FLAG_UNHASHED))) {
+			/* LRU order is left to misses, the idle
+			 * generation is kept exact */
+			(void)atomic_inc_uint32_t(&gd->refcnt);
+			atomic_store_uint32_t(&gd->gen,
+					      atomic_inc_uint32_t(&axp->gen));
+			authgss_ctx_slot_put(slot, gd);
+			return (gd);
+		}
+		authgss_ctx_slot_put(slot, gd);
+		gd = NULL;
+	}
+
 	mutex_lock(&t->mtx);
-	ngd =
-	    rbtree_x_cached_lookup(&authgss_hash_st.xt, t, &gk.node_k, gk.hk.k);
+	ngd = opr_rbtree_lookup(&t->t, &gk.node_k);
 	if (ngd) {
 		gd = opr_containerof(ngd, struct svc_rpc_gss_data, node_k);
 		/* lru adjust */
-		axp = (struct authgss_x_part *)t->u1;
 		TAILQ_REMOVE(&axp->lru_q, gd, lru_q);
 		TAILQ_INSERT_TAIL(&axp->lru_q, gd, lru_q);
-		++(axp->gen);
+		atomic_store_uint32_t(&gd->gen, atomic_inc_uint32_t(&axp->gen));
+		(void)atomic_inc_uint32_t(&gd->refcnt);
+		/* fill the slot with a reference of its own */
 		(void)atomic_inc_uint32_t(&gd->refcnt);
-		(void)atomic_inc_uint32_t(&gd->gen);
+		old = atomic_exchange_voidptr((void **)slot, gd);
+		if (old)
+			unref_svc_rpc_gss_data(old, SVC_RPC_GSS_FLAG_NONE);
 	}
 	mutex_unlock(&t->mtx);
 
@@ -188,7 +285,8 @@ authgss_ctx_hash_set(struct svc_rpc_gss_data *gd)
 	gss_union_ctx_id_desc *gss_ctx;
 	bool rslt;
 
-	cond_init_authgss_hash();
+	if (!cond_init_authgss_hash())
+		return (false);
 
 	gss_ctx = (gss_union_ctx_id_desc *) (gd->ctx);
 	gd->hk.k = gss_ctx_hash(gss_ctx);
@@ -196,12 +294,17 @@ authgss_ctx_hash_set(struct svc_rpc_gss_data *gd)
 	++(gd->refcnt);		/* locked */
 	t = rbtx_partition_of_scalar(&authgss_hash_st.xt, gd->hk.k);
 	mutex_lock(&t->mtx);
-	rslt =
-	    rbtree_x_cached_insert(&authgss_hash_st.xt, t, &gd->node_k,
-				   gd->hk.k);
+	rslt = (opr_rbtree_insert(&t->t, &gd->node_k) == NULL);
+	if (unlikely(!rslt)) {
+		/* hash collision, leave gd to the call */
+		mutex_unlock(&t->mtx);
+		--(gd->refcnt);
+		return (false);
+	}
 	/* lru */
 	axp = (struct authgss_x_part *)t->u1;
 	TAILQ_INSERT_TAIL(&axp->lru_q, gd, lru_q);
+	gd->gen = axp->gen;
 	mutex_unlock(&t->mtx);
 
 	/* global size */
@@ -216,13 +319,15 @@ authgss_ctx_hash_del(struct svc_rpc_gss_data *gd)
 	struct rbtree_x_part *t;
 	struct authgss_x_part *axp;
 
-	cond_init_authgss_hash();
+	if (!cond_init_authgss_hash())
+		return (false);
 
 	t = rbtx_partition_of_scalar(&authgss_hash_st.xt, gd->hk.k);
 	mutex_lock(&t->mtx);
-	rbtree_x_cached_remove(&authgss_hash_st.xt, t, &gd->node_k, gd->hk.k);
+	opr_rbtree_remove(&t->t, &gd->node_k);
 	axp = (struct authgss_x_part *)t->u1;
 	TAILQ_REMOVE(&axp->lru_q, gd, lru_q);
+	authgss_ctx_unhash(axp, gd);
 	mutex_unlock(&t->mtx);
 
 	/* global size */
@@ -253,10 +358,11 @@ void authgss_ctx_gc_idle(void)
 {
 	struct rbtree_x_part *xp;
 	struct authgss_x_part *axp;
-	struct svc_rpc_gss_data *gd;
+	struct svc_rpc_gss_data *gd, *last;
 	int ix, cnt, part;
 
-	cond_init_authgss_hash();
+	if (!cond_init_authgss_hash())
+		return;
 
 	for (ix = 0, part = IDLE_NEXT(); ix < authgss_hash_st.xt.npart;
 	     ++ix, part = IDLE_NEXT()) {
@@ -269,6 +375,18 @@ void authgss_ctx_gc_idle(void)
 		if (!gd)
 			goto next_t;
 
+		/* cache hits don't reorder the LRU, requeue the contexts
+		 * used after the current tail */
+		last = TAILQ_LAST(&axp->lru_q, ctx_tailq);
+		if ((int32_t)(atomic_fetch_uint32_t(&gd->gen)
+			      - atomic_fetch_uint32_t(&last->gen)) > 0) {
+			TAILQ_REMOVE(&axp->lru_q, gd, lru_q);
+			TAILQ_INSERT_TAIL(&axp->lru_q, gd, lru_q);
+			if (++cnt < authgss_hash_st.max_part)
+				goto again;
+			goto next_t;
+		}
+
 		if (unlikely((authgss_hash_st.size > __svc_params->gss.max_gc)
 			     ||
 			     ((abs(axp->gen - gd->gen) >
@@ -276,9 +394,9 @@ void authgss_ctx_gc_idle(void)
 			     || (authgss_ctx_expired(gd)))) {
 
 			/* remove entry */
-			rbtree_x_cached_remove(&authgss_hash_st.xt, xp,
-					       &gd->node_k, gd->hk.k);
+			opr_rbtree_remove(&xp->t, &gd->node_k);
 			TAILQ_REMOVE(&axp->lru_q, gd, lru_q);
+			authgss_ctx_unhash(axp, gd);
 			(void)atomic_dec_uint32_t(&authgss_hash_st.size);
 
 			/* drop sentinel ref (may free gd) */
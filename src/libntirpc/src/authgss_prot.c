@@ -43,6 +43,8 @@
 #include <rpc/auth_inline.h>
 #include <rpc/auth.h>
 #include <rpc/auth_gss.h>
+#include <rpc/svc_auth.h>
+#include <rpc/gss_internal.h>
 #include <rpc/rpc.h>
 #include <gssapi/gssapi.h>
 
@@ -138,9 +140,9 @@ xdr_rpc_gss_init_res(XDR *xdrs, struct rpc_gss_init_res *p)
 }
 
 bool
-xdr_rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
-		      gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
-		      u_int seq)
+rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
+		  gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
+		  u_int seq, mutex_t *ctx_lock)
 {
 	gss_buffer_desc databuf, wrapbuf;
 	OM_uint32 maj_stat, min_stat;
@@ -188,7 +190,11 @@ xdr_rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
 			return (FALSE);
 
 		/* Checksum rpc_gss_data_t. */
+		if (ctx_lock)
+			mutex_lock(ctx_lock);
 		maj_stat = gss_get_mic(&min_stat, ctx, qop, &databuf, &wrapbuf);
+		if (ctx_lock)
+			mutex_unlock(ctx_lock);
 		if (maj_stat != GSS_S_COMPLETE) {
 			log_debug("gss_get_mic failed");
 			return (FALSE);
@@ -204,9 +210,13 @@ xdr_rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
 		gss_release_buffer(&min_stat, &wrapbuf);
 	} else if (svc == RPCSEC_GSS_SVC_PRIVACY) {
 		/* Encrypt rpc_gss_data_t. */
+		if (ctx_lock)
+			mutex_lock(ctx_lock);
 		maj_stat =
 		    gss_wrap(&min_stat, ctx, TRUE, qop, &databuf, &conf_state,
 			     &wrapbuf);
+		if (ctx_lock)
+			mutex_unlock(ctx_lock);
 		if (maj_stat != GSS_S_COMPLETE) {
 			log_status("gss_wrap", maj_stat, min_stat);
 			return (FALSE);
@@ -228,82 +238,127 @@ xdr_rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
 }
 
 bool
-xdr_rpc_gss_unwrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
-			gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
-			u_int seq)
+xdr_rpc_gss_wrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
+		      gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
+		      u_int seq)
 {
-	XDR tmpxdrs;
-	gss_buffer_desc databuf, wrapbuf;
-	OM_uint32 maj_stat, min_stat;
-	u_int seq_num, qop_state;
-	int conf_state;
-	bool xdr_stat;
+	return (rpc_gss_wrap_data(xdrs, xdr_func, xdr_ptr, ctx, qop, svc, seq,
+				  NULL));
+}
 
-	if (xdr_func == (xdrproc_t) xdr_void || xdr_ptr == NULL)
-		return (TRUE);
+bool
+xdr_rpc_gss_body(XDR *xdrs, struct svc_rpc_gss_body *body)
+{
+	OM_uint32 min_stat;
 
-	memset(&databuf, 0, sizeof(databuf));
-	memset(&wrapbuf, 0, sizeof(wrapbuf));
+	memset(&body->databuf, 0, sizeof(body->databuf));
+	memset(&body->wrapbuf, 0, sizeof(body->wrapbuf));
 
-	if (svc == RPCSEC_GSS_SVC_INTEGRITY) {
+	if (body->svc == RPCSEC_GSS_SVC_INTEGRITY) {
 		/* Decode databody_integ. */
-		if (!xdr_rpc_gss_buf(xdrs, &databuf, (u_int) -1)) {
+		if (!xdr_rpc_gss_buf(xdrs, &body->databuf, (u_int) -1)) {
 			log_debug("xdr decode databody_integ failed");
 			return (FALSE);
 		}
 		/* Decode checksum. */
-		if (!xdr_rpc_gss_buf(xdrs, &wrapbuf, (u_int) -1)) {
-			gss_release_buffer(&min_stat, &databuf);
+		if (!xdr_rpc_gss_buf(xdrs, &body->wrapbuf, (u_int) -1)) {
+			gss_release_buffer(&min_stat, &body->databuf);
 			log_debug("xdr decode checksum failed");
 			return (FALSE);
 		}
-		/* Verify checksum and QOP. */
-		maj_stat =
-		    gss_verify_mic(&min_stat, ctx, &databuf, &wrapbuf,
-				   &qop_state);
-		gss_release_buffer(&min_stat, &wrapbuf);
-
-		if (maj_stat != GSS_S_COMPLETE || qop_state != qop) {
-			gss_release_buffer(&min_stat, &databuf);
-			log_status("gss_verify_mic", maj_stat, min_stat);
-			return (FALSE);
-		}
-	} else if (svc == RPCSEC_GSS_SVC_PRIVACY) {
+	} else if (body->svc == RPCSEC_GSS_SVC_PRIVACY) {
 		/* Decode databody_priv. */
-		if (!xdr_rpc_gss_buf(xdrs, &wrapbuf, (u_int) -1)) {
+		if (!xdr_rpc_gss_buf(xdrs, &body->wrapbuf, (u_int) -1)) {
 			log_debug("xdr decode databody_priv failed");
 			return (FALSE);
 		}
-		/* Decrypt databody. */
-		maj_stat =
-		    gss_unwrap(&min_stat, ctx, &wrapbuf, &databuf, &conf_state,
-			       &qop_state);
+	}
+	return (TRUE);
+}
 
-		gss_release_buffer(&min_stat, &wrapbuf);
+void
+rpc_gss_release_body(struct svc_rpc_gss_body *body)
+{
+	OM_uint32 min_stat;
 
-		/* Verify encryption and QOP. */
-		if (maj_stat != GSS_S_COMPLETE || qop_state != qop
-		    || conf_state != TRUE) {
-			gss_release_buffer(&min_stat, &databuf);
-			log_status("gss_unwrap", maj_stat, min_stat);
-			return (FALSE);
-		}
+	gss_release_buffer(&min_stat, &body->databuf);
+	gss_release_buffer(&min_stat, &body->wrapbuf);
+}
+
+bool
+rpc_gss_unwrap_body(struct svc_rpc_gss_body *body, xdrproc_t xdr_func,
+		    caddr_t xdr_ptr, gss_ctx_id_t ctx, gss_qop_t qop,
+		    mutex_t *ctx_lock)
+{
+	XDR tmpxdrs;
+	OM_uint32 maj_stat = GSS_S_COMPLETE;
+	OM_uint32 min_stat;
+	u_int seq_num, qop_state = qop;
+	int conf_state = TRUE;
+	bool xdr_stat;
+
+	if (ctx_lock)
+		mutex_lock(ctx_lock);
+	if (body->svc == RPCSEC_GSS_SVC_INTEGRITY) {
+		/* Verify checksum and QOP. */
+		maj_stat =
+		    gss_verify_mic(&min_stat, ctx, &body->databuf,
+				   &body->wrapbuf, &qop_state);
+	} else if (body->svc == RPCSEC_GSS_SVC_PRIVACY) {
+		/* Decrypt databody. */
+		maj_stat =
+		    gss_unwrap(&min_stat, ctx, &body->wrapbuf, &body->databuf,
+			       &conf_state, &qop_state);
 	}
+	if (ctx_lock)
+		mutex_unlock(ctx_lock);
+
+	gss_release_buffer(&min_stat, &body->wrapbuf);
+
+	/* Verify encryption and QOP. */
+	if (maj_stat != GSS_S_COMPLETE || qop_state != qop
+	    || conf_state != TRUE) {
+		gss_release_buffer(&min_stat, &body->databuf);
+		log_status(body->svc == RPCSEC_GSS_SVC_PRIVACY
+			   ? "gss_unwrap" : "gss_verify_mic",
+			   maj_stat, min_stat);
+		return (FALSE);
+	}
+
 	/* Decode rpc_gss_data_t (sequence number + arguments). */
-	xdrmem_create(&tmpxdrs, databuf.value, databuf.length, XDR_DECODE);
+	xdrmem_create(&tmpxdrs, body->databuf.value, body->databuf.length,
+		      XDR_DECODE);
 	xdr_stat = (xdr_u_int(&tmpxdrs, &seq_num)
 		    && (*xdr_func) (&tmpxdrs, xdr_ptr));
 	XDR_DESTROY(&tmpxdrs);
-	gss_release_buffer(&min_stat, &databuf);
+	gss_release_buffer(&min_stat, &body->databuf);
 
 	/* Verify sequence number. */
-	if (xdr_stat == TRUE && seq_num != seq) {
+	if (xdr_stat == TRUE && seq_num != body->seq) {
 		log_debug("wrong sequence number in databody");
 		return (FALSE);
 	}
 	return (xdr_stat);
 }
 
+bool
+xdr_rpc_gss_unwrap_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
+			gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
+			u_int seq)
+{
+	struct svc_rpc_gss_body body;
+
+	if (xdr_func == (xdrproc_t) xdr_void || xdr_ptr == NULL)
+		return (TRUE);
+
+	body.svc = svc;
+	body.seq = seq;
+	if (!xdr_rpc_gss_body(xdrs, &body))
+		return (FALSE);
+
+	return (rpc_gss_unwrap_body(&body, xdr_func, xdr_ptr, ctx, qop, NULL));
+}
+
 bool
 xdr_rpc_gss_data(XDR *xdrs, xdrproc_t xdr_func, caddr_t xdr_ptr,
 		 gss_ctx_id_t ctx, gss_qop_t qop, rpc_gss_svc_t svc,
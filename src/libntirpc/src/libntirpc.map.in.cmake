@@ -147,6 +147,7 @@ NTIRPC_${NTIRPC_VERSION} {
     setrpcent;
     svc_auth_authenticate;
     svc_auth_reg;
+    svc_dg_enable_mmsg;
     svc_dg_ncreate;
     svc_exit;
     svc_fd_ncreate;
@@ -159,6 +160,7 @@ NTIRPC_${NTIRPC_VERSION} {
     svc_register;
     svc_rqst_new_evchan;
     svc_rqst_evchan_reg;
+    svc_rqst_evchan_move;
     svc_rqst_evchan_unreg;
     svc_rqst_rearm_events;
     svc_rqst_thrd_run;
@@ -176,6 +178,7 @@ NTIRPC_${NTIRPC_VERSION} {
     svc_vc_ncreate2;
     svc_xprt_trace;
     svcauth_gss_acquire_cred;
+    svcauth_gss_complete_args;
     svcauth_gss_destroy;
     svcauth_gss_get_principal;
     svcauth_gss_import_name;
@@ -54,8 +54,11 @@ int rbtx_init(struct rbtree_x *xt, opr_rbtree_cmpf_t cmpf, uint32_t npart,
 			"(suggest a small prime)", npart);
 	}
 
-	if (flags & RBT_X_FLAG_ALLOC)
+	if (flags & RBT_X_FLAG_ALLOC) {
 		xt->tree = mem_alloc(npart * sizeof(struct rbtree_x_part));
+		if (!xt->tree)
+			return (ENOMEM);
+	}
 
 	/* prior versions of Linux tirpc are subject to default prefer-reader
 	 * behavior (so have potential for writer starvation) */
@@ -216,6 +216,8 @@ svc_init(svc_init_params *params)
 	else
 		__svc_params->gss.max_gc = 200;
 
+	__svc_params->gss.defer_min = params->gss_defer_min;
+
 #ifdef USE_RPC_RDMA
 	rpc_rdma_internals_init();
 #endif
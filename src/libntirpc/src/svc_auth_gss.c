@@ -42,6 +42,7 @@
 #include <rpc/svc.h>
 #include <rpc/svc_auth.h>
 #include "rpc_com.h"
+#include "svc_internal.h"
 #include <rpc/gss_internal.h>
 #include <misc/portable.h>
 
@@ -419,6 +420,7 @@ _svcauth_gss(struct svc_req *req, struct rpc_msg *msg,
 
 	/* Initialize reply. */
 	req->rq_verf = _null_auth;
+	req->rq_ap2 = NULL;
 
 	/* Unserialize client credentials. */
 	if (req->rq_cred.oa_length <= 0)
@@ -652,6 +654,13 @@ svcauth_gss_release(SVCAUTH *auth, struct svc_req *req)
 	struct svc_rpc_gss_data *gd;
 	caddr_t last_oa_base;
 
+	if (req->rq_ap2) {
+		/* arguments left wrapped and never decoded */
+		rpc_gss_release_body(req->rq_ap2);
+		mem_free(req->rq_ap2, sizeof(struct svc_rpc_gss_body));
+		req->rq_ap2 = NULL;
+	}
+
 	gd = SVCAUTH_PRIVATE(auth);
 	if (gd)
 		unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
@@ -697,35 +706,74 @@ bool
 svcauth_gss_wrap(SVCAUTH *auth, struct svc_req *req, XDR *xdrs,
 		 xdrproc_t xdr_func, caddr_t xdr_ptr)
 {
-	bool result;
 	struct svc_rpc_gss_data *gd = SVCAUTH_PRIVATE(req->rq_auth);
 	u_int gc_seq = (u_int) (uintptr_t) req->rq_ap1;
+	rpc_gss_svc_t svc = gd->sec.svc;
 
-	if (!gd->established || gd->sec.svc == RPCSEC_GSS_SVC_NONE)
+	if (!gd->established || svc == RPCSEC_GSS_SVC_NONE)
 		return ((*xdr_func) (xdrs, xdr_ptr));
 
-	mutex_lock(&gd->lock);
-	result = xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr, gd->ctx,
-				  gd->sec.qop, gd->sec.svc, gc_seq);
-	mutex_unlock(&gd->lock);
-	return (result);
+	/* gd->lock is only held around gss_get_mic or gss_wrap, results
+	 * are encoded in parallel with other calls on the context */
+	return (rpc_gss_wrap_data(xdrs, xdr_func, xdr_ptr, gd->ctx,
+				  gd->sec.qop, svc, gc_seq, &gd->lock));
 }
 
 bool
 svcauth_gss_unwrap(SVCAUTH *auth, struct svc_req *req, XDR *xdrs,
 		   xdrproc_t xdr_func, caddr_t xdr_ptr)
 {
-	bool result;
 	struct svc_rpc_gss_data *gd = SVCAUTH_PRIVATE(req->rq_auth);
-	u_int gc_seq = (u_int) (uintptr_t) req->rq_ap1;
+	struct svc_rpc_gss_body body;
+
+	body.svc = gd->sec.svc;
+	body.seq = (u_int) (uintptr_t) req->rq_ap1;
 
-	if (!gd->established || gd->sec.svc == RPCSEC_GSS_SVC_NONE)
+	if (!gd->established || body.svc == RPCSEC_GSS_SVC_NONE)
 		return ((*xdr_func) (xdrs, xdr_ptr));
 
-	mutex_lock(&gd->lock);
-	result = xdr_rpc_gss_data(xdrs, xdr_func, xdr_ptr, gd->ctx,
-				  gd->sec.qop, gd->sec.svc, gc_seq);
-	mutex_unlock(&gd->lock);
+	if (xdr_func == (xdrproc_t) xdr_void || xdr_ptr == NULL)
+		return (TRUE);
+
+	/* Reading the body needs no lock, it is private to the call */
+	if (!xdr_rpc_gss_body(xdrs, &body))
+		return (FALSE);
+
+	/* Leave large bodies to svcauth_gss_complete_args(), so that
+	 * the transport can go on decoding the next call */
+	if (__svc_params->gss.defer_min
+	    && svc_rpc_gss_body_len(&body) >= __svc_params->gss.defer_min) {
+		req->rq_ap2 = mem_alloc(sizeof(struct svc_rpc_gss_body));
+		if (req->rq_ap2) {
+			memcpy(req->rq_ap2, &body, sizeof(body));
+			return (TRUE);
+		}
+	}
+
+	return (rpc_gss_unwrap_body(&body, xdr_func, xdr_ptr, gd->ctx,
+				    gd->sec.qop, &gd->lock));
+}
+
+bool
+svcauth_gss_complete_args(struct svc_req *req, xdrproc_t xdr_func,
+			  caddr_t xdr_ptr)
+{
+	struct svc_rpc_gss_data *gd = SVCAUTH_PRIVATE(req->rq_auth);
+	struct svc_rpc_gss_body *body = req->rq_ap2;
+	bool result;
+
+	if (!body)
+		return (TRUE);
+	req->rq_ap2 = NULL;
+
+	result = rpc_gss_unwrap_body(body, xdr_func, xdr_ptr, gd->ctx,
+				     gd->sec.qop, &gd->lock);
+	mem_free(body, sizeof(*body));
+
+	__warnx(TIRPC_DEBUG_FLAG_RPCSEC_GSS,
+		"%s: xid %u %s", __func__, req->rq_xid,
+		result ? "unwrapped" : "failed");
+
 	return (result);
 }
 
@@ -81,6 +81,7 @@ static int svc_dg_cache_get(SVCXPRT *, struct rpc_msg *, char **, size_t *);
 static void svc_dg_cache_set(SVCXPRT *, size_t);
 static void svc_dg_enable_pktinfo(int, const struct __rpc_sockinfo *);
 static int svc_dg_store_pktinfo(struct msghdr *, struct svc_req *);
+static bool svc_dg_mmsg_pending(SVCXPRT *);
 
 /*
  * Usage:
@@ -141,6 +142,7 @@ svc_dg_ncreate(int fd, u_int sendsize, u_int recvsize)
 		      XDR_DECODE);
 
 	su->su_cache = NULL;
+	su->su_mmsg = NULL;
 	xprt->xp_flags = SVC_XPRT_FLAG_NONE;
 	xprt->xp_refs = 1;
 	xprt->xp_fd = fd;
@@ -202,6 +204,8 @@ svc_dg_ncreate(int fd, u_int sendsize, u_int recvsize)
 static enum xprt_stat
 svc_dg_stat(SVCXPRT *xprt)
 {
+	if (svc_dg_mmsg_pending(xprt))
+		return (XPRT_MOREREQS);
 	return (XPRT_IDLE);
 }
 
@@ -241,6 +245,358 @@ static void svc_dg_set_pktinfo(struct cmsghdr *cmsg, struct svc_req *req)
 	}
 }
 
+/*
+ * recvmmsg/sendmmsg batching, see svc_dg_enable_mmsg().
+ *
+ * Received datagrams land in a ring of dm_count buffers filled by one
+ * recvmmsg.  svc_dg_recv hands them out one at a time, and svc_dg_stat
+ * reports XPRT_MOREREQS while some are left, so the caller keeps
+ * decoding without going back to the event channel.  The ring is only
+ * touched with the transport locked.
+ *
+ * Replies are encoded into one of dm_count send buffers and queued.
+ * svc_dg_unlock flushes the queue with sendmmsg once the transport
+ * lock is dropped.  Only one thread flushes at a time; replies queued
+ * while it is in sendmmsg go out in its next call, which is where the
+ * batching comes from under load.  When all the send buffers are busy
+ * the reply is sent directly, as without batching.
+ */
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+
+/* Datagrams larger than this do not exist */
+#define SVC_DG_MMSG_SLOTSZ (64 * 1024)
+
+struct svc_dg_slot {
+	struct sockaddr_storage ds_addr;
+	struct iovec ds_iov;
+	unsigned char ds_cmsg[SVC_CMSG_LEN];
+	struct msghdr ds_msghdr;	/* send side only */
+	char *ds_buf;
+};
+
+struct svc_dg_mmsg {
+	u_int dm_count;			/* datagrams per system call */
+	size_t dm_slotsz;		/* size of each buffer */
+	char *dm_bufs;			/* all the buffers */
+
+	/* receive ring */
+	struct mmsghdr *dm_rmsg;
+	struct svc_dg_slot *dm_rslot;
+	u_int dm_rnext;			/* next datagram to decode */
+	u_int dm_rcount;		/* datagrams in the ring */
+
+	/* send queue, protected by dm_slock */
+	mutex_t dm_slock;
+	struct mmsghdr *dm_smsg;	/* vector of the flush in progress */
+	struct svc_dg_slot *dm_sslot;
+	u_int *dm_sfree;		/* free send slots */
+	u_int dm_nfree;
+	u_int *dm_squeue;		/* slots waiting for sendmmsg */
+	u_int dm_nqueued;
+	u_int *dm_sflush;		/* slots of the flush in progress */
+	bool dm_flushing;
+};
+
+static void
+svc_dg_mmsg_free(struct svc_dg_mmsg *dm)
+{
+	if (dm == NULL)
+		return;
+
+	mutex_destroy(&dm->dm_slock);
+	mem_free(dm->dm_bufs, 0);
+	mem_free(dm->dm_rmsg, 0);
+	mem_free(dm->dm_rslot, 0);
+	mem_free(dm->dm_smsg, 0);
+	mem_free(dm->dm_sslot, 0);
+	mem_free(dm->dm_sfree, 0);
+	mem_free(dm->dm_squeue, 0);
+	mem_free(dm->dm_sflush, 0);
+	mem_free(dm, sizeof(*dm));
+}
+
+static struct svc_dg_mmsg *
+svc_dg_mmsg_alloc(u_int count, size_t iosz)
+{
+	struct svc_dg_mmsg *dm;
+	u_int i;
+
+	dm = mem_zalloc(sizeof(*dm));
+	if (dm == NULL)
+		return (NULL);
+
+	mutex_init(&dm->dm_slock, NULL);
+	dm->dm_count = count;
+	dm->dm_slotsz = MIN(iosz, SVC_DG_MMSG_SLOTSZ);
+	dm->dm_bufs = mem_alloc(2 * count * dm->dm_slotsz);
+	dm->dm_rmsg = mem_zalloc(count * sizeof(struct mmsghdr));
+	dm->dm_rslot = mem_zalloc(count * sizeof(struct svc_dg_slot));
+	dm->dm_smsg = mem_zalloc(count * sizeof(struct mmsghdr));
+	dm->dm_sslot = mem_zalloc(count * sizeof(struct svc_dg_slot));
+	dm->dm_sfree = mem_zalloc(count * sizeof(u_int));
+	dm->dm_squeue = mem_zalloc(count * sizeof(u_int));
+	dm->dm_sflush = mem_zalloc(count * sizeof(u_int));
+
+	if (dm->dm_bufs == NULL || dm->dm_rmsg == NULL ||
+	    dm->dm_rslot == NULL || dm->dm_smsg == NULL ||
+	    dm->dm_sslot == NULL || dm->dm_sfree == NULL ||
+	    dm->dm_squeue == NULL || dm->dm_sflush == NULL) {
+		svc_dg_mmsg_free(dm);
+		return (NULL);
+	}
+
+	for (i = 0; i < count; i++) {
+		dm->dm_rslot[i].ds_buf = dm->dm_bufs + i * dm->dm_slotsz;
+		dm->dm_sslot[i].ds_buf =
+		    dm->dm_bufs + (count + i) * dm->dm_slotsz;
+		dm->dm_sfree[i] = i;
+	}
+	dm->dm_nfree = count;
+
+	return (dm);
+}
+
+/*
+ * Refill the receive ring.  Returns false if nothing was waiting.
+ */
+static bool
+svc_dg_mmsg_fill(SVCXPRT *xprt, struct svc_dg_mmsg *dm)
+{
+	u_int i;
+	int n;
+
+	for (i = 0; i < dm->dm_count; i++) {
+		struct svc_dg_slot *slot = &dm->dm_rslot[i];
+		struct msghdr *mesgp = &dm->dm_rmsg[i].msg_hdr;
+
+		slot->ds_iov.iov_base = slot->ds_buf;
+		slot->ds_iov.iov_len = dm->dm_slotsz;
+		mesgp->msg_iov = &slot->ds_iov;
+		mesgp->msg_iovlen = 1;
+		mesgp->msg_name = &slot->ds_addr;
+		mesgp->msg_namelen = sizeof(slot->ds_addr);
+		mesgp->msg_control = slot->ds_cmsg;
+		mesgp->msg_controllen = sizeof(slot->ds_cmsg);
+		mesgp->msg_flags = 0;
+		dm->dm_rmsg[i].msg_len = 0;
+	}
+
+	dm->dm_rnext = 0;
+	dm->dm_rcount = 0;
+
+	do {
+		n = recvmmsg(xprt->xp_fd, dm->dm_rmsg, dm->dm_count,
+			     MSG_DONTWAIT, NULL);
+	} while (n == -1 && errno == EINTR);
+
+	if (n <= 0)
+		return (false);
+
+	dm->dm_rcount = n;
+	return (true);
+}
+
+/*
+ * Next datagram from the receive ring, refilling it if empty.
+ */
+static bool
+svc_dg_mmsg_recv(SVCXPRT *xprt, struct msghdr **mesgp, ssize_t *rlen)
+{
+	struct svc_dg_mmsg *dm = su_data(xprt)->su_mmsg;
+	struct mmsghdr *mm;
+
+	for (;;) {
+		if (dm->dm_rnext >= dm->dm_rcount &&
+		    !svc_dg_mmsg_fill(xprt, dm))
+			return (false);
+
+		mm = &dm->dm_rmsg[dm->dm_rnext++];
+		if (mm->msg_len < 4 * sizeof(u_int32_t))
+			continue;	/* runt, drop it */
+
+		*mesgp = &mm->msg_hdr;
+		*rlen = mm->msg_len;
+		return (true);
+	}
+}
+
+static bool
+svc_dg_mmsg_pending(SVCXPRT *xprt)
+{
+	struct svc_dg_mmsg *dm = su_data(xprt)->su_mmsg;
+
+	return (dm != NULL && dm->dm_rnext < dm->dm_rcount);
+}
+
+/*
+ * Take a free send slot.  Returns -1 if all of them are busy.
+ */
+static int
+svc_dg_mmsg_get_slot(struct svc_dg_mmsg *dm)
+{
+	int idx = -1;
+
+	mutex_lock(&dm->dm_slock);
+	if (dm->dm_nfree > 0)
+		idx = dm->dm_sfree[--dm->dm_nfree];
+	mutex_unlock(&dm->dm_slock);
+
+	return (idx);
+}
+
+static void
+svc_dg_mmsg_put_slot(struct svc_dg_mmsg *dm, u_int idx)
+{
+	mutex_lock(&dm->dm_slock);
+	dm->dm_sfree[dm->dm_nfree++] = idx;
+	mutex_unlock(&dm->dm_slock);
+}
+
+/*
+ * Queue the reply encoded in send slot idx, slen bytes long.
+ */
+static void
+svc_dg_mmsg_queue(struct svc_dg_mmsg *dm, u_int idx, size_t slen,
+		  struct svc_req *req)
+{
+	struct svc_dg_slot *slot = &dm->dm_sslot[idx];
+	struct msghdr *msg = &slot->ds_msghdr;
+
+	memcpy(&slot->ds_addr, &req->rq_raddr, req->rq_raddr_len);
+	slot->ds_iov.iov_base = slot->ds_buf;
+	slot->ds_iov.iov_len = slen;
+
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_iov = &slot->ds_iov;
+	msg->msg_iovlen = 1;
+	msg->msg_name = &slot->ds_addr;
+	msg->msg_namelen = req->rq_raddr_len;
+
+	/* Set source IP address of the reply message in PKTINFO */
+	if (req->rq_daddr_len != 0) {
+		struct cmsghdr *cmsg = (struct cmsghdr *)slot->ds_cmsg;
+
+		msg->msg_control = slot->ds_cmsg;
+		svc_dg_set_pktinfo(cmsg, req);
+		msg->msg_controllen = CMSG_ALIGN(cmsg->cmsg_len);
+	}
+
+	mutex_lock(&dm->dm_slock);
+	dm->dm_squeue[dm->dm_nqueued++] = idx;
+	mutex_unlock(&dm->dm_slock);
+}
+
+/*
+ * Send the queued replies.  Called without the transport lock.
+ */
+static void
+svc_dg_mmsg_flush(SVCXPRT *xprt)
+{
+	struct svc_dg_mmsg *dm = su_data(xprt)->su_mmsg;
+	u_int i, n, sent;
+	int rc;
+
+	if (dm == NULL)
+		return;
+
+	mutex_lock(&dm->dm_slock);
+	if (dm->dm_flushing || dm->dm_nqueued == 0) {
+		mutex_unlock(&dm->dm_slock);
+		return;
+	}
+	dm->dm_flushing = true;
+
+	while (dm->dm_nqueued > 0) {
+		n = dm->dm_nqueued;
+		memcpy(dm->dm_sflush, dm->dm_squeue, n * sizeof(u_int));
+		dm->dm_nqueued = 0;
+		mutex_unlock(&dm->dm_slock);
+
+		for (i = 0; i < n; i++) {
+			dm->dm_smsg[i].msg_hdr =
+			    dm->dm_sslot[dm->dm_sflush[i]].ds_msghdr;
+			dm->dm_smsg[i].msg_len = 0;
+		}
+
+		for (sent = 0; sent < n; sent += rc) {
+			rc = sendmmsg(xprt->xp_fd, &dm->dm_smsg[sent],
+				      n - sent, MSG_DONTWAIT);
+			if (rc == -1 && errno == EINTR) {
+				rc = 0;
+				continue;
+			}
+			if (rc <= 0) {
+				/* Lost, as a failed sendmsg would be */
+				__warnx(TIRPC_DEBUG_FLAG_SVC_DG,
+					"%s: sendmmsg failed on fd %d (%d)",
+					__func__, xprt->xp_fd, errno);
+				rc = 1;
+			}
+		}
+
+		mutex_lock(&dm->dm_slock);
+		for (i = 0; i < n; i++)
+			dm->dm_sfree[dm->dm_nfree++] = dm->dm_sflush[i];
+	}
+
+	dm->dm_flushing = false;
+	mutex_unlock(&dm->dm_slock);
+}
+
+#else				/* HAVE_RECVMMSG && HAVE_SENDMMSG */
+
+static void
+svc_dg_mmsg_free(struct svc_dg_mmsg *dm)
+{
+}
+
+static inline bool
+svc_dg_mmsg_recv(SVCXPRT *xprt, struct msghdr **mesgp, ssize_t *rlen)
+{
+	return (false);
+}
+
+static bool
+svc_dg_mmsg_pending(SVCXPRT *xprt)
+{
+	return (false);
+}
+
+static inline void
+svc_dg_mmsg_flush(SVCXPRT *xprt)
+{
+}
+
+#endif				/* HAVE_RECVMMSG && HAVE_SENDMMSG */
+
+/*
+ * Enable recvmmsg/sendmmsg batching of count datagrams.  Returns 1 on
+ * success, 0 on failure.  Replies are only sent when the transport is
+ * unlocked, so callers must serialize with SVC_LOCK and SVC_UNLOCK.
+ * The duplicate request cache, when enabled, keeps replies sent one at
+ * a time.  There is no disable.
+ */
+int
+svc_dg_enable_mmsg(SVCXPRT *xprt, u_int count)
+{
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+	struct svc_dg_data *su = su_data(xprt);
+
+	if (count < 2 || su->su_mmsg != NULL)
+		return (0);
+
+	su->su_mmsg = svc_dg_mmsg_alloc(count, su->su_iosz);
+	if (su->su_mmsg == NULL) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_DG, svc_dg_str, __no_mem_str);
+		return (0);
+	}
+	return (1);
+#else
+	return (0);
+#endif
+}
+
 static bool
 svc_dg_recv(SVCXPRT *xprt, struct svc_req *req)
 {
@@ -254,12 +610,20 @@ svc_dg_recv(SVCXPRT *xprt, struct svc_req *req)
 	size_t replylen;
 	ssize_t rlen;
 
+	req->rq_msg = alloc_rpc_msg();
+
+	if (su->su_mmsg != NULL) {
+		if (!svc_dg_mmsg_recv(xprt, &mesgp, &rlen))
+			return (false);
+		iov = *mesgp->msg_iov;
+		xdrmem_create(xdrs, iov.iov_base, iov.iov_len, XDR_DECODE);
+		goto received;
+	}
+
 	memset(&ss, 0xff, sizeof(struct sockaddr_storage));
 
 	/* Magic marker value to see if we didn't get the header. */
 
-	req->rq_msg = alloc_rpc_msg();
-
  again:
 	iov.iov_base = rpc_buffer(xprt);
 	iov.iov_len = su->su_iosz;
@@ -283,7 +647,9 @@ svc_dg_recv(SVCXPRT *xprt, struct svc_req *req)
 	if (rlen == -1 || (rlen < (ssize_t) (4 * sizeof(u_int32_t))))
 		return (false);
 
-	__rpc_set_address(&xprt->xp_remote, &ss, mesgp->msg_namelen);
+ received:
+	__rpc_set_address(&xprt->xp_remote, mesgp->msg_name,
+			  mesgp->msg_namelen);
 
 	/* Check whether there's an IP_PKTINFO or IP6_PKTINFO control message.
 	 * If yes, preserve it for svc_dg_reply; otherwise just zap any cmsgs */
@@ -323,6 +689,8 @@ svc_dg_recv(SVCXPRT *xprt, struct svc_req *req)
 		if (svc_dg_cache_get(xprt, req->rq_msg, &reply, &replylen)) {
 			iov.iov_base = reply;
 			iov.iov_len = replylen;
+			mesgp->msg_iov = &iov;
+			mesgp->msg_iovlen = 1;
 
 			/* Set source IP address of the reply message in
 			 * PKTINFO
@@ -370,8 +738,31 @@ svc_dg_reply(SVCXPRT *xprt, struct svc_req *req, struct rpc_msg *msg)
 		has_args = false;
 	}
 
-	xdrs->x_op = XDR_ENCODE;
-	XDR_SETPOS(xdrs, 0);
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+	if (su->su_mmsg != NULL && su->su_cache == NULL) {
+		struct svc_dg_mmsg *dm = su->su_mmsg;
+		int idx = svc_dg_mmsg_get_slot(dm);
+
+		if (idx >= 0) {
+			xdrmem_create(xdrs, dm->dm_sslot[idx].ds_buf,
+				      dm->dm_slotsz, XDR_ENCODE);
+
+			if (xdr_replymsg(xdrs, msg) && req->rq_raddr_len
+			    && (!has_args
+				|| SVCAUTH_WRAP(req->rq_auth, req, xdrs,
+						xdr_results, xdr_location))) {
+				/* sent by svc_dg_unlock */
+				svc_dg_mmsg_queue(dm, idx, XDR_GETPOS(xdrs),
+						  req);
+				return (true);
+			}
+			svc_dg_mmsg_put_slot(dm, idx);
+			return (false);
+		}
+	}
+#endif
+
+	xdrmem_create(xdrs, rpc_buffer(xprt), su->su_iosz, XDR_ENCODE);
 
 	if (xdr_replymsg(xdrs, msg) && req->rq_raddr_len
 	    && (!has_args
@@ -446,6 +837,9 @@ svc_dg_unlock(SVCXPRT *xprt, uint32_t flags, const char *file,
 {
 	rpc_dplx_rux(xprt);
 	rpc_dplx_sux(xprt);
+
+	/* queued replies, if batching */
+	svc_dg_mmsg_flush(xprt);
 }
 
 static void
@@ -461,9 +855,13 @@ svc_dg_destroy(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 		" should actually destroy things @ %s:%d",
 		__func__, xprt, xprt->xp_refs, tag, line);
 
+	svc_dg_mmsg_flush(xprt);
+
 	if (xprt->xp_fd != -1)
 		(void)close(xprt->xp_fd);
 
+	svc_dg_mmsg_free(su->su_mmsg);
+
 	XDR_DESTROY(&(su->su_xdrs));
 	(void)mem_free(rpc_buffer(xprt), su->su_iosz);
 	(void)mem_free(su, sizeof(*su));
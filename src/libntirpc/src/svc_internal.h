@@ -66,6 +66,7 @@ struct svc_params {
 		int max_ctx;
 		int max_idle_gen;
 		int max_gc;
+		u_int defer_min;
 	} gss;
 
 	struct {
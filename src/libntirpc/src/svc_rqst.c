@@ -741,6 +741,81 @@ svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 	return (0);
 }
 
+/*
+ * Move xprt to event channel chan_id, in lieu of svc_rqst_rearm_events.
+ *
+ * The caller owns xprt as for a rearm: its oneshot event fired and it is
+ * not armed anywhere, so no channel can have a pending event for it.  It
+ * is armed on its new channel, or rearmed where it is when it could not
+ * be moved.
+ *
+ * @note Locking
+ * - Takes both channel locks, in channel id order, then the xprt lock
+ */
+int
+svc_rqst_evchan_move(uint32_t chan_id, SVCXPRT *xprt,
+		     uint32_t __attribute__ ((unused)) flags)
+{
+	struct svc_rqst_rec *sr_rec;
+	struct svc_rqst_rec *old_rec;
+	struct rbtree_x_part *t;
+	bool moved = false;
+	int code = 0;
+
+	cond_init_svc_rqst();
+
+	if (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		goto out;
+
+	sr_rec = svc_rqst_lookup_chan(chan_id, &t, SVC_RQST_FLAG_PART_UNLOCK);
+	if (!sr_rec) {
+		code = ENOENT;
+		goto out;
+	}
+
+	old_rec = (struct svc_rqst_rec *)xprt->xp_ev;
+	if (!old_rec || old_rec == sr_rec) {
+		sr_rec_release(sr_rec, SVC_RQST_FLAG_SREC_LOCKED);
+		return (svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE));
+	}
+
+	if (old_rec->id_k < sr_rec->id_k) {
+		mutex_unlock(&sr_rec->mtx);
+		mutex_lock(&old_rec->mtx);
+		mutex_lock(&sr_rec->mtx);
+	} else
+		mutex_lock(&old_rec->mtx);
+
+	mutex_lock(&xprt->xp_lock);
+
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+	    && xprt->xp_ev == old_rec) {
+		TAILQ_REMOVE(&old_rec->xprt_q, xprt, xp_evq);
+		(void)svc_rqst_unhook_events(xprt, old_rec);
+
+		TAILQ_INSERT_TAIL(&sr_rec->xprt_q, xprt, xp_evq);
+		xprt->xp_ev = sr_rec;
+		(void)svc_rqst_hook_events(xprt, sr_rec);
+
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d moved from evchan %d to %d",
+			__func__, xprt, xprt->xp_fd, old_rec->id_k,
+			sr_rec->id_k);
+		moved = true;
+	}
+
+	mutex_unlock(&xprt->xp_lock);
+	mutex_unlock(&old_rec->mtx);
+	sr_rec_release(sr_rec, SVC_RQST_FLAG_SREC_LOCKED);
+
+	/* Not moved, so still disarmed where it was */
+	if (!moved)
+		code = svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+
+ out:
+	return (code);
+}
+
 static int
 svc_rqst_hook_events(SVCXPRT *xprt /* LOCKED */ ,
 		     struct svc_rqst_rec *sr_rec /* LOCKED */)
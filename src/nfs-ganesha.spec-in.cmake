@@ -36,6 +36,15 @@ Requires: sles-release >= 12
 @BCOND_NULLFS@ nullfs
 %global use_fsal_null %{on_off_switch nullfs}
 
+@BCOND_MEM@ mem
+%global use_fsal_mem %{on_off_switch mem}
+
+@BCOND_PROF@ prof
+%global use_fsal_prof %{on_off_switch prof}
+
+@BCOND_BCACHE@ bcache
+%global use_fsal_bcache %{on_off_switch bcache}
+
 @BCOND_GPFS@ gpfs
 %global use_fsal_gpfs %{on_off_switch gpfs}
 
@@ -245,6 +254,42 @@ This package contains a Stackable FSAL shared object to
 be used with NFS-Ganesha. This is mostly a template for future (more sophisticated) stackable FSALs
 %endif
 
+# MEM
+%if %{with mem}
+%package mem
+Summary: The NFS-GANESHA's MEM FSAL
+Group: Applications/System
+Requires: nfs-ganesha = %{version}-%{release}
+
+%description mem
+This package contains a FSAL shared object to be used with
+NFS-Ganesha, keeping file systems in memory to benchmark the server
+%endif
+
+# PROF
+%if %{with prof}
+%package prof
+Summary: The NFS-GANESHA's PROF Stackable FSAL
+Group: Applications/System
+Requires: nfs-ganesha = %{version}-%{release}
+
+%description prof
+This package contains a Stackable FSAL shared object to be used with
+NFS-Ganesha, timing the calls to the FSAL below it
+%endif
+
+# BCACHE
+%if %{with bcache}
+%package bcache
+Summary: The NFS-GANESHA's BCACHE Stackable FSAL
+Group: Applications/System
+Requires: nfs-ganesha = %{version}-%{release}
+
+%description bcache
+This package contains a Stackable FSAL shared object to be used with
+NFS-Ganesha, caching the file data of the FSAL below it
+%endif
+
 # GPFS
 %if %{with gpfs}
 %package gpfs
@@ -398,6 +443,9 @@ be used with NFS-Ganesha to support Gluster
 cmake .	-DCMAKE_BUILD_TYPE=Debug			\
 	-DBUILD_CONFIG=rpmbuild				\
 	-DUSE_FSAL_NULL=%{use_fsal_null}		\
+	-DUSE_FSAL_MEM=%{use_fsal_mem}		\
+	-DUSE_FSAL_PROF=%{use_fsal_prof}		\
+	-DUSE_FSAL_BCACHE=%{use_fsal_bcache}		\
 	-DUSE_FSAL_ZFS=%{use_fsal_zfs}			\
 	-DUSE_FSAL_XFS=%{use_fsal_xfs}			\
 	-DUSE_FSAL_CEPH=%{use_fsal_ceph}		\
@@ -582,6 +630,24 @@ killall -SIGHUP dbus-daemon 2>&1 > /dev/null
 %{_libdir}/ganesha/libfsalnull*
 %endif
 
+%if %{with mem}
+%files mem
+%defattr(-,root,root,-)
+%{_libdir}/ganesha/libfsalmem*
+%endif
+
+%if %{with prof}
+%files prof
+%defattr(-,root,root,-)
+%{_libdir}/ganesha/libfsalprof*
+%endif
+
+%if %{with bcache}
+%files bcache
+%defattr(-,root,root,-)
+%{_libdir}/ganesha/libfsalbcache*
+%endif
+
 %if %{with gpfs}
 %files gpfs
 %defattr(-,root,root,-)
@@ -44,6 +44,16 @@ class RetrieveExportStats():
         stats_op = self.exportmgrobj.get_dbus_method("ShowCacheInode",
                                  self.dbus_exportstats_name)
         return InodeStats(stats_op())
+    # latency percentiles totalled over all exports, window 0/1/10/60 secs
+    def latency_stats(self, window):
+        stats_op = self.exportmgrobj.get_dbus_method("GetGlobalLatency",
+                                 self.dbus_exportstats_name)
+        return LatencyStats(stats_op(dbus.UInt32(window)))
+    # per method stats of an FSAL that keeps them, e.g. PROF
+    def fsal_stats(self, fsal):
+        stats_op = self.exportmgrobj.get_dbus_method("GetFSALStats",
+                                 self.dbus_exportstats_name)
+        return FSALStats(stats_op(fsal))
     # list of all exports
     def export_stats(self):
         stats_op = self.exportmgrobj.get_dbus_method("ShowExports",
@@ -225,6 +235,9 @@ class InodeStats():
         self.cache_conflict = stats[3][7]
         self.cache_add = stats[3][9]
         self.cache_mapping = stats[3][11]
+        self.cache_entries = stats[3][13]
+        self.cache_dirs = stats[3][15]
+        self.bytes_per_inode = stats[3][23]
     def __str__(self):
         if self.status != "OK":
             return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
@@ -234,7 +247,47 @@ class InodeStats():
                  "\nInode Cache Misses: " + str(self.cache_miss) +
                  "\nInode Cache Conflicts:: " + str(self.cache_conflict) +
                  "\nInode Cache Adds: " + str(self.cache_add) +
-                 "\nInode Cache Mapping: " + str(self.cache_mapping) )
+                 "\nInode Cache Mapping: " + str(self.cache_mapping) +
+                 "\nInode Cache Entries: " + str(self.cache_entries) +
+                 "\nInode Cache Directories: " + str(self.cache_dirs) +
+                 "\nInode Cache Bytes per Inode: " + str(self.bytes_per_inode) )
+
+class LatencyStats():
+    def __init__(self, stats):
+        self.stats = stats
+    def __str__(self):
+        if self.stats[1] != "OK":
+            return "GANESHA RESPONSE STATUS: " + self.stats[1]
+        output = ("Timestamp: " + time.ctime(self.stats[2][0]) + str(self.stats[2][1]) + " nsecs" +
+                  "\nLatency (nsecs)\t     count\t       p50\t       p90\t       p99\t     p99.9\t       max" +
+                  "\t  qwait p50\t  qwait p99\tqwait p99.9\t  qwait max\n")
+        for op in self.stats[3]:
+            output += "%s" % (str(op[0]).ljust(16))
+            for stat in op[1:]:
+                output += "\t" + str(stat).rjust(10)
+            output += "\n"
+        return output
+
+class FSALStats():
+    def __init__(self, stats):
+        self.stats = stats
+    def ops(self, ops):
+        output = ("FSAL method\t     calls\t    errors\t  inflight\t     bytes\t  outliers" +
+                  "\t       p50\t       p90\t       p99\t     p99.9\t       max\n")
+        for op in ops:
+            output += "%s" % (str(op[0]).ljust(20))
+            for stat in op[1:]:
+                output += "\t" + str(stat).rjust(10)
+            output += "\n"
+        return output
+    def __str__(self):
+        if self.stats[1] != "OK":
+            return "GANESHA RESPONSE STATUS: " + self.stats[1]
+        output = ("Timestamp: " + time.ctime(self.stats[2][0]) + str(self.stats[2][1]) + " nsecs" +
+                  "\nAll exports (latency in nsecs):\n" + self.ops(self.stats[3]))
+        for export in self.stats[4]:
+            output += "\nEXPORT %s:\n" % (export[0]) + self.ops(export[1])
+        return output
 
 class FastStats():
     def __init__(self, stats):
@@ -16,7 +16,8 @@ def usage():
     message = "Command gives global stats by default.\n"
     message += "%s [list_clients | deleg <ip address> | " % (sys.argv[0])
     message += "inode | iov3 [export id] | iov4 [export id] | export |"
-    message += " total [export id] | fast | pnfs [export id] ]"
+    message += " total [export id] | fast | pnfs [export id] |"
+    message += " latency [0 | 1 | 10 | 60] | fsal <fsal name> ]"
     sys.exit(message)
 
 if len(sys.argv) < 2:
@@ -26,7 +27,7 @@ else:
 
 # check arguments
 commands = ('help', 'list_clients', 'deleg', 'global', 'inode', 'iov3', 'iov4',
-           'export', 'total', 'fast', 'pnfs')
+           'export', 'total', 'fast', 'pnfs', 'latency', 'fsal')
 if command not in commands:
     print "Option \"%s\" is not correct." % (command)
     usage()
@@ -44,6 +45,20 @@ elif command in ('iov3', 'iov4', 'total', 'pnfs'):
         command_arg = sys.argv[2]
     else:
         usage()
+# optionally accepts a window in seconds, 0 meaning since start
+elif command in ('latency'):
+    if (len(sys.argv) == 2):
+        command_arg = 0
+    elif (len(sys.argv) == 3) and sys.argv[2].isdigit():
+        command_arg = int(sys.argv[2])
+    else:
+        usage()
+# requires an FSAL name
+elif command in ('fsal'):
+    if not len(sys.argv) == 3:
+        print "Option \"%s\" must be followed by an FSAL name." % (command)
+        usage()
+    command_arg = sys.argv[2]
 elif command == "help":
     usage()
 
@@ -70,3 +85,7 @@ elif command == "total":
     print exp_interface.total_stats(command_arg)
 elif command == "pnfs":
     print exp_interface.pnfs_stats(command_arg)
+elif command == "latency":
+    print exp_interface.latency_stats(command_arg)
+elif command == "fsal":
+    print exp_interface.fsal_stats(command_arg)
@@ -593,7 +593,7 @@ static bool get_nfsv3_stats_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v3_iostats(server_st->st.nfsv3, &iter);
+		server_dbus_v3_iostats(&server_st->st, &iter);
 
 	if (client != NULL)
 		put_gsh_client(client);
@@ -640,7 +640,7 @@ static bool get_nfsv40_stats_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v40_iostats(server_st->st.nfsv40, &iter);
+		server_dbus_v40_iostats(&server_st->st, &iter);
 
 	if (client != NULL)
 		put_gsh_client(client);
@@ -687,7 +687,7 @@ static bool get_nfsv41_stats_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v41_iostats(server_st->st.nfsv41, &iter);
+		server_dbus_v41_iostats(&server_st->st, &iter);
 
 	if (client != NULL)
 		put_gsh_client(client);
@@ -735,7 +735,7 @@ static bool get_nfsv41_stats_layouts(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v41_layouts(server_st->st.nfsv41, &iter);
+		server_dbus_v41_layouts(&server_st->st, &iter);
 
 	if (client != NULL)
 		put_gsh_client(client);
@@ -945,6 +945,106 @@ static struct gsh_dbus_method cltmgr_show_9p_op_stats = {
 };
 #endif
 
+/**
+ * DBUS method to report latency percentiles of a client
+ *
+ */
+
+static bool get_client_latency(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!nfs_param.core_param.enable_latency_hist) {
+		success = false;
+		errormsg = "Latency histograms are not enabled";
+	} else {
+		client = lookup_client(args, &errormsg);
+		if (client == NULL)
+			success = false;
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success) {
+		server_st = container_of(client, struct server_stats, client);
+		server_dbus_latency_percentiles(&server_st->st, &iter);
+	}
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_latency = {
+	.name = "GetLatencyPercentiles",
+	.method = get_client_latency,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LAT_PERCENTILES_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report latency and queue wait histograms of a
+ * client operation
+ *
+ */
+
+static bool get_client_latency_histogram(DBusMessageIter *args,
+					 DBusMessage *reply,
+					 DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	char *opname = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!nfs_param.core_param.enable_latency_hist) {
+		success = false;
+		errormsg = "Latency histograms are not enabled";
+	} else {
+		client = lookup_client(args, &errormsg);
+		if (client == NULL)
+			success = false;
+	}
+	dbus_message_iter_next(args);
+	if (success)
+		success = arg_latency_op(args, &opname, &errormsg);
+	if (success) {
+		server_st = container_of(client, struct server_stats, client);
+		if (!server_stats_has_latency(&server_st->st, opname)) {
+			success = false;
+			errormsg = "Client does not have any activity for op";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_latency_histogram(&server_st->st, opname, &iter);
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_latency_histogram = {
+	.name = "GetLatencyHistogram",
+	.method = get_client_latency_histogram,
+	.args = {IPADDR_ARG,
+		 LAT_OP_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LAT_HISTOGRAM_REPLY,
+		 END_ARG_LIST}
+};
 
 static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v3_io,
@@ -952,6 +1052,8 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v41_io,
 	&cltmgr_show_v41_layouts,
 	&cltmgr_show_delegations,
+	&cltmgr_show_latency,
+	&cltmgr_show_latency_histogram,
 #ifdef _USE_9P
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
@@ -33,6 +33,29 @@
  * @file delayed_exec.c
  * @author Adam C. Emerson <aemerson@linuxbox.com>
  * @brief Implementation of the delayed execution system
+ *
+ * Each executor thread owns a shard: a hierarchical timer wheel, a
+ * queue of tasks that are due, and a pool of free tasks, under one
+ * mutex.  Tasks are submitted to the shard of the submitting thread,
+ * handed out round robin, so submitters seldom share a mutex.
+ *
+ * The wheel has DELAYED_WHEEL_LEVELS levels of DELAYED_WHEEL_SLOTS
+ * slots.  Level 0 holds tasks due within 64 ticks of a millisecond,
+ * one slot per tick; each level above holds 64 times longer spans.
+ * When a span comes up its slot is cascaded, its tasks put in the
+ * levels below, and the tasks of a level 0 slot go to the run queue
+ * when its tick comes.  Insertion and cancellation are O(1), however
+ * many timers there are.  Ticks with nothing to do are skipped, so an
+ * idle thread sleeps until the next slot that has tasks.
+ *
+ * A thread takes up to DELAYED_BATCH due tasks at a time and runs
+ * them without the mutex.  When it has none, it steals half the run
+ * queue of another thread, so a burst of expiries on one shard is
+ * spread over all the threads.
+ *
+ * Tasks are never freed, only returned to their shard's pool, and
+ * each use gets a new sequence number, so a struct delayed_timer can
+ * always be checked against its task.
  */
 
 #include "config.h"
@@ -43,29 +66,37 @@
 #include <signal.h>
 #endif
 #include "abstract_mem.h"
+#include "abstract_atomic.h"
 #include "delayed_exec.h"
 #include "log.h"
-#include "avltree.h"
-#include "misc/queue.h"
+#include "gsh_list.h"
 #include "gsh_intrinsic.h"
+#include "gsh_config.h"
 #include "common_utils.h"
 
-/**
- * @brief A list of tasks
- */
-
-LIST_HEAD(delayed_tasklist, delayed_task);
+/** Bits of the tick each level of the wheel resolves */
+#define DELAYED_WHEEL_BITS 6
+#define DELAYED_WHEEL_SLOTS (1 << DELAYED_WHEEL_BITS)
+#define DELAYED_WHEEL_MASK (DELAYED_WHEEL_SLOTS - 1)
+/** Levels of the wheel, reaching 2^30 ticks, over 12 days */
+#define DELAYED_WHEEL_LEVELS 5
+#define DELAYED_WHEEL_SPAN (1ULL << (DELAYED_WHEEL_BITS * DELAYED_WHEEL_LEVELS))
+/** Nanoseconds in a tick */
+#define DELAYED_TICK NS_PER_MSEC
+/** Tasks allocated at once when a pool is empty */
+#define DELAYED_POOL_CHUNK 256
+/** Most tasks a thread takes off a run queue at once */
+#define DELAYED_BATCH 32
 
 /**
- * @brief All tasks executing at a given time.
+ * @brief Where a task is
  */
 
-struct delayed_multi {
-	struct timespec realtime;	/*< A wallclock time at which to
-					   perform the given task. */
-	struct delayed_tasklist list;	/*< The linked list of tasks to
-					   perform. */
-	struct avltree_node node;	/*< Our node in the tree */
+enum delayed_task_state {
+	delayed_task_free,	/*< In the pool */
+	delayed_task_pending,	/*< In a slot of the wheel */
+	delayed_task_queued,	/*< Due, on the run queue */
+	delayed_task_running	/*< Taken by a thread */
 };
 
 /**
@@ -77,23 +108,33 @@ struct delayed_task {
 	void (*func)(void *);
 	/** Argument for delayed task */
 	void *arg;
-	/** Link in the task list. */
-	LIST_ENTRY(delayed_task) link;
+	/** Tick at which to run it */
+	uint64_t expires;
+	/** This use of the task, for delayed_cancel */
+	uint64_t seq;
+	enum delayed_task_state state;
+	/** Shard whose pool the task belongs to */
+	struct delayed_shard *shard;
+	/** Link in a slot, the run queue, a batch or the pool */
+	struct glist_head link;
 };
 
 /**
- * @brief A list of threads
+ * @brief The wheel, run queue and pool of one executor thread
  */
 
-LIST_HEAD(delayed_threadlist, delayed_thread);
-
-/**
- * @brief An individual executor thread
- */
-
-struct delayed_thread {
-	pthread_t id;		/*< Thread id */
-	 LIST_ENTRY(delayed_thread) link;	/*< Link in the thread list. */
+struct delayed_shard {
+	pthread_mutex_t mtx;	/*< Protects everything below */
+	pthread_cond_t cv;	/*< The thread waits here */
+	uint64_t next;		/*< Next tick to process */
+	uint64_t wake;		/*< Tick the thread sleeps to, 0 if awake */
+	struct glist_head wheel[DELAYED_WHEEL_LEVELS][DELAYED_WHEEL_SLOTS];
+	struct glist_head runq;	/*< Due tasks, oldest first */
+	struct glist_head pool;	/*< Free tasks */
+	uint64_t seq;		/*< Last sequence number handed out */
+	struct delayed_stats stats;
+	pthread_t id;		/*< The executor thread */
+	bool alive;		/*< The thread has not exited, under mtx */
 };
 
 /**
@@ -101,14 +142,17 @@ struct delayed_thread {
  * Delayed execution state.
  */
 
-/** list of all threads */
-static struct delayed_threadlist thread_list;
-/** Mutex for delayed execution */
+/** The shards, one per thread */
+static struct delayed_shard *shards;
+static uint32_t nshards;
+/** Tick 0 */
+static struct timespec delayed_epoch;
+/** Mutex for starting and stopping */
 static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
-/** Condition variable for delayed execution */
+/** Signalled when a thread exits */
 static pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
-/** The timer tree */
-static struct avltree tree;
+/** Threads not yet exited */
+static uint32_t nthreads;
 
 /**
  * @brief Posssible states for the delayed executor
@@ -121,87 +165,369 @@ enum delayed_state {
 /** State for the executor */
 static enum delayed_state delayed_state;
 
-enum delayed_employment {
-	delayed_employed,	/*< Work is available, do it. */
-	delayed_on_break,	/*< Work is available, but wait for it */
-	delayed_unemployed	/*< No work is available, wait indefinitely */
-};
+/** Shard the calling thread submits to */
+static __thread uint32_t thread_shard = UINT32_MAX;
+static uint32_t next_shard;
 
 /** @} */
 
-static int comparator(const struct avltree_node *a,
-		      const struct avltree_node *b)
+/**
+ * @brief The current tick
+ */
+
+static uint64_t delayed_now(void)
 {
-	struct delayed_multi *p =
-	    avltree_container_of(a, struct delayed_multi, node);
-	struct delayed_multi *q =
-	    avltree_container_of(b, struct delayed_multi, node);
+	struct timespec ts;
+
+	now(&ts);
+	if (gsh_time_cmp(&ts, &delayed_epoch) <= 0)
+		return 0;
 
-	return gsh_time_cmp(&p->realtime, &q->realtime);
+	return timespec_diff(&delayed_epoch, &ts) / DELAYED_TICK;
+}
+
+static inline uint32_t delayed_slot(uint64_t tick, int level)
+{
+	return (tick >> (DELAYED_WHEEL_BITS * level)) & DELAYED_WHEEL_MASK;
+}
+
+static struct delayed_shard *delayed_home(void)
+{
+	if (unlikely(thread_shard == UINT32_MAX))
+		thread_shard = atomic_postinc_uint32_t(&next_shard);
+
+	return &shards[thread_shard % nshards];
 }
 
 /**
- * @brief Get a task to perform
+ * @brief Get a free task, growing the pool if needed
  *
- * This function must be called with the mutex held.
+ * This function must be called with the shard mutex held.
  *
- * @param[out] when The time for which to wait, if there is one
- * @param[out] func The function to execute, if there is one
- * @param[out] arg  The argument to supply, if there is one
+ * @return The task or NULL if out of memory.
+ */
+
+static struct delayed_task *delayed_task_get(struct delayed_shard *sh)
+{
+	struct delayed_task *task;
+	int i;
+
+	if (glist_empty(&sh->pool)) {
+		task = gsh_calloc(DELAYED_POOL_CHUNK, sizeof(*task));
+		if (task == NULL)
+			return NULL;
+		for (i = 0; i < DELAYED_POOL_CHUNK; i++) {
+			task[i].shard = sh;
+			glist_add_tail(&sh->pool, &task[i].link);
+		}
+	}
+
+	task = glist_first_entry(&sh->pool, struct delayed_task, link);
+	glist_del(&task->link);
+
+	return task;
+}
+
+static void delayed_task_put(struct delayed_shard *sh,
+			     struct delayed_task *task)
+{
+	task->state = delayed_task_free;
+	task->func = NULL;
+	task->arg = NULL;
+	glist_add(&sh->pool, &task->link);
+}
+
+static void delayed_enqueue(struct delayed_shard *sh,
+			    struct delayed_task *task)
+{
+	task->state = delayed_task_queued;
+	glist_add_tail(&sh->runq, &task->link);
+	if (++sh->stats.queued > sh->stats.max_queued)
+		sh->stats.max_queued = sh->stats.queued;
+}
+
+/**
+ * @brief Put a task in the wheel, or on the run queue if it is due
  *
- * @retval delayed_employed if there is a task to perform now.  Its
- *         argument and function are stored in @c arg and @c func.
- * @retval delayed_on_break if there is work but it is not to be
- *         performed yet.  The time at which it is to be performed is
- *         set in *when.
- * @retval delayed_unemployed if there is no work at all.  The caller
- *         should wait indefinitely to be signalled.
+ * The level is the one whose span covers the time left; tasks further
+ * out than the wheel reaches go in the last level and are put back
+ * when their slot comes up.  This function must be called with the
+ * shard mutex held.
  */
 
-static enum delayed_employment delayed_get_work(struct timespec *when,
-						void (**func) (void *),
-						void **arg)
+static void delayed_wheel_add(struct delayed_shard *sh,
+			      struct delayed_task *task)
+{
+	uint64_t expires = task->expires;
+	uint64_t delta;
+	int level = 0;
+
+	if (expires < sh->next) {
+		delayed_enqueue(sh, task);
+		return;
+	}
+
+	delta = expires - sh->next;
+	if (delta >= DELAYED_WHEEL_SPAN) {
+		delta = DELAYED_WHEEL_SPAN - 1;
+		expires = sh->next + delta;
+	}
+
+	while (delta >= (1ULL << (DELAYED_WHEEL_BITS * (level + 1))))
+		level++;
+
+	task->state = delayed_task_pending;
+	glist_add_tail(&sh->wheel[level][delayed_slot(expires, level)],
+		       &task->link);
+	sh->stats.pending++;
+}
+
+/**
+ * @brief Move the tasks of a slot to the levels below
+ */
+
+static void delayed_cascade(struct delayed_shard *sh, int level,
+			    uint32_t slot)
+{
+	struct glist_head list;
+	struct glist_head *node, *noden;
+	struct delayed_task *task;
+
+	glist_init(&list);
+	glist_splice_tail(&list, &sh->wheel[level][slot]);
+
+	glist_for_each_safe(node, noden, &list) {
+		task = glist_entry(node, struct delayed_task, link);
+		glist_del(node);
+		sh->stats.pending--;
+		delayed_wheel_add(sh, task);
+	}
+}
+
+/**
+ * @brief Process the next tick of a shard
+ *
+ * The slots whose span starts at this tick are cascaded, higher
+ * levels last, then the tasks due are queued.
+ */
+
+static void delayed_tick(struct delayed_shard *sh)
+{
+	uint64_t tick = sh->next;
+	struct glist_head *slot;
+	struct glist_head *node, *noden;
+	int level;
+
+	for (level = 1; level < DELAYED_WHEEL_LEVELS; level++) {
+		if (tick & ((1ULL << (DELAYED_WHEEL_BITS * level)) - 1))
+			break;
+		delayed_cascade(sh, level, delayed_slot(tick, level));
+	}
+
+	slot = &sh->wheel[0][delayed_slot(tick, 0)];
+	glist_for_each_safe(node, noden, slot) {
+		glist_del(node);
+		sh->stats.pending--;
+		delayed_enqueue(sh,
+				glist_entry(node, struct delayed_task, link));
+	}
+
+	sh->next = tick + 1;
+}
+
+/**
+ * @brief The next tick at which a shard has something to do
+ *
+ * That is the first tick with a task in its level 0 slot or whose
+ * span starts a slot with tasks at a higher level.
+ *
+ * @return The tick, UINT64_MAX if the wheel is empty.
+ */
+
+static uint64_t delayed_next_event(struct delayed_shard *sh)
+{
+	uint64_t best = UINT64_MAX;
+	uint64_t step, tick;
+	int level, i;
+
+	if (sh->stats.pending == 0)
+		return best;
+
+	for (level = 0; level < DELAYED_WHEEL_LEVELS; level++) {
+		step = 1ULL << (DELAYED_WHEEL_BITS * level);
+		tick = (sh->next + step - 1) & ~(step - 1);
+
+		for (i = 0; i < DELAYED_WHEEL_SLOTS && tick < best;
+		     i++, tick += step) {
+			if (!glist_empty(
+				&sh->wheel[level][delayed_slot(tick, level)])) {
+				best = tick;
+				break;
+			}
+		}
+	}
+
+	return best;
+}
+
+/**
+ * @brief Bring a shard up to the current tick
+ *
+ * Only ticks with something to do are processed; those between are
+ * empty, so skipping them changes nothing.  This function must be
+ * called with the shard mutex held.
+ */
+
+static void delayed_advance(struct delayed_shard *sh)
+{
+	uint64_t current = delayed_now();
+	uint64_t tick;
+
+	while ((tick = delayed_next_event(sh)) <= current) {
+		sh->next = tick;
+		delayed_tick(sh);
+	}
+
+	if (sh->next <= current)
+		sh->next = current + 1;
+}
+
+/**
+ * @brief Take due tasks off a run queue
+ *
+ * This function must be called with the shard mutex held.
+ *
+ * @param[in]  sh    The shard
+ * @param[out] batch The tasks taken
+ * @param[in]  max   Most tasks to take
+ *
+ * @return The number of tasks taken.
+ */
+
+static uint32_t delayed_take(struct delayed_shard *sh,
+			     struct glist_head *batch, uint32_t max)
 {
-	struct avltree_node *first = avltree_first(&tree);
-	struct delayed_multi *mul;
-	struct timespec current;
 	struct delayed_task *task;
+	uint32_t n = 0;
+
+	glist_init(batch);
+	while (n < max && !glist_empty(&sh->runq)) {
+		task = glist_first_entry(&sh->runq, struct delayed_task, link);
+		glist_del(&task->link);
+		task->state = delayed_task_running;
+		glist_add_tail(batch, &task->link);
+		n++;
+	}
+
+	sh->stats.queued -= n;
+	if (n != 0)
+		sh->stats.batches++;
+
+	return n;
+}
 
-	if (first == NULL)
-		return delayed_unemployed;
+/**
+ * @brief Run a batch and give its tasks back to their shard
+ *
+ * @param[in] sh     The shard the tasks were taken from
+ * @param[in] batch  The tasks
+ * @param[in] n      Their number
+ * @param[in] stolen Whether this is not the shard's thread
+ */
 
-	now(&current);
-	mul = avltree_container_of(first, struct delayed_multi, node);
+static void delayed_run(struct delayed_shard *sh, struct glist_head *batch,
+			uint32_t n, bool stolen)
+{
+	struct glist_head *node, *noden;
+	struct delayed_task *task;
 
-	if (gsh_time_cmp(&mul->realtime, &current) > 0) {
-		*when = mul->realtime;
-		return delayed_on_break;
+	glist_for_each(node, batch) {
+		task = glist_entry(node, struct delayed_task, link);
+		task->func(task->arg);
 	}
 
-	task = LIST_FIRST(&mul->list);
-	*func = task->func;
-	*arg = task->arg;
-	LIST_REMOVE(task, link);
-	gsh_free(task);
-	if (LIST_EMPTY(&mul->list)) {
-		avltree_remove(first, &tree);
-		gsh_free(mul);
+	PTHREAD_MUTEX_lock(&sh->mtx);
+	glist_for_each_safe(node, noden, batch) {
+		glist_del(node);
+		delayed_task_put(sh,
+				 glist_entry(node, struct delayed_task, link));
 	}
+	sh->stats.run += n;
+	if (stolen)
+		sh->stats.stolen += n;
+	PTHREAD_MUTEX_unlock(&sh->mtx);
+}
+
+/**
+ * @brief Take half the run queue of a busy thread
+ *
+ * Shards whose mutex is taken are passed over.
+ *
+ * @param[in]  me     The shard of the calling thread
+ * @param[out] victim The shard the tasks were taken from
+ * @param[out] batch  The tasks taken
+ *
+ * @return The number of tasks taken.
+ */
 
-	return delayed_employed;
+static uint32_t delayed_steal(struct delayed_shard *me,
+			      struct delayed_shard **victim,
+			      struct glist_head *batch)
+{
+	struct delayed_shard *sh;
+	uint32_t i, n, want;
+
+	for (i = 1; i < nshards; i++) {
+		sh = &shards[(me - shards + i) % nshards];
+		if (pthread_mutex_trylock(&sh->mtx) != 0)
+			continue;
+		want = (sh->stats.queued + 1) / 2;
+		n = delayed_take(sh, batch,
+				 want < DELAYED_BATCH ? want : DELAYED_BATCH);
+		PTHREAD_MUTEX_unlock(&sh->mtx);
+		if (n != 0) {
+			*victim = sh;
+			return n;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Wake the next thread to steal from a long run queue
+ */
+
+static void delayed_wake_thief(struct delayed_shard *me)
+{
+	struct delayed_shard *sh = &shards[(me - shards + 1) % nshards];
+
+	if (sh == me)
+		return;
+
+	PTHREAD_MUTEX_lock(&sh->mtx);
+	if (sh->wake != 0)
+		pthread_cond_signal(&sh->cv);
+	PTHREAD_MUTEX_unlock(&sh->mtx);
 }
 
 /**
  * @brief Thread function to execute delayed tasks
  *
- * @param[in] arg The thread entry (cast to void)
+ * @param[in] arg The shard of the thread (cast to void)
  *
  * @return NULL, always and forever.
  */
 
 void *delayed_thread(void *arg)
 {
-	struct delayed_thread *thr = arg;
+	struct delayed_shard *sh = arg;
+	struct delayed_shard *victim;
+	struct glist_head batch;
+	struct timespec then;
+	uint64_t wake;
+	uint32_t n;
+	bool more;
 	int old_type = 0;
 	int old_state = 0;
 	sigset_t old_sigmask;
@@ -218,34 +544,54 @@ void *delayed_thread(void *arg)
 
 	pthread_sigmask(SIG_SETMASK, NULL, &old_sigmask);
 
-	PTHREAD_MUTEX_lock(&mtx);
-	while (delayed_state == delayed_running) {
-		struct timespec then;
-		void (*func)(void *);
-		void *arg;
-
-		switch (delayed_get_work(&then, &func, &arg)) {
-		case delayed_unemployed:
-			pthread_cond_wait(&cv, &mtx);
-			break;
+	/* Tasks this thread submits go to its own wheel */
+	thread_shard = sh - shards;
 
-		case delayed_on_break:
-			pthread_cond_timedwait(&cv, &mtx, &then);
-			break;
+	PTHREAD_MUTEX_lock(&sh->mtx);
+	while (delayed_state == delayed_running) {
+		delayed_advance(sh);
+
+		n = delayed_take(sh, &batch, DELAYED_BATCH);
+		if (n != 0) {
+			more = !glist_empty(&sh->runq);
+			PTHREAD_MUTEX_unlock(&sh->mtx);
+			if (more)
+				delayed_wake_thief(sh);
+			delayed_run(sh, &batch, n, false);
+			PTHREAD_MUTEX_lock(&sh->mtx);
+			continue;
+		}
 
-		case delayed_employed:
-			PTHREAD_MUTEX_unlock(&mtx);
-			func(arg);
-			PTHREAD_MUTEX_lock(&mtx);
-			break;
+		PTHREAD_MUTEX_unlock(&sh->mtx);
+		n = delayed_steal(sh, &victim, &batch);
+		if (n != 0)
+			delayed_run(victim, &batch, n, true);
+		PTHREAD_MUTEX_lock(&sh->mtx);
+
+		if (n != 0 || !glist_empty(&sh->runq))
+			continue;
+
+		wake = delayed_next_event(sh);
+		if (wake <= delayed_now())
+			continue;
+
+		sh->wake = wake;
+		if (wake == UINT64_MAX) {
+			pthread_cond_wait(&sh->cv, &sh->mtx);
+		} else {
+			then = delayed_epoch;
+			timespec_add_nsecs(wake * DELAYED_TICK, &then);
+			pthread_cond_timedwait(&sh->cv, &sh->mtx, &then);
 		}
+		sh->wake = 0;
 	}
-	LIST_REMOVE(thr, link);
-	if (LIST_EMPTY(&thread_list))
-		pthread_cond_broadcast(&cv);
+	PTHREAD_MUTEX_unlock(&sh->mtx);
 
+	PTHREAD_MUTEX_lock(&mtx);
+	sh->alive = false;
+	if (--nthreads == 0)
+		pthread_cond_broadcast(&cv);
 	PTHREAD_MUTEX_unlock(&mtx);
-	gsh_free(thr);
 
 	return NULL;
 }
@@ -256,20 +602,36 @@ void *delayed_thread(void *arg)
 
 void delayed_start(void)
 {
-	/* Make this a parameter later */
-	const size_t threads_to_start = 1;
+	uint32_t threads_to_start = nfs_param.core_param.delayed_exec_threads;
 	/* Thread attributes */
 	pthread_attr_t attr;
+	struct delayed_shard *sh;
 	/* Thread index */
-	int i;
+	int i, level, slot;
+
+	/* Zero when the configuration was not read */
+	if (threads_to_start == 0)
+		threads_to_start = 1;
 
-	LIST_INIT(&thread_list);
-	avltree_init(&tree, comparator, 0);
+	now(&delayed_epoch);
 
-	if (threads_to_start == 0) {
+	shards = gsh_calloc(threads_to_start, sizeof(struct delayed_shard));
+	if (shards == NULL) {
 		LogFatal(COMPONENT_THREAD,
-			 "You can't execute tasks with zero threads.");
+			 "Unable to start delayed executor: no memory.");
+	}
+
+	for (i = 0; i < threads_to_start; ++i) {
+		sh = &shards[i];
+		PTHREAD_MUTEX_init(&sh->mtx, NULL);
+		PTHREAD_COND_init(&sh->cv, NULL);
+		for (level = 0; level < DELAYED_WHEEL_LEVELS; level++)
+			for (slot = 0; slot < DELAYED_WHEEL_SLOTS; slot++)
+				glist_init(&sh->wheel[level][slot]);
+		glist_init(&sh->runq);
+		glist_init(&sh->pool);
 	}
+	nshards = threads_to_start;
 
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -278,115 +640,209 @@ void delayed_start(void)
 	delayed_state = delayed_running;
 
 	for (i = 0; i < threads_to_start; ++i) {
-		struct delayed_thread *thread =
-		    gsh_malloc(sizeof(struct delayed_thread));
-		int rc = 0;
+		int rc = pthread_create(&shards[i].id, &attr, delayed_thread,
+					&shards[i]);
 
-		if (thread == NULL) {
-			LogFatal(COMPONENT_THREAD,
-				 "Unable to start delayed executor: no memory.");
-		}
-		rc = pthread_create(&thread->id, &attr, delayed_thread, thread);
 		if (rc != 0) {
 			LogFatal(COMPONENT_THREAD,
 				 "Unable to start delayed executor: %d", rc);
 		}
-		LIST_INSERT_HEAD(&thread_list, thread, link);
+		shards[i].alive = true;
+		nthreads++;
 	}
 	PTHREAD_MUTEX_unlock(&mtx);
+
+	pthread_attr_destroy(&attr);
 }
 
 /**
  * @brief Shut down the delayed executor
+ *
+ * Tasks not yet run are left where they are.
  */
 
 void delayed_shutdown(void)
 {
 	int rc = -1;
 	struct timespec then;
+	uint32_t i;
 
 	now(&then);
 	then.tv_sec += 120;
 
 	PTHREAD_MUTEX_lock(&mtx);
 	delayed_state = delayed_stopping;
-	pthread_cond_broadcast(&cv);
-	while ((rc != ETIMEDOUT) && !LIST_EMPTY(&thread_list))
-		rc = pthread_cond_timedwait(&cv, &mtx, &then);
+	PTHREAD_MUTEX_unlock(&mtx);
+
+	for (i = 0; i < nshards; i++) {
+		PTHREAD_MUTEX_lock(&shards[i].mtx);
+		pthread_cond_broadcast(&shards[i].cv);
+		PTHREAD_MUTEX_unlock(&shards[i].mtx);
+	}
 
-	if (!LIST_EMPTY(&thread_list)) {
-		struct delayed_thread *thr;
+	PTHREAD_MUTEX_lock(&mtx);
+	while ((rc != ETIMEDOUT) && nthreads != 0)
+		rc = pthread_cond_timedwait(&cv, &mtx, &then);
 
+	if (nthreads != 0) {
 		LogMajor(COMPONENT_THREAD,
 			 "Delayed executor threads not shutting down cleanly, taking harsher measures.");
-		while ((thr = LIST_FIRST(&thread_list)) != NULL) {
-			LIST_REMOVE(thr, link);
-			pthread_cancel(thr->id);
-			gsh_free(thr);
+		for (i = 0; i < nshards; i++) {
+			if (!shards[i].alive)
+				continue;
+			pthread_cancel(shards[i].id);
+			shards[i].alive = false;
 		}
 	}
 	PTHREAD_MUTEX_unlock(&mtx);
 }
 
 /**
- * @brief Submit a new task
+ * @brief Submit a new task that can be cancelled
  *
- * @param[in] func  The function to run
- * @param[in] arg   The argument to run it with
- * @param[in] delay The dleay in nanoseconds
+ * @param[in]  func  The function to run
+ * @param[in]  arg   The argument to run it with
+ * @param[in]  delay The delay in nanoseconds
+ * @param[out] timer Handle to cancel the task with, may be NULL
  *
  * @retval 0 on success.
  * @retval ENOMEM on inability to allocate memory causing other than success.
+ * @retval EINVAL if the executor was never started.
  */
 
-int delayed_submit(void (*func) (void *), void *arg, nsecs_elapsed_t delay)
+int delayed_submit_timer(void (*func) (void *), void *arg,
+			 nsecs_elapsed_t delay, struct delayed_timer *timer)
 {
-	struct delayed_multi *mul = NULL;
-	struct delayed_task *task = NULL;
-	struct avltree_node *collision = NULL;
-	struct avltree_node *first = NULL;
+	struct delayed_shard *sh;
+	struct delayed_task *task;
 
-	mul = gsh_malloc(sizeof(struct delayed_multi));
+	if (unlikely(nshards == 0))
+		return EINVAL;
 
-	if (mul == NULL) {
-		LogMajor(COMPONENT_THREAD,
-			 "Unable to allocate memory for delayed task.");
-		return ENOMEM;
-	}
-
-	task = gsh_malloc(sizeof(struct delayed_task));
+	sh = delayed_home();
 
+	PTHREAD_MUTEX_lock(&sh->mtx);
+	task = delayed_task_get(sh);
 	if (task == NULL) {
-		gsh_free(mul);
+		PTHREAD_MUTEX_unlock(&sh->mtx);
 		LogMajor(COMPONENT_THREAD,
 			 "Unable to allocate memory for delayed task.");
 		return ENOMEM;
 	}
 
-	now(&mul->realtime);
-	timespec_add_nsecs(delay, &mul->realtime);
-
-	PTHREAD_MUTEX_lock(&mtx);
-	first = avltree_first(&tree);
-	collision = avltree_insert(&mul->node, &tree);
-	if (unlikely(collision)) {
-		gsh_free(mul);
-		/* There is already a node for this exact time in the
-		   tree.  Add our task to its list. */
-		mul =
-		    avltree_container_of(collision, struct delayed_multi, node);
-	} else {
-		LIST_INIT(&mul->list);
-	}
 	task->func = func;
 	task->arg = arg;
-	LIST_INSERT_HEAD(&mul->list, task, link);
-	if (!first || comparator(&mul->node, first) < 0)
-		pthread_cond_broadcast(&cv);
+	task->seq = ++sh->seq;
+	/* The current tick is partly gone, so one more makes sure the
+	   task does not run early */
+	task->expires = delay == 0 ? 0 :
+	    delayed_now() + 1 + (delay + DELAYED_TICK - 1) / DELAYED_TICK;
+
+	delayed_wheel_add(sh, task);
+	sh->stats.submitted++;
+
+	if (timer != NULL) {
+		timer->task = task;
+		timer->seq = task->seq;
+	}
 
-	PTHREAD_MUTEX_unlock(&mtx);
+	if (sh->wake != 0 && task->expires < sh->wake)
+		pthread_cond_signal(&sh->cv);
+
+	PTHREAD_MUTEX_unlock(&sh->mtx);
 
 	return 0;
 }
 
+/**
+ * @brief Submit a new task
+ *
+ * @param[in] func  The function to run
+ * @param[in] arg   The argument to run it with
+ * @param[in] delay The dleay in nanoseconds
+ *
+ * @retval 0 on success.
+ * @retval ENOMEM on inability to allocate memory causing other than success.
+ */
+
+int delayed_submit(void (*func) (void *), void *arg, nsecs_elapsed_t delay)
+{
+	return delayed_submit_timer(func, arg, delay, NULL);
+}
+
+/**
+ * @brief Cancel a task that has not started to run
+ *
+ * The timer is cleared either way.
+ *
+ * @param[in,out] timer The task, as filled in by delayed_submit_timer
+ * @param[out]    arg   The argument of a cancelled task, may be NULL
+ *
+ * @retval true if the task was cancelled and will not run.
+ * @retval false if it ran, is running, or there was none.
+ */
+
+bool delayed_cancel(struct delayed_timer *timer, void **arg)
+{
+	struct delayed_task *task = timer->task;
+	struct delayed_shard *sh;
+	bool cancelled = false;
+
+	if (task == NULL)
+		return false;
+
+	sh = task->shard;
+
+	PTHREAD_MUTEX_lock(&sh->mtx);
+	if (task->seq == timer->seq &&
+	    (task->state == delayed_task_pending ||
+	     task->state == delayed_task_queued)) {
+		glist_del(&task->link);
+		if (task->state == delayed_task_pending)
+			sh->stats.pending--;
+		else
+			sh->stats.queued--;
+		if (arg != NULL)
+			*arg = task->arg;
+		delayed_task_put(sh, task);
+		sh->stats.cancelled++;
+		cancelled = true;
+	}
+	PTHREAD_MUTEX_unlock(&sh->mtx);
+
+	timer->task = NULL;
+	timer->seq = 0;
+
+	return cancelled;
+}
+
+/**
+ * @brief Sum the counters of all threads
+ *
+ * @param[out] stats The counters; max_queued is the most of any thread
+ */
+
+void delayed_get_stats(struct delayed_stats *stats)
+{
+	struct delayed_shard *sh;
+	uint32_t i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < nshards; i++) {
+		sh = &shards[i];
+		PTHREAD_MUTEX_lock(&sh->mtx);
+		stats->submitted += sh->stats.submitted;
+		stats->cancelled += sh->stats.cancelled;
+		stats->run += sh->stats.run;
+		stats->batches += sh->stats.batches;
+		stats->stolen += sh->stats.stolen;
+		stats->pending += sh->stats.pending;
+		stats->queued += sh->stats.queued;
+		if (sh->stats.max_queued > stats->max_queued)
+			stats->max_queued = sh->stats.max_queued;
+		PTHREAD_MUTEX_unlock(&sh->mtx);
+	}
+}
+
 /** @} */
@@ -80,6 +80,46 @@ struct export_by_id {
 
 static struct export_by_id export_by_id;
 
+/**
+ * @brief A path component in a trie of exports
+ *
+ * Exports are also kept in two tries of path components, one by full
+ * path and one by pseudo path, for longest prefix lookups that take
+ * as many steps as the path has components.  The components of a
+ * path are the strings between its '/'s, so "/a/b" is "", "a", "b"
+ * and the root "/", like the empty path, is the single "".  A node
+ * lists the exports whose path ends there, in the order they were
+ * inserted, and holds no reference on them.
+ */
+struct export_trie_node {
+	struct avltree_node node_k;	/*< In the children of parent */
+	struct avltree children;	/*< Nodes one component longer */
+	struct export_trie_node *parent;
+	struct glist_head exports;	/*< Exports of this path */
+	const char *name;		/*< The component, not terminated */
+	size_t len;			/*< Its length */
+};
+
+/**
+ * @brief A trie of exports
+ *
+ * Changed with both this lock and export_by_id.lock held for write,
+ * so lookups only need this one.
+ */
+struct export_trie {
+	pthread_rwlock_t lock;
+	struct export_trie_node root;
+	size_t link;	/*< Offset of the list entry in gsh_export */
+};
+
+static struct export_trie export_by_path = {
+	.link = offsetof(struct gsh_export, exp_path_list),
+};
+
+static struct export_trie export_by_pseudo = {
+	.link = offsetof(struct gsh_export, exp_pseudo_list),
+};
+
 /** List of all active exports,
   * protected by export_by_id.lock
   */
@@ -95,6 +135,261 @@ static struct glist_head mount_work;
   */
 static struct glist_head unexport_work;
 
+/**
+ * @brief Path component comparator for the export tries
+ */
+static int export_trie_cmpf(const struct avltree_node *lhs,
+			    const struct avltree_node *rhs)
+{
+	struct export_trie_node *lk, *rk;
+	int rc;
+
+	lk = avltree_container_of(lhs, struct export_trie_node, node_k);
+	rk = avltree_container_of(rhs, struct export_trie_node, node_k);
+
+	rc = memcmp(lk->name, rk->name, MIN(lk->len, rk->len));
+	if (rc != 0)
+		return rc;
+	if (lk->len != rk->len)
+		return (lk->len < rk->len) ? -1 : 1;
+	return 0;
+}
+
+static void export_trie_init(struct export_trie *trie)
+{
+	PTHREAD_RWLOCK_init(&trie->lock, NULL);
+	avltree_init(&trie->root.children, export_trie_cmpf, 0);
+	glist_init(&trie->root.exports);
+}
+
+/**
+ * @brief Length of a path as the tries see it
+ *
+ * A trailing '/' is ignored, so "/" is the empty path.
+ */
+static inline size_t export_trie_pathlen(const char *path)
+{
+	size_t len = strlen(path);
+
+	if (len > 0 && path[len - 1] == '/')
+		len--;
+
+	return len;
+}
+
+/**
+ * @brief Take the next component of a path
+ *
+ * @param[in,out] path Rest of the path, NULL past its last component
+ * @param[in]     end  End of the path
+ * @param[out]    key  Set to the component
+ */
+static inline void export_trie_next(const char **path, const char *end,
+				    struct export_trie_node *key)
+{
+	const char *slash = memchr(*path, '/', end - *path);
+
+	key->name = *path;
+	key->len = (slash != NULL ? slash : end) - *path;
+	*path = slash != NULL ? slash + 1 : NULL;
+}
+
+static inline struct export_trie_node *
+export_trie_child(struct export_trie_node *node, struct export_trie_node *key)
+{
+	struct avltree_node *child;
+
+	child = avltree_lookup(&key->node_k, &node->children);
+	if (child == NULL)
+		return NULL;
+
+	return avltree_container_of(child, struct export_trie_node, node_k);
+}
+
+static inline struct gsh_export *
+export_trie_export(struct export_trie *trie, struct glist_head *glist)
+{
+	return (struct gsh_export *)((char *)glist - trie->link);
+}
+
+/**
+ * @brief Add an export to a trie under its path
+ *
+ * Called with the trie locked for write.
+ *
+ * @return false if out of memory.
+ */
+static bool export_trie_insert(struct export_trie *trie,
+			       struct gsh_export *export, const char *path)
+{
+	struct export_trie_node key, *node = &trie->root, *child;
+	const char *end = path + export_trie_pathlen(path);
+	char *name;
+
+	while (path != NULL) {
+		export_trie_next(&path, end, &key);
+
+		child = export_trie_child(node, &key);
+		if (child == NULL) {
+			child = gsh_calloc(1, sizeof(*child) + key.len);
+			if (child == NULL)
+				return false;
+			name = (char *)(child + 1);
+			memcpy(name, key.name, key.len);
+			child->name = name;
+			child->len = key.len;
+			child->parent = node;
+			avltree_init(&child->children, export_trie_cmpf, 0);
+			glist_init(&child->exports);
+			(void)avltree_insert(&child->node_k, &node->children);
+		}
+		node = child;
+	}
+
+	glist_add_tail(&node->exports, (struct glist_head *)
+		       ((char *)export + trie->link));
+	return true;
+}
+
+/**
+ * @brief Remove an export from a trie
+ *
+ * Nodes left with no exports and no children are freed.  Called with
+ * the trie locked for write.
+ */
+static void export_trie_remove(struct export_trie *trie,
+			       struct gsh_export *export, const char *path)
+{
+	struct export_trie_node key, *node = &trie->root, *child;
+	const char *end = path + export_trie_pathlen(path);
+
+	glist_del((struct glist_head *)((char *)export + trie->link));
+
+	/* The path may be only partly there if its insert failed */
+	while (path != NULL) {
+		export_trie_next(&path, end, &key);
+		child = export_trie_child(node, &key);
+		if (child == NULL)
+			break;
+		node = child;
+	}
+
+	while (node != &trie->root &&
+	       glist_empty(&node->exports) &&
+	       avltree_size(&node->children) == 0) {
+		child = node;
+		node = node->parent;
+		avltree_remove(&child->node_k, &node->children);
+		gsh_free(child);
+	}
+}
+
+/**
+ * @brief Longest prefix lookup in a trie
+ *
+ * Exports match a path equal to theirs or starting with it and a '/',
+ * the root export any path starting with '/'.  Of several exports of
+ * the matching path, the first inserted is taken if it is the whole
+ * path, else the last, as the linear search of the export list did.
+ *
+ * @param trie        [IN] The trie to search
+ * @param path        [IN] The path to look up
+ * @param exact_match [IN] The path must match exactly
+ *
+ * @return pointer to ref counted export
+ */
+static struct gsh_export *export_trie_lookup(struct export_trie *trie,
+					     const char *path,
+					     bool exact_match)
+{
+	struct export_trie_node key, *node = &trie->root, *match = NULL;
+	const char *end = path + export_trie_pathlen(path);
+	struct gsh_export *export = NULL;
+	bool whole = false;
+
+	PTHREAD_RWLOCK_rdlock(&trie->lock);
+
+	while (path != NULL) {
+		export_trie_next(&path, end, &key);
+
+		node = export_trie_child(node, &key);
+		if (node == NULL)
+			break;
+
+		if (!glist_empty(&node->exports)) {
+			match = node;
+			whole = path == NULL;
+		}
+	}
+
+	if (match != NULL && (whole || !exact_match)) {
+		export = export_trie_export(trie, whole
+					    ? match->exports.next
+					    : match->exports.prev);
+		get_gsh_export_ref(export);
+	}
+
+	PTHREAD_RWLOCK_unlock(&trie->lock);
+
+	return export;
+}
+
+/**
+ * @brief Add an export to the tries
+ *
+ * Called with export_by_id.lock held for write.
+ *
+ * @return false if out of memory.
+ */
+static bool export_tries_insert(struct gsh_export *export)
+{
+	bool rc;
+
+	PTHREAD_RWLOCK_wrlock(&export_by_path.lock);
+	rc = export_trie_insert(&export_by_path, export, export->fullpath);
+	if (!rc)
+		export_trie_remove(&export_by_path, export, export->fullpath);
+	PTHREAD_RWLOCK_unlock(&export_by_path.lock);
+
+	if (!rc || export->pseudopath == NULL)
+		return rc;
+
+	PTHREAD_RWLOCK_wrlock(&export_by_pseudo.lock);
+	rc = export_trie_insert(&export_by_pseudo, export,
+				export->pseudopath);
+	if (!rc)
+		export_trie_remove(&export_by_pseudo, export,
+				   export->pseudopath);
+	PTHREAD_RWLOCK_unlock(&export_by_pseudo.lock);
+
+	if (!rc) {
+		PTHREAD_RWLOCK_wrlock(&export_by_path.lock);
+		export_trie_remove(&export_by_path, export, export->fullpath);
+		PTHREAD_RWLOCK_unlock(&export_by_path.lock);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Remove an export from the tries
+ *
+ * Called with export_by_id.lock held for write.
+ */
+static void export_tries_remove(struct gsh_export *export)
+{
+	PTHREAD_RWLOCK_wrlock(&export_by_path.lock);
+	export_trie_remove(&export_by_path, export, export->fullpath);
+	PTHREAD_RWLOCK_unlock(&export_by_path.lock);
+
+	if (export->pseudopath == NULL)
+		return;
+
+	PTHREAD_RWLOCK_wrlock(&export_by_pseudo.lock);
+	export_trie_remove(&export_by_pseudo, export, export->pseudopath);
+	PTHREAD_RWLOCK_unlock(&export_by_pseudo.lock);
+}
+
 void export_add_to_mount_work(struct gsh_export *export)
 {
 	PTHREAD_RWLOCK_wrlock(&export_by_id.lock);
@@ -180,6 +475,7 @@ void export_revert(struct gsh_export *export)
 	if (&export->node_k == cnode)
 		atomic_store_voidptr(cache_slot, NULL);
 	avltree_remove(&export->node_k, &export_by_id.t);
+	export_tries_remove(export);
 	glist_del(&export->exp_list);
 	glist_del(&export->exp_work);
 
@@ -222,6 +518,7 @@ struct gsh_export *alloc_export(void)
 	if (export_st == NULL)
 		return NULL;
 
+	export_st->st.nshards = server_stats_shards();
 	export = &export_st->export;
 
 	glist_init(&export->exp_state_list);
@@ -283,6 +580,15 @@ bool insert_gsh_export(struct gsh_export *export)
 		return false;
 	}
 
+	if (!export_tries_insert(export)) {
+		LogCrit(COMPONENT_EXPORT,
+			"Out of memory indexing export %d paths",
+			export->export_id);
+		avltree_remove(&export->node_k, &export_by_id.t);
+		PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+		return false;
+	}
+
 	/* we will hold a ref starting out... */
 	get_gsh_export_ref(export);
 
@@ -351,9 +657,9 @@ struct gsh_export *get_gsh_export(uint16_t export_id)
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list, assumes being called with
- * export manager lock held (such as from within foreach_gsh_export.
+ * Gets an export entry from its path using a substring match in the
+ * trie of full paths.  Needs no lock, but may be called with the
+ * export manager lock held (such as from within foreach_gsh_export).
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -365,71 +671,14 @@ struct gsh_export *get_gsh_export(uint16_t export_id)
 struct gsh_export *get_gsh_export_by_path_locked(char *path,
 						 bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		len_export = strlen(export->fullpath);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in fullpath just after the end of path is not '/'
-		 * it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
-
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->fullpath, path, len_export) == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
-
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
-
-	return ret_exp;
+	return export_trie_lookup(&export_by_path, path, exact_match);
 }
 
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list.
+ * Gets an export entry from its path using a substring match in the
+ * trie of full paths.
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -440,23 +689,15 @@ struct gsh_export *get_gsh_export_by_path_locked(char *path,
 
 struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 {
-	struct gsh_export *exp;
-
-	PTHREAD_RWLOCK_rdlock(&export_by_id.lock);
-
-	exp = get_gsh_export_by_path_locked(path, exact_match);
-
-	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
-
-	return exp;
+	return export_trie_lookup(&export_by_path, path, exact_match);
 }
 
 /**
  * @brief Lookup the export manager struct by export pseudo path
  *
- * Gets an export entry from its pseudo (if it exists), assumes
- * being called with export manager lock held (such as from within
- * foreach_gsh_export.
+ * Gets an export entry from its pseudo (if it exists) in the trie of
+ * pseudo paths.  Needs no lock, but may be called with the export
+ * manager lock held (such as from within foreach_gsh_export).
  *
  * @param path        [IN] the path for the entry to be found.
  * @param exact_match [IN] the path must match exactly
@@ -467,74 +708,7 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 						   bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	/* Ignore trailing slash in path */
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->pseudopath == NULL)
-			continue;
-
-		len_export = strlen(export->pseudopath);
-
-		LogFullDebug(COMPONENT_EXPORT,
-			     "Comparing %s %d to %s %d",
-			     path, len_path,
-			     export->pseudopath, len_export);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for Pseudo root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in pseudopath just after the end of path is not
-		 * '/' it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
-
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->pseudopath, path, len_export)
-		    == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
-
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
-
-	return ret_exp;
+	return export_trie_lookup(&export_by_pseudo, path, exact_match);
 }
 
 /**
@@ -550,15 +724,7 @@ struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 
 struct gsh_export *get_gsh_export_by_pseudo(char *path, bool exact_match)
 {
-	struct gsh_export *exp;
-
-	PTHREAD_RWLOCK_rdlock(&export_by_id.lock);
-
-	exp = get_gsh_export_by_pseudo_locked(path, exact_match);
-
-	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
-
-	return exp;
+	return export_trie_lookup(&export_by_pseudo, path, exact_match);
 }
 
 /**
@@ -662,6 +828,9 @@ void remove_gsh_export(uint16_t export_id)
 
 		export = avltree_container_of(node, struct gsh_export, node_k);
 
+		/* Remove from the path lookups */
+		export_tries_remove(export);
+
 		/* Remove the export from the export list */
 		glist_del(&export->exp_list);
 
@@ -1275,7 +1444,7 @@ static bool get_nfsv3_export_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v3_iostats(export_st->st.nfsv3, &iter);
+		server_dbus_v3_iostats(&export_st->st, &iter);
 
 	if (export != NULL)
 		put_gsh_export(export);
@@ -1320,7 +1489,7 @@ static bool get_nfsv40_export_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v40_iostats(export_st->st.nfsv40, &iter);
+		server_dbus_v40_iostats(&export_st->st, &iter);
 
 	if (export != NULL)
 		put_gsh_export(export);
@@ -1365,7 +1534,7 @@ static bool get_nfsv41_export_io(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v41_iostats(export_st->st.nfsv41, &iter);
+		server_dbus_v41_iostats(&export_st->st, &iter);
 
 	if (export != NULL)
 		put_gsh_export(export);
@@ -1410,7 +1579,7 @@ static bool get_nfsv41_export_layouts(DBusMessageIter *args,
 	}
 	dbus_status_reply(&iter, success, errormsg);
 	if (success)
-		server_dbus_v41_layouts(export_st->st.nfsv41, &iter);
+		server_dbus_v41_layouts(&export_st->st, &iter);
 
 	if (export != NULL)
 		put_gsh_export(export);
@@ -1495,6 +1664,357 @@ static bool show_cache_inode_stats(DBusMessageIter *args,
 	return true;
 }
 
+static bool show_fsal_sync_stats(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	fsal_sync_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_fsal_up_stats(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	fsal_up_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_delayed_stats(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	delayed_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_numa_stats(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	numa_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_deleg_policy_stats(DBusMessageIter *args,
+				    DBusMessage *reply,
+				    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	deleg_policy_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_startup_stats(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	startup_dbus_show(&iter);
+
+	return true;
+}
+
+/**
+ * DBUS method to report latency percentiles of an export
+ *
+ */
+
+static bool get_export_latency(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	struct export_stats *export_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!nfs_param.core_param.enable_latency_hist) {
+		success = false;
+		errormsg = "Latency histograms are not enabled";
+	} else {
+		export = lookup_export(args, &errormsg);
+		if (export == NULL)
+			success = false;
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success) {
+		export_st = container_of(export, struct export_stats, export);
+		server_dbus_latency_percentiles(&export_st->st, &iter);
+	}
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_latency = {
+	.name = "GetLatencyPercentiles",
+	.method = get_export_latency,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LAT_PERCENTILES_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report latency and queue wait histograms of an
+ * export operation
+ *
+ */
+
+static bool get_export_latency_histogram(DBusMessageIter *args,
+					 DBusMessage *reply,
+					 DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	struct export_stats *export_st = NULL;
+	char *opname = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!nfs_param.core_param.enable_latency_hist) {
+		success = false;
+		errormsg = "Latency histograms are not enabled";
+	} else {
+		export = lookup_export(args, &errormsg);
+		if (export == NULL)
+			success = false;
+	}
+	dbus_message_iter_next(args);
+	if (success)
+		success = arg_latency_op(args, &opname, &errormsg);
+	if (success) {
+		export_st = container_of(export, struct export_stats, export);
+		if (!server_stats_has_latency(&export_st->st, opname)) {
+			success = false;
+			errormsg = "Export does not have any activity for op";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_latency_histogram(&export_st->st, opname, &iter);
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_latency_histogram = {
+	.name = "GetLatencyHistogram",
+	.method = get_export_latency_histogram,
+	.args = {EXPORT_ID_ARG,
+		 LAT_OP_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LAT_HISTOGRAM_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report server wide latency percentiles
+ *
+ * The window argument selects since start (0) or the last complete
+ * 1, 10 or 60 second period.
+ */
+
+static bool get_global_latency(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	uint32_t window = 0;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!nfs_param.core_param.enable_latency_hist) {
+		success = false;
+		errormsg = "Latency histograms are not enabled";
+	} else {
+		success = arg_latency_window(args, &window, &errormsg);
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		global_dbus_latency_percentiles(window, &iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method global_show_latency = {
+	.name = "GetGlobalLatency",
+	.method = get_global_latency,
+	.args = {LAT_WINDOW_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LAT_PERCENTILES_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief Find the FSAL named by a DBus argument
+ *
+ * @param args     [IN]  message argument iterator
+ * @param errormsg [OUT] reason on failure
+ *
+ * @return The FSAL with a reference taken, or NULL.
+ */
+
+static struct fsal_module *lookup_fsal_arg(DBusMessageIter *args,
+					   char **errormsg)
+{
+	struct fsal_module *fsal_hdl;
+	char *name;
+
+	if (args == NULL) {
+		*errormsg = "message is missing argument";
+		return NULL;
+	}
+	if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_STRING) {
+		*errormsg = "arg not a string";
+		return NULL;
+	}
+	dbus_message_iter_get_basic(args, &name);
+	fsal_hdl = lookup_fsal(name);
+	if (fsal_hdl == NULL)
+		*errormsg = "FSAL not loaded";
+	return fsal_hdl;
+}
+
+/**
+ * DBUS method to report the statistics an FSAL keeps of its methods
+ *
+ */
+
+static bool get_fsal_stats(DBusMessageIter *args,
+			   DBusMessage *reply,
+			   DBusError *error)
+{
+	struct fsal_module *fsal_hdl;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	fsal_hdl = lookup_fsal_arg(args, &errormsg);
+	if (fsal_hdl == NULL) {
+		success = false;
+	} else if (!fsal_hdl->m_ops.fsal_extract_stats(fsal_hdl, NULL)) {
+		success = false;
+		errormsg = "FSAL does not keep statistics";
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		fsal_hdl->m_ops.fsal_extract_stats(fsal_hdl, &iter);
+
+	if (fsal_hdl != NULL)
+		fsal_put(fsal_hdl);
+	return true;
+}
+
+static struct gsh_dbus_method fsal_show_stats = {
+	.name = "GetFSALStats",
+	.method = get_fsal_stats,
+	.args = {FSAL_NAME_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 FSAL_STATS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to zero the statistics an FSAL keeps
+ *
+ */
+
+static bool reset_fsal_stats(DBusMessageIter *args,
+			     DBusMessage *reply,
+			     DBusError *error)
+{
+	struct fsal_module *fsal_hdl;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+	struct timespec timestamp;
+
+	dbus_message_iter_init_append(reply, &iter);
+	fsal_hdl = lookup_fsal_arg(args, &errormsg);
+	if (fsal_hdl == NULL) {
+		success = false;
+	} else if (!fsal_hdl->m_ops.fsal_extract_stats(fsal_hdl, NULL)) {
+		success = false;
+		errormsg = "FSAL does not keep statistics";
+	} else {
+		fsal_hdl->m_ops.fsal_reset_stats(fsal_hdl);
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	if (fsal_hdl != NULL)
+		fsal_put(fsal_hdl);
+	return true;
+}
+
+static struct gsh_dbus_method fsal_reset_stats = {
+	.name = "ResetFSALStats",
+	.method = reset_fsal_stats,
+	.args = {FSAL_NAME_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method export_show_v41_layouts = {
 	.name = "GetNFSv41Layouts",
 	.method = get_nfsv41_export_layouts,
@@ -1637,6 +2157,75 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+/** Syncs asked for by stable writes and COMMITs, and syncs made */
+
+static struct gsh_dbus_method fsal_sync_show = {
+	.name = "ShowFSALSync",
+	.method = show_fsal_sync_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+/** Upcalls batched and merged, and batches applied */
+
+static struct gsh_dbus_method fsal_up_show = {
+	.name = "ShowUpcalls",
+	.method = show_fsal_up_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+/** Timers of the delayed executor, cancelled, run and stolen, and
+ *  the depth of its run queues */
+
+static struct gsh_dbus_method delayed_show = {
+	.name = "ShowDelayed",
+	.method = show_delayed_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+/** Requests queued on each NUMA node, and those handed off to
+    workers of another node */
+
+static struct gsh_dbus_method numa_show = {
+	.name = "ShowNUMA",
+	.method = show_numa_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 NUMA_NODES_REPLY,
+		 END_ARG_LIST}
+};
+
+/** Delegations granted and refused by Adaptive_Delegations, and
+    measured recall latency */
+
+static struct gsh_dbus_method deleg_policy_show = {
+	.name = "ShowDelegPolicy",
+	.method = show_deleg_policy_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+/** Microseconds taken by each phase of startup */
+
+static struct gsh_dbus_method startup_show = {
+	.name = "ShowStartup",
+	.method = show_startup_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
 /**
  * @brief Report all IO stats of all exports in one call
  *
@@ -1704,7 +2293,18 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&fsal_sync_show,
+	&fsal_up_show,
+	&delayed_show,
+	&numa_show,
+	&deleg_policy_show,
+	&startup_show,
 	&export_show_all_io,
+	&export_show_latency,
+	&export_show_latency_histogram,
+	&global_show_latency,
+	&fsal_show_stats,
+	&fsal_reset_stats,
 	NULL
 };
 
@@ -1747,6 +2347,8 @@ void export_pkginit(void)
 	memset(&export_by_id.cache, 0, sizeof(export_by_id.cache));
 
 	glist_init(&exportlist);
+	export_trie_init(&export_by_path);
+	export_trie_init(&export_by_pseudo);
 	glist_init(&mount_work);
 	glist_init(&unexport_work);
 }
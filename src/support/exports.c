@@ -1544,25 +1544,122 @@ void free_export_resources(struct gsh_export *export)
 		gsh_free(export->FS_tag);
 }
 
+/** Exports whose roots exports_pkginit looks up */
+struct export_init_work {
+	struct gsh_export **exports;
+	uint32_t count;
+	uint32_t alloc;
+	uint32_t next;		/*< Next export to take */
+	uint32_t failed;
+};
+
 /**
- * @brief pkginit callback to initialize exports from nfs_init
+ * @brief pkginit callback collecting a reference to each export
  *
- * Assumes being called with the export_by_id.lock held.
+ * Called with the export_by_id.lock held.
  * true on success
  */
 
 static bool init_export_cb(struct gsh_export *exp, void *state)
 {
-	return !(init_export_root(exp));
+	struct export_init_work *work = state;
+	struct gsh_export **exports;
+
+	if (work->count == work->alloc) {
+		exports = gsh_realloc(work->exports,
+				      (work->alloc * 2 + 16) *
+				      sizeof(*exports));
+		if (exports == NULL)
+			return false;
+		work->exports = exports;
+		work->alloc = work->alloc * 2 + 16;
+	}
+
+	get_gsh_export_ref(exp);
+	work->exports[work->count++] = exp;
+	return true;
+}
+
+/**
+ * @brief Look up export roots until there are none left
+ */
+
+static void init_export_roots(struct export_init_work *work)
+{
+	uint32_t i;
+
+	while ((i = atomic_postinc_uint32_t(&work->next)) < work->count)
+		if (init_export_root(work->exports[i]) != 0)
+			atomic_inc_uint32_t(&work->failed);
+}
+
+static void *init_export_thread(void *arg)
+{
+	SetNameFunction("export_init");
+	init_export_roots(arg);
+	return NULL;
 }
 
 /**
  * @brief Initialize exports over a live cache inode and fsal layer
+ *
+ * The roots are looked up by up to Export_Init_Threads threads, this
+ * one among them, since each lookup may wait on a slow backend.  An
+ * export whose root cannot be found does not hold up the others.
  */
 
 void exports_pkginit(void)
 {
-	foreach_gsh_export(init_export_cb, NULL);
+	struct export_init_work work;
+	pthread_t *threads;
+	uint32_t nthreads = nfs_param.core_param.export_init_threads;
+	uint32_t started = 0, i;
+	struct timespec start, end;
+	int rc;
+
+	memset(&work, 0, sizeof(work));
+	now(&start);
+
+	if (!foreach_gsh_export(init_export_cb, &work))
+		LogCrit(COMPONENT_INIT,
+			"Could not list exports, only %u roots initialized",
+			work.count);
+
+	if (nthreads > work.count)
+		nthreads = work.count;
+
+	threads = nthreads > 1
+		? gsh_calloc(nthreads - 1, sizeof(*threads)) : NULL;
+
+	if (threads != NULL) {
+		for (started = 0; started < nthreads - 1; started++) {
+			rc = pthread_create(&threads[started], NULL,
+					    init_export_thread, &work);
+			if (rc != 0) {
+				LogWarn(COMPONENT_INIT,
+					"Could not start export init thread: %s",
+					strerror(rc));
+				break;
+			}
+		}
+	}
+
+	init_export_roots(&work);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < work.count; i++)
+		put_gsh_export(work.exports[i]);
+
+	now(&end);
+	LogEvent(COMPONENT_INIT,
+		 "Initialized %u export roots with %u threads in %" PRIu64
+		 " ms, %u failed", work.count, started + 1,
+		 timespec_diff(&start, &end) / NS_PER_MSEC, work.failed);
+
+	gsh_free(threads);
+	gsh_free(work.exports);
 }
 
 /**
@@ -1600,7 +1697,8 @@ cache_inode_status_t nfs_export_get_root_entry(struct gsh_export *export,
 /**
  * @brief Initialize the root cache inode for an export.
  *
- * Assumes being called with the export_by_id.lock held.
+ * The caller holds a reference to the export.  Exports may be
+ * initialized concurrently, even ones with the same root.
  *
  * @param exp [IN] the export
  *
@@ -1680,7 +1778,7 @@ int init_export_root(struct gsh_export *export)
 
 	export->exp_root_cache_inode = entry;
 
-	glist_add_tail(&entry->object.dir.export_roots,
+	glist_add_tail(&entry->object.dir->export_roots,
 		       &export->exp_root_list);
 
 	/* Protect this entry from removal (unlink) */
@@ -1819,7 +1917,7 @@ void kill_export_root_entry(cache_entry_t *entry)
 	while (true) {
 		PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 
-		export = glist_first_entry(&entry->object.dir.export_roots,
+		export = glist_first_entry(&entry->object.dir->export_roots,
 					   struct gsh_export,
 					   exp_root_list);
 
@@ -1858,7 +1956,7 @@ void kill_export_junction_entry(cache_entry_t *entry)
 
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 
-	export = entry->object.dir.junction_export;
+	export = entry->object.dir->junction_export;
 
 	if (export == NULL) {
 		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
@@ -1866,7 +1964,7 @@ void kill_export_junction_entry(cache_entry_t *entry)
 	}
 
 	/* Detach the export from the inode */
-	entry->object.dir.junction_export = NULL;
+	entry->object.dir->junction_export = NULL;
 
 	get_gsh_export_ref(export);
 
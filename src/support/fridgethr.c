@@ -48,6 +48,7 @@
 #endif
 #include "abstract_mem.h"
 #include "fridgethr.h"
+#include "gsh_numa.h"
 #include "nfs_core.h"
 
 /**
@@ -554,6 +555,9 @@ static void *fridgethr_start_routine(void *arg)
 	   which would indicate bugs in the code. */
 	assert(rc == 0);
 
+	if (fr->p.numa_bind)
+		gsh_numa_bind(fr->p.numa_node);
+
 	if (fr->p.thread_initialize)
 		fr->p.thread_initialize(&fe->ctx);
 
@@ -0,0 +1,227 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @defgroup Server statistics management
+ * @{
+ */
+
+/**
+ * @file latency_histogram.c
+ * @brief Log-linear latency histograms
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include "gsh_intrinsic.h"
+#include "abstract_mem.h"
+#include "latency_histogram.h"
+
+/**
+ * @brief Shard used by the calling thread
+ *
+ * Threads are handed shards round robin the first time they record,
+ * which spreads the worker pool evenly without needing to know which
+ * CPU we are running on.
+ */
+
+static __thread uint32_t thread_shard = UINT32_MAX;
+static uint32_t next_shard;
+
+uint32_t lat_hist_thread_shard(void)
+{
+	if (unlikely(thread_shard == UINT32_MAX))
+		thread_shard = atomic_postinc_uint32_t(&next_shard);
+	return thread_shard;
+}
+
+/**
+ * @brief Value reported for a bucket
+ *
+ * This is the highest value counted in the bucket, so percentiles
+ * are never understated.  The overflow bucket reports its lowest
+ * value since it has no upper bound.
+ *
+ * @param[in] idx Bucket index
+ *
+ * @return Value in nanoseconds.
+ */
+
+uint64_t lat_hist_bucket_value(unsigned int idx)
+{
+	unsigned int shift;
+	uint64_t low;
+
+	if (idx < LAT_HIST_SUB_BUCKETS)
+		return idx;
+
+	shift = idx / LAT_HIST_SUB_BUCKETS - 1;
+	low = (uint64_t)(LAT_HIST_SUB_BUCKETS + idx % LAT_HIST_SUB_BUCKETS)
+	    << shift;
+
+	if (idx == LAT_HIST_OVERFLOW)
+		return low;
+
+	return low + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * @brief Number of values counted in a histogram
+ */
+
+uint64_t lat_hist_count(const struct lat_histogram *hist)
+{
+	uint64_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		count += hist->bucket[i];
+	return count;
+}
+
+/**
+ * @brief Largest value counted in a histogram
+ *
+ * @return Value of the highest non-empty bucket, 0 if empty.
+ */
+
+uint64_t lat_hist_max(const struct lat_histogram *hist)
+{
+	int i;
+
+	for (i = LAT_HIST_BUCKETS - 1; i >= 0; i--)
+		if (hist->bucket[i] != 0)
+			return lat_hist_bucket_value(i);
+	return 0;
+}
+
+/**
+ * @brief Compute a percentile
+ *
+ * @param[in] hist  Histogram (not being updated, i.e. a copy)
+ * @param[in] count Result of lat_hist_count on hist
+ * @param[in] pct   Percentile wanted, 0 < pct <= 100
+ *
+ * @return Value in nanoseconds, 0 if the histogram is empty.
+ */
+
+uint64_t lat_hist_percentile(const struct lat_histogram *hist,
+			     uint64_t count, double pct)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (count == 0)
+		return 0;
+
+	rank = (uint64_t)(count * pct / 100.0);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		seen += hist->bucket[i];
+		if (seen >= rank)
+			return lat_hist_bucket_value(i);
+	}
+	return lat_hist_max(hist);
+}
+
+/**
+ * @brief Accumulate a histogram into another
+ */
+
+void lat_hist_add(struct lat_histogram *sum,
+		  const struct lat_histogram *hist)
+{
+	unsigned int i;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		sum->bucket[i] += atomic_fetch_uint64_t(
+				(uint64_t *)&hist->bucket[i]);
+}
+
+/**
+ * @brief Difference between two snapshots of the same histogram
+ */
+
+void lat_hist_delta(struct lat_histogram *delta,
+		    const struct lat_histogram *now,
+		    const struct lat_histogram *then)
+{
+	unsigned int i;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		delta->bucket[i] = now->bucket[i] - then->bucket[i];
+}
+
+/**
+ * @brief Allocate the shards of a sharded histogram
+ *
+ * @param[out] hs      Histogram to set up
+ * @param[in]  nshards Number of shards wanted, clamped to
+ *                     [1, LAT_HIST_MAX_SHARDS]
+ *
+ * @return true on success, false on allocation failure.
+ */
+
+bool lat_hist_shards_init(struct lat_hist_shards *hs, uint32_t nshards)
+{
+	if (nshards == 0)
+		nshards = 1;
+	else if (nshards > LAT_HIST_MAX_SHARDS)
+		nshards = LAT_HIST_MAX_SHARDS;
+
+	hs->shard = gsh_calloc(nshards, sizeof(struct lat_histogram));
+	if (hs->shard == NULL) {
+		hs->nshards = 0;
+		return false;
+	}
+	hs->nshards = nshards;
+	return true;
+}
+
+void lat_hist_shards_destroy(struct lat_hist_shards *hs)
+{
+	gsh_free(hs->shard);
+	hs->shard = NULL;
+	hs->nshards = 0;
+}
+
+/**
+ * @brief Sum the shards of a sharded histogram
+ *
+ * @param[in]  hs  Sharded histogram
+ * @param[out] sum Zeroed and filled with the total
+ */
+
+void lat_hist_shards_sum(struct lat_hist_shards *hs,
+			 struct lat_histogram *sum)
+{
+	uint32_t i;
+
+	memset(sum, 0, sizeof(*sum));
+	for (i = 0; i < hs->nshards; i++)
+		lat_hist_add(sum, &hs->shard[i]);
+}
+
+/** @} */
@@ -42,6 +42,7 @@
 #include "nfs_convert.h"
 #include "export_mgr.h"
 #include "fsal_convert.h"
+#include "cache_inode_hash.h"
 
 /**
  *
@@ -159,6 +160,11 @@ cache_entry_t *nfs3_FhandleToCache(nfs_fh3 *fh3,
 
 	if (FSAL_IS_ERROR(fsal_status))
 		cache_status = cache_inode_error_convert(fsal_status);
+	else if (v3_handle->fhflags1 & FH_CACHE_HINT)
+		cache_status = cache_inode_get_hinted(
+			&fsal_data,
+			nfs_fh_hint(v3_handle->fsopaque, v3_handle->fs_len),
+			&entry);
 	else
 		cache_status = cache_inode_get(&fsal_data, &entry);
 
@@ -172,6 +178,39 @@ cache_entry_t *nfs3_FhandleToCache(nfs_fh3 *fh3,
 	return entry;
 }
 
+/**
+ * @brief Append the cache hint of an object to its handle
+ *
+ * The hint is the hash its cache entry is stored under, which
+ * cache_inode_get_hinted takes instead of hashing the handle.  It is
+ * only added if File_Handle_Hints is set and the handle still fits in
+ * maxlen.
+ *
+ * @param[in,out] fhflags1   Flags of the handle
+ * @param[out]    hint       Where the hint goes, just past the opaque
+ * @param[in]     hsize      Size of the handle without the hint
+ * @param[in]     maxlen     Largest handle allowed
+ * @param[in]     fsalhandle The FSAL object of the handle
+ */
+
+static void nfs_fh_add_hint(uint8_t *fhflags1, uint8_t *hint, size_t hsize,
+			    size_t maxlen,
+			    const struct fsal_obj_handle *fsalhandle)
+{
+	struct fsal_obj_handle *obj = (struct fsal_obj_handle *)fsalhandle;
+	struct gsh_buffdesc key;
+	uint64_t hk;
+
+	if (!nfs_param.core_param.fh_hints || hsize + FH_HINT_SIZE > maxlen)
+		return;
+
+	obj->obj_ops.handle_to_key(obj, &key);
+	hk = cih_hash_fh(&key);
+
+	memcpy(hint, &hk, sizeof(hk));
+	*fhflags1 |= FH_CACHE_HINT;
+}
+
 /**
  * @brief Converts an FSAL object to an NFSv4 file handle
  *
@@ -213,6 +252,11 @@ bool nfs4_FSALToFhandle(nfs_fh4 *fh4,
 	/* keep track of the export id */
 	file_handle->id.exports = exp->export_id;
 
+	nfs_fh_add_hint(&file_handle->fhflags1,
+			file_handle->fsopaque + file_handle->fs_len,
+			nfs4_sizeof_handle(file_handle), NFS4_FHSIZE,
+			fsalhandle);
+
 	/* Set the len */
 	fh4->nfs_fh4_len = nfs4_sizeof_handle(file_handle);
 
@@ -269,6 +313,15 @@ bool nfs3_FSALToFhandle(nfs_fh3 *fh3,
 	/* keep track of the export id */
 	file_handle->exportid = exp->export_id;
 
+	/* VMware's 56 byte limit is not worth breaking for a hint */
+	nfs_fh_add_hint(&file_handle->fhflags1,
+			file_handle->fsopaque + file_handle->fs_len,
+			offsetof(file_handle_v3_t, fsopaque) +
+				file_handle->fs_len,
+			nfs_param.core_param.short_file_handle
+				? 56 : NFS3_FHSIZE,
+			fsalhandle);
+
 	/* Set the len */
 	/* re-adjust to as built */
 	fh3->data.data_len = nfs3_sizeof_handle(file_handle);
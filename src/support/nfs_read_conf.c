@@ -142,6 +142,18 @@ static struct config_item core_params[] = {
 		       nfs_core_param, rpc.max_recv_buffer_size),
 	CONF_ITEM_UI32("RPC_Ioq_ThrdMax", 1, 1024*128, 200,
 		       nfs_core_param, rpc.ioq_thrd_max),
+	CONF_ITEM_UI32("RPC_UDP_Batch", 1, 256, RPC_DEFAULT_UDP_BATCH,
+		       nfs_core_param, rpc.udp_batch),
+	CONF_ITEM_UI32("RPC_UDP_Sockets", 1, RPC_MAX_UDP_SOCKETS, 1,
+		       nfs_core_param, rpc.udp_sockets),
+	CONF_ITEM_UI32("RPC_TCP_Event_Channels", 0, RPC_MAX_TCP_EVENT_CHAN, 0,
+		       nfs_core_param, rpc.tcp_evchans),
+	CONF_ITEM_BOOL("RPC_TCP_Channel_Listeners", false,
+		       nfs_core_param, rpc.tcp_chan_listeners),
+	CONF_ITEM_BOOL("RPC_Event_Channel_Affinity", false,
+		       nfs_core_param, rpc.evchan_affinity),
+	CONF_ITEM_BOOL("RPC_TCP_Rebalance", false,
+		       nfs_core_param, rpc.tcp_rebalance),
 	CONF_ITEM_I64("Decoder_Fridge_Expiration_Delay", 0, 7200, 600,
 		      nfs_core_param, decoder_fridge_expiration_delay),
 	CONF_ITEM_I64("Decoder_Fridge_Block_Timeout", 0, 7200, 600,
@@ -160,8 +172,20 @@ static struct config_item core_params[] = {
 		       nfs_core_param, enable_RQUOTA),
 	CONF_ITEM_BOOL("Enable_Fast_Stats", false,
 		       nfs_core_param, enable_FASTSTATS),
+	CONF_ITEM_BOOL("Enable_Latency_Histograms", false,
+		       nfs_core_param, enable_latency_hist),
+	CONF_ITEM_UI32("Stats_Shards", 0, 64, 0,
+		       nfs_core_param, stats_shards),
 	CONF_ITEM_BOOL("Short_File_Handle", false,
 		       nfs_core_param, short_file_handle),
+	CONF_ITEM_BOOL("File_Handle_Hints", false,
+		       nfs_core_param, fh_hints),
+	CONF_ITEM_UI32("Export_Init_Threads", 1, 256, 4,
+		       nfs_core_param, export_init_threads),
+	CONF_ITEM_UI32("Delayed_Exec_Threads", 1, 64, 4,
+		       nfs_core_param, delayed_exec_threads),
+	CONF_ITEM_BOOL("NUMA_Worker_Pools", false,
+		       nfs_core_param, numa_pools),
 	CONF_ITEM_I64("Manage_Gids_Expiration", 0, 7*24*60*60, 30*60,
 			nfs_core_param, manage_gids_expiration),
 	CONF_ITEM_PATH("Plugins_Dir", 1, MAXPATHLEN, FSAL_MODULE_LOC,
@@ -196,6 +220,8 @@ static struct config_item krb5_params[] = {
 		       nfs_krb5_param, ccache_dir),
 	CONF_ITEM_BOOL("Active_krb5", true,
 		       nfs_krb5_param, active_krb5),
+	CONF_ITEM_UI32("Unwrap_Offload_Size", 0, UINT32_MAX, 0,
+		       nfs_krb5_param, unwrap_offload_size),
 	CONFIG_EOL
 };
 
@@ -241,10 +267,20 @@ static struct config_item version4_params[] = {
 	CONF_ITEM_UI32("Deleg_Recall_Retry_Delay", 0, 10,
 			DELEG_RECALL_RETRY_DELAY_DEFAULT,
 			nfs_version4_parameter, deleg_recall_retry_delay),
+	CONF_ITEM_BOOL("Adaptive_Delegations", false,
+		       nfs_version4_parameter, adaptive_delegations),
+	CONF_ITEM_UI32("Deleg_Open_Cost", 1, 10000000,
+		       DELEG_OPEN_COST_DEFAULT,
+		       nfs_version4_parameter, deleg_open_cost),
+	CONF_ITEM_UI32("Deleg_Recall_Cost", 1, 100000000,
+		       DELEG_RECALL_COST_DEFAULT,
+		       nfs_version4_parameter, deleg_recall_cost),
 	CONF_ITEM_BOOL("PNFS_MDS", true,
 		       nfs_version4_parameter, pnfs_mds),
 	CONF_ITEM_BOOL("PNFS_DS", true,
 		       nfs_version4_parameter, pnfs_ds),
+	CONF_ITEM_BOOL("Fast_Fattr_Encode", true,
+		       nfs_version4_parameter, fast_fattr_encode),
 	CONFIG_EOL
 };
 
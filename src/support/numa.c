@@ -0,0 +1,277 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @addtogroup numa
+ * @{
+ */
+
+/**
+ * @file numa.c
+ * @brief NUMA nodes and binding threads to them
+ *
+ * The nodes are read from sysfs rather than through libnuma, so that
+ * the server does not depend on it.  Memory is preferred from a node
+ * with set_mempolicy(2) where the system has it; elsewhere binding a
+ * thread to the CPUs of a node leaves the memory it first touches
+ * there.
+ */
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef LINUX
+#include <linux/mempolicy.h>
+#endif
+#include "log.h"
+#include "gsh_numa.h"
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+
+/** Kernel node numbers a memory policy can name */
+#define NUMA_KERNEL_NODES 1024
+#define NUMA_MASK_BITS (8 * sizeof(unsigned long))
+
+/**
+ * @brief A node, as pools see it
+ *
+ * Past GSH_NUMA_MAX_NODES kernel nodes share pools, so a pool may
+ * have the CPUs of several.
+ */
+
+struct numa_node {
+	cpu_set_t cpus;		/*< CPUs we may run on */
+	unsigned long mems[NUMA_KERNEL_NODES / NUMA_MASK_BITS];
+				/*< Kernel nodes to allocate from */
+};
+
+static struct numa_node numa_node[GSH_NUMA_MAX_NODES];
+static uint32_t numa_nnodes = 1;
+static bool numa_bound;		/*< Threads are bound to nodes */
+
+__thread uint32_t gsh_numa_this_node;
+
+/**
+ * @brief Parse a sysfs list such as "0-7,16-23"
+ *
+ * @param[in]  s   The list
+ * @param[out] set The numbers in it
+ *
+ * @return false if the list is malformed or too large.
+ */
+
+static bool numa_parse_list(const char *s, cpu_set_t *set)
+{
+	unsigned long lo, hi;
+	char *end;
+
+	CPU_ZERO(set);
+	while (*s != '\0' && *s != '\n') {
+		lo = strtoul(s, &end, 10);
+		if (end == s)
+			return false;
+		hi = lo;
+		s = end;
+		if (*s == '-') {
+			hi = strtoul(s + 1, &end, 10);
+			if (end == s + 1 || hi < lo)
+				return false;
+			s = end;
+		}
+		if (hi >= CPU_SETSIZE)
+			return false;
+		for (; lo <= hi; lo++)
+			CPU_SET(lo, set);
+		if (*s == ',')
+			s++;
+	}
+	return true;
+}
+
+static bool numa_read_list(const char *path, cpu_set_t *set)
+{
+	char buf[4096];
+	FILE *f = fopen(path, "r");
+	bool ok;
+
+	if (f == NULL)
+		return false;
+	ok = fgets(buf, sizeof(buf), f) != NULL && numa_parse_list(buf, set);
+	fclose(f);
+	return ok;
+}
+
+/**
+ * @brief Find the NUMA nodes
+ *
+ * Nodes with no CPU the process may run on are skipped.  With fewer
+ * than two nodes left there is nothing to bind.
+ *
+ * @param[in] pools NUMA_Worker_Pools
+ */
+
+void gsh_numa_init(bool pools)
+{
+	cpu_set_t allowed, online, cpus;
+	char path[64];
+	uint32_t n = 0, ix;
+	int node;
+
+	if (!pools)
+		return;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		LogWarn(COMPONENT_THREAD,
+			"Cannot get the CPUs of the process, error %d(%s), no NUMA worker pools",
+			errno, strerror(errno));
+		return;
+	}
+
+	if (!numa_read_list(NUMA_SYSFS "/online", &online)) {
+		LogWarn(COMPONENT_THREAD,
+			"Cannot read the NUMA nodes from %s, no NUMA worker pools",
+			NUMA_SYSFS);
+		return;
+	}
+
+	for (node = 0; node < NUMA_KERNEL_NODES; node++) {
+		if (!CPU_ISSET(node, &online))
+			continue;
+
+		snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist",
+			 node);
+		if (!numa_read_list(path, &cpus)) {
+			LogWarn(COMPONENT_THREAD, "Cannot read %s", path);
+			continue;
+		}
+
+		CPU_AND(&cpus, &cpus, &allowed);
+		if (CPU_COUNT(&cpus) == 0)
+			continue;
+
+		ix = n % GSH_NUMA_MAX_NODES;
+		CPU_OR(&numa_node[ix].cpus, &numa_node[ix].cpus, &cpus);
+		numa_node[ix].mems[node / NUMA_MASK_BITS] |=
+			1UL << (node % NUMA_MASK_BITS);
+		LogInfo(COMPONENT_THREAD,
+			"NUMA node %d, %d CPUs, is pool %" PRIu32,
+			node, CPU_COUNT(&cpus), ix);
+		n++;
+	}
+
+	if (n < 2) {
+		LogInfo(COMPONENT_THREAD,
+			"A single NUMA node, no NUMA worker pools");
+		memset(numa_node, 0, sizeof(numa_node));
+		return;
+	}
+
+	numa_nnodes = n;
+	if (numa_nnodes > GSH_NUMA_MAX_NODES)
+		numa_nnodes = GSH_NUMA_MAX_NODES;
+	numa_bound = true;
+
+	LogEvent(COMPONENT_THREAD, "%" PRIu32 " NUMA worker pools",
+		 numa_nnodes);
+}
+
+/**
+ * @brief Number of nodes
+ */
+
+uint32_t gsh_numa_nodes(void)
+{
+	return numa_nnodes;
+}
+
+/**
+ * @brief Bind the calling thread to a node
+ *
+ * The thread runs on the CPUs of the node and allocates from its
+ * memory first.  Does nothing without NUMA worker pools.
+ *
+ * @param[in] node The node
+ */
+
+void gsh_numa_bind(uint32_t node)
+{
+	struct numa_node *nn;
+	int rc;
+
+	if (!numa_bound || node >= numa_nnodes)
+		return;
+
+	nn = &numa_node[node];
+	rc = pthread_setaffinity_np(pthread_self(), sizeof(nn->cpus),
+				    &nn->cpus);
+	if (rc != 0) {
+		LogWarn(COMPONENT_THREAD,
+			"Cannot bind thread to NUMA pool %" PRIu32
+			", error %d(%s)", node, rc, strerror(rc));
+		return;
+	}
+
+#if defined(LINUX) && defined(SYS_set_mempolicy)
+	/* maxnode counts one past the last bit, as the kernel reads it */
+	if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nn->mems,
+		    NUMA_KERNEL_NODES + 1) != 0)
+		LogDebug(COMPONENT_THREAD,
+			 "Cannot prefer the memory of NUMA pool %" PRIu32
+			 ", error %d(%s)", node, errno, strerror(errno));
+#endif
+
+	gsh_numa_this_node = node;
+}
+
+/**
+ * @brief A node's share of a number of threads
+ *
+ * The shares add up to total, so with fewer threads than nodes the
+ * last nodes get none.
+ *
+ * @param[in] total Threads over all nodes
+ * @param[in] node  The node
+ *
+ * @return The threads of the node.
+ */
+
+uint32_t gsh_numa_share(uint32_t total, uint32_t node)
+{
+	uint32_t share = total / numa_nnodes;
+
+	if (node < total % numa_nnodes)
+		share++;
+	return share;
+}
+
+/** @} */
@@ -58,8 +58,15 @@
 #include "client_mgr.h"
 #include "export_mgr.h"
 #include "server_stats.h"
+#include "gsh_numa.h"
+#include "cache_inode_lru.h"
+#include "FSAL/fsal_commonlib.h"
+#include "fsal_up.h"
+#include "sal_functions.h"
 #include <abstract_atomic.h>
 #include "nfs_proto_functions.h"
+#include "latency_histogram.h"
+#include "delayed_exec.h"
 
 #define NFS_V3_NB_COMMAND (NFSPROC3_COMMIT + 1)
 #define NFS_V4_NB_COMMAND 2
@@ -72,6 +79,23 @@
 #define NFS_V42_NB_OPERATION (NFS4_OP_WRITE_SAME + 1)
 #define _9P_NB_COMMAND 33
 
+/** Time taken by each phase of startup, from ServerBootTime */
+static struct {
+	const char *name;
+	nsecs_elapsed_t start;
+	nsecs_elapsed_t elapsed;
+} startup_phases[STARTUP_PHASES] = {
+	[STARTUP_FSALS] = { .name = "fsals" },
+	[STARTUP_EXPORTS] = { .name = "exports" },
+	[STARTUP_EXPORT_ROOTS] = { .name = "export_roots" },
+	[STARTUP_PSEUDOFS] = { .name = "pseudofs" },
+	[STARTUP_RECOVERY] = { .name = "recovery" },
+	[STARTUP_SERVICES] = { .name = "services" },
+};
+
+/** When the server was ready to serve, from ServerBootTime */
+static nsecs_elapsed_t startup_ready;
+
 #ifdef USE_DBUS
 
 struct op_name {
@@ -261,6 +285,12 @@ static const uint32_t nfsv42_optype[NFS_V42_NB_OPERATION] = {
 	[NFS4_OP_READ_PLUS] = READ_OP,
 };
 
+/* Per protocol stats are kept in shards so that concurrent requests
+ * do not bounce the same cache lines.  Shards are cache line aligned.
+ */
+#define STATS_CACHE_LINE 64
+#define STATS_MAX_SHARDS 64
+
 /* latency stats
  */
 struct op_latency {
@@ -299,6 +329,35 @@ struct nfsv4_ops {
 	uint64_t op[NFS4_OP_LAST_ONE];
 };
 
+/* latency histogram windows, global ops only
+ */
+
+enum hist_window {
+	HIST_WIN_1S,
+	HIST_WIN_10S,
+	HIST_WIN_60S,
+	HIST_WIN_COUNT
+};
+
+static const uint32_t hist_win_secs[HIST_WIN_COUNT] = { 1, 10, 60 };
+
+struct op_hist_window {
+	struct lat_histogram snap_latency[HIST_WIN_COUNT];
+	struct lat_histogram snap_qwait[HIST_WIN_COUNT];
+	struct lat_histogram last_latency[HIST_WIN_COUNT];
+	struct lat_histogram last_qwait[HIST_WIN_COUNT];
+};
+
+/* latency histograms, allocated on first use when
+ * Enable_Latency_Histograms is set
+ */
+
+struct op_hist {
+	struct lat_hist_shards latency;	/* executed (non dup) ops */
+	struct lat_hist_shards qwait;	/* queue wait time */
+	struct op_hist_window *win;	/* NULL except for global ops */
+};
+
 /* basic op counter
  */
 
@@ -309,6 +368,7 @@ struct proto_op {
 	struct op_latency latency;	/* either executed ops latency */
 	struct op_latency dup_latency;	/* or latency (runtime) to replay */
 	struct op_latency queue_latency;	/* queue wait time */
+	struct op_hist *hist;	/* percentile histograms */
 };
 
 /* basic I/O transfer counter
@@ -335,21 +395,21 @@ struct nfsv3_stats {
 	struct proto_op cmds;	/* non-I/O ops = cmds - (read+write) */
 	struct xfer_op read;
 	struct xfer_op write;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 /* Mount statistics counters
  */
 struct mnt_stats {
 	struct proto_op v1_ops;
 	struct proto_op v3_ops;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 /* lock manager counters
  */
 
 struct nlmv4_stats {
 	struct proto_op ops;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 /* Quota counters
  */
@@ -357,7 +417,7 @@ struct nlmv4_stats {
 struct rquota_stats {
 	struct proto_op ops;
 	struct proto_op ext_ops;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 /* NFSv4 statistics counters
  */
@@ -367,7 +427,7 @@ struct nfsv40_stats {
 	uint64_t ops_per_compound;	/* avg = total / ops_per */
 	struct xfer_op read;
 	struct xfer_op write;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 struct nfsv41_stats {
 	struct proto_op compounds;
@@ -379,7 +439,7 @@ struct nfsv41_stats {
 	struct layout_op layout_commit;
 	struct layout_op layout_return;
 	struct layout_op recall;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 struct transport_stats {
 	uint64_t rx_bytes;
@@ -413,7 +473,7 @@ struct global_stats {
 	struct nlm_ops lm;
 	struct mnt_ops mn;
 	struct qta_ops qt;
-};
+} __attribute__ ((aligned(STATS_CACHE_LINE)));
 
 struct deleg_stats {
 	uint32_t curr_deleg_grants; /* current num of delegations owned by
@@ -424,172 +484,319 @@ struct deleg_stats {
 	uint32_t num_revokes;	    /* Num revokes for the client */
 };
 
+/* global_st is shard 0, the histogram owner.  The others are allocated
+ * by server_stats_init before any request is serviced.
+ */
 static struct global_stats global_st;
+static struct global_stats *global_shards[STATS_MAX_SHARDS] = { &global_st };
+static uint32_t global_nshards = 1;
+
 struct cache_stats cache_st;
 struct cache_stats *cache_stp = &cache_st;
 
+/* Named protocol ops for latency reporting
+ */
+
+struct named_op {
+	const char *name;
+	struct proto_op *op;
+};
+
+/* The global ops that are actually recorded.  These get sharded
+ * histograms with windows, set up by server_stats_init.
+ */
+
+static const struct named_op global_hist_ops[] = {
+	{ "NFSv3", &global_st.nfsv3.cmds },
+	{ "MNTv1", &global_st.mnt.v1_ops },
+	{ "MNTv3", &global_st.mnt.v3_ops },
+	{ "NLMv4", &global_st.nlm4.ops },
+	{ "RQUOTA", &global_st.rquota.ops },
+	{ "NFSv40", &global_st.nfsv40.compounds },
+	{ "NFSv41", &global_st.nfsv41.compounds },
+	{ "NFSv42", &global_st.nfsv42.compounds },
+};
+
+#define GLOBAL_HIST_OPS \
+	((int)(sizeof(global_hist_ops) / sizeof(global_hist_ops[0])))
+#define MAX_STATS_HIST_OPS 17
+
+static pthread_mutex_t hist_win_mtx = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t hist_win_ticks;
+
 /* include the top level server_stats struct definition
  */
 #include "server_stats_private.h"
 
+/**
+ * @brief Number of shards for export stats
+ *
+ * Stats_Shards, or the number of online CPUs if that is 0.
+ */
+
+uint32_t server_stats_shards(void)
+{
+	static uint32_t nshards;
+	long n;
+
+	if (likely(nshards != 0))
+		return nshards;
+
+	n = nfs_param.core_param.stats_shards;
+	if (n == 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	else if (n > STATS_MAX_SHARDS)
+		n = STATS_MAX_SHARDS;
+	nshards = n;
+	return nshards;
+}
+
+static inline uint32_t stats_nshards(struct gsh_stats *stats)
+{
+	return stats->nshards != 0 ? stats->nshards : 1;
+}
+
+/**
+ * @brief Shard of a stats block for the calling thread
+ */
+
+static inline uint32_t stats_shard(struct gsh_stats *stats)
+{
+	return lat_hist_thread_shard() % stats_nshards(stats);
+}
+
+static inline struct global_stats *get_global(void)
+{
+	return global_shards[lat_hist_thread_shard() % global_nshards];
+}
+
+/**
+ * @brief Get or install a shard array
+ *
+ * Lock free; if two threads race to install the array, the loser
+ * frees its copy and uses the winner's.
+ *
+ * @param slot    [IN] pointer in gsh_stats to fill
+ * @param size    [IN] size of one shard
+ * @param nshards [IN] number of shards
+ *
+ * @return the array (shard 0), NULL on OOM
+ */
+
+static void *get_shards(void **slot, size_t size, uint32_t nshards)
+{
+	void *sp = atomic_fetch_voidptr(slot);
+
+	if (likely(sp != NULL))
+		return sp;
+
+	sp = gsh_malloc_aligned(STATS_CACHE_LINE, size * nshards);
+	if (sp == NULL)
+		return NULL;
+	memset(sp, 0, size * nshards);
+	if (!atomic_cas_voidptr(slot, NULL, sp)) {
+		gsh_free(sp);
+		sp = atomic_fetch_voidptr(slot);
+	}
+	return sp;
+}
+
 /**
  * @brief Get stats struct helpers
  *
  * These functions dereference the protocol specific struct
- * silently calloc the struct on first use.
+ * silently allocating the shards on first use.  They return shard
+ * 0, which also owns the latency histograms; counters are updated
+ * in the shard picked by stats_shard.
  *
  * @param stats [IN] the stats structure to dereference in
- * @param lock  [IN] the lock in the stats owning struct
  *
- * @return pointer to proto struct, NULL on OOM
- *
- * @TODO make them inlines for release
+ * @return pointer to proto struct shard 0, NULL on OOM
  */
 
-static struct nfsv3_stats *get_v3(struct gsh_stats *stats,
-				  pthread_rwlock_t *lock)
+static inline struct nfsv3_stats *get_v3(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv3 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv3 == NULL)
-			stats->nfsv3 =
-			    gsh_calloc(sizeof(struct nfsv3_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv3;
+	return get_shards((void **)&stats->nfsv3, sizeof(struct nfsv3_stats),
+			  stats_nshards(stats));
 }
 
-static struct mnt_stats *get_mnt(struct gsh_stats *stats,
-				 pthread_rwlock_t *lock)
+static inline struct mnt_stats *get_mnt(struct gsh_stats *stats)
 {
-	if (unlikely(stats->mnt == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->mnt == NULL)
-			stats->mnt = gsh_calloc(sizeof(struct mnt_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->mnt;
+	return get_shards((void **)&stats->mnt, sizeof(struct mnt_stats),
+			  stats_nshards(stats));
 }
 
-static struct nlmv4_stats *get_nlm4(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static inline struct nlmv4_stats *get_nlm4(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nlm4 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nlm4 == NULL)
-			stats->nlm4 = gsh_calloc(sizeof(struct nlmv4_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nlm4;
+	return get_shards((void **)&stats->nlm4, sizeof(struct nlmv4_stats),
+			  stats_nshards(stats));
 }
 
-static struct rquota_stats *get_rquota(struct gsh_stats *stats,
-				       pthread_rwlock_t *lock)
+static inline struct rquota_stats *get_rquota(struct gsh_stats *stats)
 {
-	if (unlikely(stats->rquota == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->rquota == NULL)
-			stats->rquota =
-			    gsh_calloc(sizeof(struct rquota_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->rquota;
+	return get_shards((void **)&stats->rquota,
+			  sizeof(struct rquota_stats), stats_nshards(stats));
 }
 
-static struct nfsv40_stats *get_v40(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static inline struct nfsv40_stats *get_v40(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv40 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv40 == NULL)
-			stats->nfsv40 =
-			    gsh_calloc(sizeof(struct nfsv40_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv40;
+	return get_shards((void **)&stats->nfsv40,
+			  sizeof(struct nfsv40_stats), stats_nshards(stats));
 }
 
-static struct nfsv41_stats *get_v41(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static inline struct nfsv41_stats *get_v41(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv41 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv41 == NULL)
-			stats->nfsv41 =
-			    gsh_calloc(sizeof(struct nfsv41_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv41;
+	return get_shards((void **)&stats->nfsv41,
+			  sizeof(struct nfsv41_stats), stats_nshards(stats));
 }
 
-static struct nfsv41_stats *get_v42(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static inline struct nfsv41_stats *get_v42(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv42 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv42 == NULL)
-			stats->nfsv42 =
-			    gsh_calloc(sizeof(struct nfsv41_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv42;
+	return get_shards((void **)&stats->nfsv42,
+			  sizeof(struct nfsv41_stats), stats_nshards(stats));
 }
 
 #ifdef _USE_9P
-static struct _9p_stats *get_9p(struct gsh_stats *stats, pthread_rwlock_t *lock)
+/* 9P stats are not sharded */
+static inline struct _9p_stats *get_9p(struct gsh_stats *stats)
 {
-	if (unlikely(stats->_9p == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->_9p == NULL)
-			stats->_9p = gsh_calloc(sizeof(struct _9p_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->_9p;
+	return get_shards((void **)&stats->_9p, sizeof(struct _9p_stats), 1);
 }
 #endif
 
 /* Functions for recording statistics
  */
 
+/**
+ * @brief Fold a sample into latency min/max
+ *
+ * Compare and swap so that concurrent updates cannot lose a new
+ * minimum or maximum.
+ *
+ * @param lat [IN] latency struct to update
+ * @param val [IN] sample
+ */
+static void record_min_max(struct op_latency *lat, uint64_t val)
+{
+	uint64_t cur;
+
+	cur = atomic_fetch_uint64_t(&lat->min);
+	while ((cur == 0L || cur > val)
+	       && !atomic_cas_uint64_t(&lat->min, cur, val))
+		cur = atomic_fetch_uint64_t(&lat->min);
+
+	cur = atomic_fetch_uint64_t(&lat->max);
+	while ((cur == 0L || cur < val)
+	       && !atomic_cas_uint64_t(&lat->max, cur, val))
+		cur = atomic_fetch_uint64_t(&lat->max);
+}
+
+/**
+ * @brief Allocate latency histograms
+ *
+ * @param nshards [IN] number of shards per histogram
+ * @param window  [IN] also keep windowed snapshots
+ *
+ * @return the histograms, NULL on OOM
+ */
+static struct op_hist *op_hist_alloc(uint32_t nshards, bool window)
+{
+	struct op_hist *hist = gsh_calloc(sizeof(struct op_hist), 1);
+
+	if (hist == NULL)
+		return NULL;
+	if (!lat_hist_shards_init(&hist->latency, nshards))
+		goto err;
+	if (!lat_hist_shards_init(&hist->qwait, nshards))
+		goto err;
+	if (window) {
+		hist->win = gsh_calloc(sizeof(struct op_hist_window), 1);
+		if (hist->win == NULL)
+			goto err;
+	}
+	return hist;
+
+err:
+	lat_hist_shards_destroy(&hist->latency);
+	lat_hist_shards_destroy(&hist->qwait);
+	gsh_free(hist);
+	return NULL;
+}
+
+static void op_hist_free(struct op_hist *hist)
+{
+	lat_hist_shards_destroy(&hist->latency);
+	lat_hist_shards_destroy(&hist->qwait);
+	gsh_free(hist->win);
+	gsh_free(hist);
+}
+
+/**
+ * @brief Get the latency histograms of an op
+ *
+ * Per export and per client histograms are created on first use
+ * with a single shard; losing the install race just frees ours.
+ *
+ * @param op [IN] protocol op stats struct
+ *
+ * @return the histograms, NULL on OOM
+ */
+static struct op_hist *get_op_hist(struct proto_op *op)
+{
+	struct op_hist *hist;
+
+	hist = atomic_fetch_voidptr((void **)&op->hist);
+	if (likely(hist != NULL))
+		return hist;
+
+	hist = op_hist_alloc(1, false);
+	if (hist == NULL)
+		return NULL;
+	if (!atomic_cas_voidptr((void **)&op->hist, NULL, hist)) {
+		op_hist_free(hist);
+		hist = atomic_fetch_voidptr((void **)&op->hist);
+	}
+	return hist;
+}
+
 /**
  * @brief Record latency stats
  *
  * @param op           [IN] protocol op stats struct
+ * @param base         [IN] same op in shard 0, owns the histograms
  * @param request_time [IN] time consumed by request
  * @param qwait_time   [IN] time sitting on queue
  * @param dup          [IN] detected this was a dup request
  */
-void record_latency(struct proto_op *op, nsecs_elapsed_t request_time,
-		    nsecs_elapsed_t qwait_time, bool dup)
+static void record_latency(struct proto_op *op, struct proto_op *base,
+			   nsecs_elapsed_t request_time,
+			   nsecs_elapsed_t qwait_time, bool dup)
 {
 
 	/* dup latency is counted separately */
 	if (likely(!dup)) {
 		(void)atomic_add_uint64_t(&op->latency.latency, request_time);
-		if (op->latency.min == 0L || op->latency.min > request_time)
-			(void)atomic_store_uint64_t(&op->latency.min,
-						    request_time);
-		if (op->latency.max == 0L || op->latency.max < request_time)
-			(void)atomic_store_uint64_t(&op->latency.max,
-						    request_time);
+		record_min_max(&op->latency, request_time);
 	} else {
 		(void)atomic_add_uint64_t(&op->dup_latency.latency,
 					  request_time);
-		if (op->dup_latency.min == 0L
-		    || op->dup_latency.min > request_time)
-			(void)atomic_store_uint64_t(&op->dup_latency.min,
-						    request_time);
-		if (op->dup_latency.max == 0L
-		    || op->dup_latency.max < request_time)
-			(void)atomic_store_uint64_t(&op->dup_latency.max,
-						    request_time);
+		record_min_max(&op->dup_latency, request_time);
 	}
 	/* record how long it was laying around waiting ... */
 	(void)atomic_add_uint64_t(&op->queue_latency.latency, qwait_time);
-	if (op->queue_latency.min == 0L || op->queue_latency.min > qwait_time)
-		(void)atomic_store_uint64_t(&op->queue_latency.min, qwait_time);
-	if (op->queue_latency.max == 0L || op->queue_latency.max < qwait_time)
-		(void)atomic_store_uint64_t(&op->queue_latency.max, qwait_time);
+	record_min_max(&op->queue_latency, qwait_time);
+
+	if (nfs_param.core_param.enable_latency_hist) {
+		struct op_hist *hist = get_op_hist(base);
+
+		if (hist == NULL)
+			return;
+		if (likely(!dup))
+			lat_hist_shards_record(&hist->latency, request_time);
+		lat_hist_shards_record(&hist->qwait, qwait_time);
+	}
 }
 
 /**
@@ -621,38 +828,41 @@ static void record_io(struct xfer_op *iop, size_t requested, size_t transferred,
  * @brief record i/o stats by protocol
  */
 
-static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    size_t requested,
+static void record_io_stats(struct gsh_stats *gsh_st, size_t requested,
 			    size_t transferred, bool success, bool is_write)
 {
 	struct xfer_op *iop = NULL;
+	uint32_t shard = stats_shard(gsh_st);
 
 	if (op_ctx->req_type == NFS_REQUEST) {
 		if (op_ctx->nfs_vers == NFS_V3) {
-			struct nfsv3_stats *sp = get_v3(gsh_st, lock);
+			struct nfsv3_stats *sp = get_v3(gsh_st);
 
 			if (sp == NULL)
 				return;
-			iop = is_write ? &sp->write : &sp->read;
+			iop = is_write ? &sp[shard].write : &sp[shard].read;
 		} else if (op_ctx->nfs_vers == NFS_V4) {
 			if (op_ctx->nfs_minorvers == 0) {
-				struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+				struct nfsv40_stats *sp = get_v40(gsh_st);
 
 				if (sp == NULL)
 					return;
-				iop = is_write ? &sp->write : &sp->read;
+				iop = is_write ? &sp[shard].write
+					       : &sp[shard].read;
 			} else if (op_ctx->nfs_minorvers == 1) {
-				struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+				struct nfsv41_stats *sp = get_v41(gsh_st);
 
 				if (sp == NULL)
 					return;
-				iop = is_write ? &sp->write : &sp->read;
+				iop = is_write ? &sp[shard].write
+					       : &sp[shard].read;
 			} else if (op_ctx->nfs_minorvers == 2) {
-				struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+				struct nfsv41_stats *sp = get_v42(gsh_st);
 
 				if (sp == NULL)
 					return;
-				iop = is_write ? &sp->write : &sp->read;
+				iop = is_write ? &sp[shard].write
+					       : &sp[shard].read;
 			}
 			/* the frightening thought is someday minor == 3 */
 		} else {
@@ -660,7 +870,7 @@ static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 		}
 #ifdef _USE_9P
 	} else if (op_ctx->req_type == _9P_REQUEST) {
-		struct _9p_stats *sp = get_9p(gsh_st, lock);
+		struct _9p_stats *sp = get_9p(gsh_st);
 
 		if (sp == NULL)
 			return;
@@ -669,24 +879,27 @@ static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 	} else {
 		return;
 	}
+	if (iop == NULL)
+		return;
 	record_io(iop, requested, transferred, success);
 }
 
 /**
  * @brief count the protocol operation
  *
- * Use atomic ops to avoid locks. We don't lock for the max
- * and min because if there is a collision, over the long haul,
- * the error is near zero...
+ * Use atomic ops to avoid locks.  Max and min are updated with
+ * compare and swap in record_latency.
  *
  * @param op           [IN] pointer to specific protocol struct
+ * @param base         [IN] same op in shard 0, owns the histograms
  * @param request_time [IN] wallclock time (nsecs) for this op
  * @param qwait_time   [IN] wallclock time (nsecs) waiting for service
  * @param success      [IN] protocol error code == OK
  * @param dup          [IN] true if op was detected duplicate
  */
 
-static void record_op(struct proto_op *op, nsecs_elapsed_t request_time,
+static void record_op(struct proto_op *op, struct proto_op *base,
+		      nsecs_elapsed_t request_time,
 		      nsecs_elapsed_t qwait_time, bool success, bool dup)
 {
 	/* count the op */
@@ -696,7 +909,7 @@ static void record_op(struct proto_op *op, nsecs_elapsed_t request_time,
 		(void)atomic_inc_uint64_t(&op->errors);
 	if (unlikely(dup))
 		(void)atomic_inc_uint64_t(&op->dups);
-	record_latency(op, request_time, qwait_time, dup);
+	record_latency(op, base, request_time, qwait_time, dup);
 }
 
 /**
@@ -731,77 +944,96 @@ static void record_layout(struct nfsv41_stats *sp, int proto_op, int status)
 }
 
 /**
- * @brief Record NFS V4 compound stats
+ * @brief Record NFS V4.1/4.2 op stats
+ *
+ * V4.1 and V4.2 share a stats struct, only the op type table differs.
+ *
+ * @param sp           [IN] shard 0 of the stats struct
+ * @param shard        [IN] shard to count in
+ * @param optype       [IN] op type table for the minor version
+ * @param proto_op     [IN] protocol op
+ * @param request_time [IN] time consumed by request
+ * @param qwait_time   [IN] time sitting on queue
+ * @param status       [IN] operation status
+ */
+
+static void record_nfsv41_op(struct nfsv41_stats *sp, uint32_t shard,
+			     const uint32_t *optype, int proto_op,
+			     nsecs_elapsed_t request_time,
+			     nsecs_elapsed_t qwait_time, int status)
+{
+	struct nfsv41_stats *sh = &sp[shard];
+
+	switch (optype[proto_op]) {
+	case READ_OP:
+		record_latency(&sh->read.cmd, &sp->read.cmd, request_time,
+			       qwait_time, false);
+		break;
+	case WRITE_OP:
+		record_latency(&sh->write.cmd, &sp->write.cmd, request_time,
+			       qwait_time, false);
+		break;
+	case LAYOUT_OP:
+		record_layout(sh, proto_op, status);
+		break;
+	default:
+		record_op(&sh->compounds, &sp->compounds, request_time,
+			  qwait_time, status == NFS4_OK, false);
+	}
+}
+
+/**
+ * @brief Record NFS V4 op stats
+ *
+ * @param gsh_st       [IN] stats struct from client or export
+ * @param proto_op     [IN] protocol op
+ * @param minorversion [IN] NFS V4 minor version
+ * @param request_time [IN] time consumed by request
+ * @param qwait_time   [IN] time sitting on queue
+ * @param status       [IN] operation status
  */
 
-static void record_nfsv4_op(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    int proto_op, int minorversion,
-			    nsecs_elapsed_t request_time,
+static void record_nfsv4_op(struct gsh_stats *gsh_st, int proto_op,
+			    int minorversion, nsecs_elapsed_t request_time,
 			    nsecs_elapsed_t qwait_time, int status)
 {
+	uint32_t shard = stats_shard(gsh_st);
+
 	if (minorversion == 0) {
-		struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+		struct nfsv40_stats *sp = get_v40(gsh_st);
+		struct nfsv40_stats *sh;
 
 		if (sp == NULL)
 			return;
+		sh = &sp[shard];
 		/* record stuff */
 		switch (nfsv40_optype[proto_op]) {
 		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sh->read.cmd, &sp->read.cmd,
+				       request_time, qwait_time, false);
 			break;
 		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sh->write.cmd, &sp->write.cmd,
+				       request_time, qwait_time, false);
 			break;
 		default:
-			record_op(&sp->compounds, request_time, qwait_time,
-				  status == NFS4_OK, false);
+			record_op(&sh->compounds, &sp->compounds, request_time,
+				  qwait_time, status == NFS4_OK, false);
 		}
 	} else if (minorversion == 1) {
-		struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v41(gsh_st);
 
 		if (sp == NULL)
 			return;
-		/* record stuff */
-		switch (nfsv41_optype[proto_op]) {
-		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
-			break;
-		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
-			break;
-		case LAYOUT_OP:
-			record_layout(sp, proto_op, status);
-			break;
-		default:
-			record_op(&sp->compounds, request_time, qwait_time,
-				  status == NFS4_OK, false);
-		}
+		record_nfsv41_op(sp, shard, nfsv41_optype, proto_op,
+				 request_time, qwait_time, status);
 	} else if (minorversion == 2) {
-		struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v42(gsh_st);
 
 		if (sp == NULL)
 			return;
-		/* record stuff */
-		switch (nfsv42_optype[proto_op]) {
-		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
-			break;
-		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
-			break;
-		case LAYOUT_OP:
-			record_layout(sp, proto_op, status);
-			break;
-		default:
-			record_op(&sp->compounds, request_time, qwait_time,
-				  status == NFS4_OK, false);
-		}
+		record_nfsv41_op(sp, shard, nfsv42_optype, proto_op,
+				 request_time, qwait_time, status);
 	}
 
 }
@@ -810,39 +1042,35 @@ static void record_nfsv4_op(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
  * @brief Record NFS V4 compound stats
  */
 
-static void record_compound(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    int minorversion, uint64_t num_ops,
-			    nsecs_elapsed_t request_time,
+static void record_compound(struct gsh_stats *gsh_st, int minorversion,
+			    uint64_t num_ops, nsecs_elapsed_t request_time,
 			    nsecs_elapsed_t qwait_time, bool success)
 {
-	if (minorversion == 0) {
+	uint32_t shard = stats_shard(gsh_st);
 
-		struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+	if (minorversion == 0) {
 
-		if (sp == NULL)
-			return;
-		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
-		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
-	} else if (minorversion == 1) {
-		struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+		struct nfsv40_stats *sp = get_v40(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
-		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
-	} else if (minorversion == 2) {
-		struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+		record_op(&sp[shard].compounds, &sp->compounds, request_time,
+			  qwait_time, success, false);
+		(void)atomic_add_uint64_t(&sp[shard].ops_per_compound,
+					  num_ops);
+	} else if (minorversion == 1 || minorversion == 2) {
+		struct nfsv41_stats *sp = minorversion == 1
+						? get_v41(gsh_st)
+						: get_v42(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
-		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
+		record_op(&sp[shard].compounds, &sp->compounds, request_time,
+			  qwait_time, success, false);
+		(void)atomic_add_uint64_t(&sp[shard].ops_per_compound,
+					  num_ops);
 	}
 
 }
@@ -854,95 +1082,101 @@ static void record_compound(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
  * Once we found the stats block, do the update(s).
  *
  * @param gsh_st       [IN] stats struct from client or export
- * @param lock         [IN] lock on client|export for malloc
  * @param reqdata      [IN] info about the proto request
  * @param success      [IN] the op returned OK (or error)
  * @param request_time [IN] time consumed by request
  * @param qwait_time   [IN] time sitting on queue
  * @param dup          [IN] detected this was a dup request
+ * @param global       [IN] also count in the global stats
  */
 
-static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			 request_data_t *reqdata, nsecs_elapsed_t request_time,
+static void record_stats(struct gsh_stats *gsh_st, request_data_t *reqdata,
+			 nsecs_elapsed_t request_time,
 			 nsecs_elapsed_t qwait_time, bool success, bool dup,
 			 bool global)
 {
 	struct svc_req *req = &reqdata->r_u.req.svc;
 	uint32_t proto_op = req->rq_proc;
+	uint32_t shard = stats_shard(gsh_st);
+	struct global_stats *gsp = global ? get_global() : NULL;
 
 	if (req->rq_prog == nfs_param.core_param.program[P_NFS]) {
 		if (proto_op == 0)
 			return;	/* we don't count NULL ops */
 		if (req->rq_vers == NFS_V3) {
-			struct nfsv3_stats *sp = get_v3(gsh_st, lock);
+			struct nfsv3_stats *sp = get_v3(gsh_st);
+			struct nfsv3_stats *sh;
 
 			if (sp == NULL)
 				return;
+			sh = &sp[shard];
 			/* record stuff */
 			if (global)
-				record_op(&global_st.nfsv3.cmds, request_time,
+				record_op(&gsp->nfsv3.cmds,
+					  &global_st.nfsv3.cmds, request_time,
 					  qwait_time, success, dup);
 			switch (nfsv3_optype[proto_op]) {
 			case READ_OP:
-				record_latency(&sp->read.cmd, request_time,
-					       qwait_time, dup);
+				record_latency(&sh->read.cmd, &sp->read.cmd,
+					       request_time, qwait_time, dup);
 				break;
 			case WRITE_OP:
-				record_latency(&sp->write.cmd, request_time,
-					       qwait_time, dup);
+				record_latency(&sh->write.cmd, &sp->write.cmd,
+					       request_time, qwait_time, dup);
 				break;
 			default:
-				record_op(&sp->cmds, request_time, qwait_time,
-					  success, dup);
+				record_op(&sh->cmds, &sp->cmds, request_time,
+					  qwait_time, success, dup);
 			}
 		} else {
 			/* We don't do V4 here and V2 is toast */
 			return;
 		}
 	} else if (req->rq_prog == nfs_param.core_param.program[P_MNT]) {
-		struct mnt_stats *sp = get_mnt(gsh_st, lock);
+		struct mnt_stats *sp = get_mnt(gsh_st);
 
 		if (global && req->rq_vers == MOUNT_V1)
-			record_op(&global_st.mnt.v1_ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->mnt.v1_ops, &global_st.mnt.v1_ops,
+				  request_time, qwait_time, success, dup);
 		else if (global)
-			record_op(&global_st.mnt.v3_ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->mnt.v3_ops, &global_st.mnt.v3_ops,
+				  request_time, qwait_time, success, dup);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		if (req->rq_vers == MOUNT_V1)
-			record_op(&sp->v1_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp[shard].v1_ops, &sp->v1_ops, request_time,
+				  qwait_time, success, dup);
 		else
-			record_op(&sp->v3_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp[shard].v3_ops, &sp->v3_ops, request_time,
+				  qwait_time, success, dup);
 	} else if (req->rq_prog == nfs_param.core_param.program[P_NLM]) {
-		struct nlmv4_stats *sp = get_nlm4(gsh_st, lock);
+		struct nlmv4_stats *sp = get_nlm4(gsh_st);
 
 		if (global)
-			record_op(&global_st.nlm4.ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->nlm4.ops, &global_st.nlm4.ops,
+				  request_time, qwait_time, success, dup);
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->ops, request_time, qwait_time, success, dup);
+		record_op(&sp[shard].ops, &sp->ops, request_time, qwait_time,
+			  success, dup);
 	} else if (req->rq_prog == nfs_param.core_param.program[P_RQUOTA]) {
-		struct rquota_stats *sp = get_rquota(gsh_st, lock);
+		struct rquota_stats *sp = get_rquota(gsh_st);
 
 		if (global)
-			record_op(&global_st.rquota.ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->rquota.ops, &global_st.rquota.ops,
+				  request_time, qwait_time, success, dup);
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		if (req->rq_vers == RQUOTAVERS)
-			record_op(&sp->ops, request_time, qwait_time, success,
-				  dup);
+			record_op(&sp[shard].ops, &sp->ops, request_time,
+				  qwait_time, success, dup);
 		else
-			record_op(&sp->ext_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp[shard].ext_ops, &sp->ext_ops,
+				  request_time, qwait_time, success, dup);
 	}
 }
 
@@ -983,13 +1217,29 @@ void server_stats_transport_done(struct gsh_client *client,
 {
 	struct server_stats *server_st =
 		container_of(client, struct server_stats, client);
-	struct _9p_stats *sp = get_9p(&server_st->st, &client->lock);
+	struct _9p_stats *sp = get_9p(&server_st->st);
 
 	if (sp != NULL)
 		record_transport_stats(&sp->trans, rx_bytes, rx_pkt, rx_err,
 				       tx_bytes, tx_pkt, tx_err);
 }
 
+/**
+ * @brief record one 9p opcode
+ *
+ * 9P ops are not timed, so they are only counted.  Going through
+ * record_op would give every opcode histograms of nothing but zeros.
+ */
+static void record_9p_op(struct _9p_stats *sp, u8 opc)
+{
+	struct proto_op *op;
+
+	op = get_shards((void **)&sp->opcodes[opc], sizeof(struct proto_op),
+			1);
+	if (op != NULL)
+		(void)atomic_inc_uint64_t(&op->total);
+}
+
 /**
  * @bried record 9p operation stats
  *
@@ -1006,14 +1256,9 @@ void server_stats_9p_done(u8 opc, struct _9p_request_data *req9p)
 		struct server_stats *server_st;
 
 		server_st = container_of(client, struct server_stats, client);
-		sp = get_9p(&server_st->st, &client->lock);
-		if (sp != NULL) {
-			if (sp->opcodes[opc] == NULL)
-				sp->opcodes[opc] =
-					gsh_calloc(sizeof(struct proto_op), 1);
-			if (sp->opcodes[opc] != NULL)
-				record_op(sp->opcodes[opc], 0, 0, true, false);
-		}
+		sp = get_9p(&server_st->st);
+		if (sp != NULL)
+			record_9p_op(sp, opc);
 	}
 
 	if (op_ctx->export) {
@@ -1021,14 +1266,9 @@ void server_stats_9p_done(u8 opc, struct _9p_request_data *req9p)
 
 		export = op_ctx->export;
 		exp_st = container_of(export, struct export_stats, export);
-		sp = get_9p(&exp_st->st, &export->lock);
-		if (sp != NULL) {
-			if (sp->opcodes[opc] == NULL)
-				sp->opcodes[opc] =
-					gsh_calloc(sizeof(struct proto_op), 1);
-			if (sp->opcodes[opc] != NULL)
-				record_op(sp->opcodes[opc], 0, 0, true, false);
-		}
+		sp = get_9p(&exp_st->st);
+		if (sp != NULL)
+			record_9p_op(sp, opc);
 	}
 }
 #endif
@@ -1046,15 +1286,16 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 	nsecs_elapsed_t stop_time;
 	struct svc_req *req = &reqdata->r_u.req.svc;
 	uint32_t proto_op = req->rq_proc;
+	struct global_stats *gsp = get_global();
 
 	if (req->rq_prog == NFS_PROGRAM && op_ctx->nfs_vers == NFS_V3)
-			global_st.v3.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->v3.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_NLM])
-		global_st.lm.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->lm.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_MNT])
-		global_st.mn.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->mn.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_RQUOTA])
-		global_st.qt.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->qt.op[proto_op]);
 
 	if (nfs_param.core_param.enable_FASTSTATS)
 		return;
@@ -1065,7 +1306,7 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 		struct server_stats *server_st;
 
 		server_st = container_of(client, struct server_stats, client);
-		record_stats(&server_st->st, &client->lock, reqdata,
+		record_stats(&server_st->st, reqdata,
 			     stop_time - op_ctx->start_time,
 			     op_ctx->queue_wait,
 			     rc == NFS_REQ_OK, dup, true);
@@ -1076,7 +1317,7 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_stats(&exp_st->st, &op_ctx->export->lock, reqdata,
+		record_stats(&exp_st->st, reqdata,
 			     stop_time - op_ctx->start_time,
 			     op_ctx->queue_wait, rc == NFS_REQ_OK, dup, false);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
@@ -1096,9 +1337,10 @@ void server_stats_nfsv4_op_done(int proto_op,
 	struct gsh_client *client = op_ctx->client;
 	struct timespec current_time;
 	nsecs_elapsed_t stop_time;
+	struct global_stats *gsp = get_global();
 
 	if (op_ctx->nfs_vers == NFS_V4)
-		global_st.v4.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->v4.op[proto_op]);
 
 	if (nfs_param.core_param.enable_FASTSTATS)
 		return;
@@ -1110,28 +1352,31 @@ void server_stats_nfsv4_op_done(int proto_op,
 		struct server_stats *server_st;
 
 		server_st = container_of(client, struct server_stats, client);
-		record_nfsv4_op(&server_st->st, &client->lock, proto_op,
+		record_nfsv4_op(&server_st->st, proto_op,
 				op_ctx->nfs_minorvers, stop_time - start_time,
 				op_ctx->queue_wait, status);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
 	}
 
 	if (op_ctx->nfs_minorvers == 0)
-		record_op(&global_st.nfsv40.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv40.compounds, &global_st.nfsv40.compounds,
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 1)
-		record_op(&global_st.nfsv41.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv41.compounds, &global_st.nfsv41.compounds,
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 2)
-		record_op(&global_st.nfsv42.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv42.compounds, &global_st.nfsv42.compounds,
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 
 	if (op_ctx->export != NULL) {
 		struct export_stats *exp_st;
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_nfsv4_op(&exp_st->st, &op_ctx->export->lock, proto_op,
+		record_nfsv4_op(&exp_st->st, proto_op,
 				op_ctx->nfs_minorvers, stop_time - start_time,
 				op_ctx->queue_wait, status);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
@@ -1157,8 +1402,7 @@ void server_stats_compound_done(int num_ops, int status)
 		struct server_stats *server_st;
 
 		server_st = container_of(client, struct server_stats, client);
-		record_compound(&server_st->st, &client->lock,
-				op_ctx->nfs_minorvers,
+		record_compound(&server_st->st, op_ctx->nfs_minorvers,
 				num_ops, stop_time - op_ctx->start_time,
 				op_ctx->queue_wait, status == NFS4_OK);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
@@ -1168,8 +1412,7 @@ void server_stats_compound_done(int num_ops, int status)
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_compound(&exp_st->st, &op_ctx->export->lock,
-				op_ctx->nfs_minorvers, num_ops,
+		record_compound(&exp_st->st, op_ctx->nfs_minorvers, num_ops,
 				stop_time - op_ctx->start_time,
 				op_ctx->queue_wait, status == NFS4_OK);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
@@ -1192,17 +1435,16 @@ void server_stats_io_done(size_t requested,
 
 		server_st = container_of(op_ctx->client, struct server_stats,
 					 client);
-		record_io_stats(&server_st->st, &op_ctx->client->lock,
-				requested, transferred, success,
-				is_write);
+		record_io_stats(&server_st->st, requested, transferred,
+				success, is_write);
 	}
 	if (op_ctx->export != NULL) {
 		struct export_stats *exp_st;
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_io_stats(&exp_st->st, &op_ctx->export->lock,
-				requested, transferred, success, is_write);
+		record_io_stats(&exp_st->st, requested, transferred, success,
+				is_write);
 	}
 }
 
@@ -1211,136 +1453,432 @@ void server_stats_io_done(size_t requested,
  *
  * Called from a bunch of places.
  */
-void check_deleg_struct(struct gsh_stats *stats, pthread_rwlock_t *lock)
+static struct deleg_stats *get_deleg(struct gsh_client *client)
 {
-	if (unlikely(stats->deleg == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->deleg == NULL)
-			stats->deleg = gsh_calloc(
-					sizeof(struct deleg_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
+	struct server_stats *server_st;
+
+	server_st = container_of(client, struct server_stats, client);
+	return get_shards((void **)&server_st->st.deleg,
+			  sizeof(struct deleg_stats), 1);
 }
+
 void inc_grants(struct gsh_client *client)
 {
-	if (client != NULL) {
-		struct server_stats *server_st;
+	struct deleg_stats *ds;
 
-		server_st = container_of(client, struct server_stats, client);
-		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->curr_deleg_grants++;
+	if (client != NULL) {
+		ds = get_deleg(client);
+		if (ds != NULL)
+			(void)atomic_inc_uint32_t(&ds->curr_deleg_grants);
 	}
 }
 void dec_grants(struct gsh_client *client)
 {
-	if (client != NULL) {
-		struct server_stats *server_st;
+	struct deleg_stats *ds;
 
-		server_st = container_of(client, struct server_stats, client);
-		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->curr_deleg_grants++;
+	if (client != NULL) {
+		ds = get_deleg(client);
+		if (ds != NULL)
+			(void)atomic_inc_uint32_t(&ds->curr_deleg_grants);
 	}
 }
 void inc_revokes(struct gsh_client *client)
 {
-	if (client != NULL) {
-		struct server_stats *server_st;
+	struct deleg_stats *ds;
 
-		server_st = container_of(client, struct server_stats, client);
-		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->num_revokes++;
+	if (client != NULL) {
+		ds = get_deleg(client);
+		if (ds != NULL)
+			(void)atomic_inc_uint32_t(&ds->num_revokes);
 	}
 }
 void inc_recalls(struct gsh_client *client)
 {
-	if (client != NULL) {
-		struct server_stats *server_st;
+	struct deleg_stats *ds;
 
-		server_st = container_of(client, struct server_stats, client);
-		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->tot_recalls++;
+	if (client != NULL) {
+		ds = get_deleg(client);
+		if (ds != NULL)
+			(void)atomic_inc_uint32_t(&ds->tot_recalls);
 	}
 }
 void inc_failed_recalls(struct gsh_client *client)
 {
-	if (client != NULL) {
-		struct server_stats *server_st;
+	struct deleg_stats *ds;
 
-		server_st = container_of(client, struct server_stats, client);
-		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->failed_recalls++;
+	if (client != NULL) {
+		ds = get_deleg(client);
+		if (ds != NULL)
+			(void)atomic_inc_uint32_t(&ds->failed_recalls);
 	}
 }
 
-#ifdef USE_DBUS
-
-/* Functions for marshalling statistics to DBUS
- */
-
 /**
- * @brief Report Stats availability as members of a struct
+ * @brief Collect the ops of a stats block that have histograms
  *
- * struct available_stats {
- *      ...
- *	bool nfsv3;
- *	bool mnt;
- *	bool nlm4;
- *	bool rquota;
- *	bool nfsv40;
- *	bool nfsv41;
- *	bool nfsv42;
- *	bool _9p;
- *      ...
- * }
+ * @param st  [IN]  stats struct from client or export
+ * @param ops [OUT] array of at least MAX_STATS_HIST_OPS entries
  *
- * @param name        [IN] name of export or IP address as string
- * @param stats       [IN] pointer to server stats struct
- * @param last_update [IN] elapsed timestamp of last activity
- * @param iter        [IN] iterator to stuff struct into
+ * @return number of entries filled in
  */
 
-void server_stats_summary(DBusMessageIter *iter, struct gsh_stats *st)
+static int stats_hist_ops(struct gsh_stats *st, struct named_op *ops)
 {
-	dbus_bool_t stats_available;
+	int n = 0;
+
+#define ADD_HIST_OP(opname, opp)				\
+	do {							\
+		if (atomic_fetch_voidptr((void **)&(opp)->hist)) {	\
+			ops[n].name = opname;			\
+			ops[n].op = opp;			\
+			n++;					\
+		}						\
+	} while (0)
+
+	if (st->nfsv3 != NULL) {
+		ADD_HIST_OP("NFSv3", &st->nfsv3->cmds);
+		ADD_HIST_OP("NFSv3_READ", &st->nfsv3->read.cmd);
+		ADD_HIST_OP("NFSv3_WRITE", &st->nfsv3->write.cmd);
+	}
+	if (st->mnt != NULL) {
+		ADD_HIST_OP("MNTv1", &st->mnt->v1_ops);
+		ADD_HIST_OP("MNTv3", &st->mnt->v3_ops);
+	}
+	if (st->nlm4 != NULL)
+		ADD_HIST_OP("NLMv4", &st->nlm4->ops);
+	if (st->rquota != NULL) {
+		ADD_HIST_OP("RQUOTA", &st->rquota->ops);
+		ADD_HIST_OP("RQUOTA_EXT", &st->rquota->ext_ops);
+	}
+	if (st->nfsv40 != NULL) {
+		ADD_HIST_OP("NFSv40", &st->nfsv40->compounds);
+		ADD_HIST_OP("NFSv40_READ", &st->nfsv40->read.cmd);
+		ADD_HIST_OP("NFSv40_WRITE", &st->nfsv40->write.cmd);
+	}
+	if (st->nfsv41 != NULL) {
+		ADD_HIST_OP("NFSv41", &st->nfsv41->compounds);
+		ADD_HIST_OP("NFSv41_READ", &st->nfsv41->read.cmd);
+		ADD_HIST_OP("NFSv41_WRITE", &st->nfsv41->write.cmd);
+	}
+	if (st->nfsv42 != NULL) {
+		ADD_HIST_OP("NFSv42", &st->nfsv42->compounds);
+		ADD_HIST_OP("NFSv42_READ", &st->nfsv42->read.cmd);
+		ADD_HIST_OP("NFSv42_WRITE", &st->nfsv42->write.cmd);
+	}
 
-	stats_available = st->nfsv3 != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->mnt != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->nlm4 != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->rquota != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->nfsv40 != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->nfsv41 != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->nfsv42 != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
-	stats_available = st->_9p != 0;
-	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
-				       &stats_available);
+#undef ADD_HIST_OP
+
+	return n;
 }
 
-/** @brief Report protocol operation statistics
- *
- * struct proto_op {
- *         uint64_t total;
- *         uint64_t errors;
- *         ...
- * }
+/**
+ * @brief Roll the windowed global histograms
  *
- * @param op    [IN] pointer to proto op sub-structure of interest
- * @param iter  [IN] interator in reply stream to fill
+ * Runs once a second off the delayed executor.  Each window keeps
+ * the histogram of its last complete period.
  */
-static void server_dbus_op_stats(struct proto_op *op, DBusMessageIter *iter)
+
+static void hist_window_tick(void *arg)
+{
+	struct lat_histogram latency, qwait;
+	int i, w;
+
+	PTHREAD_MUTEX_lock(&hist_win_mtx);
+	hist_win_ticks++;
+	for (i = 0; i < GLOBAL_HIST_OPS; i++) {
+		struct op_hist *hist = global_hist_ops[i].op->hist;
+
+		if (hist == NULL || hist->win == NULL)
+			continue;
+		lat_hist_shards_sum(&hist->latency, &latency);
+		lat_hist_shards_sum(&hist->qwait, &qwait);
+		for (w = 0; w < HIST_WIN_COUNT; w++) {
+			if (hist_win_ticks % hist_win_secs[w] != 0)
+				continue;
+			lat_hist_delta(&hist->win->last_latency[w], &latency,
+				       &hist->win->snap_latency[w]);
+			lat_hist_delta(&hist->win->last_qwait[w], &qwait,
+				       &hist->win->snap_qwait[w]);
+			hist->win->snap_latency[w] = latency;
+			hist->win->snap_qwait[w] = qwait;
+		}
+	}
+	PTHREAD_MUTEX_unlock(&hist_win_mtx);
+
+	(void)delayed_submit(hist_window_tick, NULL, NS_PER_SEC);
+}
+
+/**
+ * @brief Set up global stats shards and latency histograms
+ *
+ * Global counters get server_stats_shards() shards, global latency
+ * histograms one shard per online CPU plus windowed snapshots.
+ * Must be called after the delayed executor is started and before
+ * the worker threads are.
+ */
+
+void server_stats_init(void)
+{
+	uint32_t nshards = server_stats_shards();
+	uint32_t shard;
+	long ncpu;
+	int i;
+
+	for (shard = 1; shard < nshards; shard++) {
+		global_shards[shard] =
+		    gsh_malloc_aligned(STATS_CACHE_LINE,
+				       sizeof(struct global_stats));
+		if (global_shards[shard] == NULL) {
+			LogCrit(COMPONENT_INIT,
+				"Could not allocate global stats shard %u",
+				shard);
+			break;
+		}
+		memset(global_shards[shard], 0, sizeof(struct global_stats));
+	}
+	global_nshards = shard;
+
+	LogInfo(COMPONENT_INIT, "Stats sharded %u ways", global_nshards);
+
+	if (!nfs_param.core_param.enable_latency_hist)
+		return;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	for (i = 0; i < GLOBAL_HIST_OPS; i++) {
+		struct proto_op *op = global_hist_ops[i].op;
+
+		if (op->hist != NULL)
+			continue;
+		op->hist = op_hist_alloc(ncpu, true);
+		if (op->hist == NULL) {
+			LogCrit(COMPONENT_INIT,
+				"Could not allocate latency histograms for %s",
+				global_hist_ops[i].name);
+			return;
+		}
+	}
+
+	LogEvent(COMPONENT_INIT,
+		 "Latency histograms enabled, %u shards per global op",
+		 global_hist_ops[0].op->hist->latency.nshards);
+
+	(void)delayed_submit(hist_window_tick, NULL, NS_PER_SEC);
+}
+
+#ifdef USE_DBUS
+
+/* Sum the shards of a stats block for reporting.  The sums do not
+ * carry the histograms, those are read from shard 0.
+ */
+
+static void sum_latency(struct op_latency *sum, const struct op_latency *lat)
+{
+	sum->latency += lat->latency;
+	if (lat->min != 0 && (sum->min == 0 || lat->min < sum->min))
+		sum->min = lat->min;
+	if (lat->max > sum->max)
+		sum->max = lat->max;
+}
+
+static void sum_proto_op(struct proto_op *sum, const struct proto_op *op)
+{
+	sum->total += op->total;
+	sum->errors += op->errors;
+	sum->dups += op->dups;
+	sum_latency(&sum->latency, &op->latency);
+	sum_latency(&sum->dup_latency, &op->dup_latency);
+	sum_latency(&sum->queue_latency, &op->queue_latency);
+}
+
+static void sum_xfer_op(struct xfer_op *sum, const struct xfer_op *iop)
+{
+	sum_proto_op(&sum->cmd, &iop->cmd);
+	sum->requested += iop->requested;
+	sum->transferred += iop->transferred;
+}
+
+static void sum_layout_op(struct layout_op *sum, const struct layout_op *lop)
+{
+	sum->total += lop->total;
+	sum->errors += lop->errors;
+	sum->delays += lop->delays;
+}
+
+static void sum_v3(struct nfsv3_stats *sum, const struct nfsv3_stats *sp)
+{
+	sum_proto_op(&sum->cmds, &sp->cmds);
+	sum_xfer_op(&sum->read, &sp->read);
+	sum_xfer_op(&sum->write, &sp->write);
+}
+
+static void sum_v40(struct nfsv40_stats *sum, const struct nfsv40_stats *sp)
+{
+	sum_proto_op(&sum->compounds, &sp->compounds);
+	sum->ops_per_compound += sp->ops_per_compound;
+	sum_xfer_op(&sum->read, &sp->read);
+	sum_xfer_op(&sum->write, &sp->write);
+}
+
+static void sum_v41(struct nfsv41_stats *sum, const struct nfsv41_stats *sp)
+{
+	sum_proto_op(&sum->compounds, &sp->compounds);
+	sum->ops_per_compound += sp->ops_per_compound;
+	sum_xfer_op(&sum->read, &sp->read);
+	sum_xfer_op(&sum->write, &sp->write);
+	sum_layout_op(&sum->getdevinfo, &sp->getdevinfo);
+	sum_layout_op(&sum->layout_get, &sp->layout_get);
+	sum_layout_op(&sum->layout_commit, &sp->layout_commit);
+	sum_layout_op(&sum->layout_return, &sp->layout_return);
+	sum_layout_op(&sum->recall, &sp->recall);
+}
+
+static void sum_ops(uint64_t *sum, const uint64_t *op, int nops)
+{
+	int i;
+
+	for (i = 0; i < nops; i++)
+		sum[i] += op[i];
+}
+
+/**
+ * @brief Sum the global stats shards
+ *
+ * @param sum [OUT] zeroed and filled in
+ */
+
+static void sum_global(struct global_stats *sum)
+{
+	uint32_t i;
+
+	memset(sum, 0, sizeof(*sum));
+	for (i = 0; i < global_nshards; i++) {
+		struct global_stats *gsp = global_shards[i];
+
+		sum_v3(&sum->nfsv3, &gsp->nfsv3);
+		sum_proto_op(&sum->mnt.v1_ops, &gsp->mnt.v1_ops);
+		sum_proto_op(&sum->mnt.v3_ops, &gsp->mnt.v3_ops);
+		sum_proto_op(&sum->nlm4.ops, &gsp->nlm4.ops);
+		sum_proto_op(&sum->rquota.ops, &gsp->rquota.ops);
+		sum_proto_op(&sum->rquota.ext_ops, &gsp->rquota.ext_ops);
+		sum_v40(&sum->nfsv40, &gsp->nfsv40);
+		sum_v41(&sum->nfsv41, &gsp->nfsv41);
+		sum_v41(&sum->nfsv42, &gsp->nfsv42);
+		sum_ops(sum->v3.op, gsp->v3.op, NFSPROC3_COMMIT + 1);
+		sum_ops(sum->v4.op, gsp->v4.op, NFS4_OP_LAST_ONE);
+		sum_ops(sum->lm.op, gsp->lm.op, NLMPROC4_FREE_ALL + 1);
+		sum_ops(sum->mn.op, gsp->mn.op, MOUNTPROC3_EXPORT + 1);
+		sum_ops(sum->qt.op, gsp->qt.op, RQUOTAPROC_SETACTIVEQUOTA + 1);
+	}
+}
+
+/**
+ * @brief Sum the shards of a protocol stats struct
+ *
+ * @param sum [OUT] zeroed and filled in
+ * @param sp  [IN]  shard array, must not be NULL
+ * @param st  [IN]  stats block owning sp
+ */
+
+static void stats_sum_v3(struct nfsv3_stats *sum, struct nfsv3_stats *sp,
+			 struct gsh_stats *st)
+{
+	uint32_t i;
+
+	memset(sum, 0, sizeof(*sum));
+	for (i = 0; i < stats_nshards(st); i++)
+		sum_v3(sum, &sp[i]);
+}
+
+static void stats_sum_v40(struct nfsv40_stats *sum, struct nfsv40_stats *sp,
+			  struct gsh_stats *st)
+{
+	uint32_t i;
+
+	memset(sum, 0, sizeof(*sum));
+	for (i = 0; i < stats_nshards(st); i++)
+		sum_v40(sum, &sp[i]);
+}
+
+static void stats_sum_v41(struct nfsv41_stats *sum, struct nfsv41_stats *sp,
+			  struct gsh_stats *st)
+{
+	uint32_t i;
+
+	memset(sum, 0, sizeof(*sum));
+	for (i = 0; i < stats_nshards(st); i++)
+		sum_v41(sum, &sp[i]);
+}
+
+/* Functions for marshalling statistics to DBUS
+ */
+
+/**
+ * @brief Report Stats availability as members of a struct
+ *
+ * struct available_stats {
+ *      ...
+ *	bool nfsv3;
+ *	bool mnt;
+ *	bool nlm4;
+ *	bool rquota;
+ *	bool nfsv40;
+ *	bool nfsv41;
+ *	bool nfsv42;
+ *	bool _9p;
+ *      ...
+ * }
+ *
+ * @param name        [IN] name of export or IP address as string
+ * @param stats       [IN] pointer to server stats struct
+ * @param last_update [IN] elapsed timestamp of last activity
+ * @param iter        [IN] iterator to stuff struct into
+ */
+
+void server_stats_summary(DBusMessageIter *iter, struct gsh_stats *st)
+{
+	dbus_bool_t stats_available;
+
+	stats_available = st->nfsv3 != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->mnt != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->nlm4 != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->rquota != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->nfsv40 != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->nfsv41 != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->nfsv42 != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+	stats_available = st->_9p != 0;
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN,
+				       &stats_available);
+}
+
+/** @brief Report protocol operation statistics
+ *
+ * struct proto_op {
+ *         uint64_t total;
+ *         uint64_t errors;
+ *         ...
+ * }
+ *
+ * @param op    [IN] pointer to proto op sub-structure of interest
+ * @param iter  [IN] interator in reply stream to fill
+ */
+static void server_dbus_op_stats(struct proto_op *op, DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
 	uint64_t zero = 0;
@@ -1416,6 +1954,10 @@ static void server_dbus_transportstats(struct transport_stats *tstats,
 void server_dbus_total(struct export_stats *export_st, DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
+	struct gsh_stats *st = &export_st->st;
+	struct nfsv3_stats v3;
+	struct nfsv40_stats v40;
+	struct nfsv41_stats v41;
 	uint64_t total = 0;
 	char *version;
 
@@ -1428,44 +1970,54 @@ void server_dbus_total(struct export_stats *export_st, DBusMessageIter *iter)
 	if (export_st->st.nfsv3 == NULL)
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 				&total);
-	else
+	else {
+		stats_sum_v3(&v3, st->nfsv3, st);
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv3->cmds.total);
+				&v3.cmds.total);
+	}
 	version = "NFSv40";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	if (export_st->st.nfsv40 == NULL)
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 				&total);
-	else
+	else {
+		stats_sum_v40(&v40, st->nfsv40, st);
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv40->compounds.total);
+				&v40.compounds.total);
+	}
 	version = "NFSv41";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	if (export_st->st.nfsv41 == NULL)
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 				&total);
-	else
+	else {
+		stats_sum_v41(&v41, st->nfsv41, st);
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv41->compounds.total);
+				&v41.compounds.total);
+	}
 	version = "NFSv42";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	if (export_st->st.nfsv42 == NULL)
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 				&total);
-	else
+	else {
+		stats_sum_v41(&v41, st->nfsv42, st);
 		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv42->compounds.total);
+				&v41.compounds.total);
+	}
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
 void global_dbus_total(DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
+	struct global_stats global_sum;
 	char *version;
 
+	sum_global(&global_sum);
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
 
@@ -1473,42 +2025,42 @@ void global_dbus_total(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv3.cmds.total);
+					&global_sum.nfsv3.cmds.total);
 	version = "NFSv40";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv40.compounds.total);
+					&global_sum.nfsv40.compounds.total);
 	version = "NFSv41";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv41.compounds.total);
+					&global_sum.nfsv41.compounds.total);
 	version = "NFSv42";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv42.compounds.total);
+					&global_sum.nfsv42.compounds.total);
 	version = "NLM4";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nlm4.ops.total);
+					&global_sum.nlm4.ops.total);
 	version = "MNTv1";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.mnt.v1_ops.total);
+					&global_sum.mnt.v1_ops.total);
 	version = "MNTv3";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.mnt.v3_ops.total);
+					&global_sum.mnt.v3_ops.total);
 	version = "RQUOTA";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.rquota.ops.total);
+					&global_sum.rquota.ops.total);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
@@ -1516,9 +2068,11 @@ void global_dbus_fast(DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
 	char *version;
+	struct global_stats global_sum;
 	char *op;
 	int i;
 
+	sum_global(&global_sum);
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
 
@@ -1526,103 +2080,111 @@ void global_dbus_fast(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NFSPROC3_COMMIT; i++) {
-		if (global_st.v3.op[i] > 0) {
+		if (global_sum.v3.op[i] > 0) {
 			op = optabv3[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.v3.op[i]);
+					DBUS_TYPE_UINT64, &global_sum.v3.op[i]);
 		}
 	}
 	version = "\nNFSv4:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NFS4_OP_LAST_ONE; i++) {
-		if (global_st.v4.op[i] > 0) {
+		if (global_sum.v4.op[i] > 0) {
 			op = optabv4[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.v4.op[i]);
+					DBUS_TYPE_UINT64, &global_sum.v4.op[i]);
 		}
 	}
 	version = "\nNLM:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NLM4_FAILED; i++) {
-		if (global_st.lm.op[i] > 0) {
+		if (global_sum.lm.op[i] > 0) {
 			op = optnlm[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.lm.op[i]);
+					DBUS_TYPE_UINT64, &global_sum.lm.op[i]);
 		}
 	}
 	version = "\nMNT:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < MOUNTPROC3_EXPORT; i++) {
-		if (global_st.mn.op[i] > 0) {
+		if (global_sum.mn.op[i] > 0) {
 			op = optmnt[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.mn.op[i]);
+					DBUS_TYPE_UINT64, &global_sum.mn.op[i]);
 		}
 	}
 	version = "\nQUOTA:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < RQUOTAPROC_SETACTIVEQUOTA; i++) {
-		if (global_st.qt.op[i] > 0) {
+		if (global_sum.qt.op[i] > 0) {
 			op = optqta[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.qt.op[i]);
+					DBUS_TYPE_UINT64, &global_sum.qt.op[i]);
 		}
 	}
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
-void server_dbus_v3_iostats(struct nfsv3_stats *v3p, DBusMessageIter *iter)
+void server_dbus_v3_iostats(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv3_stats sum;
 
+	stats_sum_v3(&sum, st->nfsv3, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v3p->read, iter);
-	server_dbus_iostats(&v3p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
-void server_dbus_v40_iostats(struct nfsv40_stats *v40p, DBusMessageIter *iter)
+void server_dbus_v40_iostats(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv40_stats sum;
 
+	stats_sum_v40(&sum, st->nfsv40, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v40p->read, iter);
-	server_dbus_iostats(&v40p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
-void server_dbus_v41_iostats(struct nfsv41_stats *v41p, DBusMessageIter *iter)
+void server_dbus_v41_iostats(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	stats_sum_v41(&sum, st->nfsv41, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v41p->read, iter);
-	server_dbus_iostats(&v41p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
-void server_dbus_v42_iostats(struct nfsv41_stats *v42p, DBusMessageIter *iter)
+void server_dbus_v42_iostats(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	stats_sum_v41(&sum, st->nfsv42, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v42p->read, iter);
-	server_dbus_iostats(&v42p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_fill_io(DBusMessageIter *array_iter, uint16_t *export_id,
@@ -1666,36 +2228,37 @@ void server_dbus_fill_io(DBusMessageIter *array_iter, uint16_t *export_id,
 void server_dbus_all_iostats(struct export_stats *export_statistics,
 			     DBusMessageIter *array_iter)
 {
-	if (export_statistics->st.nfsv3 != NULL) {
+	struct gsh_stats *st = &export_statistics->st;
+	struct nfsv3_stats v3;
+	struct nfsv40_stats v40;
+	struct nfsv41_stats v41;
+
+	if (st->nfsv3 != NULL) {
+		stats_sum_v3(&v3, st->nfsv3, st);
 		server_dbus_fill_io(array_iter,
 				    &(export_statistics->export.export_id),
-				    "NFSv3",
-				    &(export_statistics->st.nfsv3->read),
-				    &(export_statistics->st.nfsv3->write));
+				    "NFSv3", &v3.read, &v3.write);
 	}
 
-	if (export_statistics->st.nfsv40 != NULL) {
+	if (st->nfsv40 != NULL) {
+		stats_sum_v40(&v40, st->nfsv40, st);
 		server_dbus_fill_io(array_iter,
 				    &(export_statistics->export.export_id),
-				    "NFSv40",
-				    &(export_statistics->st.nfsv40->read),
-				    &(export_statistics->st.nfsv40->write));
+				    "NFSv40", &v40.read, &v40.write);
 	}
 
-	if (export_statistics->st.nfsv41 != NULL) {
+	if (st->nfsv41 != NULL) {
+		stats_sum_v41(&v41, st->nfsv41, st);
 		server_dbus_fill_io(array_iter,
 				    &(export_statistics->export.export_id),
-				    "NFSv41",
-				    &(export_statistics->st.nfsv41->read),
-				    &(export_statistics->st.nfsv41->write));
+				    "NFSv41", &v41.read, &v41.write);
 	}
 
-	if (export_statistics->st.nfsv42 != NULL) {
+	if (st->nfsv42 != NULL) {
+		stats_sum_v41(&v41, st->nfsv42, st);
 		server_dbus_fill_io(array_iter,
 				    &(export_statistics->export.export_id),
-				    "NFSv42",
-				    &(export_statistics->st.nfsv42->read),
-				    &(export_statistics->st.nfsv42->write));
+				    "NFSv42", &v41.read, &v41.write);
 	}
 }
 
@@ -1732,6 +2295,8 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 	struct timespec timestamp;
 	DBusMessageIter struct_iter;
 	char *type;
+	uint64_t entries, dirs, entry_size, dir_size;
+	uint64_t inode_bytes, bytes_per_inode;
 
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
@@ -1763,6 +2328,298 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 					&cache_st.inode_mapping);
 
+	/* Memory held by cache_inode for its own structures.  FSAL
+	 * object handles and hash keys are sized by the FSAL and are
+	 * not included. */
+	entries = atomic_fetch_uint64_t(&lru_state.entries_used);
+	dirs = atomic_fetch_uint64_t(&cache_st.inode_dirs);
+	entry_size = sizeof(cache_entry_t);
+	dir_size = sizeof(struct cache_inode_dir);
+	inode_bytes = entries * entry_size + dirs * dir_size;
+	bytes_per_inode = entries ? inode_bytes / entries : entry_size;
+
+	type = "cache_entries";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&entries);
+	type = "cache_dirs";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&dirs);
+	type = "entry_size";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&entry_size);
+	type = "dir_size";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&dir_size);
+	type = "inode_bytes";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&inode_bytes);
+	type = "bytes_per_inode";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&bytes_per_inode);
+
+	type = "ra_hits";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_ra_st.hits);
+	type = "ra_misses";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_ra_st.misses);
+	type = "ra_fills";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_ra_st.fills);
+	type = "ra_evicted";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_ra_st.evicted);
+	type = "fh_hint_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.fh_hint_hit);
+	type = "fh_hint_miss";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.fh_hint_miss);
+	type = "fh_hint_bad";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.fh_hint_bad);
+
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+void fsal_sync_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	char *type;
+	uint64_t requests, syncs, saved, writebacks;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	requests = atomic_fetch_uint64_t(&fsal_sync_stats.requests);
+	syncs = atomic_fetch_uint64_t(&fsal_sync_stats.syncs);
+	saved = requests > syncs ? requests - syncs : 0;
+	writebacks = atomic_fetch_uint64_t(&fsal_sync_stats.writebacks);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "sync_requests";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&requests);
+	type = "syncs";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&syncs);
+	type = "syncs_saved";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&saved);
+	type = "range_writebacks";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&writebacks);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+void fsal_up_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	char *type;
+	uint64_t queued, coalesced, batches, depth, max_depth;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	queued = atomic_fetch_uint64_t(&fsal_up_batch_st.queued);
+	coalesced = atomic_fetch_uint64_t(&fsal_up_batch_st.coalesced);
+	batches = atomic_fetch_uint64_t(&fsal_up_batch_st.batches);
+	depth = atomic_fetch_uint64_t(&fsal_up_batch_st.depth);
+	max_depth = atomic_fetch_uint64_t(&fsal_up_batch_st.max_depth);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "upcalls_queued";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&queued);
+	type = "upcalls_coalesced";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&coalesced);
+	type = "batches";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&batches);
+	type = "queue_depth";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&depth);
+	type = "max_queue_depth";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&max_depth);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+/**
+ * @brief Report the timers and run queues of the delayed executor
+ *
+ * @param iter [IN] The iterator to the dbus message
+ */
+
+void delayed_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	struct delayed_stats st;
+	char *type;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	delayed_get_stats(&st);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "submitted";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.submitted);
+	type = "cancelled";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.cancelled);
+	type = "run";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.run);
+	type = "batches";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.batches);
+	type = "stolen";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.stolen);
+	type = "pending";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.pending);
+	type = "queue_depth";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.queued);
+	type = "max_queue_depth";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st.max_queued);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+/**
+ * @brief Report the requests of each NUMA node
+ *
+ * @param iter [IN] The iterator to the dbus message
+ */
+
+void numa_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	struct nfs_node_stats st;
+	uint32_t node;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 NUMA_NODES_ARRAY_TYPE, &array_iter);
+	for (node = 0; node < gsh_numa_nodes(); node++) {
+		nfs_rpc_node_stats(node, &st);
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+					       &node);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.enqueued);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.local);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.remote);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.queued);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report the adaptive delegation policy
+ *
+ * @param iter [IN] The iterator to the dbus message
+ */
+
+void deleg_policy_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	char *type;
+	uint64_t opens, granted, declined, saved;
+	uint64_t recalls, recall_avg, recall_max;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	opens = atomic_fetch_uint64_t(&deleg_policy_st.opens);
+	granted = atomic_fetch_uint64_t(&deleg_policy_st.granted);
+	declined = atomic_fetch_uint64_t(&deleg_policy_st.declined);
+	saved = atomic_fetch_uint64_t(&deleg_policy_st.saved_opens);
+	recalls = atomic_fetch_uint64_t(&deleg_policy_st.recalls);
+	recall_avg = recalls == 0 ? 0 :
+		atomic_fetch_uint64_t(&deleg_policy_st.recall_usec) / recalls;
+	recall_max = atomic_fetch_uint64_t(&deleg_policy_st.recall_usec_max);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "opens";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&opens);
+	type = "granted";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&granted);
+	type = "declined";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&declined);
+	type = "predicted_opens_saved";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&saved);
+	type = "recalls";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&recalls);
+	type = "recall_usec_avg";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&recall_avg);
+	type = "recall_usec_max";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&recall_max);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
@@ -1826,30 +2683,34 @@ static void server_dbus_layouts(struct layout_op *lop, DBusMessageIter *iter)
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
-void server_dbus_v41_layouts(struct nfsv41_stats *v41p, DBusMessageIter *iter)
+void server_dbus_v41_layouts(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	stats_sum_v41(&sum, st->nfsv41, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_layouts(&v41p->getdevinfo, iter);
-	server_dbus_layouts(&v41p->layout_get, iter);
-	server_dbus_layouts(&v41p->layout_commit, iter);
-	server_dbus_layouts(&v41p->layout_return, iter);
-	server_dbus_layouts(&v41p->recall, iter);
+	server_dbus_layouts(&sum.getdevinfo, iter);
+	server_dbus_layouts(&sum.layout_get, iter);
+	server_dbus_layouts(&sum.layout_commit, iter);
+	server_dbus_layouts(&sum.layout_return, iter);
+	server_dbus_layouts(&sum.recall, iter);
 }
 
-void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter)
+void server_dbus_v42_layouts(struct gsh_stats *st, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	stats_sum_v41(&sum, st->nfsv42, st);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_layouts(&v42p->getdevinfo, iter);
-	server_dbus_layouts(&v42p->layout_get, iter);
-	server_dbus_layouts(&v42p->layout_commit, iter);
-	server_dbus_layouts(&v42p->layout_return, iter);
-	server_dbus_layouts(&v42p->recall, iter);
+	server_dbus_layouts(&sum.getdevinfo, iter);
+	server_dbus_layouts(&sum.layout_get, iter);
+	server_dbus_layouts(&sum.layout_commit, iter);
+	server_dbus_layouts(&sum.layout_return, iter);
+	server_dbus_layouts(&sum.recall, iter);
 }
 
 /**
@@ -1878,6 +2739,298 @@ void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter)
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+/**
+ * @brief Parse the op name argument of latency histogram requests
+ *
+ * @param args    [IN]  message argument iterator
+ * @param opname  [OUT] op name, owned by the message
+ * @param errormsg [OUT] reason on failure
+ *
+ * @return true if a string was found
+ */
+
+bool arg_latency_op(DBusMessageIter *args, char **opname, char **errormsg)
+{
+	if (args == NULL) {
+		*errormsg = "message is missing argument";
+		return false;
+	}
+	if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_STRING) {
+		*errormsg = "arg not a string";
+		return false;
+	}
+	dbus_message_iter_get_basic(args, opname);
+	return true;
+}
+
+/**
+ * @brief Parse the window argument of global latency requests
+ *
+ * @param args     [IN]  message argument iterator
+ * @param window   [OUT] 0 (since start), 1, 10 or 60 seconds
+ * @param errormsg [OUT] reason on failure
+ *
+ * @return true if a valid window was found
+ */
+
+bool arg_latency_window(DBusMessageIter *args, uint32_t *window,
+			char **errormsg)
+{
+	int w;
+
+	if (args == NULL) {
+		*errormsg = "message is missing argument";
+		return false;
+	}
+	if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT32) {
+		*errormsg = "arg not a uint32";
+		return false;
+	}
+	dbus_message_iter_get_basic(args, window);
+	if (*window == 0)
+		return true;
+	for (w = 0; w < HIST_WIN_COUNT; w++)
+		if (*window == hist_win_secs[w])
+			return true;
+	*errormsg = "window must be 0, 1, 10 or 60";
+	return false;
+}
+
+/**
+ * @brief Report percentiles of one op
+ *
+ * struct {
+ *	string name;
+ *	uint64_t count;
+ *	uint64_t latency_p50, p90, p99, p999, max;
+ *	uint64_t qwait_p50, p99, p999, max;
+ * }
+ *
+ * @param array_iter [IN] array iterator to append to
+ * @param name       [IN] op name
+ * @param latency    [IN] latency histogram
+ * @param qwait      [IN] queue wait histogram
+ */
+
+static void server_dbus_op_percentiles(DBusMessageIter *array_iter,
+				       const char *name,
+				       struct lat_histogram *latency,
+				       struct lat_histogram *qwait)
+{
+	DBusMessageIter struct_iter;
+	uint64_t count, qcount, val;
+	static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+	static const double qpcts[] = { 50.0, 99.0, 99.9 };
+	int i;
+
+	count = lat_hist_count(latency);
+	qcount = lat_hist_count(qwait);
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &count);
+	for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++) {
+		val = lat_hist_percentile(latency, count, pcts[i]);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+	}
+	val = lat_hist_max(latency);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	for (i = 0; i < sizeof(qpcts) / sizeof(qpcts[0]); i++) {
+		val = lat_hist_percentile(qwait, qcount, qpcts[i]);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+	}
+	val = lat_hist_max(qwait);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report latency percentiles of an export or client
+ *
+ * @param st   [IN] stats struct from client or export
+ * @param iter [IN] iterator in reply stream to fill
+ */
+
+void server_dbus_latency_percentiles(struct gsh_stats *st,
+				     DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	struct named_op ops[MAX_STATS_HIST_OPS];
+	struct lat_histogram latency, qwait;
+	DBusMessageIter array_iter;
+	int i, n;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 LAT_PERCENTILES_ARRAY_TYPE,
+					 &array_iter);
+	n = stats_hist_ops(st, ops);
+	for (i = 0; i < n; i++) {
+		lat_hist_shards_sum(&ops[i].op->hist->latency, &latency);
+		lat_hist_shards_sum(&ops[i].op->hist->qwait, &qwait);
+		server_dbus_op_percentiles(&array_iter, ops[i].name,
+					   &latency, &qwait);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report global latency percentiles
+ *
+ * @param window [IN] 0 for since start, else 1, 10 or 60 seconds
+ * @param iter   [IN] iterator in reply stream to fill
+ */
+
+void global_dbus_latency_percentiles(uint32_t window, DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	struct lat_histogram latency, qwait;
+	DBusMessageIter array_iter;
+	int i, w = 0;
+
+	while (window != 0 && hist_win_secs[w] != window)
+		w++;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 LAT_PERCENTILES_ARRAY_TYPE,
+					 &array_iter);
+	for (i = 0; i < GLOBAL_HIST_OPS; i++) {
+		struct op_hist *hist = global_hist_ops[i].op->hist;
+
+		if (hist == NULL)
+			continue;
+		if (window == 0) {
+			lat_hist_shards_sum(&hist->latency, &latency);
+			lat_hist_shards_sum(&hist->qwait, &qwait);
+		} else if (hist->win != NULL) {
+			PTHREAD_MUTEX_lock(&hist_win_mtx);
+			latency = hist->win->last_latency[w];
+			qwait = hist->win->last_qwait[w];
+			PTHREAD_MUTEX_unlock(&hist_win_mtx);
+		} else {
+			continue;
+		}
+		server_dbus_op_percentiles(&array_iter, global_hist_ops[i].name,
+					   &latency, &qwait);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static struct proto_op *find_hist_op(struct gsh_stats *st, const char *opname)
+{
+	struct named_op ops[MAX_STATS_HIST_OPS];
+	int i, n;
+
+	n = stats_hist_ops(st, ops);
+	for (i = 0; i < n; i++)
+		if (strcmp(ops[i].name, opname) == 0)
+			return ops[i].op;
+	return NULL;
+}
+
+/**
+ * @brief Does an export or client have histograms for an op
+ */
+
+bool server_stats_has_latency(struct gsh_stats *st, const char *opname)
+{
+	return find_hist_op(st, opname) != NULL;
+}
+
+static void server_dbus_buckets(struct lat_histogram *hist,
+				DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter, struct_iter;
+	uint64_t val;
+	unsigned int i;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(tt)",
+					 &array_iter);
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		if (hist->bucket[i] == 0)
+			continue;
+		val = lat_hist_bucket_value(i);
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &hist->bucket[i]);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report the raw latency and queue wait histograms of an op
+ *
+ * Each histogram is an array of (bucket upper bound in nsecs, count)
+ * for the non-empty buckets.  Values too large for any bucket are
+ * reported last, with the lowest value they can have.
+ *
+ * @param st     [IN] stats struct from client or export
+ * @param opname [IN] op name as reported by the percentiles methods
+ * @param iter   [IN] iterator in reply stream to fill
+ */
+
+void server_dbus_latency_histogram(struct gsh_stats *st, const char *opname,
+				   DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	struct lat_histogram latency, qwait;
+	struct proto_op *op = find_hist_op(st, opname);
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	if (op != NULL) {
+		lat_hist_shards_sum(&op->hist->latency, &latency);
+		lat_hist_shards_sum(&op->hist->qwait, &qwait);
+	} else {
+		memset(&latency, 0, sizeof(latency));
+		memset(&qwait, 0, sizeof(qwait));
+	}
+	server_dbus_buckets(&latency, iter);
+	server_dbus_buckets(&qwait, iter);
+}
+
+/**
+ * @brief Report how long each phase of startup took
+ */
+
+void startup_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	uint64_t usec;
+	char *type;
+	int phase;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	for (phase = 0; phase < STARTUP_PHASES; phase++) {
+		type = (char *)startup_phases[phase].name;
+		usec = startup_phases[phase].elapsed / NS_PER_USEC;
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+					       &type);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &usec);
+	}
+	type = "ready";
+	usec = startup_ready / NS_PER_USEC;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &usec);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
 #endif				/* USE_DBUS */
 
 /**
@@ -1891,6 +3044,14 @@ void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter)
 
 void server_stats_free(struct gsh_stats *statsp)
 {
+	struct named_op ops[MAX_STATS_HIST_OPS];
+	int i, n;
+
+	n = stats_hist_ops(statsp, ops);
+	for (i = 0; i < n; i++) {
+		op_hist_free(ops[i].op->hist);
+		ops[i].op->hist = NULL;
+	}
 	if (statsp->nfsv3 != NULL) {
 		gsh_free(statsp->nfsv3);
 		statsp->nfsv3 = NULL;
@@ -1924,8 +3085,11 @@ void server_stats_free(struct gsh_stats *statsp)
 		u8 opc;
 
 		for (opc = 0; opc <= _9P_RWSTAT; opc++) {
-			if (statsp->_9p->opcodes[opc] != NULL)
-				gsh_free(statsp->_9p->opcodes[opc]);
+			if (statsp->_9p->opcodes[opc] == NULL)
+				continue;
+			if (statsp->_9p->opcodes[opc]->hist != NULL)
+				op_hist_free(statsp->_9p->opcodes[opc]->hist);
+			gsh_free(statsp->_9p->opcodes[opc]);
 		}
 		gsh_free(statsp->_9p);
 		statsp->_9p = NULL;
@@ -1933,4 +3097,50 @@ void server_stats_free(struct gsh_stats *statsp)
 #endif
 }
 
+/**
+ * @brief Start timing a phase of startup
+ *
+ * Startup is single threaded, so nothing here is locked.
+ */
+
+void server_stats_startup_begin(enum startup_phase phase)
+{
+	struct timespec ts;
+
+	now(&ts);
+	startup_phases[phase].start = timespec_diff(&ServerBootTime, &ts);
+}
+
+/**
+ * @brief Finish timing a phase of startup and log it
+ */
+
+void server_stats_startup_end(enum startup_phase phase)
+{
+	struct timespec ts;
+
+	now(&ts);
+	startup_phases[phase].elapsed = timespec_diff(&ServerBootTime, &ts) -
+					startup_phases[phase].start;
+
+	LogEvent(COMPONENT_INIT, "Startup phase %s took %" PRIu64 " ms",
+		 startup_phases[phase].name,
+		 startup_phases[phase].elapsed / NS_PER_MSEC);
+}
+
+/**
+ * @brief Record that the server is ready to serve
+ */
+
+void server_stats_startup_done(void)
+{
+	struct timespec ts;
+
+	now(&ts);
+	startup_ready = timespec_diff(&ServerBootTime, &ts);
+
+	LogEvent(COMPONENT_INIT, "Server ready %" PRIu64 " ms after start",
+		 startup_ready / NS_PER_MSEC);
+}
+
 /** @} */
@@ -0,0 +1,245 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_cache_inode.c
+ * @brief Microbenchmarks of the cache_inode hash and LRU
+ *
+ * Handles of the BENCH FSAL are 8 byte keys, each case draws its keys
+ * from its own range:
+ *
+ * - cih_hit and cih_miss probe the handle hash directly with
+ *   cih_get_by_key_latched, as PUTFH does before anything else.
+ * - get_hit is cache_inode_get and cache_inode_put of cached entries.
+ * - get_hinted is get_hit through cache_inode_get_hinted, with the
+ *   hints that File_Handle_Hints puts in handles, as PUTFH of such a
+ *   handle does.
+ * - get_miss asks for a handle never seen before every time, so each
+ *   call creates an FSAL handle and inserts a new entry.  Once the
+ *   cache is at its high water mark every insert recycles an entry.
+ * - lru_churn picks keys out of twice as many handles as the cache
+ *   holds, so that about half of the calls reap an entry.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "abstract_atomic.h"
+#include "cache_inode.h"
+#include "cache_inode_hash.h"
+#include "cache_inode_lru.h"
+#include "abstract_mem.h"
+#include "bench_common.h"
+
+#define KEY_HIT		0
+#define KEY_MISS	(1ULL << 40)
+#define KEY_FRESH	(1ULL << 48)
+#define KEY_CHURN	(1ULL << 56)
+
+static uint64_t fresh_key = KEY_FRESH;
+static uint64_t *hit_hints;
+
+static void get_put(struct bench_thread *bt, uint64_t k)
+{
+	cache_entry_t *entry = bench_get_entry(k);
+
+	if (entry == NULL) {
+		bt->errors++;
+		return;
+	}
+	cache_inode_put(entry);
+}
+
+static void cih_probe(struct bench_thread *bt, uint64_t k, bool expected)
+{
+	struct gsh_buffdesc fh_desc = {
+		.addr = &k,
+		.len = sizeof(k)
+	};
+	cache_inode_key_t key;
+	cih_latch_t latch;
+	cache_entry_t *entry;
+
+	(void)cih_hash_key(&key, bench_fsal, &fh_desc,
+			   CIH_HASH_KEY_PROTOTYPE);
+
+	entry = cih_get_by_key_latched(&key, &latch,
+				       CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
+				       __func__, __LINE__);
+	if (entry != NULL)
+		cih_latch_rele(&latch);
+
+	if ((entry != NULL) != expected)
+		bt->errors++;
+}
+
+/**
+ * @brief Make sure the whole hit set is cached
+ */
+
+static int warm_hit_set(void)
+{
+	struct bench_thread bt = { 0 };
+	uint32_t i;
+
+	for (i = 0; i < bench_opts.objects; i++)
+		get_put(&bt, KEY_HIT + i);
+
+	return bt.errors != 0 ? -1 : 0;
+}
+
+/**
+ * @brief Hint every handle of the hit set, as minted handles would be
+ */
+
+static int hint_hit_set(void)
+{
+	struct gsh_buffdesc fh_desc;
+	uint64_t k;
+	uint32_t i;
+
+	if (hit_hints == NULL) {
+		hit_hints = gsh_malloc(bench_opts.objects * sizeof(*hit_hints));
+		if (hit_hints == NULL)
+			return -1;
+	}
+
+	for (i = 0; i < bench_opts.objects; i++) {
+		k = KEY_HIT + i;
+		fh_desc.addr = &k;
+		fh_desc.len = sizeof(k);
+		hit_hints[i] = cih_hash_fh(&fh_desc);
+	}
+
+	memset(cache_stp, 0, sizeof(*cache_stp));
+	return warm_hit_set();
+}
+
+static void hinted_report(void)
+{
+	fprintf(stderr, "%" PRIu64 " hinted hits, %" PRIu64 " misses\n",
+		atomic_fetch_uint64_t(&cache_stp->fh_hint_hit),
+		atomic_fetch_uint64_t(&cache_stp->fh_hint_miss));
+}
+
+static void cih_hit_op(struct bench_thread *bt)
+{
+	cih_probe(bt, KEY_HIT + bench_rand(bt) % bench_opts.objects, true);
+}
+
+static void cih_miss_op(struct bench_thread *bt)
+{
+	cih_probe(bt, KEY_MISS + bench_rand(bt) % bench_opts.objects, false);
+}
+
+static void get_hit_op(struct bench_thread *bt)
+{
+	get_put(bt, KEY_HIT + bench_rand(bt) % bench_opts.objects);
+}
+
+static void get_hinted_op(struct bench_thread *bt)
+{
+	uint32_t i = bench_rand(bt) % bench_opts.objects;
+	uint64_t k = KEY_HIT + i;
+	cache_inode_fsal_data_t fsdata = {
+		.export = bench_fsal_export,
+		.fh_desc.addr = &k,
+		.fh_desc.len = sizeof(k),
+	};
+	cache_entry_t *entry;
+
+	if (cache_inode_get_hinted(&fsdata, hit_hints[i], &entry) !=
+	    CACHE_INODE_SUCCESS) {
+		bt->errors++;
+		return;
+	}
+	cache_inode_put(entry);
+}
+
+static void get_miss_op(struct bench_thread *bt)
+{
+	get_put(bt, atomic_inc_uint64_t(&fresh_key));
+}
+
+static void lru_churn_op(struct bench_thread *bt)
+{
+	get_put(bt, KEY_CHURN + bench_rand(bt) %
+		(2 * (uint64_t)cache_param.entries_hwmark));
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "cih_hit",
+		.desc = "cih_get_by_key_latched of cached handles",
+		.setup = warm_hit_set,
+		.op = cih_hit_op,
+	},
+	{
+		.name = "cih_miss",
+		.desc = "cih_get_by_key_latched of unknown handles",
+		.setup = warm_hit_set,
+		.op = cih_miss_op,
+	},
+	{
+		.name = "get_hit",
+		.desc = "cache_inode_get and put of cached handles",
+		.setup = warm_hit_set,
+		.op = get_hit_op,
+	},
+	{
+		.name = "get_hinted",
+		.desc = "cache_inode_get_hinted and put of cached handles",
+		.setup = hint_hit_set,
+		.op = get_hinted_op,
+		.cleanup = hinted_report,
+	},
+	{
+		.name = "get_miss",
+		.desc = "cache_inode_get and put of new handles",
+		.op = get_miss_op,
+	},
+	{
+		.name = "lru_churn",
+		.desc = "cache_inode_get and put over twice Entries_HWMark handles",
+		.op = lru_churn_op,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_cache_inode", cases,
+			     ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	if (bench_opts.objects > cache_param.entries_hwmark)
+		fprintf(stderr,
+			"Warning: %u objects do not fit under Entries_HWMark %u, hits will miss\n",
+			bench_opts.objects, cache_param.entries_hwmark);
+
+	return bench_run_cases(cases, ncases);
+}
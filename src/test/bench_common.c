@@ -0,0 +1,865 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_common.c
+ * @brief Harness for the in-process microbenchmarks
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "config_parsing.h"
+#include "fsal.h"
+#include "FSAL/fsal_commonlib.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "sal_functions.h"
+#include "export_mgr.h"
+#include "../MainNFSD/nfs_init.h"
+#include "bench_common.h"
+
+/** Threads publish their op count and check for the end this often */
+#define BENCH_BATCH 64
+
+struct bench_options bench_opts = {
+	.duration = 2.0,
+	.warmup = 0.5,
+	.objects = 10000,
+};
+
+struct fsal_module *bench_fsal;
+struct fsal_export *bench_fsal_export;
+struct gsh_export *bench_export;
+struct req_op_context bench_main_ctx;
+
+static struct user_cred bench_main_creds;
+
+/* Needed by the server libraries, normally in nfs_main.c */
+config_file_t config_struct;
+char *log_path;
+char *exec_name = "bench";
+char *host_name = "localhost";
+int debug_level = -1;
+int detach_flag;
+nfs_start_info_t my_nfs_start_info;
+
+static int32_t bench_running;
+
+/*
+ * The BENCH FSAL
+ *
+ * Handles are 8 byte keys.  Every handle is a regular file that exists
+ * as soon as somebody asks for it; nothing is stored besides the
+ * object itself, so the cost measured above it is only that of the
+ * layers under test.
+ */
+
+struct bench_handle {
+	struct fsal_obj_handle obj_handle;
+	struct attrlist attributes;
+	uint64_t key;
+	fsal_openflags_t openflags;
+};
+
+static struct fsal_module bench_module;
+static struct fsal_export bench_module_export;
+
+static void bench_release(struct fsal_obj_handle *obj_hdl)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	fsal_obj_handle_fini(obj_hdl);
+	gsh_free(hdl);
+}
+
+static void bench_handle_to_key(struct fsal_obj_handle *obj_hdl,
+				struct gsh_buffdesc *fh_desc)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	fh_desc->addr = &hdl->key;
+	fh_desc->len = sizeof(hdl->key);
+}
+
+static fsal_status_t bench_getattrs(struct fsal_obj_handle *obj_hdl)
+{
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t bench_open(struct fsal_obj_handle *obj_hdl,
+				fsal_openflags_t openflags)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	hdl->openflags = openflags;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_openflags_t bench_status(struct fsal_obj_handle *obj_hdl)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	return hdl->openflags;
+}
+
+static fsal_status_t bench_close(struct fsal_obj_handle *obj_hdl)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	if (hdl->openflags == FSAL_O_CLOSED)
+		return fsalstat(ERR_FSAL_NOT_OPENED, 0);
+	hdl->openflags = FSAL_O_CLOSED;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t bench_create_handle(struct fsal_export *exp_hdl,
+					 struct gsh_buffdesc *hdl_desc,
+					 struct fsal_obj_handle **handle)
+{
+	struct bench_handle *hdl;
+	struct fsal_obj_ops *ops;
+	struct timespec ts;
+
+	*handle = NULL;
+
+	if (hdl_desc->len != sizeof(uint64_t))
+		return fsalstat(ERR_FSAL_BADHANDLE, 0);
+
+	hdl = gsh_calloc(1, sizeof(*hdl));
+	if (hdl == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	memcpy(&hdl->key, hdl_desc->addr, sizeof(hdl->key));
+	hdl->openflags = FSAL_O_CLOSED;
+	hdl->obj_handle.attrs = &hdl->attributes;
+	fsal_obj_handle_init(&hdl->obj_handle, exp_hdl, REGULAR_FILE);
+
+	ops = &hdl->obj_handle.obj_ops;
+	ops->release = bench_release;
+	ops->handle_to_key = bench_handle_to_key;
+	ops->getattrs = bench_getattrs;
+	ops->open = bench_open;
+	ops->status = bench_status;
+	ops->close = bench_close;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	hdl->attributes.mask = ATTR_TYPE | ATTR_SIZE | ATTR_FILEID |
+	    ATTR_MODE | ATTR_NUMLINKS | ATTR_OWNER | ATTR_GROUP |
+	    ATTR_ATIME | ATTR_CTIME | ATTR_MTIME | ATTR_CHGTIME |
+	    ATTR_CHANGE;
+	hdl->attributes.type = REGULAR_FILE;
+	hdl->attributes.fileid = hdl->key;
+	hdl->attributes.mode = 0644;
+	hdl->attributes.numlinks = 1;
+	hdl->attributes.atime = ts;
+	hdl->attributes.ctime = ts;
+	hdl->attributes.mtime = ts;
+	hdl->attributes.chgtime = ts;
+	hdl->attributes.change = timespec_to_nsecs(&ts);
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Register the BENCH FSAL and build its export
+ *
+ * This must run while the FSAL manager still accepts registrations,
+ * that is before anything calls start_fsals().
+ */
+
+static int bench_fsal_init(void)
+{
+	int rc;
+
+	rc = register_fsal(&bench_module, "BENCH", FSAL_MAJOR_VERSION,
+			   FSAL_MINOR_VERSION, FSAL_ID_NO_PNFS);
+	if (rc != 0)
+		return rc;
+
+	fsal_export_init(&bench_module_export);
+	bench_module_export.fsal = &bench_module;
+	bench_module_export.exp_ops.create_handle = bench_create_handle;
+
+	bench_fsal = &bench_module;
+	bench_fsal_export = &bench_module_export;
+	return 0;
+}
+
+/**
+ * @brief Create the export all benchmark threads work in
+ */
+
+static int bench_export_init(void)
+{
+	struct gsh_export *export;
+
+	export = alloc_export();
+	if (export == NULL)
+		return ENOMEM;
+
+	export->export_id = 1;
+	export->fullpath = gsh_strdup("/bench");
+	export->pseudopath = gsh_strdup("/bench");
+	export->fsal_export = bench_fsal_export;
+	export->expire_time_attr = 60;
+
+	if (export->fullpath == NULL || export->pseudopath == NULL)
+		return ENOMEM;
+
+	if (!insert_gsh_export(export))
+		return EEXIST;
+
+	bench_export = export;
+
+	bench_main_ctx.creds = &bench_main_creds;
+	bench_main_ctx.export = bench_export;
+	bench_main_ctx.fsal_export = bench_fsal_export;
+	bench_main_ctx.fsal_module = bench_fsal;
+	op_ctx = &bench_main_ctx;
+	return 0;
+}
+
+/**
+ * @brief Initialize the server libraries
+ *
+ * This follows the daemon's startup: logging, configuration, the
+ * cache_inode and SAL packages, the LRU and the state id table.  The
+ * configuration is read from -f, or is empty.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+
+int bench_init_server(void)
+{
+	struct config_error_type err_type;
+	nfs_start_info_t start_info = { 0 };
+	config_file_t config;
+	char *path;
+	int rc;
+
+	nfs_prereq_init(exec_name, host_name, debug_level, log_path);
+
+	rc = bench_fsal_init();
+	if (rc != 0) {
+		fprintf(stderr, "Could not register the BENCH FSAL: %s\n",
+			strerror(rc));
+		return -1;
+	}
+
+	if (!init_error_type(&err_type))
+		return -1;
+
+	path = bench_opts.config_path != NULL ?
+	    bench_opts.config_path : "/dev/null";
+	config = config_ParseFile(path, &err_type);
+	if (config == NULL || !config_error_is_harmless(&err_type)) {
+		fprintf(stderr, "Could not parse %s\n", path);
+		return -1;
+	}
+
+	if (read_log_config(config, &err_type) < 0 ||
+	    nfs_set_param_from_conf(config, &start_info, &err_type) < 0) {
+		fprintf(stderr, "Error in configuration %s\n", path);
+		return -1;
+	}
+	config_Free(config);
+
+	if (bench_opts.entries_hwmark != 0)
+		cache_param.entries_hwmark = bench_opts.entries_hwmark;
+
+	if (init_server_pkgs() != 0)
+		return -1;
+
+	rc = cache_inode_lru_pkginit();
+	if (rc != 0) {
+		fprintf(stderr, "Could not start the LRU: %d\n", rc);
+		return -1;
+	}
+
+	if (nfs4_Init_state_id() != 0)
+		return -1;
+
+	rc = bench_export_init();
+	if (rc != 0) {
+		fprintf(stderr, "Could not create the export: %s\n",
+			strerror(rc));
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get a referenced cache entry for a BENCH handle
+ *
+ * @param[in] key The handle
+ *
+ * @return The entry, to be released with cache_inode_put, or NULL.
+ */
+
+cache_entry_t *bench_get_entry(uint64_t key)
+{
+	cache_inode_fsal_data_t fsdata;
+	cache_entry_t *entry;
+
+	fsdata.export = bench_fsal_export;
+	fsdata.fh_desc.addr = &key;
+	fsdata.fh_desc.len = sizeof(key);
+
+	if (cache_inode_get(&fsdata, &entry) != CACHE_INODE_SUCCESS)
+		return NULL;
+
+	return entry;
+}
+
+/*
+ * Memory store
+ *
+ * A read, write and commit for the BENCH FSAL that copy from and to
+ * memory after a fixed call_ns per call, like a backend with a round
+ * trip per I/O.
+ */
+
+struct bench_store bench_store;
+
+static void bench_store_call(void)
+{
+	struct timespec start, ts;
+
+	if (bench_store.sleep) {
+		ts.tv_sec = bench_store.call_ns / 1000000000;
+		ts.tv_nsec = bench_store.call_ns % 1000000000;
+		nanosleep(&ts, NULL);
+		return;
+	}
+
+	now(&start);
+	do {
+		now(&ts);
+	} while (timespec_diff(&start, &ts) < bench_store.call_ns);
+}
+
+static uint64_t bench_store_key(struct fsal_obj_handle *obj_hdl)
+{
+	struct bench_handle *hdl =
+	    container_of(obj_hdl, struct bench_handle, obj_handle);
+
+	return hdl->key;
+}
+
+static fsal_status_t bench_store_read(struct fsal_obj_handle *obj_hdl,
+				      uint64_t offset, size_t size,
+				      void *buffer, size_t *read, bool *eof)
+{
+	uint64_t key = bench_store_key(obj_hdl);
+	uint64_t fsize = atomic_fetch_uint64_t(&bench_store.size[key]);
+
+	bench_store_call();
+	(void)atomic_inc_uint64_t(&bench_store.reads);
+
+	if (offset >= fsize) {
+		*read = 0;
+		*eof = true;
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	}
+	if (size > fsize - offset)
+		size = fsize - offset;
+
+	memcpy(buffer, bench_store.data[key] + offset, size);
+	*read = size;
+	*eof = offset + size == fsize;
+
+	if (bench_store.read_cb != NULL)
+		bench_store.read_cb(key, offset, size);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t bench_store_write(struct fsal_obj_handle *obj_hdl,
+				       uint64_t offset, size_t size,
+				       void *buffer, size_t *wrote,
+				       bool *fsal_stable)
+{
+	uint64_t key = bench_store_key(obj_hdl);
+
+	bench_store_call();
+	(void)atomic_inc_uint64_t(&bench_store.writes);
+
+	if (offset >= bench_store.file_size)
+		return fsalstat(ERR_FSAL_FBIG, 0);
+	if (size > bench_store.file_size - offset)
+		size = bench_store.file_size - offset;
+
+	memcpy(bench_store.data[key] + offset, buffer, size);
+	if (offset + size > bench_store.size[key])
+		bench_store.size[key] = offset + size;
+	*wrote = size;
+	*fsal_stable = false;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t bench_store_commit(struct fsal_obj_handle *obj_hdl,
+					off_t offset, size_t len)
+{
+	bench_store_call();
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+static fsal_status_t bench_store_getattrs(struct fsal_obj_handle *obj_hdl)
+{
+	uint64_t key = bench_store_key(obj_hdl);
+
+	obj_hdl->attrs->filesize = bench_store.size[key];
+	obj_hdl->attrs->spaceused = bench_store.size[key];
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Get a referenced cache entry for a file of the memory store
+ *
+ * A file new to the store is bench_store.file_size bytes, zeroed, or
+ * filled with a pattern of its key if bench_store.fill is set.
+ *
+ * @param[in] key The file, below BENCH_STORE_FILES
+ *
+ * @return The entry, to be released with cache_inode_put, or NULL.
+ */
+
+cache_entry_t *bench_store_get_entry(uint64_t key)
+{
+	cache_entry_t *entry;
+	struct fsal_obj_ops *ops;
+	uint64_t fsize = bench_store.file_size;
+	uint32_t i;
+
+	if (key >= BENCH_STORE_FILES)
+		return NULL;
+
+	if (bench_store.data[key] == NULL) {
+		bench_store.data[key] = gsh_calloc(1, fsize);
+		if (bench_store.data[key] == NULL)
+			return NULL;
+		if (bench_store.fill)
+			for (i = 0; i < fsize / sizeof(i); i++)
+				((uint32_t *)bench_store.data[key])[i] =
+							key * fsize + i;
+		bench_store.size[key] = fsize;
+	}
+
+	entry = bench_get_entry(key);
+	if (entry == NULL)
+		return NULL;
+
+	ops = &entry->obj_handle->obj_ops;
+	ops->read = bench_store_read;
+	ops->write = bench_store_write;
+	ops->commit = bench_store_commit;
+	ops->getattrs = bench_store_getattrs;
+	entry->obj_handle->attrs->filesize = bench_store.size[key];
+	return entry;
+}
+
+/*
+ * Command line
+ */
+
+static void bench_usage(const char *prog, struct bench_case *cases,
+			int ncases)
+{
+	int i;
+
+	fprintf(stderr,
+		"Usage: %s [-t max_threads] [-T n,n,...] [-d seconds] [-w seconds]\n"
+		"\t[-n objects] [-e entries_hwmark] [-f config] [-c case,...] [-P]\n"
+		"\t[-C]\n"
+		"\t-t  Largest thread count, default the number of CPUs\n"
+		"\t-T  Thread counts to run, default 1, 2, 4 .. max_threads\n"
+		"\t-d  Measured time per thread count, default %.1f\n"
+		"\t-w  Warm up time per thread count, default %.1f\n"
+		"\t-n  Working set size, default %" PRIu32 "\n"
+		"\t-e  Cache entries high water mark, default from config\n"
+		"\t-f  Configuration file, default none\n"
+		"\t-c  Cases to run, default all\n"
+		"\t-P  Pin thread i to CPU i\n"
+		"\t-C  Only run the checks of the setups, for the test suite\n"
+		"Cases:\n",
+		prog, bench_opts.duration, bench_opts.warmup,
+		bench_opts.objects);
+
+	for (i = 0; i < ncases; i++)
+		fprintf(stderr, "\t%-12s %s\n", cases[i].name, cases[i].desc);
+}
+
+static int bench_parse_list(char *arg)
+{
+	char *tok, *save = NULL;
+	unsigned int n = 0, max = 0;
+
+	bench_opts.nthreads = gsh_calloc(strlen(arg) / 2 + 1,
+					 sizeof(unsigned int));
+
+	for (tok = strtok_r(arg, ",", &save); tok != NULL;
+	     tok = strtok_r(NULL, ",", &save)) {
+		int v = atoi(tok);
+
+		if (v <= 0)
+			return -1;
+		bench_opts.nthreads[n++] = v;
+		if (v > max)
+			max = v;
+	}
+	if (n == 0)
+		return -1;
+
+	bench_opts.npoints = n;
+	bench_opts.max_threads = max;
+	return 0;
+}
+
+/**
+ * @brief Parse the common options
+ *
+ * @return 0 on success, -1 after printing the usage.
+ */
+
+int bench_parse_args(int argc, char **argv, const char *prog,
+		     struct bench_case *cases, int ncases)
+{
+	unsigned int n;
+	int opt;
+
+	exec_name = (char *)prog;
+
+	while ((opt = getopt(argc, argv, "t:T:d:w:n:e:f:c:PCh")) != -1) {
+		switch (opt) {
+		case 't':
+			bench_opts.max_threads = atoi(optarg);
+			break;
+		case 'T':
+			if (bench_parse_list(optarg) != 0) {
+				fprintf(stderr, "Bad thread list\n");
+				return -1;
+			}
+			break;
+		case 'd':
+			bench_opts.duration = atof(optarg);
+			break;
+		case 'w':
+			bench_opts.warmup = atof(optarg);
+			break;
+		case 'n':
+			bench_opts.objects = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			bench_opts.entries_hwmark = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			bench_opts.config_path = optarg;
+			break;
+		case 'c':
+			bench_opts.cases = optarg;
+			break;
+		case 'P':
+			bench_opts.pin = true;
+			break;
+		case 'C':
+			bench_opts.checks_only = true;
+			break;
+		default:
+			bench_usage(prog, cases, ncases);
+			return -1;
+		}
+	}
+
+	if (optind != argc || bench_opts.duration <= 0 ||
+	    bench_opts.warmup < 0 || bench_opts.objects == 0) {
+		bench_usage(prog, cases, ncases);
+		return -1;
+	}
+
+	if (bench_opts.nthreads != NULL)
+		return 0;
+
+	if (bench_opts.max_threads == 0)
+		bench_opts.max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (bench_opts.max_threads == 0)
+		bench_opts.max_threads = 1;
+
+	/* 1, 2, 4 .. and max_threads itself */
+	bench_opts.nthreads = gsh_calloc(34, sizeof(unsigned int));
+	for (n = 1; n < bench_opts.max_threads; n *= 2)
+		bench_opts.nthreads[bench_opts.npoints++] = n;
+	bench_opts.nthreads[bench_opts.npoints++] = bench_opts.max_threads;
+
+	return 0;
+}
+
+/*
+ * Runner
+ */
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_sleep(double seconds)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)seconds;
+	ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+static uint64_t bench_sum_ops(struct bench_thread *threads,
+			      unsigned int nthreads)
+{
+	uint64_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < nthreads; i++)
+		sum += atomic_fetch_uint64_t(&threads[i].ops);
+	return sum;
+}
+
+struct bench_arg {
+	struct bench_case *bc;
+	struct bench_thread *bt;
+	pthread_barrier_t *barrier;
+};
+
+static void *bench_thread_main(void *arg)
+{
+	struct bench_arg *ba = arg;
+	struct bench_case *bc = ba->bc;
+	struct bench_thread *bt = ba->bt;
+	uint64_t ops = 0;
+	int i;
+
+	if (bench_opts.pin) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(bt->idx % CPU_SETSIZE, &cpus);
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(cpus),
+					     &cpus);
+	}
+
+	bt->req_ctx.creds = &bt->creds;
+	bt->req_ctx.export = bench_export;
+	bt->req_ctx.fsal_export = bench_fsal_export;
+	bt->req_ctx.fsal_module = bench_fsal;
+	bt->req_ctx.nfs_vers = 4;
+	bt->req_ctx.nfs_minorvers = 1;
+	op_ctx = &bt->req_ctx;
+
+	if (bc->thread_init != NULL)
+		bc->thread_init(bt);
+
+	pthread_barrier_wait(ba->barrier);
+
+	while (atomic_fetch_int32_t(&bench_running)) {
+		for (i = 0; i < BENCH_BATCH; i++)
+			bc->op(bt);
+		ops += BENCH_BATCH;
+		atomic_store_uint64_t(&bt->ops, ops);
+	}
+
+	if (bc->thread_fini != NULL)
+		bc->thread_fini(bt);
+
+	op_ctx = NULL;
+	return NULL;
+}
+
+/**
+ * @brief Run a case with a given number of threads
+ *
+ * @return Operations per second, or a negative value on failure.
+ */
+
+static double bench_run_point(struct bench_case *bc, unsigned int nthreads,
+			      uint64_t *errors)
+{
+	struct bench_thread *threads;
+	struct bench_arg *args;
+	pthread_barrier_t barrier;
+	uint64_t ops0, ops1;
+	double t0, t1;
+	unsigned int i, started;
+	double rate = -1;
+
+	*errors = 0;
+	threads = gsh_malloc_aligned(64, nthreads * sizeof(*threads));
+	args = gsh_calloc(nthreads, sizeof(*args));
+	if (threads == NULL || args == NULL)
+		goto out;
+	memset(threads, 0, nthreads * sizeof(*threads));
+
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	atomic_store_int32_t(&bench_running, 1);
+
+	for (started = 0; started < nthreads; started++) {
+		threads[started].idx = started;
+		threads[started].nthreads = nthreads;
+		threads[started].rand = (started + 1) * 0x9E3779B97F4A7C15ULL;
+		args[started].bc = bc;
+		args[started].bt = &threads[started];
+		args[started].barrier = &barrier;
+		if (pthread_create(&threads[started].thread, NULL,
+				   bench_thread_main, &args[started]) != 0) {
+			fprintf(stderr, "Could not create thread %u: %s\n",
+				started, strerror(errno));
+			LogFatal(COMPONENT_INIT, "Could not create threads");
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	bench_sleep(bench_opts.warmup);
+	ops0 = bench_sum_ops(threads, nthreads);
+	t0 = bench_now();
+	bench_sleep(bench_opts.duration);
+	ops1 = bench_sum_ops(threads, nthreads);
+	t1 = bench_now();
+
+	atomic_store_int32_t(&bench_running, 0);
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		*errors += threads[i].errors;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	rate = (ops1 - ops0) / (t1 - t0);
+
+ out:
+	gsh_free(args);
+	gsh_free(threads);
+	return rate;
+}
+
+static bool bench_selected(struct bench_case *bc)
+{
+	const char *p = bench_opts.cases;
+	size_t len = strlen(bc->name);
+
+	if (p == NULL)
+		return true;
+
+	while (p != NULL) {
+		if (strncmp(p, bc->name, len) == 0 &&
+		    (p[len] == ',' || p[len] == '\0'))
+			return true;
+		p = strchr(p, ',');
+		if (p != NULL)
+			p++;
+	}
+	return false;
+}
+
+/**
+ * @brief Run the selected cases and print their scaling curves
+ *
+ * For each thread count the table has the aggregate throughput, the
+ * time per operation seen by one thread, the speedup and efficiency
+ * relative to the per thread throughput of the first thread count, and
+ * the number of failed operations.  With -C only the setups, and the
+ * checks they make, are run.
+ *
+ * @return 0 on success, 1 if a case failed.
+ */
+
+int bench_run_cases(struct bench_case *cases, int ncases)
+{
+	unsigned int p;
+	int i, rc = 0;
+
+	for (i = 0; i < ncases; i++) {
+		struct bench_case *bc = &cases[i];
+		double base = 0;
+
+		if (!bench_selected(bc))
+			continue;
+
+		if (bc->setup != NULL && bc->setup() != 0) {
+			fprintf(stderr, "%s: setup failed\n", bc->name);
+			rc = 1;
+			continue;
+		}
+
+		if (bench_opts.checks_only) {
+			printf("%s: setup passed\n", bc->name);
+			if (bc->cleanup != NULL)
+				bc->cleanup();
+			continue;
+		}
+
+		printf("\n%s: %s\n", bc->name, bc->desc);
+		printf("%8s %14s %14s %9s %11s %10s\n",
+		       "threads", "ops/s", "ns/op/thread", "speedup",
+		       "efficiency", "errors");
+
+		for (p = 0; p < bench_opts.npoints; p++) {
+			unsigned int n = bench_opts.nthreads[p];
+			uint64_t errors;
+			double rate = bench_run_point(bc, n, &errors);
+
+			if (rate <= 0) {
+				printf("%8u %14s\n", n, "failed");
+				rc = 1;
+				continue;
+			}
+			if (base == 0)
+				base = rate / bench_opts.nthreads[p];
+
+			printf("%8u %14.0f %14.1f %9.2f %10.1f%% %10" PRIu64
+			       "\n", n, rate, n * 1e9 / rate, rate / base,
+			       100.0 * rate / (base * n), errors);
+			fflush(stdout);
+		}
+
+		if (bc->cleanup != NULL)
+			bc->cleanup();
+	}
+
+	return rc;
+}
@@ -0,0 +1,160 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_common.h
+ * @brief Harness for the in-process microbenchmarks
+ *
+ * A benchmark is a set of cases.  Each case is run from 1 up to the
+ * maximum number of threads and its throughput is reported for every
+ * thread count, which gives the scaling curve of the code path under
+ * test.
+ *
+ * The cache_inode and SAL benchmarks run against the real libraries
+ * initialized as the server does it, with a fake in-memory FSAL
+ * (FSAL "BENCH") underneath so that no file system cost is measured.
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "fsal.h"
+#include "cache_inode.h"
+#include "export_mgr.h"
+
+/**
+ * @brief State of one benchmark thread
+ *
+ * Each thread has its own operation context, so op_ctx is valid in
+ * the op callback.
+ */
+
+struct bench_thread {
+	pthread_t thread;
+	unsigned int idx;		/*< 0 .. nthreads - 1 */
+	unsigned int nthreads;		/*< Threads in this run */
+	uint64_t rand;			/*< xorshift state */
+	uint64_t ops;			/*< Published every BENCH_BATCH ops */
+	uint64_t errors;		/*< Failed operations, kept by the case */
+	struct req_op_context req_ctx;
+	struct user_cred creds;
+	void *private;			/*< For the case */
+} __attribute__ ((aligned(64)));
+
+/**
+ * @brief A benchmark case
+ */
+
+struct bench_case {
+	const char *name;
+	const char *desc;
+	/** Called once before the case runs, may be NULL */
+	int (*setup)(void);
+	/** Called in each thread before the run, may be NULL */
+	void (*thread_init)(struct bench_thread *bt);
+	/** One operation */
+	void (*op)(struct bench_thread *bt);
+	/** Called in each thread after the run, may be NULL */
+	void (*thread_fini)(struct bench_thread *bt);
+	/** Called once after the case ran, may be NULL */
+	void (*cleanup)(void);
+};
+
+/**
+ * @brief Options common to all benchmarks
+ */
+
+struct bench_options {
+	unsigned int max_threads;	/*< -t */
+	unsigned int *nthreads;		/*< -T, or 1, 2, 4 .. max_threads */
+	unsigned int npoints;
+	double duration;		/*< -d, seconds per point */
+	double warmup;			/*< -w, seconds before measuring */
+	uint32_t objects;		/*< -n, size of the working set */
+	uint32_t entries_hwmark;	/*< -e, 0 keeps the configured value */
+	char *config_path;		/*< -f */
+	char *cases;			/*< -c */
+	bool pin;			/*< -P */
+	bool checks_only;		/*< -C, setups without runs */
+};
+
+extern struct bench_options bench_opts;
+
+/** Files of the memory store */
+#define BENCH_STORE_FILES 1024
+
+/**
+ * @brief A backend in memory for files of the BENCH FSAL
+ *
+ * The benchmark sets the parameters before it gets a file from
+ * bench_store_get_entry.  Files can be cut short by setting their size
+ * and grow back to file_size with writes.
+ */
+
+struct bench_store {
+	uint64_t file_size;		/*< Of new files, and the most held */
+	uint64_t call_ns;		/*< Time every FSAL call takes */
+	bool sleep;			/*< Sleep through a call, not spin */
+	bool fill;			/*< New files have a pattern, not 0 */
+	/** Called after every read from the store, may be NULL */
+	void (*read_cb)(uint64_t key, uint64_t offset, size_t size);
+	char *data[BENCH_STORE_FILES];	/*< File contents, by key */
+	uint64_t size[BENCH_STORE_FILES]; /*< File sizes, by key */
+	uint64_t reads;			/*< FSAL reads */
+	uint64_t writes;		/*< FSAL writes */
+};
+
+extern struct bench_store bench_store;
+
+/** The fake FSAL, its export and the gsh_export over it */
+extern struct fsal_module *bench_fsal;
+extern struct fsal_export *bench_fsal_export;
+extern struct gsh_export *bench_export;
+
+/** Operation context of the main thread, for setup and cleanup */
+extern struct req_op_context bench_main_ctx;
+
+/**
+ * @brief Random number for the calling thread
+ */
+
+static inline uint64_t bench_rand(struct bench_thread *bt)
+{
+	uint64_t x = bt->rand;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	bt->rand = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+int bench_parse_args(int argc, char **argv, const char *prog,
+		     struct bench_case *cases, int ncases);
+int bench_init_server(void);
+cache_entry_t *bench_get_entry(uint64_t key);
+cache_entry_t *bench_store_get_entry(uint64_t key);
+int bench_run_cases(struct bench_case *cases, int ncases);
+
+#endif				/* BENCH_COMMON_H */
@@ -0,0 +1,210 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_delayed.c
+ * @brief Microbenchmarks of the delayed executor
+ *
+ * submit_cancel submits a task a lease period out and cancels it, the
+ * way a returned delegation cancels its revoke check.  submit_run
+ * submits tasks due within a few milliseconds that only count
+ * themselves, and reports how they were batched and stolen.  Setup of
+ * the first case checks that a task does not run early and that a
+ * cancelled one does not run at all.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "bench_common.h"
+#include "delayed_exec.h"
+
+#define CHECK_DELAY (20 * NS_PER_MSEC)
+
+static uint64_t ran;
+static uint64_t submitted;
+
+static struct timespec check_start;
+static nsecs_elapsed_t check_elapsed;
+
+static void count_task(void *arg)
+{
+	(void)atomic_inc_uint64_t(&ran);
+}
+
+static void check_task(void *arg)
+{
+	struct timespec ts;
+
+	now(&ts);
+	atomic_store_uint64_t(&check_elapsed,
+			      timespec_diff(&check_start, &ts));
+}
+
+static void never_task(void *arg)
+{
+	fprintf(stderr, "Cancelled task ran\n");
+	abort();
+}
+
+/**
+ * @brief Wait for all submitted tasks to run
+ */
+
+static int run_drain(void)
+{
+	int i;
+
+	for (i = 0; i < 10000; i++) {
+		if (atomic_fetch_uint64_t(&ran) ==
+		    atomic_fetch_uint64_t(&submitted))
+			return 0;
+		usleep(1000);
+	}
+
+	fprintf(stderr, "Tasks not run after 10s\n");
+	return -1;
+}
+
+/**
+ * @brief Check a delayed task is on time and a cancelled one is gone
+ */
+
+static int delayed_check(void)
+{
+	struct delayed_timer timer;
+	void *arg = NULL;
+	int i;
+
+	if (delayed_submit_timer(never_task, &timer, 100 * NS_PER_MSEC,
+				 &timer) != 0 ||
+	    !delayed_cancel(&timer, &arg) || arg != &timer) {
+		fprintf(stderr, "Could not cancel a task\n");
+		return -1;
+	}
+
+	if (delayed_cancel(&timer, NULL)) {
+		fprintf(stderr, "Cancelled a task twice\n");
+		return -1;
+	}
+
+	now(&check_start);
+	if (delayed_submit(check_task, NULL, CHECK_DELAY) != 0)
+		return -1;
+
+	for (i = 0; i < 1000; i++) {
+		if (atomic_fetch_uint64_t(&check_elapsed) != 0)
+			break;
+		usleep(1000);
+	}
+
+	if (check_elapsed < CHECK_DELAY) {
+		fprintf(stderr, "Task ran after %" PRIu64 " ns, not %" PRIu64
+			"\n", check_elapsed, CHECK_DELAY);
+		return -1;
+	}
+
+	fprintf(stderr, "A %" PRIu64 " ms task ran after %" PRIu64 " us\n",
+		CHECK_DELAY / NS_PER_MSEC, check_elapsed / NS_PER_USEC);
+	return 0;
+}
+
+static int cancel_setup(void)
+{
+	static bool checked;
+
+	if (!checked && delayed_check() != 0)
+		return -1;
+	checked = true;
+
+	return 0;
+}
+
+static void cancel_op(struct bench_thread *bt)
+{
+	struct delayed_timer timer;
+
+	if (delayed_submit_timer(never_task, NULL, 90 * NS_PER_SEC,
+				 &timer) != 0 ||
+	    !delayed_cancel(&timer, NULL))
+		bt->errors++;
+}
+
+static void run_op(struct bench_thread *bt)
+{
+	if (delayed_submit(count_task, NULL,
+			   bench_rand(bt) % (4 * NS_PER_MSEC)) != 0) {
+		bt->errors++;
+		return;
+	}
+
+	(void)atomic_inc_uint64_t(&submitted);
+}
+
+static void delayed_report(void)
+{
+	struct delayed_stats st;
+
+	(void)run_drain();
+	delayed_get_stats(&st);
+	fprintf(stderr,
+		"%" PRIu64 " run in %" PRIu64 " batches, %" PRIu64
+		" stolen, %" PRIu64 " cancelled, max queue depth %" PRIu64
+		"\n", st.run, st.batches, st.stolen, st.cancelled,
+		st.max_queued);
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "submit_cancel",
+		.desc = "Submit a task 90s out and cancel it",
+		.setup = cancel_setup,
+		.op = cancel_op,
+		.cleanup = delayed_report,
+	},
+	{
+		.name = "submit_run",
+		.desc = "Submit a task due within 4ms",
+		.op = run_op,
+		.cleanup = delayed_report,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_delayed", cases, ncases) != 0)
+		return 1;
+
+	/* For Delayed_Exec_Threads */
+	if (bench_init_server() != 0)
+		return 1;
+
+	delayed_start();
+
+	return bench_run_cases(cases, ncases);
+}
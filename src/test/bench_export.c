@@ -0,0 +1,222 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_export.c
+ * @brief Microbenchmarks of export lookup by path
+ *
+ * Setup adds as many exports as the working set, export i with full
+ * path /export/tenant<i>/vol and pseudo path /tenants/<i>, like a
+ * multi-tenant server, and checks prefix, exact and removed lookups.
+ *
+ * - by_path looks up a path three components below an export, as
+ *   MOUNT of a subdirectory does.
+ * - by_pseudo looks up a pseudo path exactly, as the pseudo FS does.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "abstract_mem.h"
+#include "export_mgr.h"
+#include "bench_common.h"
+
+#define FIRST_ID 2
+#define MAX_EXPORTS 60000
+
+static uint32_t nexports;
+static char **mount_paths;
+static char **pseudo_paths;
+
+static struct gsh_export *add_export(uint32_t i)
+{
+	struct gsh_export *export = alloc_export();
+	char path[64];
+
+	if (export == NULL)
+		return NULL;
+
+	export->export_id = FIRST_ID + i;
+	snprintf(path, sizeof(path), "/export/tenant%05u/vol", i);
+	export->fullpath = gsh_strdup(path);
+	snprintf(path, sizeof(path), "/tenants/%05u", i);
+	export->pseudopath = gsh_strdup(path);
+	export->fsal_export = bench_fsal_export;
+
+	if (export->fullpath == NULL || export->pseudopath == NULL ||
+	    !insert_gsh_export(export)) {
+		free_export(export);
+		return NULL;
+	}
+
+	return export;
+}
+
+/**
+ * @brief Check a lookup finds the expected export, or none
+ */
+
+static int check_one(bool pseudo, char *path, bool exact, int expected)
+{
+	struct gsh_export *export;
+	int found;
+
+	export = pseudo ? get_gsh_export_by_pseudo(path, exact)
+			: get_gsh_export_by_path(path, exact);
+	found = export != NULL ? export->export_id : -1;
+	if (export != NULL)
+		put_gsh_export(export);
+
+	if (found == expected)
+		return 0;
+
+	fprintf(stderr, "%s %s%s found %d, not %d\n",
+		pseudo ? "Pseudo" : "Path", path, exact ? " exactly" : "",
+		found, expected);
+	return -1;
+}
+
+static int check_lookups(void)
+{
+	char path[128];
+	uint32_t i = nexports / 2;
+	int id = FIRST_ID + i;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), "/export/tenant%05u/vol", i);
+	rc |= check_one(false, path, true, id);
+	strcat(path, "/");
+	rc |= check_one(false, path, true, id);
+	strcat(path, "a/b");
+	rc |= check_one(false, path, false, id);
+	rc |= check_one(false, path, true, -1);
+	snprintf(path, sizeof(path), "/export/tenant%05u/vo", i);
+	rc |= check_one(false, path, false, -1);
+	snprintf(path, sizeof(path), "/export/tenant%05u/volume", i);
+	rc |= check_one(false, path, false, -1);
+	rc |= check_one(false, "/export", false, -1);
+	rc |= check_one(false, "/bench/x", false, 1);
+	snprintf(path, sizeof(path), "/tenants/%05u", i);
+	rc |= check_one(true, path, true, id);
+
+	/* Gone from both tries once removed */
+	remove_gsh_export(id);
+	rc |= check_one(true, path, true, -1);
+	snprintf(path, sizeof(path), "/export/tenant%05u/vol/a", i);
+	rc |= check_one(false, path, false, -1);
+	if (add_export(i) == NULL)
+		return -1;
+	rc |= check_one(false, path, false, id);
+
+	return rc != 0 ? -1 : 0;
+}
+
+static int exports_setup(void)
+{
+	char path[128];
+	uint32_t i;
+
+	if (mount_paths != NULL)
+		return 0;
+
+	nexports = bench_opts.objects;
+	if (nexports > MAX_EXPORTS)
+		nexports = MAX_EXPORTS;
+
+	mount_paths = gsh_calloc(nexports, sizeof(*mount_paths));
+	pseudo_paths = gsh_calloc(nexports, sizeof(*pseudo_paths));
+	if (mount_paths == NULL || pseudo_paths == NULL)
+		return -1;
+
+	for (i = 0; i < nexports; i++) {
+		if (add_export(i) == NULL) {
+			fprintf(stderr, "Could not add export %u\n", i);
+			return -1;
+		}
+		snprintf(path, sizeof(path),
+			 "/export/tenant%05u/vol/home/user/data", i);
+		mount_paths[i] = gsh_strdup(path);
+		snprintf(path, sizeof(path), "/tenants/%05u", i);
+		pseudo_paths[i] = gsh_strdup(path);
+		if (mount_paths[i] == NULL || pseudo_paths[i] == NULL)
+			return -1;
+	}
+
+	if (check_lookups() != 0)
+		return -1;
+
+	fprintf(stderr, "%u exports, lookups checked\n", nexports);
+	return 0;
+}
+
+static void lookup(struct bench_thread *bt, bool pseudo)
+{
+	uint32_t i = bench_rand(bt) % nexports;
+	struct gsh_export *export;
+
+	export = pseudo ? get_gsh_export_by_pseudo(pseudo_paths[i], true)
+			: get_gsh_export_by_path(mount_paths[i], false);
+	if (export == NULL || export->export_id != FIRST_ID + i) {
+		bt->errors++;
+		if (export == NULL)
+			return;
+	}
+	put_gsh_export(export);
+}
+
+static void by_path_op(struct bench_thread *bt)
+{
+	lookup(bt, false);
+}
+
+static void by_pseudo_op(struct bench_thread *bt)
+{
+	lookup(bt, true);
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "by_path",
+		.desc = "get_gsh_export_by_path of a path below an export",
+		.setup = exports_setup,
+		.op = by_path_op,
+	},
+	{
+		.name = "by_pseudo",
+		.desc = "get_gsh_export_by_pseudo of an export's pseudo path",
+		.setup = exports_setup,
+		.op = by_pseudo_op,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_export", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
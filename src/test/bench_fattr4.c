@@ -0,0 +1,227 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_fattr4.c
+ * @brief Microbenchmarks of NFSv4 attribute encoding
+ *
+ * One operation encodes the attributes of every entry of a directory
+ * of -n entries (10000 by default) with the bitmap of a Linux client
+ * READDIRPLUS, as nfs4_op_readdir does for each entry it returns.
+ * fattr4_table encodes them through fattr4tab one attribute at a time,
+ * fattr4_fast with the precompiled encoder.  Setup checks both give the
+ * same bytes.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "nfs_core.h"
+#include "nfs_fh.h"
+#include "nfs_proto_tools.h"
+#include "bench_common.h"
+
+static struct attrlist *entries;
+static struct bitmap4 readdirplus_bitmap;
+
+/** The handle of an entry, as nfs4_FSALToFhandle builds it */
+struct bench_fh {
+	file_handle_v4_t fh;
+	uint64_t key;
+} __attribute__ ((__packed__));
+
+static void bench_make_fh(struct bench_fh *bfh, nfs_fh4 *fh4, uint32_t i)
+{
+	memset(bfh, 0, sizeof(*bfh));
+	bfh->fh.fhversion = GANESHA_FH_VERSION;
+	bfh->fh.id.exports = 1;
+	bfh->fh.fs_len = sizeof(bfh->key);
+	bfh->key = i;
+	fh4->nfs_fh4_val = (char *)bfh;
+	fh4->nfs_fh4_len = sizeof(*bfh);
+}
+
+static int bench_encode(uint32_t i, fattr4 *fattr)
+{
+	struct bench_fh bfh;
+	nfs_fh4 fh4;
+	struct xdr_attrs_args args;
+
+	/* encode_filehandle swaps the export id in place */
+	bench_make_fh(&bfh, &fh4, i);
+
+	memset(&args, 0, sizeof(args));
+	args.attrs = &entries[i];
+	args.hdl4 = &fh4;
+	args.mounted_on_fileid = entries[i].fileid;
+
+	return nfs4_FSALattr_To_Fattr(&args, &readdirplus_bitmap, fattr);
+}
+
+/**
+ * @brief Build the directory and check both encoders agree on it
+ */
+
+static int entries_setup(void)
+{
+	fattr4 table, fast;
+	struct timespec ts;
+	uint32_t i;
+	int rc = 0;
+
+	if (entries != NULL)
+		return 0;
+
+	entries = gsh_calloc(bench_opts.objects, sizeof(*entries));
+	if (entries == NULL)
+		return -1;
+
+	now(&ts);
+	for (i = 0; i < bench_opts.objects; i++) {
+		struct attrlist *attrs = &entries[i];
+
+		attrs->type = (i % 8) == 0 ? DIRECTORY : REGULAR_FILE;
+		attrs->filesize = (uint64_t) i * 4096;
+		attrs->spaceused = attrs->filesize;
+		attrs->fsid.major = 0x5eed;
+		attrs->fsid.minor = 1;
+		attrs->fileid = 1000 + i;
+		attrs->mode = attrs->type == DIRECTORY ? 0755 : 0644;
+		attrs->numlinks = attrs->type == DIRECTORY ? 2 : 1;
+		attrs->owner = 0;
+		attrs->group = 0;
+		attrs->atime = ts;
+		attrs->mtime = ts;
+		attrs->ctime = ts;
+		attrs->chgtime = ts;
+		attrs->change = timespec_to_nsecs(&ts) + i;
+	}
+
+	/* What the Linux client asks for in READDIRPLUS */
+	memset(&readdirplus_bitmap, 0, sizeof(readdirplus_bitmap));
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_TYPE);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_CHANGE);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_SIZE);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_FSID);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_RDATTR_ERROR);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_FILEHANDLE);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_FILEID);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_MODE);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_NUMLINKS);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_OWNER);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_OWNER_GROUP);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_RAWDEV);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_SPACE_USED);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_TIME_ACCESS);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_TIME_METADATA);
+	set_attribute_in_bitmap(&readdirplus_bitmap, FATTR4_TIME_MODIFY);
+	set_attribute_in_bitmap(&readdirplus_bitmap,
+				FATTR4_MOUNTED_ON_FILEID);
+
+	for (i = 0; i < bench_opts.objects && rc == 0; i++) {
+		nfs_param.nfsv4_param.fast_fattr_encode = false;
+		if (bench_encode(i, &table) != 0)
+			return -1;
+		nfs_param.nfsv4_param.fast_fattr_encode = true;
+		if (bench_encode(i, &fast) != 0) {
+			nfs4_Fattr_Free(&table);
+			return -1;
+		}
+
+		if (memcmp(&table.attrmask, &fast.attrmask,
+			   sizeof(table.attrmask)) != 0 ||
+		    table.attr_vals.attrlist4_len !=
+		    fast.attr_vals.attrlist4_len ||
+		    memcmp(table.attr_vals.attrlist4_val,
+			   fast.attr_vals.attrlist4_val,
+			   table.attr_vals.attrlist4_len) != 0) {
+			fprintf(stderr,
+				"Encoders disagree on entry %"PRIu32"\n", i);
+			rc = -1;
+		}
+
+		nfs4_Fattr_Free(&table);
+		nfs4_Fattr_Free(&fast);
+	}
+
+	return rc;
+}
+
+static int table_setup(void)
+{
+	if (entries_setup() != 0)
+		return -1;
+	nfs_param.nfsv4_param.fast_fattr_encode = false;
+	return 0;
+}
+
+static int fast_setup(void)
+{
+	if (entries_setup() != 0)
+		return -1;
+	nfs_param.nfsv4_param.fast_fattr_encode = true;
+	return 0;
+}
+
+static void readdir_op(struct bench_thread *bt)
+{
+	fattr4 fattr;
+	uint32_t i;
+
+	for (i = 0; i < bench_opts.objects; i++) {
+		if (bench_encode(i, &fattr) != 0) {
+			bt->errors++;
+			continue;
+		}
+		nfs4_Fattr_Free(&fattr);
+	}
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "fattr4_table",
+		.desc = "READDIRPLUS attributes of -n entries, fattr4tab",
+		.setup = table_setup,
+		.op = readdir_op,
+	},
+	{
+		.name = "fattr4_fast",
+		.desc = "READDIRPLUS attributes of -n entries, precompiled",
+		.setup = fast_setup,
+		.op = readdir_op,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_fattr4", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
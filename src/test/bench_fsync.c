@@ -0,0 +1,299 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_fsync.c
+ * @brief Microbenchmarks of group commit
+ *
+ * One operation is a 4KiB FILE_SYNC write as FSAL_VFS makes it: a
+ * pwrite followed by a sync, every thread writing its own part of one
+ * file.  write_fsync syncs with fsync as each write did before,
+ * write_group through an fsal_sync_group.  The file is created in
+ * $BENCH_FSYNC_DIR, or the current directory, which should be on the
+ * storage to be measured rather than on a tmpfs.  Setup of write_group
+ * checks that concurrent callers of a group all get their syncs, and
+ * all get the error of one that failed, but later callers do not.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "bench_common.h"
+#include "FSAL/fsal_commonlib.h"
+
+#define IO_SIZE 4096
+#define THREAD_SPAN (64 * IO_SIZE)
+#define CHECK_THREADS 8
+#define CHECK_SYNCS 64
+
+static int fd = -1;
+static struct fsal_sync_group sync_group;
+static bool grouped;
+static uint64_t requests, syncs;
+
+static int file_setup(void)
+{
+	const char *dir = getenv("BENCH_FSYNC_DIR");
+	char path[1024];
+
+	if (fd < 0) {
+		snprintf(path, sizeof(path), "%s/bench_fsync.XXXXXX",
+			 dir != NULL ? dir : ".");
+		fd = mkstemp(path);
+		if (fd < 0) {
+			fprintf(stderr, "Could not create %s: %s\n", path,
+				strerror(errno));
+			return -1;
+		}
+		unlink(path);
+		fsal_sync_group_init(&sync_group);
+	}
+
+	requests = atomic_fetch_uint64_t(&fsal_sync_stats.requests);
+	syncs = atomic_fetch_uint64_t(&fsal_sync_stats.syncs);
+	return 0;
+}
+
+struct checker {
+	pthread_t thread;
+	struct fsal_sync_group *sg;
+	int fd;
+	int errors;		/*< Syncs that did not return expect */
+	int expect;
+};
+
+static void *checker_main(void *arg)
+{
+	struct checker *c = arg;
+	int i;
+
+	for (i = 0; i < CHECK_SYNCS; i++)
+		if (fsal_sync_group_sync(c->sg, c->fd, 0, 0) != c->expect)
+			c->errors++;
+	return NULL;
+}
+
+/**
+ * @brief Sync from CHECK_THREADS threads at once
+ *
+ * @return The syncs that did not return expect, -1 if threads could
+ *         not be started.
+ */
+
+static int group_run(struct fsal_sync_group *sg, int sync_fd, int expect)
+{
+	struct checker c[CHECK_THREADS];
+	int i, n, errors = 0;
+
+	for (n = 0; n < CHECK_THREADS; n++) {
+		c[n].sg = sg;
+		c[n].fd = sync_fd;
+		c[n].errors = 0;
+		c[n].expect = expect;
+		if (pthread_create(&c[n].thread, NULL, checker_main,
+				   &c[n]) != 0)
+			break;
+	}
+	for (i = 0; i < n; i++) {
+		pthread_join(c[i].thread, NULL);
+		errors += c[i].errors;
+	}
+	return n == CHECK_THREADS ? errors : -1;
+}
+
+/**
+ * @brief Check the results concurrent callers of a group get
+ */
+
+static int group_check(void)
+{
+	struct fsal_sync_group sg;
+	uint64_t req, done;
+	int errors, rc = -1;
+
+	fsal_sync_group_init(&sg);
+
+	req = atomic_fetch_uint64_t(&fsal_sync_stats.requests);
+	done = atomic_fetch_uint64_t(&fsal_sync_stats.syncs);
+	errors = group_run(&sg, fd, 0);
+	req = atomic_fetch_uint64_t(&fsal_sync_stats.requests) - req;
+	done = atomic_fetch_uint64_t(&fsal_sync_stats.syncs) - done;
+	if (errors != 0 || req != CHECK_THREADS * CHECK_SYNCS ||
+	    done == 0 || done > req) {
+		fprintf(stderr,
+			"%d syncs failed, %" PRIu64 " requests, %" PRIu64
+			" syncs\n", errors, req, done);
+		goto out;
+	}
+
+	/* Every caller is told of the failure of the sync covering it */
+	errors = group_run(&sg, -1, EBADF);
+	if (errors != 0) {
+		fprintf(stderr, "%d syncs of a bad fd did not fail\n",
+			errors);
+		goto out;
+	}
+
+	/* but callers coming after it are not */
+	if (fsal_sync_group_sync(&sg, fd, 0, 0) != 0) {
+		fprintf(stderr, "A sync failed after an earlier failure\n");
+		goto out;
+	}
+
+	fprintf(stderr, "Checked %d grouped syncs, %" PRIu64 " made\n",
+		CHECK_THREADS * CHECK_SYNCS, done);
+	rc = 0;
+
+ out:
+	fsal_sync_group_destroy(&sg);
+	return rc;
+}
+
+static int fsync_setup(void)
+{
+	grouped = false;
+	return file_setup();
+}
+
+static int group_setup(void)
+{
+	static bool checked;
+
+	grouped = true;
+	if (file_setup() != 0)
+		return -1;
+
+	if (!checked && group_check() != 0)
+		return -1;
+	checked = true;
+
+	/* The stats the run is reported with start after the check */
+	return file_setup();
+}
+
+struct writer {
+	uint64_t offset;
+	char buf[IO_SIZE];
+};
+
+static void writer_init(struct bench_thread *bt)
+{
+	struct writer *w = gsh_calloc(1, sizeof(*w));
+
+	if (w == NULL)
+		return;
+
+	memset(w->buf, bt->idx, sizeof(w->buf));
+	bt->private = w;
+}
+
+static void write_op(struct bench_thread *bt)
+{
+	struct writer *w = bt->private;
+	uint64_t offset;
+	int rc;
+
+	if (w == NULL) {
+		bt->errors++;
+		return;
+	}
+
+	offset = (uint64_t) bt->idx * THREAD_SPAN + w->offset;
+	if (pwrite(fd, w->buf, IO_SIZE, offset) != IO_SIZE) {
+		bt->errors++;
+		return;
+	}
+
+	if (grouped)
+		rc = fsal_sync_group_sync(&sync_group, fd, offset, IO_SIZE);
+	else
+		rc = fsync(fd);
+	if (rc != 0)
+		bt->errors++;
+
+	w->offset = (w->offset + IO_SIZE) % THREAD_SPAN;
+}
+
+static void writer_fini(struct bench_thread *bt)
+{
+	gsh_free(bt->private);
+	bt->private = NULL;
+}
+
+static void syncs_report(void)
+{
+	if (!grouped)
+		return;
+
+	fprintf(stderr, "%" PRIu64 " sync requests, %" PRIu64 " syncs\n",
+		atomic_fetch_uint64_t(&fsal_sync_stats.requests) - requests,
+		atomic_fetch_uint64_t(&fsal_sync_stats.syncs) - syncs);
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "write_fsync",
+		.desc = "4KiB FILE_SYNC writes to one file, fsync each",
+		.setup = fsync_setup,
+		.thread_init = writer_init,
+		.op = write_op,
+		.thread_fini = writer_fini,
+		.cleanup = syncs_report,
+	},
+	{
+		.name = "write_group",
+		.desc = "4KiB FILE_SYNC writes to one file, group commit",
+		.setup = group_setup,
+		.thread_init = writer_init,
+		.op = write_op,
+		.thread_fini = writer_fini,
+		.cleanup = syncs_report,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+	int rc;
+
+	if (bench_parse_args(argc, argv, "bench_fsync", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	rc = bench_run_cases(cases, ncases);
+
+	if (fd >= 0) {
+		close(fd);
+		fsal_sync_group_destroy(&sync_group);
+	}
+
+	return rc;
+}
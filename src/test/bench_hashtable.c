@@ -0,0 +1,215 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_hashtable.c
+ * @brief Microbenchmarks of the generic hash table
+ *
+ * The tables have 8 byte keys hashed with CityHash64 and as many
+ * partitions as the state id table.  ht_get and ht_get_cached look up
+ * the working set in a table without and with the per partition cache,
+ * ht_set_del inserts and removes a key of the thread's own.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "hashtable.h"
+#include "city.h"
+#include "sal_functions.h"
+#include "bench_common.h"
+
+static struct hash_table *ht_plain;
+static struct hash_table *ht_cached;
+static uint64_t *keys;
+
+static int bench_hash_both(struct hash_param *hparam,
+			   struct gsh_buffdesc *key, uint32_t *index,
+			   uint64_t *rbthash)
+{
+	uint64_t h = CityHash64(key->addr, key->len);
+
+	if (index != NULL)
+		*index = h % hparam->index_size;
+	if (rbthash != NULL)
+		*rbthash = h;
+	return 1;
+}
+
+static int bench_compare_key(struct gsh_buffdesc *key1,
+			     struct gsh_buffdesc *key2)
+{
+	return *(uint64_t *) key1->addr != *(uint64_t *) key2->addr;
+}
+
+static int bench_display_key(struct gsh_buffdesc *key, char *str)
+{
+	return sprintf(str, "%" PRIx64, *(uint64_t *) key->addr);
+}
+
+static struct hash_table *bench_table(uint32_t flags, char *name)
+{
+	struct hash_param param = {
+		.flags = flags,
+		.index_size = PRIME_STATE,
+		.hash_func_both = bench_hash_both,
+		.compare_key = bench_compare_key,
+		.key_to_str = bench_display_key,
+		.val_to_str = bench_display_key,
+		.ht_name = name,
+		.ht_log_component = COMPONENT_HASHTABLE,
+	};
+
+	return hashtable_init(&param);
+}
+
+/**
+ * @brief Build both tables, holding the same working set
+ */
+
+static int tables_setup(void)
+{
+	struct gsh_buffdesc key, val;
+	uint32_t i;
+
+	if (keys != NULL)
+		return 0;
+
+	ht_plain = bench_table(HT_FLAG_NONE, "Bench Plain");
+	ht_cached = bench_table(HT_FLAG_CACHE, "Bench Cached");
+	keys = gsh_calloc(bench_opts.objects, sizeof(*keys));
+	if (ht_plain == NULL || ht_cached == NULL || keys == NULL)
+		return -1;
+
+	for (i = 0; i < bench_opts.objects; i++) {
+		keys[i] = CityHash64((char *)&i, sizeof(i));
+		key.addr = &keys[i];
+		key.len = sizeof(keys[i]);
+		val = key;
+
+		if (hashtable_test_and_set(ht_plain, &key, &val,
+				HASHTABLE_SET_HOW_SET_NO_OVERWRITE)
+		    != HASHTABLE_SUCCESS ||
+		    hashtable_test_and_set(ht_cached, &key, &val,
+				HASHTABLE_SET_HOW_SET_NO_OVERWRITE)
+		    != HASHTABLE_SUCCESS)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void get_op(struct bench_thread *bt, struct hash_table *ht)
+{
+	struct gsh_buffdesc key, val;
+
+	key.addr = &keys[bench_rand(bt) % bench_opts.objects];
+	key.len = sizeof(uint64_t);
+
+	if (HashTable_Get(ht, &key, &val) != HASHTABLE_SUCCESS ||
+	    val.addr != key.addr)
+		bt->errors++;
+}
+
+static void ht_get_op(struct bench_thread *bt)
+{
+	get_op(bt, ht_plain);
+}
+
+static void ht_get_cached_op(struct bench_thread *bt)
+{
+	get_op(bt, ht_cached);
+}
+
+static void set_del_init(struct bench_thread *bt)
+{
+	/* The table keeps pointers to keys, they must outlive the entry */
+	bt->private = gsh_calloc(1, sizeof(uint64_t));
+}
+
+static void ht_set_del_op(struct bench_thread *bt)
+{
+	struct gsh_buffdesc key, val;
+	uint64_t *k = bt->private;
+
+	if (k == NULL) {
+		bt->errors++;
+		return;
+	}
+
+	/* Never collides with the working set, nor with other threads */
+	*k = ((uint64_t) (bt->idx + 1) << 48) | (bench_rand(bt) >> 16);
+	key.addr = k;
+	key.len = sizeof(*k);
+	val = key;
+
+	if (HashTable_Set(ht_plain, &key, &val) != HASHTABLE_SUCCESS) {
+		bt->errors++;
+		return;
+	}
+	if (HashTable_Del(ht_plain, &key, NULL, NULL) != HASHTABLE_SUCCESS)
+		bt->errors++;
+}
+
+static void set_del_fini(struct bench_thread *bt)
+{
+	gsh_free(bt->private);
+	bt->private = NULL;
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "ht_get",
+		.desc = "HashTable_Get, no cache",
+		.setup = tables_setup,
+		.op = ht_get_op,
+	},
+	{
+		.name = "ht_get_cached",
+		.desc = "HashTable_Get, HT_FLAG_CACHE",
+		.setup = tables_setup,
+		.op = ht_get_cached_op,
+	},
+	{
+		.name = "ht_set_del",
+		.desc = "HashTable_Set and HashTable_Del, no cache",
+		.setup = tables_setup,
+		.thread_init = set_del_init,
+		.op = ht_set_del_op,
+		.thread_fini = set_del_fini,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_hashtable", cases,
+			     ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,330 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_readahead.c
+ * @brief Microbenchmarks of sequential read-ahead
+ *
+ * One operation is a 64KiB cache_inode_rdwr read, each thread reading
+ * its own file sequentially, from the memory store of the harness
+ * with calls of BACKEND_CALL_NS.  read_direct runs with Read_Ahead
+ * off, read_ahead with it on.  Setup reads a file sequentially with
+ * read-ahead on while writing and truncating parts of it, and checks
+ * every read against the store.  It then reads another slowly enough
+ * for read-ahead to keep up, and checks that no byte of it was read
+ * from the FSAL twice.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "nfs_core.h"
+#include "bench_common.h"
+
+#define IO_SIZE (64 * 1024)
+#define FILE_SIZE (16 * 1024 * 1024)
+#define BACKEND_CALL_NS 200000
+#define KEY_CHECK 0
+#define KEY_ONCE (BENCH_STORE_FILES - 1)
+#define ONCE_SIZE (2 * 1024 * 1024)
+
+/** Bytes of the first ONCE_SIZE of KEY_ONCE read from the FSAL */
+static uint64_t once_bytes;
+
+static void once_read(uint64_t key, uint64_t offset, size_t size)
+{
+	if (key == KEY_ONCE && offset < ONCE_SIZE)
+		(void)atomic_add_uint64_t(&once_bytes,
+					  MIN(size, ONCE_SIZE - offset));
+}
+
+static int file_read(cache_entry_t *entry, uint64_t offset, size_t size,
+		     void *buffer, size_t *moved)
+{
+	bool eof = false, sync = false;
+
+	*moved = 0;
+	if (cache_inode_rdwr(entry, CACHE_INODE_READ, offset, size, moved,
+			     buffer, &eof, &sync, NULL) != CACHE_INODE_SUCCESS)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Check reads with read-ahead against the store
+ */
+
+static int readahead_check(void)
+{
+	cache_entry_t *entry;
+	char *buf, *chunk;
+	uint64_t offset, expect, hits;
+	size_t moved, size;
+	uint32_t i, seed = 1;
+	bool sync;
+	int rc = -1;
+
+	cache_param.read_ahead.enabled = true;
+
+	entry = bench_store_get_entry(KEY_CHECK);
+	buf = gsh_malloc(IO_SIZE);
+	chunk = gsh_malloc(IO_SIZE);
+	if (entry == NULL || buf == NULL || chunk == NULL)
+		goto out;
+
+	hits = atomic_fetch_uint64_t(&cache_ra_st.hits);
+
+	for (i = 0, offset = 0; i < 4096; i++) {
+		size = 1 + (seed = seed * 1103515245 + 12345) % IO_SIZE;
+
+		switch (i % 64) {
+		case 17:
+			/* Write a little ahead of the reader */
+			memset(chunk, i, size);
+			moved = 0;
+			sync = false;
+			if (cache_inode_rdwr(entry, CACHE_INODE_WRITE,
+					     offset + IO_SIZE * 2, size,
+					     &moved, chunk, NULL, &sync,
+					     NULL) != CACHE_INODE_SUCCESS) {
+				fprintf(stderr, "Write %"PRIu32" failed\n", i);
+				goto out;
+			}
+			break;
+		case 41:
+			/* Cut short behind our back, as an upcall tells */
+			bench_store.size[KEY_CHECK] = offset + IO_SIZE * 3;
+			cache_inode_invalidate(entry,
+					       CACHE_INODE_INVALIDATE_CONTENT);
+			entry->obj_handle->attrs->filesize =
+						bench_store.size[KEY_CHECK];
+			break;
+		case 63:
+			/* Grow it back and go somewhere else */
+			bench_store.size[KEY_CHECK] = FILE_SIZE;
+			cache_inode_invalidate(entry,
+					       CACHE_INODE_INVALIDATE_CONTENT);
+			entry->obj_handle->attrs->filesize = FILE_SIZE;
+			offset = (seed >> 4) % (FILE_SIZE - IO_SIZE * 64);
+			break;
+		default:
+			break;
+		}
+
+		if (file_read(entry, offset, size, buf, &moved) != 0) {
+			fprintf(stderr, "Read %"PRIu32" failed\n", i);
+			goto out;
+		}
+
+		expect = offset >= bench_store.size[KEY_CHECK] ? 0
+			 : MIN(size, bench_store.size[KEY_CHECK] - offset);
+		if (moved != expect ||
+		    memcmp(buf, bench_store.data[KEY_CHECK] + offset,
+			   moved) != 0) {
+			fprintf(stderr,
+				"Read %"PRIu32" at %"PRIu64" differs\n",
+				i, offset);
+			goto out;
+		}
+
+		offset += moved;
+		if (offset + IO_SIZE * 4 >= FILE_SIZE)
+			offset = 0;
+	}
+
+	fprintf(stderr, "Checked 4096 reads, %" PRIu64 " from read-ahead\n",
+		atomic_fetch_uint64_t(&cache_ra_st.hits) - hits);
+	rc = 0;
+
+ out:
+	if (entry != NULL)
+		cache_inode_put(entry);
+	gsh_free(buf);
+	gsh_free(chunk);
+	return rc;
+}
+
+/**
+ * @brief Check a sequential reader gets each byte from the FSAL once
+ *
+ * Each read waits for the read-ahead it started, so every miss is one
+ * that read-ahead could not have served.
+ */
+
+static int readahead_once_check(void)
+{
+	cache_entry_t *entry;
+	char *buf;
+	uint64_t offset;
+	size_t moved;
+	int rc = -1;
+
+	entry = bench_store_get_entry(KEY_ONCE);
+	buf = gsh_malloc(IO_SIZE);
+	if (entry == NULL || buf == NULL)
+		goto out;
+
+	for (offset = 0; offset < ONCE_SIZE; offset += IO_SIZE) {
+		if (file_read(entry, offset, IO_SIZE, buf, &moved) != 0 ||
+		    moved != IO_SIZE) {
+			fprintf(stderr, "Read at %"PRIu64" failed\n", offset);
+			goto out;
+		}
+		usleep(10000);
+	}
+
+	if (atomic_fetch_uint64_t(&once_bytes) != ONCE_SIZE) {
+		fprintf(stderr,
+			"Read %"PRIu64" bytes from the FSAL for %d\n",
+			atomic_fetch_uint64_t(&once_bytes), ONCE_SIZE);
+		goto out;
+	}
+	rc = 0;
+
+ out:
+	if (entry != NULL)
+		cache_inode_put(entry);
+	gsh_free(buf);
+	return rc;
+}
+
+static int direct_setup(void)
+{
+	cache_param.read_ahead.enabled = false;
+	bench_store.reads = 0;
+	return 0;
+}
+
+static int readahead_setup(void)
+{
+	static bool checked;
+
+	cache_param.read_ahead.enabled = true;
+	if (cache_inode_readahead_pkginit() != 0)
+		return -1;
+
+	if (!checked &&
+	    (readahead_check() != 0 || readahead_once_check() != 0))
+		return -1;
+	checked = true;
+
+	bench_store.reads = 0;
+	return 0;
+}
+
+struct reader {
+	cache_entry_t *entry;
+	uint64_t offset;
+	char buf[IO_SIZE];
+};
+
+static void reader_init(struct bench_thread *bt)
+{
+	struct reader *r = gsh_calloc(1, sizeof(*r));
+
+	if (r == NULL)
+		return;
+
+	r->entry = bench_store_get_entry(1 + bt->idx);
+	bt->private = r;
+}
+
+static void read_op(struct bench_thread *bt)
+{
+	struct reader *r = bt->private;
+	size_t moved;
+
+	if (r == NULL || r->entry == NULL ||
+	    file_read(r->entry, r->offset, IO_SIZE, r->buf, &moved) != 0 ||
+	    moved != IO_SIZE) {
+		bt->errors++;
+		return;
+	}
+
+	r->offset += IO_SIZE;
+	if (r->offset == FILE_SIZE)
+		r->offset = 0;
+}
+
+static void reader_fini(struct bench_thread *bt)
+{
+	struct reader *r = bt->private;
+
+	if (r == NULL)
+		return;
+
+	if (r->entry != NULL)
+		cache_inode_put(r->entry);
+
+	gsh_free(r);
+	bt->private = NULL;
+}
+
+static void reads_report(void)
+{
+	fprintf(stderr, "%" PRIu64 " FSAL reads\n",
+		atomic_fetch_uint64_t(&bench_store.reads));
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "read_direct",
+		.desc = "64KiB sequential reads, Read_Ahead off",
+		.setup = direct_setup,
+		.thread_init = reader_init,
+		.op = read_op,
+		.thread_fini = reader_fini,
+		.cleanup = reads_report,
+	},
+	{
+		.name = "read_ahead",
+		.desc = "64KiB sequential reads, Read_Ahead on",
+		.setup = readahead_setup,
+		.thread_init = reader_init,
+		.op = read_op,
+		.thread_fini = reader_fini,
+		.cleanup = reads_report,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_readahead", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	bench_store.file_size = FILE_SIZE;
+	bench_store.call_ns = BACKEND_CALL_NS;
+	bench_store.sleep = true;
+	bench_store.fill = true;
+	bench_store.read_cb = once_read;
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,389 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_sal.c
+ * @brief Microbenchmarks of the state id table and byte range locks
+ *
+ * - state_get looks up open stateids with nfs4_State_Get_Pointer, as
+ *   every stateid carrying operation does, and drops the reference.
+ * - state_set_del inserts a new stateid and removes it, as OPEN and
+ *   CLOSE do.  Every thread has its own file and owner.
+ * - lock_private takes and releases a write lock on a file of the
+ *   thread's own.
+ * - lock_shared does the same on disjoint ranges of a single file, so
+ *   the threads contend on the file's lock list.
+ *
+ * The owners are built here rather than through the client id code,
+ * the locks are NFSv4 locks without a lock stateid.  The BENCH FSAL
+ * has no lock support, so locks are only managed by SAL.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "abstract_mem.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+#include "bench_common.h"
+
+#define KEY_FILES	0
+#define KEY_SETDEL	(1ULL << 40)
+#define KEY_LOCK	(1ULL << 48)
+#define KEY_LOCK_SHARED	(1ULL << 56)
+
+/** Clients owning the preloaded states */
+#define BENCH_CLIENTS 64
+
+/** Bytes locked by each operation */
+#define LOCK_RANGE 4096
+
+static cache_entry_t **files;
+static state_t **states;
+static state_owner_t *open_owners[BENCH_CLIENTS];
+static cache_entry_t *shared_file;
+
+static uint64_t bench_clientid(unsigned int client)
+{
+	/* Like a real client id: an epoch, then a counter */
+	return ((uint64_t) 0x5eed << 32) | client;
+}
+
+static state_owner_t *new_owner(state_owner_type_t type, uint64_t clientid,
+				const char *kind, unsigned int n)
+{
+	state_owner_t *owner;
+	char name[64];
+
+	owner = gsh_calloc(1, sizeof(*owner));
+	if (owner == NULL)
+		return NULL;
+
+	owner->so_owner_len = snprintf(name, sizeof(name), "bench.%s.%u",
+				       kind, n);
+	owner->so_owner_val = gsh_strdup(name);
+	if (owner->so_owner_val == NULL) {
+		gsh_free(owner);
+		return NULL;
+	}
+
+	owner->so_type = type;
+	owner->so_refcount = 1;
+	owner->so_owner.so_nfs4_owner.so_clientid = clientid;
+	glist_init(&owner->so_lock_list);
+	glist_init(&owner->so_owner.so_nfs4_owner.so_state_list);
+	PTHREAD_MUTEX_init(&owner->so_mutex, NULL);
+	return owner;
+}
+
+static void free_owner(state_owner_t *owner)
+{
+	PTHREAD_MUTEX_destroy(&owner->so_mutex);
+	gsh_free(owner->so_owner_val);
+	gsh_free(owner);
+}
+
+/**
+ * @brief Build an open state
+ *
+ * The stateid other is the owner's client id followed by @a counter,
+ * the way the server builds them.
+ */
+
+static state_t *new_state(cache_entry_t *entry, state_owner_t *owner,
+			  uint32_t counter)
+{
+	uint64_t clientid = owner->so_owner.so_nfs4_owner.so_clientid;
+	state_t *state;
+
+	state = gsh_calloc(1, sizeof(*state));
+	if (state == NULL)
+		return NULL;
+
+	PTHREAD_MUTEX_init(&state->state_mutex, NULL);
+	state->state_type = STATE_TYPE_SHARE;
+	state->state_entry = entry;
+	state->state_owner = owner;
+	state->state_export = bench_export;
+	state->state_seqid = 1;
+	state->state_refcount = 1;
+	memcpy(state->stateid_other, &clientid, sizeof(clientid));
+	memcpy(state->stateid_other + sizeof(clientid), &counter,
+	       sizeof(counter));
+	return state;
+}
+
+/*
+ * state_get
+ */
+
+static int state_get_setup(void)
+{
+	uint32_t i;
+
+	if (states != NULL)
+		return 0;
+
+	files = gsh_calloc(bench_opts.objects, sizeof(*files));
+	states = gsh_calloc(bench_opts.objects, sizeof(*states));
+	if (files == NULL || states == NULL)
+		return -1;
+
+	for (i = 0; i < BENCH_CLIENTS; i++) {
+		open_owners[i] = new_owner(STATE_OPEN_OWNER_NFSV4,
+					   bench_clientid(i), "open", i);
+		if (open_owners[i] == NULL)
+			return -1;
+	}
+
+	/* The entries stay referenced, so they are never reaped */
+	for (i = 0; i < bench_opts.objects; i++) {
+		files[i] = bench_get_entry(KEY_FILES + i);
+		if (files[i] == NULL)
+			return -1;
+
+		states[i] = new_state(files[i],
+				      open_owners[i % BENCH_CLIENTS],
+				      i / BENCH_CLIENTS + 1);
+		if (states[i] == NULL || !nfs4_State_Set(states[i]))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void state_get_op(struct bench_thread *bt)
+{
+	state_t *state;
+
+	state = states[bench_rand(bt) % bench_opts.objects];
+	state = nfs4_State_Get_Pointer(state->stateid_other);
+	if (state == NULL) {
+		bt->errors++;
+		return;
+	}
+	dec_state_t_ref(state);
+}
+
+/*
+ * state_set_del
+ */
+
+static void state_set_del_init(struct bench_thread *bt)
+{
+	cache_entry_t *entry;
+	state_owner_t *owner;
+
+	entry = bench_get_entry(KEY_SETDEL + bt->idx);
+	owner = new_owner(STATE_OPEN_OWNER_NFSV4,
+			  bench_clientid(BENCH_CLIENTS + bt->idx), "setdel",
+			  bt->idx);
+	if (entry == NULL || owner == NULL)
+		return;
+
+	bt->private = new_state(entry, owner, 0);
+}
+
+static void state_set_del_op(struct bench_thread *bt)
+{
+	state_t *state = bt->private;
+	uint32_t counter;
+
+	if (state == NULL) {
+		bt->errors++;
+		return;
+	}
+
+	/* A new stateid each time */
+	memcpy(&counter, state->stateid_other + sizeof(uint64_t),
+	       sizeof(counter));
+	counter++;
+	memcpy(state->stateid_other + sizeof(uint64_t), &counter,
+	       sizeof(counter));
+
+	if (!nfs4_State_Set(state)) {
+		bt->errors++;
+		return;
+	}
+	if (!nfs4_State_Del(state))
+		bt->errors++;
+}
+
+static void state_set_del_fini(struct bench_thread *bt)
+{
+	state_t *state = bt->private;
+
+	if (state == NULL)
+		return;
+
+	cache_inode_put(state->state_entry);
+	free_owner(state->state_owner);
+	PTHREAD_MUTEX_destroy(&state->state_mutex);
+	gsh_free(state);
+	bt->private = NULL;
+}
+
+/*
+ * lock_private and lock_shared
+ */
+
+struct lock_ctx {
+	cache_entry_t *entry;
+	state_owner_t *owner;
+	fsal_lock_param_t lock;
+};
+
+static void lock_init(struct bench_thread *bt, cache_entry_t *entry,
+		      uint64_t start)
+{
+	struct lock_ctx *lc;
+
+	if (entry == NULL)
+		return;
+
+	lc = gsh_calloc(1, sizeof(*lc));
+	if (lc == NULL)
+		return;
+
+	lc->entry = entry;
+	lc->owner = new_owner(STATE_LOCK_OWNER_NFSV4,
+			      bench_clientid(2 * BENCH_CLIENTS + bt->idx),
+			      "lock", bt->idx);
+	if (lc->owner == NULL) {
+		gsh_free(lc);
+		return;
+	}
+
+	lc->lock.lock_sle_type = FSAL_POSIX_LOCK;
+	lc->lock.lock_type = FSAL_LOCK_W;
+	lc->lock.lock_start = start;
+	lc->lock.lock_length = LOCK_RANGE;
+	bt->private = lc;
+}
+
+static void lock_private_init(struct bench_thread *bt)
+{
+	lock_init(bt, bench_get_entry(KEY_LOCK + bt->idx), 0);
+}
+
+static int lock_shared_setup(void)
+{
+	if (shared_file == NULL)
+		shared_file = bench_get_entry(KEY_LOCK_SHARED);
+
+	return shared_file != NULL ? 0 : -1;
+}
+
+static void lock_shared_init(struct bench_thread *bt)
+{
+	lock_init(bt, shared_file, (uint64_t) bt->idx * LOCK_RANGE);
+}
+
+static void lock_op(struct bench_thread *bt)
+{
+	struct lock_ctx *lc = bt->private;
+	state_owner_t *holder;
+	fsal_lock_param_t conflict;
+	fsal_lock_param_t lock;
+
+	if (lc == NULL) {
+		bt->errors++;
+		return;
+	}
+
+	lock = lc->lock;
+	if (state_lock(lc->entry, lc->owner, NULL, STATE_NON_BLOCKING, NULL,
+		       &lock, &holder, &conflict) != STATE_SUCCESS) {
+		bt->errors++;
+		return;
+	}
+
+	lock = lc->lock;
+	if (state_unlock(lc->entry, NULL, lc->owner, false, 0, &lock)
+	    != STATE_SUCCESS)
+		bt->errors++;
+}
+
+static void lock_fini(struct bench_thread *bt)
+{
+	struct lock_ctx *lc = bt->private;
+
+	if (lc == NULL)
+		return;
+
+	if (lc->entry != shared_file)
+		cache_inode_put(lc->entry);
+	free_owner(lc->owner);
+	gsh_free(lc);
+	bt->private = NULL;
+}
+
+static void lock_shared_cleanup(void)
+{
+	cache_inode_put(shared_file);
+	shared_file = NULL;
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "state_get",
+		.desc = "nfs4_State_Get_Pointer of open stateids",
+		.setup = state_get_setup,
+		.op = state_get_op,
+	},
+	{
+		.name = "state_set_del",
+		.desc = "nfs4_State_Set and nfs4_State_Del",
+		.thread_init = state_set_del_init,
+		.op = state_set_del_op,
+		.thread_fini = state_set_del_fini,
+	},
+	{
+		.name = "lock_private",
+		.desc = "state_lock and state_unlock, a file per thread",
+		.thread_init = lock_private_init,
+		.op = lock_op,
+		.thread_fini = lock_fini,
+	},
+	{
+		.name = "lock_shared",
+		.desc = "state_lock and state_unlock, one file for all threads",
+		.setup = lock_shared_setup,
+		.thread_init = lock_shared_init,
+		.op = lock_op,
+		.thread_fini = lock_fini,
+		.cleanup = lock_shared_cleanup,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_sal", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,286 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_upcall.c
+ * @brief Microbenchmarks of upcall batching
+ *
+ * One operation is an attribute invalidation upcall on an object
+ * picked from a hot set of HOT_SET cached entries, like a storm of
+ * invalidations from a clustered backend.  inval_direct calls the
+ * fsal_up_top vector, inval_batch the asynchronous wrapper with
+ * Upcall_Batch on.  Setup of inval_batch checks that batched size
+ * updates end at the largest size, that a batched invalidation reaches
+ * the entry, and that synchronous upcalls are applied before they
+ * return.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "nfs_core.h"
+#include "fsal_up.h"
+#include "bench_common.h"
+#include "delayed_exec.h"
+#include "fridgethr.h"
+
+#define HOT_SET 256
+#define KEY_CHECK 0
+
+static cache_entry_t *hot[HOT_SET];
+
+/**
+ * @brief Wait for all batches to be applied
+ */
+
+static int batch_drain(void)
+{
+	int i;
+
+	for (i = 0; i < 10000; i++) {
+		if (atomic_fetch_uint64_t(&fsal_up_batch_st.depth) == 0)
+			return 0;
+		usleep(1000);
+	}
+
+	fprintf(stderr, "Batches not applied after 10s\n");
+	return -1;
+}
+
+/**
+ * @brief Send an upcall for a key
+ *
+ * @return 0, or the error of the upcall.
+ */
+
+static int up_key(uint64_t key, bool async, uint32_t flags,
+		  struct attrlist *attr, uint32_t upflags)
+{
+	struct gsh_buffdesc obj = {
+		.addr = &key,
+		.len = sizeof(key),
+	};
+
+	if (async && attr != NULL)
+		return up_async_update(general_fridge, &fsal_up_top,
+				       bench_fsal, &obj, attr, upflags,
+				       NULL, NULL);
+	if (async)
+		return up_async_invalidate(general_fridge, &fsal_up_top,
+					   bench_fsal, &obj, flags, NULL,
+					   NULL);
+	if (attr != NULL)
+		return fsal_up_top.update(bench_fsal, &obj, attr, upflags);
+
+	return fsal_up_top.invalidate(bench_fsal, &obj, flags);
+}
+
+/**
+ * @brief Check batched updates and invalidations against the entry
+ */
+
+static int batch_check(void)
+{
+	cache_entry_t *entry;
+	struct attrlist attr;
+	uint64_t max = 0;
+	uint32_t i, seed = 1;
+	int rc = -1;
+
+	entry = bench_get_entry(KEY_CHECK);
+	if (entry == NULL)
+		return -1;
+
+	for (i = 0; i < 1000; i++) {
+		memset(&attr, 0, sizeof(attr));
+		FSAL_SET_MASK(attr.mask, ATTR_SIZE);
+		attr.filesize = (seed = seed * 1103515245 + 12345) % 1000000;
+		if (attr.filesize > max)
+			max = attr.filesize;
+		if (up_key(KEY_CHECK, true, 0, &attr,
+			   fsal_up_update_filesize_inc) != 0) {
+			fprintf(stderr, "Update %"PRIu32" failed\n", i);
+			goto out;
+		}
+	}
+
+	if (batch_drain() != 0)
+		goto out;
+
+	if (entry->obj_handle->attrs->filesize != max) {
+		fprintf(stderr, "Size %"PRIu64" after updates, not %"PRIu64"\n",
+			entry->obj_handle->attrs->filesize, max);
+		goto out;
+	}
+
+	if (up_key(KEY_CHECK, true, CACHE_INODE_INVALIDATE_ATTRS, NULL,
+		   0) != 0 || batch_drain() != 0)
+		goto out;
+
+	if (entry->flags & CACHE_INODE_TRUST_ATTRS) {
+		fprintf(stderr, "Attributes still trusted\n");
+		goto out;
+	}
+
+	/* Synchronous upcalls are done when they return */
+	attr.filesize = max + 1;
+	if (up_key(KEY_CHECK, false, 0, &attr, 0) != 0 ||
+	    entry->obj_handle->attrs->filesize != max + 1 ||
+	    !(entry->flags & CACHE_INODE_TRUST_ATTRS)) {
+		fprintf(stderr, "Synchronous update not applied\n");
+		goto out;
+	}
+
+	if (up_key(KEY_CHECK, false, CACHE_INODE_INVALIDATE_ATTRS, NULL,
+		   0) != 0 || (entry->flags & CACHE_INODE_TRUST_ATTRS)) {
+		fprintf(stderr, "Synchronous invalidation not applied\n");
+		goto out;
+	}
+
+	fprintf(stderr, "Checked 1000 updates, %" PRIu64 " coalesced\n",
+		atomic_fetch_uint64_t(&fsal_up_batch_st.coalesced));
+	rc = 0;
+
+ out:
+	cache_inode_put(entry);
+	return rc;
+}
+
+static int hot_get(void)
+{
+	uint64_t key;
+
+	for (key = 0; key < HOT_SET; key++) {
+		if (hot[key] != NULL)
+			continue;
+		hot[key] = bench_get_entry(1 + key);
+		if (hot[key] == NULL)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int direct_setup(void)
+{
+	cache_param.upcall_batch.enabled = false;
+	return hot_get();
+}
+
+static int batch_setup(void)
+{
+	static bool checked;
+
+	cache_param.upcall_batch.enabled = true;
+
+	if (!checked && batch_check() != 0)
+		return -1;
+	checked = true;
+
+	memset(&fsal_up_batch_st, 0, sizeof(fsal_up_batch_st));
+	return hot_get();
+}
+
+static void inval_init(struct bench_thread *bt)
+{
+	uint32_t *seed = gsh_malloc(sizeof(*seed));
+
+	if (seed != NULL)
+		*seed = bt->idx + 1;
+	bt->private = seed;
+}
+
+static void inval_op(struct bench_thread *bt)
+{
+	uint32_t *seed = bt->private;
+
+	if (seed == NULL) {
+		bt->errors++;
+		return;
+	}
+
+	*seed = *seed * 1103515245 + 12345;
+	if (up_key(1 + (*seed >> 8) % HOT_SET,
+		   cache_param.upcall_batch.enabled,
+		   CACHE_INODE_INVALIDATE_ATTRS, NULL, 0) != 0)
+		bt->errors++;
+}
+
+static void inval_fini(struct bench_thread *bt)
+{
+	gsh_free(bt->private);
+	bt->private = NULL;
+}
+
+static void batch_report(void)
+{
+	(void)batch_drain();
+	fprintf(stderr,
+		"%" PRIu64 " upcalls, %" PRIu64 " coalesced, %" PRIu64
+		" batches\n",
+		atomic_fetch_uint64_t(&fsal_up_batch_st.queued),
+		atomic_fetch_uint64_t(&fsal_up_batch_st.coalesced),
+		atomic_fetch_uint64_t(&fsal_up_batch_st.batches));
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "inval_direct",
+		.desc = "Synchronous attribute invalidation upcalls",
+		.setup = direct_setup,
+		.thread_init = inval_init,
+		.op = inval_op,
+		.thread_fini = inval_fini,
+	},
+	{
+		.name = "inval_batch",
+		.desc = "Asynchronous attribute invalidation upcalls, Upcall_Batch on",
+		.setup = batch_setup,
+		.thread_init = inval_init,
+		.op = inval_op,
+		.thread_fini = inval_fini,
+		.cleanup = batch_report,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_upcall", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	/* Batches are timed by the delayed executor and applied in the
+	   general fridge */
+	delayed_start();
+	if (general_fridge_init() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,183 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_warm.c
+ * @brief Microbenchmarks of warm restart of the cache
+ *
+ * Setup caches the working set, saves it to a temporary
+ * Warm_Restart_File, kills every entry, then starts warm restart and
+ * times how long the prefetch takes to bring the whole working set
+ * back, unthrottled.
+ *
+ * - save snapshots the working set to the file, as the warm restart
+ *   thread does every Warm_Restart_Interval.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "abstract_mem.h"
+#include "cache_inode.h"
+#include "cache_inode_hash.h"
+#include "cache_inode_lru.h"
+#include "bench_common.h"
+
+#define KEY_BASE 0x5741524d00000000ULL
+
+/** Seconds the prefetch may take */
+#define PREFETCH_TIMEOUT 60
+
+static char warm_path[] = "/tmp/bench_warm.XXXXXX";
+
+static bool cached(uint64_t k)
+{
+	struct gsh_buffdesc fh_desc = {
+		.addr = &k,
+		.len = sizeof(k)
+	};
+	cache_inode_key_t key;
+	cih_latch_t latch;
+	cache_entry_t *entry;
+
+	(void)cih_hash_key(&key, bench_fsal, &fh_desc,
+			   CIH_HASH_KEY_PROTOTYPE);
+
+	entry = cih_get_by_key_latched(&key, &latch,
+				       CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
+				       __func__, __LINE__);
+	if (entry != NULL)
+		cih_latch_rele(&latch);
+
+	return entry != NULL;
+}
+
+static uint32_t count_cached(void)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < bench_opts.objects; i++)
+		n += cached(KEY_BASE + i);
+
+	return n;
+}
+
+static int warm_setup(void)
+{
+	struct timespec start, end;
+	cache_entry_t *entry;
+	uint32_t i, n;
+	int fd;
+
+	if (cache_param.warm.file != NULL)
+		return 0;
+
+	fd = mkstemp(warm_path);
+	if (fd < 0) {
+		perror(warm_path);
+		return -1;
+	}
+	close(fd);
+
+	cache_param.warm.file = gsh_strdup(warm_path);
+	cache_param.warm.entries = bench_opts.objects;
+	cache_param.warm.rate = 0;
+	cache_param.warm.readdir = false;
+	cache_param.warm.interval = 3600;
+
+	for (i = 0; i < bench_opts.objects; i++) {
+		entry = bench_get_entry(KEY_BASE + i);
+		if (entry == NULL)
+			return -1;
+		cache_inode_put(entry);
+	}
+
+	cache_inode_warm_save();
+
+	for (i = 0; i < bench_opts.objects; i++) {
+		entry = bench_get_entry(KEY_BASE + i);
+		if (entry == NULL)
+			return -1;
+		cache_inode_kill_entry(entry);
+		cache_inode_put(entry);
+	}
+
+	n = count_cached();
+	if (n != 0) {
+		fprintf(stderr, "%u entries still cached after kill\n", n);
+		return -1;
+	}
+
+	now(&start);
+	if (cache_inode_warm_pkginit() != 0)
+		return -1;
+
+	do {
+		usleep(1000);
+		n = count_cached();
+		now(&end);
+	} while (n < bench_opts.objects &&
+		 timespec_diff(&start, &end) < PREFETCH_TIMEOUT * NS_PER_SEC);
+
+	fprintf(stderr, "Prefetched %u of %u entries in %.1f ms\n",
+		n, bench_opts.objects,
+		timespec_diff(&start, &end) / (double)NS_PER_MSEC);
+
+	return n == bench_opts.objects ? 0 : -1;
+}
+
+static void save_op(struct bench_thread *bt)
+{
+	cache_inode_warm_save();
+}
+
+static void warm_cleanup(void)
+{
+	(void)cache_inode_warm_pkgshutdown();
+	unlink(warm_path);
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "save",
+		.desc = "Snapshot the working set to Warm_Restart_File",
+		.setup = warm_setup,
+		.op = save_op,
+		.cleanup = warm_cleanup,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_warm", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,340 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file bench_wgather.c
+ * @brief Microbenchmarks of UNSTABLE write gathering
+ *
+ * One operation is a 4KiB UNSTABLE cache_inode_rdwr write, each
+ * thread writing its own file sequentially, to the memory store of
+ * the harness with calls of BACKEND_CALL_NS.  write_direct runs with
+ * Write_Gather off, write_gather with it on.  Setup writes a
+ * pattern of sequential, overlapping and scattered writes with
+ * gathering on, reading some back, and checks what reaches the FSAL.
+ * It also checks that runs are written out early once
+ * Write_Gather_Max_Memory is reached.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "nfs_core.h"
+#include "bench_common.h"
+#include "delayed_exec.h"
+
+#define IO_SIZE 4096
+#define FILE_SIZE (8 * 1024 * 1024)
+#define BACKEND_CALL_NS 20000
+#define KEY_CHECK 0
+/** Files of the memory pressure check, the last gets no run */
+#define KEY_PRESSURE (BENCH_STORE_FILES - 3)
+#define PRESSURE_FILES 3
+
+static int file_write(cache_entry_t *entry, uint64_t offset, size_t size,
+		      void *buffer)
+{
+	size_t moved = 0;
+	bool sync = false;
+
+	if (cache_inode_rdwr(entry, CACHE_INODE_WRITE, offset, size, &moved,
+			     buffer, NULL, &sync, NULL) != CACHE_INODE_SUCCESS ||
+	    moved != size)
+		return -1;
+	return 0;
+}
+
+static int file_check(cache_entry_t *entry, const char *expect,
+		      uint64_t offset, size_t size)
+{
+	static char buf[IO_SIZE * 4];
+	size_t moved = 0;
+	bool eof = false, sync = false;
+
+	if (cache_inode_rdwr(entry, CACHE_INODE_READ, offset, size, &moved,
+			     buf, &eof, &sync, NULL) != CACHE_INODE_SUCCESS ||
+	    moved != size)
+		return -1;
+	return memcmp(buf, expect + offset, size) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Check gathered writes against a plain copy
+ */
+
+static int gather_check(void)
+{
+	cache_entry_t *entry;
+	char *expect, *chunk;
+	uint64_t offset, writes;
+	uint32_t i, seed = 1;
+	int rc = -1;
+
+	cache_param.write_gather.enabled = true;
+
+	entry = bench_store_get_entry(KEY_CHECK);
+	expect = gsh_calloc(1, FILE_SIZE);
+	chunk = gsh_malloc(IO_SIZE * 2);
+	if (entry == NULL || expect == NULL || chunk == NULL)
+		goto out;
+
+	writes = atomic_fetch_uint64_t(&bench_store.writes);
+
+	for (i = 0; i < 4096; i++) {
+		size_t size = 1 + (seed = seed * 1103515245 + 12345) %
+							(IO_SIZE * 2);
+
+		switch (i % 8) {
+		case 0:
+			/* Somewhere else */
+			offset = (seed >> 8) % (FILE_SIZE - IO_SIZE * 16);
+			break;
+		case 5:
+			/* Back over what was just written */
+			offset = offset > size / 2 ? offset - size / 2 : 0;
+			break;
+		default:
+			break;
+		}
+
+		memset(chunk, i, size);
+		memcpy(expect + offset, chunk, size);
+		if (file_write(entry, offset, size, chunk) != 0) {
+			fprintf(stderr, "Write %"PRIu32" failed\n", i);
+			goto out;
+		}
+
+		if (i % 64 == 63 &&
+		    file_check(entry, expect, offset, size) != 0) {
+			fprintf(stderr, "Read %"PRIu32" differs\n", i);
+			goto out;
+		}
+
+		offset += size;
+	}
+
+	if (cache_inode_commit(entry, 0, 0) != CACHE_INODE_SUCCESS) {
+		fprintf(stderr, "Commit failed\n");
+		goto out;
+	}
+
+	if (memcmp(bench_store.data[KEY_CHECK], expect, FILE_SIZE) != 0) {
+		fprintf(stderr, "Gathered writes reached the FSAL wrong\n");
+		goto out;
+	}
+
+	fprintf(stderr, "Checked 4096 writes, %" PRIu64 " FSAL writes\n",
+		atomic_fetch_uint64_t(&bench_store.writes) - writes);
+	rc = 0;
+
+ out:
+	if (entry != NULL)
+		cache_inode_put(entry);
+	gsh_free(expect);
+	gsh_free(chunk);
+	return rc;
+}
+
+/**
+ * @brief Check that reaching Write_Gather_Max_Memory flushes the runs
+ *
+ * Two files gather a run each, which together take all the memory
+ * allowed, with a delay far longer than the check.  A write to a third
+ * file must get both runs to the FSAL.
+ */
+
+static int pressure_check(void)
+{
+	cache_entry_t *entry[PRESSURE_FILES];
+	uint32_t delay = cache_param.write_gather.delay;
+	uint64_t max_memory = cache_param.write_gather.max_memory;
+	char buf[IO_SIZE];
+	int i, wait, rc = -1;
+
+	memset(entry, 0, sizeof(entry));
+	memset(buf, 'p', sizeof(buf));
+
+	cache_param.write_gather.enabled = true;
+	cache_param.write_gather.delay = 60000;
+	/* Each run starts with a 64KiB buffer */
+	cache_param.write_gather.max_memory = 2 * 64 * 1024;
+
+	for (i = 0; i < PRESSURE_FILES; i++) {
+		entry[i] = bench_store_get_entry(KEY_PRESSURE + i);
+		if (entry[i] == NULL ||
+		    file_write(entry[i], 0, IO_SIZE, buf) != 0) {
+			fprintf(stderr, "Pressure write %d failed\n", i);
+			goto out;
+		}
+	}
+
+	for (wait = 0; wait < 1000; wait++) {
+		if (bench_store.data[KEY_PRESSURE][0] == 'p' &&
+		    bench_store.data[KEY_PRESSURE + 1][0] == 'p')
+			break;
+		usleep(1000);
+	}
+
+	if (wait == 1000) {
+		fprintf(stderr,
+			"Runs not written 1s after memory ran short\n");
+		goto out;
+	}
+
+	fprintf(stderr, "Runs written %d ms after memory ran short\n",
+		wait);
+	rc = 0;
+
+ out:
+	for (i = 0; i < PRESSURE_FILES; i++) {
+		if (entry[i] == NULL)
+			continue;
+		if (cache_inode_commit(entry[i], 0, 0) != CACHE_INODE_SUCCESS)
+			rc = -1;
+		cache_inode_put(entry[i]);
+	}
+
+	cache_param.write_gather.delay = delay;
+	cache_param.write_gather.max_memory = max_memory;
+	return rc;
+}
+
+static int direct_setup(void)
+{
+	cache_param.write_gather.enabled = false;
+	bench_store.writes = 0;
+	return 0;
+}
+
+static int gather_setup(void)
+{
+	static bool checked;
+
+	if (!checked && (gather_check() != 0 || pressure_check() != 0))
+		return -1;
+	checked = true;
+
+	cache_param.write_gather.enabled = true;
+	bench_store.writes = 0;
+	return 0;
+}
+
+struct writer {
+	cache_entry_t *entry;
+	uint64_t offset;
+	uint64_t writes;
+	char buf[IO_SIZE];
+};
+
+static void writer_init(struct bench_thread *bt)
+{
+	struct writer *w = gsh_calloc(1, sizeof(*w));
+
+	if (w == NULL)
+		return;
+
+	w->entry = bench_store_get_entry(1 + bt->idx);
+	memset(w->buf, bt->idx, sizeof(w->buf));
+	bt->private = w;
+}
+
+static void write_op(struct bench_thread *bt)
+{
+	struct writer *w = bt->private;
+
+	if (w == NULL || w->entry == NULL ||
+	    file_write(w->entry, w->offset, IO_SIZE, w->buf) != 0) {
+		bt->errors++;
+		return;
+	}
+
+	w->writes++;
+	w->offset += IO_SIZE;
+	if (w->offset == FILE_SIZE)
+		w->offset = 0;
+}
+
+static void writer_fini(struct bench_thread *bt)
+{
+	struct writer *w = bt->private;
+
+	if (w == NULL)
+		return;
+
+	if (w->entry != NULL) {
+		if (cache_inode_commit(w->entry, 0, 0) != CACHE_INODE_SUCCESS)
+			bt->errors++;
+		cache_inode_put(w->entry);
+	}
+
+	gsh_free(w);
+	bt->private = NULL;
+}
+
+static void writes_report(void)
+{
+	fprintf(stderr, "%" PRIu64 " FSAL writes\n",
+		atomic_fetch_uint64_t(&bench_store.writes));
+}
+
+static struct bench_case cases[] = {
+	{
+		.name = "write_direct",
+		.desc = "4KiB UNSTABLE writes, Write_Gather off",
+		.setup = direct_setup,
+		.thread_init = writer_init,
+		.op = write_op,
+		.thread_fini = writer_fini,
+		.cleanup = writes_report,
+	},
+	{
+		.name = "write_gather",
+		.desc = "4KiB UNSTABLE writes, Write_Gather on",
+		.setup = gather_setup,
+		.thread_init = writer_init,
+		.op = write_op,
+		.thread_fini = writer_fini,
+		.cleanup = writes_report,
+	},
+};
+
+int main(int argc, char **argv)
+{
+	int ncases = sizeof(cases) / sizeof(cases[0]);
+
+	if (bench_parse_args(argc, argv, "bench_wgather", cases, ncases) != 0)
+		return 1;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	bench_store.file_size = FILE_SIZE;
+	bench_store.call_ns = BACKEND_CALL_NS;
+
+	/* Runs are flushed from the delayed executor */
+	delayed_start();
+
+	return bench_run_cases(cases, ncases);
+}
@@ -0,0 +1,388 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file test_deleg_policy.c
+ * @brief Replay open traces against the delegation grant policies
+ *
+ * Each open of a trace is played against a model of the server: an
+ * open covered by a delegation its client holds never reaches the
+ * server, an open conflicting with delegations held by others
+ * recalls them first, and any other open is seen by the server,
+ * which may then grant a delegation.  Delegations are granted
+ * always, like plain Delegations = true, never, or as
+ * deleg_policy_grant decides.  Each policy is charged Deleg_Open_Cost
+ * per open the server sees and the recall latency per recall.
+ *
+ * A trace is one open per line, "file client r|w", with files and
+ * clients numbered from 0, a millisecond apart.  Without -f,
+ * synthetic home directory, shared and phased traces are replayed.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include "gsh_config.h"
+#include "cache_inode.h"
+#include "sal_functions.h"
+
+#define MAX_CLIENTS 64
+/** Time between the opens of a trace */
+#define TICK_NS 1000000
+
+nfs_parameter_t nfs_param;
+
+struct sim_open {
+	uint32_t file;
+	uint32_t client;
+	bool write;
+};
+
+struct sim_trace {
+	const char *name;
+	struct sim_open *opens;
+	uint32_t nopens;
+	uint32_t nfiles;
+};
+
+struct sim_file {
+	struct file_deleg_stats fds;
+	uint64_t readers;	/* Clients holding a read delegation */
+	int writer;		/* Client holding the write delegation */
+};
+
+enum sim_policy {
+	SIM_NEVER,
+	SIM_ALWAYS,
+	SIM_ADAPTIVE,
+};
+
+static const char * const policy_names[] = {
+	"never", "always", "adaptive"
+};
+
+struct sim_result {
+	uint64_t server_opens;
+	uint64_t local_opens;
+	uint64_t grants;
+	uint64_t recalls;
+	double cost_ms;
+};
+
+static uint32_t recall_usec = 10000;
+
+static uint32_t sim_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static int trace_add(struct sim_trace *t, uint32_t *alloc, uint32_t file,
+		     uint32_t client, bool write)
+{
+	if (t->nopens == *alloc) {
+		struct sim_open *n;
+
+		*alloc = *alloc ? *alloc * 2 : 4096;
+		n = realloc(t->opens, *alloc * sizeof(*n));
+		if (n == NULL)
+			return -1;
+		t->opens = n;
+	}
+
+	t->opens[t->nopens].file = file;
+	t->opens[t->nopens].client = client;
+	t->opens[t->nopens].write = write;
+	t->nopens++;
+	if (file >= t->nfiles)
+		t->nfiles = file + 1;
+	return 0;
+}
+
+/**
+ * @brief Each file has an owner that makes nearly all its opens
+ */
+
+static int trace_home(struct sim_trace *t, uint32_t nopens)
+{
+	uint32_t alloc = 0, seed = 1, i, file, client;
+
+	t->name = "home";
+	for (i = 0; i < nopens; i++) {
+		file = sim_rand(&seed) % 1000;
+		client = file % 16;
+		if (sim_rand(&seed) % 100 < 3)
+			client = sim_rand(&seed) % 16;
+		if (trace_add(t, &alloc, file, client,
+			      sim_rand(&seed) % 100 < 30) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Any client opens any file
+ */
+
+static int trace_shared(struct sim_trace *t, uint32_t nopens)
+{
+	uint32_t alloc = 0, seed = 2, i;
+
+	t->name = "shared";
+	for (i = 0; i < nopens; i++)
+		if (trace_add(t, &alloc, sim_rand(&seed) % 100,
+			      sim_rand(&seed) % 16,
+			      sim_rand(&seed) % 100 < 50) != 0)
+			return -1;
+	return 0;
+}
+
+/**
+ * @brief Files pass from client to client after runs of opens
+ */
+
+static int trace_phased(struct sim_trace *t, uint32_t nopens)
+{
+	uint32_t alloc = 0, seed = 3, i, file;
+	uint32_t owner[200];
+
+	t->name = "phased";
+	for (file = 0; file < 200; file++)
+		owner[file] = file % 16;
+
+	for (i = 0; i < nopens; i++) {
+		file = sim_rand(&seed) % 200;
+		/* Runs of 20 opens on average */
+		if (sim_rand(&seed) % 20 == 0)
+			owner[file] = sim_rand(&seed) % 16;
+		if (trace_add(t, &alloc, file, owner[file],
+			      sim_rand(&seed) % 100 < 30) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int trace_read(struct sim_trace *t, const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char line[256], rw;
+	uint32_t alloc = 0, file, client;
+
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	t->name = path;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%" SCNu32 " %" SCNu32 " %c",
+			   &file, &client, &rw) != 3 ||
+		    client >= MAX_CLIENTS ||
+		    trace_add(t, &alloc, file, client, rw == 'w') != 0) {
+			fprintf(stderr, "%s: bad line: %s", path, line);
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * @brief Recall the delegations conflicting with an open
+ */
+
+static void sim_recall(struct sim_file *f, uint32_t client, bool write,
+		       struct sim_result *res)
+{
+	int c;
+
+	if (f->writer >= 0 && (uint32_t)f->writer != client) {
+		f->fds.fds_curr_delegations--;
+		deleg_policy_recalled(&f->fds, recall_usec * NS_PER_USEC);
+		res->recalls++;
+		f->writer = -1;
+	}
+
+	if (!write || f->readers == 0)
+		return;
+
+	for (c = 0; c < MAX_CLIENTS; c++) {
+		if (!(f->readers & (1ULL << c)))
+			continue;
+		/* A read delegation does not cover a write open, even
+		   by its own client */
+		f->fds.fds_curr_delegations--;
+		deleg_policy_recalled(&f->fds, recall_usec * NS_PER_USEC);
+		res->recalls++;
+	}
+	f->readers = 0;
+}
+
+static void sim_run(const struct sim_trace *t, enum sim_policy policy,
+		    struct sim_result *res)
+{
+	struct sim_file *files = calloc(t->nfiles, sizeof(*files));
+	const struct sim_open *o;
+	struct sim_file *f;
+	uint32_t i;
+	bool grant;
+
+	memset(res, 0, sizeof(*res));
+	memset(&deleg_policy_st, 0, sizeof(deleg_policy_st));
+	if (files == NULL)
+		return;
+
+	for (i = 0; i < t->nfiles; i++)
+		files[i].writer = -1;
+
+	for (i = 0; i < t->nopens; i++) {
+		o = &t->opens[i];
+		f = &files[o->file];
+
+		/* Served by the client's own delegation */
+		if ((f->writer >= 0 && (uint32_t)f->writer == o->client) ||
+		    (!o->write && (f->readers & (1ULL << o->client)))) {
+			res->local_opens++;
+			continue;
+		}
+
+		sim_recall(f, o->client, o->write, res);
+
+		res->server_opens++;
+		deleg_policy_open(&f->fds, o->client, o->write,
+				  i * TICK_NS);
+
+		/* Only delegations that conflict with nothing held */
+		if (o->write ? f->readers != 0 : f->writer >= 0)
+			continue;
+
+		switch (policy) {
+		case SIM_NEVER:
+			grant = false;
+			break;
+		case SIM_ALWAYS:
+			grant = true;
+			break;
+		default:
+			grant = deleg_policy_grant(&f->fds, o->write
+						   ? OPEN_DELEGATE_WRITE
+						   : OPEN_DELEGATE_READ);
+			break;
+		}
+
+		if (!grant)
+			continue;
+
+		res->grants++;
+		f->fds.fds_curr_delegations++;
+		f->fds.fds_delegation_count++;
+		if (o->write)
+			f->writer = o->client;
+		else
+			f->readers |= 1ULL << o->client;
+	}
+
+	res->cost_ms = (res->server_opens *
+			(double)nfs_param.nfsv4_param.deleg_open_cost +
+			res->recalls * (double)recall_usec) / 1000.0;
+	free(files);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-f trace] [-n opens] [-o open_usec] [-r recall_usec]\n"
+		"\t-f  Trace of \"file client r|w\" lines, default synthetic\n"
+		"\t-n  Opens per synthetic trace, default 200000\n"
+		"\t-o  Deleg_Open_Cost, default %d\n"
+		"\t-r  Recall latency, default %" PRIu32 "\n",
+		prog, DELEG_OPEN_COST_DEFAULT, recall_usec);
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_trace traces[3];
+	struct sim_result res;
+	const char *path = NULL;
+	uint32_t nopens = 200000;
+	int ntraces = 0, i, p, opt;
+
+	nfs_param.nfsv4_param.deleg_open_cost = DELEG_OPEN_COST_DEFAULT;
+	nfs_param.nfsv4_param.deleg_recall_cost = DELEG_RECALL_COST_DEFAULT;
+
+	while ((opt = getopt(argc, argv, "f:n:o:r:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'n':
+			nopens = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			nfs_param.nfsv4_param.deleg_open_cost =
+				strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			recall_usec = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	memset(traces, 0, sizeof(traces));
+	if (path != NULL) {
+		if (trace_read(&traces[ntraces++], path) != 0)
+			return 1;
+	} else if (trace_home(&traces[ntraces++], nopens) != 0 ||
+		   trace_shared(&traces[ntraces++], nopens) != 0 ||
+		   trace_phased(&traces[ntraces++], nopens) != 0) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	printf("%-10s %-9s %12s %12s %10s %10s %12s\n", "trace", "policy",
+	       "server_opens", "local_opens", "grants", "recalls",
+	       "cost_ms");
+
+	for (i = 0; i < ntraces; i++) {
+		for (p = SIM_NEVER; p <= SIM_ADAPTIVE; p++) {
+			sim_run(&traces[i], p, &res);
+			printf("%-10s %-9s %12" PRIu64 " %12" PRIu64
+			       " %10" PRIu64 " %10" PRIu64 " %12.1f\n",
+			       traces[i].name, policy_names[p],
+			       res.server_opens, res.local_opens, res.grants,
+			       res.recalls, res.cost_ms);
+		}
+		free(traces[i].opens);
+	}
+
+	return 0;
+}
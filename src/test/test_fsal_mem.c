@@ -0,0 +1,309 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file test_fsal_mem.c
+ * @brief Directory operations and file data of FSAL_MEM
+ *
+ * FSAL_MEM is linked in rather than loaded, and its handle methods are
+ * called directly with the server libraries initialized as the
+ * benchmarks do it.  Each case checks a directory the way lookup and
+ * readdir see it afterwards, or a file the way read and getattrs do.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "fsal.h"
+#include "bench_common.h"
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: %s failed\n",		\
+				__func__, __LINE__, #cond);		\
+			return -1;					\
+		}							\
+	} while (0)
+
+static struct fsal_obj_handle *root;
+
+struct test_readdir {
+	char names[8][16];
+	int n;
+};
+
+static bool test_readdir_cb(const char *name, void *dir_state,
+			    fsal_cookie_t cookie)
+{
+	struct test_readdir *st = dir_state;
+
+	if (st->n == 8)
+		return false;
+	strncpy(st->names[st->n], name, sizeof(st->names[0]) - 1);
+	st->n++;
+	return true;
+}
+
+static int test_list(struct fsal_obj_handle *dir, struct test_readdir *st)
+{
+	bool eof;
+
+	memset(st, 0, sizeof(*st));
+	if (FSAL_IS_ERROR(dir->obj_ops.readdir(dir, NULL, st, test_readdir_cb,
+					       &eof)) || !eof)
+		return -1;
+	return 0;
+}
+
+static struct fsal_obj_handle *test_lookup(struct fsal_obj_handle *dir,
+					   const char *name)
+{
+	struct fsal_obj_handle *hdl;
+
+	if (FSAL_IS_ERROR(dir->obj_ops.lookup(dir, name, &hdl)))
+		return NULL;
+	hdl->obj_ops.release(hdl);
+	return hdl;
+}
+
+static struct fsal_obj_handle *test_create(struct fsal_obj_handle *dir,
+					   const char *name, bool is_dir)
+{
+	struct attrlist attrs;
+	struct fsal_obj_handle *hdl;
+	fsal_status_t status;
+
+	memset(&attrs, 0, sizeof(attrs));
+	attrs.mask = ATTR_MODE;
+	attrs.mode = 0755;
+	if (is_dir)
+		status = dir->obj_ops.mkdir(dir, name, &attrs, &hdl);
+	else
+		status = dir->obj_ops.create(dir, name, &attrs, &hdl);
+	if (FSAL_IS_ERROR(status))
+		return NULL;
+	hdl->obj_ops.release(hdl);
+	return hdl;
+}
+
+static fsal_status_t test_rename(struct fsal_obj_handle *dir,
+				 const char *from, const char *to)
+{
+	return root->obj_ops.rename(test_lookup(dir, from), dir, from,
+				    dir, to);
+}
+
+/**
+ * @brief Rename a file over another
+ */
+
+static int rename_over_file(struct fsal_obj_handle *dir)
+{
+	struct fsal_obj_handle *a, *b;
+	struct test_readdir st;
+
+	a = test_create(dir, "a", false);
+	b = test_create(dir, "b", false);
+	CHECK(a != NULL && b != NULL);
+
+	CHECK(!FSAL_IS_ERROR(test_rename(dir, "a", "b")));
+	CHECK(test_lookup(dir, "b") == a);
+	CHECK(test_lookup(dir, "a") == NULL);
+	CHECK(test_list(dir, &st) == 0);
+	CHECK(st.n == 1 && strcmp(st.names[0], "b") == 0);
+
+	/* and the name can still be removed */
+	CHECK(!FSAL_IS_ERROR(dir->obj_ops.unlink(dir, "b")));
+	CHECK(test_lookup(dir, "b") == NULL);
+	CHECK(test_list(dir, &st) == 0 && st.n == 0);
+	return 0;
+}
+
+/**
+ * @brief Rename a directory over an empty one, and over a full one
+ */
+
+static int rename_over_dir(struct fsal_obj_handle *dir)
+{
+	struct fsal_obj_handle *d, *e, *f;
+	struct test_readdir st;
+
+	d = test_create(dir, "d", true);
+	e = test_create(dir, "e", true);
+	f = test_create(dir, "f", true);
+	CHECK(d != NULL && e != NULL && f != NULL);
+	CHECK(test_create(f, "x", false) != NULL);
+
+	CHECK(test_rename(dir, "d", "f").major == ERR_FSAL_NOTEMPTY);
+	CHECK(!FSAL_IS_ERROR(test_rename(dir, "d", "e")));
+	CHECK(test_lookup(dir, "e") == d);
+	CHECK(test_lookup(d, "..") == dir);
+	CHECK(test_list(dir, &st) == 0);
+	CHECK(st.n == 2);
+	return 0;
+}
+
+/**
+ * @brief Rename a name onto another name of the same file
+ */
+
+static int rename_over_link(struct fsal_obj_handle *dir)
+{
+	struct fsal_obj_handle *g;
+	struct test_readdir st;
+
+	g = test_create(dir, "g", false);
+	CHECK(g != NULL);
+	CHECK(!FSAL_IS_ERROR(g->obj_ops.link(g, dir, "h")));
+	CHECK(g->obj_ops.link(g, dir, "h").major == ERR_FSAL_EXIST);
+
+	CHECK(!FSAL_IS_ERROR(test_rename(dir, "g", "h")));
+	CHECK(test_lookup(dir, "g") == g);
+	CHECK(test_lookup(dir, "h") == g);
+	CHECK(test_list(dir, &st) == 0);
+	CHECK(st.n == 2);
+	return 0;
+}
+
+static uint64_t test_spaceused(struct fsal_obj_handle *hdl)
+{
+	if (FSAL_IS_ERROR(hdl->obj_ops.getattrs(hdl)))
+		return UINT64_MAX;
+	return hdl->attrs->spaceused;
+}
+
+/**
+ * @brief Write far into a file, read the hole and truncate it away
+ */
+
+static int sparse_write(struct fsal_obj_handle *dir)
+{
+	struct fsal_obj_handle *s;
+	struct attrlist attrs;
+	char buf[32];
+	size_t n;
+	bool stable, eof;
+	uint64_t far = 1ULL << 40;	/* 1 TiB */
+
+	s = test_create(dir, "s", false);
+	CHECK(s != NULL);
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.open(s, FSAL_O_RDWR)));
+
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.write(s, far, 5, "hello", &n,
+					       &stable)));
+	CHECK(n == 5);
+	/* Only the chunk written is held */
+	CHECK(test_spaceused(s) < 1024 * 1024);
+	CHECK(s->attrs->filesize == far + 5);
+
+	memset(buf, 'x', sizeof(buf));
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.read(s, far - 3, sizeof(buf), buf,
+					      &n, &eof)));
+	CHECK(n == 8 && eof);
+	CHECK(memcmp(buf, "\0\0\0hello", 8) == 0);
+
+	memset(buf, 'x', sizeof(buf));
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.read(s, 0, sizeof(buf), buf, &n,
+					      &eof)));
+	CHECK(n == sizeof(buf) && !eof && buf[0] == 0 && buf[31] == 0);
+
+	memset(&attrs, 0, sizeof(attrs));
+	attrs.mask = ATTR_SIZE;
+	attrs.filesize = far + 2;
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.setattrs(s, &attrs)));
+	attrs.filesize = far + 5;
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.setattrs(s, &attrs)));
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.read(s, far, sizeof(buf), buf, &n,
+					      &eof)));
+	CHECK(n == 5 && memcmp(buf, "he\0\0\0", 5) == 0);
+
+	attrs.filesize = 0;
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.setattrs(s, &attrs)));
+	CHECK(test_spaceused(s) == 0);
+
+	CHECK(!FSAL_IS_ERROR(s->obj_ops.close(s)));
+	return 0;
+}
+
+static struct {
+	const char *name;
+	int (*run)(struct fsal_obj_handle *dir);
+} cases[] = {
+	{ "rename_over_file", rename_over_file },
+	{ "rename_over_dir", rename_over_dir },
+	{ "rename_over_link", rename_over_link },
+	{ "sparse_write", sparse_write },
+};
+
+int main(int argc, char **argv)
+{
+	struct config_error_type err_type;
+	struct fsal_obj_handle *dir;
+	struct fsal_module *fsal_hdl;
+	config_file_t config;
+	fsal_status_t status;
+	int i, failed = 0;
+
+	if (bench_init_server() != 0)
+		return 1;
+
+	/* Registered when the program was loaded */
+	fsal_hdl = lookup_fsal("MEM");
+	if (fsal_hdl == NULL || !init_error_type(&err_type))
+		return 1;
+	config = config_ParseFile("/dev/null", &err_type);
+	if (config == NULL)
+		return 1;
+	status = fsal_hdl->m_ops.init_config(fsal_hdl, config, &err_type);
+	config_Free(config);
+	if (FSAL_IS_ERROR(status))
+		return 1;
+
+	status = fsal_hdl->m_ops.create_export(fsal_hdl, NULL, &err_type,
+					       NULL);
+	if (FSAL_IS_ERROR(status)) {
+		fprintf(stderr, "Could not create a MEM export\n");
+		return 1;
+	}
+
+	status = op_ctx->fsal_export->exp_ops.lookup_path(
+		op_ctx->fsal_export, op_ctx->export->fullpath, &root);
+	if (FSAL_IS_ERROR(status))
+		return 1;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		dir = test_create(root, cases[i].name, true);
+		if (dir == NULL || cases[i].run(dir) != 0) {
+			fprintf(stderr, "%s: FAILED\n", cases[i].name);
+			failed++;
+		} else {
+			fprintf(stderr, "%s: ok\n", cases[i].name);
+		}
+	}
+
+	root->obj_ops.release(root);
+	op_ctx->fsal_export->exp_ops.release(op_ctx->fsal_export);
+	fsal_put(fsal_hdl);
+
+	return failed != 0;
+}
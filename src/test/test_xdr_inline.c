@@ -0,0 +1,517 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file test_xdr_inline.c
+ * @brief Round trip fuzz test of the XDR_INLINE codecs
+ *
+ * The hot NFS types code their fixed size parts with XDR_INLINE and
+ * fall back to the per field codecs when the stream has no contiguous
+ * room.  Every value is coded both ways, on an xdrmem stream and on one
+ * whose x_inline always fails: the encodings must be identical, and
+ * decoding them, or corrupted and truncated copies of them, must give
+ * the same result both ways.
+ *
+ * Usage: test_xdr_inline [iterations [seed]]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gsh_rpc.h"
+#include "nfs23.h"
+#include "nfsv41.h"
+
+#define BUFSIZE (64 * 1024)
+
+static unsigned int seed;
+static unsigned long failures;
+
+static struct xdr_ops slow_ops;
+
+static int32_t *no_inline(XDR *xdrs, u_int len)
+{
+	return NULL;
+}
+
+static void mem_stream(XDR *xdrs, char *buf, u_int len, enum xdr_op op,
+		       bool slow)
+{
+	xdrmem_create(xdrs, buf, len, op);
+	if (slow) {
+		slow_ops = *xdrs->x_ops;
+		slow_ops.x_inline = no_inline;
+		xdrs->x_ops = &slow_ops;
+	}
+}
+
+static uint32_t rnd(void)
+{
+	return ((uint32_t) rand_r(&seed) << 16) ^ rand_r(&seed);
+}
+
+static uint64_t rnd64(void)
+{
+	return ((uint64_t) rnd() << 32) | rnd();
+}
+
+static void rnd_bytes(char *p, u_int len)
+{
+	while (len-- > 0)
+		*p++ = rnd();
+}
+
+static char *rnd_alloc(u_int len)
+{
+	char *p = malloc(len + 1);
+
+	rnd_bytes(p, len);
+	return p;
+}
+
+/*
+ * Random values.  Each fill starts from a zeroed object and is driven
+ * by seed only, so the same value can be built again: encoding an
+ * nfs_fh4 swaps its export id in place.
+ */
+
+static void fill_fattr3(fattr3 *a)
+{
+	a->type = 1 + rnd() % 7;
+	a->mode = rnd();
+	a->nlink = rnd();
+	a->uid = rnd();
+	a->gid = rnd();
+	a->size = rnd64();
+	a->used = rnd64();
+	a->rdev.specdata1 = rnd();
+	a->rdev.specdata2 = rnd();
+	a->fsid = rnd64();
+	a->fileid = rnd64();
+	a->atime.tv_sec = rnd();
+	a->atime.tv_nsec = rnd();
+	a->mtime.tv_sec = rnd();
+	a->mtime.tv_nsec = rnd();
+	a->ctime.tv_sec = rnd();
+	a->ctime.tv_nsec = rnd();
+}
+
+static void fill_post_op_attr(void *obj)
+{
+	post_op_attr *a = obj;
+
+	a->attributes_follow = rnd() % 4 != 0;
+	if (a->attributes_follow)
+		fill_fattr3(&a->post_op_attr_u.attributes);
+}
+
+static void fill_fh3(nfs_fh3 *fh)
+{
+	fh->data.data_len = rnd() % (NFS3_FHSIZE + 1);
+	fh->data.data_val = rnd_alloc(fh->data.data_len);
+}
+
+static void fill_READ3args(void *obj)
+{
+	READ3args *a = obj;
+
+	fill_fh3(&a->file);
+	a->offset = rnd64();
+	a->count = rnd();
+}
+
+static void fill_READ3resok(void *obj)
+{
+	READ3resok *a = obj;
+
+	fill_post_op_attr(&a->file_attributes);
+	a->count = rnd();
+	a->eof = rnd() & 1;
+	a->data.data_len = rnd() % 9000;
+	a->data.data_val = rnd_alloc(a->data.data_len);
+}
+
+static void fill_WRITE3args(void *obj)
+{
+	WRITE3args *a = obj;
+
+	fill_fh3(&a->file);
+	a->offset = rnd64();
+	a->count = rnd();
+	a->stable = rnd() % 3;
+	a->data.data_len = rnd() % 9000;
+	a->data.data_val = rnd_alloc(a->data.data_len);
+}
+
+static void fill_WRITE3resok(void *obj)
+{
+	WRITE3resok *a = obj;
+
+	a->file_wcc.before.attributes_follow = rnd() & 1;
+	if (a->file_wcc.before.attributes_follow) {
+		wcc_attr *w = &a->file_wcc.before.pre_op_attr_u.attributes;
+
+		w->size = rnd64();
+		w->mtime.tv_sec = rnd();
+		w->mtime.tv_nsec = rnd();
+		w->ctime.tv_sec = rnd();
+		w->ctime.tv_nsec = rnd();
+	}
+	fill_post_op_attr(&a->file_wcc.after);
+	a->count = rnd();
+	a->committed = rnd() % 3;
+	rnd_bytes(a->verf, sizeof(a->verf));
+}
+
+static void fill_stateid4(stateid4 *a)
+{
+	a->seqid = rnd();
+	rnd_bytes(a->other, sizeof(a->other));
+}
+
+static void fill_bitmap4(void *obj)
+{
+	struct bitmap4 *a = obj;
+	u_int i;
+
+	a->bitmap4_len = rnd() % (BITMAP4_MAPLEN + 1);
+	for (i = 0; i < a->bitmap4_len; i++)
+		a->map[i] = rnd();
+}
+
+static void fill_PUTFH4args(void *obj)
+{
+	PUTFH4args *a = obj;
+
+	a->object.nfs_fh4_len = rnd() % (NFS4_FHSIZE + 1);
+	a->object.nfs_fh4_val = rnd_alloc(a->object.nfs_fh4_len);
+}
+
+static void fill_SEQUENCE4args(void *obj)
+{
+	SEQUENCE4args *a = obj;
+
+	rnd_bytes(a->sa_sessionid, sizeof(a->sa_sessionid));
+	a->sa_sequenceid = rnd();
+	a->sa_slotid = rnd();
+	a->sa_highest_slotid = rnd();
+	a->sa_cachethis = rnd() & 1;
+}
+
+static void fill_SEQUENCE4resok(void *obj)
+{
+	SEQUENCE4resok *a = obj;
+
+	rnd_bytes(a->sr_sessionid, sizeof(a->sr_sessionid));
+	a->sr_sequenceid = rnd();
+	a->sr_slotid = rnd();
+	a->sr_highest_slotid = rnd();
+	a->sr_target_highest_slotid = rnd();
+	a->sr_status_flags = rnd();
+}
+
+static void fill_READ4args(void *obj)
+{
+	READ4args *a = obj;
+
+	fill_stateid4(&a->stateid);
+	a->offset = rnd64();
+	a->count = rnd();
+}
+
+static void fill_READ4resok(void *obj)
+{
+	READ4resok *a = obj;
+
+	a->eof = rnd() & 1;
+	a->data.data_len = rnd() % 9000;
+	a->data.data_val = rnd_alloc(a->data.data_len);
+}
+
+static void fill_WRITE4args(void *obj)
+{
+	WRITE4args *a = obj;
+
+	fill_stateid4(&a->stateid);
+	a->offset = rnd64();
+	a->stable = rnd() % 3;
+	a->data.data_len = rnd() % 9000;
+	a->data.data_val = rnd_alloc(a->data.data_len);
+}
+
+static void fill_WRITE4resok(void *obj)
+{
+	WRITE4resok *a = obj;
+
+	a->count = rnd();
+	a->committed = rnd() % 3;
+	rnd_bytes(a->writeverf, sizeof(a->writeverf));
+}
+
+static void fill_COMPOUND4args(void *obj)
+{
+	COMPOUND4args *a = obj;
+	nfs_argop4 *op;
+	u_int i;
+
+	a->tag.utf8string_len = rnd() % 3 == 0 ? rnd() % 16 : 0;
+	a->tag.utf8string_val = rnd_alloc(a->tag.utf8string_len);
+	a->minorversion = rnd() % 3;
+	a->argarray.argarray_len = rnd() % 8;
+	a->argarray.argarray_val =
+	    calloc(a->argarray.argarray_len + 1, sizeof(nfs_argop4));
+
+	for (i = 0; i < a->argarray.argarray_len; i++) {
+		op = &a->argarray.argarray_val[i];
+		switch (rnd() % 5) {
+		case 0:
+			op->argop = NFS4_OP_SEQUENCE;
+			fill_SEQUENCE4args(&op->nfs_argop4_u.opsequence);
+			break;
+		case 1:
+			op->argop = NFS4_OP_PUTFH;
+			fill_PUTFH4args(&op->nfs_argop4_u.opputfh);
+			break;
+		case 2:
+			op->argop = NFS4_OP_GETATTR;
+			fill_bitmap4(&op->nfs_argop4_u.opgetattr.attr_request);
+			break;
+		case 3:
+			op->argop = NFS4_OP_READ;
+			fill_READ4args(&op->nfs_argop4_u.opread);
+			break;
+		default:
+			op->argop = NFS4_OP_WRITE;
+			fill_WRITE4args(&op->nfs_argop4_u.opwrite);
+			break;
+		}
+	}
+}
+
+struct xdr_type {
+	const char *name;
+	xdrproc_t proc;
+	size_t size;
+	void (*fill)(void *obj);
+	unsigned long decoded;		/*< Fuzzed decodes that succeeded */
+};
+
+#define XDR_TYPE(t) { #t, (xdrproc_t) xdr_##t, sizeof(t), fill_##t }
+
+static struct xdr_type types[] = {
+	XDR_TYPE(post_op_attr),
+	XDR_TYPE(READ3args),
+	XDR_TYPE(READ3resok),
+	XDR_TYPE(WRITE3args),
+	XDR_TYPE(WRITE3resok),
+	XDR_TYPE(bitmap4),
+	XDR_TYPE(PUTFH4args),
+	XDR_TYPE(SEQUENCE4args),
+	XDR_TYPE(SEQUENCE4resok),
+	XDR_TYPE(READ4args),
+	XDR_TYPE(READ4resok),
+	XDR_TYPE(WRITE4args),
+	XDR_TYPE(WRITE4resok),
+	XDR_TYPE(COMPOUND4args),
+};
+
+static void fail(struct xdr_type *t, const char *what)
+{
+	fprintf(stderr, "%s: %s\n", t->name, what);
+	failures++;
+}
+
+/**
+ * @brief Build the value of a seed
+ */
+
+static void *build(struct xdr_type *t, unsigned int value_seed)
+{
+	void *obj = calloc(1, t->size);
+
+	seed = value_seed;
+	t->fill(obj);
+	return obj;
+}
+
+static void release(struct xdr_type *t, void *obj)
+{
+	xdr_free(t->proc, obj);
+	free(obj);
+}
+
+/**
+ * @brief Encode an object
+ *
+ * @return The length of the encoding, -1 on failure.
+ */
+
+static int encode(struct xdr_type *t, void *obj, char *buf, bool slow)
+{
+	XDR xdrs;
+	int len;
+
+	mem_stream(&xdrs, buf, BUFSIZE, XDR_ENCODE, slow);
+	if (!t->proc(&xdrs, obj))
+		return -1;
+	len = xdr_getpos(&xdrs);
+	xdr_destroy(&xdrs);
+	return len;
+}
+
+/**
+ * @brief Decode an object
+ *
+ * @return The object, with the number of bytes consumed in pos, or
+ *         NULL if decoding failed.
+ */
+
+static void *decode(struct xdr_type *t, char *buf, u_int len, bool slow,
+		    u_int *pos)
+{
+	XDR xdrs;
+	void *obj = calloc(1, t->size);
+
+	mem_stream(&xdrs, buf, len, XDR_DECODE, slow);
+	if (!t->proc(&xdrs, obj)) {
+		release(t, obj);
+		return NULL;
+	}
+	*pos = xdr_getpos(&xdrs);
+	xdr_destroy(&xdrs);
+	return obj;
+}
+
+/**
+ * @brief Decode both ways and compare
+ *
+ * Decoded objects are compared through their encodings.
+ */
+
+static bool decode_both(struct xdr_type *t, char *buf, u_int len,
+			char *expect, int expect_len)
+{
+	static char fast_enc[BUFSIZE], slow_enc[BUFSIZE];
+	void *fast, *slow;
+	u_int fast_pos = 0, slow_pos = 0;
+	int fast_len, slow_len;
+	bool ok = true;
+
+	fast = decode(t, buf, len, false, &fast_pos);
+	slow = decode(t, buf, len, true, &slow_pos);
+
+	if ((fast == NULL) != (slow == NULL)) {
+		fail(t, fast == NULL ? "only the inline decode failed"
+				     : "only the per field decode failed");
+		ok = false;
+	} else if (fast != NULL) {
+		fast_len = encode(t, fast, fast_enc, true);
+		slow_len = encode(t, slow, slow_enc, true);
+		if (fast_pos != slow_pos) {
+			fail(t, "decodes consumed different lengths");
+			ok = false;
+		} else if (fast_len != slow_len ||
+			   memcmp(fast_enc, slow_enc, fast_len) != 0) {
+			fail(t, "decoded values differ");
+			ok = false;
+		} else if (expect != NULL &&
+			   (fast_len != expect_len ||
+			    memcmp(fast_enc, expect, expect_len) != 0)) {
+			fail(t, "decoded value differs from the original");
+			ok = false;
+		}
+		t->decoded++;
+	}
+
+	if (fast != NULL)
+		release(t, fast);
+	if (slow != NULL)
+		release(t, slow);
+	return ok;
+}
+
+static void round_trip(struct xdr_type *t, unsigned int value_seed)
+{
+	static char fast_buf[BUFSIZE], slow_buf[BUFSIZE], fuzz[BUFSIZE];
+	void *obj;
+	int fast_len, slow_len, n;
+	u_int len;
+
+	obj = build(t, value_seed);
+	fast_len = encode(t, obj, fast_buf, false);
+	release(t, obj);
+
+	obj = build(t, value_seed);
+	slow_len = encode(t, obj, slow_buf, true);
+	release(t, obj);
+
+	if (fast_len < 0 || slow_len < 0) {
+		fail(t, "encode failed");
+		return;
+	}
+	if (fast_len != slow_len ||
+	    memcmp(fast_buf, slow_buf, fast_len) != 0) {
+		fail(t, "encodings differ");
+		return;
+	}
+
+	if (!decode_both(t, fast_buf, fast_len, fast_buf, fast_len))
+		return;
+
+	/* Corrupt a few bytes and cut the encoding short */
+	seed = value_seed ^ 0x5a5a5a5a;
+	memcpy(fuzz, fast_buf, fast_len);
+	for (n = rnd() % 4; n >= 0 && fast_len > 0; n--)
+		fuzz[rnd() % fast_len] = rnd();
+	len = rnd() % 2 ? fast_len : rnd() % (fast_len + 1);
+	decode_both(t, fuzz, len, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations = 10000, i;
+	unsigned int base = 1;
+	int ntypes = sizeof(types) / sizeof(types[0]);
+	int j;
+
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		base = strtoul(argv[2], NULL, 0);
+
+	for (j = 0; j < ntypes; j++) {
+		for (i = 0; i < iterations; i++)
+			round_trip(&types[j], base + i);
+		printf("%-16s %lu values, %lu corrupted copies decoded\n",
+		       types[j].name, iterations, types[j].decoded -
+		       iterations);
+	}
+
+	if (failures != 0) {
+		printf("%lu failures\n", failures);
+		return 1;
+	}
+
+	printf("all passed\n");
+	return 0;
+}
@@ -0,0 +1,117 @@
+#!/bin/sh
+#
+# krb5_standin.sh - throwaway Kerberos realm for rpcbench krb5 runs
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 3 of the License, or (at your option) any later version.
+#
+# Usage: krb5_standin.sh start|stop [dir]
+#
+# start creates an MIT KDC for realm RPCBENCH.TEST in dir, with a keytab
+# for nfs/localhost and a ticket for root, and prints the settings to use.
+# stop kills the KDC and removes dir.
+
+REALM=RPCBENCH.TEST
+PORT=${KDC_PORT:-8888}
+DIR=${2:-/tmp/rpcbench-krb5}
+
+die()
+{
+	echo "$0: $*" >&2
+	exit 1
+}
+
+start()
+{
+	[ -e "$DIR" ] && die "$DIR exists, stop first"
+	mkdir -p "$DIR" || die "cannot create $DIR"
+
+	cat > "$DIR/krb5.conf" <<EOC
+[libdefaults]
+	default_realm = $REALM
+	dns_lookup_kdc = false
+	dns_lookup_realm = false
+	dns_canonicalize_hostname = false
+	rdns = false
+	default_ccache_name = FILE:$DIR/ccache
+
+[realms]
+	$REALM = {
+		kdc = 127.0.0.1:$PORT
+	}
+
+[domain_realm]
+	localhost = $REALM
+EOC
+
+	cat > "$DIR/kdc.conf" <<EOC
+[kdcdefaults]
+	kdc_ports = $PORT
+	kdc_tcp_ports = $PORT
+
+[realms]
+	$REALM = {
+		database_name = $DIR/principal
+		key_stash_file = $DIR/stash
+		acl_file = $DIR/kadm5.acl
+		supported_enctypes = aes256-cts:normal aes128-cts:normal
+	}
+EOC
+	: > "$DIR/kadm5.acl"
+
+	export KRB5_CONFIG="$DIR/krb5.conf"
+	export KRB5_KDC_PROFILE="$DIR/kdc.conf"
+	export KRB5CCNAME="FILE:$DIR/ccache"
+
+	kdb5_util -r $REALM create -s -P rpcbench > /dev/null ||
+		die "kdb5_util failed"
+	kadmin.local -r $REALM -q "addprinc -randkey nfs/localhost" \
+		> /dev/null || die "kadmin.local failed"
+	kadmin.local -r $REALM -q "ktadd -k $DIR/nfs.keytab nfs/localhost" \
+		> /dev/null || die "kadmin.local failed"
+	kadmin.local -r $REALM -q "addprinc -randkey root" \
+		> /dev/null || die "kadmin.local failed"
+	kadmin.local -r $REALM -q "ktadd -k $DIR/root.keytab root" \
+		> /dev/null || die "kadmin.local failed"
+
+	krb5kdc -r $REALM -P "$DIR/kdc.pid" || die "krb5kdc failed"
+	kinit -k -t "$DIR/root.keytab" root@$REALM || die "kinit failed"
+
+	cat <<EOC
+KDC for $REALM on 127.0.0.1:$PORT, in the environment of both
+ganesha.nfsd and rpcbench:
+
+	export KRB5_CONFIG=$DIR/krb5.conf
+	export KRB5CCNAME=FILE:$DIR/ccache
+
+ganesha.nfsd configuration:
+
+	NFS_KRB5
+	{
+		PrincipalName = nfs;
+		KeytabPath = $DIR/nfs.keytab;
+		Active_krb5 = true;
+	}
+EOC
+}
+
+stop()
+{
+	[ -f "$DIR/kdc.pid" ] && kill "$(cat "$DIR/kdc.pid")"
+	rm -rf "$DIR"
+}
+
+case "$1" in
+start)
+	start
+	;;
+stop)
+	stop
+	;;
+*)
+	echo "Usage: $0 start|stop [dir]" >&2
+	exit 1
+	;;
+esac
@@ -0,0 +1,1511 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file rpcbench.c
+ * @brief NFS RPC load generator
+ *
+ * Drives a running server with a weighted mix of NFSv3 or NFSv4.1
+ * operations.  Every simulated client runs in its own thread with its
+ * own TCP connection and, for NFSv4.1, its own client ID and session.
+ * Each client works on its own set of files in the export so that
+ * OPEN and LOCK do not conflict between clients.
+ *
+ * After a warm up period operations are counted for the requested
+ * duration and the throughput and latency percentiles of every
+ * operation are reported.  Latencies are measured around the whole
+ * RPC, so they include the network round trip.
+ *
+ * NFS calls use AUTH_UNIX, or RPCSEC_GSS with krb5, krb5i or krb5p,
+ * to compare the cost of the security flavors on the same mix.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "gsh_rpc.h"
+#include "nfs23.h"
+#include "mount.h"
+#include "nfsv41.h"
+#include "latency_histogram.h"
+
+
+#define USAGE								\
+	"usage: %s -e <export> [-s <server>] [-p <port>] [-v 3|4.1]\n"	\
+	"	[-c <clients>] [-f <files>] [-S <file size>] [-b <io size>]\n"\
+	"	[-t <seconds>] [-w <seconds>] [-m <op>=<weight>,...]\n"	\
+	"	[-a sys|krb5|krb5i|krb5p]\n"				\
+	"\n"								\
+	"ops: getattr lookup read write readdir open lock\n"		\
+	"(open and lock are only available with NFSv4.1)\n"
+
+#define BENCH_NAME_LEN 64
+#define BENCH_MAX_OPS 8
+#define BENCH_DIRCOUNT 4096
+
+/* Default timeout can be changed using clnt_control() */
+static struct timeval TIMEOUT = { 25, 0 };
+
+enum bench_op {
+	BENCH_GETATTR,
+	BENCH_LOOKUP,
+	BENCH_READ,
+	BENCH_WRITE,
+	BENCH_READDIR,
+	BENCH_OPEN,
+	BENCH_LOCK,
+	BENCH_OP_COUNT
+};
+
+static const char *bench_op_names[BENCH_OP_COUNT] = {
+	[BENCH_GETATTR] = "getattr",
+	[BENCH_LOOKUP] = "lookup",
+	[BENCH_READ] = "read",
+	[BENCH_WRITE] = "write",
+	[BENCH_READDIR] = "readdir",
+	[BENCH_OPEN] = "open",
+	[BENCH_LOCK] = "lock",
+};
+
+enum bench_phase {
+	PHASE_SETUP,
+	PHASE_WARMUP,
+	PHASE_RUN,
+	PHASE_STOP
+};
+
+/**
+ * @brief A file handle as returned by the server
+ *
+ * The XDR routines byte swap the export id of our own handles in
+ * place on encode, so handles are never passed to them directly but
+ * copied to the client's scratch buffer for every call.
+ */
+
+struct bench_fh {
+	u_int len;
+	char val[NFS4_FHSIZE];
+};
+
+struct bench_file {
+	char name[BENCH_NAME_LEN];
+	struct bench_fh fh;
+	stateid4 open_stateid;	/*< NFSv4.1 only */
+	stateid4 lock_stateid;	/*< NFSv4.1 only */
+	bool lock_valid;
+};
+
+struct bench_stats {
+	uint64_t ops;
+	uint64_t errors;
+	struct lat_histogram lat;
+};
+
+struct bench_client {
+	pthread_t thread;
+	int id;
+	unsigned int seed;
+	bool failed;
+	CLIENT *clnt;
+	AUTH *auth;
+	struct bench_fh root;
+	struct bench_file *files;
+	char fhbuf[NFS4_FHSIZE];
+	char *iobuf;
+	/* NFSv4.1 */
+	clientid4 clientid;
+	sessionid4 sessionid;
+	sequenceid4 seqid;
+	char owner[2 * BENCH_NAME_LEN];
+	struct bench_stats stats[BENCH_OP_COUNT];
+};
+
+struct bench_proto {
+	const char *name;
+	uint32_t ops;		/*< Mask of supported bench_op */
+	bool (*setup)(struct bench_client *c);
+	bool (*op)(struct bench_client *c, enum bench_op op);
+	void (*teardown)(struct bench_client *c);
+};
+
+static struct bench_opts {
+	const char *server;
+	const char *export;
+	unsigned short port;
+	const struct bench_proto *proto;
+	int clients;
+	int files;
+	uint64_t file_size;
+	uint32_t io_size;
+	int duration;
+	int warmup;
+	uint32_t weight[BENCH_OP_COUNT];
+	uint32_t total_weight;
+	const char *flavor;
+	int gss_svc;		/*< rpc_gss_svc_t, 0 for AUTH_UNIX */
+} opts = {
+	.server = "127.0.0.1",
+	.clients = 16,
+	.files = 4,
+	.file_size = 1024 * 1024,
+	.io_size = 4096,
+	.duration = 30,
+	.warmup = 5,
+	.flavor = "sys",
+};
+
+static int32_t bench_phase = PHASE_SETUP;
+static volatile sig_atomic_t interrupted;
+static pthread_barrier_t start_barrier;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Pick a random block aligned offset in a file
+ */
+
+static uint64_t bench_offset(struct bench_client *c)
+{
+	uint64_t blocks = opts.file_size / opts.io_size;
+
+	if (blocks <= 1)
+		return 0;
+	return (rand_r(&c->seed) % blocks) * opts.io_size;
+}
+
+static inline struct bench_file *bench_file(struct bench_client *c)
+{
+	return &c->files[rand_r(&c->seed) % opts.files];
+}
+
+static enum bench_op bench_pick_op(struct bench_client *c)
+{
+	uint32_t r = rand_r(&c->seed) % opts.total_weight;
+	int op;
+
+	for (op = 0; op < BENCH_OP_COUNT - 1; op++) {
+		if (r < opts.weight[op])
+			break;
+		r -= opts.weight[op];
+	}
+	return op;
+}
+
+/**
+ * @brief Copy a handle to the scratch buffer for encoding
+ */
+
+static inline char *bench_fh_arg(struct bench_client *c,
+				 const struct bench_fh *fh)
+{
+	memcpy(c->fhbuf, fh->val, fh->len);
+	return c->fhbuf;
+}
+
+static bool bench_fh_set(struct bench_fh *fh, const char *val, u_int len)
+{
+	if (len > sizeof(fh->val))
+		return false;
+	memcpy(fh->val, val, len);
+	fh->len = len;
+	return true;
+}
+
+/**
+ * @brief Open a connection to one of the server's programs
+ *
+ * Without a port the program is located through rpcbind.
+ */
+
+static CLIENT *bench_connect(struct bench_client *c, rpcprog_t prog,
+			     rpcvers_t vers, unsigned short port)
+{
+	struct addrinfo hints, *res;
+	struct netbuf nbuf;
+	char service[16];
+	CLIENT *clnt;
+	int fd, rc;
+
+	if (port == 0) {
+		clnt = clnt_ncreate(opts.server, prog, vers, "tcp");
+		if (clnt == NULL) {
+			fprintf(stderr, "client %d: %s\n", c->id,
+				clnt_spcreateerror(opts.server));
+			return NULL;
+		}
+		return clnt;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof(service), "%hu", port);
+
+	rc = getaddrinfo(opts.server, service, &hints, &res);
+	if (rc != 0) {
+		fprintf(stderr, "client %d: %s: %s\n", c->id, opts.server,
+			gai_strerror(rc));
+		return NULL;
+	}
+
+	fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+		fprintf(stderr, "client %d: connect to %s failed. errno=%d\n",
+			c->id, opts.server, errno);
+		if (fd >= 0)
+			close(fd);
+		freeaddrinfo(res);
+		return NULL;
+	}
+
+	nbuf.buf = res->ai_addr;
+	nbuf.len = nbuf.maxlen = res->ai_addrlen;
+	clnt = clnt_vc_ncreate(fd, &nbuf, prog, vers, 0, 0);
+	freeaddrinfo(res);
+
+	if (clnt == NULL) {
+		fprintf(stderr, "client %d: %s\n", c->id,
+			clnt_spcreateerror(opts.server));
+		close(fd);
+		return NULL;
+	}
+
+	/* Have clnt_destroy close the socket */
+	(void)clnt_control(clnt, CLSET_FD_CLOSE, NULL);
+	return clnt;
+}
+
+static bool bench_call(struct bench_client *c, CLIENT *clnt, rpcproc_t proc,
+		       xdrproc_t xargs, void *args, xdrproc_t xres, void *res)
+{
+	enum clnt_stat stat;
+
+	stat = clnt_call(clnt, c->auth, proc, xargs, args, xres, res, TIMEOUT);
+	if (stat != RPC_SUCCESS) {
+		fprintf(stderr, "client %d: RPC failed: %s\n", c->id,
+			clnt_sperrno(stat));
+		c->failed = true;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Switch the NFS calls of a client to RPCSEC_GSS
+ *
+ * The context is established with the credentials in the default
+ * ccache, for the nfs service of the server name.  MOUNT keeps using
+ * AUTH_UNIX.
+ */
+
+#ifdef _HAVE_GSSAPI
+static gss_OID_desc bench_krb5oid = {
+	9, "\052\206\110\206\367\022\001\002\002"
+};
+#endif
+
+static bool bench_secure(struct bench_client *c)
+{
+#ifdef _HAVE_GSSAPI
+	struct rpc_gss_sec sec;
+	char service[NI_MAXHOST + 4];
+	AUTH *auth;
+
+	if (opts.gss_svc == 0)
+		return true;
+
+	memset(&sec, 0, sizeof(sec));
+	sec.mech = &bench_krb5oid;
+	sec.qop = GSS_C_QOP_DEFAULT;
+	sec.req_flags = GSS_C_MUTUAL_FLAG;
+	sec.svc = opts.gss_svc;
+	snprintf(service, sizeof(service), "nfs@%s", opts.server);
+
+	auth = authgss_ncreate_default(c->clnt, service, &sec);
+	if (auth == NULL) {
+		fprintf(stderr, "client %d: %s: %s\n", c->id, service,
+			clnt_spcreateerror("RPCSEC_GSS context"));
+		return false;
+	}
+
+	auth_destroy(c->auth);
+	c->auth = auth;
+#endif
+	return true;
+}
+
+/*
+ * NFSv3
+ */
+
+static bool v3_mount(struct bench_client *c)
+{
+	CLIENT *clnt;
+	dirpath path = (dirpath) opts.export;
+	mountres3 res;
+	bool ok = false;
+
+	clnt = bench_connect(c, MOUNTPROG, MOUNT_V3, 0);
+	if (clnt == NULL)
+		return false;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, clnt, MOUNTPROC3_MNT, (xdrproc_t) xdr_dirpath,
+			&path, (xdrproc_t) xdr_mountres3, &res))
+		goto out;
+
+	if (res.fhs_status != MNT3_OK) {
+		fprintf(stderr, "client %d: mount of %s failed: %d\n", c->id,
+			opts.export, res.fhs_status);
+	} else {
+		ok = bench_fh_set(&c->root,
+			res.mountres3_u.mountinfo.fhandle.fhandle3_val,
+			res.mountres3_u.mountinfo.fhandle.fhandle3_len);
+	}
+	clnt_freeres(clnt, (xdrproc_t) xdr_mountres3, &res);
+
+ out:
+	clnt_destroy(clnt);
+	return ok;
+}
+
+static nfsstat3 v3_lookup(struct bench_client *c, const char *name,
+			  struct bench_fh *fh)
+{
+	LOOKUP3args arg;
+	LOOKUP3res res;
+	nfsstat3 status;
+
+	arg.what.dir.data.data_val = bench_fh_arg(c, &c->root);
+	arg.what.dir.data.data_len = c->root.len;
+	arg.what.name = (filename3) name;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_LOOKUP,
+			(xdrproc_t) xdr_LOOKUP3args, &arg,
+			(xdrproc_t) xdr_LOOKUP3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	if (status == NFS3_OK && fh != NULL &&
+	    !bench_fh_set(fh, res.LOOKUP3res_u.resok.object.data.data_val,
+			  res.LOOKUP3res_u.resok.object.data.data_len))
+		status = NFS3ERR_BADHANDLE;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_LOOKUP3res, &res);
+	return status;
+}
+
+static nfsstat3 v3_create(struct bench_client *c, const char *name)
+{
+	CREATE3args arg;
+	CREATE3res res;
+	nfsstat3 status;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.where.dir.data.data_val = bench_fh_arg(c, &c->root);
+	arg.where.dir.data.data_len = c->root.len;
+	arg.where.name = (filename3) name;
+	arg.how.mode = UNCHECKED;
+	arg.how.createhow3_u.obj_attributes.mode.set_it = TRUE;
+	arg.how.createhow3_u.obj_attributes.mode.set_mode3_u.mode = 0644;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_CREATE,
+			(xdrproc_t) xdr_CREATE3args, &arg,
+			(xdrproc_t) xdr_CREATE3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_CREATE3res, &res);
+	return status;
+}
+
+static nfsstat3 v3_write(struct bench_client *c, struct bench_file *file,
+			 uint64_t offset, stable_how stable)
+{
+	WRITE3args arg;
+	WRITE3res res;
+	nfsstat3 status;
+
+	arg.file.data.data_val = bench_fh_arg(c, &file->fh);
+	arg.file.data.data_len = file->fh.len;
+	arg.offset = offset;
+	arg.count = opts.io_size;
+	arg.stable = stable;
+	arg.data.data_val = c->iobuf;
+	arg.data.data_len = opts.io_size;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_WRITE,
+			(xdrproc_t) xdr_WRITE3args, &arg,
+			(xdrproc_t) xdr_WRITE3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_WRITE3res, &res);
+	return status;
+}
+
+static nfsstat3 v3_getattr(struct bench_client *c, struct bench_file *file)
+{
+	GETATTR3args arg;
+	GETATTR3res res;
+	nfsstat3 status;
+
+	arg.object.data.data_val = bench_fh_arg(c, &file->fh);
+	arg.object.data.data_len = file->fh.len;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_GETATTR,
+			(xdrproc_t) xdr_GETATTR3args, &arg,
+			(xdrproc_t) xdr_GETATTR3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_GETATTR3res, &res);
+	return status;
+}
+
+static nfsstat3 v3_read(struct bench_client *c, struct bench_file *file)
+{
+	READ3args arg;
+	READ3res res;
+	nfsstat3 status;
+
+	arg.file.data.data_val = bench_fh_arg(c, &file->fh);
+	arg.file.data.data_len = file->fh.len;
+	arg.offset = bench_offset(c);
+	arg.count = opts.io_size;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_READ,
+			(xdrproc_t) xdr_READ3args, &arg,
+			(xdrproc_t) xdr_READ3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_READ3res, &res);
+	return status;
+}
+
+static nfsstat3 v3_readdir(struct bench_client *c)
+{
+	READDIR3args arg;
+	READDIR3res res;
+	nfsstat3 status;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.dir.data.data_val = bench_fh_arg(c, &c->root);
+	arg.dir.data.data_len = c->root.len;
+	arg.count = BENCH_DIRCOUNT;
+
+	memset(&res, 0, sizeof(res));
+	if (!bench_call(c, c->clnt, NFSPROC3_READDIR,
+			(xdrproc_t) xdr_READDIR3args, &arg,
+			(xdrproc_t) xdr_READDIR3res, &res))
+		return NFS3ERR_IO;
+
+	status = res.status;
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_READDIR3res, &res);
+	return status;
+}
+
+static bool v3_setup(struct bench_client *c)
+{
+	struct bench_file *file;
+	nfsstat3 status;
+	uint64_t offset;
+	int i;
+
+	if (!v3_mount(c))
+		return false;
+
+	c->clnt = bench_connect(c, NFS_PROGRAM, NFS_V3, opts.port);
+	if (c->clnt == NULL || !bench_secure(c))
+		return false;
+
+	for (i = 0; i < opts.files; i++) {
+		file = &c->files[i];
+
+		status = v3_create(c, file->name);
+		if (status == NFS3_OK)
+			status = v3_lookup(c, file->name, &file->fh);
+		if (status != NFS3_OK) {
+			fprintf(stderr, "client %d: create of %s failed: %d\n",
+				c->id, file->name, status);
+			return false;
+		}
+
+		for (offset = 0; offset < opts.file_size;
+		     offset += opts.io_size) {
+			status = v3_write(c, file, offset, FILE_SYNC);
+			if (status != NFS3_OK) {
+				fprintf(stderr,
+					"client %d: write to %s failed: %d\n",
+					c->id, file->name, status);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool v3_op(struct bench_client *c, enum bench_op op)
+{
+	nfsstat3 status;
+
+	switch (op) {
+	case BENCH_GETATTR:
+		status = v3_getattr(c, bench_file(c));
+		break;
+	case BENCH_LOOKUP:
+		status = v3_lookup(c, bench_file(c)->name, NULL);
+		break;
+	case BENCH_READ:
+		status = v3_read(c, bench_file(c));
+		break;
+	case BENCH_WRITE:
+		status = v3_write(c, bench_file(c), bench_offset(c), UNSTABLE);
+		break;
+	case BENCH_READDIR:
+		status = v3_readdir(c);
+		break;
+	default:
+		return false;
+	}
+	return status == NFS3_OK;
+}
+
+static void v3_teardown(struct bench_client *c)
+{
+}
+
+static const struct bench_proto nfsv3_proto = {
+	.name = "NFSv3",
+	.ops = (1 << BENCH_GETATTR) | (1 << BENCH_LOOKUP) | (1 << BENCH_READ) |
+	       (1 << BENCH_WRITE) | (1 << BENCH_READDIR),
+	.setup = v3_setup,
+	.op = v3_op,
+	.teardown = v3_teardown,
+};
+
+/*
+ * NFSv4.1
+ */
+
+static struct bitmap4 getattr_mask;
+static struct bitmap4 readdir_mask;
+
+static void bitmap_set(struct bitmap4 *bits, int attr)
+{
+	bits->map[attr / 32] |= 1U << (attr % 32);
+	if (bits->bitmap4_len < attr / 32 + 1)
+		bits->bitmap4_len = attr / 32 + 1;
+}
+
+/**
+ * @brief Attributes of a typical stat()
+ */
+
+static void v41_init_masks(void)
+{
+	static const int stat_attrs[] = {
+		FATTR4_TYPE, FATTR4_CHANGE, FATTR4_SIZE, FATTR4_FSID,
+		FATTR4_FILEID, FATTR4_MODE, FATTR4_NUMLINKS, FATTR4_OWNER,
+		FATTR4_OWNER_GROUP, FATTR4_SPACE_USED, FATTR4_TIME_ACCESS,
+		FATTR4_TIME_METADATA, FATTR4_TIME_MODIFY
+	};
+	int i;
+
+	for (i = 0; i < sizeof(stat_attrs) / sizeof(stat_attrs[0]); i++)
+		bitmap_set(&getattr_mask, stat_attrs[i]);
+
+	bitmap_set(&readdir_mask, FATTR4_TYPE);
+	bitmap_set(&readdir_mask, FATTR4_FILEID);
+}
+
+static inline void v41_sequence(struct bench_client *c, nfs_argop4 *op)
+{
+	SEQUENCE4args *arg = &op->nfs_argop4_u.opsequence;
+
+	op->argop = NFS4_OP_SEQUENCE;
+	memcpy(arg->sa_sessionid, c->sessionid, NFS4_SESSIONID_SIZE);
+	arg->sa_sequenceid = c->seqid;
+	arg->sa_slotid = 0;
+	arg->sa_highest_slotid = 0;
+	arg->sa_cachethis = FALSE;
+}
+
+static inline void v41_putfh(struct bench_client *c, nfs_argop4 *op,
+			     const struct bench_fh *fh)
+{
+	op->argop = NFS4_OP_PUTFH;
+	op->nfs_argop4_u.opputfh.object.nfs_fh4_val = bench_fh_arg(c, fh);
+	op->nfs_argop4_u.opputfh.object.nfs_fh4_len = fh->len;
+}
+
+static inline void v41_lookup(nfs_argop4 *op, const char *name)
+{
+	op->argop = NFS4_OP_LOOKUP;
+	op->nfs_argop4_u.oplookup.objname.utf8string_val = (char *)name;
+	op->nfs_argop4_u.oplookup.objname.utf8string_len = strlen(name);
+}
+
+static inline void v41_open(struct bench_client *c, nfs_argop4 *op,
+			    const char *name, const char *owner,
+			    uint32_t access, bool create)
+{
+	OPEN4args *arg = &op->nfs_argop4_u.opopen;
+
+	memset(op, 0, sizeof(*op));
+	op->argop = NFS4_OP_OPEN;
+	arg->share_access = access | OPEN4_SHARE_ACCESS_WANT_NO_DELEG;
+	arg->share_deny = OPEN4_SHARE_DENY_NONE;
+	arg->owner.clientid = c->clientid;
+	arg->owner.owner.owner_val = (char *)owner;
+	arg->owner.owner.owner_len = strlen(owner);
+	if (create) {
+		arg->openhow.opentype = OPEN4_CREATE;
+		arg->openhow.openflag4_u.how.mode = UNCHECKED4;
+	} else {
+		arg->openhow.opentype = OPEN4_NOCREATE;
+	}
+	arg->claim.claim = CLAIM_NULL;
+	arg->claim.open_claim4_u.file.utf8string_val = (char *)name;
+	arg->claim.open_claim4_u.file.utf8string_len = strlen(name);
+}
+
+/**
+ * @brief The special stateid standing for the current stateid
+ */
+
+static inline void v41_current_stateid(stateid4 *stateid)
+{
+	memset(stateid, 0, sizeof(*stateid));
+	stateid->seqid = 1;
+}
+
+/**
+ * @brief Send a compound
+ *
+ * If the first operation is SEQUENCE, it is filled in and the slot
+ * sequence id advanced when the server accepted it.
+ *
+ * @return Status of the compound, the caller frees the result.
+ */
+
+static nfsstat4 v41_compound(struct bench_client *c, nfs_argop4 *argop,
+			     u_int nops, COMPOUND4res *res)
+{
+	COMPOUND4args arg;
+	bool sequence = argop[0].argop == NFS4_OP_SEQUENCE;
+
+	if (sequence)
+		v41_sequence(c, &argop[0]);
+
+	memset(&arg, 0, sizeof(arg));
+	arg.minorversion = 1;
+	arg.argarray.argarray_val = argop;
+	arg.argarray.argarray_len = nops;
+
+	memset(res, 0, sizeof(*res));
+	if (!bench_call(c, c->clnt, NFSPROC4_COMPOUND,
+			(xdrproc_t) xdr_COMPOUND4args, &arg,
+			(xdrproc_t) xdr_COMPOUND4res, res))
+		return NFS4ERR_IO;
+
+	if (sequence && res->resarray.resarray_len > 0 &&
+	    res->resarray.resarray_val[0].nfs_resop4_u.opsequence.sr_status ==
+	    NFS4_OK)
+		c->seqid++;
+
+	return res->status;
+}
+
+static inline void v41_freeres(struct bench_client *c, COMPOUND4res *res)
+{
+	clnt_freeres(c->clnt, (xdrproc_t) xdr_COMPOUND4res, res);
+}
+
+static inline nfs_resop4 *v41_res(COMPOUND4res *res, u_int idx)
+{
+	return &res->resarray.resarray_val[idx];
+}
+
+static bool v41_create_session(struct bench_client *c)
+{
+	nfs_argop4 argop[2];
+	COMPOUND4res res;
+	EXCHANGE_ID4args *eid = &argop[0].nfs_argop4_u.opexchange_id;
+	CREATE_SESSION4args *cs = &argop[0].nfs_argop4_u.opcreate_session;
+	callback_sec_parms4 sec_parms;
+	channel_attrs4 *fore, *back;
+	char hostname[BENCH_NAME_LEN];
+	sequenceid4 sequence;
+	uint64_t now = bench_now();
+	nfsstat4 status;
+
+	/* EXCHANGE_ID */
+	memset(argop, 0, sizeof(argop));
+	if (gethostname(hostname, sizeof(hostname)) != 0)
+		strcpy(hostname, "localhost");
+	hostname[sizeof(hostname) - 1] = '\0';
+	snprintf(c->owner, sizeof(c->owner), "rpcbench.%s.%d.%d", hostname,
+		 (int)getpid(), c->id);
+
+	argop[0].argop = NFS4_OP_EXCHANGE_ID;
+	memcpy(eid->eia_clientowner.co_verifier, &now, sizeof(now));
+	eid->eia_clientowner.co_ownerid.co_ownerid_val = c->owner;
+	eid->eia_clientowner.co_ownerid.co_ownerid_len = strlen(c->owner);
+	eid->eia_flags = EXCHGID4_FLAG_USE_NON_PNFS;
+	eid->eia_state_protect.spa_how = SP4_NONE;
+
+	status = v41_compound(c, argop, 1, &res);
+	if (status != NFS4_OK) {
+		fprintf(stderr, "client %d: EXCHANGE_ID failed: %d\n", c->id,
+			status);
+		v41_freeres(c, &res);
+		return false;
+	}
+	c->clientid = v41_res(&res, 0)->nfs_resop4_u.opexchange_id.
+	    EXCHANGE_ID4res_u.eir_resok4.eir_clientid;
+	sequence = v41_res(&res, 0)->nfs_resop4_u.opexchange_id.
+	    EXCHANGE_ID4res_u.eir_resok4.eir_sequenceid;
+	v41_freeres(c, &res);
+
+	/* CREATE_SESSION, one slot since every client is synchronous */
+	memset(argop, 0, sizeof(argop));
+	memset(&sec_parms, 0, sizeof(sec_parms));
+	sec_parms.cb_secflavor = AUTH_NONE;
+
+	argop[0].argop = NFS4_OP_CREATE_SESSION;
+	cs->csa_clientid = c->clientid;
+	cs->csa_sequence = sequence;
+	fore = &cs->csa_fore_chan_attrs;
+	fore->ca_maxrequestsize = opts.io_size + 4096;
+	fore->ca_maxresponsesize = opts.io_size + 4096;
+	fore->ca_maxresponsesize_cached = 4096;
+	fore->ca_maxoperations = BENCH_MAX_OPS;
+	fore->ca_maxrequests = 1;
+	back = &cs->csa_back_chan_attrs;
+	back->ca_maxrequestsize = 4096;
+	back->ca_maxresponsesize = 4096;
+	back->ca_maxresponsesize_cached = 4096;
+	back->ca_maxoperations = 2;
+	back->ca_maxrequests = 1;
+	cs->csa_sec_parms.csa_sec_parms_val = &sec_parms;
+	cs->csa_sec_parms.csa_sec_parms_len = 1;
+
+	status = v41_compound(c, argop, 1, &res);
+	if (status != NFS4_OK) {
+		fprintf(stderr, "client %d: CREATE_SESSION failed: %d\n",
+			c->id, status);
+		v41_freeres(c, &res);
+		return false;
+	}
+	memcpy(c->sessionid, v41_res(&res, 0)->nfs_resop4_u.opcreate_session.
+	       CREATE_SESSION4res_u.csr_resok4.csr_sessionid,
+	       NFS4_SESSIONID_SIZE);
+	c->seqid = 1;
+	v41_freeres(c, &res);
+
+	/* RECLAIM_COMPLETE, we have nothing to reclaim */
+	memset(argop, 0, sizeof(argop));
+	argop[0].argop = NFS4_OP_SEQUENCE;
+	argop[1].argop = NFS4_OP_RECLAIM_COMPLETE;
+	argop[1].nfs_argop4_u.opreclaim_complete.rca_one_fs = FALSE;
+
+	status = v41_compound(c, argop, 2, &res);
+	v41_freeres(c, &res);
+	if (status != NFS4_OK && status != NFS4ERR_COMPLETE_ALREADY) {
+		fprintf(stderr, "client %d: RECLAIM_COMPLETE failed: %d\n",
+			c->id, status);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Look up the export in the pseudo file system
+ */
+
+static bool v41_lookup_export(struct bench_client *c)
+{
+	nfs_argop4 *argop;
+	COMPOUND4res res;
+	char *path, *comp, *save;
+	u_int nops = 2, ncomp = 0;
+	nfsstat4 status;
+	const char *p;
+	bool ok = false;
+
+	for (p = opts.export; *p != '\0'; p++)
+		if (*p == '/')
+			ncomp++;
+
+	argop = gsh_calloc(ncomp + 3, sizeof(*argop));
+	path = gsh_strdup(opts.export);
+
+	argop[0].argop = NFS4_OP_SEQUENCE;
+	argop[1].argop = NFS4_OP_PUTROOTFH;
+	for (comp = strtok_r(path, "/", &save); comp != NULL;
+	     comp = strtok_r(NULL, "/", &save))
+		v41_lookup(&argop[nops++], comp);
+	argop[nops++].argop = NFS4_OP_GETFH;
+
+	status = v41_compound(c, argop, nops, &res);
+	if (status != NFS4_OK) {
+		fprintf(stderr, "client %d: lookup of %s failed: %d\n", c->id,
+			opts.export, status);
+	} else {
+		GETFH4resok *fh = &v41_res(&res, nops - 1)->nfs_resop4_u.
+		    opgetfh.GETFH4res_u.resok4;
+
+		ok = bench_fh_set(&c->root, fh->object.nfs_fh4_val,
+				  fh->object.nfs_fh4_len);
+	}
+	v41_freeres(c, &res);
+	gsh_free(argop);
+	gsh_free(path);
+	return ok;
+}
+
+static nfsstat4 v41_write(struct bench_client *c, struct bench_file *file,
+			  uint64_t offset, stable_how4 stable)
+{
+	nfs_argop4 argop[3];
+	COMPOUND4res res;
+	WRITE4args *arg = &argop[2].nfs_argop4_u.opwrite;
+	nfsstat4 status;
+
+	argop[0].argop = NFS4_OP_SEQUENCE;
+	v41_putfh(c, &argop[1], &file->fh);
+	argop[2].argop = NFS4_OP_WRITE;
+	arg->stateid = file->open_stateid;
+	arg->offset = offset;
+	arg->stable = stable;
+	arg->data.data_val = c->iobuf;
+	arg->data.data_len = opts.io_size;
+
+	status = v41_compound(c, argop, 3, &res);
+	v41_freeres(c, &res);
+	return status;
+}
+
+static bool v41_setup(struct bench_client *c)
+{
+	nfs_argop4 argop[4];
+	COMPOUND4res res;
+	struct bench_file *file;
+	nfsstat4 status;
+	uint64_t offset;
+	int i;
+
+	c->clnt = bench_connect(c, NFS4_PROGRAM, NFS_V4, opts.port);
+	if (c->clnt == NULL || !bench_secure(c))
+		return false;
+
+	if (!v41_create_session(c) || !v41_lookup_export(c))
+		return false;
+
+	for (i = 0; i < opts.files; i++) {
+		file = &c->files[i];
+
+		argop[0].argop = NFS4_OP_SEQUENCE;
+		v41_putfh(c, &argop[1], &c->root);
+		v41_open(c, &argop[2], file->name, c->owner,
+			 OPEN4_SHARE_ACCESS_BOTH, true);
+		argop[3].argop = NFS4_OP_GETFH;
+
+		status = v41_compound(c, argop, 4, &res);
+		if (status == NFS4_OK) {
+			GETFH4resok *fh = &v41_res(&res, 3)->nfs_resop4_u.
+			    opgetfh.GETFH4res_u.resok4;
+
+			file->open_stateid = v41_res(&res, 2)->nfs_resop4_u.
+			    opopen.OPEN4res_u.resok4.stateid;
+			if (!bench_fh_set(&file->fh, fh->object.nfs_fh4_val,
+					  fh->object.nfs_fh4_len))
+				status = NFS4ERR_BADHANDLE;
+		}
+		v41_freeres(c, &res);
+		if (status != NFS4_OK) {
+			fprintf(stderr, "client %d: open of %s failed: %d\n",
+				c->id, file->name, status);
+			return false;
+		}
+
+		for (offset = 0; offset < opts.file_size;
+		     offset += opts.io_size) {
+			status = v41_write(c, file, offset, FILE_SYNC4);
+			if (status != NFS4_OK) {
+				fprintf(stderr,
+					"client %d: write to %s failed: %d\n",
+					c->id, file->name, status);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool v41_op(struct bench_client *c, enum bench_op op)
+{
+	nfs_argop4 argop[BENCH_MAX_OPS];
+	COMPOUND4res res;
+	struct bench_file *file = bench_file(c);
+	nfsstat4 status;
+	u_int nops = 2;
+
+	memset(argop, 0, sizeof(argop));
+	argop[0].argop = NFS4_OP_SEQUENCE;
+
+	switch (op) {
+	case BENCH_GETATTR:
+		v41_putfh(c, &argop[1], &file->fh);
+		argop[nops].argop = NFS4_OP_GETATTR;
+		argop[nops++].nfs_argop4_u.opgetattr.attr_request =
+		    getattr_mask;
+		break;
+
+	case BENCH_LOOKUP:
+		v41_putfh(c, &argop[1], &c->root);
+		v41_lookup(&argop[nops++], file->name);
+		argop[nops++].argop = NFS4_OP_GETFH;
+		break;
+
+	case BENCH_READ:
+		v41_putfh(c, &argop[1], &file->fh);
+		argop[nops].argop = NFS4_OP_READ;
+		argop[nops].nfs_argop4_u.opread.stateid = file->open_stateid;
+		argop[nops].nfs_argop4_u.opread.offset = bench_offset(c);
+		argop[nops++].nfs_argop4_u.opread.count = opts.io_size;
+		break;
+
+	case BENCH_WRITE:
+		return v41_write(c, file, bench_offset(c), UNSTABLE4) ==
+		    NFS4_OK;
+
+	case BENCH_READDIR:
+		v41_putfh(c, &argop[1], &c->root);
+		argop[nops].argop = NFS4_OP_READDIR;
+		argop[nops].nfs_argop4_u.opreaddir.dircount = BENCH_DIRCOUNT;
+		argop[nops].nfs_argop4_u.opreaddir.maxcount = BENCH_DIRCOUNT;
+		argop[nops++].nfs_argop4_u.opreaddir.attr_request =
+		    readdir_mask;
+		break;
+
+	case BENCH_OPEN:
+		/* A second open owner, so the CLOSE does not tear down
+		 * the open used for I/O.
+		 */
+		v41_putfh(c, &argop[1], &c->root);
+		v41_open(c, &argop[nops++], file->name, "rpcbench.open",
+			 OPEN4_SHARE_ACCESS_READ, false);
+		argop[nops].argop = NFS4_OP_CLOSE;
+		v41_current_stateid(
+			&argop[nops++].nfs_argop4_u.opclose.open_stateid);
+		break;
+
+	case BENCH_LOCK:
+		v41_putfh(c, &argop[1], &file->fh);
+		argop[nops].argop = NFS4_OP_LOCK;
+		{
+			LOCK4args *lock = &argop[nops++].nfs_argop4_u.oplock;
+
+			lock->locktype = WRITE_LT;
+			lock->offset = bench_offset(c);
+			lock->length = opts.io_size;
+			if (file->lock_valid) {
+				lock->locker.new_lock_owner = FALSE;
+				lock->locker.locker4_u.lock_owner.
+				    lock_stateid = file->lock_stateid;
+			} else {
+				open_to_lock_owner4 *lo =
+				    &lock->locker.locker4_u.open_owner;
+
+				lock->locker.new_lock_owner = TRUE;
+				lo->open_stateid = file->open_stateid;
+				lo->lock_owner.clientid = c->clientid;
+				lo->lock_owner.owner.owner_val = c->owner;
+				lo->lock_owner.owner.owner_len =
+				    strlen(c->owner);
+			}
+			argop[nops].argop = NFS4_OP_LOCKU;
+			argop[nops].nfs_argop4_u.oplocku.locktype = WRITE_LT;
+			argop[nops].nfs_argop4_u.oplocku.offset = lock->offset;
+			argop[nops].nfs_argop4_u.oplocku.length = lock->length;
+			v41_current_stateid(
+			    &argop[nops++].nfs_argop4_u.oplocku.lock_stateid);
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	status = v41_compound(c, argop, nops, &res);
+	if (op == BENCH_LOCK && status == NFS4_OK) {
+		file->lock_stateid = v41_res(&res, nops - 1)->nfs_resop4_u.
+		    oplocku.LOCKU4res_u.lock_stateid;
+		file->lock_valid = true;
+	}
+	v41_freeres(c, &res);
+	return status == NFS4_OK;
+}
+
+/**
+ * @brief Close the files and tear down the session and client ID
+ *
+ * Failures are ignored, the server will expire whatever is left.
+ */
+
+static void v41_teardown(struct bench_client *c)
+{
+	nfs_argop4 argop[3];
+	COMPOUND4res res;
+	int i;
+
+	if (c->clnt == NULL || c->failed)
+		return;
+
+	for (i = 0; i < opts.files; i++) {
+		if (c->files[i].fh.len == 0)
+			continue;
+		memset(argop, 0, sizeof(argop));
+		argop[0].argop = NFS4_OP_SEQUENCE;
+		v41_putfh(c, &argop[1], &c->files[i].fh);
+		argop[2].argop = NFS4_OP_CLOSE;
+		argop[2].nfs_argop4_u.opclose.open_stateid =
+		    c->files[i].open_stateid;
+		(void)v41_compound(c, argop, 3, &res);
+		v41_freeres(c, &res);
+	}
+
+	memset(argop, 0, sizeof(argop));
+	argop[0].argop = NFS4_OP_DESTROY_SESSION;
+	memcpy(argop[0].nfs_argop4_u.opdestroy_session.dsa_sessionid,
+	       c->sessionid, NFS4_SESSIONID_SIZE);
+	(void)v41_compound(c, argop, 1, &res);
+	v41_freeres(c, &res);
+
+	memset(argop, 0, sizeof(argop));
+	argop[0].argop = NFS4_OP_DESTROY_CLIENTID;
+	argop[0].nfs_argop4_u.opdestroy_clientid.dca_clientid = c->clientid;
+	(void)v41_compound(c, argop, 1, &res);
+	v41_freeres(c, &res);
+}
+
+static const struct bench_proto nfsv41_proto = {
+	.name = "NFSv4.1",
+	.ops = (1 << BENCH_OP_COUNT) - 1,
+	.setup = v41_setup,
+	.op = v41_op,
+	.teardown = v41_teardown,
+};
+
+/*
+ * Driver
+ */
+
+static void *bench_client_thread(void *arg)
+{
+	struct bench_client *c = arg;
+	struct bench_stats *stats;
+	enum bench_op op;
+	uint64_t start, end;
+	int32_t phase;
+	bool ok;
+
+	if (!opts.proto->setup(c))
+		c->failed = true;
+
+	(void)pthread_barrier_wait(&start_barrier);
+
+	while (!c->failed) {
+		phase = atomic_fetch_int32_t(&bench_phase);
+		if (phase == PHASE_STOP)
+			break;
+
+		op = bench_pick_op(c);
+		start = bench_now();
+		ok = opts.proto->op(c, op);
+		end = bench_now();
+
+		/* Only count operations that ran entirely in the
+		 * measured period.
+		 */
+		if (phase != PHASE_RUN ||
+		    atomic_fetch_int32_t(&bench_phase) != PHASE_RUN)
+			continue;
+
+		stats = &c->stats[op];
+		stats->ops++;
+		if (!ok)
+			stats->errors++;
+		lat_hist_record(&stats->lat, end - start);
+	}
+
+	opts.proto->teardown(c);
+	return NULL;
+}
+
+static void bench_report(struct bench_client *clients, uint64_t elapsed)
+{
+	struct bench_stats sum, total;
+	double secs = elapsed / 1000000000.0;
+	uint64_t count;
+	int op, i;
+
+	memset(&total, 0, sizeof(total));
+
+	printf("%s %s, %d clients, %d files of %llu bytes each, "
+	       "I/O size %u, %.1f seconds\n\n", opts.proto->name, opts.flavor,
+	       opts.clients, opts.files, (unsigned long long)opts.file_size,
+	       opts.io_size, secs);
+	printf("%-8s %12s %10s %8s %10s %10s %10s %10s %10s\n",
+	       "op", "count", "ops/s", "errors", "p50(us)", "p90(us)",
+	       "p99(us)", "p99.9(us)", "max(us)");
+
+	for (op = 0; op <= BENCH_OP_COUNT; op++) {
+		if (op < BENCH_OP_COUNT) {
+			if (opts.weight[op] == 0)
+				continue;
+			memset(&sum, 0, sizeof(sum));
+			for (i = 0; i < opts.clients; i++) {
+				sum.ops += clients[i].stats[op].ops;
+				sum.errors += clients[i].stats[op].errors;
+				lat_hist_add(&sum.lat,
+					     &clients[i].stats[op].lat);
+			}
+			total.ops += sum.ops;
+			total.errors += sum.errors;
+			lat_hist_add(&total.lat, &sum.lat);
+		} else {
+			sum = total;
+		}
+
+		count = lat_hist_count(&sum.lat);
+		printf("%-8s %12llu %10.0f %8llu %10.1f %10.1f %10.1f %10.1f "
+		       "%10.1f\n",
+		       op < BENCH_OP_COUNT ? bench_op_names[op] : "total",
+		       (unsigned long long)sum.ops, sum.ops / secs,
+		       (unsigned long long)sum.errors,
+		       lat_hist_percentile(&sum.lat, count, 50) / 1000.0,
+		       lat_hist_percentile(&sum.lat, count, 90) / 1000.0,
+		       lat_hist_percentile(&sum.lat, count, 99) / 1000.0,
+		       lat_hist_percentile(&sum.lat, count, 99.9) / 1000.0,
+		       lat_hist_max(&sum.lat) / 1000.0);
+	}
+}
+
+/**
+ * @brief Parse a security flavor
+ */
+
+static bool parse_flavor(const char *str)
+{
+	opts.flavor = str;
+	if (strcmp(str, "sys") == 0) {
+		opts.gss_svc = 0;
+		return true;
+	}
+#ifdef _HAVE_GSSAPI
+	if (strcmp(str, "krb5") == 0) {
+		opts.gss_svc = RPCSEC_GSS_SVC_NONE;
+		return true;
+	}
+	if (strcmp(str, "krb5i") == 0) {
+		opts.gss_svc = RPCSEC_GSS_SVC_INTEGRITY;
+		return true;
+	}
+	if (strcmp(str, "krb5p") == 0) {
+		opts.gss_svc = RPCSEC_GSS_SVC_PRIVACY;
+		return true;
+	}
+#endif
+	fprintf(stderr, "unsupported security flavor %s\n", str);
+	return false;
+}
+
+/**
+ * @brief Parse a size with an optional k, m or g suffix
+ */
+
+static bool parse_size(const char *str, uint64_t *size)
+{
+	char *end;
+	unsigned long long val = strtoull(str, &end, 0);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		val <<= 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		val <<= 20;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		val <<= 30;
+		end++;
+		break;
+	}
+	if (*end != '\0' || val == 0)
+		return false;
+	*size = val;
+	return true;
+}
+
+/**
+ * @brief Parse an operation mix such as "getattr=40,read=30,write=30"
+ */
+
+static bool parse_mix(const char *mix)
+{
+	char *str = gsh_strdup(mix);
+	char *item, *save, *eq;
+	bool ok = true;
+	int op;
+
+	memset(opts.weight, 0, sizeof(opts.weight));
+	opts.total_weight = 0;
+
+	for (item = strtok_r(str, ",", &save); item != NULL && ok;
+	     item = strtok_r(NULL, ",", &save)) {
+		eq = strchr(item, '=');
+		if (eq != NULL)
+			*eq++ = '\0';
+		for (op = 0; op < BENCH_OP_COUNT; op++)
+			if (strcmp(item, bench_op_names[op]) == 0)
+				break;
+		if (op == BENCH_OP_COUNT) {
+			fprintf(stderr, "unknown op %s\n", item);
+			ok = false;
+		} else if ((opts.proto->ops & (1 << op)) == 0) {
+			fprintf(stderr, "%s is not available with %s\n",
+				item, opts.proto->name);
+			ok = false;
+		} else {
+			opts.weight[op] = eq != NULL ? atoi(eq) : 1;
+			opts.total_weight += opts.weight[op];
+		}
+	}
+
+	if (ok && opts.total_weight == 0) {
+		fprintf(stderr, "empty op mix\n");
+		ok = false;
+	}
+	gsh_free(str);
+	return ok;
+}
+
+static void bench_interrupt(int sig)
+{
+	interrupted = 1;
+}
+
+/**
+ * @brief Sleep until the time is up or we are interrupted
+ */
+
+static void bench_sleep(int seconds)
+{
+	uint64_t until = bench_now() + (uint64_t)seconds * 1000000000;
+	struct timespec tick = { 0, 100000000 };
+
+	while (!interrupted && bench_now() < until)
+		nanosleep(&tick, NULL);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_client *clients;
+	const char *mix = NULL;
+	uint64_t start, elapsed, size;
+	int c, i, j, failed = 0;
+
+	opts.proto = &nfsv41_proto;
+
+	while ((c = getopt(argc, argv, "s:p:e:v:c:f:S:b:t:w:m:a:h")) != EOF)
+		switch (c) {
+		case 's':
+			opts.server = optarg;
+			break;
+		case 'p':
+			opts.port = atoi(optarg);
+			break;
+		case 'e':
+			opts.export = optarg;
+			break;
+		case 'v':
+			if (strcmp(optarg, "3") == 0) {
+				opts.proto = &nfsv3_proto;
+			} else if (strcmp(optarg, "4.1") == 0) {
+				opts.proto = &nfsv41_proto;
+			} else {
+				fprintf(stderr, "unsupported version %s\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'c':
+			opts.clients = atoi(optarg);
+			break;
+		case 'f':
+			opts.files = atoi(optarg);
+			break;
+		case 'S':
+			if (!parse_size(optarg, &opts.file_size)) {
+				fprintf(stderr, "bad file size %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'b':
+			if (!parse_size(optarg, &size) || size > (1 << 20)) {
+				fprintf(stderr, "bad I/O size %s\n", optarg);
+				exit(1);
+			}
+			opts.io_size = size;
+			break;
+		case 't':
+			opts.duration = atoi(optarg);
+			break;
+		case 'w':
+			opts.warmup = atoi(optarg);
+			break;
+		case 'm':
+			mix = optarg;
+			break;
+		case 'a':
+			if (!parse_flavor(optarg))
+				exit(1);
+			break;
+		case 'h':
+		case '?':
+		default:
+			fprintf(stderr, USAGE, argv[0]);
+			exit(1);
+			break;
+		}
+
+	if (opts.export == NULL || opts.clients <= 0 || opts.files <= 0 ||
+	    opts.duration <= 0 || opts.warmup < 0) {
+		fprintf(stderr, USAGE, argv[0]);
+		exit(1);
+	}
+
+	if (mix == NULL)
+		mix = opts.proto == &nfsv3_proto
+		    ? "getattr=40,lookup=20,read=20,write=10,readdir=10"
+		    : "getattr=35,lookup=15,read=20,write=10,readdir=5,"
+		      "open=10,lock=5";
+	if (!parse_mix(mix))
+		exit(1);
+
+	v41_init_masks();
+
+	clients = gsh_calloc(opts.clients, sizeof(*clients));
+	for (i = 0; i < opts.clients; i++) {
+		clients[i].id = i;
+		clients[i].seed = getpid() ^ (i * 2654435761U);
+		clients[i].auth = authunix_ncreate_default();
+		clients[i].iobuf = gsh_malloc(opts.io_size);
+		memset(clients[i].iobuf, 'a' + i % 26, opts.io_size);
+		clients[i].files = gsh_calloc(opts.files,
+					      sizeof(struct bench_file));
+		for (j = 0; j < opts.files; j++)
+			snprintf(clients[i].files[j].name, BENCH_NAME_LEN,
+				 "rpcbench.%d.%d", i, j);
+	}
+
+	signal(SIGINT, bench_interrupt);
+	signal(SIGTERM, bench_interrupt);
+
+	(void)pthread_barrier_init(&start_barrier, NULL, opts.clients + 1);
+	for (i = 0; i < opts.clients; i++) {
+		if (pthread_create(&clients[i].thread, NULL,
+				   bench_client_thread, &clients[i]) != 0) {
+			fprintf(stderr, "pthread_create failed. errno=%d\n",
+				errno);
+			exit(1);
+		}
+	}
+
+	printf("Setting up %d clients\n", opts.clients);
+	(void)pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < opts.clients; i++)
+		if (clients[i].failed)
+			failed++;
+	if (failed == opts.clients) {
+		fprintf(stderr, "all clients failed to set up\n");
+		interrupted = 1;
+	} else if (failed != 0) {
+		fprintf(stderr, "%d clients failed to set up\n", failed);
+	}
+
+	atomic_store_int32_t(&bench_phase, PHASE_WARMUP);
+	bench_sleep(opts.warmup);
+
+	atomic_store_int32_t(&bench_phase, PHASE_RUN);
+	start = bench_now();
+	bench_sleep(opts.duration);
+	elapsed = bench_now() - start;
+	atomic_store_int32_t(&bench_phase, PHASE_STOP);
+
+	for (i = 0; i < opts.clients; i++)
+		pthread_join(clients[i].thread, NULL);
+
+	if (failed != opts.clients)
+		bench_report(clients, elapsed);
+
+	for (i = 0; i < opts.clients; i++) {
+		if (clients[i].clnt != NULL)
+			clnt_destroy(clients[i].clnt);
+		auth_destroy(clients[i].auth);
+		gsh_free(clients[i].iobuf);
+		gsh_free(clients[i].files);
+	}
+	gsh_free(clients);
+	(void)pthread_barrier_destroy(&start_barrier);
+
+	return failed == opts.clients;
+}